@@ -0,0 +1,142 @@
+#include "pch.h"
+#include "BoundingVolumeHierarchy.h"
+#include "TestFramework.h"
+
+#include <algorithm>
+#include <random>
+
+static std::vector<BoundingBox> RandomBoxes(std::mt19937& random, uint32_t count, float emptyChance)
+{
+    std::uniform_real_distribution<float> position(-100.f, 100.f);
+    std::uniform_real_distribution<float> extent(0.01f, 3.f);
+    std::uniform_real_distribution<float> chance(0.f, 1.f);
+
+    std::vector<BoundingBox> boxes(count);
+    for (BoundingBox& box : boxes)
+    {
+        if (chance(random) < emptyChance)
+        { box = BoundingBox::Empty(); }
+        else
+        { box = BoundingBox::FromCenterExtents(float3(position(random), position(random), position(random)), float3(extent(random), extent(random), extent(random))); }
+    }
+    return boxes;
+}
+
+static Frustum RandomFrustum(std::mt19937& random)
+{
+    std::uniform_real_distribution<float> position(-100.f, 100.f);
+    float3 eye(position(random) * 0.5f, position(random) * 0.5f, position(random) * 0.5f);
+    float3 target(position(random), position(random), position(random));
+    return Frustum(float4x4::MakeCameraLookAtViewTransform(eye, target, float3::UnitY) * float4x4::MakePerspectiveTransformReverseZ(1.2f, 1.7f, 0.01f));
+}
+
+static std::vector<uint32_t> BruteForceCull(std::span<const BoundingBox> boxes, const Frustum& frustum)
+{
+    std::vector<uint32_t> visibleItems;
+    for (uint32_t i = 0; i < boxes.size(); i++)
+    {
+        if (!boxes[i].IsEmpty() && frustum.Intersects(boxes[i]))
+        { visibleItems.push_back(i); }
+    }
+    return visibleItems;
+}
+
+static std::vector<uint32_t> SortedCull(const BoundingVolumeHierarchy& bvh, const Frustum& frustum)
+{
+    std::vector<uint32_t> visibleItems;
+    bvh.Cull(frustum, visibleItems);
+    std::sort(visibleItems.begin(), visibleItems.end());
+    return visibleItems;
+}
+
+TEST(BoundingVolumeHierarchy, MatchesBruteForce)
+{
+    // Sizes around multiples of four exercise partially filled leaves
+    std::mt19937 random(1);
+    for (uint32_t boxCount = 0; boxCount < 100; boxCount++)
+    {
+        std::vector<BoundingBox> boxes = RandomBoxes(random, boxCount, 0.05f);
+        BoundingVolumeHierarchy bvh(boxes);
+        for (uint32_t i = 0; i < 4; i++)
+        {
+            Frustum frustum = RandomFrustum(random);
+            Check(SortedCull(bvh, frustum) == BruteForceCull(boxes, frustum));
+        }
+    }
+}
+
+TEST(BoundingVolumeHierarchy, MatchesBruteForceWithManyBoxes)
+{
+    std::mt19937 random(2);
+    std::vector<BoundingBox> boxes = RandomBoxes(random, 20000, 0.05f);
+    BoundingVolumeHierarchy bvh(boxes);
+    for (uint32_t i = 0; i < 50; i++)
+    {
+        Frustum frustum = RandomFrustum(random);
+        Check(SortedCull(bvh, frustum) == BruteForceCull(boxes, frustum));
+    }
+}
+
+TEST(BoundingVolumeHierarchy, IdenticalBoxes)
+{
+    // Boxes which can't be split by their centers must still all end up in the hierarchy
+    float3 center(0.f, 0.f, 10.f);
+    std::vector<BoundingBox> boxes(777, BoundingBox::FromCenterExtents(center, float3(1.f, 1.f, 1.f)));
+    BoundingVolumeHierarchy bvh(boxes);
+    Frustum frustum(float4x4::MakeCameraLookAtViewTransform(float3(0.f, 0.f, 0.f), center, float3::UnitY) * float4x4::MakePerspectiveTransformReverseZ(1.2f, 1.f, 0.01f));
+    Require(BruteForceCull(boxes, frustum).size() == boxes.size());
+    Check(SortedCull(bvh, frustum) == BruteForceCull(boxes, frustum));
+}
+
+TEST(BoundingVolumeHierarchy, OnlyEmptyBoxes)
+{
+    std::vector<BoundingBox> boxes(10, BoundingBox::Empty());
+    BoundingVolumeHierarchy bvh(boxes);
+    std::mt19937 random(3);
+    for (uint32_t i = 0; i < 10; i++)
+    { Check(SortedCull(bvh, RandomFrustum(random)).empty()); }
+}
+
+TEST(BoundingVolumeHierarchy, CullAppends)
+{
+    std::mt19937 random(4);
+    std::vector<BoundingBox> boxes = RandomBoxes(random, 500, 0.f);
+    BoundingVolumeHierarchy bvh(boxes);
+    Frustum frustum = RandomFrustum(random);
+
+    std::vector<uint32_t> visibleItems = { UINT32_MAX };
+    bvh.Cull(frustum, visibleItems);
+    Require(!visibleItems.empty());
+    Check(visibleItems[0] == UINT32_MAX);
+    Check(visibleItems.size() == BruteForceCull(boxes, frustum).size() + 1);
+}
+
+TEST(BoundingVolumeHierarchy, Benchmark)
+{
+    // The benchmark asserts that the hierarchy and brute force agree for every frustum
+    BoundingVolumeHierarchyBenchmark benchmark = BoundingVolumeHierarchy::Benchmark(5000, 16);
+    Check(benchmark.BoxCount == 5000);
+    Check(benchmark.FrustumCount == 16);
+    Check(benchmark.NodeCount > 0);
+    Check(benchmark.AverageVisibleCount > 0.0);
+    Check(benchmark.AverageVisibleCount < 5000.0);
+}
+
+TEST(BoundingBox, FromPoints)
+{
+    std::mt19937 random(5);
+    std::uniform_real_distribution<float> position(-100.f, 100.f);
+    for (uint32_t pointCount = 1; pointCount < 50; pointCount++)
+    {
+        std::vector<float3> points(pointCount);
+        for (float3& point : points)
+        { point = float3(position(random), position(random), position(random)); }
+
+        BoundingBox expected = BoundingBox::Empty();
+        for (float3 point : points)
+        { expected = expected.Union({ point, point }); }
+
+        BoundingBox box = BoundingBox::FromPoints(points);
+        Check(memcmp(&box, &expected, sizeof(box)) == 0);
+    }
+}
@@ -0,0 +1,134 @@
+#include "pch.h"
+#include "DescriptorAllocator.h"
+#include "TestFramework.h"
+
+#include <deque>
+#include <random>
+
+TEST(DescriptorAllocator, ReusesLowestFreedIndexFirst)
+{
+    DescriptorAllocator allocator(8);
+    DescriptorHandle handles[8];
+    for (uint32_t i = 0; i < 8; i++)
+    {
+        Require(allocator.TryAllocate(&handles[i]));
+        Check(handles[i].Index == i);
+        Check(handles[i].Generation == 1);
+    }
+
+    DescriptorHandle handle;
+    Check(!allocator.TryAllocate(&handle));
+
+    allocator.Free(handles[5]);
+    allocator.Free(handles[2]);
+    allocator.Free(handles[3]);
+
+    DescriptorAllocatorStatistics statistics = allocator.Statistics();
+    Check(statistics.Capacity == 8);
+    Check(statistics.LiveCount == 5);
+    Check(statistics.HighWaterMark == 8);
+    Check(statistics.FreeListCount == 3);
+    Check(statistics.LargestFreeRun == 2);
+    Check(statistics.Fragmentation() == 3.f / 8.f);
+
+    Require(allocator.TryAllocate(&handle));
+    Check(handle.Index == 2);
+    Check(handle.Generation == 3);
+    Require(allocator.TryAllocate(&handle));
+    Check(handle.Index == 3);
+    Require(allocator.TryAllocate(&handle));
+    Check(handle.Index == 5);
+    Check(!allocator.TryAllocate(&handle));
+    Check(allocator.Statistics().Fragmentation() == 0.f);
+}
+
+TEST(DescriptorAllocator, DetectsStaleHandles)
+{
+    DescriptorAllocator allocator(4);
+    DescriptorHandle first;
+    Require(allocator.TryAllocate(&first));
+    Check(allocator.IsLive(first));
+
+    allocator.Free(first);
+    Check(!allocator.IsLive(first));
+
+    // The index is reused, but the old handle stays dead
+    DescriptorHandle second;
+    Require(allocator.TryAllocate(&second));
+    Check(second.Index == first.Index);
+    Check(allocator.IsLive(second));
+    Check(!allocator.IsLive(first));
+
+    // Out of range indices, free generations, and indices which were never allocated are never live
+    Check(!allocator.IsLive({ .Index = 100, .Generation = 1 }));
+    Check(!allocator.IsLive({ .Index = second.Index, .Generation = second.Generation + 1 }));
+    Check(!allocator.IsLive({ .Index = 3, .Generation = 1 }));
+}
+
+TEST(DescriptorAllocator, EmptyStatistics)
+{
+    DescriptorAllocator allocator(16);
+    DescriptorAllocatorStatistics statistics = allocator.Statistics();
+    Check(statistics.LiveCount == 0);
+    Check(statistics.HighWaterMark == 0);
+    Check(statistics.LargestFreeRun == 0);
+    Check(statistics.Fragmentation() == 0.f);
+}
+
+TEST(DescriptorAllocator, DeferredFrees)
+{
+    // Frees are deferred until the GPU is done with the frame which last used the descriptor (like ResourceDescriptorManager does) while the GPU is
+    // shadowed as the set of indices it may still read
+    const uint32_t framesInFlight = 3;
+    const uint32_t capacity = 4096;
+    std::mt19937 random(7);
+    DescriptorAllocator allocator(capacity);
+    std::vector<DescriptorHandle> live;
+    std::deque<std::pair<uint64_t, DescriptorHandle>> pendingFrees;
+    std::vector<bool> isGpuVisible(capacity, false);
+    uint32_t reusedTooEarlyCount = 0;
+    uint32_t staleCount = 0;
+
+    for (uint64_t frame = 0; frame < 20000; frame++)
+    {
+        while (!pendingFrees.empty() && pendingFrees.front().first + framesInFlight <= frame)
+        {
+            DescriptorHandle handle = pendingFrees.front().second;
+            pendingFrees.pop_front();
+            isGpuVisible[handle.Index] = false;
+            allocator.Free(handle);
+            staleCount += allocator.IsLive(handle);
+        }
+
+        uint32_t allocationCount = random() % 20;
+        for (uint32_t i = 0; i < allocationCount; i++)
+        {
+            DescriptorHandle handle;
+            if (!allocator.TryAllocate(&handle))
+            { break; }
+
+            reusedTooEarlyCount += isGpuVisible[handle.Index];
+            isGpuVisible[handle.Index] = true;
+            live.push_back(handle);
+        }
+
+        uint32_t freeCount = random() % 20;
+        for (uint32_t i = 0; i < freeCount && !live.empty(); i++)
+        {
+            size_t j = random() % live.size();
+            pendingFrees.push_back({ frame, live[j] });
+            live[j] = live.back();
+            live.pop_back();
+        }
+
+        DescriptorAllocatorStatistics statistics = allocator.Statistics();
+        Check(statistics.LiveCount == live.size() + pendingFrees.size());
+        Check(statistics.LiveCount + statistics.FreeListCount == statistics.HighWaterMark);
+        Check(statistics.LargestFreeRun <= statistics.FreeListCount);
+    }
+
+    Check(reusedTooEarlyCount == 0);
+    Check(staleCount == 0);
+    for (const DescriptorHandle& handle : live)
+    { Check(allocator.IsLive(handle)); }
+}
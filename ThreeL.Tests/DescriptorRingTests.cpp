@@ -0,0 +1,167 @@
+#include "pch.h"
+#include "DescriptorRing.h"
+#include "TestFramework.h"
+
+#include <random>
+
+TEST(DescriptorRing, ReclaimsWholeFrames)
+{
+    DescriptorRing ring(10);
+    uint32_t offset;
+    Require(ring.TryAllocate(4, &offset));
+    Check(offset == 0);
+    Require(ring.TryAllocate(4, &offset));
+    Check(offset == 4);
+    ring.EndFrame(1);
+    Check(ring.HasFramesInFlight());
+    Check(ring.OldestFenceValue() == 1);
+
+    // Tables never straddle the end of the ring, and wrapping would overwrite the first frame
+    Check(!ring.TryAllocate(4, &offset));
+    Require(ring.TryAllocate(2, &offset));
+    Check(offset == 8);
+    ring.EndFrame(2);
+
+    ring.Retire(1);
+    Check(ring.OldestFenceValue() == 2);
+    Require(ring.TryAllocate(3, &offset));
+    Check(offset == 0);
+    Check(!ring.TryAllocate(6, &offset));
+    ring.EndFrame(3);
+
+    DescriptorRingStatistics statistics = ring.Statistics();
+    Check(statistics.Capacity == 10);
+    Check(statistics.UsedCount == 5);
+    Check(statistics.InFlightFrameCount == 2);
+    Check(statistics.PeakFrameUsage == 8);
+
+    ring.Retire(3);
+    Check(!ring.HasFramesInFlight());
+    Check(ring.UsedCount() == 0);
+    Require(ring.TryAllocate(10, &offset));
+    Check(offset == 0);
+    Check(ring.Statistics().HighWaterMark == 10);
+}
+
+TEST(DescriptorRing, SkippedDescriptorsBelongToTheFrameWhichSkippedThem)
+{
+    DescriptorRing ring(10);
+    uint32_t offset;
+    Require(ring.TryAllocate(7, &offset));
+    ring.EndFrame(1);
+    Require(ring.TryAllocate(2, &offset));
+    Check(offset == 7);
+    ring.EndFrame(2);
+    ring.Retire(1);
+
+    // The descriptor left at the end is skipped by frame 3, so it's only reclaimed along with it
+    Require(ring.TryAllocate(4, &offset));
+    Check(offset == 0);
+    Check(ring.UsedCount() == 2 + 1 + 4);
+    ring.EndFrame(3);
+
+    Require(ring.TryAllocate(3, &offset));
+    Check(offset == 4);
+    Check(!ring.TryAllocate(1, &offset));
+    ring.EndFrame(4);
+
+    ring.Retire(2);
+    Check(ring.UsedCount() == 1 + 4 + 3);
+    Require(ring.TryAllocate(1, &offset));
+    Check(offset == 7);
+    Check(!ring.TryAllocate(2, &offset));
+
+    ring.Retire(3);
+    Require(ring.TryAllocate(2, &offset));
+    Check(offset == 8);
+}
+
+TEST(DescriptorRing, RestartsAtTheBeginningOnceIdle)
+{
+    DescriptorRing ring(10);
+    uint32_t offset;
+    Require(ring.TryAllocate(7, &offset));
+    ring.EndFrame(1);
+    ring.Retire(1);
+
+    // Nothing is in flight, so a table which wouldn't fit at the end doesn't need to skip anything
+    Require(ring.TryAllocate(4, &offset));
+    Check(offset == 0);
+    Check(ring.UsedCount() == 4);
+}
+
+TEST(DescriptorRing, EmptyFrames)
+{
+    DescriptorRing ring(16);
+    for (uint64_t fenceValue = 1; fenceValue <= 5; fenceValue++)
+    { ring.EndFrame(fenceValue); }
+
+    Check(ring.UsedCount() == 0);
+    ring.Retire(5);
+    Check(!ring.HasFramesInFlight());
+}
+
+TEST(DescriptorRing, RandomTimeline)
+{
+    // The GPU lags a random number of frames behind the CPU, the fence value which last wrote each descriptor is shadowed to catch the ring handing out
+    // descriptors the GPU might still be reading
+    for (uint32_t capacity : { 7u, 64u, 1000u, 4096u })
+    {
+        std::mt19937 random(capacity);
+        DescriptorRing ring(capacity);
+        std::vector<uint64_t> writers(capacity, 0);
+        uint64_t cpuFenceValue = 0;
+        uint64_t gpuFenceValue = 0;
+        uint32_t stallCount = 0;
+        uint32_t allocationCount = 0;
+        uint32_t overwriteCount = 0;
+
+        for (uint32_t frame = 0; frame < 20000; frame++)
+        {
+            uint64_t frameFenceValue = ++cpuFenceValue;
+            uint32_t tableCount = random() % 8;
+            for (uint32_t t = 0; t < tableCount; t++)
+            {
+                uint32_t count = 1 + random() % std::max(1u, capacity / 5);
+                uint32_t offset;
+                bool isAllocated;
+                while (!(isAllocated = ring.TryAllocate(count, &offset)) && ring.HasFramesInFlight())
+                {
+                    // Wait for the oldest frame like the caller would
+                    stallCount++;
+                    gpuFenceValue = std::max(gpuFenceValue, ring.OldestFenceValue());
+                    ring.Retire(gpuFenceValue);
+                }
+
+                // Otherwise the current frame alone has filled the ring
+                if (!isAllocated)
+                { continue; }
+
+                Require(offset + count <= capacity);
+                for (uint32_t i = offset; i < offset + count; i++)
+                {
+                    if (writers[i] > gpuFenceValue && writers[i] != frameFenceValue)
+                    { overwriteCount++; }
+                    writers[i] = frameFenceValue;
+                }
+                allocationCount++;
+            }
+
+            ring.EndFrame(frameFenceValue);
+            if (random() % 3 != 0)
+            {
+                gpuFenceValue = std::min(cpuFenceValue, gpuFenceValue + random() % 3);
+                ring.Retire(gpuFenceValue);
+            }
+
+            DescriptorRingStatistics statistics = ring.Statistics();
+            Check(statistics.UsedCount <= capacity);
+            Check(statistics.HighWaterMark <= capacity);
+            Check(statistics.UsedCount <= statistics.HighWaterMark);
+        }
+
+        Check(overwriteCount == 0);
+        Check(stallCount > 0);
+        Check(allocationCount > 20000);
+    }
+}
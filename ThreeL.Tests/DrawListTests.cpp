@@ -0,0 +1,398 @@
+#include "pch.h"
+#include "DrawList.h"
+#include "JobSystem.h"
+#include "MockCommandList.h"
+#include "TestFramework.h"
+
+#include <random>
+
+namespace
+{
+    // None of these are ever dereferenced, they only need to be distinct
+    ID3D12PipelineState* FakePipelineState(uint32_t pipeline)
+    { return reinterpret_cast<ID3D12PipelineState*>((uintptr_t)(pipeline + 1) * 256); }
+
+    D3D12_VERTEX_BUFFER_VIEW FakeVertexBuffer(uint32_t mesh, uint32_t stream)
+    { return { .BufferLocation = 0x100000 * (uint64_t)(mesh + 1) + 0x10000 * stream, .SizeInBytes = 0x10000, .StrideInBytes = 12 }; }
+
+    D3D12_INDEX_BUFFER_VIEW FakeIndexBuffer(uint32_t mesh, uint32_t lod)
+    { return { .BufferLocation = 0x80000000 + 0x100000 * (uint64_t)mesh + 0x10000 * lod, .SizeInBytes = 0x10000 }; }
+
+    const uint32_t IndexCount = 300;
+
+    // (An empty initializer list would be ambiguous with the chunk overloads of Submit.)
+    const std::span<const uint8_t> AllVisible;
+
+    DrawPacket MakePacket(uint32_t pipeline, uint32_t mesh, uint32_t node, uint32_t primitive, uint32_t material)
+    {
+        return
+        {
+            // Same layout as the scene-built lists
+            .SortKey = ((uint64_t)pipeline << 48) | ((uint64_t)mesh << 16) | material,
+            .PipelineState = FakePipelineState(pipeline),
+            .Positions = FakeVertexBuffer(mesh, 0),
+            .Normals = FakeVertexBuffer(mesh, 1),
+            .Uvs = FakeVertexBuffer(mesh, 2),
+            .Indices = FakeIndexBuffer(mesh, 0),
+            .NodeIndex = node,
+            .PrimitiveIndex = primitive,
+            .MaterialId = material,
+            .ColorsIndex = BUFFER_DISABLED,
+            .TangentsIndex = mesh,
+            .VertexOrIndexCount = IndexCount,
+            .IsIndexed = true,
+        };
+    }
+
+    std::vector<ShaderInterop::PerNodeCb> MakeNodes(uint32_t count)
+    {
+        std::vector<ShaderInterop::PerNodeCb> nodes(count);
+        for (uint32_t i = 0; i < count; i++)
+        {
+            nodes[i].Transform = float4x4(1.f);
+            nodes[i].Transform.m30 = (float)i;
+        }
+        return nodes;
+    }
+
+    bool SameView(const D3D12_VERTEX_BUFFER_VIEW& a, const D3D12_VERTEX_BUFFER_VIEW& b) { return memcmp(&a, &b, sizeof(a)) == 0; }
+    bool SameView(const D3D12_INDEX_BUFFER_VIEW& a, const D3D12_INDEX_BUFFER_VIEW& b) { return memcmp(&a, &b, sizeof(a)) == 0; }
+
+    // Checks that a draw was issued with all of the state its packet needs
+    void CheckDrawState(const DrawList& list, const MockCommandList::Draw& draw, const DrawPacket& packet, uint32_t lod)
+    {
+        Check(draw.PipelineState == packet.PipelineState);
+        Check(SameView(draw.VertexBuffers[MeshInputSlot::Position], packet.Positions));
+        if (list.Pass() != DrawListPass::DepthPrePass)
+        { Check(SameView(draw.VertexBuffers[MeshInputSlot::Normal], packet.Normals)); }
+        Check(SameView(draw.VertexBuffers[MeshInputSlot::Uv0], packet.Uvs));
+
+        const ShaderInterop::PerNodeCb& node = list.Nodes()[packet.NodeIndex];
+        Check(memcmp(&draw.PerNode.Transform, &node.Transform, sizeof(node.Transform)) == 0);
+        Check(draw.PerNode.MaterialId == packet.MaterialId);
+        Check(draw.PerNode.ColorsIndex == packet.ColorsIndex);
+        Check(draw.PerNode.TangentsIndex == packet.TangentsIndex);
+
+        Check(draw.IsIndexed == packet.IsIndexed);
+        if (packet.IsIndexed)
+        {
+            auto [indices, indexCount] = list.LodIndices(packet, lod);
+            Check(SameView(draw.Indices, *indices));
+            Check(draw.VertexOrIndexCount == indexCount);
+        }
+        else
+        {
+            Check(draw.VertexOrIndexCount == packet.VertexOrIndexCount);
+        }
+    }
+
+    void CheckStatisticsMatch(const DrawListStatistics& statistics, const MockCommandList& commandList)
+    {
+        Check(statistics.DrawCount == commandList.Draws.size());
+        Check(statistics.InstanceCount == commandList.InstanceCount());
+        Check(statistics.PipelineStateChanges == commandList.PipelineStateCalls);
+        Check(statistics.VertexBufferChanges == commandList.VertexBufferCalls);
+        Check(statistics.IndexBufferChanges == commandList.IndexBufferCalls);
+        Check(statistics.RootConstantChanges == commandList.RootConstantCalls);
+        Check(statistics.InstanceBufferChanges == commandList.InstanceBufferCalls);
+    }
+}
+
+TEST(DrawList, PacketsAreSortedStably)
+{
+    std::vector<DrawPacket> packets =
+    {
+        MakePacket(1, 0, 0, 0, 0),
+        MakePacket(0, 1, 1, 1, 0),
+        MakePacket(0, 0, 2, 2, 3),
+        MakePacket(0, 0, 3, 3, 3),
+        MakePacket(0, 0, 4, 4, 1),
+    };
+    DrawList list(DrawListPass::Opaque, packets, MakeNodes(5), 5);
+
+    uint32_t expectedOrder[] = { 4, 2, 3, 1, 0 };
+    Require(list.Packets().size() == std::size(expectedOrder));
+    for (size_t i = 0; i < std::size(expectedOrder); i++)
+    { Check(list.Packets()[i].PrimitiveIndex == expectedOrder[i]); }
+}
+
+TEST(DrawList, SubmitSkipsRedundantState)
+{
+    // Same pipeline, mesh, and node with a material change in the middle
+    DrawList list(DrawListPass::Opaque, { MakePacket(0, 0, 0, 0, 0), MakePacket(0, 0, 0, 1, 0), MakePacket(0, 0, 0, 2, 1) }, MakeNodes(1), 3);
+
+    MockCommandList commandList;
+    DrawListStatistics statistics = list.Submit(&commandList);
+    CheckStatisticsMatch(statistics, commandList);
+
+    Check(statistics.DrawCount == 3);
+    Check(statistics.PipelineStateChanges == 1);
+    Check(statistics.VertexBufferChanges == 3); // Position, normal, and UV once each
+    Check(statistics.IndexBufferChanges == 1);
+    Check(statistics.RootConstantChanges == 2); // The whole node once, then only the per-primitive tail for the material change
+
+    for (size_t i = 0; i < commandList.Draws.size(); i++)
+    { CheckDrawState(list, commandList.Draws[i], list.Packets()[i], 0); }
+}
+
+TEST(DrawList, DepthPrePassDoesNotBindNormals)
+{
+    DrawList list(DrawListPass::DepthPrePass, { MakePacket(0, 0, 0, 0, 0), MakePacket(0, 1, 0, 1, 0) }, MakeNodes(1), 2);
+
+    MockCommandList commandList;
+    DrawListStatistics statistics = list.Submit(&commandList);
+    CheckStatisticsMatch(statistics, commandList);
+    Check(statistics.VertexBufferChanges == 4); // Positions and UVs for both meshes
+    Check(commandList.VertexBuffers[MeshInputSlot::Normal].BufferLocation == 0);
+}
+
+TEST(DrawList, InvisiblePrimitivesAreSkipped)
+{
+    std::vector<DrawPacket> packets;
+    for (uint32_t i = 0; i < 8; i++)
+    { packets.push_back(MakePacket(i % 2, i % 3, i, i, 0)); }
+    DrawList list(DrawListPass::Opaque, packets, MakeNodes(8), 8);
+
+    std::vector<uint8_t> visibility(8, 0);
+    MockCommandList nothingVisible;
+    DrawListStatistics statistics = list.Submit(&nothingVisible, visibility);
+    CheckStatisticsMatch(statistics, nothingVisible);
+    Check(statistics.DrawCount == 0);
+    Check(statistics.PipelineStateChanges == 0);
+    Check(statistics.RootConstantChanges == 0);
+
+    visibility[3] = 1;
+    visibility[6] = 1;
+    MockCommandList twoVisible;
+    statistics = list.Submit(&twoVisible, visibility);
+    CheckStatisticsMatch(statistics, twoVisible);
+    Require(twoVisible.Draws.size() == 2);
+    Check(twoVisible.Draws[0].PerNode.Transform.m30 == 6.f); // Pipeline 0 sorts first
+    Check(twoVisible.Draws[1].PerNode.Transform.m30 == 3.f);
+}
+
+TEST(DrawList, NonIndexedPrimitivesDrawVertices)
+{
+    DrawPacket packet = MakePacket(0, 0, 0, 0, 0);
+    packet.IsIndexed = false;
+    packet.VertexOrIndexCount = 36;
+    DrawList list(DrawListPass::Opaque, { packet }, MakeNodes(1), 1);
+
+    MockCommandList commandList;
+    DrawListStatistics statistics = list.Submit(&commandList);
+    CheckStatisticsMatch(statistics, commandList);
+    Check(statistics.IndexBufferChanges == 0);
+    Require(commandList.Draws.size() == 1);
+    Check(!commandList.Draws[0].IsIndexed);
+    Check(commandList.Draws[0].VertexOrIndexCount == 36);
+}
+
+TEST(DrawList, LodsSwitchIndexBuffers)
+{
+    // Two primitives of the same mesh with two LODs each
+    std::vector<MeshLod> lods =
+    {
+        { .Indices = FakeIndexBuffer(0, 1), .IndexCount = IndexCount / 2, .Error = 0.1f },
+        { .Indices = FakeIndexBuffer(0, 2), .IndexCount = IndexCount / 4, .Error = 0.4f },
+    };
+    DrawPacket a = MakePacket(0, 0, 0, 0, 0);
+    DrawPacket b = MakePacket(0, 0, 1, 1, 0);
+    a.LodCount = b.LodCount = 2;
+    DrawList list(DrawListPass::Opaque, { a, b }, MakeNodes(2), 2, lods);
+
+    std::vector<uint8_t> primitiveLods = { 2, 2 };
+    MockCommandList sameLod;
+    DrawListStatistics statistics = list.Submit(&sameLod, AllVisible, primitiveLods);
+    CheckStatisticsMatch(statistics, sameLod);
+    Check(statistics.IndexBufferChanges == 1);
+    Require(sameLod.Draws.size() == 2);
+    Check(sameLod.Draws[0].VertexOrIndexCount == IndexCount / 4);
+    Check(sameLod.Draws[1].VertexOrIndexCount == IndexCount / 4);
+
+    primitiveLods = { 0, 1 };
+    MockCommandList differentLods;
+    statistics = list.Submit(&differentLods, AllVisible, primitiveLods);
+    CheckStatisticsMatch(statistics, differentLods);
+    Check(statistics.IndexBufferChanges == 2);
+    Require(differentLods.Draws.size() == 2);
+    CheckDrawState(list, differentLods.Draws[0], list.Packets()[0], 0);
+    CheckDrawState(list, differentLods.Draws[1], list.Packets()[1], 1);
+}
+
+TEST(DrawList, ClusterCulledPrimitivesDrawSurvivingRanges)
+{
+    DrawList list(DrawListPass::Opaque, { MakePacket(0, 0, 0, 0, 0), MakePacket(0, 1, 0, 1, 0), MakePacket(0, 2, 0, 2, 0) }, MakeNodes(1), 3);
+
+    // Primitive 0 isn't cluster culled, primitive 1 has two surviving ranges, and primitive 2 has none
+    ClusterDrawSet clusterDraws =
+    {
+        .PrimitiveFirstDraw = { 0, 0, 2 },
+        .PrimitiveDrawCount = { ClusterDrawSet::NotClusterCulled, 2, 0 },
+        .Draws = { { .FirstIndex = 0, .IndexCount = 30 }, { .FirstIndex = 90, .IndexCount = 60 } },
+    };
+
+    MockCommandList commandList;
+    DrawListStatistics statistics = list.Submit(&commandList, AllVisible, { }, &clusterDraws);
+    CheckStatisticsMatch(statistics, commandList);
+    Require(commandList.Draws.size() == 3);
+    Check(commandList.Draws[0].VertexOrIndexCount == IndexCount);
+    Check(commandList.Draws[1].StartIndex == 0 && commandList.Draws[1].VertexOrIndexCount == 30);
+    Check(commandList.Draws[2].StartIndex == 90 && commandList.Draws[2].VertexOrIndexCount == 60);
+    Check(SameView(commandList.Draws[2].VertexBuffers[MeshInputSlot::Position], FakeVertexBuffer(1, 0)));
+    // Primitive 2 was skipped entirely, so its vertex buffers were never bound
+    Check(statistics.VertexBufferChanges == 6);
+}
+
+TEST(DrawList, RandomSubmissionsMatchPacketState)
+{
+    std::mt19937 random(1234);
+    const uint32_t packetCount = 500;
+    const uint32_t nodeCount = 40;
+
+    std::vector<MeshLod> lods;
+    std::vector<DrawPacket> packets;
+    for (uint32_t i = 0; i < packetCount; i++)
+    {
+        uint32_t mesh = random() % 12;
+        DrawPacket packet = MakePacket(random() % 4, mesh, random() % nodeCount, i, random() % 6);
+        packet.IsIndexed = random() % 8 != 0;
+        packet.FirstLod = (uint32_t)lods.size();
+        packet.LodCount = packet.IsIndexed ? random() % 4 : 0;
+        for (uint32_t lod = 1; lod <= packet.LodCount; lod++)
+        { lods.push_back({ .Indices = FakeIndexBuffer(mesh, lod), .IndexCount = IndexCount >> lod, .Error = (float)lod }); }
+        packets.push_back(packet);
+    }
+
+    for (DrawListPass pass : { DrawListPass::DepthPrePass, DrawListPass::Opaque })
+    {
+        DrawList list(pass, packets, MakeNodes(nodeCount), packetCount, lods);
+
+        for (uint32_t iteration = 0; iteration < 20; iteration++)
+        {
+            std::vector<uint8_t> visibility(packetCount);
+            std::vector<uint8_t> primitiveLods(packetCount, 0);
+            for (const DrawPacket& packet : list.Packets())
+            {
+                visibility[packet.PrimitiveIndex] = random() % 4 != 0;
+                primitiveLods[packet.PrimitiveIndex] = (uint8_t)(random() % (packet.LodCount + 1));
+            }
+
+            // Every chunk is recorded on its own command list, so each one must bind all of its own state
+            DrawListStatistics total = { };
+            for (DrawListChunk chunk : list.Chunks(1 + iteration % 6, 16))
+            {
+                MockCommandList commandList;
+                DrawListStatistics statistics = list.Submit(&commandList, chunk, visibility, primitiveLods);
+                CheckStatisticsMatch(statistics, commandList);
+                total.DrawCount += statistics.DrawCount;
+
+                size_t drawIndex = 0;
+                for (const DrawPacket& packet : list.Packets().subspan(chunk.First, chunk.Count))
+                {
+                    if (!visibility[packet.PrimitiveIndex])
+                    { continue; }
+
+                    Require(drawIndex < commandList.Draws.size());
+                    CheckDrawState(list, commandList.Draws[drawIndex], packet, primitiveLods[packet.PrimitiveIndex]);
+                    drawIndex++;
+                }
+                Check(drawIndex == commandList.Draws.size());
+            }
+
+            uint32_t visibleCount = (uint32_t)std::count(visibility.begin(), visibility.end(), 1);
+            Check(total.DrawCount == visibleCount);
+        }
+    }
+}
+
+TEST(DrawList, ChunksPartitionTheList)
+{
+    std::mt19937 random(31);
+    for (uint32_t iteration = 0; iteration < 200; iteration++)
+    {
+        // Runs of packets sharing a pipeline state, like a sorted list
+        uint32_t packetCount = random() % 2000;
+        std::vector<DrawPacket> packets(packetCount);
+        uint32_t pipeline = 0;
+        for (DrawPacket& packet : packets)
+        {
+            if (random() % 40 == 0)
+            { pipeline++; }
+            packet.PipelineState = FakePipelineState(pipeline);
+        }
+
+        uint32_t maxChunkCount = 1 + random() % 16;
+        uint32_t minChunkSize = random() % 64;
+        std::vector<DrawListChunk> chunks = DrawList::Chunks(packets, maxChunkCount, minChunkSize);
+
+        Require(!chunks.empty());
+        Check(chunks.size() <= maxChunkCount);
+        if (minChunkSize > 0)
+        { Check(chunks.size() == 1 || packetCount / chunks.size() >= minChunkSize); }
+
+        // Contiguous, in order, and covering every packet exactly once
+        uint32_t next = 0;
+        for (const DrawListChunk& chunk : chunks)
+        {
+            Check(chunk.First == next);
+            Check(chunk.Count > 0 || packetCount == 0);
+            next += chunk.Count;
+        }
+        Check(next == packetCount);
+
+        // Boundaries are only nudged a quarter of a chunk, so no chunk gets much bigger than the ideal size
+        if (chunks.size() > 1)
+        {
+            uint32_t idealChunkSize = packetCount / (uint32_t)chunks.size();
+            for (const DrawListChunk& chunk : chunks)
+            { Check(chunk.Count <= idealChunkSize * 2 + chunks.size()); }
+        }
+    }
+}
+
+TEST(DrawList, ChunksPreferPipelineStateChanges)
+{
+    // 4 pipeline states of 100 packets each split into 4 chunks should split exactly on the pipeline state changes when they're a little after the ideal boundaries
+    std::vector<DrawPacket> packets(400);
+    for (uint32_t i = 0; i < packets.size(); i++)
+    { packets[i].PipelineState = FakePipelineState(i < 10 ? 0 : (i - 10) / 100); }
+
+    std::vector<DrawListChunk> chunks = DrawList::Chunks(packets, 4, 1);
+    Require(chunks.size() == 4);
+    for (size_t i = 1; i < chunks.size(); i++)
+    { Check(packets[chunks[i].First].PipelineState != packets[chunks[i].First - 1].PipelineState); }
+}
+
+TEST(DrawList, ParallelChunksMatchSerialSubmission)
+{
+    // Mirrors how Main records the scene passes: each chunk is recorded on a worker into its own command list and the lists are executed in chunk order
+    std::mt19937 random(311);
+    const uint32_t packetCount = 3000;
+    std::vector<DrawPacket> packets;
+    for (uint32_t i = 0; i < packetCount; i++)
+    { packets.push_back(MakePacket(random() % 5, random() % 20, random() % 50, i, random() % 8)); }
+    DrawList list(DrawListPass::Opaque, packets, MakeNodes(50), packetCount);
+
+    std::vector<uint8_t> visibility(packetCount);
+    for (uint8_t& visible : visibility)
+    { visible = random() % 3 != 0; }
+
+    MockCommandList serial;
+    list.Submit(&serial, visibility);
+
+    JobSystem jobs(4);
+    std::vector<DrawListChunk> chunks = list.Chunks(jobs.WorkerCount() + 1, 64);
+    std::vector<MockCommandList> commandLists(chunks.size());
+    jobs.ParallelFor((uint32_t)chunks.size(), [&](uint32_t i) { list.Submit(&commandLists[i], chunks[i], visibility); });
+
+    // Redundant state filtering restarts at each chunk, but the draws themselves (and the state they see) must be identical
+    std::vector<MockCommandList::Draw> parallelDraws;
+    for (const MockCommandList& commandList : commandLists)
+    { parallelDraws.insert(parallelDraws.end(), commandList.Draws.begin(), commandList.Draws.end()); }
+
+    Require(parallelDraws.size() == serial.Draws.size());
+    uint32_t mismatchCount = 0;
+    for (size_t i = 0; i < parallelDraws.size(); i++)
+    { mismatchCount += memcmp(&parallelDraws[i], &serial.Draws[i], sizeof(MockCommandList::Draw)) != 0 ? 1 : 0; }
+    Check(mismatchCount == 0);
+}
@@ -0,0 +1,238 @@
+#include "pch.h"
+#include "FenceReactor.h"
+#include "TestFramework.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <random>
+
+namespace
+{
+    class SoftwareWaiter;
+
+    //! A fence signaled from the CPU, stands in for an ID3D12Fence
+    class SoftwareFence : public ReactorFence
+    {
+    private:
+        std::atomic<uint64_t> m_Value = 0;
+        SoftwareWaiter& m_Waiter;
+
+    public:
+        SoftwareFence(SoftwareWaiter& waiter)
+            : m_Waiter(waiter)
+        { }
+
+        uint64_t CompletedValue() const override { return m_Value.load(); }
+
+        //! Fences never go backwards, signaling a lower value than the current one does nothing
+        void Signal(uint64_t value);
+    };
+
+    //! Waits on a condition variable which is notified whenever a fence is signaled
+    class SoftwareWaiter : public ReactorWaiter
+    {
+    public:
+        std::mutex Lock;
+        std::condition_variable Changed;
+        bool IsWoken = false;
+
+        void WaitForAny(std::span<const ReactorFence* const> fences, std::span<const uint64_t> values) override
+        {
+            std::unique_lock<std::mutex> guard(Lock);
+            Changed.wait(guard, [&]()
+                {
+                    if (IsWoken)
+                    { return true; }
+
+                    for (size_t i = 0; i < fences.size(); i++)
+                    {
+                        if (fences[i]->CompletedValue() >= values[i])
+                        { return true; }
+                    }
+                    return false;
+                });
+            IsWoken = false;
+        }
+
+        void Wake() override
+        {
+            {
+                std::lock_guard<std::mutex> guard(Lock);
+                IsWoken = true;
+            }
+            Changed.notify_all();
+        }
+    };
+
+    void SoftwareFence::Signal(uint64_t value)
+    {
+        {
+            std::lock_guard<std::mutex> guard(m_Waiter.Lock);
+            uint64_t current = m_Value.load();
+            while (current < value && !m_Value.compare_exchange_weak(current, value))
+            { }
+        }
+        m_Waiter.Changed.notify_all();
+    }
+
+    //! A log of callbacks which can be waited on from the test's thread
+    class CallbackLog
+    {
+    private:
+        std::mutex m_Lock;
+        std::condition_variable m_Changed;
+        std::vector<int> m_Entries;
+
+    public:
+        std::function<void()> Append(int entry)
+        {
+            return [this, entry]()
+                {
+                    {
+                        std::lock_guard<std::mutex> guard(m_Lock);
+                        m_Entries.push_back(entry);
+                    }
+                    m_Changed.notify_all();
+                };
+        }
+
+        //! Returns the entries once there are at least count of them, or after a generous timeout so that a broken reactor fails rather than hangs
+        std::vector<int> WaitFor(size_t count)
+        {
+            std::unique_lock<std::mutex> guard(m_Lock);
+            m_Changed.wait_for(guard, std::chrono::seconds(10), [&]() { return m_Entries.size() >= count; });
+            return m_Entries;
+        }
+
+        std::vector<int> Entries()
+        {
+            std::lock_guard<std::mutex> guard(m_Lock);
+            return m_Entries;
+        }
+    };
+}
+
+TEST(FenceReactor, RunsCallbacksInFenceValueOrder)
+{
+    SoftwareWaiter waiter;
+    SoftwareFence a(waiter);
+    SoftwareFence b(waiter);
+    CallbackLog log;
+
+    FenceReactor reactor(waiter);
+    reactor.Then(a, 3, log.Append(3));
+    reactor.Then(a, 1, log.Append(1));
+    reactor.Then(a, 3, log.Append(4));
+    reactor.Then(a, 2, log.Append(2));
+    reactor.Then(b, 1, log.Append(10));
+
+    // Nothing has been signaled, give the reactor a chance to misbehave
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    Check(log.Entries().empty());
+
+    a.Signal(2);
+    Check(log.WaitFor(2) == std::vector<int>({ 1, 2 }));
+
+    reactor.Post(log.Append(99));
+    Check(log.WaitFor(3) == std::vector<int>({ 1, 2, 99 }));
+
+    // Callbacks with the same value run in the order they were registered
+    a.Signal(5);
+    Check(log.WaitFor(5) == std::vector<int>({ 1, 2, 99, 3, 4 }));
+
+    b.Signal(1);
+    Check(log.WaitFor(6) == std::vector<int>({ 1, 2, 99, 3, 4, 10 }));
+}
+
+TEST(FenceReactor, ReachedValuesRunImmediately)
+{
+    SoftwareWaiter waiter;
+    SoftwareFence fence(waiter);
+    fence.Signal(7);
+    CallbackLog log;
+
+    FenceReactor reactor(waiter);
+    reactor.Then(fence, 0, log.Append(0));
+    reactor.Then(fence, 7, log.Append(7));
+    Check(log.WaitFor(2) == std::vector<int>({ 0, 7 }));
+}
+
+TEST(FenceReactor, DestructorWaitsForEveryCallback)
+{
+    SoftwareWaiter waiter;
+    SoftwareFence a(waiter);
+    SoftwareFence b(waiter);
+    CallbackLog log;
+    std::thread signaler;
+    {
+        FenceReactor reactor(waiter);
+        reactor.Then(a, 5, log.Append(5));
+
+        // Callbacks may register more callbacks, even while the reactor is shutting down
+        reactor.Then(b, 1, [&]() { reactor.Then(b, 2, log.Append(12)); });
+        reactor.Then(b, 1, log.Append(11));
+
+        signaler = std::thread([&]()
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(50));
+                a.Signal(5);
+                b.Signal(2);
+            });
+    }
+
+    std::vector<int> entries = log.Entries();
+    std::sort(entries.begin(), entries.end());
+    Check(entries == std::vector<int>({ 5, 11, 12 }));
+    signaler.join();
+}
+
+TEST(FenceReactor, ConcurrentProducers)
+{
+    // Many threads register callbacks and signal fences at once, every callback must run exactly once and never before its value
+    SoftwareWaiter waiter;
+    const uint32_t fenceCount = 4;
+    const uint32_t threadCount = 4;
+    const uint32_t callbacksPerThread = 20000;
+    std::vector<std::unique_ptr<SoftwareFence>> fences;
+    for (uint32_t i = 0; i < fenceCount; i++)
+    { fences.push_back(std::make_unique<SoftwareFence>(waiter)); }
+
+    std::atomic<uint32_t> runCount = 0;
+    std::atomic<uint32_t> earlyCount = 0;
+    {
+        FenceReactor reactor(waiter);
+        std::vector<std::thread> producers;
+        for (uint32_t t = 0; t < threadCount; t++)
+        {
+            producers.emplace_back([&, t]()
+                {
+                    std::mt19937 random(t);
+                    for (uint32_t i = 0; i < callbacksPerThread; i++)
+                    {
+                        uint32_t f = random() % fenceCount;
+                        SoftwareFence& fence = *fences[f];
+                        uint64_t value = fence.CompletedValue() + random() % 8;
+                        reactor.Then(fence, value, [&, f, value]()
+                            {
+                                runCount++;
+                                if (fences[f]->CompletedValue() < value)
+                                { earlyCount++; }
+                            });
+
+                        if (random() % 16 == 0)
+                        { fence.Signal(fence.CompletedValue() + 1); }
+                    }
+                });
+        }
+
+        for (std::thread& producer : producers)
+        { producer.join(); }
+
+        for (std::unique_ptr<SoftwareFence>& fence : fences)
+        { fence->Signal(UINT32_MAX); }
+    }
+
+    Check(runCount == threadCount * callbacksPerThread);
+    Check(earlyCount == 0);
+}
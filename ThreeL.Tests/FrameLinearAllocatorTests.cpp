@@ -0,0 +1,132 @@
+#include "pch.h"
+#include "FrameLinearAllocator.h"
+#include "TestFramework.h"
+
+#include <map>
+#include <random>
+#include <thread>
+
+TEST(FrameLinearAllocator, AllocatesAlignedFromEachFramesRegion)
+{
+    const uint64_t capacity = 64 * 1024;
+    FrameLinearAllocator allocator(capacity, 3);
+    Check(allocator.BufferSize() == capacity * 3);
+
+    Check(allocator.BeginFrame() == 0);
+    Check(allocator.Allocate(224) == 0);
+    Check(allocator.Allocate(1) == 256);
+    Check(allocator.Allocate(256) == 512);
+    Check(allocator.FrameUsage() == 768);
+
+    // Peak usage is only updated once a frame ends
+    Check(allocator.PeakFrameUsage() == 0);
+    Check(allocator.BeginFrame() == 1);
+    Check(allocator.PeakFrameUsage() == 768);
+    Check(allocator.FrameUsage() == 0);
+
+    // Filling a region exactly is fine, anything past it fails without affecting the reported usage
+    Check(allocator.Allocate(capacity) == capacity);
+    Check(allocator.Allocate(1) == FrameLinearAllocator::NoAllocation);
+    Check(allocator.Allocate(capacity) == FrameLinearAllocator::NoAllocation);
+    Check(allocator.FrameUsage() == capacity);
+
+    Check(allocator.BeginFrame() == 2);
+    Check(allocator.PeakFrameUsage() == capacity);
+    Check(allocator.Allocate(5) == 2 * capacity);
+
+    // Wraps back around to the first region
+    Check(allocator.BeginFrame() == 0);
+    Check(allocator.Allocate(5) == 0);
+}
+
+TEST(FrameLinearAllocator, NeverOverlapsFramesInFlight)
+{
+    // Each frame's allocations are read until the frame's fence completes frameCount - 1 frames later, which is what BeginFrame's caller waits for
+    const uint32_t frameCount = 3;
+    const uint64_t capacity = 64 * 1024;
+    FrameLinearAllocator allocator(capacity, frameCount);
+    std::mt19937 random(3);
+
+    // Offset -> (end, frame)
+    std::map<uint64_t, std::pair<uint64_t, uint64_t>> live;
+    uint32_t overlapCount = 0;
+    uint32_t failureCount = 0;
+    for (uint64_t frame = 0; frame < 5000; frame++)
+    {
+        allocator.BeginFrame();
+        std::erase_if(live, [&](const auto& entry) { return entry.second.second + frameCount <= frame; });
+
+        uint32_t allocationCount = random() % 100;
+        for (uint32_t i = 0; i < allocationCount; i++)
+        {
+            uint64_t size = 1 + random() % 2000;
+            uint64_t offset = allocator.Allocate(size);
+            if (offset == FrameLinearAllocator::NoAllocation)
+            {
+                failureCount++;
+                break;
+            }
+
+            Check(offset % FrameLinearAllocator::Alignment == 0);
+            Require(offset + size <= allocator.BufferSize());
+
+            // Allocations stay inside the current frame's region
+            Check(offset / capacity == allocator.CurrentFrame() && (offset + size - 1) / capacity == allocator.CurrentFrame());
+
+            auto next = live.lower_bound(offset);
+            if (next != live.end() && next->first < offset + size)
+            { overlapCount++; }
+            if (next != live.begin() && std::prev(next)->second.first > offset)
+            { overlapCount++; }
+            live[offset] = { offset + size, frame };
+        }
+    }
+
+    Check(overlapCount == 0);
+    Check(failureCount > 0);
+    Check(allocator.PeakFrameUsage() <= capacity);
+}
+
+TEST(FrameLinearAllocator, ConcurrentAllocations)
+{
+    const uint64_t capacity = 1 << 20;
+    const uint32_t threadCount = 4;
+    FrameLinearAllocator allocator(capacity, 2);
+    for (uint32_t frame = 0; frame < 2; frame++)
+    {
+        allocator.BeginFrame();
+
+        // The second frame asks for more than fits, so some allocations must fail while the rest stay in bounds
+        const uint32_t allocationsPerThread = frame == 0 ? 1000 : 2000;
+        std::vector<std::vector<uint64_t>> offsets(threadCount);
+        std::vector<std::thread> threads;
+        for (uint32_t t = 0; t < threadCount; t++)
+        {
+            threads.emplace_back([&, t]()
+                {
+                    for (uint32_t i = 0; i < allocationsPerThread; i++)
+                    {
+                        uint64_t offset = allocator.Allocate(100);
+                        if (offset != FrameLinearAllocator::NoAllocation)
+                        { offsets[t].push_back(offset); }
+                    }
+                });
+        }
+
+        for (std::thread& thread : threads)
+        { thread.join(); }
+
+        std::vector<uint64_t> all;
+        for (const std::vector<uint64_t>& threadOffsets : offsets)
+        { all.insert(all.end(), threadOffsets.begin(), threadOffsets.end()); }
+        std::sort(all.begin(), all.end());
+
+        // Every allocation got its own aligned slot and the slots are packed together from the start of the region
+        Require(!all.empty());
+        Check(all.size() == std::min<uint64_t>(threadCount * allocationsPerThread, capacity / FrameLinearAllocator::Alignment));
+        Check(all.front() == frame * capacity);
+        for (size_t i = 1; i < all.size(); i++)
+        { Check(all[i] - all[i - 1] == FrameLinearAllocator::Alignment); }
+        Check(all.back() + 100 <= (frame + 1) * capacity);
+    }
+}
@@ -0,0 +1,143 @@
+#include "pch.h"
+#include "HeapSuballocator.h"
+#include "TestFramework.h"
+
+#include <map>
+#include <random>
+
+namespace
+{
+    const uint64_t KB = 1024;
+    const uint64_t MB = 1024 * KB;
+}
+
+TEST(HeapSuballocator, AlignmentPaddingIsReused)
+{
+    HeapSuballocator heap(64 * MB, 4 * KB);
+    HeapSuballocation a, b, c;
+    Require(heap.TryAllocate(4 * KB, 4 * KB, &a));
+    Check(a.Offset == 0);
+
+    // The padding between 4K and 64K becomes a free block...
+    Require(heap.TryAllocate(64 * KB, 64 * KB, &b));
+    Check(b.Offset == 64 * KB);
+    Check(heap.Statistics().FreeBlockCount == 2);
+
+    // ...which a later allocation fills exactly
+    Require(heap.TryAllocate(60 * KB, 4 * KB, &c));
+    Check(c.Offset == 4 * KB);
+    Check(heap.Statistics().FreeBlockCount == 1);
+    Check(heap.AllocationCount() == 3);
+    Check(heap.UsedBytes() == 128 * KB);
+}
+
+TEST(HeapSuballocator, FreedBlocksMerge)
+{
+    HeapSuballocator heap(64 * MB, 4 * KB);
+    HeapSuballocation a, b, c;
+    Require(heap.TryAllocate(4 * KB, 4 * KB, &a));
+    Require(heap.TryAllocate(64 * KB, 64 * KB, &b));
+    Require(heap.TryAllocate(60 * KB, 4 * KB, &c));
+
+    // Freeing the middle allocation last has to merge with free blocks on both sides
+    heap.Free(a.Block);
+    heap.Free(b.Block);
+    Check(heap.Statistics().FreeBlockCount == 2);
+    Check(heap.Statistics().Fragmentation() > 0.f);
+    heap.Free(c.Block);
+
+    HeapSuballocatorStatistics statistics = heap.Statistics();
+    Check(heap.IsEmpty());
+    Check(statistics.UsedBytes == 0);
+    Check(statistics.FreeBlockCount == 1);
+    Check(statistics.LargestFreeBlock == 64 * MB);
+    Check(statistics.Fragmentation() == 0.f);
+
+    // The whole heap can be allocated again
+    Require(heap.TryAllocate(64 * MB, 64 * KB, &a));
+    Check(a.Offset == 0);
+    Check(!heap.TryAllocate(4 * KB, 4 * KB, &b));
+    Check(heap.Statistics().Fragmentation() == 0.f);
+    heap.Free(a.Block);
+}
+
+TEST(HeapSuballocator, SizesRoundUpToTheGranularity)
+{
+    HeapSuballocator heap(64 * MB, 4 * KB);
+    HeapSuballocation allocation;
+    Check(!heap.TryAllocate(65 * MB, 4 * KB, &allocation));
+
+    Require(heap.TryAllocate(1, 4 * KB, &allocation));
+    Check(heap.AllocationSize(allocation.Block) == 4 * KB);
+    Check(heap.UsedBytes() == 4 * KB);
+    heap.Free(allocation.Block);
+
+    Require(heap.TryAllocate(4 * KB + 1, 4 * KB, &allocation));
+    Check(heap.AllocationSize(allocation.Block) == 8 * KB);
+}
+
+TEST(HeapSuballocator, RandomAllocations)
+{
+    // Shadows the live allocations in an interval map to catch overlaps, and checks the statistics against it
+    for (uint64_t capacity : { 4 * MB, 64 * MB, 256 * MB + 12 * KB })
+    {
+        std::mt19937_64 random(capacity);
+        HeapSuballocator heap(capacity, 4 * KB);
+
+        // Offset -> (size, block)
+        std::map<uint64_t, std::pair<uint64_t, uint32_t>> live;
+        uint32_t overlapCount = 0;
+        for (uint32_t i = 0; i < 100000; i++)
+        {
+            if (live.empty() || random() % 100 < 52)
+            {
+                uint64_t size = random() % 4 == 0 ? 1 + random() % (2 * MB) : 1 + random() % (128 * KB);
+                uint64_t alignment = random() % 50 == 0 ? 4 * MB : random() % 2 == 0 ? 64 * KB : 4 * KB;
+                HeapSuballocation allocation;
+                if (!heap.TryAllocate(size, alignment, &allocation))
+                { continue; }
+
+                Check(allocation.Offset % alignment == 0);
+                uint64_t allocationSize = heap.AllocationSize(allocation.Block);
+                Check(allocationSize >= size && allocationSize - size < 4 * KB);
+                Require(allocation.Offset + allocationSize <= capacity);
+
+                auto next = live.lower_bound(allocation.Offset);
+                if (next != live.end() && next->first < allocation.Offset + allocationSize)
+                { overlapCount++; }
+                if (next != live.begin() && std::prev(next)->first + std::prev(next)->second.first > allocation.Offset)
+                { overlapCount++; }
+                live[allocation.Offset] = { allocationSize, allocation.Block };
+            }
+            else
+            {
+                auto it = live.begin();
+                std::advance(it, random() % live.size());
+                heap.Free(it->second.second);
+                live.erase(it);
+            }
+
+            if (i % 1000 == 0)
+            {
+                uint64_t usedBytes = 0;
+                for (const auto& [offset, entry] : live)
+                { usedBytes += entry.first; }
+
+                HeapSuballocatorStatistics statistics = heap.Statistics();
+                Check(statistics.UsedBytes == usedBytes);
+                Check(statistics.AllocationCount == live.size());
+                Check(statistics.LargestFreeBlock <= capacity - usedBytes);
+            }
+        }
+
+        Check(overlapCount == 0);
+
+        for (const auto& [offset, entry] : live)
+        { heap.Free(entry.second); }
+
+        HeapSuballocatorStatistics statistics = heap.Statistics();
+        Check(statistics.UsedBytes == 0);
+        Check(statistics.FreeBlockCount == 1);
+        Check(statistics.LargestFreeBlock == capacity);
+    }
+}
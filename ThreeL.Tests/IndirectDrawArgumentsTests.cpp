@@ -0,0 +1,304 @@
+#include "pch.h"
+#include "IndirectDrawArguments.h"
+#include "TestFramework.h"
+
+#include <random>
+
+namespace
+{
+    ID3D12PipelineState* FakePipelineState(uint32_t pipeline)
+    { return reinterpret_cast<ID3D12PipelineState*>((uintptr_t)(pipeline + 1) * 256); }
+
+    // Packets are made sorted by pipeline state like a DrawList's
+    std::vector<DrawPacket> MakeSortedPackets(std::mt19937& random, uint32_t count, uint32_t pipelineCount, uint32_t nodeCount)
+    {
+        std::vector<DrawPacket> packets(count);
+        for (uint32_t i = 0; i < count; i++)
+        {
+            packets[i] =
+            {
+                .PipelineState = FakePipelineState((uint32_t)((uint64_t)i * pipelineCount / count)),
+                .Positions = { .BufferLocation = 0x10000 * (uint64_t)(random() % 16), .SizeInBytes = 0x10000, .StrideInBytes = 12 },
+                .Normals = { .BufferLocation = 0x2000000 + 0x10000 * (uint64_t)(random() % 16), .SizeInBytes = 0x10000, .StrideInBytes = 12 },
+                .Uvs = { .BufferLocation = 0x4000000 + 0x10000 * (uint64_t)(random() % 16), .SizeInBytes = 0x10000, .StrideInBytes = 8 },
+                .Indices = { .BufferLocation = 0x8000000 + 0x10000 * (uint64_t)i, .SizeInBytes = 0x10000 },
+                .NodeIndex = random() % nodeCount,
+                .PrimitiveIndex = i,
+                .MaterialId = random() % 32,
+                .ColorsIndex = random() % 2 == 0 ? BUFFER_DISABLED : i,
+                .TangentsIndex = i + 1000,
+                .VertexOrIndexCount = 3 * (1 + random() % 1000),
+                .IsIndexed = random() % 10 != 0,
+                .BoundsCenter = float3((float)i, 0.f, 0.f),
+                .BoundsExtents = float3(1.f, 2.f, 3.f),
+            };
+        }
+        return packets;
+    }
+
+    std::vector<ShaderInterop::PerNodeCb> MakeNodes(uint32_t count)
+    {
+        std::vector<ShaderInterop::PerNodeCb> nodes(count);
+        for (uint32_t i = 0; i < count; i++)
+        {
+            nodes[i].Transform = float4x4(1.f);
+            nodes[i].Transform.m30 = (float)i;
+            nodes[i].NormalTransform = float3x3(1.f);
+            // Garbage which must be replaced by the packet's values
+            nodes[i].MaterialId = nodes[i].ColorsIndex = nodes[i].TangentsIndex = 0xDEADBEEF;
+        }
+        return nodes;
+    }
+
+    bool SameRecord(const ShaderInterop::IndirectDrawRecord& a, const ShaderInterop::IndirectDrawRecord& b)
+    { return memcmp(&a, &b, sizeof(a)) == 0; }
+
+    // Emulates SelectLod in SceneCulling.cs.hlsl
+    uint32_t SelectLod(const IndirectDrawArguments::Arguments& arguments, const ShaderInterop::IndirectDrawCullingInfo& info, float3 eyePosition, float pixelsPerUnit, float maxPixelError)
+    {
+        if (maxPixelError <= 0.f)
+        { return 0; }
+
+        float3 offset = eyePosition - info.BoundsCenter;
+        offset = float3(std::abs(offset.x), std::abs(offset.y), std::abs(offset.z)) - info.BoundsExtents;
+        offset = float3(std::max(offset.x, 0.f), std::max(offset.y, 0.f), std::max(offset.z, 0.f));
+        float distance = offset.Length();
+
+        for (uint32_t i = info.LodCount; i > 0; i--)
+        {
+            if (arguments.Lods[info.FirstLod + i - 1].Error * pixelsPerUnit <= maxPixelError * distance)
+            { return i; }
+        }
+
+        return 0;
+    }
+
+    // Emulates the end of MainCull in SceneCulling.cs.hlsl, which patches the record as raw bytes using these offsets
+    ShaderInterop::IndirectDrawRecord PatchLod(const IndirectDrawArguments::Arguments& arguments, uint32_t recordIndex, uint32_t lod)
+    {
+        ShaderInterop::IndirectDrawRecord record = arguments.Records[recordIndex];
+        if (lod > 0)
+        {
+            const ShaderInterop::IndirectDrawLod& meshLod = arguments.Lods[arguments.CullingInfo[recordIndex].FirstLod + lod - 1];
+            uint8_t* bytes = reinterpret_cast<uint8_t*>(&record);
+            memcpy(bytes + 48, &meshLod.Indices, 16);
+            memcpy(bytes + 188, &meshLod.IndexCount, 4);
+        }
+        return record;
+    }
+}
+
+TEST(IndirectDrawArguments, RecordsMatchPackets)
+{
+    std::mt19937 random(30);
+    std::vector<DrawPacket> packets = MakeSortedPackets(random, 300, 5, 20);
+    std::vector<ShaderInterop::PerNodeCb> nodes = MakeNodes(20);
+    IndirectDrawArguments::Arguments arguments = IndirectDrawArguments::Build(packets, nodes);
+
+    Require(arguments.Records.size() == arguments.CullingInfo.size());
+    Check(arguments.Records.size() + arguments.UnindexedPackets.size() == packets.size());
+
+    // Records keep the order of the indexed packets
+    uint32_t recordIndex = 0;
+    for (const DrawPacket& packet : packets)
+    {
+        if (!packet.IsIndexed)
+        { continue; }
+
+        Require(recordIndex < arguments.Records.size());
+        const ShaderInterop::IndirectDrawRecord& record = arguments.Records[recordIndex];
+        Check(memcmp(&record.Positions, &packet.Positions, sizeof(packet.Positions)) == 0);
+        Check(memcmp(&record.Normals, &packet.Normals, sizeof(packet.Normals)) == 0);
+        Check(memcmp(&record.Uvs, &packet.Uvs, sizeof(packet.Uvs)) == 0);
+        Check(memcmp(&record.Indices, &packet.Indices, sizeof(packet.Indices)) == 0);
+
+        const ShaderInterop::PerNodeCb& node = nodes[packet.NodeIndex];
+        Check(memcmp(&record.PerNode.Transform, &node.Transform, sizeof(node.Transform)) == 0);
+        Check(memcmp(&record.PerNode.NormalTransform, &node.NormalTransform, sizeof(node.NormalTransform)) == 0);
+        Check(record.PerNode.MaterialId == packet.MaterialId);
+        Check(record.PerNode.ColorsIndex == packet.ColorsIndex);
+        Check(record.PerNode.TangentsIndex == packet.TangentsIndex);
+
+        Check(record.Draw.IndexCountPerInstance == packet.VertexOrIndexCount);
+        Check(record.Draw.InstanceCount == 1);
+        Check(record.Draw.StartIndexLocation == 0);
+        Check(record.Draw.BaseVertexLocation == 0);
+        Check(record.Draw.StartInstanceLocation == 0);
+
+        const ShaderInterop::IndirectDrawCullingInfo& cullingInfo = arguments.CullingInfo[recordIndex];
+        Check(memcmp(&cullingInfo.BoundsCenter, &packet.BoundsCenter, sizeof(float3)) == 0);
+        Check(memcmp(&cullingInfo.BoundsExtents, &packet.BoundsExtents, sizeof(float3)) == 0);
+        recordIndex++;
+    }
+
+    for (const DrawPacket& packet : arguments.UnindexedPackets)
+    { Check(!packet.IsIndexed); }
+}
+
+TEST(IndirectDrawArguments, BucketsPartitionRecordsByPipelineState)
+{
+    std::mt19937 random(31);
+    for (uint32_t pipelineCount : { 1u, 2u, 7u, 40u })
+    {
+        std::vector<DrawPacket> packets = MakeSortedPackets(random, 200, pipelineCount, 8);
+        IndirectDrawArguments::Arguments arguments = IndirectDrawArguments::Build(packets, MakeNodes(8));
+
+        // Buckets are contiguous, non-empty, in order, and cover every record
+        uint32_t next = 0;
+        for (uint32_t i = 0; i < arguments.Buckets.size(); i++)
+        {
+            const IndirectDrawArguments::Bucket& bucket = arguments.Buckets[i];
+            Check(bucket.First == next);
+            Check(bucket.Count > 0);
+            next += bucket.Count;
+
+            for (uint32_t j = bucket.First; j < bucket.First + bucket.Count; j++)
+            {
+                Check(arguments.CullingInfo[j].BucketIndex == i);
+                Check(arguments.CullingInfo[j].BucketFirst == bucket.First);
+            }
+
+            for (uint32_t j = i + 1; j < arguments.Buckets.size(); j++)
+            { Check(arguments.Buckets[j].PipelineState != bucket.PipelineState); }
+        }
+        Check(next == arguments.Records.size());
+        Check(arguments.Buckets.size() <= pipelineCount);
+    }
+}
+
+TEST(IndirectDrawArguments, OnlyUnindexedPackets)
+{
+    std::mt19937 random(32);
+    std::vector<DrawPacket> packets = MakeSortedPackets(random, 10, 2, 1);
+    for (DrawPacket& packet : packets)
+    { packet.IsIndexed = false; }
+
+    IndirectDrawArguments::Arguments arguments = IndirectDrawArguments::Build(packets, MakeNodes(1));
+    Check(arguments.Records.empty());
+    Check(arguments.CullingInfo.empty());
+    Check(arguments.Buckets.empty());
+    Check(arguments.UnindexedPackets.size() == packets.size());
+}
+
+TEST(IndirectDrawArguments, CompactionStaysWithinBuckets)
+{
+    // Emulates MainCull in SceneCulling.cs.hlsl: visible records are appended to their bucket's range using a per-bucket counter
+    std::mt19937 random(33);
+    std::vector<DrawPacket> packets = MakeSortedPackets(random, 500, 6, 10);
+    IndirectDrawArguments::Arguments arguments = IndirectDrawArguments::Build(packets, MakeNodes(10));
+
+    for (uint32_t iteration = 0; iteration < 10; iteration++)
+    {
+        std::vector<ShaderInterop::IndirectDrawRecord> culledRecords(arguments.Records.size());
+        std::vector<uint8_t> written(arguments.Records.size(), 0);
+        std::vector<uint32_t> bucketCounts(arguments.Buckets.size(), 0);
+        std::vector<uint32_t> visibleRecords;
+
+        // Visit the records in a random order since GPU threads can reach the atomic in any order
+        std::vector<uint32_t> order(arguments.Records.size());
+        for (uint32_t i = 0; i < order.size(); i++)
+        { order[i] = i; }
+        std::shuffle(order.begin(), order.end(), random);
+
+        for (uint32_t i : order)
+        {
+            if (random() % 3 == 0)
+            { continue; }
+
+            visibleRecords.push_back(i);
+            const ShaderInterop::IndirectDrawCullingInfo& info = arguments.CullingInfo[i];
+            uint32_t slot = bucketCounts[info.BucketIndex]++;
+            uint32_t destination = info.BucketFirst + slot;
+            Require(destination < culledRecords.size());
+            Check(written[destination] == 0);
+            written[destination] = 1;
+            culledRecords[destination] = arguments.Records[i];
+        }
+
+        // Each ExecuteIndirect reads bucket.First + [0, count), which must be exactly the bucket's visible records
+        for (uint32_t bucketIndex = 0; bucketIndex < arguments.Buckets.size(); bucketIndex++)
+        {
+            const IndirectDrawArguments::Bucket& bucket = arguments.Buckets[bucketIndex];
+            Check(bucketCounts[bucketIndex] <= bucket.Count);
+
+            for (uint32_t visible : visibleRecords)
+            {
+                if (arguments.CullingInfo[visible].BucketIndex != bucketIndex)
+                { continue; }
+
+                bool found = false;
+                for (uint32_t j = bucket.First; j < bucket.First + bucketCounts[bucketIndex]; j++)
+                { found |= SameRecord(culledRecords[j], arguments.Records[visible]); }
+                Check(found);
+            }
+        }
+    }
+}
+
+TEST(IndirectDrawArguments, LodSelectionMatchesDrawList)
+{
+    // Every primitive has its own LODs with growing errors (and some have none)
+    std::mt19937 random(34);
+    std::vector<DrawPacket> packets = MakeSortedPackets(random, 200, 4, 10);
+    std::vector<MeshLod> lods;
+    for (DrawPacket& packet : packets)
+    {
+        packet.BoundsCenter = float3((float)(random() % 200) - 100.f, (float)(random() % 20), (float)(random() % 200) - 100.f);
+        packet.FirstLod = (uint32_t)lods.size();
+        packet.LodCount = random() % (MeshPrimitive::MaxLodCount + 1);
+        float error = 0.f;
+        for (uint32_t i = 0; i < packet.LodCount; i++)
+        {
+            error += 0.001f * (float)(1 + random() % 100);
+            lods.push_back
+            ({
+                .Indices = { .BufferLocation = 0x90000000 + 0x10000 * (uint64_t)lods.size(), .SizeInBytes = 0x8000, .Format = DXGI_FORMAT_R32_UINT },
+                .IndexCount = 3 * (1 + random() % 100),
+                .Error = error,
+            });
+        }
+    }
+
+    DrawList list(DrawListPass::Opaque, packets, MakeNodes(10), (uint32_t)packets.size(), lods);
+    IndirectDrawArguments::Arguments arguments = IndirectDrawArguments::Build(list.Packets(), list.Nodes(), list.Lods());
+    Require(arguments.Lods.size() == lods.size());
+
+    std::vector<uint8_t> primitiveLods(list.PrimitiveCount());
+    uint32_t lodCounts[MeshPrimitive::MaxLodCount + 1] = { };
+    for (uint32_t iteration = 0; iteration < 50; iteration++)
+    {
+        float3 eyePosition((float)(random() % 400) - 200.f, (float)(random() % 50), (float)(random() % 400) - 200.f);
+        float pixelsPerUnit = 500.f + (float)(random() % 1000);
+        float maxPixelError = iteration % 10 == 0 ? 0.f : 0.25f * (float)(1 + random() % 32);
+        if (maxPixelError > 0.f)
+        { list.SelectLods(eyePosition, pixelsPerUnit, maxPixelError, primitiveLods); }
+        else
+        { std::fill(primitiveLods.begin(), primitiveLods.end(), (uint8_t)0); }
+
+        uint32_t recordIndex = 0;
+        for (const DrawPacket& packet : list.Packets())
+        {
+            if (!packet.IsIndexed)
+            { continue; }
+
+            uint32_t lod = SelectLod(arguments, arguments.CullingInfo[recordIndex], eyePosition, pixelsPerUnit, maxPixelError);
+            lodCounts[lod]++;
+            Check(lod == primitiveLods[packet.PrimitiveIndex]);
+
+            ShaderInterop::IndirectDrawRecord record = PatchLod(arguments, recordIndex, lod);
+            auto [indices, indexCount] = list.LodIndices(packet, lod);
+            Check(memcmp(&record.Indices, indices, sizeof(*indices)) == 0);
+            Check(record.Draw.IndexCountPerInstance == indexCount);
+
+            // Everything else is the same for every LOD
+            Check(memcmp(&record.Positions, &arguments.Records[recordIndex].Positions, offsetof(ShaderInterop::IndirectDrawRecord, Indices)) == 0);
+            Check(memcmp(&record.PerNode, &arguments.Records[recordIndex].PerNode, sizeof(record.PerNode)) == 0);
+            Check(record.Draw.InstanceCount == 1 && record.Draw.StartIndexLocation == 0 && record.Draw.BaseVertexLocation == 0);
+            recordIndex++;
+        }
+    }
+
+    // Make sure the scenes actually exercised every LOD
+    for (uint32_t count : lodCounts)
+    { Check(count > 0); }
+}
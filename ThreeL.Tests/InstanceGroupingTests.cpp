@@ -0,0 +1,177 @@
+#include "pch.h"
+#include "InstanceGrouping.h"
+#include "TestFramework.h"
+
+#include <algorithm>
+#include <random>
+
+namespace
+{
+    // None of these are ever dereferenced, they only need to be distinct
+    ID3D12PipelineState* FakePipelineState(uint32_t pipeline)
+    { return reinterpret_cast<ID3D12PipelineState*>((uintptr_t)(pipeline + 1) * 256); }
+
+    DrawPacket MakePacket(uint32_t pipeline, uint32_t mesh, uint32_t node, uint32_t material)
+    {
+        return
+        {
+            .PipelineState = FakePipelineState(pipeline),
+            .Positions = { .BufferLocation = 0x100000 * (uint64_t)(mesh + 1), .SizeInBytes = 0x10000, .StrideInBytes = 12 },
+            .Normals = { .BufferLocation = 0x100000 * (uint64_t)(mesh + 1) + 0x10000, .SizeInBytes = 0x10000, .StrideInBytes = 12 },
+            .Uvs = { .BufferLocation = 0x100000 * (uint64_t)(mesh + 1) + 0x20000, .SizeInBytes = 0x10000, .StrideInBytes = 8 },
+            .Indices = { .BufferLocation = 0x80000000 + 0x100000 * (uint64_t)mesh, .SizeInBytes = 0x10000 },
+            .NodeIndex = node,
+            .PrimitiveIndex = node,
+            .MaterialId = material,
+            .ColorsIndex = BUFFER_DISABLED,
+            .TangentsIndex = mesh,
+            .VertexOrIndexCount = 300,
+            .IsIndexed = true,
+        };
+    }
+
+    // Everything InstancedDrawList draws a whole group with
+    bool SharesState(const DrawPacket& a, const DrawPacket& b)
+    {
+        return a.PipelineState == b.PipelineState
+            && memcmp(&a.Positions, &b.Positions, sizeof(a.Positions)) == 0
+            && memcmp(&a.Normals, &b.Normals, sizeof(a.Normals)) == 0
+            && memcmp(&a.Uvs, &b.Uvs, sizeof(a.Uvs)) == 0
+            && memcmp(&a.Indices, &b.Indices, sizeof(a.Indices)) == 0
+            && a.MaterialId == b.MaterialId
+            && a.ColorsIndex == b.ColorsIndex
+            && a.TangentsIndex == b.TangentsIndex
+            && a.VertexOrIndexCount == b.VertexOrIndexCount
+            && a.IsIndexed == b.IsIndexed;
+    }
+
+    // Checks everything Build promises about its result
+    void CheckGrouping(std::span<const DrawPacket> packets, const InstanceGrouping& grouping)
+    {
+        // Every packet is drawn by exactly one instance
+        Require(grouping.InstancePackets.size() == packets.size());
+        std::vector<uint32_t> sortedPackets = grouping.InstancePackets;
+        std::sort(sortedPackets.begin(), sortedPackets.end());
+        for (uint32_t i = 0; i < sortedPackets.size(); i++)
+        { Check(sortedPackets[i] == i); }
+
+        uint32_t nextInstance = 0;
+        for (uint32_t groupIndex = 0; groupIndex < grouping.Groups.size(); groupIndex++)
+        {
+            const InstanceGroup& group = grouping.Groups[groupIndex];
+            Require(group.InstanceCount > 0);
+            Require(group.FirstInstance == nextInstance);
+            nextInstance += group.InstanceCount;
+            Require(nextInstance <= grouping.InstancePackets.size());
+
+            // Groups are ordered by their first packet, which is also their first instance
+            Check(grouping.InstancePackets[group.FirstInstance] == group.FirstPacket);
+            if (groupIndex > 0)
+            { Check(group.FirstPacket > grouping.Groups[groupIndex - 1].FirstPacket); }
+
+            for (uint32_t instance = group.FirstInstance; instance < group.FirstInstance + group.InstanceCount; instance++)
+            {
+                uint32_t packet = grouping.InstancePackets[instance];
+                Check(SharesState(packets[packet], packets[group.FirstPacket]));
+                if (instance > group.FirstInstance)
+                { Check(packet > grouping.InstancePackets[instance - 1]); }
+            }
+
+            // Groups are as large as possible
+            for (uint32_t other = 0; other < groupIndex; other++)
+            { Check(!SharesState(packets[grouping.Groups[other].FirstPacket], packets[group.FirstPacket])); }
+        }
+        Check(nextInstance == grouping.InstancePackets.size());
+    }
+}
+
+TEST(InstanceGrouping, Empty)
+{
+    InstanceGrouping grouping = InstanceGrouping::Build({ });
+    Check(grouping.Groups.empty());
+    Check(grouping.InstancePackets.empty());
+}
+
+TEST(InstanceGrouping, NodesSharingMeshes)
+{
+    // Seven nodes referencing three meshes in no particular order
+    std::vector<DrawPacket> packets;
+    const uint32_t meshes[] = { 0, 1, 0, 2, 1, 0, 2 };
+    for (uint32_t node = 0; node < std::size(meshes); node++)
+    { packets.push_back(MakePacket(0, meshes[node], node, 0)); }
+
+    InstanceGrouping grouping = InstanceGrouping::Build(packets);
+    CheckGrouping(packets, grouping);
+    Require(grouping.Groups.size() == 3);
+    Check(grouping.Groups[0].FirstPacket == 0 && grouping.Groups[0].FirstInstance == 0 && grouping.Groups[0].InstanceCount == 3);
+    Check(grouping.Groups[1].FirstPacket == 1 && grouping.Groups[1].FirstInstance == 3 && grouping.Groups[1].InstanceCount == 2);
+    Check(grouping.Groups[2].FirstPacket == 3 && grouping.Groups[2].FirstInstance == 5 && grouping.Groups[2].InstanceCount == 2);
+    Check(grouping.InstancePackets == std::vector<uint32_t>({ 0, 2, 5, 1, 4, 3, 6 }));
+}
+
+TEST(InstanceGrouping, AnySharedStateDifferenceSplitsGroups)
+{
+    std::vector<void(*)(DrawPacket&)> differences =
+    {
+        [](DrawPacket& packet) { packet.PipelineState = FakePipelineState(1); },
+        [](DrawPacket& packet) { packet.Positions.BufferLocation += 0x1000; },
+        [](DrawPacket& packet) { packet.Positions.SizeInBytes -= 12; },
+        [](DrawPacket& packet) { packet.Normals.BufferLocation += 0x1000; },
+        [](DrawPacket& packet) { packet.Uvs.StrideInBytes = 16; },
+        [](DrawPacket& packet) { packet.Indices.BufferLocation += 0x1000; },
+        [](DrawPacket& packet) { packet.Indices.SizeInBytes -= 4; },
+        [](DrawPacket& packet) { packet.MaterialId++; },
+        [](DrawPacket& packet) { packet.ColorsIndex = 7; },
+        [](DrawPacket& packet) { packet.TangentsIndex++; },
+        [](DrawPacket& packet) { packet.VertexOrIndexCount -= 3; },
+        [](DrawPacket& packet) { packet.IsIndexed = false; },
+    };
+
+    for (auto difference : differences)
+    {
+        DrawPacket packets[3] = { MakePacket(0, 0, 0, 0), MakePacket(0, 0, 1, 0), MakePacket(0, 0, 2, 0) };
+        difference(packets[1]);
+        InstanceGrouping grouping = InstanceGrouping::Build(packets);
+        CheckGrouping(packets, grouping);
+        Require(grouping.Groups.size() == 2);
+        Check(grouping.InstancePackets == std::vector<uint32_t>({ 0, 2, 1 }));
+    }
+}
+
+TEST(InstanceGrouping, NodeSpecificStateDoesNotSplitGroups)
+{
+    // Transforms and bounds come from the instance buffer, so they don't need to match
+    DrawPacket packets[2] = { MakePacket(0, 0, 0, 0), MakePacket(0, 0, 5, 0) };
+    packets[1].SortKey = 123;
+    packets[1].PrimitiveIndex = 9;
+    packets[1].BoundsCenter = float3(10.f, 20.f, 30.f);
+    packets[1].BoundsExtents = float3(1.f, 2.f, 3.f);
+    InstanceGrouping grouping = InstanceGrouping::Build(packets);
+    CheckGrouping(packets, grouping);
+    Check(grouping.Groups.size() == 1);
+}
+
+TEST(InstanceGrouping, Randomized)
+{
+    std::mt19937 random(1);
+    for (uint32_t trial = 0; trial < 100; trial++)
+    {
+        uint32_t packetCount = std::uniform_int_distribution<uint32_t>(0, 500)(random);
+        uint32_t meshCount = std::uniform_int_distribution<uint32_t>(1, 40)(random);
+        std::vector<DrawPacket> packets;
+        for (uint32_t i = 0; i < packetCount; i++)
+        { packets.push_back(MakePacket(random() % 3, random() % meshCount, i, random() % 4)); }
+
+        // Sorting like DrawList does gives runs of identical state, which is the common case
+        if (trial % 2 == 0)
+        { std::stable_sort(packets.begin(), packets.end(), [](const DrawPacket& a, const DrawPacket& b) { return a.Positions.BufferLocation < b.Positions.BufferLocation; }); }
+
+        InstanceGrouping grouping = InstanceGrouping::Build(packets);
+        CheckGrouping(packets, grouping);
+
+        // The grouping depends only on the packets
+        InstanceGrouping again = InstanceGrouping::Build(std::vector<DrawPacket>(packets));
+        Require(again.Groups.size() == grouping.Groups.size());
+        Check(again.InstancePackets == grouping.InstancePackets);
+    }
+}
@@ -0,0 +1,242 @@
+#include "pch.h"
+#include "JobGraph.h"
+#include "JobSystem.h"
+#include "TestFramework.h"
+
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <thread>
+
+namespace
+{
+    struct RandomGraph
+    {
+        JobGraph Graph;
+        std::vector<std::vector<JobId>> Dependencies;
+    };
+
+    // Each job depends on up to maxDependencies random earlier jobs, biased towards recent ones so that there are long chains as well as wide fans
+    void AddRandomJobs(std::mt19937& random, RandomGraph& graph, uint32_t jobCount, uint32_t maxDependencies, const std::function<JobGraph::Job(JobId)>& makeJob)
+    {
+        for (JobId id = 0; id < jobCount; id++)
+        {
+            std::vector<JobId> dependencies;
+            uint32_t dependencyCount = id == 0 ? 0 : random() % (maxDependencies + 1);
+            for (uint32_t i = 0; i < dependencyCount; i++)
+            {
+                JobId dependency = id - 1 - (JobId)(random() % std::min(id, 16u));
+                if (std::find(dependencies.begin(), dependencies.end(), dependency) == dependencies.end())
+                { dependencies.push_back(dependency); }
+            }
+
+            Check(graph.Graph.Add(std::format("job {}", id), dependencies, makeJob(id)) == id);
+            graph.Dependencies.push_back(std::move(dependencies));
+        }
+    }
+}
+
+TEST(JobGraph, Empty)
+{
+    JobSystem jobs(2);
+    JobGraph graph;
+    JobGraphResult result = graph.Run(jobs);
+    Check(result.Succeeded());
+    Check(result.Statuses.empty());
+}
+
+TEST(JobGraph, RunsJobsAfterTheirDependencies)
+{
+    std::mt19937 random(1);
+    for (uint32_t workerCount : { 0, 1, 5 })
+    {
+        JobSystem jobs(workerCount);
+        const uint32_t jobCount = 300;
+
+        // Every start and finish gets a ticket from one counter, so a job started after a dependency finished iff its start ticket is higher
+        std::atomic<uint32_t> ticket = 0;
+        std::vector<uint32_t> startTickets(jobCount);
+        std::vector<uint32_t> finishTickets(jobCount);
+        std::vector<std::atomic<uint32_t>> runCounts(jobCount);
+
+        // No two running jobs may share a thread index
+        std::vector<std::atomic<bool>> threadInUse(workerCount + 1);
+        std::atomic<uint32_t> threadIndexViolations = 0;
+
+        RandomGraph graph;
+        AddRandomJobs(random, graph, jobCount, 3, [&](JobId id)
+            {
+                return [&, id](JobContext& context)
+                    {
+                        if (context.ThreadIndex > workerCount || threadInUse[context.ThreadIndex].exchange(true))
+                        {
+                            threadIndexViolations++;
+                            return;
+                        }
+
+                        startTickets[id] = ticket++;
+                        runCounts[id]++;
+                        if (id % 7 == 0)
+                        { std::this_thread::sleep_for(std::chrono::microseconds(200)); }
+                        finishTickets[id] = ticket++;
+
+                        threadInUse[context.ThreadIndex] = false;
+                    };
+            });
+
+        // Running twice checks the graph doesn't keep any state between runs
+        for (uint32_t run = 1; run <= 2; run++)
+        {
+            JobGraphResult result = graph.Graph.Run(jobs);
+            Check(result.Succeeded());
+            Check(threadIndexViolations == 0);
+            Require(result.Statuses.size() == jobCount);
+            for (JobId id = 0; id < jobCount; id++)
+            {
+                Check(result.Statuses[id] == JobStatus::Succeeded);
+                Check(runCounts[id] == run);
+                for (JobId dependency : graph.Dependencies[id])
+                { Check(finishTickets[dependency] < startTickets[id]); }
+            }
+        }
+    }
+}
+
+TEST(JobGraph, ReadyJobsStartInTheOrderTheyWereAdded)
+{
+    // With a single thread the run order is fully determined by the graph
+    JobSystem jobs(0);
+    JobGraph graph;
+    std::vector<JobId> order;
+    auto Record = [&](JobId id) { return [&, id](JobContext&) { order.push_back(id); }; };
+
+    JobId a = graph.Add("a", { }, Record(0));
+    JobId b = graph.Add("b", { }, Record(1));
+    JobId c = graph.Add("c", { b }, Record(2));
+    graph.Add("d", { a }, Record(3));
+    graph.Add("e", { }, Record(4));
+    graph.Add("f", { c, a }, Record(5));
+    graph.Run(jobs);
+
+    // a, b, and e are ready up-front. c and d become ready after b and a, but both come before e
+    std::vector<JobId> expected = { 0, 1, 2, 3, 4, 5 };
+    Check(order == expected);
+}
+
+TEST(JobGraph, FailuresSkipEverythingDownstream)
+{
+    for (uint32_t workerCount : { 0, 3 })
+    {
+        JobSystem jobs(workerCount);
+        JobGraph graph;
+        std::vector<std::atomic<bool>> ran(8);
+        auto Job = [&](JobId id, bool fail)
+            {
+                return [&, id, fail](JobContext& context)
+                    {
+                        ran[id] = true;
+                        if (fail)
+                        { context.Error = std::format("job {} broke", id); }
+                    };
+            };
+
+        JobId a = graph.Add("a", { }, Job(0, false));
+        JobId b = graph.Add("b", { }, Job(1, true));
+        JobId c = graph.Add("c", { a }, Job(2, false));
+        JobId d = graph.Add("d", { b, c }, Job(3, false));
+        JobId e = graph.Add("e", { d }, Job(4, false));
+        JobId f = graph.Add("f", { }, Job(5, true));
+        JobId g = graph.Add("g", { a, c }, Job(6, false));
+        graph.Add("h", { e, g }, Job(7, false));
+
+        JobGraphResult result = graph.Run(jobs);
+        Check(!result.Succeeded());
+
+        const JobStatus expected[] =
+        {
+            JobStatus::Succeeded, JobStatus::Failed, JobStatus::Succeeded, JobStatus::Skipped,
+            JobStatus::Skipped, JobStatus::Failed, JobStatus::Succeeded, JobStatus::Skipped,
+        };
+        Require(result.Statuses.size() == std::size(expected));
+        for (JobId id = 0; id < std::size(expected); id++)
+        {
+            Check(result.Statuses[id] == expected[id]);
+            Check(ran[id] == (expected[id] != JobStatus::Skipped));
+            if (expected[id] == JobStatus::Skipped)
+            { Check(result.Seconds[id] == 0.0); }
+        }
+
+        // Errors are reported in the order the jobs were added no matter which failed first
+        Require(result.Errors.size() == 2);
+        Check(result.Errors[0].Job == b && result.Errors[0].Message == "job 1 broke");
+        Check(result.Errors[1].Job == f && result.Errors[1].Message == "job 5 broke");
+    }
+}
+
+TEST(JobGraph, RandomFailures)
+{
+    std::mt19937 random(2);
+    JobSystem jobs(4);
+    const uint32_t jobCount = 200;
+    std::vector<bool> fails(jobCount);
+    std::vector<std::atomic<bool>> ran(jobCount);
+    for (uint32_t i = 0; i < jobCount; i++)
+    { fails[i] = random() % 25 == 0; }
+
+    RandomGraph graph;
+    AddRandomJobs(random, graph, jobCount, 2, [&](JobId id)
+        {
+            return [&, id](JobContext& context)
+                {
+                    ran[id] = true;
+                    if (fails[id])
+                    { context.Error = "failed"; }
+                };
+        });
+
+    JobGraphResult result = graph.Graph.Run(jobs);
+
+    // A job is skipped iff any of its dependencies failed or was skipped
+    uint32_t failedCount = 0;
+    for (JobId id = 0; id < jobCount; id++)
+    {
+        bool isSkipped = false;
+        for (JobId dependency : graph.Dependencies[id])
+        { isSkipped |= result.Statuses[dependency] != JobStatus::Succeeded; }
+
+        JobStatus expected = isSkipped ? JobStatus::Skipped : fails[id] ? JobStatus::Failed : JobStatus::Succeeded;
+        Check(result.Statuses[id] == expected);
+        Check(ran[id] == !isSkipped);
+        failedCount += expected == JobStatus::Failed;
+    }
+
+    Check(result.Errors.size() == failedCount);
+    for (size_t i = 1; i < result.Errors.size(); i++)
+    { Check(result.Errors[i - 1].Job < result.Errors[i].Job); }
+}
+
+TEST(JobGraph, IndependentJobsRunInParallel)
+{
+    // Every job waits for all of the others to start, which only finishes if they all run at once
+    const uint32_t jobCount = 4;
+    JobSystem jobs(jobCount - 1);
+    JobGraph graph;
+    std::atomic<uint32_t> startedCount = 0;
+    for (uint32_t i = 0; i < jobCount; i++)
+    {
+        graph.Add("wait", { }, [&](JobContext& context)
+            {
+                startedCount++;
+                auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+                while (startedCount < jobCount && std::chrono::steady_clock::now() < deadline)
+                { std::this_thread::yield(); }
+
+                if (startedCount < jobCount)
+                { context.Error = "The other jobs never started"; }
+            });
+    }
+
+    JobGraphResult result = graph.Run(jobs);
+    Check(result.Succeeded());
+    Check(result.TotalSeconds < 10.0);
+}
@@ -0,0 +1,79 @@
+#include "pch.h"
+#include "JobSystem.h"
+#include "TestFramework.h"
+
+#include <atomic>
+#include <mutex>
+#include <set>
+
+TEST(JobSystem, EveryJobRunsExactlyOnce)
+{
+    for (uint32_t workerCount : { 0u, 1u, 3u, 8u })
+    {
+        JobSystem jobs(workerCount);
+        Check(jobs.WorkerCount() == workerCount);
+
+        for (uint32_t jobCount : { 0u, 1u, 2u, 7u, 64u, 1000u })
+        {
+            std::vector<std::atomic<uint32_t>> runCounts(jobCount);
+            jobs.ParallelFor(jobCount, [&](uint32_t i) { runCounts[i]++; });
+
+            for (uint32_t i = 0; i < jobCount; i++)
+            { Check(runCounts[i] == 1); }
+        }
+    }
+}
+
+TEST(JobSystem, ResultsAreVisibleAfterReturning)
+{
+    // Jobs write plain memory, ParallelFor returning must mean every write happened (and is visible to the caller)
+    JobSystem jobs(4);
+    std::vector<uint32_t> results(4096);
+    for (uint32_t iteration = 0; iteration < 50; iteration++)
+    {
+        jobs.ParallelFor((uint32_t)results.size(), [&](uint32_t i) { results[i] = i * iteration; });
+
+        uint32_t wrongCount = 0;
+        for (uint32_t i = 0; i < results.size(); i++)
+        { wrongCount += results[i] != i * iteration ? 1 : 0; }
+        Check(wrongCount == 0);
+    }
+}
+
+TEST(JobSystem, ManySmallBatches)
+{
+    // Back to back batches are where a worker waking up late could pick up the wrong job or miss one entirely
+    JobSystem jobs(6);
+    uint64_t expectedSum = 0;
+    std::atomic<uint64_t> sum = 0;
+    for (uint32_t batch = 0; batch < 5000; batch++)
+    {
+        uint32_t jobCount = 2 + batch % 9;
+        jobs.ParallelFor(jobCount, [&](uint32_t i) { sum += (uint64_t)batch * 16 + i; });
+
+        for (uint32_t i = 0; i < jobCount; i++)
+        { expectedSum += (uint64_t)batch * 16 + i; }
+        Require(sum == expectedSum);
+    }
+}
+
+TEST(JobSystem, CallingThreadParticipates)
+{
+    // With no workers everything runs inline on the calling thread
+    JobSystem noWorkers(0);
+    std::thread::id caller = std::this_thread::get_id();
+    bool allOnCaller = true;
+    noWorkers.ParallelFor(16, [&](uint32_t) { allOnCaller &= std::this_thread::get_id() == caller; });
+    Check(allOnCaller);
+
+    // With workers the jobs should still only ever run on the pool's threads plus the caller
+    JobSystem jobs(3);
+    std::mutex lock;
+    std::set<std::thread::id> threads;
+    jobs.ParallelFor(2000, [&](uint32_t)
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            threads.insert(std::this_thread::get_id());
+        });
+    Check(threads.size() >= 1 && threads.size() <= jobs.WorkerCount() + 1);
+}
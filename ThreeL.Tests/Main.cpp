@@ -0,0 +1,63 @@
+#include "pch.h"
+#include "TestFramework.h"
+
+#include <algorithm>
+
+static std::vector<TestCase>& Tests()
+{
+    // Function local so that registration doesn't depend on static initialization order
+    static std::vector<TestCase> tests;
+    return tests;
+}
+
+static uint32_t g_CurrentFailureCount = 0;
+
+void RegisterTest(const TestCase& test)
+{
+    Tests().push_back(test);
+}
+
+void ReportCheckFailure(const char* condition, const char* fileName, int lineNumber)
+{
+    printf("    Check '%s' failed at %s:%d\n", condition, fileName, lineNumber);
+    g_CurrentFailureCount++;
+}
+
+// Usage: ThreeL.Tests [filter]
+// Only tests whose Suite.Name contain the filter are run when one is specified
+int main(int argc, char** argv)
+{
+    const char* filter = argc > 1 ? argv[1] : nullptr;
+
+    std::vector<TestCase>& tests = Tests();
+    std::stable_sort(tests.begin(), tests.end(), [](const TestCase& a, const TestCase& b)
+        {
+            return strcmp(a.Suite, b.Suite) < 0;
+        });
+
+    uint32_t passedCount = 0;
+    uint32_t failedCount = 0;
+    for (const TestCase& test : tests)
+    {
+        std::string fullName = std::string(test.Suite) + "." + test.Name;
+        if (filter != nullptr && fullName.find(filter) == std::string::npos)
+        { continue; }
+
+        printf("%s\n", fullName.c_str());
+        g_CurrentFailureCount = 0;
+        test.Function();
+
+        if (g_CurrentFailureCount == 0)
+        {
+            passedCount++;
+        }
+        else
+        {
+            printf("    FAILED (%u checks)\n", g_CurrentFailureCount);
+            failedCount++;
+        }
+    }
+
+    printf("%u passed, %u failed\n", passedCount, failedCount);
+    return failedCount == 0 ? 0 : 1;
+}
@@ -0,0 +1,242 @@
+#include "pch.h"
+#include "MeshSimplifier.h"
+#include "TestFramework.h"
+
+#include <algorithm>
+#include <unordered_set>
+
+namespace
+{
+    struct Mesh
+    {
+        std::vector<float3> Positions;
+        std::vector<float3> Normals;
+        std::vector<uint32_t> Indices;
+    };
+
+    // A flat grid in the XZ plane facing up
+    Mesh MakeGrid(uint32_t size)
+    {
+        Mesh mesh;
+        for (uint32_t y = 0; y <= size; y++)
+        {
+            for (uint32_t x = 0; x <= size; x++)
+            {
+                mesh.Positions.push_back(float3((float)x, 0.f, (float)y));
+                mesh.Normals.push_back(float3(0.f, 1.f, 0.f));
+            }
+        }
+
+        for (uint32_t y = 0; y < size; y++)
+        {
+            for (uint32_t x = 0; x < size; x++)
+            {
+                uint32_t a = y * (size + 1) + x;
+                uint32_t b = a + 1;
+                uint32_t c = a + size + 1;
+                uint32_t d = c + 1;
+                mesh.Indices.insert(mesh.Indices.end(), { a, c, b, b, c, d });
+            }
+        }
+        return mesh;
+    }
+
+    // A bumpy UV sphere, which has a seam where longitude wraps around and many vertices at each pole
+    Mesh MakeBumpySphere(uint32_t rings, uint32_t segments)
+    {
+        Mesh mesh;
+        for (uint32_t ring = 0; ring <= rings; ring++)
+        {
+            for (uint32_t segment = 0; segment <= segments; segment++)
+            {
+                float theta = Math::Pi * (float)ring / (float)rings;
+                float phi = Math::TwoPi * (float)segment / (float)segments;
+                float3 normal(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi));
+                float bump = 1.f + 0.05f * std::sin(5.f * phi) * std::sin(4.f * theta);
+                mesh.Positions.push_back(normal * bump);
+                mesh.Normals.push_back(normal);
+            }
+        }
+
+        for (uint32_t ring = 0; ring < rings; ring++)
+        {
+            for (uint32_t segment = 0; segment < segments; segment++)
+            {
+                uint32_t a = ring * (segments + 1) + segment;
+                uint32_t b = a + 1;
+                uint32_t c = a + segments + 1;
+                uint32_t d = c + 1;
+
+                // The first and last rings each have one degenerate triangle per quad since all of their vertices are at the poles
+                if (ring > 0)
+                { mesh.Indices.insert(mesh.Indices.end(), { a, b, c }); }
+                if (ring < rings - 1)
+                { mesh.Indices.insert(mesh.Indices.end(), { b, d, c }); }
+            }
+        }
+        return mesh;
+    }
+
+    float3 TriangleNormal(std::span<const float3> positions, const uint32_t* triangle)
+    { return (positions[triangle[1]] - positions[triangle[0]]).Cross(positions[triangle[2]] - positions[triangle[0]]); }
+
+    // Closest point on a triangle, from Real-Time Collision Detection by Christer Ericson
+    float3 ClosestPointOnTriangle(float3 p, float3 a, float3 b, float3 c)
+    {
+        float3 ab = b - a;
+        float3 ac = c - a;
+        float3 ap = p - a;
+        float d1 = ab.Dot(ap);
+        float d2 = ac.Dot(ap);
+        if (d1 <= 0.f && d2 <= 0.f)
+        { return a; }
+
+        float3 bp = p - b;
+        float d3 = ab.Dot(bp);
+        float d4 = ac.Dot(bp);
+        if (d3 >= 0.f && d4 <= d3)
+        { return b; }
+
+        float vc = d1 * d4 - d3 * d2;
+        if (vc <= 0.f && d1 >= 0.f && d3 <= 0.f)
+        { return a + ab * (d1 / (d1 - d3)); }
+
+        float3 cp = p - c;
+        float d5 = ab.Dot(cp);
+        float d6 = ac.Dot(cp);
+        if (d6 >= 0.f && d5 <= d6)
+        { return c; }
+
+        float vb = d5 * d2 - d1 * d6;
+        if (vb <= 0.f && d2 >= 0.f && d6 <= 0.f)
+        { return a + ac * (d2 / (d2 - d6)); }
+
+        float va = d3 * d6 - d5 * d4;
+        if (va <= 0.f && (d4 - d3) >= 0.f && (d5 - d6) >= 0.f)
+        { return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6))); }
+
+        float denominator = 1.f / (va + vb + vc);
+        return a + ab * (vb * denominator) + ac * (vc * denominator);
+    }
+
+    // The largest distance from any of the original vertices to the simplified surface
+    float MeasureError(const Mesh& mesh, std::span<const uint32_t> simplifiedIndices)
+    {
+        float largest = 0.f;
+        for (float3 position : mesh.Positions)
+        {
+            float nearest = std::numeric_limits<float>::infinity();
+            for (size_t i = 0; i < simplifiedIndices.size(); i += 3)
+            {
+                float3 closest = ClosestPointOnTriangle(position, mesh.Positions[simplifiedIndices[i]], mesh.Positions[simplifiedIndices[i + 1]], mesh.Positions[simplifiedIndices[i + 2]]);
+                nearest = std::min(nearest, (closest - position).LengthSquared());
+            }
+            largest = std::max(largest, nearest);
+        }
+        return std::sqrt(largest);
+    }
+
+    // Checks the properties every simplified mesh should have regardless of how far it was simplified
+    void CheckWellFormed(const Mesh& mesh, const SimplifiedMesh& simplified, uint32_t targetIndexCount, float maxError)
+    {
+        Require(simplified.Indices.size() % 3 == 0);
+        Check(simplified.Indices.size() <= mesh.Indices.size());
+        Check(simplified.Error >= 0.f);
+        Check(simplified.Error <= maxError);
+
+        for (size_t i = 0; i < simplified.Indices.size(); i += 3)
+        {
+            const uint32_t* triangle = &simplified.Indices[i];
+            Require(triangle[0] < mesh.Positions.size() && triangle[1] < mesh.Positions.size() && triangle[2] < mesh.Positions.size());
+            Check(triangle[0] != triangle[1] && triangle[1] != triangle[2] && triangle[2] != triangle[0]);
+
+            // Triangles must never flip, their normals should roughly agree with the vertex normals
+            float3 normal = TriangleNormal(mesh.Positions, triangle);
+            Check(normal.LengthSquared() > 0.f);
+            Check(normal.Dot(mesh.Normals[triangle[0]] + mesh.Normals[triangle[1]] + mesh.Normals[triangle[2]]) > 0.f);
+        }
+
+        // Meshes are only ever simplified until the target is reached
+        if (targetIndexCount < mesh.Indices.size())
+        { Check(simplified.Indices.size() + 3 * 8 > targetIndexCount || simplified.Indices.size() <= targetIndexCount); }
+    }
+}
+
+TEST(MeshSimplifier, NothingToDo)
+{
+    Mesh mesh = MakeGrid(4);
+    SimplifiedMesh simplified = SimplifyMesh(mesh.Positions, mesh.Normals, mesh.Indices, (uint32_t)mesh.Indices.size(), 1.f);
+    Check(simplified.Indices == mesh.Indices);
+    Check(simplified.Error == 0.f);
+
+    SimplifiedMesh empty = SimplifyMesh({ }, { }, { }, 0, 1.f);
+    Check(empty.Indices.empty());
+}
+
+TEST(MeshSimplifier, FlatGridCollapsesWithoutError)
+{
+    Mesh mesh = MakeGrid(60);
+    SimplifiedMesh simplified = SimplifyMesh(mesh.Positions, mesh.Normals, mesh.Indices, 0, 0.001f);
+    CheckWellFormed(mesh, simplified, 0, 0.001f);
+
+    // Only the interior can collapse, so what's left is roughly a fan around the border
+    Check(simplified.Indices.size() < mesh.Indices.size() / 10);
+    Check(simplified.Error < 1e-4f);
+    Check(MeasureError(mesh, simplified.Indices) < 1e-4f);
+
+    // Open borders are never collapsed
+    std::unordered_set<uint32_t> usedVertices(simplified.Indices.begin(), simplified.Indices.end());
+    for (uint32_t i = 0; i <= 60; i++)
+    {
+        Check(usedVertices.contains(i));
+        Check(usedVertices.contains(60 * 61 + i));
+        Check(usedVertices.contains(i * 61));
+        Check(usedVertices.contains(i * 61 + 60));
+    }
+
+    // The surface still covers the whole grid
+    double area = 0.0;
+    for (size_t i = 0; i < simplified.Indices.size(); i += 3)
+    { area += TriangleNormal(mesh.Positions, &simplified.Indices[i]).Length() * 0.5; }
+    Check(std::abs(area - 60.0 * 60.0) < 0.01);
+}
+
+TEST(MeshSimplifier, ReducesTrianglesWithinErrorBounds)
+{
+    Mesh mesh = MakeBumpySphere(30, 60);
+    const float maxError = 0.05f;
+    size_t previousIndexCount = mesh.Indices.size();
+    float previousError = 0.f;
+    for (uint32_t divisor : { 2u, 4u, 10u })
+    {
+        uint32_t targetIndexCount = (uint32_t)mesh.Indices.size() / divisor / 3 * 3;
+        SimplifiedMesh simplified = SimplifyMesh(mesh.Positions, mesh.Normals, mesh.Indices, targetIndexCount, maxError);
+        CheckWellFormed(mesh, simplified, targetIndexCount, maxError);
+
+        // Smaller targets never give bigger meshes or smaller errors
+        Check(simplified.Indices.size() <= previousIndexCount);
+        Check(simplified.Error >= previousError);
+        previousIndexCount = simplified.Indices.size();
+        previousError = simplified.Error;
+
+        // The reported error is an estimate, but it should be in the right ballpark of the real distance between the surfaces
+        float measuredError = MeasureError(mesh, simplified.Indices);
+        Check(measuredError <= simplified.Error * 1.5f + 1e-4f);
+        Check(measuredError <= maxError * 1.5f);
+    }
+
+    // The sphere is smooth enough that halving it should always be possible
+    SimplifiedMesh half = SimplifyMesh(mesh.Positions, mesh.Normals, mesh.Indices, (uint32_t)mesh.Indices.size() / 2, maxError);
+    Check(half.Indices.size() <= mesh.Indices.size() / 2);
+}
+
+TEST(MeshSimplifier, MaxErrorLimitsReduction)
+{
+    Mesh mesh = MakeBumpySphere(30, 60);
+    SimplifiedMesh strict = SimplifyMesh(mesh.Positions, mesh.Normals, mesh.Indices, 0, 0.001f);
+    SimplifiedMesh loose = SimplifyMesh(mesh.Positions, mesh.Normals, mesh.Indices, 0, 0.1f);
+    CheckWellFormed(mesh, strict, 0, 0.001f);
+    CheckWellFormed(mesh, loose, 0, 0.1f);
+    Check(strict.Indices.size() > loose.Indices.size());
+    Check(MeasureError(mesh, strict.Indices) <= 0.001f * 1.5f);
+}
@@ -0,0 +1,360 @@
+#include "pch.h"
+#include "ClusterCuller.h"
+#include "MeshletBuilder.h"
+#include "TestFramework.h"
+
+#include <algorithm>
+#include <array>
+#include <random>
+
+namespace
+{
+    struct Mesh
+    {
+        std::vector<float3> Positions;
+        std::vector<uint32_t> Indices;
+    };
+
+    // A flat grid in the XZ plane facing up
+    Mesh MakeGrid(uint32_t size)
+    {
+        Mesh mesh;
+        for (uint32_t y = 0; y <= size; y++)
+        {
+            for (uint32_t x = 0; x <= size; x++)
+            { mesh.Positions.push_back(float3((float)x, 0.f, (float)y)); }
+        }
+
+        for (uint32_t y = 0; y < size; y++)
+        {
+            for (uint32_t x = 0; x < size; x++)
+            {
+                uint32_t a = y * (size + 1) + x;
+                uint32_t b = a + 1;
+                uint32_t c = a + size + 1;
+                uint32_t d = c + 1;
+                mesh.Indices.insert(mesh.Indices.end(), { a, c, b, b, c, d });
+            }
+        }
+        return mesh;
+    }
+
+    // A unit UV sphere facing outwards
+    Mesh MakeSphere(uint32_t rings, uint32_t segments)
+    {
+        Mesh mesh;
+        for (uint32_t ring = 0; ring <= rings; ring++)
+        {
+            for (uint32_t segment = 0; segment <= segments; segment++)
+            {
+                float theta = Math::Pi * (float)ring / (float)rings;
+                float phi = Math::TwoPi * (float)segment / (float)segments;
+                mesh.Positions.push_back(float3(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi)));
+            }
+        }
+
+        for (uint32_t ring = 0; ring < rings; ring++)
+        {
+            for (uint32_t segment = 0; segment < segments; segment++)
+            {
+                uint32_t a = ring * (segments + 1) + segment;
+                uint32_t b = a + 1;
+                uint32_t c = a + segments + 1;
+                uint32_t d = c + 1;
+
+                // Skip the degenerate triangles at the poles
+                if (ring > 0)
+                { mesh.Indices.insert(mesh.Indices.end(), { a, b, c }); }
+                if (ring < rings - 1)
+                { mesh.Indices.insert(mesh.Indices.end(), { b, d, c }); }
+            }
+        }
+        return mesh;
+    }
+
+    // Triangles with random vertices, which gives the builder no locality to work with
+    Mesh MakeTriangleSoup(std::mt19937& random, uint32_t vertexCount, uint32_t triangleCount)
+    {
+        std::uniform_real_distribution<float> coordinate(-1.f, 1.f);
+        Mesh mesh;
+        for (uint32_t i = 0; i < vertexCount; i++)
+        { mesh.Positions.push_back(float3(coordinate(random), coordinate(random), coordinate(random))); }
+
+        for (uint32_t i = 0; i < triangleCount * 3; i++)
+        { mesh.Indices.push_back(random() % vertexCount); }
+        return mesh;
+    }
+
+    std::array<uint32_t, 3> SortedTriangle(const uint32_t* triangle)
+    {
+        std::array<uint32_t, 3> result = { triangle[0], triangle[1], triangle[2] };
+        // Rotate (rather than sort) so that the winding is part of the comparison
+        std::rotate(result.begin(), std::min_element(result.begin(), result.end()), result.end());
+        return result;
+    }
+
+    // Checks the meshlets are within limits, agree with the reordered index buffer, and contain every input triangle exactly once
+    void CheckMeshlets(const Mesh& mesh, const MeshletMesh& meshlets)
+    {
+        Require(meshlets.Bounds.size() == meshlets.Meshlets.size());
+        Require(meshlets.Indices.size() == mesh.Indices.size());
+        Require(meshlets.Triangles.size() == mesh.Indices.size());
+
+        uint32_t nextTriangle = 0;
+        for (const Meshlet& meshlet : meshlets.Meshlets)
+        {
+            Check(meshlet.VertexCount > 0 && meshlet.VertexCount <= MaxMeshletVertices);
+            Check(meshlet.TriangleCount > 0 && meshlet.TriangleCount <= MaxMeshletTriangles);
+            Require(meshlet.FirstVertex + meshlet.VertexCount <= meshlets.Vertices.size());
+
+            // Drawing a range of the index buffer has to draw a range of meshlets
+            Check(meshlet.FirstTriangle == nextTriangle);
+            nextTriangle = meshlet.FirstTriangle + meshlet.TriangleCount;
+            Require(nextTriangle * 3 <= meshlets.Indices.size());
+
+            for (uint32_t i = meshlet.FirstTriangle * 3; i < nextTriangle * 3; i++)
+            {
+                uint8_t local = meshlets.Triangles[i];
+                Require(local < meshlet.VertexCount);
+                Check(meshlets.Vertices[meshlet.FirstVertex + local] == meshlets.Indices[i]);
+            }
+        }
+        Check(nextTriangle * 3 == meshlets.Indices.size());
+
+        std::vector<std::array<uint32_t, 3>> expected;
+        std::vector<std::array<uint32_t, 3>> actual;
+        for (size_t i = 0; i < mesh.Indices.size(); i += 3)
+        {
+            expected.push_back(SortedTriangle(&mesh.Indices[i]));
+            actual.push_back(SortedTriangle(&meshlets.Indices[i]));
+        }
+        std::sort(expected.begin(), expected.end());
+        std::sort(actual.begin(), actual.end());
+        Check(expected == actual);
+    }
+
+    bool IsBackFacing(const Mesh& mesh, const uint32_t* triangle, float3 eyePosition)
+    {
+        float3 a = mesh.Positions[triangle[0]];
+        float3 b = mesh.Positions[triangle[1]];
+        float3 c = mesh.Positions[triangle[2]];
+        float3 normal = (b - a).Cross(c - a);
+        return (a - eyePosition).Dot(normal) >= -1e-5f * normal.Length();
+    }
+
+    // Checks every meshlet's bounds contain its vertices and that the cone never culls a triangle which faces the eye
+    void CheckBounds(std::mt19937& random, const Mesh& mesh, const MeshletMesh& meshlets)
+    {
+        for (uint32_t i = 0; i < meshlets.Meshlets.size(); i++)
+        {
+            const Meshlet& meshlet = meshlets.Meshlets[i];
+            const MeshletBounds& bounds = meshlets.Bounds[i];
+            for (uint32_t v = 0; v < meshlet.VertexCount; v++)
+            {
+                float3 position = mesh.Positions[meshlets.Vertices[meshlet.FirstVertex + v]];
+                Check((position - bounds.Center).Length() <= bounds.Radius * 1.0001f + 1e-5f);
+            }
+        }
+
+        std::uniform_real_distribution<float> coordinate(-4.f, 4.f);
+        for (uint32_t e = 0; e < 200; e++)
+        {
+            float3 eyePosition(coordinate(random), coordinate(random), coordinate(random));
+            for (uint32_t i = 0; i < meshlets.Meshlets.size(); i++)
+            {
+                const Meshlet& meshlet = meshlets.Meshlets[i];
+                const MeshletBounds& bounds = meshlets.Bounds[i];
+                float3 offset = bounds.Center - eyePosition;
+                if (offset.Dot(bounds.ConeAxis) < bounds.ConeCutoff * offset.Length() + bounds.Radius)
+                { continue; }
+
+                for (uint32_t t = meshlet.FirstTriangle; t < meshlet.FirstTriangle + meshlet.TriangleCount; t++)
+                { Check(IsBackFacing(mesh, &meshlets.Indices[t * 3], eyePosition)); }
+            }
+        }
+    }
+
+    // Turns the meshlets of a single untransformed primitive into a draw list like DrawList does for a scene
+    DrawList MakeDrawList(const Mesh& mesh, const MeshletMesh& meshlets)
+    {
+        std::vector<DrawListCluster> clusters;
+        for (uint32_t i = 0; i < meshlets.Meshlets.size(); i++)
+        {
+            const MeshletBounds& bounds = meshlets.Bounds[i];
+            clusters.push_back
+            ({
+                .Bounds = { bounds.Center, bounds.Radius },
+                .ConeAxis = bounds.ConeCutoff < 1.f ? bounds.ConeAxis : float3::Zero,
+                .ConeCutoff = bounds.ConeCutoff,
+                .FirstIndex = meshlets.Meshlets[i].FirstTriangle * 3,
+                .IndexCount = meshlets.Meshlets[i].TriangleCount * 3,
+            });
+        }
+
+        DrawPacket packet =
+        {
+            .Indices = { .BufferLocation = 0x80000000, .SizeInBytes = (uint32_t)(meshlets.Indices.size() * sizeof(uint32_t)), .Format = DXGI_FORMAT_R32_UINT },
+            .VertexOrIndexCount = (uint32_t)meshlets.Indices.size(),
+            .IsIndexed = true,
+            .FirstCluster = 0,
+            .ClusterCount = (uint32_t)clusters.size(),
+            .BoundsCenter = float3::Zero,
+            .BoundsExtents = float3(1.f, 1.f, 1.f),
+        };
+
+        std::vector<ShaderInterop::PerNodeCb> nodes(1);
+        nodes[0].Transform = float4x4(1.f);
+        nodes[0].NormalTransform = float3x3(1.f);
+        return DrawList(DrawListPass::Opaque, { packet }, nodes, 1, { }, std::move(clusters));
+    }
+
+    Frustum MakeFrustum(float3 eyePosition, float3 target)
+    { return Frustum(float4x4::MakeCameraLookAtViewTransform(eyePosition, target, float3::UnitY) * float4x4::MakePerspectiveTransformReverseZ(0.8f, 1.f, 0.01f)); }
+}
+
+TEST(MeshletBuilder, Empty)
+{
+    MeshletMesh meshlets = BuildMeshlets({ }, { });
+    Check(meshlets.Meshlets.empty());
+    Check(meshlets.Indices.empty());
+
+    MeshletStatistics statistics = MeasureMeshlets(meshlets);
+    Check(statistics.MeshletCount == 0);
+    Check(statistics.VerticesPerTriangle() == 0.f);
+}
+
+TEST(MeshletBuilder, GridIsPackedTightly)
+{
+    Mesh mesh = MakeGrid(100);
+    MeshletMesh meshlets = BuildMeshlets(mesh.Positions, mesh.Indices);
+    CheckMeshlets(mesh, meshlets);
+
+    // A 64 vertex square patch holds 98 triangles, so well packed meshlets transform a little more than half a vertex per triangle
+    MeshletStatistics statistics = MeasureMeshlets(meshlets);
+    Check(statistics.TriangleCount == mesh.Indices.size() / 3);
+    Check(statistics.VerticesPerTriangle() < 0.75f);
+    Check(statistics.TriangleCount >= statistics.MeshletCount * 80);
+
+    // Every triangle faces straight up, so every meshlet gets a cone with (almost) no spread
+    Check(statistics.ConeCount == statistics.MeshletCount);
+    Check(statistics.AverageConeAngle() < 0.01f);
+    for (const MeshletBounds& bounds : meshlets.Bounds)
+    { Check(bounds.ConeAxis.Dot(float3(0.f, 1.f, 0.f)) > 0.999f); }
+}
+
+TEST(MeshletBuilder, SphereHasNarrowCones)
+{
+    std::mt19937 random(1);
+    Mesh mesh = MakeSphere(64, 128);
+    MeshletMesh meshlets = BuildMeshlets(mesh.Positions, mesh.Indices);
+    CheckMeshlets(mesh, meshlets);
+    CheckBounds(random, mesh, meshlets);
+
+    MeshletStatistics statistics = MeasureMeshlets(meshlets);
+    Check(statistics.VerticesPerTriangle() < 0.8f);
+    Check(statistics.ConeCount == statistics.MeshletCount);
+    Check(statistics.AverageConeAngle() < 0.5f);
+}
+
+TEST(MeshletBuilder, TriangleSoup)
+{
+    std::mt19937 random(2);
+    for (uint32_t vertexCount : { 3, 40, 1000 })
+    {
+        Mesh mesh = MakeTriangleSoup(random, vertexCount, 2000);
+        MeshletMesh meshlets = BuildMeshlets(mesh.Positions, mesh.Indices);
+        CheckMeshlets(mesh, meshlets);
+        CheckBounds(random, mesh, meshlets);
+    }
+}
+
+TEST(ClusterCuller, CullsBackFacingAndOffScreenClusters)
+{
+    Mesh mesh = MakeSphere(64, 128);
+    MeshletMesh meshlets = BuildMeshlets(mesh.Positions, mesh.Indices);
+    DrawList drawList = MakeDrawList(mesh, meshlets);
+    std::span<const DrawListCluster> clusters = drawList.Clusters();
+
+    std::mt19937 random(3);
+    std::uniform_real_distribution<float> coordinate(-1.f, 1.f);
+    for (uint32_t i = 0; i < 50; i++)
+    {
+        // Alternate between views of the whole sphere and close ups which leave most of it off screen
+        float distance = i % 2 == 0 ? 6.f : 1.5f;
+        float3 eyePosition = float3(coordinate(random), coordinate(random), coordinate(random) + 0.1f).Normalized() * distance;
+        Frustum frustum = MakeFrustum(eyePosition, float3::Zero);
+
+        ClusterCuller culler;
+        const ClusterDrawSet& draws = culler.Cull(drawList, frustum, eyePosition, { }, { });
+        const ClusterCullingStatistics& statistics = culler.Statistics();
+        Require(draws.IsClusterCulled(0));
+
+        Check(statistics.PrimitiveCount == 1);
+        Check(statistics.ClusterCount == clusters.size());
+        Check(statistics.TriangleCount == mesh.Indices.size() / 3);
+        Check(statistics.DrawCount == draws.Draws.size());
+
+        // Find which clusters survived from the draws, which must be merged and in index buffer order
+        std::vector<bool> isDrawn(clusters.size(), false);
+        uint32_t drawnIndexCount = 0;
+        uint32_t previousEnd = 0;
+        for (const ClusterDraw& draw : draws.PrimitiveDraws(0))
+        {
+            Check(draw.IndexCount > 0);
+            Check(draw.FirstIndex > previousEnd || drawnIndexCount == 0);
+            previousEnd = draw.FirstIndex + draw.IndexCount;
+            drawnIndexCount += draw.IndexCount;
+
+            for (uint32_t c = 0; c < clusters.size(); c++)
+            {
+                if (clusters[c].FirstIndex >= draw.FirstIndex && clusters[c].FirstIndex + clusters[c].IndexCount <= previousEnd)
+                { isDrawn[c] = true; }
+            }
+        }
+        Check(drawnIndexCount == (statistics.TriangleCount - statistics.CulledTriangleCount) * 3);
+
+        // Every culled cluster must be off screen or entirely back facing
+        uint32_t culledClusterCount = 0;
+        for (uint32_t c = 0; c < clusters.size(); c++)
+        {
+            if (isDrawn[c])
+            { continue; }
+
+            culledClusterCount++;
+            if (!frustum.Intersects(clusters[c].Bounds))
+            { continue; }
+
+            for (uint32_t t = clusters[c].FirstIndex; t < clusters[c].FirstIndex + clusters[c].IndexCount; t += 3)
+            { Check(IsBackFacing(mesh, &meshlets.Indices[t], eyePosition)); }
+        }
+        Check(culledClusterCount == statistics.FrustumCulledClusters + statistics.BackFaceCulledClusters);
+
+        // The far side of a sphere is a little under half of it, and the cones should catch most of it
+        Check(statistics.BackFaceCulledClusters * 3 >= statistics.ClusterCount);
+        if (distance < 2.f)
+        { Check(statistics.FrustumCulledClusters > 0); }
+    }
+}
+
+TEST(ClusterCuller, SkipsInvisibleAndSimplifiedPrimitives)
+{
+    Mesh mesh = MakeSphere(16, 32);
+    MeshletMesh meshlets = BuildMeshlets(mesh.Positions, mesh.Indices);
+    DrawList drawList = MakeDrawList(mesh, meshlets);
+    float3 eyePosition(0.f, 0.f, -5.f);
+    Frustum frustum = MakeFrustum(eyePosition, float3::Zero);
+
+    ClusterCuller culler;
+    const uint8_t hidden[] = { 0 };
+    Check(!culler.Cull(drawList, frustum, eyePosition, hidden, { }).IsClusterCulled(0));
+    Check(culler.Statistics().PrimitiveCount == 0);
+
+    const uint8_t simplified[] = { 1 };
+    Check(!culler.Cull(drawList, frustum, eyePosition, { }, simplified).IsClusterCulled(0));
+    Check(culler.Statistics().ClusterCount == 0);
+
+    const uint8_t visible[] = { 1 };
+    const uint8_t fullDetail[] = { 0 };
+    Check(culler.Cull(drawList, frustum, eyePosition, visible, fullDetail).IsClusterCulled(0));
+    Check(culler.Statistics().ClusterCount == meshlets.Meshlets.size());
+}
@@ -0,0 +1,114 @@
+#pragma once
+#include "ShaderInterop.h"
+
+#include <d3d12.h>
+#include <vector>
+
+//! Stands in for ID3D12GraphicsCommandList when testing the Submit methods of the draw lists
+//! Tracks the state a real command list would have bound and records every draw along with the state it was issued with, so tests can check both the
+//! number of commands and that skipping redundant state never leaves a draw with the wrong state.
+struct MockCommandList
+{
+    static constexpr uint32_t VertexBufferSlotCount = 3;
+
+    struct Draw
+    {
+        ID3D12PipelineState* PipelineState;
+        D3D12_VERTEX_BUFFER_VIEW VertexBuffers[VertexBufferSlotCount];
+        D3D12_INDEX_BUFFER_VIEW Indices;
+        ShaderInterop::PerNodeCb PerNode;
+        D3D12_GPU_VIRTUAL_ADDRESS InstanceBuffer;
+
+        bool IsIndexed;
+        uint32_t VertexOrIndexCount;
+        uint32_t InstanceCount;
+        uint32_t StartIndex;
+    };
+
+    uint32_t PipelineStateCalls = 0;
+    uint32_t VertexBufferCalls = 0;
+    uint32_t IndexBufferCalls = 0;
+    uint32_t RootConstantCalls = 0;
+    uint32_t InstanceBufferCalls = 0;
+    std::vector<Draw> Draws;
+
+    // Currently bound state
+    ID3D12PipelineState* PipelineState = nullptr;
+    D3D12_VERTEX_BUFFER_VIEW VertexBuffers[VertexBufferSlotCount] = { };
+    D3D12_INDEX_BUFFER_VIEW Indices = { };
+    ShaderInterop::PerNodeCb PerNode = { };
+    D3D12_GPU_VIRTUAL_ADDRESS InstanceBuffer = 0;
+
+    inline uint32_t InstanceCount() const
+    {
+        uint32_t result = 0;
+        for (const Draw& draw : Draws)
+        { result += draw.InstanceCount; }
+        return result;
+    }
+
+    void SetPipelineState(ID3D12PipelineState* pipelineState)
+    {
+        PipelineState = pipelineState;
+        PipelineStateCalls++;
+    }
+
+    void IASetVertexBuffers(UINT startSlot, UINT viewCount, const D3D12_VERTEX_BUFFER_VIEW* views)
+    {
+        Assert(startSlot + viewCount <= VertexBufferSlotCount);
+        for (UINT i = 0; i < viewCount; i++)
+        { VertexBuffers[startSlot + i] = views[i]; }
+        VertexBufferCalls++;
+    }
+
+    void IASetIndexBuffer(const D3D12_INDEX_BUFFER_VIEW* view)
+    {
+        Indices = *view;
+        IndexBufferCalls++;
+    }
+
+    void SetGraphicsRoot32BitConstants(UINT rootParameterIndex, UINT constantCount, const void* data, UINT destinationOffset)
+    {
+        Assert(rootParameterIndex == ShaderInterop::Pbr::RpPerNodeCb);
+        Assert((destinationOffset + constantCount) * sizeof(uint32_t) <= sizeof(PerNode));
+        memcpy((uint32_t*)&PerNode + destinationOffset, data, constantCount * sizeof(uint32_t));
+        RootConstantCalls++;
+    }
+
+    void SetGraphicsRootShaderResourceView(UINT rootParameterIndex, D3D12_GPU_VIRTUAL_ADDRESS address)
+    {
+        Assert(rootParameterIndex == ShaderInterop::Pbr::RpInstanceBuffer);
+        InstanceBuffer = address;
+        InstanceBufferCalls++;
+    }
+
+    void DrawIndexedInstanced(UINT indexCount, UINT instanceCount, UINT startIndex, INT baseVertex, UINT startInstance)
+    {
+        Assert(baseVertex == 0 && startInstance == 0);
+        Draws.push_back(MakeDraw(true, indexCount, instanceCount, startIndex));
+    }
+
+    void DrawInstanced(UINT vertexCount, UINT instanceCount, UINT startVertex, UINT startInstance)
+    {
+        Assert(startVertex == 0 && startInstance == 0);
+        Draws.push_back(MakeDraw(false, vertexCount, instanceCount, 0));
+    }
+
+private:
+    Draw MakeDraw(bool isIndexed, uint32_t vertexOrIndexCount, uint32_t instanceCount, uint32_t startIndex) const
+    {
+        Draw draw =
+        {
+            .PipelineState = PipelineState,
+            .Indices = Indices,
+            .PerNode = PerNode,
+            .InstanceBuffer = InstanceBuffer,
+            .IsIndexed = isIndexed,
+            .VertexOrIndexCount = vertexOrIndexCount,
+            .InstanceCount = instanceCount,
+            .StartIndex = startIndex,
+        };
+        memcpy(draw.VertexBuffers, VertexBuffers, sizeof(VertexBuffers));
+        return draw;
+    }
+};
@@ -0,0 +1,313 @@
+#include "pch.h"
+#include "OcclusionRasterizer.h"
+#include "JobSystem.h"
+#include "TestFramework.h"
+
+#include <algorithm>
+#include <random>
+
+namespace
+{
+    const uint32_t Width = 128;
+    const uint32_t Height = 96;
+
+    // Occluders closer to the camera than this may be clipped away by the rasterizer, so the reference doesn't require them to be drawn
+    const double OccluderClipDistance = 0.25;
+
+    // Pixel centers this close to the edge of a triangle (in barycentric coordinates) may go either way
+    const double EdgeEpsilon = 1e-3;
+
+    // Relative depth error allowed, this must stay below the rasterizer's query bias or occluders could hide themselves
+    const double DepthTolerance = 1e-4;
+
+    float4x4 MakeViewProjection()
+    {
+        float4x4 view = float4x4::MakeCameraLookAtViewTransform(float3(0.f, 0.f, 0.f), float3(0.f, 0.f, 1.f), float3::UnitY);
+        return view * float4x4::MakePerspectiveTransformReverseZ(1.2f, (float)Width / (float)Height, 0.01f);
+    }
+
+    void AddTriangle(OccluderGeometry& geometry, float3 a, float3 b, float3 c, bool doubleSided = true)
+    {
+        uint32_t first = (uint32_t)geometry.Positions.size();
+        geometry.Positions.insert(geometry.Positions.end(), { a, b, c });
+        geometry.Indices.insert(geometry.Indices.end(), { first, first + 1, first + 2 });
+        if (doubleSided)
+        { geometry.Indices.insert(geometry.Indices.end(), { first, first + 2, first + 1 }); }
+    }
+
+    void AddQuad(OccluderGeometry& geometry, float3 a, float3 b, float3 c, float3 d)
+    {
+        AddTriangle(geometry, a, b, c);
+        AddTriangle(geometry, a, c, d);
+    }
+
+    void AddBox(OccluderGeometry& geometry, const BoundingBox& box)
+    {
+        auto Corner = [&](uint32_t i) { return float3((i & 1) ? box.Max.x : box.Min.x, (i & 2) ? box.Max.y : box.Min.y, (i & 4) ? box.Max.z : box.Min.z); };
+        AddQuad(geometry, Corner(0), Corner(1), Corner(3), Corner(2));
+        AddQuad(geometry, Corner(4), Corner(5), Corner(7), Corner(6));
+        AddQuad(geometry, Corner(0), Corner(1), Corner(5), Corner(4));
+        AddQuad(geometry, Corner(2), Corner(3), Corner(7), Corner(6));
+        AddQuad(geometry, Corner(0), Corner(2), Corner(6), Corner(4));
+        AddQuad(geometry, Corner(1), Corner(3), Corner(7), Corner(5));
+    }
+
+    //! The nearest (reverse Z) depth of the geometry at every pixel center, ignoring winding, 0 where nothing was hit
+    //! Intersections are found in homogeneous clip space so that geometry crossing the near plane needs no clipping:
+    //! the point on a triangle which projects to a pixel center is the one with barycentrics orthogonal to both (x - ndcX * w) and (y - ndcY * w).
+    //! Strict samples only count pixel centers well inside triangles and far enough from the camera that the rasterizer must have drawn them,
+    //! otherwise any hit in front of the camera counts.
+    std::vector<double> ReferenceDepth(const OccluderGeometry& geometry, const float4x4& viewProjection, bool strict)
+    {
+        std::vector<double> depth(Width * Height, 0.0);
+        for (uint32_t triangle = 0; triangle < geometry.TriangleCount(); triangle++)
+        {
+            double clip[3][4];
+            for (uint32_t i = 0; i < 3; i++)
+            {
+                float3 p = geometry.Positions[geometry.Indices[triangle * 3 + i]];
+                const float4x4& m = viewProjection;
+                clip[i][0] = (double)p.x * m.m00 + (double)p.y * m.m10 + (double)p.z * m.m20 + m.m30;
+                clip[i][1] = (double)p.x * m.m01 + (double)p.y * m.m11 + (double)p.z * m.m21 + m.m31;
+                clip[i][2] = (double)p.x * m.m02 + (double)p.y * m.m12 + (double)p.z * m.m22 + m.m32;
+                clip[i][3] = (double)p.x * m.m03 + (double)p.y * m.m13 + (double)p.z * m.m23 + m.m33;
+            }
+
+            for (uint32_t y = 0; y < Height; y++)
+            {
+                double ndcY = 1.0 - ((double)y + 0.5) / Height * 2.0;
+                for (uint32_t x = 0; x < Width; x++)
+                {
+                    double ndcX = ((double)x + 0.5) / Width * 2.0 - 1.0;
+                    double a[3], c[3];
+                    for (uint32_t i = 0; i < 3; i++)
+                    {
+                        a[i] = clip[i][0] - ndcX * clip[i][3];
+                        c[i] = clip[i][1] - ndcY * clip[i][3];
+                    }
+
+                    double barycentrics[3] = { a[1] * c[2] - a[2] * c[1], a[2] * c[0] - a[0] * c[2], a[0] * c[1] - a[1] * c[0] };
+                    double sum = barycentrics[0] + barycentrics[1] + barycentrics[2];
+                    if (std::abs(sum) < 1e-12)
+                    { continue; }
+
+                    double w = 0.0;
+                    double z = 0.0;
+                    double minimum = 1.0;
+                    for (uint32_t i = 0; i < 3; i++)
+                    {
+                        barycentrics[i] /= sum;
+                        w += barycentrics[i] * clip[i][3];
+                        z += barycentrics[i] * clip[i][2];
+                        minimum = std::min(minimum, barycentrics[i]);
+                    }
+
+                    bool hit = strict ? minimum >= EdgeEpsilon && w >= OccluderClipDistance : minimum >= -EdgeEpsilon && w > 0.0;
+                    if (hit)
+                    { depth[y * Width + x] = std::max(depth[y * Width + x], z / w); }
+                }
+            }
+        }
+        return depth;
+    }
+
+    //! Checks that every pixel of the rasterizer is between the strict and loose reference depths
+    uint32_t CountReferenceMismatches(const OcclusionRasterizer& rasterizer, const OccluderGeometry& geometry, const float4x4& viewProjection)
+    {
+        std::vector<double> strict = ReferenceDepth(geometry, viewProjection, true);
+        std::vector<double> loose = ReferenceDepth(geometry, viewProjection, false);
+        uint32_t mismatchCount = 0;
+        for (uint32_t i = 0; i < Width * Height; i++)
+        {
+            double depth = rasterizer.Depth()[i];
+            if (depth < strict[i] * (1.0 - DepthTolerance) || depth > loose[i] * (1.0 + DepthTolerance))
+            { mismatchCount++; }
+        }
+        return mismatchCount;
+    }
+
+    uint32_t CountCoveredPixels(const OcclusionRasterizer& rasterizer)
+    { return (uint32_t)std::count_if(rasterizer.Depth().begin(), rasterizer.Depth().end(), [](float depth) { return depth > 0.f; }); }
+}
+
+TEST(OcclusionRasterizer, MatchesReference)
+{
+    // Overlapping triangles of all sizes in front of the camera, spread over every tile
+    JobSystem jobs(3);
+    OcclusionRasterizer rasterizer(Width, Height);
+    float4x4 viewProjection = MakeViewProjection();
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> unit(-1.f, 1.f);
+    for (uint32_t trial = 0; trial < 10; trial++)
+    {
+        OccluderGeometry geometry;
+        for (uint32_t i = 0; i < 60; i++)
+        {
+            float3 center(unit(random) * 20.f, unit(random) * 12.f, 6.f + (unit(random) + 1.f) * 20.f);
+            float size = trial < 5 ? 6.f : 0.5f;
+            auto Vertex = [&]() { return center + float3(unit(random) * size, unit(random) * size, unit(random) * 3.f); };
+            AddTriangle(geometry, Vertex(), Vertex(), Vertex());
+        }
+
+        rasterizer.Render(geometry, viewProjection, jobs);
+        Check(CountCoveredPixels(rasterizer) > 0);
+        Check(CountReferenceMismatches(rasterizer, geometry, viewProjection) == 0);
+    }
+}
+
+TEST(OcclusionRasterizer, ClipsTrianglesCrossingTheNearPlane)
+{
+    // Large triangles around the camera, many of which have vertices behind it
+    JobSystem jobs(3);
+    OcclusionRasterizer rasterizer(Width, Height);
+    float4x4 viewProjection = MakeViewProjection();
+    std::mt19937 random(2);
+    std::uniform_real_distribution<float> unit(-1.f, 1.f);
+    uint32_t crossingCount = 0;
+    for (uint32_t trial = 0; trial < 20; trial++)
+    {
+        OccluderGeometry geometry;
+        for (uint32_t i = 0; i < 4; i++)
+        {
+            auto Vertex = [&]() { return float3(unit(random) * 30.f, unit(random) * 30.f, unit(random) * 20.f + 5.f); };
+            AddTriangle(geometry, Vertex(), Vertex(), Vertex());
+            crossingCount += std::min({ geometry.Positions.end()[-1].z, geometry.Positions.end()[-2].z, geometry.Positions.end()[-3].z }) < 0.f ? 1 : 0;
+        }
+
+        rasterizer.Render(geometry, viewProjection, jobs);
+        Check(CountReferenceMismatches(rasterizer, geometry, viewProjection) == 0);
+    }
+    Check(crossingCount > 20);
+
+    // A floor passing beneath the camera should cover the whole bottom half of the screen
+    OccluderGeometry floor;
+    AddQuad(floor, float3(-1000.f, -1.f, -1000.f), float3(1000.f, -1.f, -1000.f), float3(1000.f, -1.f, 1000.f), float3(-1000.f, -1.f, 1000.f));
+    rasterizer.Render(floor, viewProjection, jobs);
+    Check(CountReferenceMismatches(rasterizer, floor, viewProjection) == 0);
+    for (uint32_t y = Height / 2; y < Height; y++)
+    { Check(rasterizer.Depth()[y * Width + Width / 2] > 0.f); }
+    Check(rasterizer.Depth()[0] == 0.f);
+}
+
+TEST(OcclusionRasterizer, CullsBackFaces)
+{
+    JobSystem jobs(0);
+    OcclusionRasterizer rasterizer(Width, Height);
+    float4x4 viewProjection = MakeViewProjection();
+
+    // Counter-clockwise as seen from the camera
+    OccluderGeometry front;
+    AddTriangle(front, float3(-5.f, -5.f, 10.f), float3(-5.f, 5.f, 10.f), float3(5.f, -5.f, 10.f), false);
+    rasterizer.Render(front, viewProjection, jobs);
+    uint32_t frontCoverage = CountCoveredPixels(rasterizer);
+
+    OccluderGeometry back;
+    AddTriangle(back, float3(-5.f, -5.f, 10.f), float3(5.f, -5.f, 10.f), float3(-5.f, 5.f, 10.f), false);
+    rasterizer.Render(back, viewProjection, jobs);
+    uint32_t backCoverage = CountCoveredPixels(rasterizer);
+
+    // Exactly one of the two windings should be drawn
+    Check((frontCoverage > 0) != (backCoverage > 0));
+    Check(frontCoverage + backCoverage > Width * Height / 8);
+}
+
+TEST(OcclusionRasterizer, WorkerCountDoesNotChangeTheResult)
+{
+    std::mt19937 random(3);
+    std::uniform_real_distribution<float> unit(-1.f, 1.f);
+    OccluderGeometry geometry;
+    for (uint32_t i = 0; i < 5000; i++)
+    {
+        float3 center(unit(random) * 30.f, unit(random) * 15.f, 3.f + (unit(random) + 1.f) * 30.f);
+        auto Vertex = [&]() { return center + float3(unit(random) * 2.f, unit(random) * 2.f, unit(random)); };
+        AddTriangle(geometry, Vertex(), Vertex(), Vertex());
+    }
+
+    float4x4 viewProjection = MakeViewProjection();
+    JobSystem serialJobs(0);
+    OcclusionRasterizer serial(Width, Height);
+    serial.Render(geometry, viewProjection, serialJobs);
+
+    JobSystem parallelJobs(5);
+    OcclusionRasterizer parallel(Width, Height);
+    parallel.Render(geometry, viewProjection, parallelJobs);
+
+    Require(CountCoveredPixels(serial) > 0);
+    Check(std::equal(serial.Depth().begin(), serial.Depth().end(), parallel.Depth().begin()));
+}
+
+TEST(OcclusionRasterizer, BoxesBehindAWall)
+{
+    JobSystem jobs(2);
+    OcclusionRasterizer rasterizer(Width, Height);
+    OccluderGeometry wall;
+    AddQuad(wall, float3(-5.f, -5.f, 10.f), float3(5.f, -5.f, 10.f), float3(5.f, 5.f, 10.f), float3(-5.f, 5.f, 10.f));
+    rasterizer.Render(wall, MakeViewProjection(), jobs);
+
+    auto Box = [](float3 center, float extent) { return BoundingBox::FromCenterExtents(center, float3(extent, extent, extent)); };
+    Check(!rasterizer.IsVisible(Box(float3(0.f, 0.f, 20.f), 1.f)));
+    Check(!rasterizer.IsVisible(Box(float3(-4.f, 4.f, 100.f), 1.f)));
+    Check(!rasterizer.IsVisible(BoundingBox::Empty()));
+    Check(rasterizer.IsVisible(Box(float3(0.f, 0.f, 5.f), 1.f))); // In front
+    Check(rasterizer.IsVisible(Box(float3(0.f, 0.f, 10.f), 1.f))); // Straddling
+    Check(rasterizer.IsVisible(Box(float3(30.f, 0.f, 40.f), 1.f))); // Beside
+    Check(rasterizer.IsVisible(Box(float3(0.f, 0.f, 0.f), 1.f))); // Crossing the near plane
+    Check(rasterizer.IsVisible(Box(float3(16.f, 0.f, 30.f), 1.f))); // Peeking around the edge
+
+    // The wall's own bounds are flush with it and must not be occluded by it
+    Check(rasterizer.IsVisible(BoundingBox::FromCenterExtents(float3(0.f, 0.f, 10.f), float3(5.f, 5.f, 0.f))));
+}
+
+TEST(OcclusionRasterizer, BoxesAreNeverHiddenWhenVisible)
+{
+    // Whenever a box is reported hidden, every pixel center it covers must be behind an occluder according to the reference
+    JobSystem jobs(3);
+    OcclusionRasterizer rasterizer(Width, Height);
+    float4x4 viewProjection = MakeViewProjection();
+    std::mt19937 random(4);
+    std::uniform_real_distribution<float> unit(-1.f, 1.f);
+    uint32_t hiddenCount = 0;
+    uint32_t visibleCount = 0;
+    for (uint32_t trial = 0; trial < 8; trial++)
+    {
+        OccluderGeometry geometry;
+        for (uint32_t i = 0; i < 12; i++)
+        {
+            float3 center(unit(random) * 15.f, unit(random) * 10.f, 15.f + unit(random) * 5.f);
+            float3 right(6.f + unit(random) * 3.f, unit(random) * 2.f, unit(random) * 2.f);
+            float3 up(unit(random) * 2.f, 6.f + unit(random) * 3.f, unit(random) * 2.f);
+            AddQuad(geometry, center - right - up, center + right - up, center + right + up, center - right + up);
+        }
+
+        rasterizer.Render(geometry, viewProjection, jobs);
+        std::vector<double> occluderDepth = ReferenceDepth(geometry, viewProjection, false);
+
+        for (uint32_t i = 0; i < 40; i++)
+        {
+            float3 center(unit(random) * 20.f, unit(random) * 12.f, 25.f + unit(random) * 15.f);
+            float3 extents(0.2f + (unit(random) + 1.f), 0.2f + (unit(random) + 1.f), 0.2f + (unit(random) + 1.f));
+            BoundingBox box = BoundingBox::FromCenterExtents(center, extents);
+            if (rasterizer.IsVisible(box))
+            {
+                visibleCount++;
+                continue;
+            }
+
+            hiddenCount++;
+            OccluderGeometry boxGeometry;
+            AddBox(boxGeometry, box);
+            std::vector<double> boxDepth = ReferenceDepth(boxGeometry, viewProjection, true);
+            uint32_t leakCount = 0;
+            for (uint32_t pixel = 0; pixel < Width * Height; pixel++)
+            {
+                if (boxDepth[pixel] > 0.0 && occluderDepth[pixel] < boxDepth[pixel])
+                { leakCount++; }
+            }
+            Check(leakCount == 0);
+        }
+    }
+
+    // Make sure both outcomes were actually exercised
+    Check(hiddenCount > 10);
+    Check(visibleCount > 10);
+}
@@ -0,0 +1,100 @@
+#include "pch.h"
+#include "ParticleDispatchArguments.h"
+#include "TestFramework.h"
+
+using namespace ParticleDispatchArguments;
+
+static const uint32_t UpdateGroupSize = ShaderInterop::ParticleSystem::UpdateGroupSize;
+static const uint32_t SpawnGroupSize = ShaderInterop::ParticleSystem::SpawnGroupSize;
+static const uint32_t LightingGroupSize = ShaderInterop::ParticleLighting::GroupSize;
+
+// Checks the invariants every dispatch size should have regardless of how it was computed
+static void CheckDispatchSize(const DispatchSize& size, uint32_t groupSize)
+{
+    Check(size.Arguments.ThreadGroupCountY == 1);
+    Check(size.Arguments.ThreadGroupCountZ == 1);
+    Check(size.ThreadsDispatched == size.Arguments.ThreadGroupCountX * groupSize);
+    Check(size.ThreadsUseful <= size.ThreadsDispatched);
+    // Never more than one partially useful group
+    Check(size.ThreadsDispatched - size.ThreadsUseful < groupSize);
+}
+
+TEST(ParticleDispatchArguments, UpdateRoundsUpToWholeGroups)
+{
+    const uint32_t capacity = 10000;
+    for (uint32_t living : { 0u, 1u, UpdateGroupSize - 1, UpdateGroupSize, UpdateGroupSize + 1, 1234u, capacity })
+    {
+        DispatchSize size = ForUpdate(living, capacity);
+        CheckDispatchSize(size, UpdateGroupSize);
+        Check(size.ThreadsUseful == living);
+        Check(size.Arguments.ThreadGroupCountX == (living + UpdateGroupSize - 1) / UpdateGroupSize);
+    }
+}
+
+TEST(ParticleDispatchArguments, EmptySystemDispatchesNothing)
+{
+    Check(ForUpdate(0, 100).Arguments.ThreadGroupCountX == 0);
+    Check(ForSpawn(0, 0, 100).Arguments.ThreadGroupCountX == 0);
+    Check(ForLighting(0, 100).Arguments.ThreadGroupCountX == 0);
+}
+
+TEST(ParticleDispatchArguments, UpdateClampsToCapacity)
+{
+    // The living count can exceed capacity when spawning fails because the system is full
+    const uint32_t capacity = 1000;
+    DispatchSize size = ForUpdate(capacity + 500, capacity);
+    CheckDispatchSize(size, UpdateGroupSize);
+    Check(size.ThreadsUseful == capacity);
+    Check(size.Arguments.ThreadGroupCountX == (capacity + UpdateGroupSize - 1) / UpdateGroupSize);
+}
+
+TEST(ParticleDispatchArguments, SpawnOnlyFillsRemainingCapacity)
+{
+    const uint32_t capacity = 1000;
+
+    DispatchSize size = ForSpawn(900, 50, capacity);
+    CheckDispatchSize(size, SpawnGroupSize);
+    Check(size.ThreadsUseful == 50);
+
+    size = ForSpawn(900, 500, capacity);
+    CheckDispatchSize(size, SpawnGroupSize);
+    Check(size.ThreadsUseful == 100);
+
+    // Full systems (or systems which overflowed) spawn nothing
+    Check(ForSpawn(capacity, 10, capacity).ThreadsUseful == 0);
+    Check(ForSpawn(capacity + 10, 10, capacity).ThreadsUseful == 0);
+    Check(ForSpawn(capacity + 10, 10, capacity).Arguments.ThreadGroupCountX == 0);
+}
+
+TEST(ParticleDispatchArguments, LightingCoversEveryDrawnParticle)
+{
+    const uint32_t capacity = 4096;
+    for (uint32_t count = 0; count <= capacity + LightingGroupSize; count += 7)
+    {
+        DispatchSize size = ForLighting(count, capacity);
+        CheckDispatchSize(size, LightingGroupSize);
+        Check(size.ThreadsUseful == std::min(count, capacity));
+    }
+}
+
+TEST(ParticleDispatchArguments, SpawnAfterUpdateNeverExceedsCapacity)
+{
+    // Simulates a system over a number of frames the same way ParticleSystem::Update drives the GPU
+    const uint32_t capacity = 777;
+    uint32_t living = 0;
+    for (uint32_t frame = 0; frame < 200; frame++)
+    {
+        DispatchSize update = ForUpdate(living, capacity);
+        // Roughly a third of particles die every frame
+        uint32_t survivors = update.ThreadsUseful - update.ThreadsUseful / 3;
+        DispatchSize spawn = ForSpawn(survivors, 50 + (frame * 37) % 300, capacity);
+        living = survivors + spawn.ThreadsUseful;
+        Check(living <= capacity);
+
+        ShaderInterop::ParticleDispatchStatistics statistics = Statistics(update, spawn);
+        Check(statistics.UpdateThreadsDispatched == update.ThreadsDispatched);
+        Check(statistics.UpdateThreadsUseful == update.ThreadsUseful);
+        Check(statistics.SpawnThreadsDispatched == spawn.ThreadsDispatched);
+        Check(statistics.SpawnThreadsUseful == spawn.ThreadsUseful);
+    }
+}
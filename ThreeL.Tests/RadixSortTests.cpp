@@ -0,0 +1,101 @@
+#include "pch.h"
+#include "JobSystem.h"
+#include "RadixSort.h"
+#include "TestFramework.h"
+
+#include <algorithm>
+#include <random>
+
+namespace
+{
+    enum class KeyDistribution
+    {
+        Random,
+        //! Only the low 16 bits vary, so most passes are skipped as trivial
+        Narrow,
+        //! Only bits 8 through 15 vary, which leaves an odd number of passes and the result in the scratch buffers
+        SingleDigit,
+        Equal,
+        Descending,
+        Count
+    };
+
+    std::vector<uint64_t> MakeKeys(std::mt19937_64& random, uint32_t count, KeyDistribution distribution)
+    {
+        std::vector<uint64_t> keys(count);
+        for (uint32_t i = 0; i < count; i++)
+        {
+            switch (distribution)
+            {
+                case KeyDistribution::Random: keys[i] = random(); break;
+                case KeyDistribution::Narrow: keys[i] = 0xABCD000000000000 | (random() & 0xFFFF); break;
+                case KeyDistribution::SingleDigit: keys[i] = 0x1234567800000000 | (random() & 0xFF00); break;
+                case KeyDistribution::Equal: keys[i] = 0x0123456789ABCDEF; break;
+                case KeyDistribution::Descending: keys[i] = UINT64_MAX - (uint64_t)i * 0x10001; break;
+                default: Assert(false);
+            }
+        }
+        return keys;
+    }
+
+    // Sorts with the radix sorter and checks the result against a stable comparison sort
+    void CheckSort(JobSystem& jobs, RadixSorter& sorter, std::vector<uint64_t> keys)
+    {
+        const uint32_t count = (uint32_t)keys.size();
+        std::vector<uint32_t> values(count);
+        for (uint32_t i = 0; i < count; i++)
+        { values[i] = i; }
+
+        std::vector<std::pair<uint64_t, uint32_t>> expected(count);
+        for (uint32_t i = 0; i < count; i++)
+        { expected[i] = { keys[i], i }; }
+        std::stable_sort(expected.begin(), expected.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+
+        sorter.Sort(jobs, keys, values);
+
+        uint32_t mismatchCount = 0;
+        for (uint32_t i = 0; i < count; i++)
+        {
+            if (keys[i] != expected[i].first || values[i] != expected[i].second)
+            { mismatchCount++; }
+        }
+        Check(mismatchCount == 0);
+    }
+}
+
+TEST(RadixSort, MatchesStableSort)
+{
+    std::mt19937_64 random(1);
+    for (uint32_t workerCount : { 0, 1, 3, 7 })
+    {
+        JobSystem jobs(workerCount);
+        RadixSorter sorter;
+        for (uint32_t count : { 0, 1, 2, 5, 1000, 8191, 8192, 50001, 200000 })
+        {
+            for (uint32_t distribution = 0; distribution < (uint32_t)KeyDistribution::Count; distribution++)
+            { CheckSort(jobs, sorter, MakeKeys(random, count, (KeyDistribution)distribution)); }
+        }
+    }
+}
+
+TEST(RadixSort, ReusesScratchAcrossSizes)
+{
+    // A sorter which has warmed up on a big list must not leak stale scratch data into smaller ones
+    std::mt19937_64 random(2);
+    JobSystem jobs(3);
+    RadixSorter sorter;
+    for (uint32_t count : { 100000, 10, 30000, 0, 100001, 3 })
+    { CheckSort(jobs, sorter, MakeKeys(random, count, KeyDistribution::Random)); }
+}
+
+TEST(RadixSort, FewDistinctKeysStayStable)
+{
+    // Many duplicate keys spread across every job's slice is where an unstable scatter would show up
+    std::mt19937_64 random(3);
+    JobSystem jobs(5);
+    RadixSorter sorter;
+    std::vector<uint64_t> keys(120000);
+    for (uint64_t& key : keys)
+    { key = (random() % 4) << 40; }
+    CheckSort(jobs, sorter, keys);
+}
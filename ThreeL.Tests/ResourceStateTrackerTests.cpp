@@ -0,0 +1,616 @@
+#include "pch.h"
+#include "ResourceStateTracker.h"
+#include "TestFramework.h"
+
+#include <random>
+#include <string>
+
+namespace
+{
+    using States = D3D12_RESOURCE_STATES;
+    const States COMMON = D3D12_RESOURCE_STATE_COMMON;
+    const States RT = D3D12_RESOURCE_STATE_RENDER_TARGET;
+    const States UAV = D3D12_RESOURCE_STATE_UNORDERED_ACCESS;
+    const States DW = D3D12_RESOURCE_STATE_DEPTH_WRITE;
+    const States DR = D3D12_RESOURCE_STATE_DEPTH_READ;
+    const States SRV = D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE;
+    const States PSRV = D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE;
+    const States IA = D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT;
+    const States CD = D3D12_RESOURCE_STATE_COPY_DEST;
+    const States CS = D3D12_RESOURCE_STATE_COPY_SOURCE;
+    const uint32_t ALL = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
+
+    // The tracker never dereferences resources
+    ID3D12Resource* const R1 = reinterpret_cast<ID3D12Resource*>(0x1000);
+    ID3D12Resource* const R2 = reinterpret_cast<ID3D12Resource*>(0x2000);
+
+    std::string Describe(States states)
+    {
+        if (states == COMMON)
+        { return "COMMON"; }
+
+        const std::pair<States, const char*> names[] = { { RT, "RT" }, { UAV, "UAV" }, { DW, "DW" }, { DR, "DR" }, { SRV, "SRV" }, { PSRV, "PSRV" }, { IA, "IA" }, { CD, "CD" }, { CS, "CS" } };
+        std::string result;
+        for (const auto& [state, name] : names)
+        {
+            if ((states & state) == 0)
+            { continue; }
+
+            result += result.empty() ? "" : "|";
+            result += name;
+        }
+        return result;
+    }
+
+    std::string Describe(ID3D12Resource* resource)
+    {
+        return resource == R1 ? "R1" : resource == R2 ? "R2" : resource == nullptr ? "*" : "?";
+    }
+
+    //! Describes the pending barriers of the tracker and clears them, IE: "Begin R1:0 RT>PSRV; UAV *; Alias"
+    std::string TakeBarriers(ResourceStateTracker& tracker)
+    {
+        std::string result;
+        for (const D3D12_RESOURCE_BARRIER& barrier : tracker.PendingBarriers())
+        {
+            result += result.empty() ? "" : "; ";
+            if (barrier.Type == D3D12_RESOURCE_BARRIER_TYPE_UAV)
+            {
+                result += "UAV " + Describe(barrier.UAV.pResource);
+                continue;
+            }
+            else if (barrier.Type == D3D12_RESOURCE_BARRIER_TYPE_ALIASING)
+            {
+                result += "Alias";
+                continue;
+            }
+
+            const D3D12_RESOURCE_TRANSITION_BARRIER& transition = barrier.Transition;
+            result += barrier.Flags == D3D12_RESOURCE_BARRIER_FLAG_BEGIN_ONLY ? "Begin " : barrier.Flags == D3D12_RESOURCE_BARRIER_FLAG_END_ONLY ? "End " : "";
+            result += Describe(transition.pResource) + ":" + (transition.Subresource == ALL ? "*" : std::to_string(transition.Subresource));
+            result += " " + Describe(transition.StateBefore) + ">" + Describe(transition.StateAfter);
+        }
+
+        tracker.ClearPendingBarriers();
+        return result;
+    }
+
+    bool IsReadOnly(States states)
+    {
+        const States readOnly = D3D12_RESOURCE_STATE_GENERIC_READ | DR | D3D12_RESOURCE_STATE_RESOLVE_SOURCE | D3D12_RESOURCE_STATE_SHADING_RATE_SOURCE;
+        return states != COMMON && (states & ~readOnly) == 0;
+    }
+
+    //! Replays barriers and accesses against the state the GPU would see, counting anything the D3D12 resource state model doesn't allow
+    struct GpuModel
+    {
+        struct Subresource
+        {
+            States State;
+            bool IsPromoted = false;
+            bool IsSplit = false;
+        };
+
+        std::vector<Subresource> Subresources;
+        bool IsStateless;
+        uint32_t ViolationCount = 0;
+
+        GpuModel(uint32_t subresourceCount, States initialState, bool isStateless)
+            : Subresources(subresourceCount, { .State = initialState }), IsStateless(isStateless)
+        {
+        }
+
+        void Barrier(const D3D12_RESOURCE_BARRIER& barrier)
+        {
+            if (barrier.Type != D3D12_RESOURCE_BARRIER_TYPE_TRANSITION)
+            { return; }
+
+            auto apply = [&](Subresource& subresource)
+                {
+                    ViolationCount += subresource.State != barrier.Transition.StateBefore;
+                    if (barrier.Flags == D3D12_RESOURCE_BARRIER_FLAG_BEGIN_ONLY)
+                    {
+                        ViolationCount += subresource.IsSplit;
+                        subresource.IsSplit = true;
+                        return;
+                    }
+
+                    if (barrier.Flags == D3D12_RESOURCE_BARRIER_FLAG_END_ONLY)
+                    {
+                        ViolationCount += !subresource.IsSplit;
+                        subresource.IsSplit = false;
+                    }
+
+                    subresource.State = barrier.Transition.StateAfter;
+                    subresource.IsPromoted = false;
+                };
+
+            if (barrier.Transition.Subresource == ALL)
+            {
+                for (Subresource& subresource : Subresources)
+                { apply(subresource); }
+            }
+            else
+            { apply(Subresources[barrier.Transition.Subresource]); }
+        }
+
+        //! The GPU accesses a subresource in the given state, which must either be its current state or one it can be implicitly promoted to
+        void Access(uint32_t subresourceIndex, States state)
+        {
+            Subresource& subresource = Subresources[subresourceIndex];
+            ViolationCount += subresource.IsSplit;
+            if (subresource.State == state || (IsReadOnly(state) && IsReadOnly(subresource.State) && (state & ~subresource.State) == 0))
+            { return; }
+
+            States promotable = IsStateless ? (States)~0 : SRV | PSRV | CS | CD;
+            bool canPromoteFromCommon = subresource.State == COMMON && (IsStateless || IsReadOnly(state) || state == CD);
+            bool canAccumulateReads = subresource.IsPromoted && IsReadOnly(subresource.State) && IsReadOnly(state);
+            if (state == COMMON || (state & ~promotable) != 0 || !(canPromoteFromCommon || canAccumulateReads))
+            {
+                ViolationCount++;
+                return;
+            }
+
+            subresource.State = subresource.State == COMMON ? state : subresource.State | state;
+            subresource.IsPromoted = true;
+        }
+
+        void CommandListEnded(bool isCopyQueue)
+        {
+            for (Subresource& subresource : Subresources)
+            {
+                if (isCopyQueue || IsStateless || (subresource.IsPromoted && IsReadOnly(subresource.State)))
+                { subresource.State = COMMON; }
+                subresource.IsPromoted = false;
+            }
+        }
+    };
+}
+
+TEST(ResourceStateTracker, RedundantTransitionsAreSkipped)
+{
+    ResourceStateTracker tracker(D3D12_COMMAND_LIST_TYPE_DIRECT);
+    ResourceState state(RT);
+    state.Initialize(1, false);
+
+    tracker.Transition(state, R1, RT);
+    Check(TakeBarriers(tracker) == "");
+    tracker.Transition(state, R1, PSRV);
+    Check(TakeBarriers(tracker) == "R1:* RT>PSRV");
+    tracker.Transition(state, R1, PSRV | SRV);
+    Check(TakeBarriers(tracker) == "R1:* PSRV>SRV|PSRV");
+
+    // Already readable as a non-pixel shader resource
+    tracker.Transition(state, R1, SRV);
+    Check(TakeBarriers(tracker) == "");
+    Check(state.State() == (SRV | PSRV));
+
+    tracker.Transition(state, R1, RT);
+    Check(TakeBarriers(tracker) == "R1:* SRV|PSRV>RT");
+    tracker.CommandListEnded();
+}
+
+TEST(ResourceStateTracker, ConsecutiveTransitionsMerge)
+{
+    ResourceStateTracker tracker(D3D12_COMMAND_LIST_TYPE_DIRECT);
+    ResourceState state(RT);
+    state.Initialize(1, false);
+
+    tracker.Transition(state, R1, PSRV);
+    tracker.Transition(state, R1, UAV);
+    Check(TakeBarriers(tracker) == "R1:* RT>UAV");
+
+    // Leaving and returning to unordered access still orders the UAV accesses on either side
+    tracker.Transition(state, R1, SRV);
+    tracker.Transition(state, R1, UAV);
+    Check(TakeBarriers(tracker) == "UAV R1");
+
+    tracker.Transition(state, R1, CS);
+    tracker.Transition(state, R1, SRV);
+    tracker.Transition(state, R1, CS);
+    Check(TakeBarriers(tracker) == "R1:* UAV>CS");
+
+    // Nothing used the resource as a render target, so returning to a read-only state cancels out
+    tracker.Transition(state, R1, RT);
+    tracker.Transition(state, R1, CS);
+    Check(TakeBarriers(tracker) == "");
+
+    // Writes on either side of a read-only state still need to be ordered
+    tracker.Transition(state, R1, RT);
+    Check(TakeBarriers(tracker) == "R1:* CS>RT");
+    tracker.Transition(state, R1, CS);
+    tracker.Transition(state, R1, RT);
+    Check(TakeBarriers(tracker) == "R1:* RT>CS; R1:* CS>RT");
+
+    // Transitions of other resources don't get in the way
+    ResourceState other(RT);
+    other.Initialize(1, false);
+    tracker.Transition(state, R1, UAV);
+    tracker.Transition(other, R2, SRV);
+    tracker.Transition(state, R1, CS);
+    Check(TakeBarriers(tracker) == "R1:* RT>CS; R2:* RT>SRV");
+
+    tracker.Transition(state, R1, RT);
+    tracker.Transition(other, R2, RT);
+    Check(TakeBarriers(tracker) == "R1:* CS>RT; R2:* SRV>RT");
+    tracker.CommandListEnded();
+}
+
+TEST(ResourceStateTracker, UavAndAliasingBarriersStopMerging)
+{
+    ResourceStateTracker tracker(D3D12_COMMAND_LIST_TYPE_DIRECT);
+    ResourceState state(CS);
+    state.Initialize(1, false);
+
+    tracker.Transition(state, R1, UAV);
+    tracker.UavBarrier(R1);
+    tracker.Transition(state, R1, SRV);
+    Check(TakeBarriers(tracker) == "R1:* CS>UAV; UAV R1; R1:* UAV>SRV");
+
+    tracker.Transition(state, R1, UAV);
+    tracker.UavBarrier(nullptr);
+    tracker.Transition(state, R1, SRV);
+    Check(TakeBarriers(tracker) == "R1:* SRV>UAV; UAV *; R1:* UAV>SRV");
+
+    // UAV barriers for other resources don't
+    tracker.Transition(state, R1, UAV);
+    tracker.UavBarrier(R2);
+    tracker.Transition(state, R1, RT);
+    Check(TakeBarriers(tracker) == "R1:* SRV>RT; UAV R2");
+
+    tracker.Transition(state, R1, UAV);
+    tracker.AliasingBarrier(R2, R1);
+    tracker.Transition(state, R1, RT);
+    Check(TakeBarriers(tracker) == "R1:* RT>UAV; Alias; R1:* UAV>RT");
+
+    tracker.Transition(state, R1, UAV);
+    tracker.AliasingBarrier(nullptr, R2);
+    tracker.Transition(state, R1, RT);
+    Check(TakeBarriers(tracker) == "R1:* RT>UAV; Alias; R1:* UAV>RT");
+    tracker.CommandListEnded();
+}
+
+TEST(ResourceStateTracker, Subresources)
+{
+    ResourceStateTracker tracker(D3D12_COMMAND_LIST_TYPE_COMPUTE);
+    ResourceState state(SRV);
+    state.Initialize(4, false);
+
+    tracker.Transition(state, R1, UAV, 2);
+    Check(TakeBarriers(tracker) == "R1:2 SRV>UAV");
+    Check(!state.IsUniform());
+    Check(state.State(1) == SRV && state.State(2) == UAV);
+
+    // Transitioning a resource which isn't uniform needs a barrier per subresource...
+    tracker.Transition(state, R1, CS);
+    Check(TakeBarriers(tracker) == "R1:0 SRV>CS; R1:1 SRV>CS; R1:2 UAV>CS; R1:3 SRV>CS");
+    Check(state.IsUniform());
+
+    tracker.Transition(state, R1, SRV, 0);
+    Check(TakeBarriers(tracker) == "R1:0 CS>SRV");
+    tracker.Transition(state, R1, CS, 2);
+    Check(TakeBarriers(tracker) == "");
+    tracker.Transition(state, R1, UAV, 2);
+    tracker.Transition(state, R1, CS, 2);
+    Check(TakeBarriers(tracker) == "");
+    Check(!state.IsUniform());
+
+    tracker.Transition(state, R1, UAV);
+    Check(TakeBarriers(tracker) == "R1:0 SRV>UAV; R1:1 CS>UAV; R1:2 CS>UAV; R1:3 CS>UAV");
+
+    // ...but a uniform one only needs one
+    tracker.Transition(state, R1, SRV);
+    Check(TakeBarriers(tracker) == "R1:* UAV>SRV");
+
+    // Transitions of a single subresource don't merge with earlier ones of every subresource
+    tracker.Transition(state, R1, UAV);
+    tracker.Transition(state, R1, CS, 1);
+    Check(TakeBarriers(tracker) == "R1:* SRV>UAV; R1:1 UAV>CS");
+
+    tracker.Transition(state, R1, UAV, 1);
+    tracker.Transition(state, R1, UAV, 0);
+    tracker.Transition(state, R1, SRV, 1);
+    Check(TakeBarriers(tracker) == "R1:1 CS>SRV");
+
+    tracker.Transition(state, R1, SRV);
+    TakeBarriers(tracker);
+    tracker.CommandListEnded();
+}
+
+TEST(ResourceStateTracker, TexturePromotionAndDecay)
+{
+    ResourceStateTracker tracker(D3D12_COMMAND_LIST_TYPE_DIRECT);
+    ResourceState state;
+    state.Initialize(2, false);
+
+    // Nothing used the promoted state, so the promotion is rolled back
+    tracker.Transition(state, R1, PSRV);
+    Check(TakeBarriers(tracker) == "");
+    tracker.Transition(state, R1, RT);
+    Check(TakeBarriers(tracker) == "R1:* COMMON>RT");
+    tracker.Transition(state, R1, COMMON);
+    Check(TakeBarriers(tracker) == "R1:* RT>COMMON");
+
+    // Promoted read-only states accumulate
+    tracker.Transition(state, R1, PSRV);
+    tracker.WorkRecorded();
+    tracker.Transition(state, R1, SRV);
+    tracker.WorkRecorded();
+    Check(TakeBarriers(tracker) == "");
+    Check(state.State() == (PSRV | SRV));
+
+    // States reached through barriers don't decay
+    tracker.Transition(state, R1, RT);
+    Check(TakeBarriers(tracker) == "R1:* SRV|PSRV>RT");
+    tracker.CommandListEnded();
+    Check(state.State() == RT);
+
+    tracker.Transition(state, R1, COMMON);
+    TakeBarriers(tracker);
+    tracker.CommandListEnded();
+
+    // Promoted read-only states do
+    tracker.Transition(state, R1, SRV);
+    tracker.WorkRecorded();
+    tracker.CommandListEnded();
+    Check(TakeBarriers(tracker) == "");
+    Check(state.State() == COMMON);
+
+    // Textures can be promoted to copy destination, but nothing can be promoted from a promoted write
+    tracker.Transition(state, R1, CD);
+    Check(TakeBarriers(tracker) == "");
+    tracker.WorkRecorded();
+    tracker.Transition(state, R1, CS);
+    Check(TakeBarriers(tracker) == "R1:* CD>CS");
+    tracker.CommandListEnded();
+    Check(state.State() == CS);
+
+    tracker.Transition(state, R1, COMMON);
+    TakeBarriers(tracker);
+    tracker.CommandListEnded();
+
+    // Promoted writes to textures don't decay outside of copy queues
+    tracker.Transition(state, R1, CD, 0);
+    Check(TakeBarriers(tracker) == "");
+    tracker.WorkRecorded();
+    tracker.CommandListEnded();
+    Check(state.State(0) == CD && state.State(1) == COMMON);
+
+    // Render target, unordered access, and indirect argument states aren't promotable for textures
+    ResourceState texture;
+    texture.Initialize(1, false);
+    tracker.Transition(texture, R2, RT);
+    Check(TakeBarriers(tracker) == "R2:* COMMON>RT");
+    tracker.Transition(texture, R2, UAV);
+    Check(TakeBarriers(tracker) == "R2:* RT>UAV");
+    tracker.Transition(texture, R2, COMMON);
+    Check(TakeBarriers(tracker) == "R2:* UAV>COMMON");
+    tracker.CommandListEnded();
+
+    tracker.Transition(texture, R2, SRV | IA);
+    Check(TakeBarriers(tracker) == "R2:* COMMON>SRV|IA");
+    tracker.Transition(texture, R2, COMMON);
+    TakeBarriers(tracker);
+    tracker.CommandListEnded();
+}
+
+TEST(ResourceStateTracker, BufferPromotionAndDecay)
+{
+    ResourceStateTracker tracker(D3D12_COMMAND_LIST_TYPE_DIRECT);
+    ResourceState buffer(COMMON);
+    buffer.Initialize(1, true);
+
+    // Buffers can be promoted to any state, but not from a promoted write
+    tracker.Transition(buffer, R1, UAV);
+    Check(TakeBarriers(tracker) == "");
+    tracker.WorkRecorded();
+    tracker.Transition(buffer, R1, IA);
+    Check(TakeBarriers(tracker) == "R1:* UAV>IA");
+    tracker.CommandListEnded();
+    Check(buffer.State() == COMMON);
+
+    tracker.Transition(buffer, R1, IA);
+    tracker.WorkRecorded();
+    tracker.Transition(buffer, R1, SRV);
+    Check(TakeBarriers(tracker) == "");
+    Check(buffer.State() == (IA | SRV));
+    tracker.CommandListEnded();
+
+    // Buffers always decay, even when their state didn't come from a promotion
+    ResourceState explicitBuffer(UAV);
+    explicitBuffer.Initialize(1, true);
+    tracker.Transition(explicitBuffer, R2, UAV);
+    tracker.CommandListEnded();
+    Check(explicitBuffer.State() == COMMON);
+}
+
+TEST(ResourceStateTracker, EverythingDecaysOnCopyQueues)
+{
+    ResourceStateTracker tracker(D3D12_COMMAND_LIST_TYPE_COPY);
+    ResourceState texture;
+    texture.Initialize(3, false);
+
+    tracker.Transition(texture, R1, CD);
+    Check(TakeBarriers(tracker) == "");
+    tracker.WorkRecorded();
+    tracker.Transition(texture, R1, CS, 1);
+    Check(TakeBarriers(tracker) == "R1:1 CD>CS");
+    tracker.CommandListEnded();
+
+    Check(texture.IsUniform());
+    Check(texture.State() == COMMON);
+}
+
+TEST(ResourceStateTracker, SplitBarriers)
+{
+    ResourceStateTracker tracker(D3D12_COMMAND_LIST_TYPE_DIRECT);
+    ResourceState state(RT);
+    state.Initialize(2, false);
+
+    tracker.BeginTransition(state, R1, PSRV);
+    Check(TakeBarriers(tracker) == "Begin R1:* RT>PSRV");
+    tracker.Transition(state, R1, PSRV);
+    Check(TakeBarriers(tracker) == "End R1:* RT>PSRV");
+    tracker.Transition(state, R1, PSRV);
+    Check(TakeBarriers(tracker) == "");
+
+    tracker.BeginTransition(state, R1, RT, 1);
+    tracker.Transition(state, R1, UAV, 0);
+    Check(TakeBarriers(tracker) == "Begin R1:1 PSRV>RT; R1:0 PSRV>UAV");
+    tracker.Transition(state, R1, RT, 1);
+    tracker.Transition(state, R1, RT, 0);
+    Check(TakeBarriers(tracker) == "End R1:1 PSRV>RT; R1:0 UAV>RT");
+
+    // Split barriers are never merged with
+    tracker.BeginTransition(state, R1, UAV);
+    tracker.Transition(state, R1, UAV);
+    tracker.Transition(state, R1, RT);
+    Check(TakeBarriers(tracker) == "Begin R1:* RT>UAV; End R1:* RT>UAV; R1:* UAV>RT");
+
+    // Promotions have nothing to begin
+    ResourceState promoted;
+    promoted.Initialize(1, false);
+    tracker.BeginTransition(promoted, R2, SRV);
+    Check(TakeBarriers(tracker) == "");
+    tracker.Transition(promoted, R2, SRV);
+    Check(TakeBarriers(tracker) == "");
+    tracker.CommandListEnded();
+}
+
+TEST(ResourceStateTracker, RandomTransitions)
+{
+    // Every barrier the tracker emits is replayed against a model of the GPU's view of the resource. Work is recorded at random points and accesses every
+    // subresource transitioned since the last work, so a missing barrier shows up as an access the GPU can't satisfy through promotion.
+    std::mt19937 random(48);
+    const States NONE = (States)-1;
+    const States randomStates[] = { COMMON, UAV, SRV, PSRV, SRV | PSRV, RT, CD, CS, IA, DW, DR, DR | SRV };
+    uint32_t violationCount = 0;
+    uint32_t stateMismatchCount = 0;
+    uint32_t accessCount = 0;
+    uint32_t barrierCount = 0;
+
+    for (uint32_t iteration = 0; iteration < 20000; iteration++)
+    {
+        bool isStateless = random() % 2 == 0;
+        uint32_t subresourceCount = isStateless ? 1 : 1 + random() % 4;
+        bool isDepth = !isStateless && random() % 3 == 0;
+        D3D12_COMMAND_LIST_TYPE queueType = random() % 3 == 0 ? D3D12_COMMAND_LIST_TYPE_COPY : random() % 2 == 0 ? D3D12_COMMAND_LIST_TYPE_DIRECT : D3D12_COMMAND_LIST_TYPE_COMPUTE;
+        bool isCopyQueue = queueType == D3D12_COMMAND_LIST_TYPE_COPY;
+
+        // Resources used on copy queues and buffers are always in the common state between command lists
+        States initialState = isDepth ? DW : random() % 2 == 0 ? COMMON : randomStates[random() % std::size(randomStates)];
+        if (isCopyQueue || isStateless)
+        { initialState = COMMON; }
+
+        ResourceStateTracker tracker(queueType);
+        ResourceState state(initialState);
+        state.Initialize(subresourceCount, isStateless);
+        GpuModel gpu(subresourceCount, initialState, isStateless);
+
+        auto flushBarriers = [&]()
+            {
+                for (const D3D12_RESOURCE_BARRIER& barrier : tracker.PendingBarriers())
+                {
+                    gpu.Barrier(barrier);
+                    barrierCount++;
+                }
+                tracker.ClearPendingBarriers();
+            };
+
+        for (uint32_t commandList = 0; commandList < 3; commandList++)
+        {
+            // The state each subresource will be accessed in by the next work, NONE when it won't be accessed
+            std::vector<States> accessStates(subresourceCount, NONE);
+            auto setAccessState = [&](uint32_t subresource, States desiredState)
+                {
+                    if (subresource == ALL)
+                    { std::fill(accessStates.begin(), accessStates.end(), desiredState); }
+                    else
+                    { accessStates[subresource] = desiredState; }
+                };
+
+            std::vector<std::pair<uint32_t, States>> splitTransitions;
+            for (uint32_t operation = 0; operation < 20; operation++)
+            {
+                States desiredState;
+                if (isCopyQueue)
+                { desiredState = random() % 2 == 0 ? CD : CS; }
+                else
+                {
+                    desiredState = randomStates[random() % std::size(randomStates)];
+                    bool isDepthState = desiredState == DW || desiredState == DR || desiredState == (DR | SRV);
+                    if (isStateless && (desiredState == RT || isDepthState))
+                    { desiredState = UAV; }
+                    else if (!isDepth && isDepthState)
+                    { desiredState = RT; }
+                    else if (isDepth && desiredState == RT)
+                    { desiredState = DW; }
+                }
+
+                uint32_t subresource = random() % 3 == 0 ? ALL : random() % subresourceCount;
+                uint32_t kind = random() % 10;
+
+                bool overlapsSplit = false;
+                for (const auto& [splitSubresource, splitState] : splitTransitions)
+                { overlapsSplit |= splitSubresource == subresource || splitSubresource == ALL || subresource == ALL; }
+
+                if (kind == 0 && !overlapsSplit && desiredState != COMMON)
+                {
+                    tracker.BeginTransition(state, R1, desiredState, subresource);
+                    splitTransitions.push_back({ subresource, desiredState });
+                    setAccessState(subresource, NONE);
+                    continue;
+                }
+
+                // Split barriers are ended before anything else touches the resource
+                if (overlapsSplit)
+                {
+                    for (const auto& [splitSubresource, splitState] : splitTransitions)
+                    {
+                        tracker.Transition(state, R1, splitState, splitSubresource);
+                        setAccessState(splitSubresource, splitState);
+                    }
+                    splitTransitions.clear();
+                }
+
+                if (kind == 1)
+                { tracker.UavBarrier(random() % 2 == 0 ? R1 : nullptr); }
+
+                tracker.Transition(state, R1, desiredState, subresource);
+                setAccessState(subresource, desiredState);
+
+                if (random() % 3 == 0)
+                {
+                    flushBarriers();
+                    tracker.WorkRecorded();
+                    for (uint32_t i = 0; i < subresourceCount; i++)
+                    {
+                        if (accessStates[i] == COMMON || accessStates[i] == NONE)
+                        { continue; }
+
+                        gpu.Access(i, accessStates[i]);
+                        accessCount++;
+                    }
+                    setAccessState(ALL, NONE);
+                }
+            }
+
+            for (const auto& [splitSubresource, splitState] : splitTransitions)
+            { tracker.Transition(state, R1, splitState, splitSubresource); }
+
+            flushBarriers();
+            tracker.CommandListEnded();
+            gpu.CommandListEnded(isCopyQueue);
+
+            for (uint32_t i = 0; i < subresourceCount; i++)
+            { stateMismatchCount += gpu.Subresources[i].State != state.State(i); }
+        }
+
+        violationCount += gpu.ViolationCount;
+    }
+
+    Check(violationCount == 0);
+    Check(stateMismatchCount == 0);
+    Check(accessCount > 100000);
+    Check(barrierCount > 100000);
+}
@@ -0,0 +1,278 @@
+#include "pch.h"
+#include "ShaderCache.h"
+#include "TestFramework.h"
+
+#include <algorithm>
+#include <fstream>
+#include <random>
+#include <thread>
+
+namespace
+{
+    // A scratch directory which is removed when the test is done with it
+    struct TemporaryDirectory
+    {
+        std::filesystem::path Path;
+
+        TemporaryDirectory()
+        {
+            std::random_device random;
+            Path = std::filesystem::temp_directory_path() / std::format("ThreeL.Tests.{:08x}{:08x}", random(), random());
+            std::filesystem::create_directories(Path);
+        }
+
+        ~TemporaryDirectory()
+        {
+            std::error_code error;
+            std::filesystem::remove_all(Path, error);
+        }
+    };
+
+    void WriteText(const std::filesystem::path& path, const char* text)
+    {
+        std::filesystem::create_directories(path.parent_path());
+        std::ofstream(path, std::ios::binary | std::ios::trunc) << text;
+    }
+
+    // Stands in for the compiler, every compilation produces distinct output so that cache hits can be told apart from recompiles
+    struct FakeCompiler
+    {
+        uint32_t CompileCount = 0;
+
+        std::optional<CachedShader> operator()()
+        {
+            CompileCount++;
+            return CachedShader
+            {
+                .Shader = { 0xDE, 0xAD, (uint8_t)CompileCount, (uint8_t)(CompileCount >> 8) },
+                .RootSignature = { 0x42, (uint8_t)CompileCount },
+            };
+        }
+    };
+
+    std::vector<std::filesystem::path> CacheFiles(const std::filesystem::path& directory)
+    {
+        std::vector<std::filesystem::path> result;
+        for (const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator(directory))
+        { result.push_back(entry.path()); }
+        return result;
+    }
+
+    struct ShaderTree
+    {
+        TemporaryDirectory Directory;
+        std::filesystem::path Source;
+        std::filesystem::path Common;
+        std::filesystem::path Nested;
+        std::filesystem::path Missing;
+        ShaderCacheRequest Request;
+
+        ShaderTree()
+        {
+            std::filesystem::path shaders = Directory.Path / "Shaders";
+            Source = shaders / "Test.cs.hlsl";
+            Common = shaders / "Common.hlsli";
+            Nested = shaders / "Sub" / "Nested.hlsli";
+            Missing = shaders / "Sub" / "Missing.hlsli";
+
+            WriteText(Source, "#include \"Common.hlsli\"\n  #  include <Sub/Nested.hlsli>\n#if 0\n#include \"Sub/Nested.hlsli\"\n#endif\n[numthreads(64, 1, 1)] void main() { }\n");
+            WriteText(Common, "// Includes itself, which must not loop forever\n#include \"Common.hlsli\"\n");
+            WriteText(Nested, "#include \"../Common.hlsli\"\n#include \"Missing.hlsli\"\n");
+
+            Request =
+            {
+                .SourcePath = Source,
+                .EntryPoint = L"main",
+                .Target = L"cs_6_0",
+                .Defines = { L"FOO=1" },
+                .Arguments = { L"-Zpr" },
+            };
+        }
+    };
+}
+
+TEST(ShaderCache, IncludeClosure)
+{
+    ShaderTree tree;
+    std::vector<std::filesystem::path> closure = ShaderCache::IncludeClosure(tree.Source);
+
+    // Every file appears once in the order it was first included, including the missing one
+    std::vector<std::filesystem::path> expected = { tree.Source, tree.Common, tree.Nested, tree.Missing };
+    Require(closure.size() == expected.size());
+    for (size_t i = 0; i < expected.size(); i++)
+    { Check(closure[i] == expected[i].lexically_normal()); }
+}
+
+TEST(ShaderCache, HitsUntilAnythingChanges)
+{
+    ShaderTree tree;
+    ShaderCache cache(tree.Directory.Path / "Cache", "fake 1.0");
+    FakeCompiler compiler;
+    auto compile = [&]() { return compiler(); };
+
+    std::optional<CachedShader> first = cache.GetOrCompile(tree.Request, compile);
+    std::optional<CachedShader> second = cache.GetOrCompile(tree.Request, compile);
+    Require(first.has_value() && second.has_value());
+    Check(compiler.CompileCount == 1);
+    Check(cache.MissCount() == 1 && cache.HitCount() == 1);
+    Check(first->Shader == second->Shader);
+    Check(first->RootSignature == second->RootSignature);
+
+    // A second cache sharing the directory (IE: the next run) hits too
+    {
+        ShaderCache other(cache.Directory(), "fake 1.0");
+        other.GetOrCompile(tree.Request, compile);
+        Check(compiler.CompileCount == 1);
+    }
+
+    // Each of these must miss once and then hit again
+    auto CheckMissesOnce = [&](const char* change)
+        {
+            uint32_t compileCount = compiler.CompileCount;
+            cache.GetOrCompile(tree.Request, compile);
+            cache.GetOrCompile(tree.Request, compile);
+            if (compiler.CompileCount != compileCount + 1)
+            {
+                printf("    Changing %s didn't miss exactly once\n", change);
+                Check(compiler.CompileCount == compileCount + 1);
+            }
+        };
+
+    WriteText(tree.Common, "// Edited\n");
+    CheckMissesOnce("an included file");
+
+    WriteText(tree.Missing, "// Created\n");
+    CheckMissesOnce("a missing include");
+
+    tree.Request.Defines = { L"FOO=2" };
+    CheckMissesOnce("a define");
+
+    // The same string as a define or an argument must not produce the same key
+    tree.Request.Defines = { };
+    tree.Request.Arguments = { L"-Zpr", L"FOO=2" };
+    CheckMissesOnce("a define into an argument");
+
+    tree.Request.Arguments = { L"-Zpr", L"FOO=", L"2" };
+    CheckMissesOnce("how arguments are split");
+
+    tree.Request.EntryPoint = L"main2";
+    CheckMissesOnce("the entry point");
+
+    tree.Request.Target = L"cs_6_6";
+    CheckMissesOnce("the target");
+
+    {
+        ShaderCache newerCompiler(cache.Directory(), "fake 1.1");
+        uint32_t compileCount = compiler.CompileCount;
+        newerCompiler.GetOrCompile(tree.Request, compile);
+        Check(compiler.CompileCount == compileCount + 1);
+    }
+
+    // No temporary files are left behind
+    for (const std::filesystem::path& file : CacheFiles(cache.Directory()))
+    { Check(file.extension() == ".bin"); }
+}
+
+TEST(ShaderCache, IgnoresCorruptEntries)
+{
+    ShaderTree tree;
+    ShaderCache cache(tree.Directory.Path / "Cache", "fake 1.0");
+    FakeCompiler compiler;
+    auto compile = [&]() { return compiler(); };
+
+    std::string key = cache.ComputeKey(tree.Request);
+    std::filesystem::path entryPath = cache.Directory() / (key + ".bin");
+    std::optional<CachedShader> expected = cache.GetOrCompile(tree.Request, compile);
+    Require(std::filesystem::exists(entryPath));
+    uint64_t entrySize = std::filesystem::file_size(entryPath);
+
+    // Flip a bit of the payload, truncate the file, and then clobber the header
+    for (uint32_t corruption = 0; corruption < 3; corruption++)
+    {
+        {
+            std::fstream file(entryPath, std::ios::in | std::ios::out | std::ios::binary);
+            if (corruption == 0)
+            {
+                file.seekg(entrySize - 1);
+                char last = (char)file.get();
+                file.seekp(entrySize - 1);
+                file.put(last ^ 1);
+            }
+            else if (corruption == 2)
+            { file.write("garbage!", 8); }
+        }
+
+        if (corruption == 1)
+        { std::filesystem::resize_file(entryPath, entrySize - 1); }
+
+        Check(!cache.Load(key).has_value());
+
+        // The corrupt entry is recompiled and replaced
+        uint32_t compileCount = compiler.CompileCount;
+        std::optional<CachedShader> result = cache.GetOrCompile(tree.Request, compile);
+        Check(compiler.CompileCount == compileCount + 1);
+        Require(result.has_value());
+        Check(cache.Load(key).has_value());
+    }
+}
+
+TEST(ShaderCache, FailedCompilationsArentCached)
+{
+    ShaderTree tree;
+    ShaderCache cache(tree.Directory.Path / "Cache", "fake 1.0");
+    uint32_t attemptCount = 0;
+    auto fail = [&]() -> std::optional<CachedShader> { attemptCount++; return std::nullopt; };
+
+    Check(!cache.GetOrCompile(tree.Request, fail).has_value());
+    Check(!cache.GetOrCompile(tree.Request, fail).has_value());
+    Check(attemptCount == 2);
+    Check(!std::filesystem::exists(cache.Directory()) || CacheFiles(cache.Directory()).empty());
+}
+
+TEST(ShaderCache, EmptyRootSignatureRoundTrips)
+{
+    ShaderTree tree;
+    ShaderCache cache(tree.Directory.Path / "Cache", "fake 1.0");
+    CachedShader shader = { .Shader = { 1, 2, 3 } };
+    cache.Store("0123456789abcdef", shader);
+
+    std::optional<CachedShader> loaded = cache.Load("0123456789abcdef");
+    Require(loaded.has_value());
+    Check(loaded->Shader == shader.Shader);
+    Check(loaded->RootSignature.empty());
+}
+
+TEST(ShaderCache, ConcurrentWritersShareTheCache)
+{
+    // Several threads (standing in for processes) missing the same entry at once must all end up with a valid entry and no leftovers
+    ShaderTree tree;
+    std::filesystem::path directory = tree.Directory.Path / "Cache";
+    std::string key = ShaderCache(directory, "fake 1.0").ComputeKey(tree.Request);
+
+    CachedShader shader = { .Shader = std::vector<uint8_t>(64 * 1024, 0x5A), .RootSignature = { 7, 7, 7 } };
+    std::vector<std::thread> threads;
+    for (uint32_t i = 0; i < 8; i++)
+    {
+        threads.emplace_back([&]()
+            {
+                ShaderCache cache(directory, "fake 1.0");
+                for (uint32_t j = 0; j < 20; j++)
+                {
+                    cache.Store(key, shader);
+                    std::optional<CachedShader> loaded = cache.Load(key);
+                    // Loads racing with renames may miss on some platforms, but they must never return a torn entry
+                    if (loaded.has_value())
+                    { Check(loaded->Shader == shader.Shader && loaded->RootSignature == shader.RootSignature); }
+                }
+            });
+    }
+
+    for (std::thread& thread : threads)
+    { thread.join(); }
+
+    std::vector<std::filesystem::path> files = CacheFiles(directory);
+    Check(files.size() == 1);
+    std::optional<CachedShader> loaded = ShaderCache(directory, "fake 1.0").Load(key);
+    Require(loaded.has_value());
+    Check(loaded->Shader == shader.Shader);
+}
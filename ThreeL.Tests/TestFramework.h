@@ -0,0 +1,31 @@
+#pragma once
+#include <stdint.h>
+
+//! A test registered with the TEST macro, see Main.cpp for how they're run
+struct TestCase
+{
+    const char* Suite;
+    const char* Name;
+    void (*Function)();
+};
+
+void RegisterTest(const TestCase& test);
+void ReportCheckFailure(const char* condition, const char* fileName, int lineNumber);
+
+struct TestRegistration
+{
+    TestRegistration(const TestCase& test) { RegisterTest(test); }
+};
+
+//! Defines and registers a test, tests are named Suite.Name
+#define TEST(suite, name) \
+    static void Test_##suite##_##name(); \
+    static TestRegistration _TestRegistration_##suite##_##name({ .Suite = #suite, .Name = #name, .Function = Test_##suite##_##name }); \
+    static void Test_##suite##_##name()
+
+//! Records a failure of the current test when the condition is false, the test keeps running
+#define Check(cond) (void)((!!(cond)) || (ReportCheckFailure(#cond, __FILE__, __LINE__), 0))
+
+//! Records a failure of the current test and returns from it when the condition is false
+//! Use this when the rest of the test would be meaningless (or would crash) after a failure.
+#define Require(cond) do { if (!(cond)) { ReportCheckFailure(#cond, __FILE__, __LINE__); return; } } while (false)
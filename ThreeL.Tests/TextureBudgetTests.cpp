@@ -0,0 +1,251 @@
+#include "pch.h"
+#include "TextureBudget.h"
+#include "TestFramework.h"
+
+#include <random>
+
+TEST(TextureBudget, MipMath)
+{
+    Check(TextureBudget::MipCount(uint2(1, 1)) == 1);
+    Check(TextureBudget::MipCount(uint2(256, 64)) == 9);
+    Check(TextureBudget::MipCount(uint2(300, 7)) == 9);
+
+    uint2 size = TextureBudget::MipSize(uint2(300, 7), 3);
+    Check(size.x == 37 && size.y == 1);
+    size = TextureBudget::MipSize(uint2(300, 7), 8);
+    Check(size.x == 1 && size.y == 1);
+
+    Check(TextureBudget::MipChainBytes(uint2(4, 4), 0) == (16 + 4 + 1) * 4);
+    Check(TextureBudget::MipChainBytes(uint2(4, 4), 2) == 4);
+    Check(TextureBudget::MipChainBytes(uint2(4, 4), 3) == 0);
+
+    Check(TextureBudget::FloorMip(uint2(1024, 256), 64) == 4);
+    Check(TextureBudget::FloorMip(uint2(64, 64), 64) == 0);
+    Check(TextureBudget::FloorMip(uint2(1, 1), 64) == 0);
+    Check(TextureBudget::FloorMip(uint2(8, 8), 0) == 3);
+}
+
+TEST(TextureBudget, UnusedTexturesOnlyWantTheirFloorMip)
+{
+    const uint2 size(256, 256);
+    TextureBudget budget;
+    uint32_t used = budget.AddTexture(size, 2);
+    uint32_t unused = budget.AddTexture(size, 2);
+    Check(budget.TargetMip(used) == 2);
+
+    budget.MarkUsed(used, 1);
+    budget.Update();
+    Check(budget.TargetMip(used) == 0);
+    Check(budget.TargetMip(unused) == 2);
+
+    const TextureBudgetStatistics& statistics = budget.Statistics();
+    Check(statistics.WantedBytes == TextureBudget::MipChainBytes(size, 0) + TextureBudget::MipChainBytes(size, 2));
+    Check(statistics.TargetBytes == statistics.WantedBytes);
+    Check(statistics.EvictedMipCount == 0);
+    Check(!statistics.IsOverBudget);
+}
+
+TEST(TextureBudget, EvictsLeastRecentlyUsedFirst)
+{
+    const uint2 size(256, 256);
+    const uint64_t fullBytes = TextureBudget::MipChainBytes(size, 0);
+    TextureBudget budget;
+    uint32_t older = budget.AddTexture(size, 2);
+    uint32_t newer = budget.AddTexture(size, 2);
+    budget.MarkUsed(older, 1);
+    budget.MarkUsed(newer, 2);
+
+    // Only the older texture loses its top mip
+    budget.SetBudget(fullBytes + TextureBudget::MipChainBytes(size, 1));
+    budget.Update();
+    Check(budget.TargetMip(older) == 1);
+    Check(budget.TargetMip(newer) == 0);
+    Check(budget.Statistics().EvictedMipCount == 1);
+
+    // The older texture is dropped to its floor before the newer one loses anything
+    budget.SetBudget(fullBytes + TextureBudget::MipChainBytes(size, 2));
+    budget.Update();
+    Check(budget.TargetMip(older) == 2);
+    Check(budget.TargetMip(newer) == 0);
+
+    budget.SetBudget(fullBytes);
+    budget.Update();
+    Check(budget.TargetMip(older) == 2);
+    Check(budget.TargetMip(newer) == 1);
+    Check(budget.Statistics().TargetBytes <= fullBytes);
+    Check(!budget.Statistics().IsOverBudget);
+
+    // Using the older texture again makes it the newer one
+    budget.MarkUsed(older, 3);
+    budget.SetBudget(fullBytes + TextureBudget::MipChainBytes(size, 1));
+    budget.Update();
+    Check(budget.TargetMip(older) == 0);
+    Check(budget.TargetMip(newer) == 1);
+}
+
+TEST(TextureBudget, TexturesUsedTogetherLoseTheirLargestMipsFirst)
+{
+    TextureBudget budget;
+    uint32_t large = budget.AddTexture(uint2(512, 512), 3);
+    uint32_t small = budget.AddTexture(uint2(256, 256), 2);
+    budget.MarkUsed(large, 5);
+    budget.MarkUsed(small, 5);
+
+    // Dropping the large texture's top mip frees enough on its own
+    uint64_t wantedBytes = TextureBudget::MipChainBytes(uint2(512, 512), 0) + TextureBudget::MipChainBytes(uint2(256, 256), 0);
+    budget.SetBudget(wantedBytes - 1);
+    budget.Update();
+    Check(budget.TargetMip(large) == 1);
+    Check(budget.TargetMip(small) == 0);
+
+    // Afterwards both top mips are the same size, so they take turns
+    budget.SetBudget(wantedBytes - 512 * 512 * 4 - 1);
+    budget.Update();
+    Check(budget.TargetMip(large) + budget.TargetMip(small) == 2);
+    Check(budget.Statistics().EvictedMipCount == 2);
+}
+
+TEST(TextureBudget, NeverDropsBelowTheFloor)
+{
+    const uint2 size(256, 256);
+    TextureBudget budget(0);
+    uint32_t a = budget.AddTexture(size, 2);
+    uint32_t b = budget.AddTexture(size, 2);
+    budget.MarkUsed(a, 1);
+    budget.MarkUsed(b, 2);
+    budget.Update();
+
+    const TextureBudgetStatistics& statistics = budget.Statistics();
+    Check(budget.TargetMip(a) == 2 && budget.TargetMip(b) == 2);
+    Check(statistics.IsOverBudget);
+    Check(statistics.EvictedMipCount == 4);
+    Check(statistics.TargetBytes == 2 * TextureBudget::MipChainBytes(size, 2));
+}
+
+TEST(TextureBudget, RemovedTexturesDontCount)
+{
+    const uint2 size(128, 128);
+    TextureBudget budget(TextureBudget::MipChainBytes(size, 0));
+    uint32_t removed = budget.AddTexture(size, 1);
+    uint32_t kept = budget.AddTexture(size, 1);
+    budget.MarkUsed(removed, 1);
+    budget.MarkUsed(kept, 1);
+    budget.RemoveTexture(removed);
+    Check(budget.TargetMip(removed) == TextureBudget::MipCount(size));
+
+    budget.Update();
+    Check(budget.TargetMip(removed) == TextureBudget::MipCount(size));
+    Check(budget.TargetMip(kept) == 0);
+    Check(budget.Statistics().WantedBytes == TextureBudget::MipChainBytes(size, 0));
+    Check(budget.Statistics().EvictedMipCount == 0);
+}
+
+TEST(TextureBudget, SimulatesRecordedTraces)
+{
+    // Eight textures used one after the other, the budget either fits all of them or only two
+    TextureUsageTrace trace;
+    const uint2 size(512, 512);
+    for (uint32_t i = 0; i < 8; i++)
+    { trace.TextureSizes.push_back(size); }
+    for (uint32_t frame = 0; frame < 100; frame++)
+    { trace.FrameUsage.push_back({ frame % 8 }); }
+
+    const uint64_t fullBytes = TextureBudget::MipChainBytes(size, 0);
+    TextureBudgetSimulation large = SimulateTextureBudget(trace, fullBytes * 8, 64);
+    Check(large.UseCount == 100);
+    Check(large.EvictedBytes == 0);
+    Check(large.StreamedBytes == fullBytes * 8);
+    Check(large.DegradedUseCount == 8); // Only the first use of each texture
+
+    // Each texture is evicted before it comes around again
+    TextureBudgetSimulation small = SimulateTextureBudget(trace, fullBytes * 2, 64);
+    Check(small.EvictedBytes > 0);
+    Check(small.DegradedUseCount == 100);
+    Check(small.PeakTargetBytes <= fullBytes * 2);
+    Check(small.StreamedBytes - small.EvictedBytes <= small.PeakTargetBytes);
+}
+
+TEST(TextureBudget, RandomUsage)
+{
+    // Checks the properties of the budget against a shadow of when each texture was last used
+    std::mt19937 random(47);
+    const uint32_t textureCount = 64;
+    const uint32_t floorMipSize = 32;
+    TextureBudget budget;
+    std::vector<uint2> sizes;
+    std::vector<int64_t> lastUsed(textureCount, -1);
+    std::vector<bool> isRemoved(textureCount, false);
+    uint64_t floorBytes = 0;
+    for (uint32_t i = 0; i < textureCount; i++)
+    {
+        uint2 size(1u << (random() % 12), 1u << (random() % 12));
+        sizes.push_back(size);
+        budget.AddTexture(size, TextureBudget::FloorMip(size, floorMipSize));
+        floorBytes += TextureBudget::MipChainBytes(size, TextureBudget::FloorMip(size, floorMipSize));
+    }
+
+    uint32_t lruViolationCount = 0;
+    uint32_t overBudgetCount = 0;
+    uint32_t evictingFrameCount = 0;
+    for (uint64_t frame = 1; frame < 2000; frame++)
+    {
+        uint32_t useCount = random() % 8;
+        for (uint32_t i = 0; i < useCount; i++)
+        {
+            uint32_t texture = random() % textureCount;
+            budget.MarkUsed(texture, frame);
+            lastUsed[texture] = (int64_t)frame;
+        }
+
+        if (frame % 500 == 0)
+        {
+            uint32_t texture = random() % textureCount;
+            budget.RemoveTexture(texture);
+            isRemoved[texture] = true;
+        }
+
+        if (random() % 20 == 0)
+        { budget.SetBudget(floorBytes + random() % (64 * 1024 * 1024)); }
+
+        budget.Update();
+
+        uint64_t targetBytes = 0;
+        uint64_t wantedBytes = 0;
+        for (uint32_t i = 0; i < textureCount; i++)
+        {
+            uint32_t target = budget.TargetMip(i);
+            if (isRemoved[i])
+            {
+                Check(target == TextureBudget::MipCount(sizes[i]));
+                continue;
+            }
+
+            uint32_t floorMip = TextureBudget::FloorMip(sizes[i], floorMipSize);
+            uint32_t wantedMip = lastUsed[i] >= 0 ? 0 : floorMip;
+            Check(target >= wantedMip && target <= floorMip);
+            targetBytes += TextureBudget::MipChainBytes(sizes[i], target);
+            wantedBytes += TextureBudget::MipChainBytes(sizes[i], wantedMip);
+
+            // A texture only loses mips once every texture used less recently than it is at its floor
+            if (target == wantedMip)
+            { continue; }
+
+            for (uint32_t j = 0; j < textureCount; j++)
+            {
+                if (!isRemoved[j] && lastUsed[j] >= 0 && lastUsed[j] < lastUsed[i] && budget.TargetMip(j) != TextureBudget::FloorMip(sizes[j], floorMipSize))
+                { lruViolationCount++; }
+            }
+        }
+
+        const TextureBudgetStatistics& statistics = budget.Statistics();
+        Check(statistics.TargetBytes == targetBytes);
+        Check(statistics.WantedBytes == wantedBytes);
+        Check(statistics.IsOverBudget == (targetBytes > budget.Budget()));
+        overBudgetCount += statistics.IsOverBudget;
+        evictingFrameCount += statistics.EvictedMipCount > 0;
+    }
+
+    Check(lruViolationCount == 0);
+    Check(overBudgetCount == 0);
+    Check(evictingFrameCount > 100);
+}
@@ -0,0 +1,466 @@
+#include "pch.h"
+#include "TextureStreamer.h"
+#include "TestFramework.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <random>
+#include <thread>
+
+namespace
+{
+    // Images are "encoded" as their size followed by a seed for a deterministic pattern, a seed of 255 fails to decode
+    std::vector<uint8_t> EncodeImage(uint2 size, uint8_t seed)
+    {
+        std::vector<uint8_t> encodedData(9);
+        std::memcpy(&encodedData[0], &size.x, 4);
+        std::memcpy(&encodedData[4], &size.y, 4);
+        encodedData[8] = seed;
+        return encodedData;
+    }
+
+    bool DecodeImage(std::span<const uint8_t> encodedData, std::vector<uint8_t>* outRgbaData, uint2* outSize)
+    {
+        if (encodedData[8] == 255)
+        { return false; }
+
+        std::memcpy(&outSize->x, &encodedData[0], 4);
+        std::memcpy(&outSize->y, &encodedData[4], 4);
+        outRgbaData->resize((size_t)outSize->x * outSize->y * 4);
+        for (size_t i = 0; i < outRgbaData->size(); i++)
+        { (*outRgbaData)[i] = (uint8_t)(encodedData[8] + i * 7 + (i >> 9)); }
+        return true;
+    }
+
+    //! Stands in for GpuTextureStreamer, mips either land as soon as they're uploaded or once the test says so
+    //! Everything the sink contract forbids is counted as a violation rather than asserted so that a broken streamer fails the test instead of crashing it.
+    class FakeUploadSink : public TextureUploadSink
+    {
+    private:
+        struct SinkTexture
+        {
+            uint32_t MipCount;
+            uint32_t AllocatedMip;
+            std::vector<std::vector<uint8_t>> Mips;
+            std::vector<bool> IsLanded;
+        };
+
+        std::vector<SinkTexture> m_Textures;
+
+    public:
+        struct Upload
+        {
+            StreamedTextureId Texture;
+            uint32_t MipLevel;
+        };
+
+        TextureStreamer* Streamer = nullptr;
+        bool IsImmediate = true;
+        std::vector<Upload> Uploads;
+        std::vector<Upload> PendingUploads;
+        uint32_t AllocationCount = 0;
+        uint32_t FlushCount = 0;
+        uint32_t ViolationCount = 0;
+
+        //! Must be called for each texture in the same order they're registered with the streamer
+        void AddTexture(uint2 size)
+        {
+            uint32_t mipCount = TextureBudget::MipCount(size);
+            m_Textures.push_back({ .MipCount = mipCount, .AllocatedMip = mipCount, .Mips = std::vector<std::vector<uint8_t>>(mipCount), .IsLanded = std::vector<bool>(mipCount) });
+        }
+
+        void AllocateMips(StreamedTextureId id, uint32_t mostDetailedMip, uint32_t preserveFromMip) override
+        {
+            SinkTexture& texture = m_Textures[id];
+            AllocationCount++;
+            if (mostDetailedMip >= texture.MipCount || preserveFromMip < mostDetailedMip || preserveFromMip > texture.MipCount)
+            {
+                ViolationCount++;
+                return;
+            }
+
+            // Preserved mips must be in the old allocation and must have been uploaded to it (even if they haven't landed yet)
+            if (preserveFromMip < texture.MipCount && preserveFromMip < texture.AllocatedMip)
+            { ViolationCount++; }
+            for (uint32_t mipLevel = preserveFromMip; mipLevel < texture.MipCount; mipLevel++)
+            {
+                if (texture.Mips[mipLevel].empty())
+                { ViolationCount++; }
+            }
+
+            // Uploads in flight to the mips which are being discarded would be lost
+            for (const Upload& upload : PendingUploads)
+            {
+                if (upload.Texture == id && upload.MipLevel < preserveFromMip)
+                { ViolationCount++; }
+            }
+
+            for (uint32_t mipLevel = 0; mipLevel < preserveFromMip; mipLevel++)
+            {
+                texture.Mips[mipLevel].clear();
+                texture.IsLanded[mipLevel] = false;
+            }
+            texture.AllocatedMip = mostDetailedMip;
+        }
+
+        void UploadMip(StreamedTextureId id, uint32_t mipLevel, uint2 size, std::span<const uint8_t> rgbaData) override
+        {
+            SinkTexture& texture = m_Textures[id];
+            if (mipLevel < texture.AllocatedMip || rgbaData.size() != (size_t)size.x * size.y * 4 || !texture.Mips[mipLevel].empty())
+            { ViolationCount++; }
+
+            texture.Mips[mipLevel].assign(rgbaData.begin(), rgbaData.end());
+            Uploads.push_back({ .Texture = id, .MipLevel = mipLevel });
+
+            if (IsImmediate)
+            { Land(id, mipLevel); }
+            else
+            { PendingUploads.push_back({ .Texture = id, .MipLevel = mipLevel }); }
+        }
+
+        void FlushUploads() override
+        { FlushCount++; }
+
+        //! Lands the specified number of pending uploads, picked at random
+        void LandPendingUploads(size_t count, std::mt19937& random)
+        {
+            std::shuffle(PendingUploads.begin(), PendingUploads.end(), random);
+            count = std::min(count, PendingUploads.size());
+            std::vector<Upload> landing(PendingUploads.end() - count, PendingUploads.end());
+            PendingUploads.resize(PendingUploads.size() - count);
+            for (const Upload& upload : landing)
+            { Land(upload.Texture, upload.MipLevel); }
+        }
+
+        //! Checks that every mip the streamer claims is resident has actually landed in the current allocation
+        void CheckResidency(const TextureResidencyChange& change)
+        {
+            const SinkTexture& texture = m_Textures[change.Texture];
+            if (change.MostDetailedMip < texture.AllocatedMip && change.MostDetailedMip != texture.MipCount)
+            { ViolationCount++; }
+
+            for (uint32_t mipLevel = change.MostDetailedMip; mipLevel < texture.MipCount; mipLevel++)
+            {
+                if (!texture.IsLanded[mipLevel])
+                { ViolationCount++; }
+            }
+        }
+
+        inline uint32_t AllocatedMip(StreamedTextureId id) const { return m_Textures[id].AllocatedMip; }
+        inline const std::vector<uint8_t>& Mip(StreamedTextureId id, uint32_t mipLevel) const { return m_Textures[id].Mips[mipLevel]; }
+
+    private:
+        void Land(StreamedTextureId id, uint32_t mipLevel)
+        {
+            SinkTexture& texture = m_Textures[id];
+            if (mipLevel < texture.AllocatedMip)
+            { ViolationCount++; }
+
+            texture.IsLanded[mipLevel] = true;
+            Streamer->MipUploaded(id, mipLevel);
+        }
+    };
+
+    //! Waits for the workers to finish decoding, or gives up after a generous timeout so that a broken streamer fails rather than hangs
+    bool WaitForDecodes(TextureStreamer& streamer)
+    {
+        for (int i = 0; i < 10000; i++)
+        {
+            TextureStreamerStatistics statistics = streamer.Statistics();
+            if (statistics.WaitingCount == 0 && statistics.DecodingCount == 0)
+            { return true; }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return false;
+    }
+
+    StreamedTextureId Register(TextureStreamer& streamer, FakeUploadSink& sink, uint2 size, uint8_t seed, bool isSrgb = false)
+    {
+        sink.AddTexture(size);
+        return streamer.Register(EncodeImage(size, seed), size, isSrgb);
+    }
+
+    void CheckResidencyChanges(TextureStreamer& streamer, FakeUploadSink& sink)
+    {
+        for (const TextureResidencyChange& change : streamer.TakeResidencyChanges())
+        { sink.CheckResidency(change); }
+    }
+}
+
+TEST(TextureStreamer, StreamsTailMipsFirstThenByPriority)
+{
+    FakeUploadSink sink;
+    TextureStreamer streamer(sink, DecodeImage);
+    sink.Streamer = &streamer;
+    StreamedTextureId a = Register(streamer, sink, uint2(1024, 1024), 1);
+    StreamedTextureId b = Register(streamer, sink, uint2(512, 256), 2);
+    Check(streamer.MostDetailedResidentMip(a) == 11);
+
+    // Unused textures only want their tail mips, which are uploaded regardless of the upload budget
+    Require(WaitForDecodes(streamer));
+    streamer.Update(0);
+    CheckResidencyChanges(streamer, sink);
+    Check(streamer.MostDetailedResidentMip(a) == 4);
+    Check(streamer.MostDetailedResidentMip(b) == 3);
+    Check(sink.Uploads.size() == 7 + 7);
+    Check(sink.Uploads.front().Texture == a && sink.Uploads.front().MipLevel == 10);
+    Check(sink.AllocationCount == 2);
+    Check(sink.FlushCount == 1);
+
+    // Using the textures makes them want their detail mips, which have to be decoded again since only the wanted ones were kept
+    streamer.ReportUsage(a, 1.f);
+    streamer.ReportUsage(b, 0.5f);
+    streamer.Update(0);
+    Check(streamer.Statistics().Budget.WantedBytes == TextureBudget::MipChainBytes(uint2(1024, 1024), 0) + TextureBudget::MipChainBytes(uint2(512, 256), 0));
+    Require(WaitForDecodes(streamer));
+
+    // The upload budget always allows at least one mip, which goes to the texture with the highest priority
+    size_t uploadCount = sink.Uploads.size();
+    streamer.Update(0);
+    Require(sink.Uploads.size() == uploadCount + 1);
+    Check(sink.Uploads.back().Texture == a && sink.Uploads.back().MipLevel == 3);
+    Check(sink.AllocatedMip(a) == 0);
+
+    // Priorities decay, but a is still ahead of b
+    uploadCount = sink.Uploads.size();
+    streamer.Update(UINT64_MAX);
+    Require(sink.Uploads.size() == uploadCount + 3 + 3);
+    Check(sink.Uploads[uploadCount].Texture == a && sink.Uploads[uploadCount + 3].Texture == b);
+    CheckResidencyChanges(streamer, sink);
+
+    TextureStreamerStatistics statistics = streamer.Statistics();
+    Check(streamer.MostDetailedResidentMip(a) == 0 && streamer.MostDetailedResidentMip(b) == 0);
+    Check(statistics.ResidentCount == 2);
+    Check(statistics.StreamingCount == 0);
+    Check(statistics.DecodedBytes == 0);
+    Check(statistics.UploadedBytes == statistics.AllocatedBytes);
+    Check(sink.ViolationCount == 0);
+
+    // Mip 0 is the decoded image as-is
+    std::vector<uint8_t> decoded;
+    uint2 decodedSize;
+    Require(DecodeImage(EncodeImage(uint2(512, 256), 2), &decoded, &decodedSize));
+    Check(sink.Mip(b, 0) == decoded);
+}
+
+TEST(TextureStreamer, FailedDecodesKeepTheirPlaceholder)
+{
+    FakeUploadSink sink;
+    TextureStreamer streamer(sink, DecodeImage);
+    sink.Streamer = &streamer;
+    StreamedTextureId broken = Register(streamer, sink, uint2(32, 32), 255);
+    sink.AddTexture(uint2(200, 100));
+    StreamedTextureId mismatched = streamer.Register(EncodeImage(uint2(100, 100), 3), uint2(200, 100), false);
+    StreamedTextureId good = Register(streamer, sink, uint2(16, 16), 4);
+
+    Require(WaitForDecodes(streamer));
+    streamer.ReportUsage(broken, 1.f);
+    streamer.ReportUsage(mismatched, 1.f);
+    streamer.Update(UINT64_MAX);
+    CheckResidencyChanges(streamer, sink);
+
+    TextureStreamerStatistics statistics = streamer.Statistics();
+    Check(statistics.FailedCount == 2);
+    Check(statistics.ResidentCount == 1);
+    Check(statistics.Budget.TargetBytes == TextureBudget::MipChainBytes(uint2(16, 16), 0));
+    Check(streamer.MostDetailedResidentMip(broken) == streamer.MipCount(broken));
+    Check(streamer.MostDetailedResidentMip(mismatched) == streamer.MipCount(mismatched));
+    Check(streamer.MostDetailedResidentMip(good) == 0);
+    for (const FakeUploadSink::Upload& upload : sink.Uploads)
+    { Check(upload.Texture == good); }
+    Check(sink.ViolationCount == 0);
+}
+
+TEST(TextureStreamer, SrgbMipsAreFilteredInLinearSpace)
+{
+    // A black texel next to a white one, with alpha going from 0 to 255
+    TextureDecoder decoder = [](std::span<const uint8_t>, std::vector<uint8_t>* outRgbaData, uint2* outSize)
+        {
+            *outSize = uint2(2, 1);
+            *outRgbaData = { 0, 0, 0, 0, 255, 255, 255, 255 };
+            return true;
+        };
+
+    for (bool isSrgb : { true, false })
+    {
+        FakeUploadSink sink;
+        TextureStreamer streamer(sink, decoder, 1);
+        sink.Streamer = &streamer;
+        StreamedTextureId texture = Register(streamer, sink, uint2(2, 1), 0, isSrgb);
+        Require(WaitForDecodes(streamer));
+        streamer.Update(0);
+
+        // Linear 0.5 is 188 in sRGB, alpha is always linear
+        Require(streamer.MostDetailedResidentMip(texture) == 0);
+        const std::vector<uint8_t>& mip = sink.Mip(texture, 1);
+        Require(mip.size() == 4);
+        Check(mip[0] == (isSrgb ? 188 : 128) && mip[1] == mip[0] && mip[2] == mip[0]);
+        Check(mip[3] == 128);
+    }
+}
+
+TEST(TextureStreamer, EvictedMipsAreDecodedAgain)
+{
+    FakeUploadSink sink;
+    TextureStreamer streamer(sink, DecodeImage);
+    sink.Streamer = &streamer;
+    const uint2 size(256, 256);
+    StreamedTextureId texture = Register(streamer, sink, size, 5);
+
+    auto StreamIn = [&]()
+        {
+            for (int i = 0; i < 100 && streamer.MostDetailedResidentMip(texture) != 0; i++)
+            {
+                streamer.ReportUsage(texture, 1.f);
+                streamer.Update(UINT64_MAX);
+                CheckResidencyChanges(streamer, sink);
+                WaitForDecodes(streamer);
+            }
+        };
+
+    StreamIn();
+    Require(streamer.MostDetailedResidentMip(texture) == 0);
+    std::vector<uint8_t> mip0 = sink.Mip(texture, 0);
+    std::vector<uint8_t> mip1 = sink.Mip(texture, 1);
+
+    // Shrinking the budget to the floor mip reallocates the texture without its top mips, preserving the rest
+    uint32_t floorMip = TextureBudget::FloorMip(size, TextureStreamer::TAIL_MIP_SIZE);
+    streamer.SetBudget(TextureBudget::MipChainBytes(size, floorMip));
+    streamer.ReportUsage(texture, 1.f);
+    streamer.Update(UINT64_MAX);
+    CheckResidencyChanges(streamer, sink);
+    Check(streamer.MostDetailedResidentMip(texture) == floorMip);
+    Check(sink.AllocatedMip(texture) == floorMip);
+
+    TextureStreamerStatistics statistics = streamer.Statistics();
+    Check(statistics.EvictedBytes == TextureBudget::MipChainBytes(size, 0) - TextureBudget::MipChainBytes(size, floorMip));
+    Check(statistics.AllocatedBytes == TextureBudget::MipChainBytes(size, floorMip));
+    Check(statistics.Budget.EvictedMipCount == floorMip);
+    Check(statistics.ResidentCount == 1);
+
+    // Once there's room again the evicted mips come back identical to before
+    streamer.SetBudget(UINT64_MAX);
+    StreamIn();
+    Require(streamer.MostDetailedResidentMip(texture) == 0);
+    Check(sink.Mip(texture, 0) == mip0);
+    Check(sink.Mip(texture, 1) == mip1);
+    Check(sink.ViolationCount == 0);
+}
+
+TEST(TextureStreamer, ShrinksOnlyOnceUploadsLand)
+{
+    FakeUploadSink sink;
+    sink.IsImmediate = false;
+    TextureStreamer streamer(sink, DecodeImage);
+    sink.Streamer = &streamer;
+    const uint2 size(512, 512);
+    StreamedTextureId texture = Register(streamer, sink, size, 6);
+    std::mt19937 random(6);
+
+    // Issue every mip without landing the detail mips
+    for (int i = 0; i < 100 && sink.AllocatedMip(texture) != 0; i++)
+    {
+        streamer.ReportUsage(texture, 1.f);
+        streamer.Update(UINT64_MAX);
+        WaitForDecodes(streamer);
+    }
+    streamer.ReportUsage(texture, 1.f);
+    streamer.Update(UINT64_MAX);
+    Require(sink.AllocatedMip(texture) == 0);
+    Require(!sink.PendingUploads.empty());
+
+    // The uploads might be to the mips the budget wants dropped, so the texture keeps its allocation until they land
+    uint32_t floorMip = TextureBudget::FloorMip(size, TextureStreamer::TAIL_MIP_SIZE);
+    streamer.SetBudget(TextureBudget::MipChainBytes(size, floorMip));
+    uint32_t allocationCount = sink.AllocationCount;
+    streamer.Update(UINT64_MAX);
+    Check(sink.AllocationCount == allocationCount);
+    Check(sink.AllocatedMip(texture) == 0);
+
+    sink.LandPendingUploads(sink.PendingUploads.size(), random);
+    CheckResidencyChanges(streamer, sink);
+    Check(streamer.MostDetailedResidentMip(texture) == 0);
+
+    streamer.Update(UINT64_MAX);
+    CheckResidencyChanges(streamer, sink);
+    Check(sink.AllocationCount == allocationCount + 1);
+    Check(sink.AllocatedMip(texture) == floorMip);
+    Check(streamer.MostDetailedResidentMip(texture) == floorMip);
+    Check(sink.ViolationCount == 0);
+}
+
+TEST(TextureStreamer, RandomTimeline)
+{
+    // Uploads land out of order a few frames late while usage and the budget change at random, the sink checks the streamer never breaks its contract
+    const uint64_t maxDecodedBytes = 2 * 1024 * 1024;
+    const uint32_t workerCount = 2;
+    FakeUploadSink sink;
+    sink.IsImmediate = false;
+    TextureStreamer streamer(sink, DecodeImage, workerCount, maxDecodedBytes);
+    sink.Streamer = &streamer;
+
+    std::mt19937 random(5);
+    std::vector<StreamedTextureId> textures;
+    uint64_t largestChainBytes = 0;
+    uint64_t totalBytes = 0;
+    for (uint32_t i = 0; i < 40; i++)
+    {
+        uint2 size(1u << (random() % 11), 1u << (random() % 11));
+        textures.push_back(Register(streamer, sink, size, (uint8_t)i, i % 2 == 0));
+        largestChainBytes = std::max(largestChainBytes, TextureBudget::MipChainBytes(size, 0));
+        totalBytes += TextureBudget::MipChainBytes(size, 0);
+    }
+
+    uint64_t peakDecodedBytes = 0;
+    for (uint32_t frame = 0; frame < 300; frame++)
+    {
+        for (uint32_t i = 0; i < 5; i++)
+        { streamer.ReportUsage(textures[random() % textures.size()], (float)(random() % 100) / 100.f); }
+
+        if (frame % 50 == 25)
+        { streamer.SetBudget(totalBytes / (2 + random() % 8)); }
+        else if (frame % 50 == 0)
+        { streamer.SetBudget(UINT64_MAX); }
+
+        streamer.Update(256 * 1024);
+        sink.LandPendingUploads((sink.PendingUploads.size() + 1) / 2, random);
+        CheckResidencyChanges(streamer, sink);
+        peakDecodedBytes = std::max(peakDecodedBytes, streamer.Statistics().DecodedBytes);
+
+        if (frame % 10 == 0)
+        { std::this_thread::sleep_for(std::chrono::milliseconds(1)); }
+    }
+
+    // Use everything until it's all resident
+    streamer.SetBudget(UINT64_MAX);
+    bool isEverythingResident = false;
+    for (uint32_t frame = 0; frame < 10000 && !isEverythingResident; frame++)
+    {
+        for (StreamedTextureId texture : textures)
+        { streamer.ReportUsage(texture, 1.f); }
+
+        streamer.Update(256 * 1024);
+        sink.LandPendingUploads(sink.PendingUploads.size(), random);
+        CheckResidencyChanges(streamer, sink);
+        peakDecodedBytes = std::max(peakDecodedBytes, streamer.Statistics().DecodedBytes);
+
+        isEverythingResident = true;
+        for (StreamedTextureId texture : textures)
+        { isEverythingResident &= streamer.MostDetailedResidentMip(texture) == 0; }
+
+        if (!isEverythingResident)
+        { std::this_thread::sleep_for(std::chrono::microseconds(200)); }
+    }
+
+    Check(isEverythingResident);
+    Check(sink.ViolationCount == 0);
+
+    // Workers only check the limit before they start decoding, so each of them can overshoot it by a texture
+    Check(peakDecodedBytes <= maxDecodedBytes + workerCount * largestChainBytes);
+
+    TextureStreamerStatistics statistics = streamer.Statistics();
+    Check(statistics.ResidentCount == textures.size());
+    Check(statistics.AllocatedBytes == totalBytes);
+    Check(statistics.DecodedBytes == 0);
+}
@@ -0,0 +1,167 @@
+#include "pch.h"
+#include "UploadRing.h"
+#include "TestFramework.h"
+
+#include <random>
+
+TEST(UploadRing, AllocatesInOrder)
+{
+    UploadRing ring(1024);
+    UploadRingAllocation a, b, c;
+    Require(ring.TryAllocate(100, 16, &a));
+    Require(ring.TryAllocate(100, 256, &b));
+    Check(a.Offset == 0);
+    Check(b.Offset == 256);
+    Check(a.Region != b.Region);
+
+    // Doesn't fit in what's left after b
+    Check(!ring.TryAllocate(700, 1, &c));
+    Require(ring.TryAllocate(600, 8, &c));
+    Check(c.Offset == 360);
+    Check(ring.UsedBytes() == 960);
+    Check(ring.RegionCount() == 3);
+}
+
+TEST(UploadRing, RetiresInAllocationOrder)
+{
+    UploadRing ring(1024);
+    UploadRingAllocation a, b, c;
+    Require(ring.TryAllocate(100, 1, &a));
+    Require(ring.TryAllocate(100, 1, &b));
+    Require(ring.TryAllocate(100, 1, &c));
+
+    // Submitted out of order, so a holds back b and c even though their fences complete first
+    ring.Submit(b.Region, 2);
+    ring.Submit(c.Region, 1);
+    ring.Retire(2);
+    Check(ring.RegionCount() == 3);
+    Check(ring.UsedBytes() == 300);
+
+    ring.Submit(a.Region, 3);
+    ring.Retire(2);
+    Check(ring.RegionCount() == 3);
+    ring.Retire(3);
+    Check(ring.IsEmpty());
+    Check(ring.UsedBytes() == 0);
+
+    // The whole ring is available again
+    Require(ring.TryAllocate(1024, 512, &a));
+    Check(a.Offset == 0);
+}
+
+TEST(UploadRing, WrapsAroundTheEnd)
+{
+    UploadRing ring(1024);
+    UploadRingAllocation a, b, c;
+    Require(ring.TryAllocate(600, 1, &a));
+    Require(ring.TryAllocate(300, 1, &b));
+    Check(b.Offset == 600);
+    ring.Submit(a.Region, 1);
+    ring.Retire(1);
+
+    // Allocations never straddle the end of the ring, the 124 bytes left at the end are skipped and belong to c
+    Require(ring.TryAllocate(200, 1, &c));
+    Check(c.Offset == 0);
+    Check(ring.UsedBytes() == 300 + 124 + 200);
+    Check(!ring.TryAllocate(500, 1, &a));
+    Check(!ring.TryAllocate(2048, 1, &a));
+
+    ring.Submit(b.Region, 2);
+    ring.Submit(c.Region, 3);
+    ring.Retire(3);
+    Check(ring.IsEmpty());
+    Check(ring.UsedBytes() == 0);
+}
+
+TEST(UploadRing, RandomTimeline)
+{
+    // Simulates uploads being allocated, submitted in any order, and completed by a fence while shadowing which bytes are in use
+    struct Live
+    {
+        uint64_t Offset;
+        uint64_t Size;
+        uint64_t Region;
+        uint64_t FenceValue;
+    };
+
+    std::mt19937 random(1);
+    for (uint64_t capacity : { 4096ull, 65536ull })
+    {
+        UploadRing ring(capacity);
+        std::vector<Live> pending;
+        std::vector<Live> inFlight;
+        std::vector<bool> isInUse(capacity, false);
+        uint64_t nextFenceValue = 1;
+        uint64_t completedFenceValue = 0;
+        uint32_t allocationCount = 0;
+        uint32_t overlapCount = 0;
+
+        for (uint32_t step = 0; step < 100000; step++)
+        {
+            uint32_t operation = random() % 10;
+            if (operation < 5)
+            {
+                uint64_t size = 1 + random() % (capacity / (random() % 4 == 0 ? 3 : 40));
+                uint64_t alignment = 1ull << (random() % 10);
+                UploadRingAllocation allocation;
+                if (ring.TryAllocate(size, alignment, &allocation))
+                {
+                    Check(allocation.Offset % alignment == 0);
+                    Require(allocation.Offset + size <= capacity);
+                    for (uint64_t i = allocation.Offset; i < allocation.Offset + size; i++)
+                    {
+                        overlapCount += isInUse[i];
+                        isInUse[i] = true;
+                    }
+
+                    pending.push_back({ .Offset = allocation.Offset, .Size = size, .Region = allocation.Region });
+                    allocationCount++;
+                }
+                else
+                {
+                    // An empty ring can always satisfy these sizes
+                    Check(ring.UsedBytes() > 0);
+                }
+            }
+            else if (operation < 8 && !pending.empty())
+            {
+                size_t i = random() % pending.size();
+                Live live = pending[i];
+                pending.erase(pending.begin() + i);
+                live.FenceValue = nextFenceValue++;
+                ring.Submit(live.Region, live.FenceValue);
+                inFlight.push_back(live);
+            }
+            else if (nextFenceValue - 1 > completedFenceValue)
+            {
+                completedFenceValue += 1 + random() % (nextFenceValue - 1 - completedFenceValue);
+                ring.Retire(completedFenceValue);
+
+                // The ring may keep completed uploads around longer than this, but it must never hand out their bytes before they complete
+                std::erase_if(inFlight, [&](const Live& live)
+                    {
+                        if (live.FenceValue > completedFenceValue)
+                        { return false; }
+
+                        std::fill(isInUse.begin() + live.Offset, isInUse.begin() + live.Offset + live.Size, false);
+                        return true;
+                    });
+            }
+
+            Check(ring.UsedBytes() <= capacity);
+        }
+
+        Check(overlapCount == 0);
+        Check(allocationCount > 10000);
+
+        for (const Live& live : pending)
+        { ring.Submit(live.Region, nextFenceValue++); }
+        ring.Retire(nextFenceValue - 1);
+        Check(ring.IsEmpty());
+        Check(ring.UsedBytes() == 0);
+
+        UploadRingAllocation whole;
+        Require(ring.TryAllocate(capacity, 512, &whole));
+        Check(whole.Offset == 0);
+    }
+}
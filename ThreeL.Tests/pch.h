@@ -0,0 +1,3 @@
+#pragma once
+// The tests share ThreeL's precompiled header so that its sources can be compiled in to this project as-is
+#include "../ThreeL/pch.h"
@@ -3,10 +3,38 @@
 
 #include <stb_image.h>
 
-Scene LoadGltfScene(ResourceManager& resources, const std::string& filePath, const float4x4& transform)
+namespace
+{
+    // Images are decoded on demand by the texture streamer, so all we do here is hang on to the encoded data and read the size from its header
+    bool LoadImageDataDeferred(tinygltf::Image* image, const int imageIndex, std::string* error, std::string* warning, int requestedWidth, int requestedHeight, const unsigned char* bytes, int size, void* userData)
+    {
+        int width;
+        int height;
+        int channels;
+        if (!stbi_info_from_memory(bytes, size, &width, &height, &channels))
+        {
+            if (error != nullptr)
+            { *error += std::format("Failed to read the header of image #{}: {}\n", imageIndex, stbi_failure_reason()); }
+            return false;
+        }
+
+        // Describe the image as it'll be after decoding
+        image->width = width;
+        image->height = height;
+        image->component = 4;
+        image->bits = 8;
+        image->pixel_type = TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE;
+        image->image.assign(bytes, bytes + size);
+        image->as_is = true;
+        return true;
+    }
+}
+
+Scene LoadGltfScene(ResourceManager& resources, JobSystem& jobs, const std::string& filePath, const float4x4& transform)
 {
     tinygltf::Model model;
     tinygltf::TinyGLTF loader;
+    loader.SetImageLoader(LoadImageDataDeferred, nullptr);
     std::string gltfError;
     std::string gltfWarning;
     printf("Parsing glTF file...\n");
@@ -25,7 +53,7 @@ Scene LoadGltfScene(ResourceManager& resources, const std::string& filePath, con
     }
 
     printf("Loading glTF scene...\n");
-    return Scene(resources, model, transform);
+    return Scene(resources, jobs, model, transform);
 }
 
 Texture LoadHdr(ResourceManager& resources, std::string filePath)
@@ -3,8 +3,9 @@
 #include "Scene.h"
 #include "Texture.h"
 
+class JobSystem;
 struct ResourceManager;
 
-Scene LoadGltfScene(ResourceManager& resources, const std::string& filePath, const float4x4& transform = float4x4::Identity);
+Scene LoadGltfScene(ResourceManager& resources, JobSystem& jobs, const std::string& filePath, const float4x4& transform = float4x4::Identity);
 Texture LoadHdr(ResourceManager& resources, std::string filePath);
 Texture LoadTexture(ResourceManager& resources, std::string filePath);
@@ -19,12 +19,12 @@ private:
         : m_Rtv(rtvHandle)
     {
         m_Resource = renderTarget;
-        m_CurrentState = D3D12_RESOURCE_STATE_PRESENT;
+        m_State = ResourceState(D3D12_RESOURCE_STATE_PRESENT);
     }
 
     inline void AssertIsInPresentState() const
     {
-        Assert(m_CurrentState == D3D12_RESOURCE_STATE_PRESENT);
+        Assert(m_State.IsUniform() && m_State.State() == D3D12_RESOURCE_STATE_PRESENT);
     }
 
 public:
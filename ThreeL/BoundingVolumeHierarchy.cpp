@@ -0,0 +1,245 @@
+#include "pch.h"
+#include "BoundingVolumeHierarchy.h"
+#include "Stopwatch.h"
+
+#include <algorithm>
+#include <xmmintrin.h>
+
+namespace
+{
+    inline float Component(float3 v, int axis)
+    { return axis == 0 ? v.x : axis == 1 ? v.y : v.z; }
+
+    struct ItemRange
+    {
+        uint32_t First;
+        uint32_t Count;
+    };
+}
+
+BoundingVolumeHierarchy::BoundingVolumeHierarchy(std::span<const BoundingBox> boxes)
+{
+    std::vector<float3> centers(boxes.size());
+    for (uint32_t i = 0; i < boxes.size(); i++)
+    {
+        // Empty boxes can never be visible, so they're left out of the hierarchy entirely
+        if (boxes[i].IsEmpty())
+        { continue; }
+
+        m_Items.push_back(i);
+        centers[i] = boxes[i].Center();
+    }
+
+    if (m_Items.empty())
+    { return; }
+
+    // Median splits tend to leave two or three items in the bottom nodes, so there end up being about half as many nodes as items
+    m_Nodes.reserve(m_Items.size() / 2 + 1);
+    Build(boxes, centers, 0, (uint32_t)m_Items.size());
+}
+
+uint32_t BoundingVolumeHierarchy::Build(std::span<const BoundingBox> boxes, std::span<const float3> centers, uint32_t first, uint32_t count)
+{
+    uint32_t nodeIndex = (uint32_t)m_Nodes.size();
+    m_Nodes.push_back({ });
+
+    // Partition the items into up to four groups by repeatedly splitting the largest group at the median of its longest axis
+    ItemRange groups[Width] = { { first, count } };
+    uint32_t groupCount = 1;
+    while (groupCount < Width)
+    {
+        uint32_t largest = 0;
+        for (uint32_t i = 1; i < groupCount; i++)
+        {
+            if (groups[i].Count > groups[largest].Count)
+            { largest = i; }
+        }
+
+        ItemRange range = groups[largest];
+        if (range.Count < 2)
+        { break; }
+
+        BoundingBox centerBounds = BoundingBox::Empty();
+        for (uint32_t i = range.First; i < range.First + range.Count; i++)
+        {
+            float3 center = centers[m_Items[i]];
+            centerBounds = centerBounds.Union({ center, center });
+        }
+
+        float3 size = centerBounds.Max - centerBounds.Min;
+        int axis = size.x >= size.y && size.x >= size.z ? 0 : size.y >= size.z ? 1 : 2;
+
+        auto begin = m_Items.begin() + range.First;
+        auto middle = begin + range.Count / 2;
+        auto end = begin + range.Count;
+        std::nth_element(begin, middle, end, [&](uint32_t a, uint32_t b) { return Component(centers[a], axis) < Component(centers[b], axis); });
+
+        groups[largest] = { range.First, range.Count / 2 };
+        groups[groupCount] = { range.First + range.Count / 2, range.Count - range.Count / 2 };
+        groupCount++;
+    }
+
+    for (uint32_t i = 0; i < groupCount; i++)
+    {
+        ItemRange group = groups[i];
+        BoundingBox bounds = BoundingBox::Empty();
+        for (uint32_t j = group.First; j < group.First + group.Count; j++)
+        { bounds = bounds.Union(boxes[m_Items[j]]); }
+
+        // Groups of a single item are leaves, everything else gets its own node
+        // (Build may reallocate m_Nodes, so we can't hold a reference to our node across the call.)
+        uint32_t childNode = group.Count == 1 ? LeafChild : Build(boxes, centers, group.First, group.Count);
+
+        Node& node = m_Nodes[nodeIndex];
+        float3 center = bounds.Center();
+        float3 extents = bounds.Extents();
+        node.CenterX[i] = center.x;
+        node.CenterY[i] = center.y;
+        node.CenterZ[i] = center.z;
+        node.ExtentsX[i] = extents.x;
+        node.ExtentsY[i] = extents.y;
+        node.ExtentsZ[i] = extents.z;
+        node.ChildNode[i] = childNode;
+        node.FirstItem[i] = group.First;
+        node.ItemCount[i] = group.Count;
+    }
+
+    return nodeIndex;
+}
+
+void BoundingVolumeHierarchy::Cull(const Frustum& frustum, std::vector<uint32_t>& visibleItems) const
+{
+    if (m_Nodes.empty())
+    { return; }
+
+    // Splat the planes up-front since every node is tested against all of them
+    __m128 planeX[Frustum::PlaneCount];
+    __m128 planeY[Frustum::PlaneCount];
+    __m128 planeZ[Frustum::PlaneCount];
+    __m128 planeW[Frustum::PlaneCount];
+    __m128 absPlaneX[Frustum::PlaneCount];
+    __m128 absPlaneY[Frustum::PlaneCount];
+    __m128 absPlaneZ[Frustum::PlaneCount];
+    const __m128 signBit = _mm_set1_ps(-0.f);
+    for (uint32_t i = 0; i < Frustum::PlaneCount; i++)
+    {
+        planeX[i] = _mm_set1_ps(frustum.Planes[i].x);
+        planeY[i] = _mm_set1_ps(frustum.Planes[i].y);
+        planeZ[i] = _mm_set1_ps(frustum.Planes[i].z);
+        planeW[i] = _mm_set1_ps(frustum.Planes[i].w);
+        absPlaneX[i] = _mm_andnot_ps(signBit, planeX[i]);
+        absPlaneY[i] = _mm_andnot_ps(signBit, planeY[i]);
+        absPlaneZ[i] = _mm_andnot_ps(signBit, planeZ[i]);
+    }
+
+    // Each node pushes at most four children and the tree is roughly balanced, so the stack stays shallow
+    uint32_t stack[64];
+    uint32_t stackSize = 0;
+    stack[stackSize++] = 0;
+
+    const __m128 zero = _mm_setzero_ps();
+    while (stackSize > 0)
+    {
+        const Node& node = m_Nodes[stack[--stackSize]];
+        __m128 centerX = _mm_load_ps(node.CenterX);
+        __m128 centerY = _mm_load_ps(node.CenterY);
+        __m128 centerZ = _mm_load_ps(node.CenterZ);
+        __m128 extentsX = _mm_load_ps(node.ExtentsX);
+        __m128 extentsY = _mm_load_ps(node.ExtentsY);
+        __m128 extentsZ = _mm_load_ps(node.ExtentsZ);
+
+        // Same test as Frustum::Intersects, additionally children entirely in front of every plane are noted so their subtrees don't need testing
+        int outsideMask = 0;
+        int insideMask = 0xF;
+        for (uint32_t i = 0; i < Frustum::PlaneCount; i++)
+        {
+            __m128 distance = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(planeX[i], centerX), _mm_mul_ps(planeY[i], centerY)), _mm_mul_ps(planeZ[i], centerZ)), planeW[i]);
+            __m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(extentsX, absPlaneX[i]), _mm_mul_ps(extentsY, absPlaneY[i])), _mm_mul_ps(extentsZ, absPlaneZ[i]));
+            outsideMask |= _mm_movemask_ps(_mm_cmplt_ps(_mm_add_ps(distance, radius), zero));
+            insideMask &= _mm_movemask_ps(_mm_cmpge_ps(_mm_sub_ps(distance, radius), zero));
+        }
+
+        int visibleMask = ~outsideMask & 0xF;
+        for (uint32_t i = 0; i < Width; i++)
+        {
+            if ((visibleMask & (1 << i)) == 0 || node.ItemCount[i] == 0)
+            { continue; }
+
+            if (node.ChildNode[i] == LeafChild || (insideMask & (1 << i)) != 0)
+            {
+                auto items = m_Items.begin() + node.FirstItem[i];
+                visibleItems.insert(visibleItems.end(), items, items + node.ItemCount[i]);
+            }
+            else
+            {
+                Assert(stackSize < std::size(stack));
+                stack[stackSize++] = node.ChildNode[i];
+            }
+        }
+    }
+}
+
+BoundingVolumeHierarchyBenchmark BoundingVolumeHierarchy::Benchmark(uint32_t boxCount, uint32_t frustumCount)
+{
+    Assert(frustumCount > 0);
+
+    // Scatter small boxes through a cube using a fixed LCG so that every run culls the same data
+    uint32_t seed = 0x5EED;
+    auto Random = [&]()
+        {
+            seed = seed * 1664525 + 1013904223;
+            return (float)(seed >> 8) / (float)(1 << 24);
+        };
+
+    std::vector<BoundingBox> boxes(boxCount);
+    for (BoundingBox& box : boxes)
+    {
+        float3 center(Random() * 200.f - 100.f, Random() * 50.f, Random() * 200.f - 100.f);
+        float3 extents(0.1f + Random() * 3.f, 0.1f + Random() * 3.f, 0.1f + Random() * 3.f);
+        box = BoundingBox::FromCenterExtents(center, extents);
+    }
+
+    Stopwatch stopwatch;
+    BoundingVolumeHierarchy bvh(boxes);
+    BoundingVolumeHierarchyBenchmark result =
+    {
+        .BoxCount = boxCount,
+        .FrustumCount = frustumCount,
+        .NodeCount = bvh.NodeCount(),
+        .BuildSeconds = stopwatch.ElapsedSeconds(),
+    };
+
+    std::vector<uint32_t> visibleItems;
+    visibleItems.reserve(boxCount);
+    float4x4 projection = float4x4::MakePerspectiveTransformReverseZ(Math::HalfPi, 16.f / 9.f, 0.1f);
+    for (uint32_t i = 0; i < frustumCount; i++)
+    {
+        // Look around from the middle of the scene like a player would
+        float angle = (float)i * Math::TwoPi / (float)frustumCount;
+        float3 eye(std::cos(angle) * 20.f, 10.f, std::sin(angle) * 20.f);
+        float3 target = eye + float3(std::cos(angle * 3.f), -0.2f, std::sin(angle * 3.f));
+        Frustum frustum(float4x4::MakeCameraLookAtViewTransform(eye, target, float3::UnitY) * projection);
+
+        visibleItems.clear();
+        stopwatch.Restart();
+        bvh.Cull(frustum, visibleItems);
+        result.CullSeconds += stopwatch.ElapsedSeconds();
+
+        stopwatch.Restart();
+        uint32_t bruteForceVisibleCount = 0;
+        for (const BoundingBox& box : boxes)
+        {
+            if (frustum.Intersects(box))
+            { bruteForceVisibleCount++; }
+        }
+        result.BruteForceSeconds += stopwatch.ElapsedSeconds();
+
+        Assert(visibleItems.size() == bruteForceVisibleCount);
+        result.AverageVisibleCount += (double)visibleItems.size();
+    }
+
+    result.AverageVisibleCount /= frustumCount;
+    result.CullSeconds /= frustumCount;
+    result.BruteForceSeconds /= frustumCount;
+    return result;
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include "Bounds.h"
+
+#include <span>
+#include <vector>
+
+//! Timings from BoundingVolumeHierarchy::Benchmark, culling times are in seconds per frustum
+struct BoundingVolumeHierarchyBenchmark
+{
+    uint32_t BoxCount;
+    uint32_t FrustumCount;
+    uint32_t NodeCount;
+    double AverageVisibleCount;
+    double BuildSeconds;
+    double CullSeconds;
+    //! Testing every box with Frustum::Intersects instead
+    double BruteForceSeconds;
+};
+
+//! A flattened four-wide bounding volume hierarchy over a static set of bounding boxes, used to frustum cull the scene on the CPU
+//! Each node stores the bounds of its four children as a structure of arrays so that all four can be tested against a plane at once with SSE.
+class BoundingVolumeHierarchy
+{
+public:
+    static constexpr uint32_t Width = 4;
+
+private:
+    static constexpr uint32_t LeafChild = 0xFFFFFFFF;
+
+    struct alignas(16) Node
+    {
+        float CenterX[Width];
+        float CenterY[Width];
+        float CenterZ[Width];
+        float ExtentsX[Width];
+        float ExtentsY[Width];
+        float ExtentsZ[Width];
+
+        // Index of the child node in m_Nodes, or LeafChild if the child is a single item
+        uint32_t ChildNode[Width];
+
+        // The range of m_Items covered by the child's subtree, unused children have no items
+        uint32_t FirstItem[Width];
+        uint32_t ItemCount[Width];
+    };
+
+    std::vector<Node> m_Nodes;
+
+    // Indices into the boxes the hierarchy was built from, ordered such that every subtree covers a contiguous range
+    std::vector<uint32_t> m_Items;
+
+    uint32_t Build(std::span<const BoundingBox> boxes, std::span<const float3> centers, uint32_t first, uint32_t count);
+
+public:
+    //! Builds the hierarchy over the specified boxes, culling results are reported as indices into this list
+    //! Empty boxes are never reported as visible.
+    BoundingVolumeHierarchy(std::span<const BoundingBox> boxes);
+
+    inline uint32_t NodeCount() const { return (uint32_t)m_Nodes.size(); }
+    inline uint32_t ItemCount() const { return (uint32_t)m_Items.size(); }
+
+    //! Appends the indices of the boxes which intersect the frustum to visibleItems
+    //! Results are conservative in the same way as Frustum::Intersects and are not in any particular order.
+    void Cull(const Frustum& frustum, std::vector<uint32_t>& visibleItems) const;
+
+    //! Times building a hierarchy over boxCount synthetic boxes and culling it against frustumCount views compared to testing every box individually
+    //! Used by the --benchmark-bvh command line option.
+    static BoundingVolumeHierarchyBenchmark Benchmark(uint32_t boxCount, uint32_t frustumCount);
+};
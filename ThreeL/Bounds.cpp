@@ -0,0 +1,148 @@
+#include "pch.h"
+#include "Bounds.h"
+
+#include <algorithm>
+#include <limits>
+#include <xmmintrin.h>
+
+namespace
+{
+    inline float3 ComponentMin(float3 a, float3 b) { return float3(std::min(a.x, b.x), std::min(a.y, b.y), std::min(a.z, b.z)); }
+    inline float3 ComponentMax(float3 a, float3 b) { return float3(std::max(a.x, b.x), std::max(a.y, b.y), std::max(a.z, b.z)); }
+}
+
+BoundingBox BoundingBox::Empty()
+{
+    const float infinity = std::numeric_limits<float>::infinity();
+    return { float3(infinity), float3(-infinity) };
+}
+
+BoundingBox BoundingBox::FromPoints(std::span<const float3> points)
+{
+    static_assert(sizeof(float3) == sizeof(float) * 3);
+    BoundingBox result = Empty();
+    size_t i = 0;
+
+    // Groups of four points are exactly three vectors: (x0 y0 z0 x1) (y1 z1 x2 y2) (z2 x3 y3 z3)
+    // Each of the three layouts is accumulated separately and the components are gathered back out of them at the end
+    if (points.size() >= 4)
+    {
+        const float* data = &points[0].x;
+        __m128 min0 = _mm_loadu_ps(data + 0);
+        __m128 min1 = _mm_loadu_ps(data + 4);
+        __m128 min2 = _mm_loadu_ps(data + 8);
+        __m128 max0 = min0;
+        __m128 max1 = min1;
+        __m128 max2 = min2;
+
+        for (i = 4; i + 4 <= points.size(); i += 4)
+        {
+            __m128 a = _mm_loadu_ps(data + i * 3 + 0);
+            __m128 b = _mm_loadu_ps(data + i * 3 + 4);
+            __m128 c = _mm_loadu_ps(data + i * 3 + 8);
+            min0 = _mm_min_ps(min0, a);
+            min1 = _mm_min_ps(min1, b);
+            min2 = _mm_min_ps(min2, c);
+            max0 = _mm_max_ps(max0, a);
+            max1 = _mm_max_ps(max1, b);
+            max2 = _mm_max_ps(max2, c);
+        }
+
+        alignas(16) float mins[12];
+        alignas(16) float maxs[12];
+        _mm_store_ps(mins + 0, min0);
+        _mm_store_ps(mins + 4, min1);
+        _mm_store_ps(mins + 8, min2);
+        _mm_store_ps(maxs + 0, max0);
+        _mm_store_ps(maxs + 4, max1);
+        _mm_store_ps(maxs + 8, max2);
+
+        for (int j = 0; j < 4; j++)
+        {
+            result.Min = ComponentMin(result.Min, float3(mins[j * 3 + 0], mins[j * 3 + 1], mins[j * 3 + 2]));
+            result.Max = ComponentMax(result.Max, float3(maxs[j * 3 + 0], maxs[j * 3 + 1], maxs[j * 3 + 2]));
+        }
+    }
+
+    for (; i < points.size(); i++)
+    {
+        result.Min = ComponentMin(result.Min, points[i]);
+        result.Max = ComponentMax(result.Max, points[i]);
+    }
+
+    return result;
+}
+
+BoundingBox BoundingBox::Union(const BoundingBox& other) const
+{
+    return { ComponentMin(Min, other.Min), ComponentMax(Max, other.Max) };
+}
+
+BoundingBox BoundingBox::Transformed(const float4x4& transform) const
+{
+    if (IsEmpty())
+    { return *this; }
+
+    // The extents of the transformed box are the local extents projected onto each world axis
+    float3 localExtents = Extents();
+    float4 worldCenter = transform.Transform(float4(Center(), 1.f));
+    float3 worldExtents = float3
+    (
+        localExtents.x * std::abs(transform.m00) + localExtents.y * std::abs(transform.m10) + localExtents.z * std::abs(transform.m20),
+        localExtents.x * std::abs(transform.m01) + localExtents.y * std::abs(transform.m11) + localExtents.z * std::abs(transform.m21),
+        localExtents.x * std::abs(transform.m02) + localExtents.y * std::abs(transform.m12) + localExtents.z * std::abs(transform.m22)
+    );
+
+    return FromCenterExtents(float3(worldCenter.x, worldCenter.y, worldCenter.z), worldExtents);
+}
+
+BoundingSphere BoundingSphere::FromBox(const BoundingBox& box)
+{
+    return { box.Center(), box.Extents().Length() };
+}
+
+Frustum::Frustum(const float4x4& viewProjection)
+{
+    // Planes are extracted from the columns of the view projection matrix, this must match IsVisible in SceneCulling.cs.hlsl
+    const float4x4& m = viewProjection;
+    float4 column0 = float4(m.m00, m.m10, m.m20, m.m30);
+    float4 column1 = float4(m.m01, m.m11, m.m21, m.m31);
+    float4 column2 = float4(m.m02, m.m12, m.m22, m.m32);
+    float4 column3 = float4(m.m03, m.m13, m.m23, m.m33);
+
+    Planes[0] = column3 + column0; // Left
+    Planes[1] = column3 - column0; // Right
+    Planes[2] = column3 + column1; // Bottom
+    Planes[3] = column3 - column1; // Top
+    Planes[4] = column3 - column2; // Near
+}
+
+bool Frustum::Intersects(const BoundingBox& box) const
+{
+    float3 center = box.Center();
+    float3 extents = box.Extents();
+
+    for (const float4& plane : Planes)
+    {
+        // The box is outside when its closest corner is behind the plane
+        float distance = plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w;
+        float radius = extents.x * std::abs(plane.x) + extents.y * std::abs(plane.y) + extents.z * std::abs(plane.z);
+        if (distance + radius < 0.f)
+        { return false; }
+    }
+
+    return true;
+}
+
+bool Frustum::Intersects(const BoundingSphere& sphere) const
+{
+    for (const float4& plane : Planes)
+    {
+        // The planes aren't normalized, so the radius is scaled to match rather than normalizing the distance
+        float distance = plane.x * sphere.Center.x + plane.y * sphere.Center.y + plane.z * sphere.Center.z + plane.w;
+        if (distance < 0.f && distance * distance > sphere.Radius * sphere.Radius * (plane.x * plane.x + plane.y * plane.y + plane.z * plane.z))
+        { return false; }
+    }
+
+    return true;
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include "Math.h"
+
+#include <span>
+
+//! An axis-aligned bounding box
+struct BoundingBox
+{
+    float3 Min;
+    float3 Max;
+
+    //! Returns an inverted box which contains nothing, any box unioned with it is itself
+    static BoundingBox Empty();
+
+    //! Computes the tightest box containing the specified points
+    static BoundingBox FromPoints(std::span<const float3> points);
+
+    static inline BoundingBox FromCenterExtents(float3 center, float3 extents)
+    { return { center - extents, center + extents }; }
+
+    inline float3 Center() const { return (Min + Max) * 0.5f; }
+    inline float3 Extents() const { return (Max - Min) * 0.5f; }
+    inline bool IsEmpty() const { return Min.x > Max.x || Min.y > Max.y || Min.z > Max.z; }
+
+    BoundingBox Union(const BoundingBox& other) const;
+
+    //! Returns the box which encloses this one after it has been transformed
+    BoundingBox Transformed(const float4x4& transform) const;
+};
+
+//! A bounding sphere
+struct BoundingSphere
+{
+    float3 Center;
+    float Radius;
+
+    //! Returns the sphere which circumscribes the specified box
+    static BoundingSphere FromBox(const BoundingBox& box);
+};
+
+//! The planes of a view frustum, extracted from a reverse Z view projection matrix with an infinite far plane
+struct Frustum
+{
+    static constexpr uint32_t PlaneCount = 5;
+
+    //! Left, right, bottom, top, and near planes
+    //! Normals point into the frustum and are not normalized.
+    float4 Planes[PlaneCount];
+
+    explicit Frustum(const float4x4& viewProjection);
+
+    bool Intersects(const BoundingBox& box) const;
+    bool Intersects(const BoundingSphere& sphere) const;
+};
@@ -0,0 +1,65 @@
+#include "pch.h"
+#include "ClusterCuller.h"
+
+const ClusterDrawSet& ClusterCuller::Cull(const DrawList& drawList, const Frustum& frustum, float3 eyePosition, std::span<const uint8_t> primitiveVisibility, std::span<const uint8_t> primitiveLods)
+{
+    const uint32_t primitiveCount = drawList.PrimitiveCount();
+    Assert(primitiveVisibility.empty() || primitiveVisibility.size() == primitiveCount);
+    Assert(primitiveLods.empty() || primitiveLods.size() == primitiveCount);
+
+    m_Draws.PrimitiveFirstDraw.assign(primitiveCount, 0);
+    m_Draws.PrimitiveDrawCount.assign(primitiveCount, ClusterDrawSet::NotClusterCulled);
+    m_Draws.Draws.clear();
+    m_Statistics = { };
+
+    std::span<const DrawListCluster> clusters = drawList.Clusters();
+    for (const DrawPacket& packet : drawList.Packets())
+    {
+        if (packet.ClusterCount == 0)
+        { continue; }
+
+        if (!primitiveVisibility.empty() && !primitiveVisibility[packet.PrimitiveIndex])
+        { continue; }
+
+        if (!primitiveLods.empty() && primitiveLods[packet.PrimitiveIndex] != 0)
+        { continue; }
+
+        const uint32_t firstDraw = (uint32_t)m_Draws.Draws.size();
+        m_Statistics.PrimitiveCount++;
+        m_Statistics.ClusterCount += packet.ClusterCount;
+
+        for (const DrawListCluster& cluster : clusters.subspan(packet.FirstCluster, packet.ClusterCount))
+        {
+            const uint32_t triangleCount = cluster.IndexCount / 3;
+            m_Statistics.TriangleCount += triangleCount;
+
+            if (!frustum.Intersects(cluster.Bounds))
+            {
+                m_Statistics.FrustumCulledClusters++;
+                m_Statistics.CulledTriangleCount += triangleCount;
+                continue;
+            }
+
+            // Every triangle of the cluster faces away from the eye, see MeshletBounds
+            float3 offset = cluster.Bounds.Center - eyePosition;
+            if (offset.Dot(cluster.ConeAxis) >= cluster.ConeCutoff * offset.Length() + cluster.Bounds.Radius)
+            {
+                m_Statistics.BackFaceCulledClusters++;
+                m_Statistics.CulledTriangleCount += triangleCount;
+                continue;
+            }
+
+            // Meshlets are stored in index buffer order, so a cluster can only ever extend the draw of the cluster just before it
+            if (m_Draws.Draws.size() > firstDraw && m_Draws.Draws.back().FirstIndex + m_Draws.Draws.back().IndexCount == cluster.FirstIndex)
+            { m_Draws.Draws.back().IndexCount += cluster.IndexCount; }
+            else
+            { m_Draws.Draws.push_back({ .FirstIndex = cluster.FirstIndex, .IndexCount = cluster.IndexCount }); }
+        }
+
+        m_Draws.PrimitiveFirstDraw[packet.PrimitiveIndex] = firstDraw;
+        m_Draws.PrimitiveDrawCount[packet.PrimitiveIndex] = (uint32_t)m_Draws.Draws.size() - firstDraw;
+    }
+
+    m_Statistics.DrawCount = (uint32_t)m_Draws.Draws.size();
+    return m_Draws;
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include "Bounds.h"
+#include "DrawList.h"
+
+#include <span>
+#include <vector>
+
+//! Counts gathered by ClusterCuller::Cull
+struct ClusterCullingStatistics
+{
+    //! Primitives whose clusters were tested and the number of clusters and triangles they had
+    uint32_t PrimitiveCount;
+    uint32_t ClusterCount;
+    uint32_t TriangleCount;
+
+    uint32_t FrustumCulledClusters;
+    uint32_t BackFaceCulledClusters;
+    uint32_t CulledTriangleCount;
+
+    //! Number of index ranges the surviving clusters were merged into
+    uint32_t DrawCount;
+};
+
+//! Culls the meshlets of the scene on the CPU against the view frustum and their normal cones
+//! Only visible primitives drawn at full detail are cluster culled since LODs don't have meshlets. A meshlet is a contiguous range of its primitive's index
+//! buffer, so surviving meshlets are drawn directly as index ranges with neighboring ranges merged together, no compacted index buffer is needed.
+class ClusterCuller
+{
+private:
+    ClusterDrawSet m_Draws;
+    ClusterCullingStatistics m_Statistics = { };
+
+public:
+    //! Culls the clusters of the specified draw list, the results can be used with any draw list of the same scene (see DrawList::PrimitiveBounds)
+    //! Visibility and LODs are optional in the same way as they are for DrawList::Submit.
+    const ClusterDrawSet& Cull(const DrawList& drawList, const Frustum& frustum, float3 eyePosition, std::span<const uint8_t> primitiveVisibility, std::span<const uint8_t> primitiveLods);
+
+    inline const ClusterDrawSet& Draws() const { return m_Draws; }
+    inline const ClusterCullingStatistics& Statistics() const { return m_Statistics; }
+};
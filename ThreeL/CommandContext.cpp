@@ -8,10 +8,9 @@
 static volatile uint64_t g_NextId;
 
 CommandContext::CommandContext(CommandQueue& commandQueue)
-    : m_CommandQueue(commandQueue)
+    : m_CommandQueue(commandQueue), m_StateTracker(commandQueue.m_Type)
 {
     ID3D12Device* device = commandQueue.m_GraphicsCore.Device();
-    memset(m_PendingResourceBarriers, 0, sizeof(m_PendingResourceBarriers));
 
     // When Device4 is available, use it to create the command list in a closed state.
     // Otherwise simulate it by creating a command list and immediately closing it.
@@ -56,63 +55,61 @@ void CommandContext::ResetCommandList(ID3D12PipelineState* initialPipelineState)
     { m_CommandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST); }
 }
 
-D3D12_RESOURCE_BARRIER& CommandContext::AllocateResourceBarrier()
+void CommandContext::InitializeResourceState(GpuResource& resource)
 {
-    // If we're out of pending resource barriers, flush them now
-    if (m_PendingResourceBarrierCount == std::size(m_PendingResourceBarriers))
-        FlushResourceBarriersEarly();
-    
-    D3D12_RESOURCE_BARRIER& result = m_PendingResourceBarriers[m_PendingResourceBarrierCount];
-    m_PendingResourceBarrierCount++;
-    return result;
+    if (resource.m_State.IsInitialized())
+        return;
+
+    // Buffers and simultaneous access textures are stateless as far as promotion and decay are concerned
+    D3D12_RESOURCE_DESC description = resource.m_Resource->GetDesc();
+    if (description.Dimension == D3D12_RESOURCE_DIMENSION_BUFFER)
+    {
+        resource.m_State.Initialize(1, true);
+        return;
+    }
+
+    D3D12_FEATURE_DATA_FORMAT_INFO formatInfo = { .Format = description.Format };
+    AssertSuccess(m_CommandQueue.m_GraphicsCore.Device()->CheckFeatureSupport(D3D12_FEATURE_FORMAT_INFO, &formatInfo, sizeof(formatInfo)));
+
+    uint32_t arraySize = description.Dimension == D3D12_RESOURCE_DIMENSION_TEXTURE3D ? 1 : description.DepthOrArraySize;
+    uint32_t subresourceCount = (uint32_t)description.MipLevels * arraySize * formatInfo.PlaneCount;
+    resource.m_State.Initialize(subresourceCount, (description.Flags & D3D12_RESOURCE_FLAG_ALLOW_SIMULTANEOUS_ACCESS) != 0);
 }
 
-void CommandContext::TransitionResource(GpuResource& resource, D3D12_RESOURCE_STATES desiredState, bool immediate)
+void CommandContext::TransitionResource(GpuResource& resource, D3D12_RESOURCE_STATES desiredState, uint32_t subresource, bool immediate)
 {
     // Always take the resource even if we don't actually do the transition for the sake of consistency
     TakeResource(resource);
 
-    D3D12_RESOURCE_STATES currentState = resource.m_CurrentState;
+    Assert(resource.m_Resource.Get() != nullptr && "Tried to transition an uninitialized resource!");
+    InitializeResourceState(resource);
+    m_StateTracker.Transition(resource.m_State, resource.m_Resource.Get(), desiredState, subresource);
 
-    // Ignore no-op transitions
-    if (currentState == desiredState)
-    {
-        if (immediate)
-            FlushResourceBarriersEarly();
+    if (immediate)
+        FlushResourceBarriersEarly();
+}
 
-        return;
-    }
+void CommandContext::BeginTransitionResource(GpuResource& resource, D3D12_RESOURCE_STATES desiredState, uint32_t subresource)
+{
+    TakeResource(resource);
 
     Assert(resource.m_Resource.Get() != nullptr && "Tried to transition an uninitialized resource!");
-    AllocateResourceBarrier() =
-    {
-        .Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION,
-        .Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE,
-        .Transition =
-        {
-            .pResource = resource.m_Resource.Get(),
-            .Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES,
-            .StateBefore = currentState,
-            .StateAfter = desiredState,
-        },
-    };
-    resource.m_CurrentState = desiredState;
+    InitializeResourceState(resource);
+    m_StateTracker.BeginTransition(resource.m_State, resource.m_Resource.Get(), desiredState, subresource);
+}
+
+void CommandContext::UavBarrier(GpuResource* resource, bool immediate)
+{
+    m_StateTracker.UavBarrier(resource == nullptr ? nullptr : resource->m_Resource.Get());
 
     if (immediate)
         FlushResourceBarriersEarly();
 }
 
-void CommandContext::UavBarrier(GpuResource* resource, bool immediate)
+void CommandContext::AliasingBarrier(GpuResource& resourceAfter, bool immediate)
 {
-    AllocateResourceBarrier() =
-    {
-        .Type = D3D12_RESOURCE_BARRIER_TYPE_UAV,
-        .Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE,
-        .UAV =
-        {
-            .pResource = resource == nullptr ? nullptr : resource->m_Resource.Get()
-        }
-    };
+    TakeResource(resourceAfter);
+    m_StateTracker.AliasingBarrier(nullptr, resourceAfter.m_Resource.Get());
 
     if (immediate)
         FlushResourceBarriersEarly();
@@ -120,17 +117,25 @@ void CommandContext::UavBarrier(GpuResource* resource, bool immediate)
 
 void CommandContext::FlushResourceBarriersEarly()
 {
-    if (m_PendingResourceBarrierCount == 0)
+    std::span<const D3D12_RESOURCE_BARRIER> barriers = m_StateTracker.PendingBarriers();
+    if (barriers.empty())
         return;
 
-    m_CommandList->ResourceBarrier(m_PendingResourceBarrierCount, m_PendingResourceBarriers);
-    m_PendingResourceBarrierCount = 0;
+    m_CommandList->ResourceBarrier((UINT)barriers.size(), barriers.data());
+    m_StateTracker.ClearPendingBarriers();
 }
 
 void CommandContext::FlushResourceBarriers()
 {
     FlushResourceBarriersEarly();
 
+    // Barriers are flushed right before the work which depends on them, which is what actually makes implicit promotions happen
+    m_StateTracker.WorkRecorded();
+    ReleaseResources();
+}
+
+void CommandContext::ReleaseResources()
+{
 #if DEBUG
     if (!m_OwnedResources.empty())
     {
@@ -148,7 +153,10 @@ GpuSyncPoint CommandContext::Flush(ID3D12PipelineState* newState)
 {
     Assert(m_CommandAllocator != nullptr && "Tried to flush an inactive context!");
 
-    FlushResourceBarriers();
+    // Nothing follows these barriers so this doesn't count as recording work
+    FlushResourceBarriersEarly();
+    m_StateTracker.CommandListEnded();
+    ReleaseResources();
 
     AssertSuccess(m_CommandList->Close());
     GpuSyncPoint syncPoint = m_CommandQueue.Execute(m_CommandList.Get());
@@ -161,7 +169,9 @@ GpuSyncPoint CommandContext::Finish()
 {
     Assert(m_CommandAllocator != nullptr && "Tried to finish an inactive context!");
 
-    FlushResourceBarriers();
+    FlushResourceBarriersEarly();
+    m_StateTracker.CommandListEnded();
+    ReleaseResources();
 
     AssertSuccess(m_CommandList->Close());
     GpuSyncPoint syncPoint = m_CommandQueue.ExecuteAndReturnAllocator(m_CommandList.Get(), m_CommandAllocator);
@@ -1,6 +1,7 @@
 #pragma once
 #include "pch.h"
 #include "GpuSyncPoint.h"
+#include "ResourceStateTracker.h"
 
 class CommandQueue;
 class GpuResource;
@@ -17,8 +18,7 @@ private:
     ID3D12CommandAllocator* m_CommandAllocator;
     ComPtr<ID3D12GraphicsCommandList> m_CommandList;
 
-    D3D12_RESOURCE_BARRIER m_PendingResourceBarriers[16];
-    uint32_t m_PendingResourceBarrierCount = 0;
+    ResourceStateTracker m_StateTracker;
 
 public:
     CommandContext(CommandQueue& commandQueue);
@@ -26,10 +26,12 @@ public:
 
     void Begin(ID3D12PipelineState* initialPipelineState);
     
-    //TODO: This is inadequate for handling subresource state tracking or implicit resource state decay/promotion
-    // This design also predates enhanced barriers and as such doesn't even slightly consider them
-    // It should be revisited, don't imitate this.
-    void TransitionResource(GpuResource& resource, D3D12_RESOURCE_STATES desiredState, bool immediate);
+    //! Transitions a subresource (or all of them) to the desired state, see ResourceStateTracker for how barriers are batched
+    //TODO: This design predates enhanced barriers and as such doesn't even slightly consider them
+    void TransitionResource(GpuResource& resource, D3D12_RESOURCE_STATES desiredState, uint32_t subresource, bool immediate);
+
+    //! Begins a split barrier, it ends when the subresource is transitioned to the same state
+    void BeginTransitionResource(GpuResource& resource, D3D12_RESOURCE_STATES desiredState, uint32_t subresource);
 
 private:
     void UavBarrier(GpuResource* resource, bool immediate);
@@ -37,6 +39,9 @@ public:
     inline void UavBarrier(bool immediate) { UavBarrier(nullptr, immediate); }
     inline void UavBarrier(GpuResource& resource, bool immediate) { UavBarrier(&resource, immediate); }
 
+    //! Activates a placed resource, any resources it overlaps become inactive
+    void AliasingBarrier(GpuResource& resourceAfter, bool immediate);
+
     void FlushResourceBarriers();
     GpuSyncPoint Flush(ID3D12PipelineState* newState);
 
@@ -44,8 +49,9 @@ public:
 
 private:
     void ResetCommandList(ID3D12PipelineState* initialPipelineState);
-    D3D12_RESOURCE_BARRIER& AllocateResourceBarrier();
+    void InitializeResourceState(GpuResource& resource);
     void FlushResourceBarriersEarly();
+    void ReleaseResources();
 
 #ifdef DEBUG
     std::vector<GpuResource*> m_OwnedResources;
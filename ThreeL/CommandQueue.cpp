@@ -32,12 +32,8 @@ ID3D12CommandAllocator* CommandQueue::RentAllocator()
         std::lock_guard<std::mutex> lock(m_AvailableAllocatorsLock);
         if (!m_AvailableAllocators.empty())
         {
-            AvailableAllocator allocator = m_AvailableAllocators.front();
-            if (allocator.FenceValue <= m_QueueFence->GetCompletedValue())
-            {
-                result = allocator.Allocator;
-                m_AvailableAllocators.pop();
-            }
+            result = m_AvailableAllocators.front();
+            m_AvailableAllocators.pop();
         }
     }
 
@@ -78,11 +74,12 @@ GpuSyncPoint CommandQueue::ExecuteAndReturnAllocator(ID3D12CommandList* commandL
     // Execute the command list and create a final sync point so we know when the allocator is able to be reset
     GpuSyncPoint syncPoint = Execute(commandList);
 
-    // Enqueue the allocator so it can be later reused
-    {
-        std::lock_guard<std::mutex> lock(m_AvailableAllocatorsLock);
-        m_AvailableAllocators.push({ syncPoint.m_FenceValue, allocator });
-    }
+    // Enqueue the allocator once the GPU is done with it so it can be later reused
+    syncPoint.Then(m_GraphicsCore.FenceReactor(), [this, allocator]()
+        {
+            std::lock_guard<std::mutex> lock(m_AvailableAllocatorsLock);
+            m_AvailableAllocators.push(allocator);
+        });
 
     return syncPoint;
 }
@@ -31,14 +31,9 @@ private:
     uint64_t m_PreviousQueueFenceValue;
     ComPtr<ID3D12Fence> m_QueueFence;
 
-    struct AvailableAllocator
-    {
-        uint64_t FenceValue;
-        ID3D12CommandAllocator* Allocator;
-    };
-
+    // Allocators are returned to this queue by the fence reactor once the GPU is done with them
     std::mutex m_AvailableAllocatorsLock;
-    std::queue<AvailableAllocator> m_AvailableAllocators;
+    std::queue<ID3D12CommandAllocator*> m_AvailableAllocators;
     std::mutex m_AllAllocatorsLock;
     std::vector<ComPtr<ID3D12CommandAllocator>> m_AllAllocators;
 
@@ -34,14 +34,29 @@ public:
 
     inline void TransitionResource(GpuResource& resource, D3D12_RESOURCE_STATES desiredState, bool immediate = false)
     {
-        m_Context->TransitionResource(resource, desiredState, immediate);
+        m_Context->TransitionResource(resource, desiredState, D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES, immediate);
+    }
+
+    inline void TransitionSubresource(GpuResource& resource, uint32_t subresource, D3D12_RESOURCE_STATES desiredState, bool immediate = false)
+    {
+        m_Context->TransitionResource(resource, desiredState, subresource, immediate);
+    }
+
+    inline void BeginTransitionResource(GpuResource& resource, D3D12_RESOURCE_STATES desiredState, uint32_t subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES)
+    {
+        m_Context->BeginTransitionResource(resource, desiredState, subresource);
     }
 
     inline void UavBarrier(bool immediate = false) { m_Context->UavBarrier(immediate); }
     inline void UavBarrier(GpuResource& resource, bool immediate = false) { m_Context->UavBarrier(resource, immediate); }
+    inline void AliasingBarrier(GpuResource& resourceAfter, bool immediate = false) { m_Context->AliasingBarrier(resourceAfter, immediate); }
 
-    //TODO: This is to workaround our resource state tracking not working well with resources which map to multiple resourcs (IE: LightLinkedList or textures with subresources.)
-    inline D3D12_RESOURCE_BARRIER& __AllocateResourceBarrier() { return m_Context->AllocateResourceBarrier(); }
+    //! Discards the contents of a resource, only UAV textures can be discarded on compute queues
+    inline void Discard(GpuResource& resource)
+    {
+        m_Context->FlushResourceBarriers();
+        CommandList()->DiscardResource(resource.m_Resource.Get(), nullptr);
+    }
 
     inline void ClearUav(ResourceDescriptor uavDescriptor, const GpuResource& resource, uint4 clearValue = uint4::Zero)
     {
@@ -4,10 +4,17 @@
 #include "GraphicsCore.h"
 
 DepthStencilBuffer::DepthStencilBuffer(GraphicsCore& graphics, const std::wstring& name, uint2 size, DXGI_FORMAT format, float depthClearValue, uint8_t stencilClearValue)
-    : m_Graphics(graphics), m_Name(name), m_Size(), m_Format(format), m_DepthClearValue(depthClearValue), m_StencilClearValue(stencilClearValue)
+    : DepthStencilBuffer(graphics, name, format, depthClearValue, stencilClearValue)
 {
     Assert(size.x > 0 && size.y > 0);
 
+    // Create the buffer and resource views
+    Resize(size);
+}
+
+DepthStencilBuffer::DepthStencilBuffer(GraphicsCore& graphics, const std::wstring& name, DXGI_FORMAT format, float depthClearValue, uint8_t stencilClearValue)
+    : m_Graphics(graphics), m_Name(name), m_Size(), m_Format(format), m_DepthClearValue(depthClearValue), m_StencilClearValue(stencilClearValue)
+{
     // Determine SRV formats
     switch (format)
     {
@@ -47,9 +54,22 @@ DepthStencilBuffer::DepthStencilBuffer(GraphicsCore& graphics, const std::wstrin
     // Allocate descriptors for the SRVs
     m_DepthShaderResourceView = graphics.ResourceDescriptorManager().AllocateDynamicDescriptor();
     m_StencilShaderResourceView = m_StencilSrvFormat == DXGI_FORMAT_UNKNOWN ? DynamicResourceDescriptor() : graphics.ResourceDescriptorManager().AllocateDynamicDescriptor();
+}
 
-    // Create the buffer and resource views
-    Resize(size);
+D3D12_RESOURCE_DESC DepthStencilBuffer::Describe(uint2 size) const
+{
+    return {
+        .Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D,
+        .Alignment = 0,
+        .Width = size.x,
+        .Height = size.y,
+        .DepthOrArraySize = 1,
+        .MipLevels = 1,
+        .Format = m_Format,
+        .SampleDesc = { .Count = 1, .Quality = 0 },
+        .Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN,
+        .Flags = D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL,
+    };
 }
 
 void DepthStencilBuffer::Resize(uint2 newSize)
@@ -67,19 +87,7 @@ void DepthStencilBuffer::Resize(uint2 newSize)
 
     // Allocate the buffer on the GPU
     D3D12_HEAP_PROPERTIES heapProperties = { D3D12_HEAP_TYPE_DEFAULT };
-    D3D12_RESOURCE_DESC resourceDescription =
-    {
-        .Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D,
-        .Alignment = 0,
-        .Width = newSize.x,
-        .Height = newSize.y,
-        .DepthOrArraySize = 1,
-        .MipLevels = 0,
-        .Format = m_Format,
-        .SampleDesc = { .Count = 1, .Quality = 0 },
-        .Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN,
-        .Flags = D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL,
-    };
+    D3D12_RESOURCE_DESC resourceDescription = Describe(newSize);
 
     D3D12_CLEAR_VALUE optimizedClearValue =
     {
@@ -101,9 +109,53 @@ void DepthStencilBuffer::Resize(uint2 newSize)
         IID_PPV_ARGS(&m_Resource)
     ));
     m_Resource->SetName(m_Name.c_str());
-    m_CurrentState = D3D12_RESOURCE_STATE_DEPTH_WRITE;
+    m_State = ResourceState(D3D12_RESOURCE_STATE_DEPTH_WRITE);
     m_Size = newSize;
 
+    CreateViews();
+}
+
+void DepthStencilBuffer::Place(uint2 size, ID3D12Heap* heap, uint64_t heapOffset)
+{
+    // Release the old buffer if we have one
+    m_Resource = nullptr;
+    m_Size = uint2();
+
+    if (heap == nullptr)
+    { return; }
+
+    Assert(size.x > 0 && size.y > 0);
+    D3D12_RESOURCE_DESC resourceDescription = Describe(size);
+    D3D12_CLEAR_VALUE optimizedClearValue =
+    {
+        .Format = m_Format,
+        .DepthStencil =
+        {
+            .Depth = m_DepthClearValue,
+            .Stencil = m_StencilClearValue,
+        },
+    };
+
+    AssertSuccess(m_Graphics.Device()->CreatePlacedResource
+    (
+        heap,
+        heapOffset,
+        &resourceDescription,
+        D3D12_RESOURCE_STATE_DEPTH_WRITE,
+        &optimizedClearValue,
+        IID_PPV_ARGS(&m_Resource)
+    ));
+    m_Resource->SetName(m_Name.c_str());
+    m_State = ResourceState(D3D12_RESOURCE_STATE_DEPTH_WRITE);
+    m_Size = size;
+
+    CreateViews();
+}
+
+void DepthStencilBuffer::CreateViews()
+{
+    ID3D12Device* device = m_Graphics.Device();
+
     // Create the depth-stencil views
     D3D12_CPU_DESCRIPTOR_HANDLE dsvHandle = m_DescriptorHeap->GetCPUDescriptorHandleForHeapStart();
     UINT dsvHandleSize = m_Graphics.Device()->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_DSV);
@@ -33,10 +33,26 @@ private:
 public:
     DepthStencilBuffer(GraphicsCore& graphics, const std::wstring& name, uint2 size, DXGI_FORMAT format = DXGI_FORMAT_D32_FLOAT, float depthClearValue = 0.f, uint8_t stencilClearValue = 0);
 
+    //! Creates a depth stencil buffer without any memory, it must be placed with Place before it's used
+    DepthStencilBuffer(GraphicsCore& graphics, const std::wstring& name, DXGI_FORMAT format = DXGI_FORMAT_D32_FLOAT, float depthClearValue = 0.f, uint8_t stencilClearValue = 0);
+
     //! Resizes the depth stencil buffer
     //! You must ensure all outstanding uses of this buffer on the GPU are complete before calling this method
     void Resize(uint2 newSize);
 
+    //! Describes the resource backing a buffer of the specified size
+    D3D12_RESOURCE_DESC Describe(uint2 size) const;
+
+    //! Recreates the depth stencil buffer as a placed resource, or releases it when heap is null
+    //! Placed depth stencil buffers must be cleared or discarded before they're used.
+    //! You must ensure all outstanding uses of this buffer on the GPU are complete before calling this method
+    void Place(uint2 size, ID3D12Heap* heap, uint64_t heapOffset);
+
+private:
+    void CreateViews();
+
+public:
+
     inline uint2 Size() const { return m_Size; }
     inline float DepthClearValue() const { return m_DepthClearValue; }
     inline uint8_t StencilClearValue() const { return m_StencilClearValue; }
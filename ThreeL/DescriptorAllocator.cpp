@@ -0,0 +1,68 @@
+#include "pch.h"
+#include "DescriptorAllocator.h"
+
+#include <algorithm>
+
+DescriptorAllocator::DescriptorAllocator(uint32_t capacity)
+    : m_Capacity(capacity), m_Generations(capacity, 0)
+{
+    Assert(capacity > 0);
+}
+
+bool DescriptorAllocator::TryAllocate(DescriptorHandle* outHandle)
+{
+    uint32_t index;
+    if (!m_FreeList.empty())
+    {
+        index = m_FreeList.top();
+        m_FreeList.pop();
+    }
+    else if (m_HighWaterMark < m_Capacity)
+    { index = m_HighWaterMark++; }
+    else
+    { return false; }
+
+    uint32_t& generation = m_Generations[index];
+    Assert(generation % 2 == 0);
+    generation++;
+    m_LiveCount++;
+
+    *outHandle = { .Index = index, .Generation = generation };
+    return true;
+}
+
+void DescriptorAllocator::Free(DescriptorHandle handle)
+{
+    Assert(IsLive(handle) && "Attempted to free a descriptor which isn't live, it was either already freed or was never allocated.");
+
+    m_Generations[handle.Index]++;
+    m_LiveCount--;
+    m_FreeList.push(handle.Index);
+}
+
+bool DescriptorAllocator::IsLive(DescriptorHandle handle) const
+{
+    return handle.Index < m_Capacity && handle.Generation % 2 == 1 && m_Generations[handle.Index] == handle.Generation;
+}
+
+DescriptorAllocatorStatistics DescriptorAllocator::Statistics() const
+{
+    DescriptorAllocatorStatistics result =
+    {
+        .Capacity = m_Capacity,
+        .LiveCount = m_LiveCount,
+        .HighWaterMark = m_HighWaterMark,
+        .FreeListCount = (uint32_t)m_FreeList.size(),
+        .LargestFreeRun = 0,
+    };
+
+    // The free list isn't ordered beyond its smallest index, so runs are found by scanning the generations instead
+    uint32_t run = 0;
+    for (uint32_t i = 0; i < m_HighWaterMark; i++)
+    {
+        run = m_Generations[i] % 2 == 0 ? run + 1 : 0;
+        result.LargestFreeRun = std::max(result.LargestFreeRun, run);
+    }
+
+    return result;
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include <functional>
+#include <queue>
+#include <stdint.h>
+#include <vector>
+
+//! A descriptor index allocated from DescriptorAllocator
+//! The generation changes every time the index is allocated or freed, which lets stale handles be detected after their descriptor is reused.
+struct DescriptorHandle
+{
+    uint32_t Index;
+    uint32_t Generation;
+};
+
+//! The result of DescriptorAllocator::Statistics
+struct DescriptorAllocatorStatistics
+{
+    uint32_t Capacity;
+    uint32_t LiveCount;
+
+    //! The number of indices which have ever been allocated, indices past this have never been touched
+    uint32_t HighWaterMark;
+
+    //! Freed indices below the high water mark and the largest run of consecutive indices among them
+    uint32_t FreeListCount;
+    uint32_t LargestFreeRun;
+
+    //! The portion of the space below the high water mark which is free, 0 when the live descriptors are packed together
+    inline float Fragmentation() const { return HighWaterMark == 0 ? 0.f : (float)FreeListCount / (float)HighWaterMark; }
+};
+
+//! Allocates individual descriptor indices from a fixed size range with a free list
+//! Freed indices are reused lowest first, which keeps the live descriptors packed towards the start of the range. This type only deals in indices so
+//! it has no dependency on D3D. It is not thread-safe.
+class DescriptorAllocator
+{
+private:
+    uint32_t m_Capacity;
+    uint32_t m_HighWaterMark = 0;
+    uint32_t m_LiveCount = 0;
+
+    // Odd generations are live, even ones are free (or were never allocated)
+    std::vector<uint32_t> m_Generations;
+    std::priority_queue<uint32_t, std::vector<uint32_t>, std::greater<uint32_t>> m_FreeList;
+
+public:
+    DescriptorAllocator(uint32_t capacity);
+    DescriptorAllocator(const DescriptorAllocator&) = delete;
+
+    //! Returns false when every index is live
+    bool TryAllocate(DescriptorHandle* outHandle);
+
+    //! Frees the handle's index for reuse, the handle must be live
+    void Free(DescriptorHandle handle);
+
+    //! Returns true if the handle refers to a live allocation (IE: it hasn't been freed, even if its index has since been reused)
+    bool IsLive(DescriptorHandle handle) const;
+
+    DescriptorAllocatorStatistics Statistics() const;
+};
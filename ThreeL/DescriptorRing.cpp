@@ -0,0 +1,79 @@
+#include "pch.h"
+#include "DescriptorRing.h"
+
+#include <algorithm>
+
+DescriptorRing::DescriptorRing(uint32_t capacity)
+    : m_Capacity(capacity)
+{
+    Assert(capacity > 0);
+}
+
+bool DescriptorRing::TryAllocate(uint32_t count, uint32_t* outOffset)
+{
+    Assert(count > 0);
+
+    if (count > m_Capacity)
+    { return false; }
+
+    // Skip to the start of the ring if the table would run off the end
+    uint64_t start = m_Head;
+    uint64_t offset = start % m_Capacity;
+    if (offset + count > m_Capacity)
+    { start += m_Capacity - offset; }
+
+    uint64_t end = start + count;
+    if (end - m_Tail > m_Capacity)
+    { return false; }
+
+    *outOffset = (uint32_t)(start % m_Capacity);
+    m_Head = end;
+    m_HighWaterMark = std::max(m_HighWaterMark, UsedCount());
+    return true;
+}
+
+void DescriptorRing::EndFrame(uint64_t fenceValue)
+{
+    Assert((m_Frames.empty() || fenceValue >= m_Frames.back().FenceValue) && "Fence values must not decrease.");
+
+    // Empty frames are still tracked so that every EndFrame has a matching frame, which keeps things simple for callers tracking frames of their own
+    m_PeakFrameUsage = std::max(m_PeakFrameUsage, (uint32_t)(m_Head - m_FrameStart));
+    m_Frames.push_back({ .End = m_Head, .FenceValue = fenceValue });
+    m_FrameStart = m_Head;
+}
+
+void DescriptorRing::Retire(uint64_t completedFenceValue)
+{
+    while (!m_Frames.empty() && m_Frames.front().FenceValue <= completedFenceValue)
+    {
+        m_Tail = m_Frames.front().End;
+        m_Frames.pop_front();
+    }
+
+    // Once everything has been retired the next table may as well start at the beginning of the ring
+    if (m_Frames.empty() && m_Head == m_FrameStart)
+    {
+        m_Head += (m_Capacity - m_Head % m_Capacity) % m_Capacity;
+        m_Tail = m_Head;
+        m_FrameStart = m_Head;
+    }
+}
+
+uint64_t DescriptorRing::OldestFenceValue() const
+{
+    Assert(!m_Frames.empty());
+    return m_Frames.front().FenceValue;
+}
+
+DescriptorRingStatistics DescriptorRing::Statistics() const
+{
+    return
+    {
+        .Capacity = m_Capacity,
+        .UsedCount = UsedCount(),
+        .HighWaterMark = m_HighWaterMark,
+        .FrameUsage = (uint32_t)(m_Head - m_FrameStart),
+        .PeakFrameUsage = m_PeakFrameUsage,
+        .InFlightFrameCount = (uint32_t)m_Frames.size(),
+    };
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include <deque>
+#include <stdint.h>
+
+//! The result of DescriptorRing::Statistics
+struct DescriptorRingStatistics
+{
+    uint32_t Capacity;
+
+    //! Descriptors allocated by frames which the GPU may still be using, including the current one
+    uint32_t UsedCount;
+
+    //! The most descriptors which have ever been in use at once, useful for sizing the ring
+    uint32_t HighWaterMark;
+
+    uint32_t FrameUsage;
+    uint32_t PeakFrameUsage;
+    uint32_t InFlightFrameCount;
+};
+
+//! Bookkeeping for a ring of descriptors which are allocated in contiguous tables and reclaimed a whole frame at a time
+//! Every frame is tagged with a fence value when it ends and its descriptors are reclaimed once that fence value is retired. A table is never split
+//! across the end of the ring, instead the descriptors left at the end are skipped and belong to the frame which skipped them.
+//! This type only deals in offsets and fence values so it has no dependency on D3D. It is not thread-safe.
+class DescriptorRing
+{
+private:
+    struct Frame
+    {
+        uint64_t End;
+        uint64_t FenceValue;
+    };
+
+    uint32_t m_Capacity;
+
+    // Positions are monotonically increasing descriptor counts, the corresponding offset within the ring is the position modulo the capacity
+    uint64_t m_Head = 0;
+    uint64_t m_Tail = 0;
+    uint64_t m_FrameStart = 0;
+
+    // Frames which have ended but haven't been retired yet, from oldest to newest
+    std::deque<Frame> m_Frames;
+
+    uint32_t m_HighWaterMark = 0;
+    uint32_t m_PeakFrameUsage = 0;
+
+public:
+    DescriptorRing(uint32_t capacity);
+    DescriptorRing(const DescriptorRing&) = delete;
+
+    //! Allocates count contiguous descriptors in the current frame
+    //! Returns false when doing so would overwrite descriptors from a frame which hasn't been retired, the caller may wait for the oldest frame to
+    //! complete (see OldestFenceValue) and try again.
+    bool TryAllocate(uint32_t count, uint32_t* outOffset);
+
+    //! Ends the current frame, its descriptors will be reclaimed once fenceValue is retired
+    //! Fence values must not decrease from one frame to the next.
+    void EndFrame(uint64_t fenceValue);
+
+    //! Reclaims the descriptors of every frame which ended with a fence value of at most completedFenceValue
+    void Retire(uint64_t completedFenceValue);
+
+    inline bool HasFramesInFlight() const { return !m_Frames.empty(); }
+
+    //! The fence value of the oldest frame which hasn't been retired, there must be one
+    uint64_t OldestFenceValue() const;
+
+    inline uint32_t Capacity() const { return m_Capacity; }
+    inline uint32_t UsedCount() const { return (uint32_t)(m_Head - m_Tail); }
+    DescriptorRingStatistics Statistics() const;
+};
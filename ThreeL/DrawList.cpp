@@ -0,0 +1,257 @@
+#include "pch.h"
+#include "DrawList.h"
+
+#include "Scene.h"
+
+#include <algorithm>
+#include <unordered_map>
+
+namespace
+{
+    // Sort key layout, most significant first:
+    // [63:48] Pipeline state ordinal
+    // [47:16] Vertex buffer chunk -- MeshHeap chunks are placed on 64 KB boundaries, so the position buffer's address in 64 KB units groups primitives by chunk
+    // [15:0] Material ID
+    uint64_t MakeSortKey(uint32_t pipelineOrdinal, D3D12_GPU_VIRTUAL_ADDRESS positions, uint32_t materialId)
+    {
+        Assert(pipelineOrdinal <= 0xFFFF);
+        uint64_t chunk = (positions / D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT) & 0xFFFFFFFF;
+        return ((uint64_t)pipelineOrdinal << 48) | (chunk << 16) | (materialId & 0xFFFF);
+    }
+
+    // Returns the largest factor by which the transform scales distances
+    float MaxScale(const float4x4& transform)
+    {
+        float3 x(transform.m00, transform.m01, transform.m02);
+        float3 y(transform.m10, transform.m11, transform.m12);
+        float3 z(transform.m20, transform.m21, transform.m22);
+        return std::sqrt(std::max({ x.LengthSquared(), y.LengthSquared(), z.LengthSquared() }));
+    }
+
+    // Returns true if the transform only rotates, mirrors, uniformly scales, and translates (IE: angles between directions are preserved)
+    bool PreservesAngles(const float4x4& transform)
+    {
+        float3 x(transform.m00, transform.m01, transform.m02);
+        float3 y(transform.m10, transform.m11, transform.m12);
+        float3 z(transform.m20, transform.m21, transform.m22);
+
+        const float tolerance = 0.001f;
+        float scaleSquared = x.LengthSquared();
+        return std::abs(y.LengthSquared() - scaleSquared) <= scaleSquared * tolerance
+            && std::abs(z.LengthSquared() - scaleSquared) <= scaleSquared * tolerance
+            && std::abs(x.Dot(y)) <= scaleSquared * tolerance
+            && std::abs(y.Dot(z)) <= scaleSquared * tolerance
+            && std::abs(z.Dot(x)) <= scaleSquared * tolerance;
+    }
+
+    inline float3 TransformNormal(const float3x3& normalTransform, float3 normal)
+    {
+        const float3x3& m = normalTransform;
+        return float3
+        (
+            normal.x * m.m00 + normal.y * m.m10 + normal.z * m.m20,
+            normal.x * m.m01 + normal.y * m.m11 + normal.z * m.m21,
+            normal.x * m.m02 + normal.y * m.m12 + normal.z * m.m22
+        );
+    }
+}
+
+DrawList::DrawList(ResourceManager& resources, const Scene& scene, DrawListPass pass)
+    : m_Pass(pass)
+{
+    // Pipeline states are numbered in the order we first encounter them so that the sort key doesn't depend on pointer values
+    std::unordered_map<ID3D12PipelineState*, uint32_t> pipelineOrdinals;
+
+    for (const SceneNode& node : scene)
+    {
+        // Skip unrenderable nodes (IE: nodes without meshes)
+        if (!node.IsValid()) { continue; }
+
+        uint32_t nodeIndex = (uint32_t)m_Nodes.size();
+        float4x4 worldTransform = node.WorldTransform();
+        float worldScale = MaxScale(worldTransform);
+        float3x3 normalTransform = node.NormalTransform();
+        bool preservesAngles = PreservesAngles(worldTransform);
+        m_Nodes.push_back
+        ({
+            .Transform = worldTransform,
+            .NormalTransform = node.NormalTransform(),
+        });
+
+        for (const MeshPrimitive& primitive : node)
+        {
+            uint32_t primitiveIndex = m_PrimitiveCount++;
+            const PbrMaterial& material = primitive.Material();
+
+            // Transparent primitives are kept in their own list since they need to be sorted by depth every frame
+            if (material.IsTransparent() != (pass == DrawListPass::Transparent))
+            { continue; }
+
+            ID3D12PipelineState* pipelineState;
+            switch (pass)
+            {
+                case DrawListPass::DepthPrePass:
+                    pipelineState = material.IsDoubleSided() ? resources.DepthOnlyDoubleSided : resources.DepthOnlySingleSided;
+                    break;
+                case DrawListPass::Opaque:
+                case DrawListPass::Transparent:
+                    pipelineState = material.PipelineStateObject();
+                    break;
+                case DrawListPass::OpaqueLightDebug:
+                    pipelineState = material.IsDoubleSided() ? resources.PbrLightDebugDoubleSided : resources.PbrLightDebugSingleSided;
+                    break;
+                default:
+                    Fail("Unreachable");
+                    pipelineState = nullptr;
+            }
+
+            uint32_t ordinal = pipelineOrdinals.try_emplace(pipelineState, (uint32_t)pipelineOrdinals.size()).first->second;
+            BoundingBox worldBounds = primitive.Bounds().Transformed(worldTransform);
+
+            uint32_t firstLod = (uint32_t)m_Lods.size();
+            for (MeshLod lod : primitive.Lods())
+            {
+                lod.Error *= worldScale;
+                m_Lods.push_back(lod);
+            }
+
+            // Normal cones only stay valid if the transform doesn't skew angles, and they're meaningless for double sided materials since neither side is culled
+            uint32_t firstCluster = (uint32_t)m_Clusters.size();
+            std::span<const Meshlet> meshlets = primitive.Meshlets();
+            std::span<const MeshletBounds> meshletBounds = primitive.MeshletCullingBounds();
+            bool canConeCull = preservesAngles && !material.IsDoubleSided();
+            for (uint32_t i = 0; i < meshlets.size(); i++)
+            {
+                const MeshletBounds& bounds = meshletBounds[i];
+                float4 worldCenter = worldTransform.Transform(float4(bounds.Center, 1.f));
+                DrawListCluster cluster =
+                {
+                    .Bounds = { float3(worldCenter.x, worldCenter.y, worldCenter.z), bounds.Radius * worldScale },
+                    .ConeAxis = float3::Zero,
+                    .ConeCutoff = 1.f,
+                    .FirstIndex = meshlets[i].FirstTriangle * 3,
+                    .IndexCount = meshlets[i].TriangleCount * 3,
+                };
+
+                if (canConeCull && bounds.ConeCutoff < 1.f)
+                {
+                    cluster.ConeAxis = TransformNormal(normalTransform, bounds.ConeAxis).Normalized();
+                    cluster.ConeCutoff = bounds.ConeCutoff;
+                }
+
+                m_Clusters.push_back(cluster);
+            }
+
+            DrawPacket packet =
+            {
+                .SortKey = MakeSortKey(ordinal, primitive.Positions().BufferLocation, material.MaterialId()),
+                .PipelineState = pipelineState,
+                .Positions = primitive.Positions(),
+                .Normals = primitive.Normals(),
+                .Uvs = primitive.Uvs(),
+                .Indices = primitive.Indices(),
+                .NodeIndex = nodeIndex,
+                .PrimitiveIndex = primitiveIndex,
+                .MaterialId = material.MaterialId(),
+                .ColorsIndex = primitive.ColorsBufferIndex(),
+                .TangentsIndex = primitive.TangentsBufferIndex(),
+                .VertexOrIndexCount = primitive.VertexOrIndexCount(),
+                .IsIndexed = primitive.IsIndexed(),
+                .FirstLod = firstLod,
+                .LodCount = (uint32_t)primitive.Lods().size(),
+                .FirstCluster = firstCluster,
+                .ClusterCount = (uint32_t)meshlets.size(),
+                .BoundsCenter = worldBounds.Center(),
+                .BoundsExtents = worldBounds.Extents(),
+            };
+            m_Packets.push_back(packet);
+        }
+    }
+
+    // Stable so that draws with identical keys stay in scene order, which keeps same-node draws adjacent for the root constants
+    std::stable_sort(m_Packets.begin(), m_Packets.end(), [](const DrawPacket& a, const DrawPacket& b) { return a.SortKey < b.SortKey; });
+}
+
+DrawList::DrawList(DrawListPass pass, std::vector<DrawPacket> packets, std::vector<ShaderInterop::PerNodeCb> nodes, uint32_t primitiveCount, std::vector<MeshLod> lods, std::vector<DrawListCluster> clusters)
+    : m_Pass(pass), m_Packets(std::move(packets)), m_PrimitiveCount(primitiveCount), m_Lods(std::move(lods)), m_Clusters(std::move(clusters)), m_Nodes(std::move(nodes))
+{
+    for (const DrawPacket& packet : m_Packets)
+    {
+        Assert(packet.NodeIndex < m_Nodes.size());
+        Assert(packet.PrimitiveIndex < m_PrimitiveCount);
+        Assert(packet.FirstLod + packet.LodCount <= m_Lods.size());
+        Assert(packet.FirstCluster + packet.ClusterCount <= m_Clusters.size());
+    }
+
+    std::stable_sort(m_Packets.begin(), m_Packets.end(), [](const DrawPacket& a, const DrawPacket& b) { return a.SortKey < b.SortKey; });
+}
+
+std::vector<BoundingBox> DrawList::PrimitiveBounds() const
+{
+    std::vector<BoundingBox> result(m_PrimitiveCount, BoundingBox::Empty());
+    for (const DrawPacket& packet : m_Packets)
+    { result[packet.PrimitiveIndex] = BoundingBox::FromCenterExtents(packet.BoundsCenter, packet.BoundsExtents); }
+
+    return result;
+}
+
+void DrawList::SelectLods(float3 eyePosition, float pixelsPerUnit, float maxPixelError, std::span<uint8_t> primitiveLods) const
+{
+    Assert(primitiveLods.size() == m_PrimitiveCount);
+
+    for (const DrawPacket& packet : m_Packets)
+    {
+        // Distance is measured to the nearest point of the bounds so that the camera can never be closer to the primitive than we think
+        float3 offset = eyePosition - packet.BoundsCenter;
+        offset = float3(std::abs(offset.x), std::abs(offset.y), std::abs(offset.z)) - packet.BoundsExtents;
+        offset = float3(std::max(offset.x, 0.f), std::max(offset.y, 0.f), std::max(offset.z, 0.f));
+        float distance = offset.Length();
+
+        // Errors grow with each LOD, so the first acceptable one from the coarsest end is the coarsest acceptable one
+        uint8_t lod = 0;
+        for (uint32_t i = packet.LodCount; i > 0; i--)
+        {
+            if (m_Lods[packet.FirstLod + i - 1].Error * pixelsPerUnit <= maxPixelError * distance)
+            {
+                lod = (uint8_t)i;
+                break;
+            }
+        }
+
+        primitiveLods[packet.PrimitiveIndex] = lod;
+    }
+}
+
+std::vector<DrawListChunk> DrawList::Chunks(std::span<const DrawPacket> packets, uint32_t maxChunkCount, uint32_t minChunkSize)
+{
+    Assert(maxChunkCount > 0);
+    uint32_t packetCount = (uint32_t)packets.size();
+    uint32_t chunkCount = std::clamp(packetCount / std::max(minChunkSize, 1u), 1u, maxChunkCount);
+    uint32_t idealChunkSize = packetCount / chunkCount;
+
+    std::vector<DrawListChunk> result;
+    result.reserve(chunkCount);
+
+    uint32_t start = 0;
+    for (uint32_t i = 1; i < chunkCount; i++)
+    {
+        // Nudge the boundary forward to the next pipeline state change if there's one nearby since the chunk will have to set the pipeline state anyway
+        // (The nudge is limited to a quarter of a chunk to keep the chunks reasonably balanced.)
+        uint32_t end = std::max(i * idealChunkSize, start + 1);
+        uint32_t limit = std::min(end + idealChunkSize / 4, packetCount - 1);
+        for (uint32_t candidate = end; candidate <= limit; candidate++)
+        {
+            if (packets[candidate].PipelineState != packets[candidate - 1].PipelineState)
+            {
+                end = candidate;
+                break;
+            }
+        }
+
+        result.push_back({ start, end - start });
+        start = end;
+    }
+
+    result.push_back({ start, packetCount - start });
+    return result;
+}
@@ -0,0 +1,297 @@
+#pragma once
+#include "Bounds.h"
+#include "MeshPrimitive.h"
+#include "ResourceManager.h"
+#include "ShaderInterop.h"
+
+#include <d3d12.h>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+class Scene;
+
+//! Determines which pipeline states and vertex streams a DrawList is baked for
+enum class DrawListPass
+{
+    DepthPrePass,
+    Opaque,
+    OpaqueLightDebug,
+    //! Alpha blended primitives, the packets must be re-ordered every frame by TransparentDrawList
+    Transparent,
+};
+
+//! A single pre-baked draw
+//! Packets are plain old data so that submission is a linear walk over memory with no indirection through the scene
+struct DrawPacket
+{
+    uint64_t SortKey;
+    ID3D12PipelineState* PipelineState;
+    D3D12_VERTEX_BUFFER_VIEW Positions;
+    D3D12_VERTEX_BUFFER_VIEW Normals;
+    D3D12_VERTEX_BUFFER_VIEW Uvs;
+    D3D12_INDEX_BUFFER_VIEW Indices;
+    uint32_t NodeIndex;
+    uint32_t PrimitiveIndex;
+    uint32_t MaterialId;
+    uint32_t ColorsIndex;
+    uint32_t TangentsIndex;
+    uint32_t VertexOrIndexCount;
+    bool IsIndexed;
+
+    // The range of DrawList::Lods() for the primitive's simplified LODs, LOD 0 is the packet's own geometry and isn't included
+    uint32_t FirstLod;
+    uint32_t LodCount;
+
+    // The range of DrawList::Clusters() for the primitive's meshlets, empty for primitives without any
+    uint32_t FirstCluster;
+    uint32_t ClusterCount;
+
+    // World space bounding box
+    float3 BoundsCenter;
+    float3 BoundsExtents;
+};
+static_assert(std::is_trivially_copyable_v<DrawPacket>);
+
+//! World space culling data for one of a packet's meshlets, see ClusterCuller
+struct DrawListCluster
+{
+    BoundingSphere Bounds;
+
+    //! See MeshletBounds, the cutoff is 1 when the cone can't be used
+    float3 ConeAxis;
+    float ConeCutoff;
+
+    //! The meshlet's range of the packet's full detail index buffer
+    uint32_t FirstIndex;
+    uint32_t IndexCount;
+};
+
+//! A range of a packet's full detail index buffer which survived cluster culling
+struct ClusterDraw
+{
+    uint32_t FirstIndex;
+    uint32_t IndexCount;
+};
+
+//! The output of ClusterCuller, indexed by DrawPacket::PrimitiveIndex like primitive visibility and LODs
+struct ClusterDrawSet
+{
+    static constexpr uint32_t NotClusterCulled = UINT32_MAX;
+
+    //! The range of Draws for each primitive, primitives which weren't cluster culled have a count of NotClusterCulled and are drawn normally
+    std::vector<uint32_t> PrimitiveFirstDraw;
+    std::vector<uint32_t> PrimitiveDrawCount;
+    std::vector<ClusterDraw> Draws;
+
+    inline bool IsClusterCulled(uint32_t primitive) const { return PrimitiveDrawCount[primitive] != NotClusterCulled; }
+    inline std::span<const ClusterDraw> PrimitiveDraws(uint32_t primitive) const
+    { return std::span(Draws).subspan(PrimitiveFirstDraw[primitive], PrimitiveDrawCount[primitive]); }
+};
+
+//! Counts of the commands emitted by DrawList::Submit
+struct DrawListStatistics
+{
+    uint32_t DrawCount;
+    uint32_t InstanceCount;
+    uint32_t PipelineStateChanges;
+    uint32_t VertexBufferChanges;
+    uint32_t IndexBufferChanges;
+    uint32_t RootConstantChanges;
+    uint32_t InstanceBufferChanges;
+};
+
+//! A contiguous range of packets within a DrawList
+struct DrawListChunk
+{
+    uint32_t First;
+    uint32_t Count;
+};
+
+//! Flattens the opaque primitives of a Scene into draw packets sorted by pipeline state, vertex buffer chunk, and material
+//! Scenes are static, so the list is built once up-front rather than re-walking the scene graph every frame.
+//! Lists for DrawListPass::Transparent contain only the transparent primitives instead, see TransparentDrawList.
+class DrawList
+{
+private:
+    DrawListPass m_Pass;
+    std::vector<DrawPacket> m_Packets;
+
+    // Number of primitives in the scene, including ones which were skipped
+    uint32_t m_PrimitiveCount = 0;
+
+    // LODs of every packet, errors are scaled to world space
+    std::vector<MeshLod> m_Lods;
+
+    // Meshlets of every packet
+    std::vector<DrawListCluster> m_Clusters;
+
+    // Per-node root constants, only Transform and NormalTransform are meaningful
+    // (The per-primitive tail of PerNodeCb comes from the packet.)
+    std::vector<ShaderInterop::PerNodeCb> m_Nodes;
+
+    static constexpr uint32_t PerPrimitiveConstantsOffset = offsetof(ShaderInterop::PerNodeCb, MaterialId) / sizeof(uint32_t);
+    static constexpr uint32_t PerPrimitiveConstantsCount = sizeof(ShaderInterop::PerNodeCb) / sizeof(uint32_t) - PerPrimitiveConstantsOffset;
+
+public:
+    DrawList(ResourceManager& resources, const Scene& scene, DrawListPass pass);
+
+    //! Creates a list from packets which were built elsewhere (IE: synthetic packets for testing), the packets are sorted the same way as above
+    DrawList(DrawListPass pass, std::vector<DrawPacket> packets, std::vector<ShaderInterop::PerNodeCb> nodes, uint32_t primitiveCount, std::vector<MeshLod> lods = { }, std::vector<DrawListCluster> clusters = { });
+
+    inline DrawListPass Pass() const { return m_Pass; }
+    inline std::span<const DrawPacket> Packets() const { return m_Packets; }
+    inline std::span<const ShaderInterop::PerNodeCb> Nodes() const { return m_Nodes; }
+    inline std::span<const MeshLod> Lods() const { return m_Lods; }
+    inline std::span<const DrawListCluster> Clusters() const { return m_Clusters; }
+
+    inline uint32_t PrimitiveCount() const { return m_PrimitiveCount; }
+
+    //! Returns the world space bounds of every primitive in the scene indexed by DrawPacket::PrimitiveIndex, skipped primitives have empty bounds
+    //! Draw lists built from the same scene number their primitives the same way, so the result can be used to cull any of them.
+    std::vector<BoundingBox> PrimitiveBounds() const;
+
+    //! Picks the coarsest LOD of every primitive whose error projects to no more than maxPixelError pixels when viewed from the specified position
+    //! pixelsPerUnit is the projected size in pixels of something one unit across at a distance of one unit (IE: the vertical projection scale times half the
+    //! screen height). Like PrimitiveBounds the result is indexed by DrawPacket::PrimitiveIndex and can be used with any draw list of the same scene.
+    void SelectLods(float3 eyePosition, float pixelsPerUnit, float maxPixelError, std::span<uint8_t> primitiveLods) const;
+
+    //! Returns the index buffer and index count to use when drawing the specified LOD of a packet
+    inline std::pair<const D3D12_INDEX_BUFFER_VIEW*, uint32_t> LodIndices(const DrawPacket& packet, uint32_t lod) const
+    { return LodIndices(m_Lods, packet, lod); }
+
+    static inline std::pair<const D3D12_INDEX_BUFFER_VIEW*, uint32_t> LodIndices(std::span<const MeshLod> lods, const DrawPacket& packet, uint32_t lod)
+    {
+        if (lod == 0)
+        { return { &packet.Indices, packet.VertexOrIndexCount }; }
+
+        Assert(lod <= packet.LodCount);
+        const MeshLod& meshLod = lods[packet.FirstLod + lod - 1];
+        return { &meshLod.Indices, meshLod.IndexCount };
+    }
+
+    //! Splits the list into at most maxChunkCount chunks for recording on separate command lists
+    //! Chunks are roughly minChunkSize packets or larger and prefer to start on a pipeline state change.
+    inline std::vector<DrawListChunk> Chunks(uint32_t maxChunkCount, uint32_t minChunkSize) const
+    { return Chunks(m_Packets, maxChunkCount, minChunkSize); }
+
+    //! Chunks an arbitrary span of packets the same way as above
+    static std::vector<DrawListChunk> Chunks(std::span<const DrawPacket> packets, uint32_t maxChunkCount, uint32_t minChunkSize);
+
+    //! Records the draws to the specified command list, skipping state which is already set
+    //! The PBR root signature must already be bound and any pending resource barriers must have been flushed.
+    //! TCommandList only needs the subset of ID3D12GraphicsCommandList used below, which allows recording into something other than a real command list.
+    //! If primitiveVisibility is not empty, draws for primitives with a visibility of 0 are skipped.
+    //! If primitiveLods is not empty, primitives are drawn using the LODs from SelectLods rather than their full detail geometry.
+    //! If clusterDraws is not null, cluster culled primitives only draw their surviving index ranges (and are skipped entirely if there are none.)
+    template<typename TCommandList>
+    DrawListStatistics Submit(TCommandList* commandList, DrawListChunk chunk, std::span<const uint8_t> primitiveVisibility = { }, std::span<const uint8_t> primitiveLods = { }, const ClusterDrawSet* clusterDraws = nullptr) const;
+
+    template<typename TCommandList>
+    inline DrawListStatistics Submit(TCommandList* commandList, std::span<const uint8_t> primitiveVisibility = { }, std::span<const uint8_t> primitiveLods = { }, const ClusterDrawSet* clusterDraws = nullptr) const
+    { return Submit(commandList, DrawListChunk { 0, (uint32_t)m_Packets.size() }, primitiveVisibility, primitiveLods, clusterDraws); }
+};
+
+template<typename TCommandList>
+DrawListStatistics DrawList::Submit(TCommandList* commandList, DrawListChunk chunk, std::span<const uint8_t> primitiveVisibility, std::span<const uint8_t> primitiveLods, const ClusterDrawSet* clusterDraws) const
+{
+    Assert(chunk.First + chunk.Count <= m_Packets.size());
+    Assert(primitiveVisibility.empty() || primitiveVisibility.size() == m_PrimitiveCount);
+    Assert(primitiveLods.empty() || primitiveLods.size() == m_PrimitiveCount);
+
+    DrawListStatistics statistics = { };
+    const bool bindNormals = m_Pass != DrawListPass::DepthPrePass;
+
+    // The previous state starts out invalid so that the first packet always binds everything
+    // (We can't rely on whatever happened to be bound before the pass or the chunk.)
+    const DrawPacket* previous = nullptr;
+    const D3D12_INDEX_BUFFER_VIEW* boundIndices = nullptr;
+
+    for (const DrawPacket& packet : std::span(m_Packets).subspan(chunk.First, chunk.Count))
+    {
+        if (!primitiveVisibility.empty() && !primitiveVisibility[packet.PrimitiveIndex])
+        { continue; }
+
+        const bool isClusterCulled = clusterDraws != nullptr && clusterDraws->IsClusterCulled(packet.PrimitiveIndex);
+        if (isClusterCulled && clusterDraws->PrimitiveDraws(packet.PrimitiveIndex).empty())
+        { continue; }
+
+        if (previous == nullptr || packet.PipelineState != previous->PipelineState)
+        {
+            commandList->SetPipelineState(packet.PipelineState);
+            statistics.PipelineStateChanges++;
+        }
+
+        auto SetVertexBuffer = [&](UINT slot, const D3D12_VERTEX_BUFFER_VIEW& view, const D3D12_VERTEX_BUFFER_VIEW* previousView)
+            {
+                if (previousView != nullptr && memcmp(&view, previousView, sizeof(view)) == 0)
+                { return; }
+
+                commandList->IASetVertexBuffers(slot, 1, &view);
+                statistics.VertexBufferChanges++;
+            };
+
+        SetVertexBuffer(MeshInputSlot::Position, packet.Positions, previous == nullptr ? nullptr : &previous->Positions);
+        if (bindNormals)
+        { SetVertexBuffer(MeshInputSlot::Normal, packet.Normals, previous == nullptr ? nullptr : &previous->Normals); }
+        SetVertexBuffer(MeshInputSlot::Uv0, packet.Uvs, previous == nullptr ? nullptr : &previous->Uvs);
+
+        if (previous == nullptr || packet.NodeIndex != previous->NodeIndex)
+        {
+            ShaderInterop::PerNodeCb perNode = m_Nodes[packet.NodeIndex];
+            perNode.MaterialId = packet.MaterialId;
+            perNode.ColorsIndex = packet.ColorsIndex;
+            perNode.TangentsIndex = packet.TangentsIndex;
+            commandList->SetGraphicsRoot32BitConstants(ShaderInterop::Pbr::RpPerNodeCb, sizeof(perNode) / sizeof(uint32_t), &perNode, 0);
+            statistics.RootConstantChanges++;
+        }
+        else if (packet.MaterialId != previous->MaterialId || packet.ColorsIndex != previous->ColorsIndex || packet.TangentsIndex != previous->TangentsIndex)
+        {
+            // Same node, so only the per-primitive tail of the constants needs to change
+            uint32_t perPrimitive[] = { packet.MaterialId, packet.ColorsIndex, packet.TangentsIndex };
+            static_assert(std::size(perPrimitive) == PerPrimitiveConstantsCount);
+            commandList->SetGraphicsRoot32BitConstants(ShaderInterop::Pbr::RpPerNodeCb, PerPrimitiveConstantsCount, perPrimitive, PerPrimitiveConstantsOffset);
+            statistics.RootConstantChanges++;
+        }
+
+        if (packet.IsIndexed)
+        {
+            uint32_t lod = primitiveLods.empty() ? 0 : primitiveLods[packet.PrimitiveIndex];
+            Assert(!isClusterCulled || lod == 0);
+
+            auto [indices, indexCount] = LodIndices(packet, lod);
+            if (boundIndices == nullptr || memcmp(indices, boundIndices, sizeof(*indices)) != 0)
+            {
+                commandList->IASetIndexBuffer(indices);
+                boundIndices = indices;
+                statistics.IndexBufferChanges++;
+            }
+
+            if (isClusterCulled)
+            {
+                for (const ClusterDraw& draw : clusterDraws->PrimitiveDraws(packet.PrimitiveIndex))
+                {
+                    commandList->DrawIndexedInstanced(draw.IndexCount, 1, draw.FirstIndex, 0, 0);
+                    statistics.DrawCount++;
+                    statistics.InstanceCount++;
+                }
+            }
+            else
+            {
+                commandList->DrawIndexedInstanced(indexCount, 1, 0, 0, 0);
+                statistics.DrawCount++;
+                statistics.InstanceCount++;
+            }
+        }
+        else
+        {
+            commandList->DrawInstanced(packet.VertexOrIndexCount, 1, 0, 0);
+            statistics.DrawCount++;
+            statistics.InstanceCount++;
+        }
+
+        previous = &packet;
+    }
+
+    return statistics;
+}
@@ -1,4 +1,5 @@
 #pragma once
+#include "DescriptorAllocator.h"
 #include "ResourceDescriptor.h"
 
 #include <d3d12.h>
@@ -14,7 +15,7 @@ private:
     ID3D12Device* m_Device;
     ResourceDescriptor m_ResourceDescriptor;
     D3D12_CPU_DESCRIPTOR_HANDLE m_ResidentCpuHandle;
-    DynamicResourceDescriptor(const ResourceDescriptorManager& manager, uint32_t index);
+    DynamicResourceDescriptor(const ResourceDescriptorManager& manager, DescriptorHandle handle);
 
     inline void CopyToGpu()
     {
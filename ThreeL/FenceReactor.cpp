@@ -0,0 +1,111 @@
+#include "pch.h"
+#include "FenceReactor.h"
+
+FenceReactor::FenceReactor(ReactorWaiter& waiter)
+    : m_Waiter(waiter)
+{
+    m_Thread = std::thread([this]() { ReactorMain(); });
+    SetThreadDescription(m_Thread.native_handle(), L"ThreeL Fence Reactor");
+}
+
+void FenceReactor::Then(const ReactorFence& fence, uint64_t value, std::function<void()>&& callback)
+{
+    bool needsWake;
+    {
+        std::lock_guard<std::mutex> lock(m_Lock);
+        Assert((!m_IsShuttingDown || std::this_thread::get_id() == m_Thread.get_id()) && "Only callbacks can register callbacks while the reactor is shutting down.");
+
+        WatchedFence* watched = nullptr;
+        for (WatchedFence& candidate : m_Fences)
+        {
+            if (candidate.Fence == &fence)
+            {
+                watched = &candidate;
+                break;
+            }
+        }
+
+        if (watched == nullptr)
+        { watched = &m_Fences.emplace_back(WatchedFence { .Fence = &fence }); }
+
+        // The reactor only needs to be woken if it's waiting for a later value than this one (or not waiting on this fence at all)
+        needsWake = watched->Callbacks.empty() || value < watched->Callbacks.begin()->first;
+        watched->Callbacks.emplace(value, std::move(callback));
+    }
+
+    if (needsWake)
+    { m_Waiter.Wake(); }
+}
+
+void FenceReactor::Post(std::function<void()>&& callback)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_Lock);
+        Assert((!m_IsShuttingDown || std::this_thread::get_id() == m_Thread.get_id()) && "Only callbacks can post callbacks while the reactor is shutting down.");
+        m_PostedCallbacks.push_back(std::move(callback));
+    }
+
+    m_Waiter.Wake();
+}
+
+void FenceReactor::ReactorMain()
+{
+    std::vector<std::function<void()>> readyCallbacks;
+    std::vector<const ReactorFence*> waitFences;
+    std::vector<uint64_t> waitValues;
+
+    while (true)
+    {
+        waitFences.clear();
+        waitValues.clear();
+        {
+            std::lock_guard<std::mutex> lock(m_Lock);
+            readyCallbacks.swap(m_PostedCallbacks);
+
+            for (WatchedFence& watched : m_Fences)
+            {
+                if (watched.Callbacks.empty())
+                { continue; }
+
+                uint64_t completedValue = watched.Fence->CompletedValue();
+                auto end = watched.Callbacks.upper_bound(completedValue);
+                for (auto it = watched.Callbacks.begin(); it != end; it++)
+                { readyCallbacks.push_back(std::move(it->second)); }
+                watched.Callbacks.erase(watched.Callbacks.begin(), end);
+
+                if (!watched.Callbacks.empty())
+                {
+                    waitFences.push_back(watched.Fence);
+                    waitValues.push_back(watched.Callbacks.begin()->first);
+                }
+            }
+
+            if (readyCallbacks.empty() && waitFences.empty() && m_IsShuttingDown)
+            { break; }
+        }
+
+        // Callbacks run without the lock held so that they can register more callbacks, which is also why the fences are checked again before waiting
+        if (!readyCallbacks.empty())
+        {
+            for (std::function<void()>& callback : readyCallbacks)
+            { callback(); }
+
+            // Clearing destroys the callbacks, which releases anything they captured
+            readyCallbacks.clear();
+            continue;
+        }
+
+        m_Waiter.WaitForAny(waitFences, waitValues);
+    }
+}
+
+FenceReactor::~FenceReactor()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_Lock);
+        m_IsShuttingDown = true;
+    }
+
+    m_Waiter.Wake();
+    m_Thread.join();
+}
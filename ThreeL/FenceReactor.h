@@ -0,0 +1,72 @@
+#pragma once
+#include <functional>
+#include <map>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <vector>
+
+//! A fence as seen by FenceReactor
+//! The reactor only deals in these and ReactorWaiter so that it has no dependency on D3D, see GpuFenceReactor for the D3D12 implementation.
+class ReactorFence
+{
+public:
+    virtual uint64_t CompletedValue() const = 0;
+    virtual ~ReactorFence() = default;
+};
+
+//! Blocks the reactor thread until there's something for it to do
+class ReactorWaiter
+{
+public:
+    //! Blocks until any fences[i] reaches values[i] or Wake is called, returns immediately if either already happened
+    //! Spurious returns are allowed.
+    virtual void WaitForAny(std::span<const ReactorFence* const> fences, std::span<const uint64_t> values) = 0;
+
+    //! Wakes the thread blocked in WaitForAny, or makes its next call return immediately if it isn't blocked
+    virtual void Wake() = 0;
+
+    virtual ~ReactorWaiter() = default;
+};
+
+//! Runs callbacks on a background thread once fences reach the values they were registered with
+//! Callbacks for the same fence run in order of their fence values, callbacks with the same value run in the order they were registered.
+//! All callbacks run on the reactor's thread, so they should be short and must not block on GPU work which hasn't been submitted yet.
+//! This type is free-threaded.
+class FenceReactor
+{
+private:
+    struct WatchedFence
+    {
+        const ReactorFence* Fence;
+        std::multimap<uint64_t, std::function<void()>> Callbacks;
+    };
+
+    ReactorWaiter& m_Waiter;
+
+    // The following are protected by m_Lock
+    std::mutex m_Lock;
+    std::vector<WatchedFence> m_Fences;
+    std::vector<std::function<void()>> m_PostedCallbacks;
+    bool m_IsShuttingDown = false;
+
+    std::thread m_Thread;
+
+public:
+    //! The waiter must outlive the reactor
+    FenceReactor(ReactorWaiter& waiter);
+    FenceReactor(const FenceReactor&) = delete;
+
+    //! Runs callback once fence reaches value, the fence must outlive the reactor
+    void Then(const ReactorFence& fence, uint64_t value, std::function<void()>&& callback);
+
+    //! Runs callback on the reactor's thread as soon as possible
+    void Post(std::function<void()>&& callback);
+
+private:
+    void ReactorMain();
+
+public:
+    //! Waits for every registered callback to run, which means waiting for the fences to reach their values
+    ~FenceReactor();
+};
@@ -0,0 +1,56 @@
+#include "pch.h"
+#include "FrameConstantAllocator.h"
+
+#include "GraphicsCore.h"
+
+FrameConstantAllocator::FrameConstantAllocator(GraphicsCore& graphics, uint64_t frameCapacity, const std::wstring& debugName)
+    : m_Graphics(graphics), m_Allocator(frameCapacity, FRAME_COUNT)
+{
+    D3D12_HEAP_PROPERTIES heapProperties = { D3D12_HEAP_TYPE_UPLOAD };
+    D3D12_RESOURCE_DESC description = DescribeBufferResource(m_Allocator.BufferSize());
+    AssertSuccess(graphics.Device()->CreateCommittedResource
+    (
+        &heapProperties,
+        D3D12_HEAP_FLAG_CREATE_NOT_ZEROED,
+        &description,
+        D3D12_RESOURCE_STATE_GENERIC_READ,
+        nullptr,
+        IID_PPV_ARGS(&m_Buffer)
+    ));
+    m_Buffer->SetName(debugName.c_str());
+
+    // The buffer stays mapped for its entire lifetime, which is fine for upload heaps
+    D3D12_RANGE emptyRange = { }; // We aren't going to read anything
+    AssertSuccess(m_Buffer->Map(0, &emptyRange, (void**)&m_MappedBuffer));
+    m_GpuAddress = m_Buffer->GetGPUVirtualAddress();
+}
+
+void FrameConstantAllocator::BeginFrame()
+{
+    uint32_t frame = m_Allocator.BeginFrame();
+    m_GraphicsSyncPoints[frame].Wait();
+    m_ComputeSyncPoints[frame].Wait();
+}
+
+void FrameConstantAllocator::EndFrame()
+{
+    uint32_t frame = m_Allocator.CurrentFrame();
+    Assert(frame < FRAME_COUNT && "EndFrame called before the first frame began.");
+    m_GraphicsSyncPoints[frame] = m_Graphics.GraphicsQueue().QueueSyncPoint();
+    m_ComputeSyncPoints[frame] = m_Graphics.ComputeQueue().QueueSyncPoint();
+}
+
+FrameConstantAllocation FrameConstantAllocator::Allocate(uint64_t sizeBytes)
+{
+    uint64_t offset = m_Allocator.Allocate(sizeBytes);
+    if (offset == FrameLinearAllocator::NoAllocation)
+    {
+        Fail("Frame constant allocator exhausted.");
+    }
+
+    return
+    {
+        .Data = std::span(m_MappedBuffer + offset, sizeBytes),
+        .GpuAddress = m_GpuAddress + offset,
+    };
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include "pch.h"
+#include "FrameLinearAllocator.h"
+#include "GpuSyncPoint.h"
+#include "SwapChain.h"
+
+class GraphicsCore;
+
+struct FrameConstantAllocation
+{
+    std::span<uint8_t> Data;
+    D3D12_GPU_VIRTUAL_ADDRESS GpuAddress;
+};
+
+//! Allocates constant buffers (and other small bits of data read by the GPU) which only need to live until the end of the frame they were allocated in
+//! Allocations come straight from a persistently mapped upload heap, so unlike FrequentlyUpdatedResource there's no copy queue upload or cross-queue
+//! synchronization involved. Allocate and Push are free-threaded so that per-draw and per-dispatch constants can be pushed while recording on the job
+//! system, BeginFrame and EndFrame must not race with them.
+class FrameConstantAllocator
+{
+public:
+    static const uint32_t FRAME_COUNT = SwapChain::BACK_BUFFER_COUNT;
+    static_assert(FrameLinearAllocator::Alignment == D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT);
+
+private:
+    GraphicsCore& m_Graphics;
+    ComPtr<ID3D12Resource> m_Buffer;
+    uint8_t* m_MappedBuffer;
+    D3D12_GPU_VIRTUAL_ADDRESS m_GpuAddress;
+    FrameLinearAllocator m_Allocator;
+
+    // The end of the GPU work from the last frame which used each region
+    GpuSyncPoint m_GraphicsSyncPoints[FRAME_COUNT];
+    GpuSyncPoint m_ComputeSyncPoints[FRAME_COUNT];
+
+public:
+    //! The frame capacity must be a multiple of the constant buffer alignment
+    FrameConstantAllocator(GraphicsCore& graphics, uint64_t frameCapacity, const std::wstring& debugName);
+    FrameConstantAllocator(const FrameConstantAllocator&) = delete;
+
+    //! Starts a new frame, waiting for the GPU to finish with the last frame which used the same region
+    //! (SwapChain::Present normally already waited for that frame, so this rarely blocks.)
+    void BeginFrame();
+
+    //! Ends the current frame, must be called once all of the frame's work has been submitted to the graphics and compute queues
+    void EndFrame();
+
+    //! Allocates memory which is valid until the end of the current frame, the address is aligned for use as a constant buffer view
+    FrameConstantAllocation Allocate(uint64_t sizeBytes);
+
+    //! Copies the data into a new allocation and returns its GPU address
+    template<typename T>
+    D3D12_GPU_VIRTUAL_ADDRESS Push(const T& data)
+    {
+        FrameConstantAllocation allocation = Allocate(sizeof(T));
+        memcpy(allocation.Data.data(), &data, sizeof(T));
+        return allocation.GpuAddress;
+    }
+
+    inline uint64_t FrameUsage() const { return m_Allocator.FrameUsage(); }
+    inline uint64_t PeakFrameUsage() const { return m_Allocator.PeakFrameUsage(); }
+};
@@ -0,0 +1,34 @@
+#include "pch.h"
+#include "FrameLinearAllocator.h"
+
+#include <algorithm>
+
+FrameLinearAllocator::FrameLinearAllocator(uint64_t frameCapacity, uint32_t frameCount)
+    : m_FrameCapacity(frameCapacity), m_FrameCount(frameCount)
+{
+    Assert(frameCapacity > 0 && frameCapacity % Alignment == 0);
+    Assert(frameCount > 0);
+}
+
+uint32_t FrameLinearAllocator::BeginFrame()
+{
+    if (m_CurrentFrame != UINT32_MAX)
+    { m_PeakFrameUsage = std::max(m_PeakFrameUsage, FrameUsage()); }
+
+    m_CurrentFrame = m_CurrentFrame == UINT32_MAX ? 0 : (m_CurrentFrame + 1) % m_FrameCount;
+    m_FrameUsage.store(0, std::memory_order_relaxed);
+    return m_CurrentFrame;
+}
+
+uint64_t FrameLinearAllocator::Allocate(uint64_t sizeBytes)
+{
+    Assert(m_CurrentFrame != UINT32_MAX && "Allocations can't be made before the first frame begins.");
+    Assert(sizeBytes > 0);
+
+    uint64_t alignedSize = (sizeBytes + Alignment - 1) & ~(Alignment - 1);
+    uint64_t offset = m_FrameUsage.fetch_add(alignedSize, std::memory_order_relaxed);
+    if (offset + alignedSize > m_FrameCapacity)
+    { return NoAllocation; }
+
+    return (uint64_t)m_CurrentFrame * m_FrameCapacity + offset;
+}
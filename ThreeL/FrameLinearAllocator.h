@@ -0,0 +1,47 @@
+#pragma once
+#include <atomic>
+#include <stdint.h>
+
+//! Bookkeeping for a buffer which is split into one equally sized region per frame in flight, each of which is allocated from linearly
+//! Every allocation is rounded up to Alignment (the D3D12 constant buffer placement alignment) so that allocations come out aligned without any extra
+//! work, which is what lets Allocate get away with a single atomic add. This type only deals in offsets so it has no dependency on D3D.
+//! Allocate is free-threaded, but must not race with BeginFrame.
+class FrameLinearAllocator
+{
+public:
+    static constexpr uint64_t Alignment = 256;
+    static constexpr uint64_t NoAllocation = UINT64_MAX;
+
+private:
+    uint64_t m_FrameCapacity;
+    uint32_t m_FrameCount;
+    uint32_t m_CurrentFrame = UINT32_MAX;
+
+    // Bytes allocated from the current frame's region, this may run past the capacity once an allocation has failed
+    std::atomic<uint64_t> m_FrameUsage = 0;
+    uint64_t m_PeakFrameUsage = 0;
+
+public:
+    //! The frame capacity must be a multiple of Alignment
+    FrameLinearAllocator(uint64_t frameCapacity, uint32_t frameCount);
+    FrameLinearAllocator(const FrameLinearAllocator&) = delete;
+
+    //! Moves on to the next frame's region and returns its index, the caller is responsible for making sure the GPU is done with it
+    uint32_t BeginFrame();
+
+    //! Returns the offset of the allocation from the start of the buffer, or NoAllocation if the current frame's region is full
+    uint64_t Allocate(uint64_t sizeBytes);
+
+    inline uint32_t CurrentFrame() const { return m_CurrentFrame; }
+    inline uint64_t FrameCapacity() const { return m_FrameCapacity; }
+    inline uint64_t BufferSize() const { return m_FrameCapacity * m_FrameCount; }
+
+    inline uint64_t FrameUsage() const
+    {
+        uint64_t usage = m_FrameUsage.load(std::memory_order_relaxed);
+        return usage < m_FrameCapacity ? usage : m_FrameCapacity;
+    }
+
+    //! The most bytes used by any frame which has ended, useful for sizing the frame capacity
+    inline uint64_t PeakFrameUsage() const { return m_PeakFrameUsage; }
+};
@@ -6,23 +6,20 @@
 #include "LightLinkedList.h"
 
 FrameStatistics::FrameStatistics(GraphicsCore& graphics)
-    : m_Graphics(graphics)
+    : m_Graphics(graphics), m_TimingHistory(std::vector<std::string>(std::begin(TimerNames), std::end(TimerNames)))
 {
     // Create buffer for collecting statistics from compute shaders
     {
-        ComPtr<ID3D12Resource> computeBuffer;
-        D3D12_HEAP_PROPERTIES heapProperties = { D3D12_HEAP_TYPE_DEFAULT };
         D3D12_RESOURCE_DESC resourceDescription = DescribeBufferResource(sizeof(StatisticsBuffer), D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
-        AssertSuccess(graphics.Device()->CreateCommittedResource
+        ComPtr<ID3D12Resource> computeBuffer = graphics.GpuMemoryManager().CreateResource
         (
-            &heapProperties,
+            GpuMemoryCategory::Statistics,
+            D3D12_HEAP_TYPE_DEFAULT,
             D3D12_HEAP_FLAG_CREATE_NOT_ZEROED,
-            &resourceDescription,
+            resourceDescription,
             D3D12_RESOURCE_STATE_COMMON,
-            nullptr,
-            IID_PPV_ARGS(&computeBuffer)
-        ));
-        computeBuffer->SetName(L"FrameStatistics Compute Buffer");
+            L"FrameStatistics Compute Buffer"
+        );
 
         D3D12_UNORDERED_ACCESS_VIEW_DESC uavDescription =
         {
@@ -41,18 +38,16 @@ FrameStatistics::FrameStatistics(GraphicsCore& graphics)
 
     // Create buffer for reading statistics from CPU
     {
-        D3D12_HEAP_PROPERTIES heapProperties = { D3D12_HEAP_TYPE_READBACK };
         D3D12_RESOURCE_DESC resourceDescription = DescribeBufferResource(sizeof(StatisticsBuffer) * BUFFER_COUNT, D3D12_RESOURCE_FLAG_NONE);
-        AssertSuccess(graphics.Device()->CreateCommittedResource
+        m_StatisticsReadbackBuffer = graphics.GpuMemoryManager().CreateResource
         (
-            &heapProperties,
-            D3D12_HEAP_FLAG_NONE, // We rely on this heap being zeroed by the runtime
-            &resourceDescription,
+            GpuMemoryCategory::Statistics,
+            D3D12_HEAP_TYPE_READBACK,
+            D3D12_HEAP_FLAG_NONE, // We rely on this heap being zeroed by the runtime (which also means it will be committed)
+            resourceDescription,
             D3D12_RESOURCE_STATE_COPY_DEST,
-            nullptr,
-            IID_PPV_ARGS(&m_StatisticsReadbackBuffer)
-        ));
-        m_StatisticsReadbackBuffer->SetName(L"FrameStatistics Readback Buffer");
+            L"FrameStatistics Readback Buffer"
+        );
     }
 
     // Create the query heap for collecting GPU timestamps
@@ -99,6 +94,9 @@ FrameStatistics::FrameStatistics(GraphicsCore& graphics)
     for (size_t i = 0; i < std::size(m_CpuTimestampsBuffer); i++)
     { m_CpuTimestampsBuffer[i] = 0 * now.QuadPart; }
 
+    for (uint64_t& frameNumber : m_BufferFrameNumbers)
+    { frameNumber = UINT64_MAX; }
+
     // Pretend to start a frame so that m_CurrentStatistics is mapped to something (all statistics will be 0)
     m_NextWriteBuffer = 0;
     m_CurrentReadBuffer = BUFFER_COUNT - 2;
@@ -128,6 +126,13 @@ void FrameStatistics::AdvanceReadBuffer()
     if (nextReadBuffer == m_CurrentReadBuffer)
     { return; }
 
+    // Every buffer up to the new read buffer has finished, so they all go into the timing history in the order they were written
+    for (uint32_t buffer = m_CurrentReadBuffer; buffer != nextReadBuffer;)
+    {
+        buffer = (buffer + 1) % BUFFER_COUNT;
+        RecordTimingHistory(buffer);
+    }
+
     // Unmap the old statistics buffer and map the new one
     if (m_CurrentStatistics != nullptr)
     {
@@ -142,13 +147,47 @@ void FrameStatistics::AdvanceReadBuffer()
         .Begin = sizeof(StatisticsBuffer) * m_CurrentReadBuffer,
         .End = sizeof(StatisticsBuffer) * (m_CurrentReadBuffer + 1),
     };
-    AssertSuccess(m_StatisticsReadbackBuffer->Map(0, &readRange, (void**)&m_CurrentStatistics));
+    // (Map returns the start of the buffer regardless of the range being read.)
+    uint8_t* mappedBuffer;
+    AssertSuccess(m_StatisticsReadbackBuffer->Map(0, &readRange, (void**)&mappedBuffer));
+    m_CurrentStatistics = (StatisticsBuffer*)(mappedBuffer + readRange.Begin);
 
     // Copy the CPU timestamps for the buffer we just read to the publicly-accessible buffer
     // (We can't just "map" a segment of m_CpuTimeStampsBuffer since it could get clobbered when the GPU is running behind but the CPU isn't.)
     memcpy(m_CurrentCpuTimestamps, m_CpuTimestampsBuffer + (TIMER_BLOCK_COUNT * m_CurrentReadBuffer), sizeof(m_CurrentCpuTimestamps));
 }
 
+void FrameStatistics::RecordTimingHistory(uint32_t buffer)
+{
+    if (m_BufferFrameNumbers[buffer] == UINT64_MAX)
+    { return; }
+
+    D3D12_RANGE readRange =
+    {
+        .Begin = sizeof(StatisticsBuffer) * buffer,
+        .End = sizeof(StatisticsBuffer) * (buffer + 1),
+    };
+    uint8_t* mappedBuffer;
+    AssertSuccess(m_StatisticsReadbackBuffer->Map(0, &readRange, (void**)&mappedBuffer));
+    StatisticsBuffer* statistics = (StatisticsBuffer*)(mappedBuffer + readRange.Begin);
+
+    float cpuMilliseconds[(int)Timer::COUNT];
+    float gpuMilliseconds[(int)Timer::COUNT];
+    for (uint32_t i = 0; i < (uint32_t)Timer::COUNT; i++)
+    {
+        // Skipped and invalid timers are both negative, which the history records as skipped
+        double elapsedCpu = GetElapsedTime(m_CpuTimestampsBuffer + (TIMER_BLOCK_COUNT * buffer), (Timer)i, m_CpuTimestampFrequency);
+        double elapsedGpu = GetElapsedTime(statistics->GpuTimestamps, (Timer)i, m_GpuTimestampFrequency);
+        cpuMilliseconds[i] = elapsedCpu < 0.0 ? TimingHistory::SKIPPED : (float)(elapsedCpu * 1000.0);
+        gpuMilliseconds[i] = elapsedGpu < 0.0 ? TimingHistory::SKIPPED : (float)(elapsedGpu * 1000.0);
+    }
+
+    D3D12_RANGE emptyRange = { };
+    m_StatisticsReadbackBuffer->Unmap(0, &emptyRange);
+
+    m_TimingHistory.Record(m_BufferFrameNumbers[buffer], cpuMilliseconds, gpuMilliseconds);
+}
+
 void FrameStatistics::StartFrame()
 {
     AdvanceReadBuffer();
@@ -200,6 +239,7 @@ void FrameStatistics::FinishCollectStatistics(GraphicsContext& context)
     );
 
     m_SyncPoints[m_NextWriteBuffer] = context.Flush();
+    m_BufferFrameNumbers[m_NextWriteBuffer] = m_CollectedFrameCount++;
 
     m_NextWriteBuffer = (m_NextWriteBuffer + 1) % BUFFER_COUNT;
 }
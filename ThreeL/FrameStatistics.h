@@ -5,6 +5,7 @@
 #include "GraphicsContext.h"
 #include "RawGpuResource.h"
 #include "SwapChain.h"
+#include "TimingHistory.h"
 
 class GraphicsCore;
 
@@ -13,10 +14,12 @@ enum class Timer
     FrameTotal,
     FrameSetup,
     ParticleUpdate,
+    SceneCulling,
     DepthPrePass,
     DownsampleDepth,
     FillLightLinkedList,
     OpaquePass,
+    TransparentPass,
     ParticleRender,
     DebugOverlay,
     UI,
@@ -24,6 +27,25 @@ enum class Timer
     COUNT,
 };
 
+//! Indexed by Timer
+static const char* TimerNames[] =
+{
+    "FrameTotal",
+    "FrameSetup",
+    "ParticleUpdate",
+    "SceneCulling",
+    "DepthPrePass",
+    "DownsampleDepth",
+    "FillLightLinkedList",
+    "OpaquePass",
+    "TransparentPass",
+    "ParticleRender",
+    "DebugOverlay",
+    "UI",
+    "Present",
+};
+static_assert(std::size(TimerNames) == (size_t)Timer::COUNT);
+
 class FrameStatistics
 {
 private:
@@ -62,11 +84,18 @@ private:
     uint32_t m_NextWriteBuffer;
     uint32_t m_CurrentReadBuffer;
 
+    // Every frame's timings are recorded in the history as its buffer becomes readable, even the ones AdvanceReadBuffer skips over
+    // UINT64_MAX marks buffers which have never been written
+    uint64_t m_BufferFrameNumbers[BUFFER_COUNT];
+    uint64_t m_CollectedFrameCount = 0;
+    TimingHistory m_TimingHistory;
+
 public:
     FrameStatistics(GraphicsCore& graphics);
 
 private:
     void AdvanceReadBuffer();
+    void RecordTimingHistory(uint32_t buffer);
 
 public:
     void StartFrame();
@@ -120,5 +149,8 @@ public:
     inline double GetElapsedTimeCpu(Timer timer) { return GetElapsedTime(m_CurrentCpuTimestamps, timer, m_CpuTimestampFrequency); }
     inline double GetElapsedTimeGpu(Timer timer) { return GetElapsedTime(m_CurrentStatistics->GpuTimestamps, timer, m_GpuTimestampFrequency); }
 
+    //! Per-frame timings of recent frames, indexed by Timer
+    inline const TimingHistory& History() const { return m_TimingHistory; }
+
     ~FrameStatistics();
 };
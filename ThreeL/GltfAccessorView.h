@@ -18,6 +18,11 @@ public:
         return (int)m_Accessor.count;
     }
 
+    inline const tinygltf::Accessor& Accessor() const
+    {
+        return m_Accessor;
+    }
+
     static GltfAccessorViewBase* Create(const tinygltf::Model& model, const tinygltf::Accessor& accessor);
 
     virtual ~GltfAccessorViewBase() = default;
@@ -3,8 +3,8 @@
 
 #include "GltfAccessorView.h"
 #include "GraphicsCore.h"
+#include "ResourceManager.h"
 #include "Scene.h"
-#include "Texture.h"
 
 static D3D12_TEXTURE_ADDRESS_MODE TranslateGltfAddressMode(int mode)
 {
@@ -101,14 +101,14 @@ SamplerId GltfLoadContext::LoadSampler(int samplerIndex)
     return m_Graphics.SamplerHeap().Create(description);
 }
 
-const Texture& GltfLoadContext::LoadTexture(int textureIndex, bool isSrgb)
+uint32_t GltfLoadContext::LoadTexture(int textureIndex, bool isSrgb, StreamedTexturePlaceholder placeholder)
 {
     const tinygltf::Texture& gltfTexture = m_Model.textures[textureIndex];
 
     // Spec allows this for textures backed by extensions, but we don't support it.
     Assert(gltfTexture.source >= 0 && "glTF texture is not backed by an image!");
 
-    // Return an existing texture if we've already uploaded this one
+    // Return an existing texture if we've already registered this one
     // Even though it's unlikely a texture will be shared between sRGB textures (IE: baseColorTexture/emissiveTexture)
     // and linear textures but we make it part of the cache key just inc ase
     const uint64_t kIsSrgbBit = 1ull << 32;
@@ -116,16 +116,15 @@ const Texture& GltfLoadContext::LoadTexture(int textureIndex, bool isSrgb)
     auto cached = m_Scene.m_TextureCache.find(cacheKey);
     if (cached != m_Scene.m_TextureCache.end())
     {
-        return *(cached->second);
+        return cached->second;
     }
 
     // Validate image attributes
     const tinygltf::Image& image = m_Model.images[gltfTexture.source];
     Assert(image.width > 0);
     Assert(image.height > 0);
-    Assert(image.component == 4 && "Loaded image is not 32bpp, TinyGLTF should not be configured to preserve source channels.");
-    Assert(image.bits == 8 || image.bits == 16);
-    Assert(image.pixel_type == TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE || image.pixel_type == TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT);
+    Assert(image.as_is && "Image was decoded by TinyGLTF, it should be configured to use LoadImageDataDeferred.");
+    Assert(image.image.size() > 0);
 
     // Make a debug name for the texture
     std::wstring name = std::format(L"{}", gltfTexture.name);
@@ -142,8 +141,11 @@ const Texture& GltfLoadContext::LoadTexture(int textureIndex, bool isSrgb)
     if (isSrgb)
     { name = std::format(L"{} (sRGB)", name); }
 
-    // Create, cache, and return the texture
-    return *(m_Scene.m_TextureCache[cacheKey] = std::make_unique<Texture>(m_Resources, name, std::span(image.image), uint2((uint32_t)image.width, (uint32_t)image.height), isSrgb));
+    // Register, cache, and return the texture
+    // (The model is discarded once the scene is loaded, so the streamer gets its own copy of the encoded image.)
+    std::vector<uint8_t> encodedData = image.image;
+    uint2 size((uint32_t)image.width, (uint32_t)image.height);
+    return m_Scene.m_TextureCache[cacheKey] = m_Resources.StreamedTextures.Register(std::move(encodedData), size, isSrgb, placeholder, name);
 }
 
 GltfAccessorViewBase* GltfLoadContext::GetAttributeRaw(const tinygltf::Primitive& primitive, const std::string& attributeName)
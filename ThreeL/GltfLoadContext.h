@@ -7,7 +7,7 @@
 class GraphicsCore;
 struct ResourceManager;
 class Scene;
-class Texture;
+enum class StreamedTexturePlaceholder;
 class GltfAccessorViewBase;
 template<typename T> class GltfAccessorView;
 
@@ -35,7 +35,8 @@ public:
         return LoadSampler(m_Model.textures[textureIndex].sampler);
     }
 
-    const Texture& LoadTexture(int textureIndex, bool isSrgb);
+    //! Registers the texture for streaming (if it wasn't already) and returns its bindless index
+    uint32_t LoadTexture(int textureIndex, bool isSrgb, StreamedTexturePlaceholder placeholder);
 
     GltfAccessorViewBase* GetAttributeRaw(const tinygltf::Primitive& primitive, const std::string& attributeName);
 
@@ -0,0 +1,81 @@
+#include "pch.h"
+#include "GpuFenceReactor.h"
+
+GpuFenceReactor::Fence::Fence(ID3D12Fence* fence)
+    : m_Fence(fence)
+{
+    m_Event = CreateEventW(nullptr, FALSE, FALSE, nullptr);
+    Assert(m_Event != nullptr);
+}
+
+uint64_t GpuFenceReactor::Fence::CompletedValue() const
+{
+    return m_Fence->GetCompletedValue();
+}
+
+GpuFenceReactor::Fence::~Fence()
+{
+    CloseHandle(m_Event);
+}
+
+GpuFenceReactor::Waiter::Waiter()
+{
+    m_WakeEvent = CreateEventW(nullptr, FALSE, FALSE, nullptr);
+    Assert(m_WakeEvent != nullptr);
+}
+
+void GpuFenceReactor::Waiter::WaitForAny(std::span<const ReactorFence* const> fences, std::span<const uint64_t> values)
+{
+    Assert(fences.size() == values.size());
+    Assert(fences.size() < MAXIMUM_WAIT_OBJECTS && "Too many fences to wait on at once.");
+
+    HANDLE events[MAXIMUM_WAIT_OBJECTS];
+    DWORD eventCount = 0;
+    events[eventCount++] = m_WakeEvent;
+
+    // Events from previous waits may still be registered with the fences, which only causes spurious wakes
+    for (size_t i = 0; i < fences.size(); i++)
+    {
+        const Fence& fence = static_cast<const Fence&>(*fences[i]);
+        AssertSuccess(fence.m_Fence->SetEventOnCompletion(values[i], fence.m_Event));
+        events[eventCount++] = fence.m_Event;
+    }
+
+    DWORD result = WaitForMultipleObjects(eventCount, events, FALSE, INFINITE);
+    Assert(result < WAIT_OBJECT_0 + eventCount);
+}
+
+void GpuFenceReactor::Waiter::Wake()
+{
+    SetEvent(m_WakeEvent);
+}
+
+GpuFenceReactor::Waiter::~Waiter()
+{
+    CloseHandle(m_WakeEvent);
+}
+
+GpuFenceReactor::GpuFenceReactor()
+    : m_Reactor(m_Waiter)
+{
+}
+
+void GpuFenceReactor::Then(ID3D12Fence* fence, uint64_t value, std::function<void()>&& callback)
+{
+    if (fence == nullptr)
+    {
+        m_Reactor.Post(std::move(callback));
+        return;
+    }
+
+    Fence* reactorFence;
+    {
+        std::lock_guard<std::mutex> lock(m_FencesLock);
+        std::unique_ptr<Fence>& entry = m_Fences[fence];
+        if (entry == nullptr)
+        { entry = std::make_unique<Fence>(fence); }
+        reactorFence = entry.get();
+    }
+
+    m_Reactor.Then(*reactorFence, value, std::move(callback));
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include "pch.h"
+#include "FenceReactor.h"
+
+#include <mutex>
+#include <unordered_map>
+
+//! FenceReactor driven by D3D12 fences, see GpuSyncPoint::Then
+class GpuFenceReactor
+{
+private:
+    class Fence : public ReactorFence
+    {
+        friend class GpuFenceReactor;
+    private:
+        ID3D12Fence* m_Fence;
+        HANDLE m_Event;
+
+    public:
+        Fence(ID3D12Fence* fence);
+        Fence(const Fence&) = delete;
+        uint64_t CompletedValue() const override;
+        ~Fence();
+    };
+
+    // Every fence gets its own event so that the reactor can wait on all of them (and the wake event) with a single WaitForMultipleObjects
+    class Waiter : public ReactorWaiter
+    {
+    private:
+        HANDLE m_WakeEvent;
+
+    public:
+        Waiter();
+        Waiter(const Waiter&) = delete;
+        void WaitForAny(std::span<const ReactorFence* const> fences, std::span<const uint64_t> values) override;
+        void Wake() override;
+        ~Waiter();
+    };
+
+    Waiter m_Waiter;
+
+    std::mutex m_FencesLock;
+    std::unordered_map<ID3D12Fence*, std::unique_ptr<Fence>> m_Fences;
+
+    // Declared last so that the reactor thread is stopped before the fences and waiter are destroyed
+    FenceReactor m_Reactor;
+
+public:
+    GpuFenceReactor();
+    GpuFenceReactor(const GpuFenceReactor&) = delete;
+
+    //! Runs callback on the reactor's thread once fence reaches value, or as soon as possible when fence is null
+    //! The fence must outlive the reactor.
+    void Then(ID3D12Fence* fence, uint64_t value, std::function<void()>&& callback);
+};
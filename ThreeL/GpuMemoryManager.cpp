@@ -0,0 +1,322 @@
+#include "pch.h"
+#include "GpuMemoryManager.h"
+
+#include "GraphicsCore.h"
+
+#include <algorithm>
+#include <atomic>
+
+namespace
+{
+    // Identifies the PlacedAllocation attached to a resource created by GpuMemoryManager
+    // {6E4B5B8C-3A61-4F1B-9C0E-2D7A8F5E91C4}
+    const GUID PlacedAllocationGuid = { 0x6e4b5b8c, 0x3a61, 0x4f1b, { 0x9c, 0x0e, 0x2d, 0x7a, 0x8f, 0x5e, 0x91, 0xc4 } };
+
+    uint32_t HeapTypeIndex(D3D12_HEAP_TYPE heapType)
+    {
+        switch (heapType)
+        {
+            case D3D12_HEAP_TYPE_DEFAULT: return 0;
+            case D3D12_HEAP_TYPE_UPLOAD: return 1;
+            case D3D12_HEAP_TYPE_READBACK: return 2;
+            default: return UINT32_MAX;
+        }
+    }
+
+    const D3D12_HEAP_TYPE HeapTypes[] = { D3D12_HEAP_TYPE_DEFAULT, D3D12_HEAP_TYPE_UPLOAD, D3D12_HEAP_TYPE_READBACK };
+}
+
+const char* GpuMemoryCategoryName(GpuMemoryCategory category)
+{
+    switch (category)
+    {
+        case GpuMemoryCategory::Geometry: return "Geometry";
+        case GpuMemoryCategory::Textures: return "Textures";
+        case GpuMemoryCategory::Buffers: return "Buffers";
+        case GpuMemoryCategory::LightLinkedList: return "LightLinkedList";
+        case GpuMemoryCategory::Particles: return "Particles";
+        case GpuMemoryCategory::Statistics: return "Statistics";
+        default: return "<Unknown>";
+    }
+}
+
+//! Attached to every resource created by GpuMemoryManager as private data, the runtime releases it when the resource is destroyed which returns the
+//! resource's memory to the manager
+class GpuMemoryManager::PlacedAllocation final : public IUnknown
+{
+private:
+    std::atomic<ULONG> m_ReferenceCount = 1;
+    GpuMemoryManager& m_Manager;
+    Heap* m_Heap; // Null for committed resources
+    uint32_t m_Block;
+    GpuMemoryCategory m_Category;
+    uint64_t m_SizeBytes;
+
+public:
+    PlacedAllocation(GpuMemoryManager& manager, Heap* heap, uint32_t block, GpuMemoryCategory category, uint64_t sizeBytes)
+        : m_Manager(manager), m_Heap(heap), m_Block(block), m_Category(category), m_SizeBytes(sizeBytes)
+    {
+    }
+
+    HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void** ppvObject) override
+    {
+        if (ppvObject == nullptr)
+        { return E_POINTER; }
+
+        if (riid != __uuidof(IUnknown))
+        {
+            *ppvObject = nullptr;
+            return E_NOINTERFACE;
+        }
+
+        AddRef();
+        *ppvObject = this;
+        return S_OK;
+    }
+
+    ULONG STDMETHODCALLTYPE AddRef() override
+    {
+        return ++m_ReferenceCount;
+    }
+
+    ULONG STDMETHODCALLTYPE Release() override
+    {
+        ULONG referenceCount = --m_ReferenceCount;
+        if (referenceCount == 0)
+        {
+            m_Manager.Free(m_Heap, m_Block, m_Category, m_SizeBytes);
+            delete this;
+        }
+
+        return referenceCount;
+    }
+};
+
+GpuMemoryManager::GpuMemoryManager(GraphicsCore& graphics)
+    : m_Graphics(graphics)
+{
+    for (GpuMemoryCategoryStatistics& category : m_Categories)
+    { category.Budget = UINT64_MAX; }
+}
+
+ComPtr<ID3D12Resource> GpuMemoryManager::CreateResource
+(
+    GpuMemoryCategory category,
+    D3D12_HEAP_TYPE heapType,
+    D3D12_HEAP_FLAGS heapFlags,
+    const D3D12_RESOURCE_DESC& description,
+    D3D12_RESOURCE_STATES initialState,
+    const std::wstring& debugName
+)
+{
+    Assert(category < GpuMemoryCategory::Count);
+    ID3D12Device* device = m_Graphics.Device();
+
+    // Figure out which heaps the resource is allowed to live in
+    // Textures try the small placement alignment first, the runtime reports a larger alignment when the texture isn't eligible for it
+    D3D12_RESOURCE_DESC placedDescription = description;
+    GpuMemoryHeapClass heapClass;
+    bool isPlaceable = (heapFlags & ~D3D12_HEAP_FLAG_CREATE_NOT_ZEROED) == 0 && (heapFlags & D3D12_HEAP_FLAG_CREATE_NOT_ZEROED) != 0;
+    isPlaceable &= HeapTypeIndex(heapType) != UINT32_MAX;
+
+    if (description.Dimension == D3D12_RESOURCE_DIMENSION_BUFFER)
+    {
+        heapClass = GpuMemoryHeapClass::Buffers;
+    }
+    else
+    {
+        heapClass = GpuMemoryHeapClass::Textures;
+        isPlaceable &= (description.Flags & (D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET | D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL)) == 0;
+        isPlaceable &= heapType == D3D12_HEAP_TYPE_DEFAULT;
+
+        if (description.SampleDesc.Count <= 1)
+        { placedDescription.Alignment = D3D12_SMALL_RESOURCE_PLACEMENT_ALIGNMENT; }
+    }
+
+    D3D12_RESOURCE_ALLOCATION_INFO allocationInfo = device->GetResourceAllocationInfo(0, 1, &placedDescription);
+    if (placedDescription.Alignment != 0 && allocationInfo.Alignment != placedDescription.Alignment)
+    {
+        placedDescription.Alignment = 0;
+        allocationInfo = device->GetResourceAllocationInfo(0, 1, &placedDescription);
+    }
+    Assert(allocationInfo.SizeInBytes != UINT64_MAX && "The resource description is invalid.");
+
+    isPlaceable &= allocationInfo.SizeInBytes <= HEAP_SIZE / 2;
+
+    Heap* heap = nullptr;
+    HeapSuballocation allocation = { .Offset = 0, .Block = HeapSuballocator::NoBlock };
+    {
+        std::lock_guard<std::mutex> lock(m_Lock);
+        GpuMemoryCategoryStatistics& statistics = m_Categories[(size_t)category];
+        if (statistics.UsedBytes + allocationInfo.SizeInBytes > statistics.Budget && !m_WarnedOverBudget[(size_t)category])
+        {
+            printf("Warning: GPU memory category '%s' exceeded its budget of %llu bytes.\n", GpuMemoryCategoryName(category), statistics.Budget);
+            m_WarnedOverBudget[(size_t)category] = true;
+        }
+
+        if (isPlaceable)
+        {
+            std::vector<std::unique_ptr<Heap>>& pool = m_Pools[HeapTypeIndex(heapType)][(size_t)heapClass];
+
+            // First fit between heaps, TLSF takes care of finding a good fit within each one
+            //PERF: With lots of heaps it'd be better to start with the fullest one, but we only expect a handful
+            for (std::unique_ptr<Heap>& candidate : pool)
+            {
+                if (candidate->Allocator.TryAllocate(allocationInfo.SizeInBytes, allocationInfo.Alignment, &allocation))
+                {
+                    heap = candidate.get();
+                    break;
+                }
+            }
+
+            if (heap == nullptr)
+            {
+                uint64_t granularity = heapClass == GpuMemoryHeapClass::Textures ? D3D12_SMALL_RESOURCE_PLACEMENT_ALIGNMENT : D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+                std::unique_ptr<Heap> newHeap = std::make_unique<Heap>(HEAP_SIZE, granularity);
+
+                D3D12_HEAP_DESC heapDescription =
+                {
+                    .SizeInBytes = HEAP_SIZE,
+                    .Properties = { heapType },
+                    .Alignment = D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT,
+                    .Flags = D3D12_HEAP_FLAG_CREATE_NOT_ZEROED | (heapClass == GpuMemoryHeapClass::Textures ? D3D12_HEAP_FLAG_ALLOW_ONLY_NON_RT_DS_TEXTURES : D3D12_HEAP_FLAG_ALLOW_ONLY_BUFFERS),
+                };
+                AssertSuccess(device->CreateHeap(&heapDescription, IID_PPV_ARGS(&newHeap->Resource)));
+                newHeap->Resource->SetName(std::format(L"GpuMemoryManager {} heap #{}", heapClass == GpuMemoryHeapClass::Textures ? L"texture" : L"buffer", pool.size()).c_str());
+
+                bool success = newHeap->Allocator.TryAllocate(allocationInfo.SizeInBytes, allocationInfo.Alignment, &allocation);
+                Assert(success && "Allocations no larger than half a heap must fit in an empty heap.");
+                heap = newHeap.get();
+                pool.push_back(std::move(newHeap));
+            }
+
+            statistics.PlacedResourceCount++;
+        }
+
+        statistics.UsedBytes += allocationInfo.SizeInBytes;
+        statistics.ResourceCount++;
+        m_LiveResourceCount++;
+    }
+
+    ComPtr<ID3D12Resource> resource;
+    if (heap != nullptr)
+    {
+        AssertSuccess(device->CreatePlacedResource(heap->Resource.Get(), allocation.Offset, &placedDescription, initialState, nullptr, IID_PPV_ARGS(&resource)));
+    }
+    else
+    {
+        D3D12_HEAP_PROPERTIES heapProperties = { heapType };
+        AssertSuccess(device->CreateCommittedResource(&heapProperties, heapFlags, &description, initialState, nullptr, IID_PPV_ARGS(&resource)));
+    }
+    resource->SetName(debugName.c_str());
+
+    // The resource holds the only reference to the allocation so that its memory is returned once the resource is destroyed
+    PlacedAllocation* placedAllocation = new PlacedAllocation(*this, heap, allocation.Block, category, allocationInfo.SizeInBytes);
+    AssertSuccess(resource->SetPrivateDataInterface(PlacedAllocationGuid, placedAllocation));
+    placedAllocation->Release();
+
+    return resource;
+}
+
+void GpuMemoryManager::Free(Heap* heap, uint32_t block, GpuMemoryCategory category, uint64_t sizeBytes)
+{
+    std::lock_guard<std::mutex> lock(m_Lock);
+    GpuMemoryCategoryStatistics& statistics = m_Categories[(size_t)category];
+    statistics.UsedBytes -= sizeBytes;
+    statistics.ResourceCount--;
+    m_LiveResourceCount--;
+
+    if (heap == nullptr)
+    { return; }
+
+    statistics.PlacedResourceCount--;
+    heap->Allocator.Free(block);
+
+    // Release empty heaps, but keep the last one in each pool around so that we don't thrash creating and destroying it
+    if (heap->Allocator.IsEmpty())
+    {
+        for (auto& poolsOfType : m_Pools)
+        {
+            for (std::vector<std::unique_ptr<Heap>>& pool : poolsOfType)
+            {
+                auto it = std::find_if(pool.begin(), pool.end(), [heap](const std::unique_ptr<Heap>& candidate) { return candidate.get() == heap; });
+                if (it != pool.end() && pool.size() > 1)
+                { pool.erase(it); }
+            }
+        }
+    }
+}
+
+void GpuMemoryManager::SetBudget(GpuMemoryCategory category, uint64_t budgetBytes)
+{
+    std::lock_guard<std::mutex> lock(m_Lock);
+    m_Categories[(size_t)category].Budget = budgetBytes;
+    m_WarnedOverBudget[(size_t)category] = false;
+}
+
+GpuMemoryCategoryStatistics GpuMemoryManager::CategoryStatistics(GpuMemoryCategory category)
+{
+    std::lock_guard<std::mutex> lock(m_Lock);
+    return m_Categories[(size_t)category];
+}
+
+uint64_t GpuMemoryManager::ReservedHeapBytes()
+{
+    std::lock_guard<std::mutex> lock(m_Lock);
+    uint64_t result = 0;
+    for (auto& poolsOfType : m_Pools)
+    {
+        for (std::vector<std::unique_ptr<Heap>>& pool : poolsOfType)
+        { result += pool.size() * HEAP_SIZE; }
+    }
+
+    return result;
+}
+
+std::vector<GpuMemoryDefragmentationHint> GpuMemoryManager::DefragmentationHints(float maximumOccupancy)
+{
+    std::lock_guard<std::mutex> lock(m_Lock);
+    std::vector<GpuMemoryDefragmentationHint> result;
+
+    for (uint32_t typeIndex = 0; typeIndex < HEAP_TYPE_COUNT; typeIndex++)
+    {
+        for (size_t heapClass = 0; heapClass < (size_t)GpuMemoryHeapClass::Count; heapClass++)
+        {
+            std::vector<std::unique_ptr<Heap>>& pool = m_Pools[typeIndex][heapClass];
+            if (pool.size() < 2)
+            { continue; }
+
+            uint64_t poolFreeBytes = 0;
+            for (std::unique_ptr<Heap>& heap : pool)
+            { poolFreeBytes += heap->Allocator.Capacity() - heap->Allocator.UsedBytes(); }
+
+            for (uint32_t i = 0; i < pool.size(); i++)
+            {
+                HeapSuballocatorStatistics statistics = pool[i]->Allocator.Statistics();
+                float occupancy = (float)statistics.UsedBytes / (float)statistics.Capacity;
+                uint64_t otherFreeBytes = poolFreeBytes - (statistics.Capacity - statistics.UsedBytes);
+
+                // Only worth mentioning if the rest of the pool could plausibly take this heap's resources
+                if (occupancy <= maximumOccupancy && otherFreeBytes >= statistics.UsedBytes)
+                {
+                    GpuMemoryDefragmentationHint hint =
+                    {
+                        .HeapType = HeapTypes[typeIndex],
+                        .HeapClass = (GpuMemoryHeapClass)heapClass,
+                        .HeapIndex = i,
+                        .Statistics = statistics,
+                    };
+                    result.push_back(hint);
+                }
+            }
+        }
+    }
+
+    return result;
+}
+
+GpuMemoryManager::~GpuMemoryManager()
+{
+    // Resources hold a pointer back to the manager (and their heap) until they're destroyed
+    Assert(m_LiveResourceCount == 0 && "All resources created by the memory manager must be destroyed before it is.");
+}
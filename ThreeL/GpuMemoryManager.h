@@ -0,0 +1,120 @@
+#pragma once
+#include "pch.h"
+#include "HeapSuballocator.h"
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class GraphicsCore;
+
+//! What a resource allocated by GpuMemoryManager is used for, each category is accounted for (and budgeted) separately
+enum class GpuMemoryCategory
+{
+    Geometry,
+    Textures,
+    Buffers,
+    LightLinkedList,
+    Particles,
+    Statistics,
+    Count
+};
+
+const char* GpuMemoryCategoryName(GpuMemoryCategory category);
+
+//! The kinds of resource which share a heap, these match the heap restrictions of resource heap tier 1
+enum class GpuMemoryHeapClass
+{
+    Buffers,
+    Textures,
+    Count
+};
+
+struct GpuMemoryCategoryStatistics
+{
+    uint64_t UsedBytes;
+    uint64_t Budget;
+    uint32_t ResourceCount;
+    uint32_t PlacedResourceCount;
+};
+
+//! A heap which is mostly empty, moving its resources elsewhere in the same pool would let it be released
+struct GpuMemoryDefragmentationHint
+{
+    D3D12_HEAP_TYPE HeapType;
+    GpuMemoryHeapClass HeapClass;
+    uint32_t HeapIndex;
+    HeapSuballocatorStatistics Statistics;
+};
+
+//! Creates resources as placed resources within large shared heaps rather than giving each its own implicit heap
+//! Heaps are reserved as needed for each combination of heap type and heap class and are suballocated with HeapSuballocator. Textures use the 4 KB
+//! small resource placement alignment whenever the runtime allows it. Placed resources free their memory when they're destroyed, so callers own them
+//! exactly like committed resources. Resources which can't (or shouldn't) be placed fall back to committed resources, see CreateResource.
+//! This type is free-threaded.
+class GpuMemoryManager
+{
+public:
+    static const uint64_t HEAP_SIZE = 64 * 1024 * 1024;
+
+private:
+    class PlacedAllocation;
+
+    struct Heap
+    {
+        ComPtr<ID3D12Heap> Resource;
+        HeapSuballocator Allocator;
+
+        Heap(uint64_t capacity, uint64_t granularity)
+            : Allocator(capacity, granularity)
+        {
+        }
+    };
+
+    static const uint32_t HEAP_TYPE_COUNT = 3; // Default, upload, and readback
+
+    GraphicsCore& m_Graphics;
+
+    // The following are protected by m_Lock
+    std::mutex m_Lock;
+    std::vector<std::unique_ptr<Heap>> m_Pools[HEAP_TYPE_COUNT][(size_t)GpuMemoryHeapClass::Count];
+    GpuMemoryCategoryStatistics m_Categories[(size_t)GpuMemoryCategory::Count] = { };
+    bool m_WarnedOverBudget[(size_t)GpuMemoryCategory::Count] = { };
+    uint32_t m_LiveResourceCount = 0;
+
+public:
+    GpuMemoryManager(GraphicsCore& graphics);
+    GpuMemoryManager(const GpuMemoryManager&) = delete;
+
+    //! Creates a resource, placing it in a shared heap when possible
+    //! Placed resources start out with whatever was in the heap before, so resources which rely on being zeroed (IE: heapFlags doesn't include
+    //! D3D12_HEAP_FLAG_CREATE_NOT_ZEROED) are committed instead. Render targets and depth stencils are committed too since placed ones must be cleared
+    //! or discarded before use, as are resources larger than half a heap since the granularity waste is insignificant for them.
+    ComPtr<ID3D12Resource> CreateResource
+    (
+        GpuMemoryCategory category,
+        D3D12_HEAP_TYPE heapType,
+        D3D12_HEAP_FLAGS heapFlags,
+        const D3D12_RESOURCE_DESC& description,
+        D3D12_RESOURCE_STATES initialState,
+        const std::wstring& debugName
+    );
+
+    //! Sets a soft budget for the category, a warning is printed the first time it's exceeded
+    void SetBudget(GpuMemoryCategory category, uint64_t budgetBytes);
+
+    GpuMemoryCategoryStatistics CategoryStatistics(GpuMemoryCategory category);
+
+    //! The total size of all heaps reserved for placed resources
+    uint64_t ReservedHeapBytes();
+
+    //! Lists heaps whose occupancy is at most maximumOccupancy when the rest of their pool has room for their resources
+    std::vector<GpuMemoryDefragmentationHint> DefragmentationHints(float maximumOccupancy = 0.25f);
+
+private:
+    void Free(Heap* heap, uint32_t block, GpuMemoryCategory category, uint64_t sizeBytes);
+
+public:
+    ~GpuMemoryManager();
+};
@@ -0,0 +1,319 @@
+#include "pch.h"
+#include "GpuRenderGraph.h"
+
+#include "CommandQueue.h"
+#include "ComputeContext.h"
+#include "GraphicsContext.h"
+#include "GraphicsCore.h"
+
+#include <algorithm>
+#include <memory>
+#include <pix3.h>
+
+namespace
+{
+    D3D12_RESOURCE_STATES AccessToState(RenderGraphAccess access, RenderGraphQueue queue)
+    {
+        switch (access)
+        {
+            case RenderGraphAccess::RenderTarget: return D3D12_RESOURCE_STATE_RENDER_TARGET;
+            case RenderGraphAccess::DepthWrite: return D3D12_RESOURCE_STATE_DEPTH_WRITE;
+            case RenderGraphAccess::DepthRead: return D3D12_RESOURCE_STATE_DEPTH_READ | D3D12_RESOURCE_STATE_ALL_SHADER_RESOURCE;
+            case RenderGraphAccess::ShaderRead: return queue == RenderGraphQueue::Graphics ? D3D12_RESOURCE_STATE_ALL_SHADER_RESOURCE : D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE;
+            case RenderGraphAccess::UnorderedAccess: return D3D12_RESOURCE_STATE_UNORDERED_ACCESS;
+            case RenderGraphAccess::CopySource: return D3D12_RESOURCE_STATE_COPY_SOURCE;
+            case RenderGraphAccess::CopyDest: return D3D12_RESOURCE_STATE_COPY_DEST;
+            default:
+                Assert(false && "Invalid render graph access.");
+                return D3D12_RESOURCE_STATE_COMMON;
+        }
+    }
+
+    D3D12_HEAP_FLAGS HeapClassFlags(GpuRenderGraphHeapClass heapClass)
+    {
+        switch (heapClass)
+        {
+            case GpuRenderGraphHeapClass::Buffers: return D3D12_HEAP_FLAG_ALLOW_ONLY_BUFFERS;
+            case GpuRenderGraphHeapClass::RenderTargetTextures: return D3D12_HEAP_FLAG_ALLOW_ONLY_RT_DS_TEXTURES;
+            case GpuRenderGraphHeapClass::Textures: return D3D12_HEAP_FLAG_ALLOW_ONLY_NON_RT_DS_TEXTURES;
+            default:
+                Assert(false && "Invalid heap class.");
+                return D3D12_HEAP_FLAG_NONE;
+        }
+    }
+
+    const wchar_t* HeapClassName(GpuRenderGraphHeapClass heapClass)
+    {
+        switch (heapClass)
+        {
+            case GpuRenderGraphHeapClass::Buffers: return L"buffer";
+            case GpuRenderGraphHeapClass::RenderTargetTextures: return L"render target";
+            case GpuRenderGraphHeapClass::Textures: return L"texture";
+            default: return L"unknown";
+        }
+    }
+
+    bool DescriptionsMatch(const D3D12_RESOURCE_DESC& a, const D3D12_RESOURCE_DESC& b)
+    {
+        return a.Dimension == b.Dimension
+            && a.Alignment == b.Alignment
+            && a.Width == b.Width
+            && a.Height == b.Height
+            && a.DepthOrArraySize == b.DepthOrArraySize
+            && a.MipLevels == b.MipLevels
+            && a.Format == b.Format
+            && a.SampleDesc.Count == b.SampleDesc.Count
+            && a.SampleDesc.Quality == b.SampleDesc.Quality
+            && a.Layout == b.Layout
+            && a.Flags == b.Flags;
+    }
+}
+
+GpuRenderGraph::GpuRenderGraph(GraphicsCore& graphics)
+    : m_Graphics(graphics)
+{
+}
+
+RenderGraphResourceId GpuRenderGraph::CreateTransient(std::string name, GpuResource& resource, const D3D12_RESOURCE_DESC& description, PlaceFunction place)
+{
+    GpuRenderGraphHeapClass heapClass = GpuRenderGraphHeapClass::Textures;
+    if (description.Dimension == D3D12_RESOURCE_DIMENSION_BUFFER)
+    { heapClass = GpuRenderGraphHeapClass::Buffers; }
+    else if ((description.Flags & (D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET | D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL)) != 0)
+    { heapClass = GpuRenderGraphHeapClass::RenderTargetTextures; }
+
+    D3D12_RESOURCE_ALLOCATION_INFO allocationInfo = m_Graphics.Device()->GetResourceAllocationInfo(0, 1, &description);
+    Assert(allocationInfo.Alignment <= D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT && "MSAA resources aren't supported by the render graph.");
+
+    Transient transient =
+    {
+        .Resource = &resource,
+        .Description = description,
+        .HeapClass = heapClass,
+        .Place = std::move(place),
+    };
+    m_Resources.push_back(std::move(transient));
+    return m_Graph.CreateTransient(std::move(name), allocationInfo.SizeInBytes, allocationInfo.Alignment, (uint32_t)heapClass);
+}
+
+RenderGraphPassId GpuRenderGraph::AddPass(std::string name, std::span<const RenderGraphResourceUse> uses, GraphicsPassFunction pass, bool hasSideEffects)
+{
+    m_Passes.push_back({ .Graphics = std::move(pass) });
+    return m_Graph.AddPass(std::move(name), RenderGraphQueue::Graphics, uses, hasSideEffects);
+}
+
+RenderGraphPassId GpuRenderGraph::AddAsyncComputePass(std::string name, std::span<const RenderGraphResourceUse> uses, ComputePassFunction pass, bool hasSideEffects)
+{
+    m_Passes.push_back({ .Compute = std::move(pass) });
+    return m_Graph.AddPass(std::move(name), RenderGraphQueue::AsyncCompute, uses, hasSideEffects);
+}
+
+void GpuRenderGraph::PlaceTransients(const RenderGraphCompilation& compilation)
+{
+    // Figure out which heaps need to be replaced
+    // Heaps are replaced when they're too small or when they're more than twice as big as they need to be
+    uint64_t newHeapSizes[(int)GpuRenderGraphHeapClass::Count] = { };
+    bool replaceHeap[(int)GpuRenderGraphHeapClass::Count] = { };
+    bool layoutChanged = false;
+    for (int i = 0; i < (int)GpuRenderGraphHeapClass::Count; i++)
+    {
+        uint64_t requiredSize = i < compilation.HeapSizes.size() ? compilation.HeapSizes[i] : 0;
+        newHeapSizes[i] = (requiredSize + D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT - 1) & ~(uint64_t)(D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT - 1);
+        replaceHeap[i] = newHeapSizes[i] > m_HeapSizes[i] || newHeapSizes[i] < m_HeapSizes[i] / 2;
+        layoutChanged |= replaceHeap[i];
+    }
+
+    // Figure out which transients need to be (re)placed
+    std::vector<RenderGraphResourceId> changedResources;
+    for (RenderGraphResourceId i = 0; i < m_Resources.size(); i++)
+    {
+        const Transient& transient = m_Resources[i];
+        if (transient.Resource == nullptr)
+        { continue; }
+
+        const RenderGraphResourcePlacement& placement = compilation.Resources[i];
+        auto previous = std::find_if(m_Placements.begin(), m_Placements.end(), [&](const Placement& p) { return p.Resource == transient.Resource; });
+
+        bool changed;
+        if (previous == m_Placements.end())
+        { changed = placement.IsPlaced; }
+        else if (!placement.IsPlaced)
+        { changed = previous->Heap != nullptr; }
+        else
+        {
+            changed = replaceHeap[(int)transient.HeapClass]
+                || previous->Heap != m_Heaps[(int)transient.HeapClass].Get()
+                || previous->HeapOffset != placement.Offset
+                || !DescriptionsMatch(previous->Description, transient.Description);
+        }
+
+        if (changed)
+        { changedResources.push_back(i); }
+    }
+
+    if (!layoutChanged && changedResources.empty())
+    { return; }
+
+    // Replacing resources while the GPU might still be using them (or the memory they alias) isn't safe
+    //PERF: The layout only changes when the screen is resized or the passes change so we just wait for the GPU rather than keeping track of retired resources
+    m_Graphics.WaitForGpuIdle();
+
+    for (int i = 0; i < (int)GpuRenderGraphHeapClass::Count; i++)
+    {
+        if (!replaceHeap[i])
+        { continue; }
+
+        m_Heaps[i] = nullptr;
+        m_HeapSizes[i] = newHeapSizes[i];
+        if (newHeapSizes[i] == 0)
+        { continue; }
+
+        GpuRenderGraphHeapClass heapClass = (GpuRenderGraphHeapClass)i;
+        D3D12_HEAP_DESC heapDescription =
+        {
+            .SizeInBytes = newHeapSizes[i],
+            .Properties = { D3D12_HEAP_TYPE_DEFAULT },
+            .Alignment = D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT,
+            .Flags = D3D12_HEAP_FLAG_CREATE_NOT_ZEROED | HeapClassFlags(heapClass),
+        };
+        AssertSuccess(m_Graphics.Device()->CreateHeap(&heapDescription, IID_PPV_ARGS(&m_Heaps[i])));
+        m_Heaps[i]->SetName(std::format(L"GpuRenderGraph {} heap", HeapClassName(heapClass)).c_str());
+    }
+
+    for (RenderGraphResourceId i : changedResources)
+    {
+        const Transient& transient = m_Resources[i];
+        const RenderGraphResourcePlacement& placement = compilation.Resources[i];
+        ID3D12Heap* heap = placement.IsPlaced ? m_Heaps[(int)transient.HeapClass].Get() : nullptr;
+        uint64_t heapOffset = placement.IsPlaced ? placement.Offset : 0;
+        transient.Place(heap, heapOffset);
+
+        Placement newPlacement =
+        {
+            .Resource = transient.Resource,
+            .Description = transient.Description,
+            .Heap = heap,
+            .HeapOffset = heapOffset,
+        };
+
+        auto previous = std::find_if(m_Placements.begin(), m_Placements.end(), [&](const Placement& p) { return p.Resource == transient.Resource; });
+        if (previous == m_Placements.end())
+        { m_Placements.push_back(newPlacement); }
+        else
+        { *previous = newPlacement; }
+    }
+}
+
+template<typename TContext>
+void GpuRenderGraph::RecordBarriers(TContext& context, RenderGraphQueue queue, std::span<const RenderGraphBarrier> barriers)
+{
+    if (barriers.empty())
+    { return; }
+
+    bool needsDiscard = false;
+    for (const RenderGraphBarrier& barrier : barriers)
+    {
+        GpuResource& resource = *m_Resources[barrier.Resource].Resource;
+        if (barrier.Before == RenderGraphAccess::None)
+        {
+            context.AliasingBarrier(resource);
+            context.TransitionResource(resource, AccessToState(barrier.After, queue));
+            needsDiscard = true;
+        }
+        else if (barrier.Before == RenderGraphAccess::UnorderedAccess && barrier.After == RenderGraphAccess::UnorderedAccess)
+        { context.UavBarrier(resource); }
+        else
+        { context.TransitionResource(resource, AccessToState(barrier.After, queue)); }
+    }
+
+    if (!needsDiscard)
+    { return; }
+
+    // Placed textures must be discarded (or cleared or fully copied over) after they're acquired, buffers don't need anything
+    for (const RenderGraphBarrier& barrier : barriers)
+    {
+        const Transient& transient = m_Resources[barrier.Resource];
+        if (barrier.Before != RenderGraphAccess::None || transient.Description.Dimension == D3D12_RESOURCE_DIMENSION_BUFFER || barrier.After == RenderGraphAccess::CopyDest)
+        { continue; }
+
+        context.Discard(*transient.Resource);
+    }
+}
+
+void GpuRenderGraph::Execute(GraphicsContext& context)
+{
+    RenderGraphCompilation compilation = m_Graph.Compile();
+    m_MemoryReport = compilation.Memory;
+    PlaceTransients(compilation);
+
+    GraphicsQueue& graphicsQueue = m_Graphics.GraphicsQueue();
+    ComputeQueue& computeQueue = m_Graphics.ComputeQueue();
+    std::unique_ptr<ComputeContext> computeContext;
+    std::vector<GpuSyncPoint> syncPoints(m_Graph.PassCount());
+
+    for (const RenderGraphCompiledPass& compiledPass : compilation.Passes)
+    {
+        const Pass& pass = m_Passes[compiledPass.Pass];
+        const std::string& name = m_Graph.PassName(compiledPass.Pass);
+
+        if (compiledPass.Queue == RenderGraphQueue::Graphics)
+        {
+            // Work recorded before the wait has to be submitted first, otherwise it'd wait too
+            if (!compiledPass.Waits.empty())
+            {
+                context.Flush();
+                for (RenderGraphPassId waitedPass : compiledPass.Waits)
+                { graphicsQueue.AwaitSyncPoint(syncPoints[waitedPass]); }
+            }
+
+            {
+                PIXScopedEvent(&context, 1, "%s", name.c_str());
+                RecordBarriers(context, compiledPass.Queue, compiledPass.Barriers);
+                pass.Graphics(context);
+                RecordBarriers(context, compiledPass.Queue, compiledPass.EndBarriers);
+            }
+
+            if (compiledPass.IsWaitedOn)
+            { syncPoints[compiledPass.Pass] = context.Flush(); }
+        }
+        else
+        {
+            if (computeContext == nullptr)
+            { computeContext = std::make_unique<ComputeContext>(computeQueue); }
+            else if (!compiledPass.Waits.empty())
+            { computeContext->Flush(); }
+
+            for (RenderGraphPassId waitedPass : compiledPass.Waits)
+            { computeQueue.AwaitSyncPoint(syncPoints[waitedPass]); }
+
+            {
+                PIXScopedEvent(computeContext.get(), 1, "%s", name.c_str());
+                RecordBarriers(*computeContext, compiledPass.Queue, compiledPass.Barriers);
+                pass.Compute(*computeContext);
+            }
+
+            if (compiledPass.IsWaitedOn)
+            { syncPoints[compiledPass.Pass] = computeContext->Flush(); }
+        }
+    }
+
+    // Async compute work which nothing waited on may still be using transients, so the graphics queue waits for it before anything else can reuse them
+    if (computeContext != nullptr)
+    {
+        GpuSyncPoint computeSyncPoint = computeContext->Finish();
+        context.Flush();
+        graphicsQueue.AwaitSyncPoint(computeSyncPoint);
+    }
+
+    m_Graph.Clear();
+    m_Resources.clear();
+    m_Passes.clear();
+}
+
+uint64_t GpuRenderGraph::ReservedHeapBytes() const
+{
+    uint64_t result = 0;
+    for (uint64_t heapSize : m_HeapSizes)
+    { result += heapSize; }
+    return result;
+}
@@ -0,0 +1,116 @@
+#pragma once
+#include "pch.h"
+#include "RenderGraph.h"
+
+#include <functional>
+#include <initializer_list>
+#include <span>
+#include <string>
+#include <vector>
+
+struct ComputeContext;
+class GpuResource;
+struct GraphicsContext;
+class GraphicsCore;
+
+//! The kinds of transient which share a heap, these match the heap restrictions of resource heap tier 1
+enum class GpuRenderGraphHeapClass
+{
+    Buffers,
+    RenderTargetTextures, //!< Render targets and depth stencils
+    Textures,
+    Count
+};
+
+//! Records a RenderGraph's passes and places its transients in heaps owned by the graph, see RenderGraph for the details of compilation
+//!
+//! The graph is rebuilt every frame by declaring resources and passes and then calling Execute, which records every pass before returning.
+//! Transients are owned by the caller, who provides a function which (re)creates each one as a placed resource. Resources are only recreated when their
+//! placement or description changes, which typically only happens when the screen is resized or the set of passes changes. The graph takes care of
+//! acquiring transients (aliasing barrier + discard) and transitioning them between passes, passes are still responsible for imported resources.
+//! Async compute passes are recorded on a separate command list and synchronized with fences, the graphics queue always waits for them before Execute returns.
+class GpuRenderGraph
+{
+public:
+    //! (Re)creates a transient as a placed resource at the specified offset within heap, or releases it when heap is null
+    using PlaceFunction = std::function<void(ID3D12Heap* heap, uint64_t heapOffset)>;
+    using GraphicsPassFunction = std::function<void(GraphicsContext& context)>;
+    using ComputePassFunction = std::function<void(ComputeContext& context)>;
+
+private:
+    struct Transient
+    {
+        GpuResource* Resource; // Null for imported resources
+        D3D12_RESOURCE_DESC Description;
+        GpuRenderGraphHeapClass HeapClass;
+        PlaceFunction Place;
+    };
+
+    struct Pass
+    {
+        GraphicsPassFunction Graphics;
+        ComputePassFunction Compute;
+    };
+
+    // Where each transient was placed by a previous frame, so resources are only recreated when something changes
+    struct Placement
+    {
+        GpuResource* Resource;
+        D3D12_RESOURCE_DESC Description;
+        ID3D12Heap* Heap;
+        uint64_t HeapOffset;
+    };
+
+    GraphicsCore& m_Graphics;
+    RenderGraph m_Graph;
+    std::vector<Transient> m_Resources; // Indexed by RenderGraphResourceId
+    std::vector<Pass> m_Passes; // Indexed by RenderGraphPassId
+
+    ComPtr<ID3D12Heap> m_Heaps[(int)GpuRenderGraphHeapClass::Count];
+    uint64_t m_HeapSizes[(int)GpuRenderGraphHeapClass::Count] = { };
+    std::vector<Placement> m_Placements;
+
+    RenderGraphMemoryReport m_MemoryReport = { };
+
+public:
+    GpuRenderGraph(GraphicsCore& graphics);
+    GpuRenderGraph(const GpuRenderGraph&) = delete;
+
+    //! Declares a transient, its memory is only valid from its first use to its last use within the graph unless it's extracted
+    //! The description must match the resource place creates.
+    RenderGraphResourceId CreateTransient(std::string name, GpuResource& resource, const D3D12_RESOURCE_DESC& description, PlaceFunction place);
+
+    //! Declares a resource owned outside of the graph, passes which write to it are never culled
+    inline RenderGraphResourceId Import(std::string name)
+    {
+        m_Resources.push_back({ });
+        return m_Graph.Import(std::move(name));
+    }
+
+    //! Allows a transient to be used after Execute returns, until Execute is next called
+    inline void Extract(RenderGraphResourceId resource) { m_Graph.Extract(resource); }
+
+    RenderGraphPassId AddPass(std::string name, std::span<const RenderGraphResourceUse> uses, GraphicsPassFunction pass, bool hasSideEffects = false);
+    RenderGraphPassId AddAsyncComputePass(std::string name, std::span<const RenderGraphResourceUse> uses, ComputePassFunction pass, bool hasSideEffects = false);
+
+    inline RenderGraphPassId AddPass(std::string name, std::initializer_list<RenderGraphResourceUse> uses, GraphicsPassFunction pass, bool hasSideEffects = false)
+    { return AddPass(std::move(name), std::span<const RenderGraphResourceUse>(uses.begin(), uses.size()), std::move(pass), hasSideEffects); }
+
+    inline RenderGraphPassId AddAsyncComputePass(std::string name, std::initializer_list<RenderGraphResourceUse> uses, ComputePassFunction pass, bool hasSideEffects = false)
+    { return AddAsyncComputePass(std::move(name), std::span<const RenderGraphResourceUse>(uses.begin(), uses.size()), std::move(pass), hasSideEffects); }
+
+    //! Compiles the graph and records every pass which survived culling, graphics passes are recorded on the specified context
+    //! The graph is cleared afterwards so that the next frame can declare its own.
+    void Execute(GraphicsContext& context);
+
+    //! The memory report of the most recent Execute
+    inline const RenderGraphMemoryReport& MemoryReport() const { return m_MemoryReport; }
+    //! The total size of the heaps currently owned by the graph
+    uint64_t ReservedHeapBytes() const;
+
+private:
+    void PlaceTransients(const RenderGraphCompilation& compilation);
+
+    template<typename TContext>
+    void RecordBarriers(TContext& context, RenderGraphQueue queue, std::span<const RenderGraphBarrier> barriers);
+};
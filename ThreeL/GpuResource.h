@@ -1,5 +1,6 @@
 #pragma once
 #include "pch.h"
+#include "ResourceStateTracker.h"
 
 class CommandContext;
 
@@ -11,7 +12,7 @@ class GpuResource
 
 protected:
     ComPtr<ID3D12Resource> m_Resource;
-    D3D12_RESOURCE_STATES m_CurrentState = D3D12_RESOURCE_STATE_COMMON;
+    ResourceState m_State;
 
     GpuResource() = default;
 
@@ -1,6 +1,8 @@
 #include "pch.h"
 #include "GpuSyncPoint.h"
 
+#include "GpuFenceReactor.h"
+
 void GpuSyncPoint::AssertReachedCold(ID3D12Fence* fence) const
 {
     if (fence->GetCompletedValue() >= m_FenceValue)
@@ -12,3 +14,17 @@ void GpuSyncPoint::AssertReachedCold(ID3D12Fence* fence) const
         Assert(false && "The synchronization point has not been reached on the GPU.");
     }
 }
+
+void GpuSyncPoint::Then(GpuFenceReactor& reactor, std::function<void()>&& callback) const
+{
+    reactor.Then(m_Fence, m_FenceValue, std::move(callback));
+}
+
+std::future<void> GpuSyncPoint::AsFuture(GpuFenceReactor& reactor) const
+{
+    // std::function must be copyable, so the promise is shared rather than moved into the callback
+    std::shared_ptr<std::promise<void>> promise = std::make_shared<std::promise<void>>();
+    std::future<void> result = promise->get_future();
+    Then(reactor, [promise]() { promise->set_value(); });
+    return result;
+}
@@ -1,11 +1,16 @@
 #pragma once
 #include "pch.h"
 
+#include <future>
+
+class GpuFenceReactor;
+
 //! Represents a GPU fence synchronization point.
 //! This struct is free-threaded.
 struct GpuSyncPoint
 {
     friend class CommandQueue;
+    friend class UploadQueue;
 
 private:
     mutable ID3D12Fence* m_Fence;
@@ -84,6 +89,13 @@ public:
         }
     }
 
+    //! Runs callback on the reactor's thread once the sync point is reached
+    //! Callbacks must not block on the GPU, use them to release or recycle resources and to hand results to other threads.
+    void Then(GpuFenceReactor& reactor, std::function<void()>&& callback) const;
+
+    //! Returns a future which becomes ready once the sync point is reached, for threads which would rather wait on a future than on the GPU
+    std::future<void> AsFuture(GpuFenceReactor& reactor) const;
+
     //! Returns a GPU sync point which has already been reached.
     inline static GpuSyncPoint CreateAlreadyReached()
     {
@@ -0,0 +1,336 @@
+#include "pch.h"
+#include "GpuTextureStreamer.h"
+
+#include "GraphicsCore.h"
+#include "PbrMaterialHeap.h"
+
+#include <stb_image.h>
+
+namespace
+{
+    const DXGI_FORMAT PLACEHOLDER_FORMAT = DXGI_FORMAT_R8G8B8A8_UNORM;
+
+    bool DecodeImage(std::span<const uint8_t> encodedData, std::vector<uint8_t>* outRgbaData, uint2* outSize)
+    {
+        int width;
+        int height;
+        int channels;
+        uint8_t* data = stbi_load_from_memory(encodedData.data(), (int)encodedData.size(), &width, &height, &channels, 4);
+        if (data == nullptr)
+        { return false; }
+
+        outRgbaData->assign(data, data + (size_t)width * height * 4);
+        stbi_image_free(data);
+        *outSize = uint2((uint32_t)width, (uint32_t)height);
+        return true;
+    }
+
+    D3D12_SHADER_RESOURCE_VIEW_DESC DescribeTextureView(DXGI_FORMAT format, uint32_t mostDetailedMip, uint32_t mipLevels)
+    {
+        return {
+            .Format = format,
+            .ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D,
+            .Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING,
+            .Texture2D =
+            {
+                .MostDetailedMip = mostDetailedMip,
+                .MipLevels = mipLevels,
+                .PlaneSlice = 0,
+                .ResourceMinLODClamp = 0.f,
+            },
+        };
+    }
+}
+
+GpuTextureStreamer::GpuTextureStreamer(GraphicsCore& graphics)
+    : m_Graphics(graphics), m_Streamer(*this, DecodeImage)
+{
+    // Create the placeholders
+    const uint8_t placeholderColors[(int)StreamedTexturePlaceholder::Count][4] =
+    {
+        { 255, 255, 255, 255 }, // White
+        { 0, 0, 0, 255 }, // Black
+        { 128, 128, 255, 255 }, // FlatNormal
+    };
+
+    D3D12_RESOURCE_DESC placeholderDescription =
+    {
+        .Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D,
+        .Alignment = 0,
+        .Width = 1,
+        .Height = 1,
+        .DepthOrArraySize = 1,
+        .MipLevels = 1,
+        .Format = PLACEHOLDER_FORMAT,
+        .SampleDesc = { .Count = 1 },
+        .Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN,
+        .Flags = D3D12_RESOURCE_FLAG_NONE,
+    };
+
+    // We don't wait on these uploads, they'll be finished by the time the upload queue is flushed at the end of initialization
+    for (int i = 0; i < (int)StreamedTexturePlaceholder::Count; i++)
+    {
+        PendingUpload pendingUpload = m_Graphics.UploadQueue().AllocateResource(placeholderDescription, std::format(L"Streamed Texture Placeholder #{}", i));
+        SpanCopy(pendingUpload.GetRow(0), std::span<const uint8_t>(placeholderColors[i]));
+        m_Placeholders[i] = pendingUpload.InitiateUpload().Resource;
+    }
+
+    m_Streamer.SetBudget(DEFAULT_MEMORY_BUDGET);
+}
+
+uint32_t GpuTextureStreamer::Register(std::vector<uint8_t>&& encodedData, uint2 size, bool isSrgb, StreamedTexturePlaceholder placeholder, const std::wstring& debugName)
+{
+    Assert(placeholder < StreamedTexturePlaceholder::Count);
+
+    // The resource isn't allocated until the streamer knows how many mips fit in the budget, see AllocateMips
+    uint32_t mipCount = TextureBudget::MipCount(size);
+    GpuStreamedTexture texture =
+    {
+        .Size = size,
+        .MipCount = mipCount,
+        .Format = isSrgb ? DXGI_FORMAT_R8G8B8A8_UNORM_SRGB : DXGI_FORMAT_R8G8B8A8_UNORM,
+        .Placeholder = placeholder,
+        .ResourceBaseMip = mipCount,
+        .ViewBaseMip = mipCount,
+        .MostDetailedResidentMip = mipCount,
+        .Descriptor = m_Graphics.ResourceDescriptorManager().AllocateDynamicDescriptor(),
+        .DebugName = debugName,
+    };
+
+    texture.Descriptor.UpdateShaderResourceView(m_Placeholders[(int)placeholder].Get(), DescribeTextureView(PLACEHOLDER_FORMAT, 0, 1));
+    uint32_t bindlessIndex = m_Graphics.ResourceDescriptorManager().GetResidentIndex(texture.Descriptor);
+
+    // Mips are only handed to us from Update, so the texture doesn't need to be in the list before the streamer knows about it
+    StreamedTextureId id = m_Streamer.Register(std::move(encodedData), size, isSrgb);
+    Assert(id == m_Textures.size());
+    m_Textures.push_back(std::move(texture));
+    m_TexturesByBindlessIndex[bindlessIndex] = id;
+    return bindlessIndex;
+}
+
+void GpuTextureStreamer::ReportUsage(uint32_t bindlessIndex, float coverage)
+{
+    auto texture = m_TexturesByBindlessIndex.find(bindlessIndex);
+    if (texture != m_TexturesByBindlessIndex.end())
+    { m_Streamer.ReportUsage(texture->second, coverage); }
+}
+
+void GpuTextureStreamer::Update(PbrMaterialHeap& materials)
+{
+    // The frame which was being recorded during the last update has been submitted since, so its descriptors can be freed once the GPU is done with it
+    // (Material parameters are only ever read from the graphics queue.)
+    if (!m_ReplacedDescriptors.empty())
+    {
+        GpuSyncPoint syncPoint = m_Graphics.GraphicsQueue().QueueSyncPoint();
+        for (const ResourceDescriptor& descriptor : m_ReplacedDescriptors)
+        { m_Graphics.ResourceDescriptorManager().FreeResidentDescriptor(descriptor, syncPoint); }
+        m_ReplacedDescriptors.clear();
+    }
+
+    // Mark the mips of finished uploads as resident
+    while (!m_InFlightUploads.empty() && m_InFlightUploads.front().SyncPoint.WasReached())
+    {
+        for (const InFlightMip& mip : m_InFlightUploads.front().Mips)
+        { m_Streamer.MipUploaded(mip.Texture, mip.MipLevel); }
+        m_InFlightUploads.pop_front();
+    }
+
+    m_Streamer.Update(UPLOAD_BYTE_BUDGET);
+
+    // Point the descriptors of textures with newly resident (or evicted) mips at them
+    for (const TextureResidencyChange& change : m_Streamer.TakeResidencyChanges())
+    {
+        m_Textures[change.Texture].MostDetailedResidentMip = change.MostDetailedMip;
+        RefreshView(change.Texture, materials);
+    }
+
+    // Switch textures over to their new allocations once their mips have been copied into them
+    std::erase_if(m_PendingViewSwitches, [&](StreamedTextureId id)
+        {
+            GpuStreamedTexture& texture = m_Textures[id];
+            if (texture.ViewResource != texture.Resource)
+            { RefreshView(id, materials); }
+            return texture.ViewResource == texture.Resource;
+        });
+
+    // Release allocations which the GPU is done with
+    while (!m_RetiredResources.empty())
+    {
+        const RetiredResource& retired = m_RetiredResources.front();
+        if (!retired.GraphicsSyncPoint.WasReached() || !retired.ComputeSyncPoint.WasReached() || !retired.UploadSyncPoint.WasReached())
+        { break; }
+
+        m_RetiredResources.pop_front();
+    }
+}
+
+void GpuTextureStreamer::RefreshView(StreamedTextureId id, PbrMaterialHeap& materials)
+{
+    GpuStreamedTexture& texture = m_Textures[id];
+
+    // Uploads and copies share the upload queue, so by the time any mip uploaded to a new allocation is resident its copy has completed too
+    if (texture.Resource != texture.ViewResource && texture.CopySyncPoint.WasReached())
+    {
+        if (texture.ViewResource != nullptr)
+        { Retire(std::move(texture.ViewResource)); }
+
+        texture.ViewResource = texture.Resource;
+        texture.ViewBaseMip = texture.ResourceBaseMip;
+    }
+
+    // Frames which are still in flight might be reading the current descriptor, so the view is written to a new one rather than being updated in place
+    ResourceDescriptorManager& descriptorManager = m_Graphics.ResourceDescriptorManager();
+    DynamicResourceDescriptor descriptor = descriptorManager.AllocateDynamicDescriptor();
+    if (texture.ViewResource == nullptr || texture.MostDetailedResidentMip == texture.MipCount)
+    {
+        descriptor.UpdateShaderResourceView(m_Placeholders[(int)texture.Placeholder].Get(), DescribeTextureView(PLACEHOLDER_FORMAT, 0, 1));
+    }
+    else
+    {
+        Assert(texture.MostDetailedResidentMip >= texture.ViewBaseMip && "Resident mips must be in the viewed allocation.");
+        uint32_t mostDetailedMip = texture.MostDetailedResidentMip - texture.ViewBaseMip;
+        descriptor.UpdateShaderResourceView(texture.ViewResource.Get(), DescribeTextureView(texture.Format, mostDetailedMip, texture.MipCount - texture.MostDetailedResidentMip));
+    }
+
+    // Publish the new index
+    uint32_t oldBindlessIndex = descriptorManager.GetResidentIndex(texture.Descriptor);
+    uint32_t newBindlessIndex = descriptorManager.GetResidentIndex(descriptor);
+    materials.ReplaceTexture(oldBindlessIndex, newBindlessIndex);
+    m_TexturesByBindlessIndex.erase(oldBindlessIndex);
+    m_TexturesByBindlessIndex[newBindlessIndex] = id;
+
+    m_ReplacedDescriptors.push_back(texture.Descriptor.ResourceDescriptor());
+    texture.Descriptor = descriptor;
+}
+
+void GpuTextureStreamer::Retire(ComPtr<ID3D12Resource>&& resource)
+{
+    // Frames which have already been submitted might still be sampling the resource, and copies out of it might still be pending
+    RetiredResource retired =
+    {
+        .Resource = std::move(resource),
+        .GraphicsSyncPoint = m_Graphics.GraphicsQueue().QueueSyncPoint(),
+        .ComputeSyncPoint = m_Graphics.ComputeQueue().QueueSyncPoint(),
+        .UploadSyncPoint = m_Graphics.UploadQueue().QueueSyncPoint(),
+    };
+    m_RetiredResources.push_back(std::move(retired));
+}
+
+void GpuTextureStreamer::AllocateMips(StreamedTextureId id, uint32_t mostDetailedMip, uint32_t preserveFromMip)
+{
+    GpuStreamedTexture& texture = m_Textures[id];
+    Assert(mostDetailedMip < texture.MipCount);
+    Assert(preserveFromMip >= mostDetailedMip && preserveFromMip <= texture.MipCount);
+
+    // Uploads to the old allocation which haven't been initiated yet need to be submitted before the copy out of it
+    if (!m_PendingUploads.empty())
+    { FlushUploads(); }
+
+    // Mips which aren't resident yet are never visible to shaders so the texture doesn't need to be zeroed
+    uint2 size = TextureBudget::MipSize(texture.Size, mostDetailedMip);
+    D3D12_RESOURCE_DESC textureDescription =
+    {
+        .Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D,
+        .Alignment = 0,
+        .Width = (UINT64)size.x,
+        .Height = (UINT)size.y,
+        .DepthOrArraySize = 1,
+        .MipLevels = (UINT16)(texture.MipCount - mostDetailedMip),
+        .Format = texture.Format,
+        .SampleDesc = { .Count = 1 },
+        .Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN,
+        .Flags = D3D12_RESOURCE_FLAG_NONE,
+    };
+
+    // Since we're going to first access this resource from a copy queue, it needs to start in the common state rather than copy destintation
+    ComPtr<ID3D12Resource> resource = m_Graphics.GpuMemoryManager().CreateResource
+    (
+        GpuMemoryCategory::Textures,
+        D3D12_HEAP_TYPE_DEFAULT,
+        D3D12_HEAP_FLAG_CREATE_NOT_ZEROED,
+        textureDescription,
+        D3D12_RESOURCE_STATE_COMMON,
+        texture.DebugName
+    );
+
+    // Carry over the mips which were already uploaded (or are being uploaded) to the old allocation
+    // The old allocation might be being sampled by the graphics queue at the same time, which is fine since both queues only read it.
+    GpuSyncPoint copySyncPoint = GpuSyncPoint::CreateAlreadyReached();
+    if (texture.Resource != nullptr && preserveFromMip < texture.MipCount)
+    {
+        Assert(preserveFromMip >= texture.ResourceBaseMip);
+        copySyncPoint = m_Graphics.UploadQueue().CopyTextureMips
+        (
+            resource.Get(), preserveFromMip - mostDetailedMip,
+            texture.Resource.Get(), preserveFromMip - texture.ResourceBaseMip,
+            texture.MipCount - preserveFromMip
+        );
+    }
+
+    // The viewed allocation is retired once the view switches away from it, allocations which were never viewed can be retired immediately
+    if (texture.Resource != nullptr && texture.Resource != texture.ViewResource)
+    { Retire(std::move(texture.Resource)); }
+
+    if (texture.ViewResource == texture.Resource)
+    { m_PendingViewSwitches.push_back(id); }
+
+    texture.Resource = std::move(resource);
+    texture.ResourceBaseMip = mostDetailedMip;
+    texture.CopySyncPoint = copySyncPoint;
+}
+
+void GpuTextureStreamer::UploadMip(StreamedTextureId id, uint32_t mipLevel, uint2 size, std::span<const uint8_t> rgbaData)
+{
+    GpuStreamedTexture& texture = m_Textures[id];
+    Assert(mipLevel >= texture.ResourceBaseMip && "Mips must be allocated before they're uploaded.");
+    PendingUpload pendingUpload = m_Graphics.UploadQueue().AllocateSubresourceUpload(texture.Resource, mipLevel - texture.ResourceBaseMip, texture.DebugName);
+
+    Assert(pendingUpload.RowCount() == size.y);
+    uint32_t sourceRowPitch = size.x * 4;
+    for (uint32_t y = 0; y < size.y; y++)
+    {
+        std::span<const uint8_t> sourceSpan = rgbaData.subspan(y * sourceRowPitch, sourceRowPitch);
+        std::span<uint8_t> destinationSpan = pendingUpload.GetRow(y);
+        Assert(sourceSpan.size() == destinationSpan.size());
+        SpanCopy(destinationSpan, sourceSpan);
+    }
+
+    m_PendingUploads.push_back(std::move(pendingUpload));
+    InFlightMip mip = { .Texture = id, .MipLevel = mipLevel };
+    m_PendingMips.push_back(mip);
+}
+
+void GpuTextureStreamer::FlushUploads()
+{
+    // Updates which only resized textures have nothing to upload
+    if (m_PendingUploads.empty())
+    { return; }
+
+    std::vector<PendingUpload*> jobs;
+    jobs.reserve(m_PendingUploads.size());
+    for (PendingUpload& pendingUpload : m_PendingUploads)
+    { jobs.push_back(&pendingUpload); }
+
+    // We hang on to the texture resources ourselves, so the initiated uploads can be discarded once we have the sync point
+    std::vector<InitiatedUpload> uploads = m_Graphics.UploadQueue().InitiateUploads(jobs);
+    InFlightUploads inFlight =
+    {
+        .SyncPoint = uploads[0].SyncPoint,
+        .Mips = std::move(m_PendingMips),
+    };
+    m_InFlightUploads.push_back(std::move(inFlight));
+
+    m_PendingUploads.clear();
+    m_PendingMips.clear();
+}
+
+GpuTextureStreamer::~GpuTextureStreamer()
+{
+    // Uploads are always initiated before Update returns, so all we have to do is make sure none of them are still writing to our textures
+    Assert(m_PendingUploads.empty());
+    for (const InFlightUploads& inFlight : m_InFlightUploads)
+    { inFlight.SyncPoint.Wait(); }
+
+    // Copies between allocations happen on the upload queue too
+    m_Graphics.UploadQueue().QueueSyncPoint().Wait();
+}
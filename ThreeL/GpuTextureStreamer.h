@@ -0,0 +1,139 @@
+#pragma once
+#include "pch.h"
+#include "DynamicResourceDescriptor.h"
+#include "GpuSyncPoint.h"
+#include "TextureStreamer.h"
+#include "UploadQueue.h"
+
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class GraphicsCore;
+class PbrMaterialHeap;
+
+//! What a streamed texture looks like until its first mips arrive
+//! These are chosen so that an unloaded texture behaves like glTF's default for the slot it's used in.
+enum class StreamedTexturePlaceholder
+{
+    White, //!< Base color and metallic/roughness textures
+    Black, //!< Emissive textures
+    FlatNormal, //!< Normal maps
+    Count,
+};
+
+//! Streams 32bpp textures to the GPU using a TextureStreamer, see its documentation for the details of scheduling and budgeting
+//! Each streamed texture's bindless index initially refers to a 1x1 placeholder. Descriptors are never rewritten while the GPU might be reading them, instead
+//! every time the view changes (as mips arrive or are evicted) it's written to a freshly allocated descriptor whose index is published to the material heap.
+//! The old descriptor is freed once the frames which might still be referencing it are done.
+//!
+//! Textures are only allocated with the mips the budget allows. When a texture grows or shrinks a new resource is allocated and the mips it shares with the
+//! old one are copied over on the upload queue. The view keeps referring to the old resource until the copy completes, after which the old resource is
+//! released once the GPU is done with it. This means a texture is briefly allocated twice while it's being resized.
+class GpuTextureStreamer : private TextureUploadSink
+{
+private:
+    struct GpuStreamedTexture
+    {
+        uint2 Size;
+        uint32_t MipCount;
+        DXGI_FORMAT Format;
+        StreamedTexturePlaceholder Placeholder;
+
+        // The most recent allocation, which holds mips [ResourceBaseMip, MipCount)
+        ComPtr<ID3D12Resource> Resource;
+        uint32_t ResourceBaseMip;
+        GpuSyncPoint CopySyncPoint;
+
+        // The resource the descriptor refers to, which lags behind Resource until the mips have been copied into it
+        ComPtr<ID3D12Resource> ViewResource;
+        uint32_t ViewBaseMip;
+        uint32_t MostDetailedResidentMip;
+
+        DynamicResourceDescriptor Descriptor;
+        std::wstring DebugName;
+    };
+
+    struct InFlightMip
+    {
+        StreamedTextureId Texture;
+        uint32_t MipLevel;
+    };
+
+    struct InFlightUploads
+    {
+        GpuSyncPoint SyncPoint;
+        std::vector<InFlightMip> Mips;
+    };
+
+    struct RetiredResource
+    {
+        ComPtr<ID3D12Resource> Resource;
+        GpuSyncPoint GraphicsSyncPoint;
+        GpuSyncPoint ComputeSyncPoint;
+        GpuSyncPoint UploadSyncPoint;
+    };
+
+    GraphicsCore& m_Graphics;
+    ComPtr<ID3D12Resource> m_Placeholders[(int)StreamedTexturePlaceholder::Count];
+
+    std::vector<GpuStreamedTexture> m_Textures;
+    std::unordered_map<uint32_t, StreamedTextureId> m_TexturesByBindlessIndex;
+
+    // Descriptors replaced during the last update, anything recorded earlier in that frame might still reference them
+    std::vector<ResourceDescriptor> m_ReplacedDescriptors;
+
+    // Uploads are batched into a single command list per update, and their completion is polled by the next update
+    std::vector<PendingUpload> m_PendingUploads;
+    std::vector<InFlightMip> m_PendingMips;
+    std::deque<InFlightUploads> m_InFlightUploads;
+
+    // Textures whose view still refers to a previous allocation
+    std::vector<StreamedTextureId> m_PendingViewSwitches;
+    std::deque<RetiredResource> m_RetiredResources;
+
+    // Declared last so that the workers are stopped before anything they could be waiting on is destroyed
+    TextureStreamer m_Streamer;
+
+public:
+    //! Maximum number of bytes of detail mips uploaded per update, tail mips don't count against this
+    static constexpr uint64_t UPLOAD_BYTE_BUDGET = 8 * 1024 * 1024;
+    static constexpr uint64_t DEFAULT_MEMORY_BUDGET = 512 * 1024 * 1024;
+
+    GpuTextureStreamer(GraphicsCore& graphics);
+    GpuTextureStreamer(const GpuTextureStreamer&) = delete;
+
+    //! Registers an encoded image (IE: a PNG or JPEG) for streaming and returns its initial bindless index, which is valid immediately
+    //! The index changes as the texture streams in, materials using it are kept up to date by Update.
+    uint32_t Register(std::vector<uint8_t>&& encodedData, uint2 size, bool isSrgb, StreamedTexturePlaceholder placeholder, const std::wstring& debugName);
+
+    //! Reports that the texture with the specified bindless index was used to draw something covering the specified fraction of the screen this frame
+    //! Indices which don't belong to a streamed texture are ignored.
+    void ReportUsage(uint32_t bindlessIndex, float coverage);
+
+    //! Uploads the next batch of mips and creates descriptors for textures with newly resident mips, should be called once per frame
+    //! The new bindless indices are published to the material heap, which must be updated before anything drawn afterwards this frame reads it.
+    void Update(PbrMaterialHeap& materials);
+
+    inline TextureStreamerStatistics Statistics() { return m_Streamer.Statistics(); }
+
+    //! Sets the budget for streamed texture memory, see TextureBudget
+    inline void SetBudget(uint64_t budgetBytes) { m_Streamer.SetBudget(budgetBytes); }
+
+    //! Records which textures are used each frame for evaluating budgets offline, see SimulateTextureBudget
+    inline void StartRecordingUsage() { m_Streamer.StartRecordingUsage(); }
+    inline TextureUsageTrace StopRecordingUsage() { return m_Streamer.StopRecordingUsage(); }
+    inline bool IsRecordingUsage() { return m_Streamer.IsRecordingUsage(); }
+
+private:
+    void RefreshView(StreamedTextureId id, PbrMaterialHeap& materials);
+    void Retire(ComPtr<ID3D12Resource>&& resource);
+
+    void AllocateMips(StreamedTextureId texture, uint32_t mostDetailedMip, uint32_t preserveFromMip) override;
+    void UploadMip(StreamedTextureId texture, uint32_t mipLevel, uint2 size, std::span<const uint8_t> rgbaData) override;
+    void FlushUploads() override;
+
+public:
+    ~GpuTextureStreamer();
+};
@@ -97,6 +97,10 @@ GraphicsCore::GraphicsCore()
 
     //---------------------------------------------------------------------------------------------------------
     // Allocate the descriptor heaps
+    //---------------------------------------------------------------------------------------------------------
+    // Resources are placed in large shared heaps rather than each getting an implicit heap of their own, see GpuMemoryManager for details
+    m_GpuMemoryManager = std::make_unique<::GpuMemoryManager>(*this);
+
     //---------------------------------------------------------------------------------------------------------
     // We only allocate a single GPU descriptor heap of each kind because switching between them is expensive on many platforms.
     // Intel:
@@ -119,6 +123,7 @@ GraphicsCore::GraphicsCore()
     m_GraphicsQueue = std::make_unique<::GraphicsQueue>(*this);
     m_ComputeQueue = std::make_unique<::ComputeQueue>(*this);
     m_UploadQueue = std::make_unique<::UploadQueue>(*this);
+    m_FenceReactor = std::make_unique<GpuFenceReactor>();
 
     //---------------------------------------------------------------------------------------------------------
     // Create common ExecuteIndirect command signatures
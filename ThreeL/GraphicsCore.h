@@ -2,6 +2,8 @@
 #include "pch.h"
 #include "CommandContext.h"
 #include "CommandQueue.h"
+#include "GpuFenceReactor.h"
+#include "GpuMemoryManager.h"
 #include "GraphicsCore.h"
 #include "ResourceDescriptorManager.h"
 #include "SamplerHeap.h"
@@ -16,6 +18,9 @@ private:
     ComPtr<IDXGIFactory4> m_DxgiFactory;
     DXGI_ADAPTER_DESC1 m_AdapterDescription;
 
+    // Declared before everything else which might own resources so that it is destroyed last
+    std::unique_ptr<GpuMemoryManager> m_GpuMemoryManager;
+
     std::unique_ptr<ResourceDescriptorManager> m_ResourceDescriptorManager;
     std::unique_ptr<SamplerHeap> m_SamplerHeap;
 
@@ -23,6 +28,9 @@ private:
     std::unique_ptr<ComputeQueue> m_ComputeQueue;
     std::unique_ptr<UploadQueue> m_UploadQueue;
 
+    // Declared after the queues so that it is destroyed first, its destructor waits for callbacks which may reference them
+    std::unique_ptr<GpuFenceReactor> m_FenceReactor;
+
     ComPtr<ID3D12CommandSignature> m_DrawIndirectCommandSignature;
     ComPtr<ID3D12CommandSignature> m_DrawIndexedIndirectCommandSignature;
     ComPtr<ID3D12CommandSignature> m_DispatchIndirectCommandSignature;
@@ -32,11 +40,13 @@ public:
 
     inline ID3D12Device* Device() const { return m_Device.Get(); }
     inline IDXGIFactory4* DxgiFactory() const { return m_DxgiFactory.Get(); }
+    inline GpuMemoryManager& GpuMemoryManager() const { return *m_GpuMemoryManager; }
     inline ResourceDescriptorManager& ResourceDescriptorManager() const { return *m_ResourceDescriptorManager; }
     inline SamplerHeap& SamplerHeap() const { return *m_SamplerHeap; }
     inline GraphicsQueue& GraphicsQueue() const { return *m_GraphicsQueue; }
     inline ComputeQueue& ComputeQueue() const { return *m_ComputeQueue; }
     inline UploadQueue& UploadQueue() const { return *m_UploadQueue; }
+    inline GpuFenceReactor& FenceReactor() const { return *m_FenceReactor; }
 
     inline ID3D12CommandSignature* DrawIndirectCommandSignature() const { return m_DrawIndirectCommandSignature.Get(); }
     inline ID3D12CommandSignature* DrawIndexedIndirectCommandSignature() const { return m_DrawIndexedIndirectCommandSignature.Get(); }
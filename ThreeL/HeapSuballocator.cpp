@@ -0,0 +1,289 @@
+#include "pch.h"
+#include "HeapSuballocator.h"
+
+#include <algorithm>
+#include <bit>
+
+HeapSuballocator::HeapSuballocator(uint64_t capacity, uint64_t granularity)
+    : m_Capacity(capacity)
+{
+    Assert(granularity > 0 && (granularity & (granularity - 1)) == 0 && "The granularity must be a power of two.");
+    Assert(capacity > 0 && capacity % granularity == 0 && "The capacity must be a multiple of the granularity.");
+    m_GranularityShift = (uint32_t)std::countr_zero(granularity);
+
+    for (uint32_t firstLevel = 0; firstLevel < FirstLevelCount; firstLevel++)
+    {
+        for (uint32_t secondLevel = 0; secondLevel < SecondLevelCount; secondLevel++)
+        { m_FreeLists[firstLevel][secondLevel] = NoBlock; }
+    }
+
+    // The heap starts out as a single free block
+    uint32_t block = NewBlock();
+    m_Blocks[block] =
+    {
+        .Offset = 0,
+        .Size = capacity >> m_GranularityShift,
+        .PreviousPhysical = NoBlock,
+        .NextPhysical = NoBlock,
+    };
+    InsertFreeBlock(block);
+}
+
+void HeapSuballocator::MapSize(uint64_t size, uint32_t* outFirstLevel, uint32_t* outSecondLevel)
+{
+    // Sizes below SecondLevelCount granules are binned linearly in the first first-level bin, everything else is binned logarithmically
+    if (size < SecondLevelCount)
+    {
+        *outFirstLevel = 0;
+        *outSecondLevel = (uint32_t)size;
+        return;
+    }
+
+    uint32_t log2 = 63 - (uint32_t)std::countl_zero(size);
+    *outFirstLevel = log2 - SecondLevelShift + 1;
+    *outSecondLevel = (uint32_t)(size >> (log2 - SecondLevelShift)) - SecondLevelCount;
+}
+
+uint32_t HeapSuballocator::NewBlock()
+{
+    if (!m_UnusedBlocks.empty())
+    {
+        uint32_t block = m_UnusedBlocks.back();
+        m_UnusedBlocks.pop_back();
+        return block;
+    }
+
+    m_Blocks.push_back({ });
+    return (uint32_t)(m_Blocks.size() - 1);
+}
+
+void HeapSuballocator::InsertFreeBlock(uint32_t block)
+{
+    uint32_t firstLevel;
+    uint32_t secondLevel;
+    MapSize(m_Blocks[block].Size, &firstLevel, &secondLevel);
+
+    uint32_t& head = m_FreeLists[firstLevel][secondLevel];
+    Block& entry = m_Blocks[block];
+    entry.IsFree = true;
+    entry.PreviousFree = NoBlock;
+    entry.NextFree = head;
+    if (head != NoBlock)
+    { m_Blocks[head].PreviousFree = block; }
+    head = block;
+
+    m_FirstLevelBitmap |= 1ull << firstLevel;
+    m_SecondLevelBitmaps[firstLevel] |= 1u << secondLevel;
+    m_FreeBlockCount++;
+}
+
+void HeapSuballocator::RemoveFreeBlock(uint32_t block)
+{
+    Block& entry = m_Blocks[block];
+    Assert(entry.IsFree);
+
+    if (entry.PreviousFree != NoBlock)
+    { m_Blocks[entry.PreviousFree].NextFree = entry.NextFree; }
+    if (entry.NextFree != NoBlock)
+    { m_Blocks[entry.NextFree].PreviousFree = entry.PreviousFree; }
+
+    uint32_t firstLevel;
+    uint32_t secondLevel;
+    MapSize(entry.Size, &firstLevel, &secondLevel);
+    uint32_t& head = m_FreeLists[firstLevel][secondLevel];
+    if (head == block)
+    {
+        head = entry.NextFree;
+        if (head == NoBlock)
+        {
+            m_SecondLevelBitmaps[firstLevel] &= ~(1u << secondLevel);
+            if (m_SecondLevelBitmaps[firstLevel] == 0)
+            { m_FirstLevelBitmap &= ~(1ull << firstLevel); }
+        }
+    }
+
+    entry.IsFree = false;
+    m_FreeBlockCount--;
+}
+
+uint32_t HeapSuballocator::FindFreeBlock(uint64_t size) const
+{
+    // Round the size up to the start of the next bin so that any block in the bin we find is large enough
+    if (size >= SecondLevelCount)
+    {
+        uint32_t log2 = 63 - (uint32_t)std::countl_zero(size);
+        uint64_t round = (1ull << (log2 - SecondLevelShift)) - 1;
+        if (size > UINT64_MAX - round)
+        { return NoBlock; }
+        size += round;
+    }
+
+    uint32_t firstLevel;
+    uint32_t secondLevel;
+    MapSize(size, &firstLevel, &secondLevel);
+    if (firstLevel >= FirstLevelCount)
+    { return NoBlock; }
+
+    uint32_t secondLevelMap = m_SecondLevelBitmaps[firstLevel] & (~0u << secondLevel);
+    if (secondLevelMap == 0)
+    {
+        // Nothing in this power of two range, move on to the smallest bin of the next non-empty range
+        uint64_t firstLevelMap = firstLevel + 1 < FirstLevelCount ? m_FirstLevelBitmap & (~0ull << (firstLevel + 1)) : 0;
+        if (firstLevelMap == 0)
+        { return NoBlock; }
+
+        firstLevel = (uint32_t)std::countr_zero(firstLevelMap);
+        secondLevelMap = m_SecondLevelBitmaps[firstLevel];
+    }
+
+    secondLevel = (uint32_t)std::countr_zero(secondLevelMap);
+    return m_FreeLists[firstLevel][secondLevel];
+}
+
+bool HeapSuballocator::TryAllocate(uint64_t sizeBytes, uint64_t alignment, HeapSuballocation* outAllocation)
+{
+    Assert(sizeBytes > 0);
+    Assert(alignment > 0 && (alignment & (alignment - 1)) == 0 && "The alignment must be a power of two.");
+
+    if (sizeBytes > m_Capacity)
+    { return false; }
+
+    uint64_t granularity = Granularity();
+    uint64_t size = (sizeBytes + granularity - 1) >> m_GranularityShift;
+    uint64_t alignmentGranules = std::max(alignment, granularity) >> m_GranularityShift;
+
+    // When the alignment is coarser than the granularity the block might need to be padded at the front
+    // Blocks are often already aligned so try without padding first, then fall back to looking for a block which is large enough for the worst case
+    uint32_t block = FindFreeBlock(size);
+    if (block != NoBlock && alignmentGranules > 1)
+    {
+        const Block& entry = m_Blocks[block];
+        uint64_t alignedOffset = (entry.Offset + alignmentGranules - 1) & ~(alignmentGranules - 1);
+        if (alignedOffset + size > entry.Offset + entry.Size)
+        { block = FindFreeBlock(size + alignmentGranules - 1); }
+    }
+
+    if (block == NoBlock)
+    { return false; }
+
+    RemoveFreeBlock(block);
+
+    // Split off the padding needed to align the allocation as a free block of its own
+    uint64_t alignedOffset = (m_Blocks[block].Offset + alignmentGranules - 1) & ~(alignmentGranules - 1);
+    uint64_t padding = alignedOffset - m_Blocks[block].Offset;
+    if (padding > 0)
+    {
+        uint32_t paddingBlock = NewBlock();
+        Block& entry = m_Blocks[block];
+        m_Blocks[paddingBlock] =
+        {
+            .Offset = entry.Offset,
+            .Size = padding,
+            .PreviousPhysical = entry.PreviousPhysical,
+            .NextPhysical = block,
+        };
+
+        if (entry.PreviousPhysical != NoBlock)
+        { m_Blocks[entry.PreviousPhysical].NextPhysical = paddingBlock; }
+
+        entry.PreviousPhysical = paddingBlock;
+        entry.Offset += padding;
+        entry.Size -= padding;
+        InsertFreeBlock(paddingBlock);
+    }
+
+    // Return whatever is left past the end of the allocation to the free lists
+    Assert(m_Blocks[block].Size >= size);
+    if (m_Blocks[block].Size > size)
+    {
+        uint32_t remainderBlock = NewBlock();
+        Block& entry = m_Blocks[block];
+        m_Blocks[remainderBlock] =
+        {
+            .Offset = entry.Offset + size,
+            .Size = entry.Size - size,
+            .PreviousPhysical = block,
+            .NextPhysical = entry.NextPhysical,
+        };
+
+        if (entry.NextPhysical != NoBlock)
+        { m_Blocks[entry.NextPhysical].PreviousPhysical = remainderBlock; }
+
+        entry.NextPhysical = remainderBlock;
+        entry.Size = size;
+        InsertFreeBlock(remainderBlock);
+    }
+
+    m_UsedGranules += size;
+    m_AllocationCount++;
+    *outAllocation = { .Offset = m_Blocks[block].Offset << m_GranularityShift, .Block = block };
+    return true;
+}
+
+void HeapSuballocator::Free(uint32_t block)
+{
+    Assert(block < m_Blocks.size() && !m_Blocks[block].IsFree && m_Blocks[block].Size > 0 && "The block is not allocated.");
+    m_UsedGranules -= m_Blocks[block].Size;
+    m_AllocationCount--;
+
+    // Merge with the following block
+    uint32_t next = m_Blocks[block].NextPhysical;
+    if (next != NoBlock && m_Blocks[next].IsFree)
+    {
+        RemoveFreeBlock(next);
+        Block& entry = m_Blocks[block];
+        entry.Size += m_Blocks[next].Size;
+        entry.NextPhysical = m_Blocks[next].NextPhysical;
+        if (entry.NextPhysical != NoBlock)
+        { m_Blocks[entry.NextPhysical].PreviousPhysical = block; }
+
+        m_Blocks[next].Size = 0;
+        m_UnusedBlocks.push_back(next);
+    }
+
+    // Merge with the preceding block
+    uint32_t previous = m_Blocks[block].PreviousPhysical;
+    if (previous != NoBlock && m_Blocks[previous].IsFree)
+    {
+        RemoveFreeBlock(previous);
+        Block& entry = m_Blocks[previous];
+        entry.Size += m_Blocks[block].Size;
+        entry.NextPhysical = m_Blocks[block].NextPhysical;
+        if (entry.NextPhysical != NoBlock)
+        { m_Blocks[entry.NextPhysical].PreviousPhysical = previous; }
+
+        m_Blocks[block].Size = 0;
+        m_UnusedBlocks.push_back(block);
+        block = previous;
+    }
+
+    InsertFreeBlock(block);
+}
+
+uint64_t HeapSuballocator::AllocationSize(uint32_t block) const
+{
+    Assert(block < m_Blocks.size() && !m_Blocks[block].IsFree);
+    return m_Blocks[block].Size << m_GranularityShift;
+}
+
+HeapSuballocatorStatistics HeapSuballocator::Statistics() const
+{
+    // The largest free block lives in the highest non-empty bin, but the bin covers a range of sizes so it has to be searched
+    uint64_t largestFreeBlock = 0;
+    if (m_FirstLevelBitmap != 0)
+    {
+        uint32_t firstLevel = 63 - (uint32_t)std::countl_zero(m_FirstLevelBitmap);
+        uint32_t secondLevel = 31 - (uint32_t)std::countl_zero(m_SecondLevelBitmaps[firstLevel]);
+        for (uint32_t block = m_FreeLists[firstLevel][secondLevel]; block != NoBlock; block = m_Blocks[block].NextFree)
+        { largestFreeBlock = std::max(largestFreeBlock, m_Blocks[block].Size); }
+    }
+
+    return
+    {
+        .Capacity = m_Capacity,
+        .UsedBytes = UsedBytes(),
+        .AllocationCount = m_AllocationCount,
+        .FreeBlockCount = m_FreeBlockCount,
+        .LargestFreeBlock = largestFreeBlock << m_GranularityShift,
+    };
+}
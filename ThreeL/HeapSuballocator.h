@@ -0,0 +1,105 @@
+#pragma once
+#include <stdint.h>
+#include <vector>
+
+//! An allocation made by HeapSuballocator::TryAllocate
+struct HeapSuballocation
+{
+    //! Offset of the allocation from the start of the heap in bytes
+    uint64_t Offset;
+
+    //! Identifies the allocation when it's freed
+    uint32_t Block;
+};
+
+//! The result of HeapSuballocator::Statistics
+struct HeapSuballocatorStatistics
+{
+    uint64_t Capacity;
+    uint64_t UsedBytes;
+    uint32_t AllocationCount;
+    uint32_t FreeBlockCount;
+    uint64_t LargestFreeBlock;
+
+    //! The portion of the free space which isn't part of the largest free block, 0 when all of the free space is contiguous
+    inline float Fragmentation() const
+    {
+        uint64_t freeBytes = Capacity - UsedBytes;
+        return freeBytes == 0 ? 0.f : 1.f - (float)LargestFreeBlock / (float)freeBytes;
+    }
+};
+
+//! Suballocates ranges of a fixed size heap using a two-level segregated fit (TLSF) allocator
+//! Free blocks are binned by size into power of two ranges which are each split into SecondLevelCount linear bins, and bitmaps of the non-empty bins
+//! make finding a suitable block constant time. Freed blocks are merged with their free neighbors immediately.
+//! Sizes and offsets are multiples of the granularity passed to the constructor (IE: the smallest placement alignment of the heap.)
+//! This type only deals in offsets so it has no dependency on D3D. It is not thread-safe.
+class HeapSuballocator
+{
+public:
+    static constexpr uint32_t NoBlock = UINT32_MAX;
+
+private:
+    static constexpr uint32_t SecondLevelShift = 4;
+    static constexpr uint32_t SecondLevelCount = 1 << SecondLevelShift;
+    static constexpr uint32_t FirstLevelCount = 64;
+
+    struct Block
+    {
+        // Offset and size are in granules
+        uint64_t Offset;
+        uint64_t Size;
+
+        // Neighboring blocks in the heap
+        uint32_t PreviousPhysical;
+        uint32_t NextPhysical;
+
+        // Neighboring blocks in the same bin, only valid for free blocks
+        uint32_t PreviousFree;
+        uint32_t NextFree;
+
+        bool IsFree;
+    };
+
+    uint64_t m_Capacity;
+    uint32_t m_GranularityShift;
+
+    std::vector<Block> m_Blocks;
+    std::vector<uint32_t> m_UnusedBlocks;
+
+    uint64_t m_FirstLevelBitmap = 0;
+    uint32_t m_SecondLevelBitmaps[FirstLevelCount] = { };
+    uint32_t m_FreeLists[FirstLevelCount][SecondLevelCount];
+
+    uint64_t m_UsedGranules = 0;
+    uint32_t m_AllocationCount = 0;
+    uint32_t m_FreeBlockCount = 0;
+
+public:
+    //! The granularity must be a power of two and the capacity must be a multiple of it
+    HeapSuballocator(uint64_t capacity, uint64_t granularity);
+    HeapSuballocator(const HeapSuballocator&) = delete;
+
+    //! Allocates sizeBytes bytes aligned to alignment (which must be a power of two), returns false if there isn't a large enough free block
+    bool TryAllocate(uint64_t sizeBytes, uint64_t alignment, HeapSuballocation* outAllocation);
+
+    //! Frees an allocation made by TryAllocate
+    void Free(uint32_t block);
+
+    //! The size of the allocation in bytes, which is its requested size rounded up to the granularity
+    uint64_t AllocationSize(uint32_t block) const;
+
+    inline uint64_t Capacity() const { return m_Capacity; }
+    inline uint64_t Granularity() const { return 1ull << m_GranularityShift; }
+    inline uint64_t UsedBytes() const { return m_UsedGranules << m_GranularityShift; }
+    inline uint32_t AllocationCount() const { return m_AllocationCount; }
+    inline bool IsEmpty() const { return m_AllocationCount == 0; }
+    HeapSuballocatorStatistics Statistics() const;
+
+private:
+    static void MapSize(uint64_t size, uint32_t* outFirstLevel, uint32_t* outSecondLevel);
+    uint32_t NewBlock();
+    void InsertFreeBlock(uint32_t block);
+    void RemoveFreeBlock(uint32_t block);
+    uint32_t FindFreeBlock(uint64_t size) const;
+};
@@ -14,22 +14,50 @@ HlslCompiler::HlslCompiler()
     AssertSuccess(DxcCreateInstance(CLSID_DxcCompiler, IID_PPV_ARGS(&m_Compiler)));
     AssertSuccess(DxcCreateInstance(CLSID_DxcUtils, IID_PPV_ARGS(&m_CompilerUtils)));
     AssertSuccess(m_CompilerUtils->CreateDefaultIncludeHandler(&m_IncludeHandler));
+
+    // The cache is keyed on the exact compiler build so that updating DXC doesn't keep using shaders from the old one
+    std::string compilerVersion = "Unknown DXC";
+    ComPtr<IDxcVersionInfo> versionInfo;
+    if (SUCCEEDED(m_Compiler.As(&versionInfo)))
+    {
+        UINT32 major;
+        UINT32 minor;
+        AssertSuccess(versionInfo->GetVersion(&major, &minor));
+        compilerVersion = std::format("DXC {}.{}", major, minor);
+
+        ComPtr<IDxcVersionInfo2> versionInfo2;
+        if (SUCCEEDED(m_Compiler.As(&versionInfo2)))
+        {
+            UINT32 commitCount;
+            char* commitHash;
+            AssertSuccess(versionInfo2->GetCommitInfo(&commitCount, &commitHash));
+            compilerVersion += std::format(" ({} {})", commitCount, commitHash);
+            CoTaskMemFree(commitHash);
+        }
+    }
+
+    m_Cache = std::make_unique<ShaderCache>(std::filesystem::current_path() / "ShaderCache", compilerVersion);
 }
 
 ShaderBlobs HlslCompiler::CompileShader(std::wstring filePath, std::wstring entryPoint, std::wstring target, const std::vector<std::wstring>& defines)
 {
-    DxcBuffer sourceBuffer = {};
-    ComPtr<IDxcBlobEncoding> source;
-    AssertSuccess(m_CompilerUtils->LoadFile(filePath.c_str(), nullptr, &source));
-    sourceBuffer.Ptr = source->GetBufferPointer();
-    sourceBuffer.Size = source->GetBufferSize();
-    sourceBuffer.Encoding = DXC_CP_ACP;
+    std::string diagnostics;
+    std::optional<ShaderBlobs> shader = TryCompileShader(filePath, entryPoint, target, defines, diagnostics);
 
-    std::vector<LPCWSTR> args =
+    if (!diagnostics.empty())
+    { std::cerr << diagnostics; }
+
+    if (!shader.has_value())
+    { Fail("Shader compilation failed."); }
+
+    return std::move(*shader);
+}
+
+std::optional<ShaderBlobs> HlslCompiler::TryCompileShader(const std::wstring& filePath, const std::wstring& entryPoint, const std::wstring& target, const std::vector<std::wstring>& defines, std::string& diagnostics)
+{
+    // Flags other than the file, entry point, target, and defines (which are all part of the cache request themselves)
+    const LPCWSTR flags[] =
     {
-        filePath.c_str(),
-        L"-E", entryPoint.c_str(),
-        L"-T", target.c_str(),
         L"-Zpr", // float4x4 uses row-major storage
 #ifdef DEBUG
         // Enable shader PDBs
@@ -42,6 +70,14 @@ ShaderBlobs HlslCompiler::CompileShader(std::wstring filePath, std::wstring entr
 #endif
     };
 
+    std::vector<LPCWSTR> args =
+    {
+        filePath.c_str(),
+        L"-E", entryPoint.c_str(),
+        L"-T", target.c_str(),
+    };
+
+    args.insert(args.end(), std::begin(flags), std::end(flags));
     args.reserve(args.size() + defines.size() * 2);
     for (const std::wstring& define : defines)
     {
@@ -49,23 +85,64 @@ ShaderBlobs HlslCompiler::CompileShader(std::wstring filePath, std::wstring entr
         args.push_back(define.c_str());
     }
 
+    // Shader PDBs are only written when the shader is actually compiled, but PDBs are named after the shader hash so it'll already be there from back then
+    ShaderCacheRequest request =
+    {
+        .SourcePath = filePath,
+        .EntryPoint = entryPoint,
+        .Target = target,
+        .Defines = defines,
+        .Arguments = std::vector<std::wstring>(std::begin(flags), std::end(flags)),
+    };
+
+    std::optional<CachedShader> compiled = m_Cache->GetOrCompile(request, [&]() { return CompileShaderUncached(filePath, entryPoint, target, args, diagnostics); });
+    if (!compiled.has_value())
+    { return std::nullopt; }
+
+    ShaderBlobs shader;
+    shader.ShaderBlob = CreateBlob(compiled->Shader);
+    shader.RootSignatureBlob = compiled->RootSignature.empty() ? nullptr : CreateBlob(compiled->RootSignature);
+    return shader;
+}
+
+std::optional<CachedShader> HlslCompiler::CompileShaderUncached(const std::wstring& filePath, const std::wstring& entryPoint, const std::wstring& target, const std::vector<LPCWSTR>& args, std::string& diagnostics)
+{
+    DxcBuffer sourceBuffer = {};
+    ComPtr<IDxcBlobEncoding> source;
+    if (FAILED(m_CompilerUtils->LoadFile(filePath.c_str(), nullptr, &source)))
+    {
+        diagnostics += std::format("Failed to load shader source '{}'.\n", filePath);
+        return std::nullopt;
+    }
+
+    sourceBuffer.Ptr = source->GetBufferPointer();
+    sourceBuffer.Size = source->GetBufferSize();
+    sourceBuffer.Encoding = DXC_CP_ACP;
+
     ComPtr<IDxcResult> results;
     HRESULT compileResult = m_Compiler->Compile(&sourceBuffer, args.data(), (UINT32)args.size(), m_IncludeHandler.Get(), IID_PPV_ARGS(&results));
 
-    // Print errors if present
+    if (FAILED(compileResult))
+    {
+        diagnostics += std::format("DXC failed to compile `{}` in '{}' for '{}' (HRESULT 0x{:08X}).\n", entryPoint, filePath, target, (uint32_t)compileResult);
+        return std::nullopt;
+    }
+
+    // Report errors if present
     ComPtr<IDxcBlobUtf8> errors;
     AssertSuccess(results->GetOutput(DXC_OUT_ERRORS, IID_PPV_ARGS(&errors), nullptr));
     if (errors != nullptr && errors->GetStringLength() > 0)
     {
-        std::wcerr << L"Diagnostics while compiling `" << entryPoint << L"` in '" << filePath << L"' for '" << target << L"':" << std::endl;
-        std::cerr << std::string(errors->GetStringPointer(), errors->GetStringLength()) << std::endl;
+        diagnostics += std::format("Diagnostics while compiling `{}` in '{}' for '{}':\n", entryPoint, filePath, target);
+        diagnostics += std::string_view(errors->GetStringPointer(), errors->GetStringLength());
+        diagnostics += '\n';
     }
 
     // Fail if the compilation failed
     HRESULT overallResult;
     AssertSuccess(results->GetStatus(&overallResult));
-    AssertSuccess(overallResult);
-    AssertSuccess(compileResult);
+    if (FAILED(overallResult))
+    { return std::nullopt; }
 
     // Write out the shader PDB
 #ifdef DEBUG
@@ -90,14 +167,31 @@ ShaderBlobs HlslCompiler::CompileShader(std::wstring filePath, std::wstring entr
     }
 #endif
 
-    // Return the compiled shader blob (and the root signature if present)
-    ShaderBlobs shader;
-    AssertSuccess(results->GetOutput(DXC_OUT_OBJECT, IID_PPV_ARGS(&shader.ShaderBlob), nullptr));
+    // Return the compiled shader (and the root signature if present)
+    auto BlobBytes = [](IDxcBlob* blob) { return std::vector<uint8_t>((uint8_t*)blob->GetBufferPointer(), (uint8_t*)blob->GetBufferPointer() + blob->GetBufferSize()); };
+    CachedShader shader;
+
+    ComPtr<IDxcBlob> shaderBlob;
+    AssertSuccess(results->GetOutput(DXC_OUT_OBJECT, IID_PPV_ARGS(&shaderBlob), nullptr));
+    shader.Shader = BlobBytes(shaderBlob.Get());
 
     if (results->HasOutput(DXC_OUT_ROOT_SIGNATURE))
-    { AssertSuccess(results->GetOutput(DXC_OUT_ROOT_SIGNATURE, IID_PPV_ARGS(&shader.RootSignatureBlob), nullptr)); }
-    else
-    { shader.RootSignatureBlob = nullptr; }
+    {
+        ComPtr<IDxcBlob> rootSignatureBlob;
+        AssertSuccess(results->GetOutput(DXC_OUT_ROOT_SIGNATURE, IID_PPV_ARGS(&rootSignatureBlob), nullptr));
+        shader.RootSignature = BlobBytes(rootSignatureBlob.Get());
+    }
 
     return shader;
 }
+
+ComPtr<ID3DBlob> HlslCompiler::CreateBlob(std::span<const uint8_t> data)
+{
+    // IDxcBlob shares its IID with ID3DBlob, so DXC's blobs can be used directly
+    ComPtr<IDxcBlobEncoding> blob;
+    AssertSuccess(m_CompilerUtils->CreateBlob(data.data(), (UINT32)data.size(), DXC_CP_ACP, &blob));
+
+    ComPtr<ID3DBlob> result;
+    AssertSuccess(blob.As(&result));
+    return result;
+}
@@ -1,5 +1,6 @@
 #pragma once
 #include "pch.h"
+#include "ShaderCache.h"
 
 struct ShaderBlobs
 {
@@ -23,7 +24,22 @@ private:
     ComPtr<IDxcUtils> m_CompilerUtils;
     ComPtr<IDxcIncludeHandler> m_IncludeHandler;
 
+    // Compiled shaders are cached in the ShaderCache folder of the working directory, see ShaderCache
+    std::unique_ptr<ShaderCache> m_Cache;
+
 public:
     HlslCompiler();
+    //! Compiles a shader, printing any diagnostics and failing if compilation fails
     ShaderBlobs CompileShader(std::wstring filePath, std::wstring entryPoint, std::wstring target, const std::vector<std::wstring>& defines = {});
+
+    //! Compiles a shader, returning nothing if compilation fails
+    //! Warnings and errors are appended to diagnostics rather than printed so that callers compiling on several threads can report them in a consistent order.
+    //! Each HlslCompiler must only be used by one thread at a time.
+    std::optional<ShaderBlobs> TryCompileShader(const std::wstring& filePath, const std::wstring& entryPoint, const std::wstring& target, const std::vector<std::wstring>& defines, std::string& diagnostics);
+
+    inline const ShaderCache& Cache() const { return *m_Cache; }
+
+private:
+    std::optional<CachedShader> CompileShaderUncached(const std::wstring& filePath, const std::wstring& entryPoint, const std::wstring& target, const std::vector<LPCWSTR>& args, std::string& diagnostics);
+    ComPtr<ID3DBlob> CreateBlob(std::span<const uint8_t> data);
 };
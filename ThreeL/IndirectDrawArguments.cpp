@@ -0,0 +1,87 @@
+#include "pch.h"
+#include "IndirectDrawArguments.h"
+
+#include <algorithm>
+
+namespace IndirectDrawArguments
+{
+    Arguments Build(std::span<const DrawPacket> packets, std::span<const ShaderInterop::PerNodeCb> nodes, std::span<const MeshLod> lods)
+    {
+        Arguments result;
+        result.Records.reserve(packets.size());
+        result.CullingInfo.reserve(packets.size());
+
+        result.Lods.reserve(lods.size());
+        for (const MeshLod& lod : lods)
+        {
+            result.Lods.push_back
+            ({
+                .Indices = lod.Indices,
+                .IndexCount = lod.IndexCount,
+                .Error = lod.Error,
+            });
+        }
+
+        for (const DrawPacket& packet : packets)
+        {
+            if (!packet.IsIndexed)
+            {
+                result.UnindexedPackets.push_back(packet);
+                continue;
+            }
+
+            // Start a new bucket whenever the pipeline state changes
+            if (result.Buckets.empty() || result.Buckets.back().PipelineState != packet.PipelineState)
+            {
+                // DrawList sorts by pipeline state first, so seeing the same one twice means the caller didn't give us a sorted list
+                Assert(std::none_of(result.Buckets.begin(), result.Buckets.end(), [&](const Bucket& bucket) { return bucket.PipelineState == packet.PipelineState; }));
+
+                result.Buckets.push_back
+                ({
+                    .PipelineState = packet.PipelineState,
+                    .First = (uint32_t)result.Records.size(),
+                    .Count = 0,
+                });
+            }
+
+            Bucket& bucket = result.Buckets.back();
+            bucket.Count++;
+
+            Assert(packet.NodeIndex < nodes.size());
+            Assert(packet.LodCount == 0 || packet.FirstLod + packet.LodCount <= lods.size());
+            ShaderInterop::PerNodeCb perNode = nodes[packet.NodeIndex];
+            perNode.MaterialId = packet.MaterialId;
+            perNode.ColorsIndex = packet.ColorsIndex;
+            perNode.TangentsIndex = packet.TangentsIndex;
+
+            result.Records.push_back
+            ({
+                .Positions = packet.Positions,
+                .Normals = packet.Normals,
+                .Uvs = packet.Uvs,
+                .Indices = packet.Indices,
+                .PerNode = perNode,
+                .Draw =
+                {
+                    .IndexCountPerInstance = packet.VertexOrIndexCount,
+                    .InstanceCount = 1,
+                    .StartIndexLocation = 0,
+                    .BaseVertexLocation = 0,
+                    .StartInstanceLocation = 0,
+                },
+            });
+
+            result.CullingInfo.push_back
+            ({
+                .BoundsCenter = packet.BoundsCenter,
+                .BucketIndex = (uint32_t)result.Buckets.size() - 1,
+                .BoundsExtents = packet.BoundsExtents,
+                .BucketFirst = bucket.First,
+                .FirstLod = packet.LodCount == 0 ? 0 : packet.FirstLod,
+                .LodCount = packet.LodCount,
+            });
+        }
+
+        return result;
+    }
+}
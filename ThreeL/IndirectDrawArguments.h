@@ -0,0 +1,36 @@
+#pragma once
+#include "DrawList.h"
+#include "ShaderInterop.h"
+
+#include <span>
+#include <vector>
+
+//! Converts the packets of a DrawList into the records consumed by IndirectDrawList's culling and ExecuteIndirect passes
+//! This is purely CPU-side so that the layout logic can be checked (and reasoned about) away from the GPU.
+namespace IndirectDrawArguments
+{
+    //! A contiguous run of records which share a pipeline state, drawn with a single ExecuteIndirect
+    struct Bucket
+    {
+        ID3D12PipelineState* PipelineState;
+        uint32_t First;
+        uint32_t Count;
+    };
+
+    struct Arguments
+    {
+        std::vector<ShaderInterop::IndirectDrawRecord> Records;
+        std::vector<ShaderInterop::IndirectDrawCullingInfo> CullingInfo;
+        std::vector<Bucket> Buckets;
+
+        //! Every LOD of the source list, the culling info references these the same way packets reference DrawList::Lods()
+        std::vector<ShaderInterop::IndirectDrawLod> Lods;
+
+        //! Packets which can't be expressed with the indexed command signature and must be drawn directly
+        std::vector<DrawPacket> UnindexedPackets;
+    };
+
+    //! Builds the arguments for the specified packets, which must be sorted such that packets sharing a pipeline state are adjacent
+    //! Records always reference the full detail geometry, SceneCulling.cs.hlsl swaps in the selected LOD's indices when it compacts them.
+    Arguments Build(std::span<const DrawPacket> packets, std::span<const ShaderInterop::PerNodeCb> nodes, std::span<const MeshLod> lods = { });
+}
@@ -0,0 +1,147 @@
+#include "pch.h"
+#include "IndirectDrawList.h"
+
+#include "ComputeContext.h"
+#include "GraphicsContext.h"
+#include "GraphicsCore.h"
+#include "ResourceManager.h"
+#include "UploadQueue.h"
+
+namespace
+{
+    RawGpuResource CreateUavBuffer(GraphicsCore& graphics, uint64_t sizeBytes, const std::wstring& debugName)
+    {
+        D3D12_HEAP_PROPERTIES heapProperties = { D3D12_HEAP_TYPE_DEFAULT };
+        D3D12_RESOURCE_DESC description = DescribeBufferResource(sizeBytes, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
+        ComPtr<ID3D12Resource> resource;
+        AssertSuccess(graphics.Device()->CreateCommittedResource
+        (
+            &heapProperties,
+            D3D12_HEAP_FLAG_CREATE_NOT_ZEROED,
+            &description,
+            D3D12_RESOURCE_STATE_COMMON,
+            nullptr,
+            IID_PPV_ARGS(&resource)
+        ));
+        resource->SetName(debugName.c_str());
+        return RawGpuResource(std::move(resource));
+    }
+}
+
+IndirectDrawList::IndirectDrawList(ResourceManager& resources, const DrawList& drawList, const std::wstring& debugName)
+    : m_Resources(resources), m_DebugName(debugName), m_Nodes(drawList.Nodes())
+{
+    IndirectDrawArguments::Arguments arguments = IndirectDrawArguments::Build(drawList.Packets(), drawList.Nodes(), drawList.Lods());
+    m_DrawCount = (uint32_t)arguments.Records.size();
+    m_Buckets = std::move(arguments.Buckets);
+    m_UnindexedPackets = std::move(arguments.UnindexedPackets);
+
+    // Nothing to allocate if everything has to be drawn directly
+    if (m_DrawCount == 0)
+    { return; }
+
+    GraphicsCore& graphics = resources.Graphics;
+    UploadQueue& uploadQueue = graphics.UploadQueue();
+    std::span<const ShaderInterop::IndirectDrawRecord> recordData = arguments.Records;
+    PendingUpload records = uploadQueue.AllocateResource(DescribeBufferResource(recordData.size_bytes()), std::format(L"{} Indirect Draw Records", m_DebugName));
+    SpanCopy(SpanCast<uint8_t, ShaderInterop::IndirectDrawRecord>(records.StagingBuffer()), recordData);
+
+    std::span<const ShaderInterop::IndirectDrawCullingInfo> cullingInfoData = arguments.CullingInfo;
+    PendingUpload cullingInfo = uploadQueue.AllocateResource(DescribeBufferResource(cullingInfoData.size_bytes()), std::format(L"{} Indirect Draw Culling Info", m_DebugName));
+    SpanCopy(SpanCast<uint8_t, ShaderInterop::IndirectDrawCullingInfo>(cullingInfo.StagingBuffer()), cullingInfoData);
+
+    // Buffers can't be empty, so scenes without any LODs get a single unused one
+    if (arguments.Lods.empty())
+    { arguments.Lods.push_back({ }); }
+
+    std::span<const ShaderInterop::IndirectDrawLod> lodData = arguments.Lods;
+    PendingUpload lods = uploadQueue.AllocateResource(DescribeBufferResource(lodData.size_bytes()), std::format(L"{} Indirect Draw LODs", m_DebugName));
+    SpanCopy(SpanCast<uint8_t, ShaderInterop::IndirectDrawLod>(lods.StagingBuffer()), lodData);
+
+    // All of the buffers are uploaded with a single command list
+    PendingUpload* pendingUploads[] = { &records, &cullingInfo, &lods };
+    std::vector<InitiatedUpload> uploads = uploadQueue.InitiateUploads(pendingUploads);
+    graphics.GraphicsQueue().AwaitSyncPoint(uploads[0].SyncPoint);
+    m_Records = RawGpuResource(std::move(uploads[0].Resource));
+    m_CullingInfo = RawGpuResource(std::move(uploads[1].Resource));
+    m_Lods = RawGpuResource(std::move(uploads[2].Resource));
+    m_CulledRecords = CreateUavBuffer(graphics, arguments.Records.size() * sizeof(ShaderInterop::IndirectDrawRecord), std::format(L"{} Culled Indirect Draw Records", m_DebugName));
+    m_BucketCounts = CreateUavBuffer(graphics, m_Buckets.size() * sizeof(uint32_t), std::format(L"{} Indirect Draw Bucket Counts", m_DebugName));
+}
+
+void IndirectDrawList::Cull(ComputeContext& context, D3D12_GPU_VIRTUAL_ADDRESS perFrameCb, float pixelsPerUnit, float maxPixelError)
+{
+    if (m_DrawCount == 0)
+    { return; }
+
+    context->SetComputeRootSignature(m_Resources.SceneCullingRootSignature);
+
+    ShaderInterop::SceneCullingParams params =
+    {
+        .DrawCount = m_DrawCount,
+        .BucketCount = (uint32_t)m_Buckets.size(),
+        .PixelsPerUnit = pixelsPerUnit,
+        .MaxPixelError = maxPixelError,
+    };
+    context->SetComputeRoot32BitConstants(ShaderInterop::SceneCulling::RpParams, sizeof(params) / sizeof(uint32_t), &params, 0);
+    context->SetComputeRootConstantBufferView(ShaderInterop::SceneCulling::RpPerFrameCb, perFrameCb);
+    context->SetComputeRootShaderResourceView(ShaderInterop::SceneCulling::RpRecords, m_Records.GpuAddress());
+    context->SetComputeRootShaderResourceView(ShaderInterop::SceneCulling::RpCullingInfo, m_CullingInfo.GpuAddress());
+    context->SetComputeRootShaderResourceView(ShaderInterop::SceneCulling::RpLods, m_Lods.GpuAddress());
+    context->SetComputeRootUnorderedAccessView(ShaderInterop::SceneCulling::RpCulledRecords, m_CulledRecords.GpuAddress());
+    context->SetComputeRootUnorderedAccessView(ShaderInterop::SceneCulling::RpBucketCounts, m_BucketCounts.GpuAddress());
+
+    context.TransitionResource(m_Records, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+    context.TransitionResource(m_CullingInfo, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+    context.TransitionResource(m_Lods, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+    context.TransitionResource(m_CulledRecords, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+    context.TransitionResource(m_BucketCounts, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+
+    context->SetPipelineState(m_Resources.SceneCullingClearCounts);
+    context.Dispatch(Math::DivRoundUp((uint32_t)m_Buckets.size(), ShaderInterop::SceneCulling::GroupSize));
+    context.UavBarrier(m_BucketCounts);
+
+    context->SetPipelineState(m_Resources.SceneCulling);
+    context.Dispatch(Math::DivRoundUp(m_DrawCount, ShaderInterop::SceneCulling::GroupSize));
+}
+
+void IndirectDrawList::Submit(GraphicsContext& context)
+{
+    if (m_DrawCount > 0)
+    {
+        context.TransitionResource(m_CulledRecords, D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT);
+        context.TransitionResource(m_BucketCounts, D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT, true);
+
+        for (uint32_t i = 0; i < m_Buckets.size(); i++)
+        {
+            const IndirectDrawArguments::Bucket& bucket = m_Buckets[i];
+            context->SetPipelineState(bucket.PipelineState);
+            context->ExecuteIndirect
+            (
+                m_Resources.PbrIndirectDrawCommandSignature.Get(),
+                bucket.Count,
+                m_CulledRecords,
+                bucket.First * sizeof(ShaderInterop::IndirectDrawRecord),
+                m_BucketCounts,
+                i * sizeof(uint32_t)
+            );
+        }
+    }
+
+    // Unindexed draws aren't culled, and since ExecuteIndirect leaves the bindings it touched in an undefined state they rebind everything
+    // (Sponza doesn't have any, so this isn't worth a separate command signature.)
+    for (const DrawPacket& packet : m_UnindexedPackets)
+    {
+        ShaderInterop::PerNodeCb perNode = m_Nodes[packet.NodeIndex];
+        perNode.MaterialId = packet.MaterialId;
+        perNode.ColorsIndex = packet.ColorsIndex;
+        perNode.TangentsIndex = packet.TangentsIndex;
+        context->SetGraphicsRoot32BitConstants(ShaderInterop::Pbr::RpPerNodeCb, sizeof(perNode) / sizeof(uint32_t), &perNode, 0);
+
+        context->SetPipelineState(packet.PipelineState);
+        context->IASetVertexBuffers(MeshInputSlot::Position, 1, &packet.Positions);
+        context->IASetVertexBuffers(MeshInputSlot::Normal, 1, &packet.Normals);
+        context->IASetVertexBuffers(MeshInputSlot::Uv0, 1, &packet.Uvs);
+        context.DrawInstanced(packet.VertexOrIndexCount, 1);
+    }
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include "DrawList.h"
+#include "IndirectDrawArguments.h"
+#include "RawGpuResource.h"
+
+#include <d3d12.h>
+#include <string>
+#include <vector>
+
+struct ComputeContext;
+struct GraphicsContext;
+struct ResourceManager;
+
+//! GPU-driven counterpart to DrawList::Submit
+//! The draws of a DrawList are uploaded once as ExecuteIndirect records. Each frame Cull frustum culls and compacts them on the GPU and Submit issues a
+//! single ExecuteIndirect for each pipeline state, so the CPU cost of recording a pass no longer scales with the number of draws.
+//! LODs are selected on the GPU while culling, using the same metric as DrawList::SelectLods.
+class IndirectDrawList
+{
+private:
+    ResourceManager& m_Resources;
+    std::wstring m_DebugName;
+
+    uint32_t m_DrawCount = 0;
+    std::vector<IndirectDrawArguments::Bucket> m_Buckets;
+    std::vector<DrawPacket> m_UnindexedPackets;
+    std::span<const ShaderInterop::PerNodeCb> m_Nodes;
+
+    RawGpuResource m_Records;
+    RawGpuResource m_CullingInfo;
+    RawGpuResource m_Lods;
+    RawGpuResource m_CulledRecords;
+    RawGpuResource m_BucketCounts;
+
+public:
+    //! The draw list must outlive the indirect draw list
+    IndirectDrawList(ResourceManager& resources, const DrawList& drawList, const std::wstring& debugName);
+    IndirectDrawList(const IndirectDrawList&) = delete;
+
+    //! Frustum culls the draws against the view projection transform in the specified per-frame constant buffer
+    //! The visible draws use the coarsest LOD within maxPixelError as seen from the per-frame eye position (see DrawList::SelectLods), or their full detail
+    //! geometry when maxPixelError is 0.
+    void Cull(ComputeContext& context, D3D12_GPU_VIRTUAL_ADDRESS perFrameCb, float pixelsPerUnit, float maxPixelError);
+
+    //! Draws whatever survived the most recent call to Cull
+    //! The PBR root signature must already be bound.
+    void Submit(GraphicsContext& context);
+
+    inline uint32_t DrawCount() const { return m_DrawCount; }
+    inline uint32_t BucketCount() const { return (uint32_t)m_Buckets.size(); }
+};
@@ -0,0 +1,73 @@
+#include "pch.h"
+#include "InstanceGrouping.h"
+
+#include <unordered_map>
+
+namespace
+{
+    // Packets can be drawn as instances of each other if everything except their node matches
+    struct SharedStateHash
+    {
+        size_t operator()(const DrawPacket* packet) const
+        {
+            size_t hash = std::hash<ID3D12PipelineState*>()(packet->PipelineState);
+            hash = hash * 31 + std::hash<D3D12_GPU_VIRTUAL_ADDRESS>()(packet->Positions.BufferLocation);
+            hash = hash * 31 + std::hash<D3D12_GPU_VIRTUAL_ADDRESS>()(packet->Indices.BufferLocation);
+            hash = hash * 31 + packet->MaterialId;
+            return hash;
+        }
+    };
+
+    struct SharedStateEqual
+    {
+        bool operator()(const DrawPacket* a, const DrawPacket* b) const
+        {
+            return a->PipelineState == b->PipelineState
+                && memcmp(&a->Positions, &b->Positions, sizeof(a->Positions)) == 0
+                && memcmp(&a->Normals, &b->Normals, sizeof(a->Normals)) == 0
+                && memcmp(&a->Uvs, &b->Uvs, sizeof(a->Uvs)) == 0
+                && memcmp(&a->Indices, &b->Indices, sizeof(a->Indices)) == 0
+                && a->MaterialId == b->MaterialId
+                && a->ColorsIndex == b->ColorsIndex
+                && a->TangentsIndex == b->TangentsIndex
+                && a->VertexOrIndexCount == b->VertexOrIndexCount
+                && a->IsIndexed == b->IsIndexed;
+        }
+    };
+}
+
+InstanceGrouping InstanceGrouping::Build(std::span<const DrawPacket> packets)
+{
+    InstanceGrouping result;
+
+    // The map is only ever used for lookups, so its iteration order (which depends on pointer values) can't affect the result
+    std::unordered_map<const DrawPacket*, uint32_t, SharedStateHash, SharedStateEqual> groupLookup;
+    std::vector<uint32_t> packetGroups(packets.size());
+    for (uint32_t i = 0; i < packets.size(); i++)
+    {
+        auto [it, isNew] = groupLookup.try_emplace(&packets[i], (uint32_t)result.Groups.size());
+        if (isNew)
+        { result.Groups.push_back({ .FirstPacket = i }); }
+
+        packetGroups[i] = it->second;
+        result.Groups[it->second].InstanceCount++;
+    }
+
+    uint32_t firstInstance = 0;
+    for (InstanceGroup& group : result.Groups)
+    {
+        group.FirstInstance = firstInstance;
+        firstInstance += group.InstanceCount;
+    }
+
+    // Scatter the packets into their groups, visiting them in order keeps each group's instances in packet order
+    std::vector<uint32_t> groupCursors(result.Groups.size());
+    result.InstancePackets.resize(packets.size());
+    for (uint32_t i = 0; i < packets.size(); i++)
+    {
+        uint32_t group = packetGroups[i];
+        result.InstancePackets[result.Groups[group].FirstInstance + groupCursors[group]++] = i;
+    }
+
+    return result;
+}
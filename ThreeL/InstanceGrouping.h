@@ -0,0 +1,31 @@
+#pragma once
+#include "DrawList.h"
+
+#include <span>
+#include <vector>
+
+//! A run of draw packets which only differ by the node they belong to
+struct InstanceGroup
+{
+    //! Index of the packet whose state is used to draw the whole group
+    uint32_t FirstPacket;
+
+    //! The range of InstanceGrouping::InstancePackets which make up the group
+    uint32_t FirstInstance;
+    uint32_t InstanceCount;
+};
+
+//! The instances drawn by an InstancedDrawList
+//! Grouping is kept separate from InstancedDrawList (which needs the GPU for its instance buffer) so that it can be tested on its own.
+struct InstanceGrouping
+{
+    std::vector<InstanceGroup> Groups;
+
+    //! Indices of the packets drawn by each instance, ordered by group
+    std::vector<uint32_t> InstancePackets;
+
+    //! Groups packets which share a pipeline state, vertex and index buffers, and per-primitive constants
+    //! Groups are ordered by their first packet and instances keep the relative order of their packets, so the result depends only on the order of the
+    //! packets and the sort order of the list is preserved.
+    static InstanceGrouping Build(std::span<const DrawPacket> packets);
+};
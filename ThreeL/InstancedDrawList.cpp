@@ -0,0 +1,49 @@
+#include "pch.h"
+#include "InstancedDrawList.h"
+
+#include "GraphicsCore.h"
+#include "ResourceManager.h"
+#include "UploadQueue.h"
+
+InstancedDrawList::InstancedDrawList(ResourceManager& resources, const DrawList& drawList, const std::wstring& debugName)
+    : m_Pass(drawList.Pass()), m_PrimitiveCount(drawList.PrimitiveCount()), m_Lods(drawList.Lods().begin(), drawList.Lods().end())
+{
+    std::span<const DrawPacket> sourcePackets = drawList.Packets();
+    m_SourceDrawCount = (uint32_t)sourcePackets.size();
+
+    InstanceGrouping grouping = InstanceGrouping::Build(sourcePackets);
+    m_Groups = std::move(grouping.Groups);
+
+    // The first packet of each group stands in for the whole group, so its node-specific members are meaningless
+    m_Packets.reserve(m_Groups.size());
+    for (const InstanceGroup& group : m_Groups)
+    {
+        DrawPacket packet = sourcePackets[group.FirstPacket];
+        packet.PipelineState = resources.InstancedPipelineState(packet.PipelineState);
+        m_Packets.push_back(packet);
+    }
+
+    std::vector<ShaderInterop::PerInstance> instances;
+    instances.reserve(grouping.InstancePackets.size());
+    m_InstancePrimitives.reserve(grouping.InstancePackets.size());
+    for (uint32_t packetIndex : grouping.InstancePackets)
+    {
+        const DrawPacket& packet = sourcePackets[packetIndex];
+        const ShaderInterop::PerNodeCb& node = drawList.Nodes()[packet.NodeIndex];
+        instances.push_back({ .Transform = node.Transform, .NormalTransform = node.NormalTransform });
+        m_InstancePrimitives.push_back(packet.PrimitiveIndex);
+    }
+
+    if (instances.empty())
+    { return; }
+
+    // The instance buffer is only ever read, so it's left in the common state and implicitly promoted whenever it's used
+    GraphicsCore& graphics = resources.Graphics;
+    std::span<const ShaderInterop::PerInstance> instanceData = instances;
+    PendingUpload pendingUpload = graphics.UploadQueue().AllocateResource(DescribeBufferResource(instanceData.size_bytes()), std::format(L"{} Instance Buffer", debugName));
+    SpanCopy(SpanCast<uint8_t, ShaderInterop::PerInstance>(pendingUpload.StagingBuffer()), instanceData);
+
+    InitiatedUpload upload = pendingUpload.InitiateUpload();
+    graphics.GraphicsQueue().AwaitSyncPoint(upload.SyncPoint);
+    m_Instances = RawGpuResource(std::move(upload.Resource));
+}
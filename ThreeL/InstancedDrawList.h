@@ -0,0 +1,164 @@
+#pragma once
+#include "DrawList.h"
+#include "InstanceGrouping.h"
+#include "RawGpuResource.h"
+#include "ShaderInterop.h"
+
+#include <d3d12.h>
+#include <span>
+#include <string>
+#include <vector>
+
+struct ResourceManager;
+
+//! Automatically instanced counterpart to DrawList
+//! Scene nodes which reference the same glTF mesh share its primitives, so their draws are merged into instanced draws which read node transforms from
+//! a per-instance buffer rather than PerNodeCb. Groups of one are drawn the same way so that the entire list can use the instanced pipeline states.
+class InstancedDrawList
+{
+private:
+    DrawListPass m_Pass;
+    uint32_t m_SourceDrawCount = 0;
+    uint32_t m_PrimitiveCount = 0;
+
+    // One packet per group using the instanced variant of its pipeline state, m_Groups is parallel to this list
+    std::vector<DrawPacket> m_Packets;
+    std::vector<InstanceGroup> m_Groups;
+
+    // DrawPacket::PrimitiveIndex of each instance, used for culling and LOD selection
+    std::vector<uint32_t> m_InstancePrimitives;
+
+    // Copy of DrawList::Lods() for the packets' FirstLod and LodCount
+    std::vector<MeshLod> m_Lods;
+
+    // ShaderInterop::PerInstance for each instance
+    RawGpuResource m_Instances;
+
+    static constexpr uint32_t PerPrimitiveConstantsOffset = offsetof(ShaderInterop::PerNodeCb, MaterialId) / sizeof(uint32_t);
+    static constexpr uint32_t PerPrimitiveConstantsCount = sizeof(ShaderInterop::PerNodeCb) / sizeof(uint32_t) - PerPrimitiveConstantsOffset;
+
+public:
+    //! The draw list does not need to outlive the instanced draw list
+    InstancedDrawList(ResourceManager& resources, const DrawList& drawList, const std::wstring& debugName);
+    InstancedDrawList(const InstancedDrawList&) = delete;
+
+    inline DrawListPass Pass() const { return m_Pass; }
+    inline std::span<const DrawPacket> Packets() const { return m_Packets; }
+
+    //! The number of draws issued by the source DrawList versus this one when nothing is culled
+    inline uint32_t SourceDrawCount() const { return m_SourceDrawCount; }
+    inline uint32_t DrawCount() const { return (uint32_t)m_Packets.size(); }
+
+    inline std::vector<DrawListChunk> Chunks(uint32_t maxChunkCount, uint32_t minChunkSize) const
+    { return DrawList::Chunks(m_Packets, maxChunkCount, minChunkSize); }
+
+    //! Records the draws to the specified command list, see DrawList::Submit
+    //! Groups which are partially culled or use several LODs are drawn with one draw per run of consecutive visible instances using the same LOD.
+    //! Cluster culling is not supported since every instance would end up with its own set of index ranges, clusterDraws must be null.
+    template<typename TCommandList>
+    DrawListStatistics Submit(TCommandList* commandList, DrawListChunk chunk, std::span<const uint8_t> primitiveVisibility = { }, std::span<const uint8_t> primitiveLods = { }, const ClusterDrawSet* clusterDraws = nullptr) const;
+
+    template<typename TCommandList>
+    inline DrawListStatistics Submit(TCommandList* commandList, std::span<const uint8_t> primitiveVisibility = { }, std::span<const uint8_t> primitiveLods = { }, const ClusterDrawSet* clusterDraws = nullptr) const
+    { return Submit(commandList, DrawListChunk { 0, (uint32_t)m_Packets.size() }, primitiveVisibility, primitiveLods, clusterDraws); }
+};
+
+template<typename TCommandList>
+DrawListStatistics InstancedDrawList::Submit(TCommandList* commandList, DrawListChunk chunk, std::span<const uint8_t> primitiveVisibility, std::span<const uint8_t> primitiveLods, const ClusterDrawSet* clusterDraws) const
+{
+    Assert(chunk.First + chunk.Count <= m_Packets.size());
+    Assert(primitiveVisibility.empty() || primitiveVisibility.size() == m_PrimitiveCount);
+    Assert(primitiveLods.empty() || primitiveLods.size() == m_PrimitiveCount);
+    Assert(clusterDraws == nullptr && "Instanced draw lists can't be cluster culled.");
+
+    DrawListStatistics statistics = { };
+    const bool bindNormals = m_Pass != DrawListPass::DepthPrePass;
+
+    auto IsVisible = [&](uint32_t instance) { return primitiveVisibility.empty() || primitiveVisibility[m_InstancePrimitives[instance]] != 0; };
+    auto InstanceLod = [&](uint32_t instance) -> uint32_t { return primitiveLods.empty() ? 0 : primitiveLods[m_InstancePrimitives[instance]]; };
+
+    const DrawPacket* previous = nullptr;
+    const D3D12_INDEX_BUFFER_VIEW* boundIndices = nullptr;
+
+    for (uint32_t i = chunk.First; i < chunk.First + chunk.Count; i++)
+    {
+        const DrawPacket& packet = m_Packets[i];
+        const InstanceGroup& group = m_Groups[i];
+
+        uint32_t instance = group.FirstInstance;
+        const uint32_t endInstance = group.FirstInstance + group.InstanceCount;
+        while (instance < endInstance && !IsVisible(instance))
+        { instance++; }
+
+        if (instance == endInstance)
+        { continue; }
+
+        if (previous == nullptr || packet.PipelineState != previous->PipelineState)
+        {
+            commandList->SetPipelineState(packet.PipelineState);
+            statistics.PipelineStateChanges++;
+        }
+
+        auto SetVertexBuffer = [&](UINT slot, const D3D12_VERTEX_BUFFER_VIEW& view, const D3D12_VERTEX_BUFFER_VIEW* previousView)
+            {
+                if (previousView != nullptr && memcmp(&view, previousView, sizeof(view)) == 0)
+                { return; }
+
+                commandList->IASetVertexBuffers(slot, 1, &view);
+                statistics.VertexBufferChanges++;
+            };
+
+        SetVertexBuffer(MeshInputSlot::Position, packet.Positions, previous == nullptr ? nullptr : &previous->Positions);
+        if (bindNormals)
+        { SetVertexBuffer(MeshInputSlot::Normal, packet.Normals, previous == nullptr ? nullptr : &previous->Normals); }
+        SetVertexBuffer(MeshInputSlot::Uv0, packet.Uvs, previous == nullptr ? nullptr : &previous->Uvs);
+
+        // Transforms come from the instance buffer, so only the per-primitive tail of the constants is ever set
+        if (previous == nullptr || packet.MaterialId != previous->MaterialId || packet.ColorsIndex != previous->ColorsIndex || packet.TangentsIndex != previous->TangentsIndex)
+        {
+            uint32_t perPrimitive[] = { packet.MaterialId, packet.ColorsIndex, packet.TangentsIndex };
+            static_assert(std::size(perPrimitive) == PerPrimitiveConstantsCount);
+            commandList->SetGraphicsRoot32BitConstants(ShaderInterop::Pbr::RpPerNodeCb, PerPrimitiveConstantsCount, perPrimitive, PerPrimitiveConstantsOffset);
+            statistics.RootConstantChanges++;
+        }
+
+        // SV_InstanceID doesn't include the start instance location, so each run of visible instances gets the instance buffer bound at its first instance
+        while (instance < endInstance)
+        {
+            uint32_t lod = InstanceLod(instance);
+            uint32_t runEnd = instance + 1;
+            while (runEnd < endInstance && IsVisible(runEnd) && InstanceLod(runEnd) == lod)
+            { runEnd++; }
+
+            uint32_t runLength = runEnd - instance;
+            commandList->SetGraphicsRootShaderResourceView(ShaderInterop::Pbr::RpInstanceBuffer, m_Instances.GpuAddress() + instance * sizeof(ShaderInterop::PerInstance));
+            statistics.InstanceBufferChanges++;
+
+            if (packet.IsIndexed)
+            {
+                auto [indices, indexCount] = DrawList::LodIndices(m_Lods, packet, lod);
+                if (boundIndices == nullptr || memcmp(indices, boundIndices, sizeof(*indices)) != 0)
+                {
+                    commandList->IASetIndexBuffer(indices);
+                    boundIndices = indices;
+                    statistics.IndexBufferChanges++;
+                }
+
+                commandList->DrawIndexedInstanced(indexCount, runLength, 0, 0, 0);
+            }
+            else
+            { commandList->DrawInstanced(packet.VertexOrIndexCount, runLength, 0, 0); }
+
+            statistics.DrawCount++;
+            statistics.InstanceCount += runLength;
+
+            instance = runEnd;
+            while (instance < endInstance && !IsVisible(instance))
+            { instance++; }
+        }
+
+        previous = &packet;
+    }
+
+    return statistics;
+}
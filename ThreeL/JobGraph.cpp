@@ -0,0 +1,131 @@
+#include "pch.h"
+#include "JobGraph.h"
+
+#include "JobSystem.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <queue>
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    inline double SecondsSince(Clock::time_point start)
+    { return std::chrono::duration<double>(Clock::now() - start).count(); }
+}
+
+JobId JobGraph::Add(std::string name, std::span<const JobId> dependencies, Job job)
+{
+    JobId id = (JobId)m_Nodes.size();
+    for (JobId dependency : dependencies)
+    {
+        Assert(dependency < id && "Jobs can only depend on jobs which were added before them.");
+        m_Nodes[dependency].Dependents.push_back(id);
+    }
+
+    m_Nodes.push_back({ .Name = std::move(name), .Function = std::move(job), .DependencyCount = (uint32_t)dependencies.size() });
+    return id;
+}
+
+JobGraphResult JobGraph::Run(JobSystem& jobs) const
+{
+    const uint32_t jobCount = (uint32_t)m_Nodes.size();
+    Clock::time_point runStart = Clock::now();
+
+    JobGraphResult result =
+    {
+        .Statuses = std::vector<JobStatus>(jobCount, JobStatus::Succeeded),
+        .Seconds = std::vector<double>(jobCount, 0.0),
+    };
+
+    // The following are protected by lock
+    std::mutex lock;
+    std::condition_variable stateChanged;
+    std::vector<uint32_t> remainingDependencies(jobCount);
+    std::vector<bool> hasFailedDependency(jobCount, false);
+    std::priority_queue<JobId, std::vector<JobId>, std::greater<JobId>> readyJobs;
+    std::vector<std::optional<std::string>> errors(jobCount);
+    uint32_t completedJobCount = 0;
+
+    for (JobId i = 0; i < jobCount; i++)
+    {
+        remainingDependencies[i] = m_Nodes[i].DependencyCount;
+        if (remainingDependencies[i] == 0)
+        { readyJobs.push(i); }
+    }
+
+    // Must be called with the lock held, skipped jobs are completed immediately so their dependents are released (and skipped) along with them
+    auto Complete = [&](JobId completedJob)
+        {
+            std::vector<JobId> completedJobs = { completedJob };
+            while (!completedJobs.empty())
+            {
+                JobId job = completedJobs.back();
+                completedJobs.pop_back();
+                completedJobCount++;
+
+                for (JobId dependent : m_Nodes[job].Dependents)
+                {
+                    if (result.Statuses[job] != JobStatus::Succeeded)
+                    { hasFailedDependency[dependent] = true; }
+
+                    if (--remainingDependencies[dependent] > 0)
+                    { continue; }
+
+                    if (hasFailedDependency[dependent])
+                    {
+                        result.Statuses[dependent] = JobStatus::Skipped;
+                        completedJobs.push_back(dependent);
+                    }
+                    else
+                    { readyJobs.push(dependent); }
+                }
+            }
+        };
+
+    // Every thread pulls ready jobs until the whole graph has completed
+    jobs.ParallelFor(jobs.WorkerCount() + 1, [&](uint32_t threadIndex)
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            while (true)
+            {
+                stateChanged.wait(guard, [&]() { return !readyJobs.empty() || completedJobCount == jobCount; });
+                if (readyJobs.empty())
+                { return; }
+
+                JobId job = readyJobs.top();
+                readyJobs.pop();
+                guard.unlock();
+
+                JobContext context = { .ThreadIndex = threadIndex };
+                Clock::time_point jobStart = Clock::now();
+                m_Nodes[job].Function(context);
+                double seconds = SecondsSince(jobStart);
+
+                guard.lock();
+                result.Seconds[job] = seconds;
+                if (context.Error.has_value())
+                {
+                    result.Statuses[job] = JobStatus::Failed;
+                    errors[job] = std::move(context.Error);
+                }
+
+                Complete(job);
+                stateChanged.notify_all();
+            }
+        });
+
+    Assert(completedJobCount == jobCount);
+
+    for (JobId i = 0; i < jobCount; i++)
+    {
+        if (errors[i].has_value())
+        { result.Errors.push_back({ .Job = i, .Message = std::move(*errors[i]) }); }
+    }
+
+    result.TotalSeconds = SecondsSince(runStart);
+    return result;
+}
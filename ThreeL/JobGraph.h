@@ -0,0 +1,88 @@
+#pragma once
+#include <functional>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+class JobSystem;
+
+using JobId = uint32_t;
+
+//! Passed to each job in a JobGraph
+struct JobContext
+{
+    //! Index of the thread running the job in [0, JobSystem::WorkerCount()]
+    //! No two jobs with the same thread index ever run at the same time, so it can be used to pick per-thread resources.
+    uint32_t ThreadIndex;
+
+    //! Setting an error fails the job, which causes every job which depends on it (directly or indirectly) to be skipped
+    std::optional<std::string> Error;
+};
+
+enum class JobStatus
+{
+    Succeeded,
+    Failed,
+    Skipped, //!< A job this job depends on failed or was skipped
+};
+
+struct JobError
+{
+    JobId Job;
+    std::string Message;
+};
+
+//! The outcome of JobGraph::Run, indexed by JobId
+struct JobGraphResult
+{
+    std::vector<JobStatus> Statuses;
+
+    //! Time spent running each job, skipped jobs have a time of 0
+    std::vector<double> Seconds;
+
+    //! Time from the start of the run until every job completed
+    double TotalSeconds;
+
+    //! Errors of the failed jobs in the order the jobs were added rather than the order they failed in, so they're reported the same way every run
+    std::vector<JobError> Errors;
+
+    inline bool Succeeded() const { return Errors.empty(); }
+};
+
+//! A set of jobs with dependencies between them which are run across a JobSystem
+//! Each job starts as soon as everything it depends on has completed. When several jobs are ready the one which was added first is started first.
+//! Jobs can only depend on jobs which were added before them, so the graph can never contain a cycle.
+class JobGraph
+{
+public:
+    using Job = std::function<void(JobContext& context)>;
+
+private:
+    struct Node
+    {
+        std::string Name;
+        Job Function;
+        std::vector<JobId> Dependents;
+        uint32_t DependencyCount;
+    };
+
+    std::vector<Node> m_Nodes;
+
+public:
+    JobGraph() = default;
+    JobGraph(const JobGraph&) = delete;
+
+    //! Adds a job which will run once every one of its dependencies has succeeded
+    JobId Add(std::string name, std::span<const JobId> dependencies, Job job);
+
+    inline JobId Add(std::string name, std::initializer_list<JobId> dependencies, Job job)
+    { return Add(std::move(name), std::span<const JobId>(dependencies.begin(), dependencies.size()), std::move(job)); }
+
+    inline uint32_t JobCount() const { return (uint32_t)m_Nodes.size(); }
+    inline const std::string& Name(JobId job) const { return m_Nodes[job].Name; }
+
+    //! Runs every job in the graph, returning once all of them have either completed or been skipped
+    //! Uses JobSystem::ParallelFor, so the same restrictions on reentrancy apply. A graph may be run more than once.
+    JobGraphResult Run(JobSystem& jobs) const;
+};
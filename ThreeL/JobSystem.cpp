@@ -0,0 +1,108 @@
+#include "pch.h"
+#include "JobSystem.h"
+
+JobSystem::JobSystem(uint32_t workerCount)
+{
+    m_Workers.reserve(workerCount);
+    for (uint32_t i = 0; i < workerCount; i++)
+    {
+        m_Workers.emplace_back([this]() { WorkerMain(); });
+        SetThreadDescription(m_Workers.back().native_handle(), std::format(L"ThreeL Job Worker #{}", i + 1).c_str());
+    }
+}
+
+uint32_t JobSystem::DefaultWorkerCount()
+{
+    // hardware_concurrency is allowed to return 0 when it doesn't know
+    uint32_t hardwareThreads = std::thread::hardware_concurrency();
+    return hardwareThreads > 1 ? hardwareThreads - 1 : 0;
+}
+
+void JobSystem::ParallelFor(uint32_t jobCount, const std::function<void(uint32_t)>& job)
+{
+    // Don't bother waking the workers when there's nothing to distribute
+    if (m_Workers.empty() || jobCount <= 1)
+    {
+        for (uint32_t i = 0; i < jobCount; i++)
+        { job(i); }
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_Lock);
+        Assert(m_Job == nullptr && "ParallelFor is not reentrant!");
+        m_Job = &job;
+        m_JobCount = jobCount;
+        m_FinishedJobCount = 0;
+        m_NextJob = 0;
+        m_Generation++;
+    }
+    m_WorkAvailable.notify_all();
+
+    uint32_t finishedJobCount = RunJobs(job, jobCount);
+
+    // Wait for the remaining jobs and for every worker to let go of the job before it goes out of scope
+    std::unique_lock<std::mutex> lock(m_Lock);
+    m_FinishedJobCount += finishedJobCount;
+    m_WorkFinished.wait(lock, [&]() { return m_FinishedJobCount == jobCount && m_ActiveWorkerCount == 0; });
+    m_Job = nullptr;
+}
+
+uint32_t JobSystem::RunJobs(const std::function<void(uint32_t)>& job, uint32_t jobCount)
+{
+    uint32_t finishedJobCount = 0;
+    for (uint32_t i = m_NextJob++; i < jobCount; i = m_NextJob++)
+    {
+        job(i);
+        finishedJobCount++;
+    }
+
+    return finishedJobCount;
+}
+
+void JobSystem::WorkerMain()
+{
+    uint64_t lastGeneration = 0;
+    while (true)
+    {
+        const std::function<void(uint32_t)>* job;
+        uint32_t jobCount;
+        {
+            std::unique_lock<std::mutex> lock(m_Lock);
+            m_WorkAvailable.wait(lock, [&]() { return m_IsShuttingDown || m_Generation != lastGeneration; });
+
+            if (m_IsShuttingDown)
+            { return; }
+
+            // If we woke up late the job might've already been completed by everyone else
+            lastGeneration = m_Generation;
+            if (m_Job == nullptr)
+            { continue; }
+
+            job = m_Job;
+            jobCount = m_JobCount;
+            m_ActiveWorkerCount++;
+        }
+
+        uint32_t finishedJobCount = RunJobs(*job, jobCount);
+
+        {
+            std::lock_guard<std::mutex> lock(m_Lock);
+            m_FinishedJobCount += finishedJobCount;
+            m_ActiveWorkerCount--;
+        }
+        m_WorkFinished.notify_all();
+    }
+}
+
+JobSystem::~JobSystem()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_Lock);
+        m_IsShuttingDown = true;
+    }
+    m_WorkAvailable.notify_all();
+
+    for (std::thread& worker : m_Workers)
+    { worker.join(); }
+}
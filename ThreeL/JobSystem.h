@@ -0,0 +1,49 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//! A minimal pool of worker threads for splitting per-frame work (such as command list recording) across cores
+class JobSystem
+{
+private:
+    std::vector<std::thread> m_Workers;
+
+    std::mutex m_Lock;
+    std::condition_variable m_WorkAvailable;
+    std::condition_variable m_WorkFinished;
+
+    // The following are protected by m_Lock
+    const std::function<void(uint32_t)>* m_Job = nullptr;
+    uint32_t m_JobCount = 0;
+    uint32_t m_FinishedJobCount = 0;
+    uint32_t m_ActiveWorkerCount = 0;
+    uint64_t m_Generation = 0;
+    bool m_IsShuttingDown = false;
+
+    std::atomic<uint32_t> m_NextJob = 0;
+
+public:
+    //! Creates a job system with the specified number of worker threads, by default one less than the number of hardware threads
+    //! (The thread which calls ParallelFor participates in running jobs, so it's counted as the remaining worker.)
+    explicit JobSystem(uint32_t workerCount = DefaultWorkerCount());
+    JobSystem(const JobSystem&) = delete;
+
+    static uint32_t DefaultWorkerCount();
+
+    inline uint32_t WorkerCount() const { return (uint32_t)m_Workers.size(); }
+
+    //! Runs job(i) for every i in [0, jobCount) across the worker threads and the calling thread, returning once all of them have completed
+    //! Jobs may run in any order. ParallelFor is not reentrant and must only be called from one thread at a time.
+    void ParallelFor(uint32_t jobCount, const std::function<void(uint32_t)>& job);
+
+private:
+    uint32_t RunJobs(const std::function<void(uint32_t)>& job, uint32_t jobCount);
+    void WorkerMain();
+
+public:
+    ~JobSystem();
+};
@@ -14,7 +14,7 @@ namespace
     extern const uint16_t LightSphereIndices[360];
 }
 
-LightLinkedList::LightLinkedList(ResourceManager& resources, uint2 initialSize)
+LightLinkedList::LightLinkedList(ResourceManager& resources)
     : m_Resources(resources)
 {
     GraphicsCore& graphics = m_Resources.Graphics;
@@ -24,21 +24,17 @@ LightLinkedList::LightLinkedList(ResourceManager& resources, uint2 initialSize)
     m_LightSphereVertices = m_Resources.MeshHeap.AllocateVertexBuffer(LightSphereVertices, sizeof(LightSphereVertices), sizeof(float3));
 
     // Create light links heap and counter
-    ComPtr<ID3D12Resource> lightLinksHeap;
-
-    D3D12_HEAP_PROPERTIES heapProperties = { D3D12_HEAP_TYPE_DEFAULT };
+    // Light links are only ever read after being linked into the (cleared) first light link buffer, so neither buffer needs to start zeroed
     D3D12_RESOURCE_DESC resourceDescription = DescribeBufferResource(ShaderInterop::SizeOfLightLink * MAX_LIGHT_LINKS, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
-
-    AssertSuccess(graphics.Device()->CreateCommittedResource
+    ComPtr<ID3D12Resource> lightLinksHeap = graphics.GpuMemoryManager().CreateResource
     (
-        &heapProperties,
-        D3D12_HEAP_FLAG_NONE,
-        &resourceDescription,
+        GpuMemoryCategory::LightLinkedList,
+        D3D12_HEAP_TYPE_DEFAULT,
+        D3D12_HEAP_FLAG_CREATE_NOT_ZEROED,
+        resourceDescription,
         D3D12_RESOURCE_STATE_COMMON,
-        nullptr,
-        IID_PPV_ARGS(&lightLinksHeap)
-    ));
-    lightLinksHeap->SetName(L"LightLinkedList LightLinksHeap");
+        L"LightLinkedList LightLinksHeap"
+    );
 
     m_LightLinksCounter = UavCounter(graphics, L"LightLinkedList LightLinksHeap (Counter)");
 
@@ -75,24 +71,32 @@ LightLinkedList::LightLinkedList(ResourceManager& resources, uint2 initialSize)
 
     m_LightLinksHeap = RawGpuResource(std::move(lightLinksHeap));
 
-    // Allocate the descriptors for the first light link buffer and "resize" to allocate the actual buffer
+    // Allocate the descriptors for the first light link buffer, the actual buffer is placed by the render graph
     m_FirstLightLinkBufferUav = graphics.ResourceDescriptorManager().AllocateDynamicDescriptor();
     m_FirstLightLinkBufferSrv = graphics.ResourceDescriptorManager().AllocateDynamicDescriptor();
-    Resize(initialSize);
 }
 
-void LightLinkedList::Resize(uint2 size)
+D3D12_RESOURCE_DESC LightLinkedList::DescribeFirstLightLinkBuffer(uint2 fullScreenSize, uint32_t lllBufferShift)
 {
-    ComPtr<ID3D12Resource> firstLightLink;
+    uint2 size = ScreenSizeToLllBufferSize(fullScreenSize, lllBufferShift);
+    return DescribeBufferResource(size.x * size.y * sizeof(uint32_t), D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
+}
 
-    // Allocate the first light link buffer
-    D3D12_HEAP_PROPERTIES heapProperties = { D3D12_HEAP_TYPE_DEFAULT };
-    D3D12_RESOURCE_DESC resourceDescription = DescribeBufferResource(size.x * size.y * sizeof(uint32_t), D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
+void LightLinkedList::PlaceFirstLightLinkBuffer(const D3D12_RESOURCE_DESC& resourceDescription, ID3D12Heap* heap, uint64_t heapOffset)
+{
+    // Release the old buffer if we have one
+    m_FirstLightLinkBuffer = RawGpuResource();
 
-    AssertSuccess(m_Resources.Graphics.Device()->CreateCommittedResource
+    if (heap == nullptr)
+    { return; }
+
+    // Allocate the first light link buffer
+    // (It's cleared every frame before it's used, so it doesn't matter that placed resources start out with garbage.)
+    ComPtr<ID3D12Resource> firstLightLink;
+    AssertSuccess(m_Resources.Graphics.Device()->CreatePlacedResource
     (
-        &heapProperties,
-        D3D12_HEAP_FLAG_NONE,
+        heap,
+        heapOffset,
         &resourceDescription,
         D3D12_RESOURCE_STATE_COMMON,
         nullptr,
@@ -148,9 +152,7 @@ void LightLinkedList::FillLights
     Assert((lightLinkedListBufferSize == depthBuffer.Size()).All() && "Light linked list buffer size and depth buffer size must match!");
 
     // Transition resources to their required states
-    // (Depth buffer cannot be allowed to implicitly promote as it'll only implicitly promote to PIXEL_SHADER_RESOURCE or DEPTH_READ but not both.)
-    context.TransitionResource(depthBuffer, D3D12_RESOURCE_STATE_DEPTH_READ | D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
-    context.TransitionResource(m_FirstLightLinkBuffer, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+    // (The depth buffer and first light link buffer are render graph transients, the graph transitions them for us.)
     context.TransitionResource(m_LightLinksHeap, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
 
     // Reset light buffers
@@ -181,7 +183,6 @@ void LightLinkedList::FillLights
 
     // Flush UAV writes and transition resources to be read for lighting
     context.UavBarrier();
-    context.TransitionResource(m_FirstLightLinkBuffer, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
     context.TransitionResource(m_LightLinksHeap, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
 }
 
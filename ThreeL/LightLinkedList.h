@@ -30,9 +30,8 @@ private:
     D3D12_INDEX_BUFFER_VIEW m_LightSphereIndices;
     D3D12_VERTEX_BUFFER_VIEW m_LightSphereVertices;
 
-    // RWByteAddressBuffer of ScreenW*ScreenH*4 bytes -- Each entry is the index of the first light link for that pixel
-    // In a more realistic implementation you'd want to restrict this to the downsampled light buffer size you're using (IE: 1/8th in the original presentation.)
-    // We allow configuring the light buffer size at runtime for the sake of experimentation, so we always allocate full-size
+    // RWByteAddressBuffer of LllBufferW*LllBufferH*4 bytes -- Each entry is the index of the first light link for that pixel
+    // This is a render graph transient sized for the current light buffer shift, see PlaceFirstLightLinkBuffer
     RawGpuResource m_FirstLightLinkBuffer;
     //TODO: Could remove these are they aren't actually being used anymore since I went with root descriptors for this buffer
     DynamicResourceDescriptor m_FirstLightLinkBufferUav;
@@ -49,15 +48,19 @@ private:
     UavCounter m_LightLinksCounter;
 
 public:
-    //! The size specified is expected to be the full screen resolution, not the reduced resolution
-    explicit LightLinkedList(ResourceManager& resources, uint2 initialSize);
+    //! The first light link buffer has no memory until it's placed with PlaceFirstLightLinkBuffer
+    explicit LightLinkedList(ResourceManager& resources);
     LightLinkedList(const LightLinkedList&) = delete;
 
-    //! Resizes the per-pixel first link buffer
-    //! The size specified is expected to be the full screen resolution, not the reduced resolution
+    //! Describes the per-pixel first link buffer for the specified light buffer size
+    static D3D12_RESOURCE_DESC DescribeFirstLightLinkBuffer(uint2 fullScreenSize, uint32_t lllBufferShift);
+
+    //! Recreates the per-pixel first link buffer as a placed resource, or releases it when heap is null
+    //! The description must come from DescribeFirstLightLinkBuffer
     //! Caller asserts that this resource is no longer in use on the GPU
-    void Resize(uint2 size);
+    void PlaceFirstLightLinkBuffer(const D3D12_RESOURCE_DESC& description, ID3D12Heap* heap, uint64_t heapOffset);
 
+    //! Expects the depth buffer to be readable as a depth buffer and shader resource, and the first light link buffer to be in the UAV state
     void FillLights
     (
         GraphicsContext& context,
@@ -80,6 +83,7 @@ public:
     inline D3D12_GPU_DESCRIPTOR_HANDLE LightLinksHeapSrv() const { return m_LightLinksHeapSrv.ResidentHandle(); }
     inline D3D12_GPU_VIRTUAL_ADDRESS LightLinksHeapGpuAddress() const { return m_LightLinksHeap.GpuAddress(); }
     inline D3D12_GPU_VIRTUAL_ADDRESS FirstLightLinkBufferGpuAddress() const { return m_FirstLightLinkBuffer.GpuAddress(); }
+    inline GpuResource& FirstLightLinkBuffer() { return m_FirstLightLinkBuffer; }
 
     static inline uint2 ScreenSizeToLllBufferSize(uint2 fullScreenSize, uint32_t lllBufferShift)
     {
@@ -2,24 +2,35 @@
 
 #include "AssetLoading.h"
 #include "BackBuffer.h"
+#include "BoundingVolumeHierarchy.h"
 #include "CameraController.h"
 #include "CameraInput.h"
+#include "ClusterCuller.h"
 #include "CommandQueue.h"
 #include "ComputeContext.h"
 #include "DearImGui.h"
 #include "DebugLayer.h"
 #include "DepthStencilBuffer.h"
+#include "DrawList.h"
+#include "FrameConstantAllocator.h"
 #include "FrameStatistics.h"
+#include "GpuRenderGraph.h"
 #include "GraphicsContext.h"
 #include "GraphicsCore.h"
+#include "IndirectDrawList.h"
+#include "InstancedDrawList.h"
+#include "JobSystem.h"
 #include "LightHeap.h"
 #include "LightLinkedList.h"
+#include "OcclusionRasterizer.h"
 #include "ParticleSystem.h"
 #include "ParticleSystemDefinition.h"
 #include "ResourceManager.h"
 #include "Scene.h"
+#include "SceneOccluders.h"
 #include "ShaderInterop.h"
 #include "Stopwatch.h"
+#include "TransparentDrawList.h"
 #include "SwapChain.h"
 #include "Ui.h"
 #include "Utilities.h"
@@ -40,9 +51,18 @@ struct DebugSettings
     LightLinkedListDebugMode OverlayMode = LightLinkedListDebugMode::None;
     float OverlayAlpha = 0.25f;
     bool AnimateLights = true;
+    bool GpuDrivenScene = false;
+    bool CpuFrustumCulling = true;
+    bool CpuOcclusionCulling = true;
+    bool AutoInstancing = true;
+    bool MeshLods = true;
+    float LodPixelError = 1.f;
+    bool ClusterCulling = false;
+    int SceneRecordingThreads = 0; // 0 = Use every available thread
 };
 
-static int MainImpl()
+//! timingExportPath is where the timing history is exported when the app exits, null to skip exporting
+static int MainImpl(const char* timingExportPath)
 {
     // Set working directory to app directory so we can easily get at our assets
     SetWorkingDirectoryToAppDirectory();
@@ -65,7 +85,8 @@ static int MainImpl()
 
     SwapChain swapChain(graphics, window);
 
-    ResourceManager resources(graphics);
+    JobSystem jobs;
+    ResourceManager resources(graphics, jobs);
 
     //-----------------------------------------------------------------------------------------------------------------
     // Load glTF model
@@ -73,23 +94,66 @@ static int MainImpl()
     Scene scene = LoadGltfScene
     (
         resources,
+        jobs,
         // Sponza isn't centered for some reason, so we manually center it on the XZ plane to make spawning random lights easier
         "Assets/Sponza/Sponza.gltf", float4x4::MakeTranslation(0.531749f, 0.f, 0.253336f)
     );
     printf("Done.\n");
 
+    // The scene is static, so its draws are flattened and sorted once up-front
+    DrawList depthPrePassDraws(resources, scene, DrawListPass::DepthPrePass);
+    DrawList opaqueDraws(resources, scene, DrawListPass::Opaque);
+    DrawList opaqueLightDebugDraws(resources, scene, DrawListPass::OpaqueLightDebug);
+
+    // Transparent primitives have to be drawn back to front, so their list is re-sorted every frame
+    TransparentDrawList transparentDraws(DrawList(resources, scene, DrawListPass::Transparent));
+    printf("Scene has %u transparent draws.\n", (uint32_t)transparentDraws.Packets().size());
+
+    // GPU-driven equivalents of the above, see DebugSettings::GpuDrivenScene
+    IndirectDrawList depthPrePassIndirectDraws(resources, depthPrePassDraws, L"Depth Pre-pass");
+    IndirectDrawList opaqueIndirectDraws(resources, opaqueDraws, L"Opaque");
+    IndirectDrawList opaqueLightDebugIndirectDraws(resources, opaqueLightDebugDraws, L"Opaque Light Debug");
+
+    // Automatically instanced equivalents of the above, see DebugSettings::AutoInstancing
+    InstancedDrawList depthPrePassInstancedDraws(resources, depthPrePassDraws, L"Depth Pre-pass");
+    InstancedDrawList opaqueInstancedDraws(resources, opaqueDraws, L"Opaque");
+    InstancedDrawList opaqueLightDebugInstancedDraws(resources, opaqueLightDebugDraws, L"Opaque Light Debug");
+    printf("Auto-instancing reduced %u scene draws to %u.\n", opaqueInstancedDraws.SourceDrawCount(), opaqueInstancedDraws.DrawCount());
+
+    // Hierarchy and occluders used to cull the draw lists on the CPU, see DebugSettings::CpuFrustumCulling and DebugSettings::CpuOcclusionCulling
+    // (All of the draw lists are built from the same scene, so they number primitives the same way and can share visibility.)
+    // (Transparent primitives are skipped by the opaque lists, so their bounds are filled in separately.)
+    std::vector<BoundingBox> scenePrimitiveBounds = depthPrePassDraws.PrimitiveBounds();
+    for (const DrawPacket& packet : transparentDraws.Packets())
+    { scenePrimitiveBounds[packet.PrimitiveIndex] = BoundingBox::FromCenterExtents(packet.BoundsCenter, packet.BoundsExtents); }
+    BoundingVolumeHierarchy sceneBvh(scenePrimitiveBounds);
+    std::vector<uint32_t> visibleScenePrimitives;
+    std::vector<uint8_t> scenePrimitiveVisibility(depthPrePassDraws.PrimitiveCount());
+
+    // LODs are likewise selected once for all of the draw lists, see DebugSettings::MeshLods
+    // (This also guarantees the depth pre-pass and opaque pass draw the same geometry, which the opaque pass's equal depth test relies on.)
+    std::vector<uint8_t> scenePrimitiveLods(depthPrePassDraws.PrimitiveCount());
+
+    // Meshlets of the full detail primitives which survive culling are drawn as ranges of their index buffers, see DebugSettings::ClusterCulling
+    ClusterCuller clusterCuller;
+
+    OccluderGeometry sceneOccluders = SelectSceneOccluders(scene, 16384);
+    OcclusionRasterizer occlusionRasterizer(320, 192);
+    printf("Selected %u occluder triangles.\n", sceneOccluders.TriangleCount());
+
     //-----------------------------------------------------------------------------------------------------------------
     // Allocate depth buffers
     //-----------------------------------------------------------------------------------------------------------------
+    // Depth buffers are render graph transients, so their memory is placed by the graph each frame
     uint2 screenSize = swapChain.Size();
     float2 screenSizeF = (float2)screenSize;
-    DepthStencilBuffer depthBuffer(graphics, L"Depth Buffer", screenSize, DEPTH_BUFFER_FORMAT);
+    DepthStencilBuffer depthBuffer(graphics, L"Depth Buffer", DEPTH_BUFFER_FORMAT);
 
     std::vector<DepthStencilBuffer> downsampledDepthBuffers;
-    for (int div = 2, shift = 1; div <= 16; div *= 2, shift++)
+    for (int div = 2; div <= 16; div *= 2)
     {
         std::wstring name = std::format(L"Depth Buffer (1/{})", div);
-        downsampledDepthBuffers.emplace_back(graphics, name, LightLinkedList::ScreenSizeToLllBufferSize(screenSize, shift), DEPTH_BUFFER_FORMAT);
+        downsampledDepthBuffers.emplace_back(graphics, name, DEPTH_BUFFER_FORMAT);
     }
 
     //-----------------------------------------------------------------------------------------------------------------
@@ -101,7 +165,7 @@ static int MainImpl()
     std::vector<ShaderInterop::LightInfo> lights;
     lights.reserve(LightHeap::MAX_LIGHTS);
 
-    LightLinkedList lightLinkedList(resources, screenSize);
+    LightLinkedList lightLinkedList(resources);
     uint32_t lightLinkedListShift = 3; // 0 = 1/1, 1 = 1/2, 2 = 1/4, 3 = 1/8
     uint32_t lightLinkLimit = LightLinkedList::MAX_LIGHT_LINKS;
 
@@ -215,9 +279,11 @@ static int MainImpl()
     // Start the camera in a sensible location for Sponza
     camera.WarpTo(float3(4.35f, 1.f, 0.f), 0.f, Math::HalfPi);
 
-    // Per-frame constant buffer
-    // This is a pretty heavyweight abstraction for a constant buffer, ideally we should have a little bump allocator for this sort of thing
-    FrequentlyUpdatedResource perFrameCbResource(graphics, DescribeBufferResource(sizeof(ShaderInterop::PerFrameCb)), L"Per-frame constant buffer");
+    // Constants which only live for a single frame
+    FrameConstantAllocator frameConstants(graphics, 1024 * 1024, L"Frame constants");
+
+    // The frame's passes are declared every frame, and the graph places the screen-sized resources they use in memory it shares between them
+    GpuRenderGraph renderGraph(graphics);
 
     // User interface
     DearImGui dearImGui(graphics, window);
@@ -315,6 +381,41 @@ static int MainImpl()
             context->SetGraphicsRootDescriptorTable(ShaderInterop::Pbr::RpBindlessHeap, graphics.ResourceDescriptorManager().GpuHeap()->GetGPUDescriptorHandleForHeapStart());
         };
 
+    // Scene draw lists are split into chunks which are recorded in parallel on their own command lists
+    // bindPassState is responsible for setting up everything a chunk's command list needs before drawing (IE: render targets and the PBR root signature)
+    // drawList may be either a DrawList or an InstancedDrawList (in which case clusterDraws must be null)
+    auto SubmitDrawList = [&](GraphicsContext& context, const auto& drawList, std::span<const uint8_t> primitiveVisibility, std::span<const uint8_t> primitiveLods, const ClusterDrawSet* clusterDraws, const std::function<void(GraphicsContext&)>& bindPassState)
+        {
+            // Recording a chunk has a fixed cost for renting and setting up a command list, so we don't split lists too finely
+            const uint32_t minChunkSize = 32;
+            uint32_t threadCount = debugSettings.SceneRecordingThreads > 0 ? (uint32_t)debugSettings.SceneRecordingThreads : jobs.WorkerCount() + 1;
+            std::vector<DrawListChunk> chunks = drawList.Chunks(threadCount, minChunkSize);
+
+            if (chunks.size() == 1)
+            {
+                bindPassState(context);
+                context.FlushResourceBarriers();
+                drawList.Submit(context.CommandList(), primitiveVisibility, primitiveLods, clusterDraws);
+                return;
+            }
+
+            // Everything recorded on the main context so far (IE: resource barriers) must execute before the chunks
+            context.Flush();
+
+            std::vector<std::unique_ptr<GraphicsContext>> chunkContexts(chunks.size());
+            jobs.ParallelFor((uint32_t)chunks.size(), [&](uint32_t i)
+                {
+                    chunkContexts[i] = std::make_unique<GraphicsContext>(graphics.GraphicsQueue());
+                    bindPassState(*chunkContexts[i]);
+                    drawList.Submit(chunkContexts[i]->CommandList(), chunks[i], primitiveVisibility, primitiveLods, clusterDraws);
+                });
+
+            // Chunks are submitted in order regardless of the order they finished recording in
+            //PERF: These could be submitted with a single ExecuteCommandLists
+            for (std::unique_ptr<GraphicsContext>& chunkContext : chunkContexts)
+            { chunkContext->Finish(); }
+        };
+
     while (Window::ProcessMessages())
     {
         PIXScopedEvent(0, "Frame %lld", frameNumber);
@@ -344,24 +445,9 @@ static int MainImpl()
         //-------------------------------------------------------------------------------------------------------------
         // Resize screen-dependent resources
         //-------------------------------------------------------------------------------------------------------------
-        if ((screenSize != swapChain.Size()).Any())
-        {
-            // Flush the GPU to ensure there's no outstanding usage of the resources
-            graphics.WaitForGpuIdle();
-            screenSize = swapChain.Size();
-            screenSizeF = (float2)screenSize;
-
-            depthBuffer.Resize(screenSize);
-
-            int shift = 1;
-            for (DepthStencilBuffer& depthBuffer : downsampledDepthBuffers)
-            {
-                depthBuffer.Resize(LightLinkedList::ScreenSizeToLllBufferSize(screenSize, shift));
-                shift++;
-            }
-
-            lightLinkedList.Resize(screenSize);
-        }
+        // (Screen-sized resources are render graph transients, the graph re-places them when their descriptions change.)
+        screenSize = swapChain.Size();
+        screenSizeF = (float2)screenSize;
 
         //-------------------------------------------------------------------------------------------------------------
         // Frame setup
@@ -378,9 +464,7 @@ static int MainImpl()
             PIXScopedEvent(&context, 0, "Frame #%lld setup", frameNumber);
             ScopedTimer(context, Timer::FrameSetup);
             context.TransitionResource(swapChain, D3D12_RESOURCE_STATE_RENDER_TARGET);
-            context.TransitionResource(depthBuffer, D3D12_RESOURCE_STATE_DEPTH_WRITE);
             context.Clear(swapChain, 0.01f, 0.01f, 0.01f, 1.f);
-            context.Clear(depthBuffer);
 
             perspectiveTransform = float4x4::MakePerspectiveTransformReverseZ(Math::Deg2Rad(cameraFovDegrees) , screenSizeF.x / screenSizeF.y, 0.0001f);
             perFrame =
@@ -396,10 +480,8 @@ static int MainImpl()
             };
             perFrame.ViewProjectionTransformInverse = perFrame.ViewProjectionTransform.Inverted();
 
-            GpuSyncPoint perFrameCbSyncPoint = perFrameCbResource.Update(perFrame);
-            graphics.GraphicsQueue().AwaitSyncPoint(perFrameCbSyncPoint); // (This is part of why FrequentlyUpdatedResource isn't the ideal abstraction here)
-            graphics.ComputeQueue().AwaitSyncPoint(perFrameCbSyncPoint); // Make sure perFrame is available to async compute
-            perFrameCbAddress = perFrameCbResource.Current()->GetGPUVirtualAddress();
+            frameConstants.BeginFrame();
+            perFrameCbAddress = frameConstants.Push(perFrame);
 
             lightUpdateSyncPoint = lightHeap.Update(lights);
         }
@@ -424,179 +506,263 @@ static int MainImpl()
 #endif
 
         //-------------------------------------------------------------------------------------------------------------
-        // Depth pre-pass
+        // Scene culling
         //-------------------------------------------------------------------------------------------------------------
+        IndirectDrawList& opaqueIndirectDrawsForFrame = debugSettings.ShowLightBoundaries ? opaqueLightDebugIndirectDraws : opaqueIndirectDraws;
+        std::span<const uint8_t> scenePrimitiveVisibilityForFrame; // Empty = Everything is visible
+        const float pixelsPerUnit = perspectiveTransform.m11 * screenSizeF.y * 0.5f;
+        if (debugSettings.GpuDrivenScene)
         {
-            PIXScopedEvent(&context, 1, "Depth pre-pass");
-            ScopedTimer(context, Timer::DepthPrePass);
-            context.SetRenderTarget(depthBuffer.View());
-            context.SetFullViewportScissor(screenSize);
-            BindPbrRootSignature(context, perFrameCbAddress);
+            PIXScopedEvent(&context, 1, "Scene culling");
+            ScopedTimer(context, Timer::SceneCulling);
+            // Both lists select LODs from the same bounds and errors, so the depth pre-pass always matches the opaque pass
+            float maxPixelError = debugSettings.MeshLods ? debugSettings.LodPixelError : 0.f;
+            depthPrePassIndirectDraws.Cull(context.Compute(), perFrameCbAddress, pixelsPerUnit, maxPixelError);
+            opaqueIndirectDrawsForFrame.Cull(context.Compute(), perFrameCbAddress, pixelsPerUnit, maxPixelError);
+        }
+        else if (debugSettings.CpuFrustumCulling)
+        {
+            PIXScopedEvent(&context, 1, "Scene culling");
+            ScopedTimer(context, Timer::SceneCulling);
+            visibleScenePrimitives.clear();
+            sceneBvh.Cull(Frustum(perFrame.ViewProjectionTransform), visibleScenePrimitives);
 
-            for (const SceneNode& node : scene)
+            if (debugSettings.CpuOcclusionCulling)
             {
-                // Skip unrenderable nodes (IE: nodes without meshes)
-                if (!node.IsValid()) { continue; }
+                occlusionRasterizer.Render(sceneOccluders, perFrame.ViewProjectionTransform, jobs);
+                std::erase_if(visibleScenePrimitives, [&](uint32_t i) { return !occlusionRasterizer.IsVisible(scenePrimitiveBounds[i]); });
+            }
 
-                ShaderInterop::PerNodeCb perNode =
-                {
-                    .Transform = node.WorldTransform(),
-                    .NormalTransform = node.NormalTransform(),
-                };
+            std::fill(scenePrimitiveVisibility.begin(), scenePrimitiveVisibility.end(), (uint8_t)0);
+            for (uint32_t primitive : visibleScenePrimitives)
+            { scenePrimitiveVisibility[primitive] = 1; }
+            scenePrimitiveVisibilityForFrame = scenePrimitiveVisibility;
+        }
 
-                PIXScopedEvent(&context, 1, "Node '%s'", node.Name().c_str());
-                for (const MeshPrimitive& primitive : node)
+        // The GPU-driven path selects LODs while culling
+        std::span<const uint8_t> scenePrimitiveLodsForFrame; // Empty = Everything uses LOD 0
+        if (debugSettings.MeshLods && !debugSettings.GpuDrivenScene)
+        {
+            depthPrePassDraws.SelectLods(camera.Position(), pixelsPerUnit, debugSettings.LodPixelError, scenePrimitiveLods);
+            scenePrimitiveLodsForFrame = scenePrimitiveLods;
+        }
+
+        // Texture streaming is prioritized by roughly how much of the screen is covered by the primitives using each texture
+        // (The GPU-driven path doesn't cull on the CPU, so everything counts as visible there.)
+        {
+            PIXScopedEvent(&context, 1, "Texture streaming");
+            float screenArea = screenSizeF.x * screenSizeF.y;
+            auto ReportTextureUsage = [&](std::span<const DrawPacket> packets)
                 {
-                    if (primitive.Material().IsTransparent())
+                    for (const DrawPacket& packet : packets)
                     {
-                        continue;
+                        if (!scenePrimitiveVisibilityForFrame.empty() && !scenePrimitiveVisibilityForFrame[packet.PrimitiveIndex])
+                        { continue; }
+
+                        // Primitives are approximated by their bounding spheres, which cover the whole screen when the camera is inside of them
+                        float3 extents = packet.BoundsExtents;
+                        float3 toCamera = camera.Position() - packet.BoundsCenter;
+                        float radius = extents.Length();
+                        float distance = toCamera.Length();
+                        float coverage = 1.f;
+                        if (distance > radius)
+                        {
+                            float projectedRadius = radius * pixelsPerUnit / distance;
+                            coverage = std::min(Math::Pi * projectedRadius * projectedRadius / screenArea, 1.f);
+                        }
+
+                        for (uint32_t texture : resources.PbrMaterials.MaterialTextures(packet.MaterialId))
+                        { resources.StreamedTextures.ReportUsage(texture, coverage); }
                     }
+                };
 
-                    PbrMaterial material = primitive.Material();
-                    perNode.MaterialId = material.MaterialId();
-                    perNode.TangentsIndex = primitive.TangentsBufferIndex();
-                    perNode.ColorsIndex = primitive.ColorsBufferIndex();
-                    context->SetGraphicsRoot32BitConstants(ShaderInterop::Pbr::RpPerNodeCb, sizeof(perNode) / sizeof(UINT), &perNode, 0);
+            ReportTextureUsage(opaqueDraws.Packets());
+            ReportTextureUsage(transparentDraws.Packets());
+            resources.StreamedTextures.Update(resources.PbrMaterials);
 
-                    context->SetPipelineState(material.IsDoubleSided() ? resources.DepthOnlyDoubleSided : resources.DepthOnlySingleSided);
-                    context->IASetVertexBuffers(MeshInputSlot::Position, 1, &primitive.Positions());
-                    context->IASetVertexBuffers(MeshInputSlot::Uv0, 1, &primitive.Uvs());
+            // Nothing recorded so far this frame reads the updated materials, so there's no need to flush first
+            graphics.GraphicsQueue().AwaitSyncPoint(resources.PbrMaterials.Update());
+        }
 
-                    if (primitive.IsIndexed())
-                    {
-                        context->IASetIndexBuffer(&primitive.Indices());
-                        context.DrawIndexedInstanced(primitive.VertexOrIndexCount(), 1);
-                    }
-                    else
-                    {
-                        context.DrawInstanced(primitive.VertexOrIndexCount(), 1);
-                    }
-                }
-            }
+        // Instanced draw lists can't be cluster culled, so cluster culling takes priority over auto-instancing
+        const ClusterDrawSet* sceneClusterDrawsForFrame = nullptr; // Null = Primitives are drawn whole
+        if (debugSettings.ClusterCulling && !debugSettings.GpuDrivenScene)
+        {
+            PIXScopedEvent(&context, 1, "Cluster culling");
+            sceneClusterDrawsForFrame = &clusterCuller.Cull(depthPrePassDraws, Frustum(perFrame.ViewProjectionTransform), camera.Position(), scenePrimitiveVisibilityForFrame, scenePrimitiveLodsForFrame);
         }
+        const bool useInstancedSceneDraws = debugSettings.AutoInstancing && sceneClusterDrawsForFrame == nullptr;
 
         //-------------------------------------------------------------------------------------------------------------
-        // Downsample depth buffer
+        // Declare frame resources
         //-------------------------------------------------------------------------------------------------------------
-        context.Flush();
+        // The depth buffers and first light link buffer only live within the frame, so the render graph aliases their memory with each other
+        // (Downsampled depth buffers below the light linked list resolution are culled along with the passes which fill them.)
+        RenderGraphResourceId backBufferResource = renderGraph.Import("Back buffer");
+
+        // Index 0 is the full resolution depth buffer, index i is downsampled to 1/(2^i)
+        std::vector<RenderGraphResourceId> depthBufferResources;
+        depthBufferResources.push_back(renderGraph.CreateTransient("Depth buffer", depthBuffer, depthBuffer.Describe(screenSize), [&](ID3D12Heap* heap, uint64_t heapOffset)
+            { depthBuffer.Place(screenSize, heap, heapOffset); }));
+
+        for (uint32_t shift = 1; shift <= (uint32_t)downsampledDepthBuffers.size(); shift++)
         {
-            PIXScopedEvent(&context, 1, "Downsample depth");
-            ScopedTimer(context, Timer::DownsampleDepth);
+            DepthStencilBuffer& downsampledDepthBuffer = downsampledDepthBuffers[shift - 1];
+            uint2 size = LightLinkedList::ScreenSizeToLllBufferSize(screenSize, shift);
+            std::string name = std::format("Depth buffer (1/{})", 1 << shift);
+            depthBufferResources.push_back(renderGraph.CreateTransient(name, downsampledDepthBuffer, downsampledDepthBuffer.Describe(size), [&downsampledDepthBuffer, size](ID3D12Heap* heap, uint64_t heapOffset)
+                { downsampledDepthBuffer.Place(size, heap, heapOffset); }));
+        }
 
-            DepthStencilBuffer* previousBuffer = &depthBuffer;
-            context->SetGraphicsRootSignature(resources.DepthDownsampleRootSignature);
-            context->SetPipelineState(resources.DepthDownsample);
+        // The first light link buffer is extracted since the frame statistics read it after the graph has executed
+        D3D12_RESOURCE_DESC firstLightLinkBufferDescription = LightLinkedList::DescribeFirstLightLinkBuffer(screenSize, lightLinkedListShift);
+        RenderGraphResourceId firstLightLinkBufferResource = renderGraph.CreateTransient("First light link buffer", lightLinkedList.FirstLightLinkBuffer(), firstLightLinkBufferDescription, [&lightLinkedList, firstLightLinkBufferDescription](ID3D12Heap* heap, uint64_t heapOffset)
+            { lightLinkedList.PlaceFirstLightLinkBuffer(firstLightLinkBufferDescription, heap, heapOffset); });
+        renderGraph.Extract(firstLightLinkBufferResource);
 
-            for (DepthStencilBuffer& depthBuffer : downsampledDepthBuffers)
+        RenderGraphResourceId lightLinkedListDepthBufferResource = depthBufferResources[lightLinkedListShift];
+        DepthStencilBuffer& lightLinkedListDepthBuffer = lightLinkedListShift == 0 ? depthBuffer : downsampledDepthBuffers[lightLinkedListShift - 1];
+
+        //-------------------------------------------------------------------------------------------------------------
+        // Depth pre-pass
+        //-------------------------------------------------------------------------------------------------------------
+        renderGraph.AddPass("Depth pre-pass", { { depthBufferResources[0], RenderGraphAccess::DepthWrite } }, [&](GraphicsContext& context)
             {
-                context->SetGraphicsRootDescriptorTable(ShaderInterop::DepthDownsample::RpInputDepthBuffer, previousBuffer->DepthShaderResourceView().ResidentHandle());
-                context.SetRenderTarget(depthBuffer.View());
-                context.SetFullViewportScissor(depthBuffer.Size());
+                ScopedTimer(context, Timer::DepthPrePass);
+                context.Clear(depthBuffer);
 
-                context.TransitionResource(*previousBuffer, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
-                context.TransitionResource(depthBuffer, D3D12_RESOURCE_STATE_DEPTH_WRITE);
-                context.DrawInstanced(3, 1);
+                auto BindDepthPrePassState = [&](GraphicsContext& passContext)
+                    {
+                        passContext.SetRenderTarget(depthBuffer.View());
+                        passContext.SetFullViewportScissor(screenSize);
+                        BindPbrRootSignature(passContext, perFrameCbAddress);
+                    };
 
-                context.TransitionResource(*previousBuffer, D3D12_RESOURCE_STATE_DEPTH_READ);
-                previousBuffer = &depthBuffer;
-            }
+                if (debugSettings.GpuDrivenScene)
+                {
+                    BindDepthPrePassState(context);
+                    depthPrePassIndirectDraws.Submit(context);
+                }
+                else if (useInstancedSceneDraws)
+                { SubmitDrawList(context, depthPrePassInstancedDraws, scenePrimitiveVisibilityForFrame, scenePrimitiveLodsForFrame, nullptr, BindDepthPrePassState); }
+                else
+                { SubmitDrawList(context, depthPrePassDraws, scenePrimitiveVisibilityForFrame, scenePrimitiveLodsForFrame, sceneClusterDrawsForFrame, BindDepthPrePassState); }
+            });
+
+        //-------------------------------------------------------------------------------------------------------------
+        // Downsample depth buffer
+        //-------------------------------------------------------------------------------------------------------------
+        // Each level is its own pass so that the levels the light linked list doesn't need are culled
+        for (uint32_t shift = 1; shift < (uint32_t)depthBufferResources.size(); shift++)
+        {
+            RenderGraphResourceUse uses[] =
+            {
+                { depthBufferResources[shift - 1], RenderGraphAccess::ShaderRead },
+                { depthBufferResources[shift], RenderGraphAccess::DepthWrite },
+            };
 
-            context.TransitionResource(*previousBuffer, D3D12_RESOURCE_STATE_DEPTH_READ);
+            renderGraph.AddPass(std::format("Downsample depth (1/{})", 1 << shift), uses, [&, shift](GraphicsContext& context)
+                {
+                    if (shift == 1)
+                    {
+                        context.Flush();
+                        stats.StartTimer(context, Timer::DownsampleDepth);
+                    }
+
+                    DepthStencilBuffer& previousBuffer = shift == 1 ? depthBuffer : downsampledDepthBuffers[shift - 2];
+                    DepthStencilBuffer& downsampledDepthBuffer = downsampledDepthBuffers[shift - 1];
+                    context->SetGraphicsRootSignature(resources.DepthDownsampleRootSignature);
+                    context->SetPipelineState(resources.DepthDownsample);
+                    context->SetGraphicsRootDescriptorTable(ShaderInterop::DepthDownsample::RpInputDepthBuffer, previousBuffer.DepthShaderResourceView().ResidentHandle());
+                    context.SetRenderTarget(downsampledDepthBuffer.View());
+                    context.SetFullViewportScissor(downsampledDepthBuffer.Size());
+                    context.DrawInstanced(3, 1);
+
+                    // The last level which survives culling is the one the light linked list uses
+                    if (shift == lightLinkedListShift)
+                    { stats.EndTimer(context, Timer::DownsampleDepth); }
+                });
         }
 
         //-------------------------------------------------------------------------------------------------------------
         // Fill light linked list
         //-------------------------------------------------------------------------------------------------------------
-        context.Flush();
+        RenderGraphResourceUse fillLightLinkedListUses[] =
         {
-            PIXScopedEvent(&context, 2, "Fill light linked list");
-            ScopedTimer(context, Timer::FillLightLinkedList);
-            graphics.GraphicsQueue().AwaitSyncPoint(lightUpdateSyncPoint);
-            DepthStencilBuffer& lightLinkedListDepthBuffer = lightLinkedListShift == 0 ? depthBuffer : downsampledDepthBuffers[lightLinkedListShift - 1];
-            lightLinkedList.FillLights
-            (
-                context,
-                lightHeap,
-                (uint32_t)lights.size(),
-                lightLinkLimit,
-                perFrameCbAddress,
-                lightLinkedListShift,
-                lightLinkedListDepthBuffer,
-                screenSize,
-                perspectiveTransform
-            );
-        }
+            { lightLinkedListDepthBufferResource, RenderGraphAccess::DepthRead },
+            { firstLightLinkBufferResource, RenderGraphAccess::UnorderedAccess },
+        };
+        renderGraph.AddPass("Fill light linked list", fillLightLinkedListUses, [&](GraphicsContext& context)
+            {
+                context.Flush();
+                ScopedTimer(context, Timer::FillLightLinkedList);
+                graphics.GraphicsQueue().AwaitSyncPoint(lightUpdateSyncPoint);
+                lightLinkedList.FillLights
+                (
+                    context,
+                    lightHeap,
+                    (uint32_t)lights.size(),
+                    lightLinkLimit,
+                    perFrameCbAddress,
+                    lightLinkedListShift,
+                    lightLinkedListDepthBuffer,
+                    screenSize,
+                    perspectiveTransform
+                );
+            });
 
         //-------------------------------------------------------------------------------------------------------------
         // Opaque pass
         //-------------------------------------------------------------------------------------------------------------
-        context.Flush();
+        RenderGraphResourceUse lightingUses[] =
         {
-            PIXScopedEvent(&context, 2, "Opaque pass");
-            ScopedTimer(context, Timer::OpaquePass);
-            context.SetRenderTarget(swapChain, depthBuffer.ReadOnlyView());
-            context.SetFullViewportScissor(screenSize);
-            BindPbrRootSignature(context, perFrameCbAddress);
-
-            for (const SceneNode& node : scene)
+            { depthBufferResources[0], RenderGraphAccess::DepthRead },
+            { firstLightLinkBufferResource, RenderGraphAccess::ShaderRead },
+            { backBufferResource, RenderGraphAccess::RenderTarget },
+        };
+        renderGraph.AddPass("Opaque pass", lightingUses, [&](GraphicsContext& context)
             {
-                // Skip unrenderable nodes (IE: nodes without meshes)
-                if (!node.IsValid()) { continue; }
-
-                ShaderInterop::PerNodeCb perNode =
-                {
-                    .Transform = node.WorldTransform(),
-                    .NormalTransform = node.NormalTransform(),
-                };
-
-                PIXScopedEvent(&context, 2, "Node '%s'", node.Name().c_str());
-                for (const MeshPrimitive& primitive : node)
-                {
-                    if (primitive.Material().IsTransparent())
+                context.Flush();
+                ScopedTimer(context, Timer::OpaquePass);
+                auto BindOpaquePassState = [&](GraphicsContext& passContext)
                     {
-                        continue;
-                    }
+                        passContext.SetRenderTarget(swapChain, depthBuffer.ReadOnlyView());
+                        passContext.SetFullViewportScissor(screenSize);
+                        BindPbrRootSignature(passContext, perFrameCbAddress);
+                    };
 
-                    PbrMaterial material = primitive.Material();
-                    perNode.MaterialId = material.MaterialId();
-                    perNode.TangentsIndex = primitive.TangentsBufferIndex();
-                    perNode.ColorsIndex = primitive.ColorsBufferIndex();
-                    context->SetGraphicsRoot32BitConstants(ShaderInterop::Pbr::RpPerNodeCb, sizeof(perNode) / sizeof(UINT), &perNode, 0);
-
-                    if (debugSettings.ShowLightBoundaries)
-                    { context->SetPipelineState(material.IsDoubleSided() ? resources.PbrLightDebugDoubleSided : resources.PbrLightDebugSingleSided); }
-                    else
-                    { context->SetPipelineState(material.PipelineStateObject()); }
-                    context->IASetVertexBuffers(MeshInputSlot::Position, 1, &primitive.Positions());
-                    context->IASetVertexBuffers(MeshInputSlot::Normal, 1, &primitive.Normals());
-                    context->IASetVertexBuffers(MeshInputSlot::Uv0, 1, &primitive.Uvs());
-
-                    if (primitive.IsIndexed())
-                    {
-                        context->IASetIndexBuffer(&primitive.Indices());
-                        context.DrawIndexedInstanced(primitive.VertexOrIndexCount(), 1);
-                    }
-                    else
-                    {
-                        context.DrawInstanced(primitive.VertexOrIndexCount(), 1);
-                    }
+                if (debugSettings.GpuDrivenScene)
+                {
+                    BindOpaquePassState(context);
+                    opaqueIndirectDrawsForFrame.Submit(context);
                 }
-            }
-        }
+                else if (useInstancedSceneDraws)
+                { SubmitDrawList(context, debugSettings.ShowLightBoundaries ? opaqueLightDebugInstancedDraws : opaqueInstancedDraws, scenePrimitiveVisibilityForFrame, scenePrimitiveLodsForFrame, nullptr, BindOpaquePassState); }
+                else
+                { SubmitDrawList(context, debugSettings.ShowLightBoundaries ? opaqueLightDebugDraws : opaqueDraws, scenePrimitiveVisibilityForFrame, scenePrimitiveLodsForFrame, sceneClusterDrawsForFrame, BindOpaquePassState); }
+            });
 
         //-------------------------------------------------------------------------------------------------------------
         // Transparents pass
         //-------------------------------------------------------------------------------------------------------------
-        context.Flush();
-        {
-            PIXScopedEvent(&context, 3, "Transparents pass");
-            //TODO: Sort and render transparent nodes from glTF (there aren't any in Sponza so I never implemented this)
+        renderGraph.AddPass("Transparents pass", lightingUses, [&](GraphicsContext& context)
+            {
+                context.Flush();
+                context.SetRenderTarget(swapChain, depthBuffer.ReadOnlyView());
+                context.SetFullViewportScissor(screenSize);
 
-            ScopedTimer(context, Timer::ParticleRender);
-            context.SetRenderTarget(swapChain, depthBuffer.ReadOnlyView());
-            context.SetFullViewportScissor(screenSize);
-            smoke.Render(context, perFrameCbAddress, lightHeap, lightLinkedList, debugSettings.ShowLightBoundaries);
-        }
+                if (!transparentDraws.Packets().empty())
+                {
+                    ScopedTimer(context, Timer::TransparentPass);
+                    transparentDraws.Sort(jobs, camera.ViewTransform(), scenePrimitiveVisibilityForFrame);
+                    BindPbrRootSignature(context, perFrameCbAddress);
+                    transparentDraws.Submit(context.CommandList());
+                }
+
+                //TODO: Particles are drawn after (and therefore always in front of) transparent primitives rather than being sorted with them
+                ScopedTimer(context, Timer::ParticleRender);
+                smoke.Render(context, perFrameCbAddress, lightHeap, lightLinkedList, screenSize, debugSettings.ShowLightBoundaries);
+            });
 
         //-------------------------------------------------------------------------------------------------------------
         // Debug overlays
@@ -604,35 +770,52 @@ static int MainImpl()
         uint32_t maxLightsPerPixelForOverlay = 0;
         if (debugSettings.OverlayMode != LightLinkedListDebugMode::None)
         {
-            PIXScopedEvent(&context, 4, "Debug overlay");
-            ScopedTimer(context, Timer::DebugOverlay);
-            context.SetRenderTarget(swapChain);
-            context.SetFullViewportScissor(screenSize);
-            ShaderInterop::LightLinkedListDebugParams params =
+            RenderGraphResourceUse uses[] =
             {
-                .Mode = debugSettings.OverlayMode,
-                .MaxLightsPerPixel = maxLightsPerPixelForOverlay = (std::max(1u, stats.MaximumLightCountForAnyPixel()) + 9) / 10 * 10,
-                .DebugOverlayAlpha = debugSettings.OverlayAlpha,
+                { firstLightLinkBufferResource, RenderGraphAccess::ShaderRead },
+                { backBufferResource, RenderGraphAccess::RenderTarget },
             };
-            lightLinkedList.DrawDebugOverlay(context, lightHeap, perFrameCbAddress, params);
+
+            renderGraph.AddPass("Debug overlay", uses, [&](GraphicsContext& context)
+                {
+                    ScopedTimer(context, Timer::DebugOverlay);
+                    context.SetRenderTarget(swapChain);
+                    context.SetFullViewportScissor(screenSize);
+                    ShaderInterop::LightLinkedListDebugParams params =
+                    {
+                        .Mode = debugSettings.OverlayMode,
+                        .MaxLightsPerPixel = maxLightsPerPixelForOverlay = (std::max(1u, stats.MaximumLightCountForAnyPixel()) + 9) / 10 * 10,
+                        .DebugOverlayAlpha = debugSettings.OverlayAlpha,
+                    };
+                    lightLinkedList.DrawDebugOverlay(context, lightHeap, perFrameCbAddress, params);
+                });
         }
 
         // Light sprites
         if (showLightSprites)
         {
-            PIXScopedEvent(&context, 4, "Light sprites");
-            context.TransitionResource(depthBuffer, D3D12_RESOURCE_STATE_DEPTH_WRITE);
-            context.SetRenderTarget(swapChain, depthBuffer.View());
-            context.SetFullViewportScissor(screenSize);
-            context->SetGraphicsRootSignature(resources.LightSpritesRootSignature);
-            context->SetPipelineState(resources.LightSprites);
-            context->SetGraphicsRootConstantBufferView(ShaderInterop::LightSprites::RpPerFrameCb, perFrameCbAddress);
-            context->SetGraphicsRootShaderResourceView(ShaderInterop::LightSprites::RpLightHeap, lightHeap.BufferGpuAddress());
-            context->SetGraphicsRootDescriptorTable(ShaderInterop::LightSprites::RpTexture, lightSprite.SrvHandle().ResidentHandle());
-            context->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
-            context.DrawInstanced(4, perFrame.LightCount, 1, 1);
+            RenderGraphResourceUse uses[] =
+            {
+                { depthBufferResources[0], RenderGraphAccess::DepthWrite },
+                { backBufferResource, RenderGraphAccess::RenderTarget },
+            };
+
+            renderGraph.AddPass("Light sprites", uses, [&](GraphicsContext& context)
+                {
+                    context.SetRenderTarget(swapChain, depthBuffer.View());
+                    context.SetFullViewportScissor(screenSize);
+                    context->SetGraphicsRootSignature(resources.LightSpritesRootSignature);
+                    context->SetPipelineState(resources.LightSprites);
+                    context->SetGraphicsRootConstantBufferView(ShaderInterop::LightSprites::RpPerFrameCb, perFrameCbAddress);
+                    context->SetGraphicsRootShaderResourceView(ShaderInterop::LightSprites::RpLightHeap, lightHeap.BufferGpuAddress());
+                    context->SetGraphicsRootDescriptorTable(ShaderInterop::LightSprites::RpTexture, lightSprite.SrvHandle().ResidentHandle());
+                    context->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
+                    context.DrawInstanced(4, perFrame.LightCount, 1, 1);
+                });
         }
 
+        renderGraph.Execute(context);
+
         // Show gizmo for moving lights
         //TODO: Add UI for selecting different lights instead of hard-coding things
         if (lights.size() > 2)
@@ -671,6 +854,42 @@ static int MainImpl()
                         ImGui::Separator();
 
                         ImGui::Checkbox("Animate lights", &debugSettings.AnimateLights);
+                        ImGui::Checkbox("GPU-driven scene", &debugSettings.GpuDrivenScene);
+                        ImGui::SetItemTooltip("Culls the scene on the GPU and draws it with ExecuteIndirect.\nCompare the CPU timings of the scene passes in the timing statistics window.");
+                        ImGui::Checkbox("Mesh LODs", &debugSettings.MeshLods);
+                        ImGui::SetItemTooltip("Draws distant primitives using simplified geometry generated when the scene was loaded.");
+                        ImGui::BeginDisabled(!debugSettings.MeshLods);
+                        ImGui::SliderFloat("LOD error", &debugSettings.LodPixelError, 0.25f, 16.f, "%.2f pixels", ImGuiSliderFlags_AlwaysClamp | ImGuiSliderFlags_Logarithmic);
+                        ImGui::SetItemTooltip("The largest on-screen geometric error allowed when selecting LODs.");
+                        ImGui::EndDisabled();
+                        ImGui::BeginDisabled(debugSettings.GpuDrivenScene);
+                        ImGui::Checkbox("CPU frustum culling", &debugSettings.CpuFrustumCulling);
+                        ImGui::SetItemTooltip("Culls scene primitives against the view frustum using a bounding volume hierarchy before recording the scene passes.");
+                        ImGui::BeginDisabled(!debugSettings.CpuFrustumCulling);
+                        ImGui::Checkbox("CPU occlusion culling", &debugSettings.CpuOcclusionCulling);
+                        ImGui::SetItemTooltip("Culls primitives which are hidden behind the scene's largest occluders using a low resolution software rasterizer.");
+                        ImGui::EndDisabled();
+                        ImGui::Checkbox("Auto-instancing", &debugSettings.AutoInstancing);
+                        ImGui::SetItemTooltip("Draws nodes which share a mesh with instanced draws.\nMerged %u scene draws into %u.", opaqueInstancedDraws.SourceDrawCount(), opaqueInstancedDraws.DrawCount());
+                        ImGui::Checkbox("Cluster culling", &debugSettings.ClusterCulling);
+                        {
+                            const ClusterCullingStatistics& clusterStats = clusterCuller.Statistics();
+                            ImGui::SetItemTooltip
+                            (
+                                "Culls the meshlets of full detail primitives against the view frustum and their normal cones, disables auto-instancing.\n"
+                                "Culled %u of %u clusters (%u frustum, %u back facing) and %u of %u triangles, drawn with %u draws.",
+                                clusterStats.FrustumCulledClusters + clusterStats.BackFaceCulledClusters,
+                                clusterStats.ClusterCount,
+                                clusterStats.FrustumCulledClusters,
+                                clusterStats.BackFaceCulledClusters,
+                                clusterStats.CulledTriangleCount,
+                                clusterStats.TriangleCount,
+                                clusterStats.DrawCount
+                            );
+                        }
+                        ImGui::SliderInt("Scene recording threads", &debugSettings.SceneRecordingThreads, 0, (int)jobs.WorkerCount() + 1, debugSettings.SceneRecordingThreads == 0 ? "All" : "%d", ImGuiSliderFlags_AlwaysClamp);
+                        ImGui::SetItemTooltip("Number of threads used to record the depth pre-pass and opaque pass.\nCompare the CPU timings of the scene passes in the timing statistics window.");
+                        ImGui::EndDisabled();
 
                         ImGui::EndMenu();
                     }
@@ -682,6 +901,11 @@ static int MainImpl()
                         ImGui::MenuItem("Particle editor", nullptr, &ui.ShowParticleSystemEditor);
                         ImGui::MenuItem("Show controls hint", nullptr, &ui.ShowControlsHint);
                         ImGui::MenuItem("Timing statistics", nullptr, &ui.ShowTimingStatisticsWindow);
+                        if (ImGui::MenuItem("Export timing history (JSON)"))
+                        { stats.History().Export("TimingHistory.json"); }
+                        if (ImGui::MenuItem("Export timing history (CSV)"))
+                        { stats.History().Export("TimingHistory.csv"); }
+                        ImGui::MenuItem("Texture streaming", nullptr, &ui.ShowTextureStreamingWindow);
 
                         if (ImGui::BeginMenu("Window Mode"))
                         {
@@ -725,7 +949,8 @@ static int MainImpl()
 
             ui.SubmitLightLinkedListSettingsWindow(lightLinkedListShift, lightLinkLimit, (uint32_t)downsampledDepthBuffers.size());
             ui.SubmitParticleSystemEditor(context.Compute(), smoke, smokeDefinition);
-            ui.SubmitTimingStatisticsWindow();
+            ui.SubmitTimingStatisticsWindow(resources.StreamedTextures, renderGraph);
+            ui.SubmitTextureStreamingWindow(resources.StreamedTextures);
             ui.SubmitViewportOverlays(debugSettings.OverlayMode, maxLightsPerPixelForOverlay);
 
             context.SetRenderTarget(swapChain);
@@ -766,8 +991,8 @@ static int MainImpl()
         //-------------------------------------------------------------------------------------------------------------
         PIXScopedEvent(99, "Housekeeping");
         context.Finish();
-
-        graphics.UploadQueue().Cleanup();
+        frameConstants.EndFrame();
+        graphics.ResourceDescriptorManager().EndFrame();
 
         lastTimestamp.QuadPart = timestamp.QuadPart;
         frameNumber++;
@@ -780,12 +1005,64 @@ static int MainImpl()
     // Ensure the GPU is done with all our resources before they're implicitly destroyed by their destructors
     // If you get a deadlock here it's probably because you had the debug layer enabled and the PIX capture library loaded at the same time
     graphics.WaitForGpuIdle();
+
+    if (timingExportPath != nullptr)
+    { stats.History().Export(timingExportPath); }
+
+    return 0;
+}
+
+// Runs the transparent draw sorting benchmark without initializing graphics, see TransparentDrawList::Benchmark
+static int BenchmarkTransparentSort()
+{
+    JobSystem jobs;
+    const uint32_t drawCount = 100000;
+    TransparentSortBenchmark benchmark = TransparentDrawList::Benchmark(jobs, drawCount, 100);
+    printf("Sorted %u transparent draws on %u threads over %u iterations:\n", benchmark.DrawCount, jobs.WorkerCount() + 1, benchmark.IterationCount);
+    printf("    Build keys: %.3f ms\n", benchmark.BuildKeysSeconds * 1000.0);
+    printf("    Radix sort: %.3f ms\n", benchmark.SortSeconds * 1000.0);
+    return 0;
+}
+
+// Runs the timing history benchmark with synthetic samples, see TimingHistory::Benchmark
+static int BenchmarkTimingHistory()
+{
+    TimingHistoryBenchmark benchmark = TimingHistory::Benchmark((uint32_t)Timer::COUNT, TimingHistory::DEFAULT_CAPACITY, 100000);
+    printf("Recorded %u frames of %u timers into a %u frame history:\n", benchmark.FrameCount, benchmark.TimerCount, benchmark.Capacity);
+    printf("    Record: %.3f us\n", benchmark.RecordSeconds * 1000000.0);
+    printf("    Snapshot: %.3f ms\n", benchmark.SnapshotSeconds * 1000.0);
+    printf("    Summarize all timers: %.3f ms\n", benchmark.SummarizeSeconds * 1000.0);
     return 0;
 }
 
-int main()
+// Runs the scene BVH culling benchmark with synthetic boxes, see BoundingVolumeHierarchy::Benchmark
+static int BenchmarkBvh()
 {
-    int result = MainImpl();
+    BoundingVolumeHierarchyBenchmark benchmark = BoundingVolumeHierarchy::Benchmark(100000, 1000);
+    printf("Culled %u boxes (%u nodes) against %u frusta, %.1f visible on average:\n", benchmark.BoxCount, benchmark.NodeCount, benchmark.FrustumCount, benchmark.AverageVisibleCount);
+    printf("    Build: %.3f ms\n", benchmark.BuildSeconds * 1000.0);
+    printf("    BVH cull: %.3f ms\n", benchmark.CullSeconds * 1000.0);
+    printf("    Brute force cull: %.3f ms\n", benchmark.BruteForceSeconds * 1000.0);
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc > 1 && strcmp(argv[1], "--benchmark-transparent-sort") == 0)
+    { return BenchmarkTransparentSort(); }
+
+    if (argc > 1 && strcmp(argv[1], "--benchmark-timing-history") == 0)
+    { return BenchmarkTimingHistory(); }
+
+    if (argc > 1 && strcmp(argv[1], "--benchmark-bvh") == 0)
+    { return BenchmarkBvh(); }
+
+    // --export-timings <path> exports the timing history on exit, as CSV if the path ends in .csv and JSON otherwise
+    const char* timingExportPath = nullptr;
+    if (argc > 2 && strcmp(argv[1], "--export-timings") == 0)
+    { timingExportPath = argv[2]; }
+
+    int result = MainImpl(timingExportPath);
     DebugLayer::ReportLiveObjects();
     return result;
 }
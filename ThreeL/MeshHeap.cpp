@@ -23,29 +23,15 @@ MeshHeap::MeshHeap(GraphicsCore& graphics)
 ComPtr<ID3D12Resource> MeshHeap::AllocateChunk(bool isStagingBuffer)
 {
     D3D12_RESOURCE_DESC description = DescribeBufferResource(CHUNK_SIZE, isStagingBuffer ? D3D12_RESOURCE_FLAG_DENY_SHADER_RESOURCE : D3D12_RESOURCE_FLAG_NONE);
-    D3D12_HEAP_PROPERTIES heapProperties = { isStagingBuffer ? D3D12_HEAP_TYPE_UPLOAD : D3D12_HEAP_TYPE_DEFAULT };
-
-    ComPtr<ID3D12Resource> newChunk;
-    AssertSuccess(m_Graphics.Device()->CreateCommittedResource
+    return m_Graphics.GpuMemoryManager().CreateResource
     (
-        &heapProperties,
+        GpuMemoryCategory::Geometry,
+        isStagingBuffer ? D3D12_HEAP_TYPE_UPLOAD : D3D12_HEAP_TYPE_DEFAULT,
         D3D12_HEAP_FLAG_CREATE_NOT_ZEROED,
-        &description,
+        description,
         isStagingBuffer ? D3D12_RESOURCE_STATE_GENERIC_READ : D3D12_RESOURCE_STATE_COMMON,
-        nullptr,
-        IID_PPV_ARGS(&newChunk)
-    ));
-
-    if (isStagingBuffer)
-    {
-        newChunk->SetName(L"MeshHeap CPU staging buffer");
-    }
-    else
-    {
-        newChunk->SetName(std::format(L"MeshHeap GPU buffer #{}", m_MeshBuffers.size()).c_str());
-    }
-
-    return newChunk;
+        isStagingBuffer ? L"MeshHeap CPU staging buffer" : std::format(L"MeshHeap GPU buffer #{}", m_MeshBuffers.size())
+    );
 }
 
 D3D12_GPU_VIRTUAL_ADDRESS MeshHeap::Allocate(const void* buffer, size_t sizeBytes, uint32_t* outBindlessIndex)
@@ -60,5 +60,13 @@ public:
         return AllocateVertexBuffer(vertexData.data(), vertexData.size_bytes(), sizeof(T), outBindlessIndex);
     }
 
+    //! Allocates a buffer which is only ever accessed through its bindless raw SRV
+    template<typename T>
+    inline D3D12_GPU_VIRTUAL_ADDRESS AllocateBindlessBuffer(std::span<const T> data, uint32_t* outBindlessIndex)
+    {
+        Assert(outBindlessIndex != nullptr);
+        return Allocate(data.data(), data.size_bytes(), outBindlessIndex);
+    }
+
     void Flush();
 };
@@ -3,6 +3,8 @@
 
 #include "GltfAccessorView.h"
 #include "GltfLoadContext.h"
+#include "MeshSimplifier.h"
+#include "ShaderInterop.h"
 #include "ResourceManager.h"
 
 #include <tiny_gltf.h>
@@ -32,33 +34,33 @@ MeshPrimitive::MeshPrimitive(GltfLoadContext& context, int meshIndex, int primit
 
         // Indices can be in u8, u16, or u32
         // https://github.com/KhronosGroup/glTF/blob/5de957b8b0a13c147c90d4ff569250440931872f/specification/2.0/README.md#primitiveindices
+        // They're widened to 32-bit for now, the index buffer isn't allocated until UploadGeneratedGeometry since GenerateMeshlets reorders them.
+        // (D3D12 doesn't support 8-bit indices, realistically we don't expect real models to use these, but some of the test models do and it's called for in the spec.)
         if (auto indicesU8 = dynamic_cast<GltfAccessorView<uint8_t>*>(accessorView))
         {
-            // D3D12 doesn't support 8-bit indices so we don't either, as such we widen them to 16-bit
-            // (Realistically we don't expect real models to use these, but some of the test models do and it's called for in the spec.)
-            std::vector<uint16_t> indices;
-            indices.reserve(indicesU8->ElementCount());
+            m_SourceIndices.reserve(indicesU8->ElementCount());
 
             for (int i = 0; i < indicesU8->ElementCount(); i++)
             {
-                indices[i] = (*indicesU8)[i];
+                m_SourceIndices.push_back((*indicesU8)[i]);
             }
-
-            m_Indices = resources.MeshHeap.AllocateIndexBuffer(indices);
         }
         else if (auto indicesU16 = dynamic_cast<GltfAccessorView<uint16_t>*>(accessorView))
         {
-            m_Indices = resources.MeshHeap.AllocateIndexBuffer(indicesU16->AsDenseSpanMaybeAllocate());
+            std::span<const uint16_t> indices = indicesU16->AsDenseSpanMaybeAllocate();
+            m_SourceIndices.assign(indices.begin(), indices.end());
         }
         else if (auto indicesU32 = dynamic_cast<GltfAccessorView<uint32_t>*>(accessorView))
         {
-            m_Indices = resources.MeshHeap.AllocateIndexBuffer(indicesU32->AsDenseSpanMaybeAllocate());
+            std::span<const uint32_t> indices = indicesU32->AsDenseSpanMaybeAllocate();
+            m_SourceIndices.assign(indices.begin(), indices.end());
         }
         else
         {
             Assert(false && "Invalid glTF accessor type for mesh primitive indices!");
         }
 
+        m_OccluderIndices = m_SourceIndices;
         delete accessorView;
     }
 
@@ -87,6 +89,40 @@ MeshPrimitive::MeshPrimitive(GltfLoadContext& context, int meshIndex, int primit
         m_Uvs = resources.MeshHeap.AllocateVertexBuffer(uv0->AsDenseSpanMaybeAllocate());
         m_VertexOrIndexCount = m_IsIndexed ? indexCount : positions->ElementCount();
 
+        // Calculate the bounds
+        // glTF requires position accessors to specify their min/max, but we fall back to scanning the positions for non-conformant files
+        const tinygltf::Accessor& positionsAccessor = positions->Accessor();
+        if (positionsAccessor.minValues.size() == 3 && positionsAccessor.maxValues.size() == 3)
+        {
+            m_Bounds =
+            {
+                float3((float)positionsAccessor.minValues[0], (float)positionsAccessor.minValues[1], (float)positionsAccessor.minValues[2]),
+                float3((float)positionsAccessor.maxValues[0], (float)positionsAccessor.maxValues[1], (float)positionsAccessor.maxValues[2]),
+            };
+        }
+        else
+        { m_Bounds = BoundingBox::FromPoints(positions->AsDenseSpanMaybeAllocate()); }
+
+        m_BoundingSphere = BoundingSphere::FromBox(m_Bounds);
+
+        // Keep a copy of the positions on the CPU in case this primitive is used as an occluder, see below
+        std::span<const float3> positionsSpan = positions->AsDenseSpanMaybeAllocate();
+        m_OccluderPositions.assign(positionsSpan.begin(), positionsSpan.end());
+        if (!m_IsIndexed)
+        {
+            m_OccluderIndices.resize(m_OccluderPositions.size());
+            for (uint32_t i = 0; i < m_OccluderIndices.size(); i++)
+            { m_OccluderIndices[i] = i; }
+        }
+
+        // Keep a copy of the geometry for GenerateMeshlets and GenerateLods, non-indexed primitives are rare enough that they don't get either
+        if (m_IsIndexed)
+        {
+            std::span<const float3> normalsSpan = normals->AsDenseSpanMaybeAllocate();
+            m_SourcePositions.assign(positionsSpan.begin(), positionsSpan.end());
+            m_SourceNormals.assign(normalsSpan.begin(), normalsSpan.end());
+        }
+
         if (tangents != nullptr)
         {
             resources.MeshHeap.AllocateVertexBuffer(tangents->AsDenseSpanMaybeAllocate(), &m_TangentsBufferIndex);
@@ -110,8 +146,124 @@ MeshPrimitive::MeshPrimitive(GltfLoadContext& context, int meshIndex, int primit
     // Create material and load textures
     m_Material = PbrMaterial(context, primitive.material, hasTangents);
 
-    // Warn about transparent materials not being implemented
-    // (Sponza doesn't use any so I never got around to implementing sorting and rendeirng them.)
-    if (m_Material.IsTransparent())
-    { printf("Warning: Mesh primitive '%s' will not be rendered because it uses alpha blending, which is currently unimplemented in ThreeL.\n", m_Name.c_str()); }
+    // Primitives which can be seen through can't occlude anything, so there's no point keeping their geometry around
+    if (m_Material.IsTransparent() || m_Material.IsAlphaTested())
+    {
+        m_OccluderPositions = { };
+        m_OccluderIndices = { };
+    }
+}
+
+void MeshPrimitive::GenerateMeshlets()
+{
+    if (m_SourceIndices.empty())
+    { return; }
+
+    MeshletMesh mesh = BuildMeshlets(m_SourcePositions, m_SourceIndices);
+    Assert(mesh.Indices.size() == m_SourceIndices.size());
+    m_MeshletStatistics = MeasureMeshlets(mesh);
+
+    // Every meshlet is a contiguous range of the reordered indices, which is what lets the CPU cluster culler draw them without any extra buffers
+    m_SourceIndices = std::move(mesh.Indices);
+    m_Meshlets = std::move(mesh.Meshlets);
+    m_MeshletBounds = std::move(mesh.Bounds);
+    m_PendingMeshletVertices = std::move(mesh.Vertices);
+    m_PendingMeshletTriangles = std::move(mesh.Triangles);
+}
+
+void MeshPrimitive::GenerateLods()
+{
+    // Each LOD aims for half the triangles of the previous one
+    // Simplification stops once it can't make enough progress (IE: it's stuck on seams or borders) or the error would be noticeable even when the primitive
+    // is tiny on screen, in either case the LOD wouldn't be worth the memory.
+    const uint32_t minLodIndexCount = 64 * 3;
+    const float maxRelativeError = 0.05f;
+
+    if (m_SourceIndices.empty())
+    { return; }
+
+    const float maxError = m_BoundingSphere.Radius * maxRelativeError;
+    m_PendingLodIndices.reserve(MaxLodCount);
+    std::span<const uint32_t> previousIndices = m_SourceIndices;
+    float previousError = 0.f;
+
+    for (uint32_t i = 0; i < MaxLodCount; i++)
+    {
+        uint32_t targetIndexCount = (uint32_t)previousIndices.size() / 6 * 3;
+        if (targetIndexCount < minLodIndexCount)
+        { break; }
+
+        SimplifiedMesh lod = SimplifyMesh(m_SourcePositions, m_SourceNormals, previousIndices, targetIndexCount, maxError - previousError);
+        if (lod.Indices.size() > previousIndices.size() * 3 / 4)
+        { break; }
+
+        // Each LOD is simplified from the previous one, so the errors accumulate
+        float error = previousError + lod.Error;
+        m_Lods.push_back({ .Indices = { }, .IndexCount = (uint32_t)lod.Indices.size(), .Error = error });
+        m_PendingLodIndices.push_back(std::move(lod.Indices));
+        previousIndices = m_PendingLodIndices.back();
+        previousError = error;
+    }
+}
+
+void MeshPrimitive::UploadGeneratedGeometry(MeshHeap& meshHeap)
+{
+    Assert(m_PendingLodIndices.size() == m_Lods.size());
+
+    if (!m_IsIndexed)
+    { return; }
+
+    // Everything indexes the primitive's own vertices, so 16-bit indices can be used whenever there's few enough of them regardless of what the file used
+    const bool use16BitIndices = m_SourcePositions.size() <= 0xFFFF;
+    auto AllocateIndices = [&](std::span<const uint32_t> indices)
+        {
+            if (!use16BitIndices)
+            { return meshHeap.AllocateIndexBuffer(indices); }
+
+            std::vector<uint16_t> narrowIndices(indices.begin(), indices.end());
+            return meshHeap.AllocateIndexBuffer(narrowIndices);
+        };
+
+    m_Indices = AllocateIndices(m_SourceIndices);
+
+    for (uint32_t i = 0; i < m_Lods.size(); i++)
+    { m_Lods[i].Indices = AllocateIndices(m_PendingLodIndices[i]); }
+
+    if (!m_Meshlets.empty())
+    {
+        std::vector<ShaderInterop::MeshletInfo> meshlets;
+        meshlets.reserve(m_Meshlets.size());
+        for (uint32_t i = 0; i < m_Meshlets.size(); i++)
+        {
+            const Meshlet& meshlet = m_Meshlets[i];
+            const MeshletBounds& bounds = m_MeshletBounds[i];
+            meshlets.push_back
+            ({
+                .FirstVertex = meshlet.FirstVertex,
+                .VertexCount = meshlet.VertexCount,
+                .FirstTriangle = meshlet.FirstTriangle,
+                .TriangleCount = meshlet.TriangleCount,
+                .Center = bounds.Center,
+                .Radius = bounds.Radius,
+                .ConeAxis = bounds.ConeAxis,
+                .ConeCutoff = bounds.ConeCutoff,
+            });
+        }
+
+        // Triangles are packed into the low 24 bits of a uint each since raw buffers can't be read a byte at a time
+        std::vector<uint32_t> triangles(m_PendingMeshletTriangles.size() / 3);
+        for (uint32_t i = 0; i < triangles.size(); i++)
+        { triangles[i] = m_PendingMeshletTriangles[i * 3] | (m_PendingMeshletTriangles[i * 3 + 1] << 8) | (m_PendingMeshletTriangles[i * 3 + 2] << 16); }
+
+        meshHeap.AllocateBindlessBuffer<ShaderInterop::MeshletInfo>(meshlets, &m_MeshletsBufferIndex);
+        meshHeap.AllocateBindlessBuffer<uint32_t>(m_PendingMeshletVertices, &m_MeshletVerticesBufferIndex);
+        meshHeap.AllocateBindlessBuffer<uint32_t>(triangles, &m_MeshletTrianglesBufferIndex);
+    }
+
+    m_PendingLodIndices = { };
+    m_PendingMeshletVertices = { };
+    m_PendingMeshletTriangles = { };
+    m_SourcePositions = { };
+    m_SourceNormals = { };
+    m_SourceIndices = { };
 }
@@ -1,13 +1,33 @@
 #pragma once
+#include "Bounds.h"
+#include "MeshletBuilder.h"
 #include "PbrMaterial.h"
+#include "Vector3.h"
 
 #include <d3d12.h>
+#include <span>
 #include <string>
+#include <vector>
 
 class GltfLoadContext;
+class MeshHeap;
+
+//! A simplified version of a primitive which shares the primitive's vertex buffers
+struct MeshLod
+{
+    D3D12_INDEX_BUFFER_VIEW Indices;
+    uint32_t IndexCount;
+
+    //! Estimate of the largest object space distance between the LOD's surface and the primitive's
+    float Error;
+};
 
 class MeshPrimitive
 {
+public:
+    //! The maximum number of LODs generated in addition to the authored geometry
+    static constexpr uint32_t MaxLodCount = 3;
+
 private:
     std::string m_Name;
     bool m_IsValid = false;
@@ -22,6 +42,35 @@ private:
     uint32_t m_ColorsBufferIndex = BUFFER_DISABLED;
     uint32_t m_TangentsBufferIndex = BUFFER_DISABLED;
 
+    // Object space bounds
+    BoundingBox m_Bounds = BoundingBox::Empty();
+    BoundingSphere m_BoundingSphere = { };
+
+    // CPU copies of the geometry for the occlusion rasterizer, empty when the primitive can't be an occluder
+    std::vector<float3> m_OccluderPositions;
+    std::vector<uint32_t> m_OccluderIndices;
+
+    // Simplified LODs, the index buffers are only valid once UploadGeneratedGeometry has been called
+    std::vector<MeshLod> m_Lods;
+    std::vector<std::vector<uint32_t>> m_PendingLodIndices;
+
+    // Object space meshlets, each one is a contiguous range of the index buffer
+    std::vector<Meshlet> m_Meshlets;
+    std::vector<MeshletBounds> m_MeshletBounds;
+    MeshletStatistics m_MeshletStatistics = { };
+
+    // Bindless copies of the meshlets (see ShaderInterop::MeshletInfo) along with their vertex lists and packed triangles
+    uint32_t m_MeshletsBufferIndex = BUFFER_DISABLED;
+    uint32_t m_MeshletVerticesBufferIndex = BUFFER_DISABLED;
+    uint32_t m_MeshletTrianglesBufferIndex = BUFFER_DISABLED;
+    std::vector<uint32_t> m_PendingMeshletVertices;
+    std::vector<uint8_t> m_PendingMeshletTriangles;
+
+    // CPU copies of the geometry for GenerateMeshlets and GenerateLods, released by UploadGeneratedGeometry
+    std::vector<float3> m_SourcePositions;
+    std::vector<float3> m_SourceNormals;
+    std::vector<uint32_t> m_SourceIndices;
+
     PbrMaterial m_Material;
 
 public:
@@ -29,8 +78,21 @@ public:
     {
     }
 
+    //! Indexed primitives have no index buffer until UploadGeneratedGeometry has been called
     MeshPrimitive(GltfLoadContext& context, int meshIndex, int primitiveIndex);
 
+    //! Splits the primitive into meshlets and reorders its indices to match
+    //! Like GenerateLods this only touches this primitive's CPU-side data, so different primitives may generate their meshlets in parallel.
+    void GenerateMeshlets();
+
+    //! Simplifies the primitive into a chain of progressively coarser LODs
+    //! Only touches this primitive's CPU-side data, so different primitives may generate their LODs in parallel.
+    void GenerateLods();
+
+    //! Allocates the index buffer along with the buffers made by GenerateMeshlets and GenerateLods, then releases the CPU copies of the geometry
+    //! The mesh heap isn't thread safe, so unlike the generation methods this must not be called in parallel.
+    void UploadGeneratedGeometry(MeshHeap& meshHeap);
+
     inline std::string Name() const { return m_Name; }
     inline bool IsValid() const { return m_IsValid; }
     inline uint32_t VertexOrIndexCount() const { return m_VertexOrIndexCount; }
@@ -42,4 +104,15 @@ public:
     inline uint32_t ColorsBufferIndex() const { return m_ColorsBufferIndex; }
     inline uint32_t TangentsBufferIndex() const { return m_TangentsBufferIndex; }
     inline const PbrMaterial& Material() const { return m_Material; }
+    inline const BoundingBox& Bounds() const { return m_Bounds; }
+    inline const BoundingSphere& SphereBounds() const { return m_BoundingSphere; }
+    inline std::span<const float3> OccluderPositions() const { return m_OccluderPositions; }
+    inline std::span<const uint32_t> OccluderIndices() const { return m_OccluderIndices; }
+    inline std::span<const MeshLod> Lods() const { return m_Lods; }
+    inline std::span<const Meshlet> Meshlets() const { return m_Meshlets; }
+    inline std::span<const MeshletBounds> MeshletCullingBounds() const { return m_MeshletBounds; }
+    inline const MeshletStatistics& MeshletBuildStatistics() const { return m_MeshletStatistics; }
+    inline uint32_t MeshletsBufferIndex() const { return m_MeshletsBufferIndex; }
+    inline uint32_t MeshletVerticesBufferIndex() const { return m_MeshletVerticesBufferIndex; }
+    inline uint32_t MeshletTrianglesBufferIndex() const { return m_MeshletTrianglesBufferIndex; }
 };
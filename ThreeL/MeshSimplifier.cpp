@@ -0,0 +1,333 @@
+#include "pch.h"
+#include "MeshSimplifier.h"
+
+#include <algorithm>
+#include <queue>
+
+namespace
+{
+    // A symmetric 4x4 matrix which evaluates to the sum of the squared distances from a point to a set of planes
+    // (Doubles are used since the quadrics of large flat regions come very close to cancelling out.)
+    struct Quadric
+    {
+        double A00, A01, A02, A03;
+        double A11, A12, A13;
+        double A22, A23;
+        double A33;
+
+        static Quadric FromPlane(double a, double b, double c, double d)
+        { return { a * a, a * b, a * c, a * d, b * b, b * c, b * d, c * c, c * d, d * d }; }
+
+        void operator +=(const Quadric& other)
+        {
+            A00 += other.A00; A01 += other.A01; A02 += other.A02; A03 += other.A03;
+            A11 += other.A11; A12 += other.A12; A13 += other.A13;
+            A22 += other.A22; A23 += other.A23;
+            A33 += other.A33;
+        }
+
+        double Evaluate(float3 point) const
+        {
+            double x = point.x;
+            double y = point.y;
+            double z = point.z;
+            return A00 * x * x + A11 * y * y + A22 * z * z + A33
+                + 2.0 * (A01 * x * y + A02 * x * z + A12 * y * z + A03 * x + A13 * y + A23 * z);
+        }
+    };
+
+    struct Collapse
+    {
+        double Error;
+        uint32_t From;
+        uint32_t To;
+        uint32_t Version;
+
+        // Ties are broken by vertex index so that the order of collapses never depends on how the queue happens to be implemented
+        bool operator >(const Collapse& other) const
+        { return Error != other.Error ? Error > other.Error : From > other.From; }
+    };
+
+    // Collapsing vertices whose normals are further apart than this (~45 degrees) would visibly change the shading
+    const float MinCollapseNormalDot = 0.7f;
+
+    // Triangles whose normal rotates further than this (~78 degrees) during a collapse, or ends up this far from the average of its vertex normals, are
+    // considered flipped
+    const float MinTriangleNormalDot = 0.2f;
+
+    inline float3 TriangleNormal(float3 a, float3 b, float3 c)
+    { return (b - a).Cross(c - a); }
+}
+
+SimplifiedMesh SimplifyMesh(std::span<const float3> positions, std::span<const float3> normals, std::span<const uint32_t> indices, uint32_t targetIndexCount, float maxError)
+{
+    Assert(indices.size() % 3 == 0);
+    Assert(normals.size() == positions.size());
+
+    const uint32_t vertexCount = (uint32_t)positions.size();
+    const uint32_t triangleCount = (uint32_t)(indices.size() / 3);
+
+    std::vector<uint32_t> triangles(indices.begin(), indices.end());
+    std::vector<bool> isTriangleAlive(triangleCount, true);
+    uint32_t aliveTriangleCount = triangleCount;
+
+    std::vector<std::vector<uint32_t>> vertexTriangles(vertexCount);
+    std::vector<Quadric> quadrics(vertexCount, Quadric { });
+
+    for (uint32_t t = 0; t < triangleCount; t++)
+    {
+        uint32_t a = triangles[t * 3 + 0];
+        uint32_t b = triangles[t * 3 + 1];
+        uint32_t c = triangles[t * 3 + 2];
+        Assert(a < vertexCount && b < vertexCount && c < vertexCount);
+
+        // Degenerate triangles are invisible, so we might as well drop them
+        if (a == b || b == c || a == c)
+        {
+            isTriangleAlive[t] = false;
+            aliveTriangleCount--;
+            continue;
+        }
+
+        vertexTriangles[a].push_back(t);
+        vertexTriangles[b].push_back(t);
+        vertexTriangles[c].push_back(t);
+
+        // Every corner gets the unweighted quadric of the triangle's plane so that quadric errors are squared distances
+        float3 normal = TriangleNormal(positions[a], positions[b], positions[c]);
+        float length = normal.Length();
+        if (length > 0.f)
+        {
+            normal = normal / length;
+            Quadric plane = Quadric::FromPlane(normal.x, normal.y, normal.z, -normal.Dot(positions[a]));
+            quadrics[a] += plane;
+            quadrics[b] += plane;
+            quadrics[c] += plane;
+        }
+    }
+
+    // Lock vertices on edges which aren't shared by exactly two triangles (IE: open borders and non-manifold edges) so that the silhouette is preserved
+    std::vector<bool> isLocked(vertexCount, false);
+    {
+        std::vector<uint64_t> edges;
+        edges.reserve(aliveTriangleCount * 3);
+        for (uint32_t t = 0; t < triangleCount; t++)
+        {
+            if (!isTriangleAlive[t])
+            { continue; }
+
+            for (uint32_t k = 0; k < 3; k++)
+            {
+                uint32_t a = triangles[t * 3 + k];
+                uint32_t b = triangles[t * 3 + (k + 1) % 3];
+                edges.push_back(((uint64_t)std::min(a, b) << 32) | std::max(a, b));
+            }
+        }
+
+        std::sort(edges.begin(), edges.end());
+        for (size_t i = 0; i < edges.size();)
+        {
+            size_t end = i + 1;
+            while (end < edges.size() && edges[end] == edges[i])
+            { end++; }
+
+            if (end - i != 2)
+            {
+                isLocked[edges[i] >> 32] = true;
+                isLocked[edges[i] & 0xFFFFFFFF] = true;
+            }
+
+            i = end;
+        }
+    }
+
+    // Lock seams, the vertices on either side of a UV or normal discontinuity share a position and must stay together to avoid opening cracks
+    {
+        std::vector<uint32_t> sortedVertices;
+        for (uint32_t i = 0; i < vertexCount; i++)
+        {
+            if (!vertexTriangles[i].empty())
+            { sortedVertices.push_back(i); }
+        }
+
+        auto PositionLess = [&](uint32_t a, uint32_t b)
+            {
+                float3 pa = positions[a];
+                float3 pb = positions[b];
+                return pa.x != pb.x ? pa.x < pb.x : pa.y != pb.y ? pa.y < pb.y : pa.z < pb.z;
+            };
+        std::sort(sortedVertices.begin(), sortedVertices.end(), PositionLess);
+
+        for (size_t i = 1; i < sortedVertices.size(); i++)
+        {
+            if (!PositionLess(sortedVertices[i - 1], sortedVertices[i]))
+            {
+                isLocked[sortedVertices[i - 1]] = true;
+                isLocked[sortedVertices[i]] = true;
+            }
+        }
+    }
+
+    auto GatherNeighbors = [&](uint32_t vertex, std::vector<uint32_t>& neighbors)
+        {
+            neighbors.clear();
+            for (uint32_t t : vertexTriangles[vertex])
+            {
+                if (isTriangleAlive[t])
+                { neighbors.insert(neighbors.end(), &triangles[t * 3], &triangles[t * 3] + 3); }
+            }
+
+            std::sort(neighbors.begin(), neighbors.end());
+            neighbors.erase(std::unique(neighbors.begin(), neighbors.end()), neighbors.end());
+        };
+
+    std::vector<uint32_t> fromNeighbors;
+    std::vector<uint32_t> toNeighbors;
+    auto IsCollapseValid = [&](uint32_t from, uint32_t to)
+        {
+            float3 fromNormal = normals[from];
+            if (fromNormal.Dot(normals[to]) < MinCollapseNormalDot)
+            { return false; }
+
+            // The two vertices may only share the neighbors opposite the edge between them, otherwise the collapse would pinch the surface into a
+            // non-manifold fold (The lists include both vertices themselves, hence four.)
+            GatherNeighbors(from, fromNeighbors);
+            GatherNeighbors(to, toNeighbors);
+            size_t sharedCount = 0;
+            for (size_t i = 0, j = 0; i < fromNeighbors.size() && j < toNeighbors.size();)
+            {
+                if (fromNeighbors[i] < toNeighbors[j]) { i++; }
+                else if (fromNeighbors[i] > toNeighbors[j]) { j++; }
+                else { sharedCount++; i++; j++; }
+            }
+
+            if (sharedCount > 4)
+            { return false; }
+
+            for (uint32_t t : vertexTriangles[from])
+            {
+                const uint32_t* triangle = &triangles[t * 3];
+                if (!isTriangleAlive[t] || triangle[0] == to || triangle[1] == to || triangle[2] == to)
+                { continue; }
+
+                float3 corners[3] = { positions[triangle[0]], positions[triangle[1]], positions[triangle[2]] };
+                float3 before = TriangleNormal(corners[0], corners[1], corners[2]);
+                float3 vertexNormals = float3(0.f, 0.f, 0.f);
+
+                for (uint32_t k = 0; k < 3; k++)
+                {
+                    if (triangle[k] == from)
+                    { corners[k] = positions[to]; }
+                    vertexNormals = vertexNormals + normals[triangle[k] == from ? to : triangle[k]];
+                }
+
+                float3 after = TriangleNormal(corners[0], corners[1], corners[2]);
+                float afterLength = after.Length();
+                if (afterLength == 0.f || after.Dot(before) < MinTriangleNormalDot * afterLength * before.Length())
+                { return false; }
+
+                // Each collapse only rotates a triangle a little, but several of them in a row could still turn it on its side
+                if (after.Dot(vertexNormals) < MinTriangleNormalDot * afterLength * vertexNormals.Length())
+                { return false; }
+            }
+
+            return true;
+        };
+
+    // Every vertex proposes collapsing onto whichever of its neighbors would introduce the least error
+    // Proposals are invalidated by bumping the vertex's version whenever its neighborhood changes.
+    std::vector<uint32_t> versions(vertexCount, 0);
+    std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> queue;
+    std::vector<Collapse> candidates;
+    std::vector<uint32_t> candidateNeighbors;
+    auto ProposeCollapse = [&](uint32_t from)
+        {
+            if (isLocked[from])
+            { return; }
+
+            // Validating a collapse is much more expensive than measuring its error, so candidates are validated from best to worst until one passes
+            candidates.clear();
+            GatherNeighbors(from, candidateNeighbors);
+            for (uint32_t to : candidateNeighbors)
+            {
+                if (to != from)
+                { candidates.push_back({ .Error = quadrics[from].Evaluate(positions[to]) + quadrics[to].Evaluate(positions[to]), .From = from, .To = to, .Version = versions[from] }); }
+            }
+
+            std::sort(candidates.begin(), candidates.end(), [](const Collapse& a, const Collapse& b) { return a.Error != b.Error ? a.Error < b.Error : a.To < b.To; });
+            for (const Collapse& candidate : candidates)
+            {
+                if (IsCollapseValid(from, candidate.To))
+                {
+                    queue.push(candidate);
+                    break;
+                }
+            }
+        };
+
+    for (uint32_t i = 0; i < vertexCount; i++)
+    { ProposeCollapse(i); }
+
+    const double maxErrorSquared = (double)maxError * (double)maxError;
+    double largestError = 0.0;
+    std::vector<uint32_t> neighbors;
+    while (aliveTriangleCount * 3 > targetIndexCount && !queue.empty())
+    {
+        Collapse collapse = queue.top();
+        queue.pop();
+
+        if (collapse.Version != versions[collapse.From])
+        { continue; }
+
+        // Proposals which are still valid always have up-to-date errors, so nothing left in the queue can be any better
+        if (collapse.Error > maxErrorSquared)
+        { break; }
+
+        const uint32_t from = collapse.From;
+        const uint32_t to = collapse.To;
+        for (uint32_t t : vertexTriangles[from])
+        {
+            if (!isTriangleAlive[t])
+            { continue; }
+
+            uint32_t* triangle = &triangles[t * 3];
+            if (triangle[0] == to || triangle[1] == to || triangle[2] == to)
+            {
+                isTriangleAlive[t] = false;
+                aliveTriangleCount--;
+            }
+            else
+            {
+                *std::find(triangle, triangle + 3, from) = to;
+                vertexTriangles[to].push_back(t);
+            }
+        }
+
+        vertexTriangles[from] = { };
+        quadrics[to] += quadrics[from];
+        isLocked[from] = true;
+        versions[from]++;
+        largestError = std::max(largestError, collapse.Error);
+
+        std::erase_if(vertexTriangles[to], [&](uint32_t t) { return !isTriangleAlive[t]; });
+
+        // The target and everything around it now has a different neighborhood, so their proposals need to be redone
+        // (The target is included in its own neighbors unless it was left without any triangles.)
+        GatherNeighbors(to, neighbors);
+        for (uint32_t neighbor : neighbors)
+        {
+            versions[neighbor]++;
+            ProposeCollapse(neighbor);
+        }
+    }
+
+    SimplifiedMesh result = { .Error = (float)std::sqrt(largestError) };
+    result.Indices.reserve(aliveTriangleCount * 3);
+    for (uint32_t t = 0; t < triangleCount; t++)
+    {
+        if (isTriangleAlive[t])
+        { result.Indices.insert(result.Indices.end(), &triangles[t * 3], &triangles[t * 3] + 3); }
+    }
+
+    return result;
+}
@@ -0,0 +1,20 @@
+#pragma once
+#include "Math.h"
+
+#include <span>
+#include <vector>
+
+//! The result of SimplifyMesh
+struct SimplifiedMesh
+{
+    std::vector<uint32_t> Indices;
+
+    //! Estimate of the largest distance between the simplified and original surfaces in the units of the positions
+    float Error;
+};
+
+//! Simplifies an indexed triangle list to targetIndexCount indices or fewer using quadric error metric guided half-edge collapses
+//! Vertices are only ever collapsed onto their neighbors, so the result indexes the original vertex buffers and needs no new vertex data.
+//! Vertices on open borders and seams (IE: positions shared by several vertices because their UVs or normals differ) are never collapsed. Collapses which
+//! would flip a triangle, merge vertices with very different normals, or introduce more than maxError are rejected, so the target may not be reached.
+SimplifiedMesh SimplifyMesh(std::span<const float3> positions, std::span<const float3> normals, std::span<const uint32_t> indices, uint32_t targetIndexCount, float maxError);
@@ -0,0 +1,240 @@
+#include "pch.h"
+#include "MeshletBuilder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace
+{
+    const uint8_t NotInMeshlet = 0xFF;
+    static_assert(MaxMeshletVertices < NotInMeshlet);
+
+    // Meshlets whose triangles stray further than this (~84 degrees) from the cone axis would only ever be back facing when viewed from almost directly
+    // behind, so they don't bother with a cone at all
+    const float MinConeDot = 0.1f;
+
+    // Triangles which aren't connected to a meshlet only join it when they face within ~60 degrees of it, otherwise the leftovers scattered around a mesh
+    // after the connected regions run out end up in a meshlet with no cone and bounds spanning the whole mesh
+    const float MinDisconnectedDot = 0.5f;
+}
+
+void MeshletStatistics::operator +=(const MeshletStatistics& other)
+{
+    MeshletCount += other.MeshletCount;
+    VertexCount += other.VertexCount;
+    TriangleCount += other.TriangleCount;
+    ConeCount += other.ConeCount;
+    ConeAngleSum += other.ConeAngleSum;
+}
+
+MeshletMesh BuildMeshlets(std::span<const float3> positions, std::span<const uint32_t> indices)
+{
+    Assert(indices.size() % 3 == 0);
+
+    const uint32_t vertexCount = (uint32_t)positions.size();
+    const uint32_t triangleCount = (uint32_t)(indices.size() / 3);
+
+    MeshletMesh result;
+    result.Indices.reserve(indices.size());
+    result.Triangles.reserve(indices.size());
+
+    // Unit face normals, degenerate triangles are left with a zero normal so that they don't affect the cones
+    std::vector<float3> triangleNormals(triangleCount, float3::Zero);
+    for (uint32_t t = 0; t < triangleCount; t++)
+    {
+        float3 a = positions[indices[t * 3 + 0]];
+        float3 b = positions[indices[t * 3 + 1]];
+        float3 c = positions[indices[t * 3 + 2]];
+        float3 normal = (b - a).Cross(c - a);
+        float length = normal.Length();
+        if (length > 0.f)
+        { triangleNormals[t] = normal / length; }
+    }
+
+    // Build the triangles of each vertex as one flat list
+    std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+    for (uint32_t index : indices)
+    {
+        Assert(index < vertexCount);
+        adjacencyOffsets[index + 1]++;
+    }
+
+    for (uint32_t i = 0; i < vertexCount; i++)
+    { adjacencyOffsets[i + 1] += adjacencyOffsets[i]; }
+
+    std::vector<uint32_t> adjacency(indices.size());
+    {
+        std::vector<uint32_t> cursors(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+        for (uint32_t i = 0; i < indices.size(); i++)
+        { adjacency[cursors[indices[i]]++] = i / 3; }
+    }
+
+    // Vertices which have no triangles left waiting for a meshlet can be skipped when searching for candidates
+    std::vector<uint32_t> liveTriangleCounts(vertexCount);
+    for (uint32_t i = 0; i < vertexCount; i++)
+    { liveTriangleCounts[i] = adjacencyOffsets[i + 1] - adjacencyOffsets[i]; }
+
+    std::vector<bool> isEmitted(triangleCount, false);
+    std::vector<uint8_t> meshletSlots(vertexCount, NotInMeshlet);
+
+    Meshlet meshlet = { };
+    float3 meshletNormal = float3::Zero;
+    std::vector<uint32_t> meshletTriangles;
+
+    auto NewVertexCount = [&](uint32_t t)
+        {
+            uint32_t count = 0;
+            for (uint32_t k = 0; k < 3; k++)
+            {
+                if (meshletSlots[indices[t * 3 + k]] == NotInMeshlet)
+                { count++; }
+            }
+            return count;
+        };
+
+    auto FlushMeshlet = [&]()
+        {
+            if (meshlet.TriangleCount == 0)
+            { return; }
+
+            std::span<const uint32_t> vertices = std::span(result.Vertices).subspan(meshlet.FirstVertex, meshlet.VertexCount);
+            float3 min = positions[vertices[0]];
+            float3 max = min;
+            for (uint32_t vertex : vertices)
+            {
+                float3 position = positions[vertex];
+                min = float3(std::min(min.x, position.x), std::min(min.y, position.y), std::min(min.z, position.z));
+                max = float3(std::max(max.x, position.x), std::max(max.y, position.y), std::max(max.z, position.z));
+            }
+
+            MeshletBounds bounds = { .Center = (min + max) * 0.5f, .Radius = 0.f, .ConeAxis = float3::Zero, .ConeCutoff = 1.f };
+            for (uint32_t vertex : vertices)
+            { bounds.Radius = std::max(bounds.Radius, (positions[vertex] - bounds.Center).Length()); }
+
+            float axisLength = meshletNormal.Length();
+            if (axisLength > 0.f)
+            {
+                bounds.ConeAxis = meshletNormal / axisLength;
+
+                float minDot = 1.f;
+                for (uint32_t t : meshletTriangles)
+                {
+                    if (triangleNormals[t].LengthSquared() > 0.f)
+                    { minDot = std::min(minDot, triangleNormals[t].Dot(bounds.ConeAxis)); }
+                }
+
+                // The cutoff is the sine of the cone's half angle
+                if (minDot >= MinConeDot)
+                { bounds.ConeCutoff = std::sqrt(1.f - minDot * minDot); }
+            }
+
+            for (uint32_t vertex : vertices)
+            { meshletSlots[vertex] = NotInMeshlet; }
+
+            result.Meshlets.push_back(meshlet);
+            result.Bounds.push_back(bounds);
+
+            meshlet =
+            {
+                .FirstVertex = (uint32_t)result.Vertices.size(),
+                .VertexCount = 0,
+                .FirstTriangle = (uint32_t)(result.Triangles.size() / 3),
+                .TriangleCount = 0,
+            };
+            meshletNormal = float3::Zero;
+            meshletTriangles.clear();
+        };
+
+    uint32_t scanCursor = 0;
+    for (uint32_t emittedCount = 0; emittedCount < triangleCount; emittedCount++)
+    {
+        // Prefer triangles which add the fewest new vertices, breaking ties by how well they line up with the meshlet's average normal
+        uint32_t best = UINT32_MAX;
+        uint32_t bestNewVertexCount = UINT32_MAX;
+        float bestAlignment = -std::numeric_limits<float>::infinity();
+        for (uint32_t i = meshlet.FirstVertex; i < result.Vertices.size(); i++)
+        {
+            uint32_t vertex = result.Vertices[i];
+            if (liveTriangleCounts[vertex] == 0)
+            { continue; }
+
+            for (uint32_t j = adjacencyOffsets[vertex]; j < adjacencyOffsets[vertex + 1]; j++)
+            {
+                uint32_t t = adjacency[j];
+                if (isEmitted[t])
+                { continue; }
+
+                uint32_t newVertexCount = NewVertexCount(t);
+                float alignment = triangleNormals[t].Dot(meshletNormal);
+                if (newVertexCount < bestNewVertexCount || (newVertexCount == bestNewVertexCount && alignment > bestAlignment))
+                {
+                    best = t;
+                    bestNewVertexCount = newVertexCount;
+                    bestAlignment = alignment;
+                }
+            }
+        }
+
+        // Nothing connected to the meshlet is left, so continue with the next triangle in index order
+        // (Indices are usually ordered for the vertex cache, so it's typically nearby.)
+        if (best == UINT32_MAX)
+        {
+            while (isEmitted[scanCursor])
+            { scanCursor++; }
+
+            best = scanCursor;
+            if (triangleNormals[best].Dot(meshletNormal) < MinDisconnectedDot * meshletNormal.Length())
+            { FlushMeshlet(); }
+
+            bestNewVertexCount = NewVertexCount(best);
+        }
+
+        // If the triangle doesn't fit it starts the next meshlet instead, which keeps that meshlet adjacent to this one
+        if (meshlet.VertexCount + bestNewVertexCount > MaxMeshletVertices || meshlet.TriangleCount == MaxMeshletTriangles)
+        { FlushMeshlet(); }
+
+        for (uint32_t k = 0; k < 3; k++)
+        {
+            uint32_t vertex = indices[best * 3 + k];
+            if (meshletSlots[vertex] == NotInMeshlet)
+            {
+                meshletSlots[vertex] = (uint8_t)meshlet.VertexCount++;
+                result.Vertices.push_back(vertex);
+            }
+
+            result.Triangles.push_back(meshletSlots[vertex]);
+            result.Indices.push_back(vertex);
+            liveTriangleCounts[vertex]--;
+        }
+
+        isEmitted[best] = true;
+        meshlet.TriangleCount++;
+        meshletNormal = meshletNormal + triangleNormals[best];
+        meshletTriangles.push_back(best);
+    }
+
+    FlushMeshlet();
+    return result;
+}
+
+MeshletStatistics MeasureMeshlets(const MeshletMesh& mesh)
+{
+    MeshletStatistics result = { .MeshletCount = (uint32_t)mesh.Meshlets.size() };
+    for (const Meshlet& meshlet : mesh.Meshlets)
+    {
+        result.VertexCount += meshlet.VertexCount;
+        result.TriangleCount += meshlet.TriangleCount;
+    }
+
+    for (const MeshletBounds& bounds : mesh.Bounds)
+    {
+        if (bounds.ConeCutoff < 1.f)
+        {
+            result.ConeCount++;
+            result.ConeAngleSum += std::asin(bounds.ConeCutoff);
+        }
+    }
+
+    return result;
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include "Math.h"
+
+#include <span>
+#include <vector>
+
+//! A small cluster of triangles, sized for mesh shader style processing
+struct Meshlet
+{
+    //! The range of MeshletMesh::Vertices referenced by the meshlet
+    uint32_t FirstVertex;
+    uint32_t VertexCount;
+
+    //! The range of triangles in MeshletMesh::Triangles and MeshletMesh::Indices (in triangles, not indices)
+    uint32_t FirstTriangle;
+    uint32_t TriangleCount;
+};
+
+//! Culling data for a meshlet
+struct MeshletBounds
+{
+    float3 Center;
+    float Radius;
+
+    //! The meshlet can be culled as back facing when dot(Center - eye, ConeAxis) >= ConeCutoff * length(Center - eye) + Radius
+    //! Meshlets whose triangles face too many directions have a cutoff of 1, which never passes.
+    float3 ConeAxis;
+    float ConeCutoff;
+};
+
+//! The result of BuildMeshlets
+struct MeshletMesh
+{
+    std::vector<Meshlet> Meshlets;
+    std::vector<MeshletBounds> Bounds;
+
+    //! Indices of the original vertices used by each meshlet
+    std::vector<uint32_t> Vertices;
+
+    //! Three meshlet-relative vertex indices per triangle
+    std::vector<uint8_t> Triangles;
+
+    //! The original index buffer reordered so that each meshlet's triangles are contiguous, drawing a range of it draws a range of meshlets
+    std::vector<uint32_t> Indices;
+};
+
+//! Measurements of how well a set of meshlets turned out, see MeasureMeshlets
+struct MeshletStatistics
+{
+    uint32_t MeshletCount;
+    uint32_t VertexCount;
+    uint32_t TriangleCount;
+
+    //! Meshlets whose normal cone is narrow enough to ever be back face culled and the sum of their cone half angles in radians
+    uint32_t ConeCount;
+    float ConeAngleSum;
+
+    void operator +=(const MeshletStatistics& other);
+
+    //! Vertex transforms per triangle if every meshlet transforms each of its vertices once, lower is better (A perfectly regular grid approaches 0.5.)
+    inline float VerticesPerTriangle() const { return TriangleCount == 0 ? 0.f : (float)VertexCount / (float)TriangleCount; }
+    inline float AverageConeAngle() const { return ConeCount == 0 ? 0.f : ConeAngleSum / (float)ConeCount; }
+};
+
+static constexpr uint32_t MaxMeshletVertices = 64;
+static constexpr uint32_t MaxMeshletTriangles = 124;
+
+//! Splits an indexed triangle list into meshlets of at most MaxMeshletVertices vertices and MaxMeshletTriangles triangles
+//! Meshlets are grown greedily from triangles which add the fewest new vertices and face the same way as the rest of the meshlet, which keeps both the
+//! vertex reuse and the normal cones tight. Every input triangle ends up in exactly one meshlet.
+MeshletMesh BuildMeshlets(std::span<const float3> positions, std::span<const uint32_t> indices);
+
+MeshletStatistics MeasureMeshlets(const MeshletMesh& mesh);
@@ -0,0 +1,354 @@
+#include "pch.h"
+#include "OcclusionRasterizer.h"
+
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <limits>
+#include <xmmintrin.h>
+
+namespace
+{
+    // Boxes are pulled towards the camera by this fraction of their depth when testing them
+    // (Without this, occluders which are flush with the face of their own bounding box can end up occluding themselves due to rounding.)
+    const float QueryDepthBias = 1e-4f;
+
+    // Occluders are additionally clipped against a plane this far in front of the camera
+    // The real near plane is extremely close, and triangles which come that close project to screen coordinates too large for the edge functions to stay precise.
+    // (Clipping away the part of an occluder which is this close to the camera only makes it occlude less.)
+    const float OccluderNearPlane = 0.1f;
+
+    // Distance to the near plane in clip space, see Frustum
+    inline float NearPlaneDistance(float4 clip)
+    { return clip.w - clip.z; }
+
+    inline float OccluderNearPlaneDistance(float4 clip)
+    { return clip.w - OccluderNearPlane; }
+
+    inline float4 Lerp(float4 a, float4 b, float t)
+    { return a + (b - a) * t; }
+
+    // Clips a convex polygon against a plane, returns the new vertex count
+    // The output must have room for one more vertex than the input.
+    template<typename TDistance>
+    uint32_t ClipPolygon(const float4* input, uint32_t inputCount, float4* output, TDistance distance)
+    {
+        uint32_t outputCount = 0;
+        for (uint32_t i = 0; i < inputCount; i++)
+        {
+            float4 current = input[i];
+            float4 next = input[(i + 1) % inputCount];
+            float currentDistance = distance(current);
+            float nextDistance = distance(next);
+
+            if (currentDistance >= 0.f)
+            { output[outputCount++] = current; }
+
+            if ((currentDistance >= 0.f) != (nextDistance >= 0.f))
+            { output[outputCount++] = Lerp(current, next, currentDistance / (currentDistance - nextDistance)); }
+        }
+
+        return outputCount;
+    }
+
+    inline int ToPixel(float x, uint32_t limit)
+    { return (int)std::clamp(x, 0.f, (float)limit); }
+}
+
+OcclusionRasterizer::OcclusionRasterizer(uint32_t width, uint32_t height)
+    : m_Width(width), m_Height(height)
+{
+    Assert(width % TileWidth == 0 && height % TileHeight == 0);
+    static_assert(TileWidth % BlockSize == 0 && TileHeight % BlockSize == 0);
+    static_assert(TileWidth % 4 == 0 && "Tiles are rasterized four pixels at a time.");
+
+    m_TileCountX = width / TileWidth;
+    m_TileCountY = height / TileHeight;
+    m_BlockCountX = width / BlockSize;
+
+    m_Depth.resize(width * height);
+    m_BlockMinDepth.resize(m_BlockCountX * (height / BlockSize));
+}
+
+void OcclusionRasterizer::Render(const OccluderGeometry& occluders, const float4x4& viewProjection, JobSystem& jobs)
+{
+    m_ViewProjection = viewProjection;
+
+    // Transform the vertices
+    const uint32_t vertexBatchSize = 1024;
+    uint32_t vertexCount = (uint32_t)occluders.Positions.size();
+    m_ClipPositions.resize(vertexCount);
+    jobs.ParallelFor(Math::DivRoundUp(vertexCount, vertexBatchSize), [&](uint32_t batch)
+        {
+            uint32_t end = std::min((batch + 1) * vertexBatchSize, vertexCount);
+            for (uint32_t i = batch * vertexBatchSize; i < end; i++)
+            { m_ClipPositions[i] = viewProjection.Transform(float4(occluders.Positions[i], 1.f)); }
+        });
+
+    // Set up the triangles and bin them into the tiles they touch
+    // Each job gets its own batch so that binning doesn't need any synchronization
+    uint32_t tileCount = m_TileCountX * m_TileCountY;
+    uint32_t batchCount = jobs.WorkerCount() + 1;
+    m_SetupBatches.resize(batchCount);
+    for (SetupBatch& batch : m_SetupBatches)
+    {
+        batch.Triangles.clear();
+        batch.TileBins.resize(tileCount);
+        for (std::vector<uint32_t>& bin : batch.TileBins)
+        { bin.clear(); }
+    }
+
+    uint32_t triangleCount = occluders.TriangleCount();
+    jobs.ParallelFor(batchCount, [&](uint32_t batchIndex)
+        {
+            uint32_t start = (uint32_t)((uint64_t)triangleCount * batchIndex / batchCount);
+            uint32_t end = (uint32_t)((uint64_t)triangleCount * (batchIndex + 1) / batchCount);
+            for (uint32_t i = start; i < end; i++)
+            {
+                const uint32_t* indices = &occluders.Indices[i * 3];
+                SetupTriangle(m_SetupBatches[batchIndex], m_ClipPositions[indices[0]], m_ClipPositions[indices[1]], m_ClipPositions[indices[2]]);
+            }
+        });
+
+    // Rasterize
+    jobs.ParallelFor(tileCount, [&](uint32_t tileIndex) { RasterizeTile(tileIndex); });
+}
+
+void OcclusionRasterizer::SetupTriangle(SetupBatch& batch, float4 a, float4 b, float4 c)
+{
+    // Most triangles don't come anywhere near the camera, so they can skip clipping entirely
+    if (std::min({ NearPlaneDistance(a), NearPlaneDistance(b), NearPlaneDistance(c) }) >= 0.f
+        && std::min({ OccluderNearPlaneDistance(a), OccluderNearPlaneDistance(b), OccluderNearPlaneDistance(c) }) >= 0.f)
+    {
+        AddTriangle(batch, a, b, c);
+        return;
+    }
+
+    // Clip against the near planes
+    // There's no far plane and the screen edges are handled by clamping the bounding rectangle, so these are the only planes we need
+    float4 triangle[3] = { a, b, c };
+    float4 clipped[4];
+    float4 polygon[5];
+    uint32_t clippedCount = ClipPolygon(triangle, 3, clipped, NearPlaneDistance);
+    uint32_t polygonCount = ClipPolygon(clipped, clippedCount, polygon, OccluderNearPlaneDistance);
+
+    for (uint32_t i = 2; i < polygonCount; i++)
+    { AddTriangle(batch, polygon[0], polygon[i - 1], polygon[i]); }
+}
+
+void OcclusionRasterizer::AddTriangle(SetupBatch& batch, float4 a, float4 b, float4 c)
+{
+    // Project to screen space, Y points down
+    float3 screen[3];
+    float4 clip[3] = { a, b, c };
+    for (uint32_t i = 0; i < 3; i++)
+    {
+        float inverseW = 1.f / clip[i].w;
+        screen[i] = float3
+        (
+            (clip[i].x * inverseW * 0.5f + 0.5f) * (float)m_Width,
+            (0.5f - clip[i].y * inverseW * 0.5f) * (float)m_Height,
+            clip[i].z * inverseW
+        );
+    }
+
+    // Front faces are counter-clockwise on screen, which is a negative area since Y points down
+    // (This also rejects degenerate triangles.)
+    float3 ab = screen[1] - screen[0];
+    float3 ac = screen[2] - screen[0];
+    float area = ab.x * ac.y - ac.x * ab.y;
+    if (!(area < 0.f))
+    { return; }
+
+    RasterTriangle triangle;
+    triangle.MinX = ToPixel(std::floor(std::min({ screen[0].x, screen[1].x, screen[2].x })), m_Width);
+    triangle.MinY = ToPixel(std::floor(std::min({ screen[0].y, screen[1].y, screen[2].y })), m_Height);
+    triangle.MaxX = ToPixel(std::ceil(std::max({ screen[0].x, screen[1].x, screen[2].x })), m_Width);
+    triangle.MaxY = ToPixel(std::ceil(std::max({ screen[0].y, screen[1].y, screen[2].y })), m_Height);
+
+    if (triangle.MinX >= triangle.MaxX || triangle.MinY >= triangle.MaxY)
+    { return; }
+
+    for (uint32_t i = 0; i < 3; i++)
+    {
+        float3 from = screen[i];
+        float3 to = screen[(i + 1) % 3];
+        triangle.EdgeA[i] = to.y - from.y;
+        triangle.EdgeB[i] = from.x - to.x;
+        triangle.EdgeC[i] = -(triangle.EdgeA[i] * from.x + triangle.EdgeB[i] * from.y);
+    }
+
+    // Depth is linear in screen space for perspective projections, so it can be described by a plane
+    // (The plane is solved in double precision since clipped triangles can extend thousands of pixels off screen, where rounding in float is enough to pull
+    // the depth in front of the occluder by more than QueryDepthBias.)
+    double abX = (double)screen[1].x - screen[0].x, abY = (double)screen[1].y - screen[0].y, abZ = (double)screen[1].z - screen[0].z;
+    double acX = (double)screen[2].x - screen[0].x, acY = (double)screen[2].y - screen[0].y, acZ = (double)screen[2].z - screen[0].z;
+    double doubleArea = abX * acY - acX * abY;
+    double depthDx = (abZ * acY - acZ * abY) / doubleArea;
+    double depthDy = (abX * acZ - acX * abZ) / doubleArea;
+    triangle.DepthDx = (float)depthDx;
+    triangle.DepthDy = (float)depthDy;
+    triangle.DepthC = (float)(screen[0].z - depthDx * screen[0].x - depthDy * screen[0].y);
+
+    uint32_t triangleIndex = (uint32_t)batch.Triangles.size();
+    batch.Triangles.push_back(triangle);
+
+    uint32_t firstTileX = triangle.MinX / TileWidth;
+    uint32_t firstTileY = triangle.MinY / TileHeight;
+    uint32_t lastTileX = (triangle.MaxX - 1) / TileWidth;
+    uint32_t lastTileY = (triangle.MaxY - 1) / TileHeight;
+    for (uint32_t tileY = firstTileY; tileY <= lastTileY; tileY++)
+    {
+        for (uint32_t tileX = firstTileX; tileX <= lastTileX; tileX++)
+        { batch.TileBins[tileY * m_TileCountX + tileX].push_back(triangleIndex); }
+    }
+}
+
+void OcclusionRasterizer::RasterizeTile(uint32_t tileIndex)
+{
+    int tileMinX = (int)((tileIndex % m_TileCountX) * TileWidth);
+    int tileMinY = (int)((tileIndex / m_TileCountX) * TileHeight);
+    int tileMaxX = tileMinX + TileWidth;
+    int tileMaxY = tileMinY + TileHeight;
+
+    for (int y = tileMinY; y < tileMaxY; y++)
+    { std::fill_n(&m_Depth[y * m_Width + tileMinX], TileWidth, 0.f); }
+
+    const __m128 pixelOffsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+    const __m128 zero = _mm_setzero_ps();
+
+    for (const SetupBatch& batch : m_SetupBatches)
+    {
+        for (uint32_t triangleIndex : batch.TileBins[tileIndex])
+        {
+            const RasterTriangle& triangle = batch.Triangles[triangleIndex];
+
+            // Pixels are processed in groups of four, so the starting column is aligned down to a group
+            int minX = std::max(triangle.MinX, tileMinX) & ~3;
+            int maxX = std::min(triangle.MaxX, tileMaxX);
+            int minY = std::max(triangle.MinY, tileMinY);
+            int maxY = std::min(triangle.MaxY, tileMaxY);
+
+            __m128 edgeA0 = _mm_set1_ps(triangle.EdgeA[0]);
+            __m128 edgeA1 = _mm_set1_ps(triangle.EdgeA[1]);
+            __m128 edgeA2 = _mm_set1_ps(triangle.EdgeA[2]);
+            __m128 depthDx = _mm_set1_ps(triangle.DepthDx);
+
+            for (int y = minY; y < maxY; y++)
+            {
+                float pixelY = (float)y + 0.5f;
+                __m128 edgeRow0 = _mm_set1_ps(triangle.EdgeB[0] * pixelY + triangle.EdgeC[0]);
+                __m128 edgeRow1 = _mm_set1_ps(triangle.EdgeB[1] * pixelY + triangle.EdgeC[1]);
+                __m128 edgeRow2 = _mm_set1_ps(triangle.EdgeB[2] * pixelY + triangle.EdgeC[2]);
+                __m128 depthRow = _mm_set1_ps(triangle.DepthDy * pixelY + triangle.DepthC);
+                float* row = &m_Depth[y * m_Width];
+                bool enteredTriangle = false;
+
+                for (int x = minX; x < maxX; x += 4)
+                {
+                    __m128 pixelX = _mm_add_ps(_mm_set1_ps((float)x), pixelOffsets);
+                    __m128 edge0 = _mm_add_ps(_mm_mul_ps(edgeA0, pixelX), edgeRow0);
+                    __m128 edge1 = _mm_add_ps(_mm_mul_ps(edgeA1, pixelX), edgeRow1);
+                    __m128 edge2 = _mm_add_ps(_mm_mul_ps(edgeA2, pixelX), edgeRow2);
+                    __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(edge0, zero), _mm_cmpge_ps(edge1, zero)), _mm_cmpge_ps(edge2, zero));
+                    // Triangles are convex, so once we've left one we won't enter it again on this row
+                    if (_mm_movemask_ps(inside) == 0)
+                    {
+                        if (enteredTriangle)
+                        { break; }
+                        continue;
+                    }
+
+                    enteredTriangle = true;
+
+                    // Keep the nearest depth, which is the largest one since we use reverse Z
+                    __m128 depth = _mm_add_ps(_mm_mul_ps(depthDx, pixelX), depthRow);
+                    __m128 previous = _mm_loadu_ps(row + x);
+                    __m128 nearest = _mm_max_ps(previous, depth);
+                    _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, previous)));
+                }
+            }
+        }
+    }
+
+    // Update the hierarchical depth for the blocks within this tile
+    for (int blockY = tileMinY; blockY < tileMaxY; blockY += BlockSize)
+    {
+        for (int blockX = tileMinX; blockX < tileMaxX; blockX += BlockSize)
+        {
+            __m128 minimum = _mm_loadu_ps(&m_Depth[blockY * m_Width + blockX]);
+            for (int y = blockY; y < blockY + (int)BlockSize; y++)
+            {
+                for (int x = blockX; x < blockX + (int)BlockSize; x += 4)
+                { minimum = _mm_min_ps(minimum, _mm_loadu_ps(&m_Depth[y * m_Width + x])); }
+            }
+
+            alignas(16) float lanes[4];
+            _mm_store_ps(lanes, minimum);
+            m_BlockMinDepth[(blockY / BlockSize) * m_BlockCountX + blockX / BlockSize] = std::min({ lanes[0], lanes[1], lanes[2], lanes[3] });
+        }
+    }
+}
+
+bool OcclusionRasterizer::IsVisible(const BoundingBox& box) const
+{
+    if (box.IsEmpty())
+    { return false; }
+
+    // Find the screen rectangle covered by the box and the depth of its nearest point
+    float minX = std::numeric_limits<float>::infinity();
+    float minY = std::numeric_limits<float>::infinity();
+    float maxX = -std::numeric_limits<float>::infinity();
+    float maxY = -std::numeric_limits<float>::infinity();
+    float nearestDepth = 0.f;
+    for (uint32_t i = 0; i < 8; i++)
+    {
+        float3 corner = float3((i & 1) ? box.Max.x : box.Min.x, (i & 2) ? box.Max.y : box.Min.y, (i & 4) ? box.Max.z : box.Min.z);
+        float4 clip = m_ViewProjection.Transform(float4(corner, 1.f));
+
+        // Projecting boxes which cross the near plane is unreliable, and they're likely very close to the camera anyway
+        if (NearPlaneDistance(clip) < 0.f || clip.w <= 0.f)
+        { return true; }
+
+        float inverseW = 1.f / clip.w;
+        float x = (clip.x * inverseW * 0.5f + 0.5f) * (float)m_Width;
+        float y = (0.5f - clip.y * inverseW * 0.5f) * (float)m_Height;
+        minX = std::min(minX, x);
+        minY = std::min(minY, y);
+        maxX = std::max(maxX, x);
+        maxY = std::max(maxY, y);
+        nearestDepth = std::max(nearestDepth, clip.z * inverseW);
+    }
+
+    nearestDepth *= 1.f + QueryDepthBias;
+
+    // The rectangle covers every pixel the box touches
+    int pixelMinX = ToPixel(std::floor(minX), m_Width);
+    int pixelMinY = ToPixel(std::floor(minY), m_Height);
+    int pixelMaxX = ToPixel(std::ceil(maxX), m_Width);
+    int pixelMaxY = ToPixel(std::ceil(maxY), m_Height);
+
+    // The box is hidden if every pixel it covers has an occluder in front of it
+    // Most blocks can be rejected based on their minimum depth, we only need to look at individual pixels when that fails
+    for (int blockY = pixelMinY / (int)BlockSize; blockY * (int)BlockSize < pixelMaxY; blockY++)
+    {
+        for (int blockX = pixelMinX / (int)BlockSize; blockX * (int)BlockSize < pixelMaxX; blockX++)
+        {
+            if (m_BlockMinDepth[blockY * m_BlockCountX + blockX] > nearestDepth)
+            { continue; }
+
+            int endY = std::min((blockY + 1) * (int)BlockSize, pixelMaxY);
+            int endX = std::min((blockX + 1) * (int)BlockSize, pixelMaxX);
+            for (int y = std::max(blockY * (int)BlockSize, pixelMinY); y < endY; y++)
+            {
+                for (int x = std::max(blockX * (int)BlockSize, pixelMinX); x < endX; x++)
+                {
+                    if (m_Depth[y * m_Width + x] <= nearestDepth)
+                    { return true; }
+                }
+            }
+        }
+    }
+
+    return false;
+}
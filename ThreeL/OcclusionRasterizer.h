@@ -0,0 +1,85 @@
+#pragma once
+#include "Bounds.h"
+
+#include <span>
+#include <vector>
+
+class JobSystem;
+
+//! World space triangles to be rasterized as occluders
+//! Triangles are single-sided with counter-clockwise front faces, double-sided occluders should include both windings.
+struct OccluderGeometry
+{
+    std::vector<float3> Positions;
+    std::vector<uint32_t> Indices;
+
+    inline uint32_t TriangleCount() const { return (uint32_t)(Indices.size() / 3); }
+};
+
+//! A low resolution software depth rasterizer for culling geometry hidden behind large occluders
+//! Depth follows the same reverse Z convention as float4x4::MakePerspectiveTransformReverseZ, so the buffer is cleared to 0 and larger depths are nearer.
+//! The buffer is split into tiles which are rasterized in parallel, each tile also maintains a hierarchical minimum depth over 8x8 blocks to speed up queries.
+//! Occluders are sampled at pixel centers, so geometry only visible through gaps narrower than a pixel of the buffer may be culled.
+class OcclusionRasterizer
+{
+public:
+    static constexpr uint32_t TileWidth = 32;
+    static constexpr uint32_t TileHeight = 32;
+    static constexpr uint32_t BlockSize = 8;
+
+private:
+    // A triangle which has been clipped, projected, and prepared for rasterization
+    // Edge functions are A * x + B * y + C and are positive inside the triangle, depth is DepthDx * x + DepthDy * y + DepthC
+    struct RasterTriangle
+    {
+        float EdgeA[3];
+        float EdgeB[3];
+        float EdgeC[3];
+        float DepthDx;
+        float DepthDy;
+        float DepthC;
+        int MinX;
+        int MinY;
+        int MaxX; // Exclusive
+        int MaxY; // Exclusive
+    };
+
+    // Triangles set up by a single job along with the tiles they touch
+    struct SetupBatch
+    {
+        std::vector<RasterTriangle> Triangles;
+        std::vector<std::vector<uint32_t>> TileBins;
+    };
+
+    uint32_t m_Width;
+    uint32_t m_Height;
+    uint32_t m_TileCountX;
+    uint32_t m_TileCountY;
+    uint32_t m_BlockCountX;
+
+    float4x4 m_ViewProjection;
+    std::vector<float> m_Depth;
+    std::vector<float> m_BlockMinDepth;
+
+    std::vector<float4> m_ClipPositions;
+    std::vector<SetupBatch> m_SetupBatches;
+
+    void SetupTriangle(SetupBatch& batch, float4 a, float4 b, float4 c);
+    void AddTriangle(SetupBatch& batch, float4 a, float4 b, float4 c);
+    void RasterizeTile(uint32_t tileIndex);
+
+public:
+    //! The width and height must be multiples of the tile size
+    OcclusionRasterizer(uint32_t width, uint32_t height);
+
+    //! Clears the buffer and rasterizes the occluders from the point of view of the specified view projection matrix
+    void Render(const OccluderGeometry& occluders, const float4x4& viewProjection, JobSystem& jobs);
+
+    //! Returns false if the box is entirely hidden behind the occluders from the last call to Render
+    //! Boxes which cross the near plane are always considered visible.
+    bool IsVisible(const BoundingBox& box) const;
+
+    inline uint32_t Width() const { return m_Width; }
+    inline uint32_t Height() const { return m_Height; }
+    inline std::span<const float> Depth() const { return m_Depth; }
+};
@@ -0,0 +1,47 @@
+#include "pch.h"
+#include "ParticleDispatchArguments.h"
+
+namespace ParticleDispatchArguments
+{
+    static DispatchSize MakeDispatchSize(uint32_t threadCount, uint32_t groupSize)
+    {
+        uint32_t groupCount = Math::DivRoundUp(threadCount, groupSize);
+        return
+        {
+            .Arguments = { .ThreadGroupCountX = groupCount, .ThreadGroupCountY = 1, .ThreadGroupCountZ = 1 },
+            .ThreadsDispatched = groupCount * groupSize,
+            .ThreadsUseful = threadCount,
+        };
+    }
+
+    DispatchSize ForUpdate(uint32_t livingParticleCount, uint32_t capacity)
+    {
+        // Living particle count can be beyond capacity when spawning fails due to the system being full
+        livingParticleCount = std::min(livingParticleCount, capacity);
+        return MakeDispatchSize(livingParticleCount, ShaderInterop::ParticleSystem::UpdateGroupSize);
+    }
+
+    DispatchSize ForSpawn(uint32_t survivorCount, uint32_t toSpawn, uint32_t capacity)
+    {
+        survivorCount = std::min(survivorCount, capacity);
+        toSpawn = std::min(toSpawn, capacity - survivorCount);
+        return MakeDispatchSize(toSpawn, ShaderInterop::ParticleSystem::SpawnGroupSize);
+    }
+
+    DispatchSize ForLighting(uint32_t particleCount, uint32_t capacity)
+    {
+        particleCount = std::min(particleCount, capacity);
+        return MakeDispatchSize(particleCount, ShaderInterop::ParticleLighting::GroupSize);
+    }
+
+    ShaderInterop::ParticleDispatchStatistics Statistics(const DispatchSize& update, const DispatchSize& spawn)
+    {
+        return
+        {
+            .UpdateThreadsDispatched = update.ThreadsDispatched,
+            .UpdateThreadsUseful = update.ThreadsUseful,
+            .SpawnThreadsDispatched = spawn.ThreadsDispatched,
+            .SpawnThreadsUseful = spawn.ThreadsUseful,
+        };
+    }
+}
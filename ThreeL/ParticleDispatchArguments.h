@@ -0,0 +1,26 @@
+#pragma once
+#include "ShaderInterop.h"
+
+//! CPU equivalent of the indirect dispatch argument computation done by MainPrepareUpdateIndirect and MainPrepareSpawnIndirect in ParticleSystem.cs.hlsl
+//! The GPU is the source of truth for the living particle count, this exists so that the sizing logic can be checked (and reasoned about) away from the GPU.
+namespace ParticleDispatchArguments
+{
+    struct DispatchSize
+    {
+        D3D12_DISPATCH_ARGUMENTS Arguments;
+        uint32_t ThreadsDispatched;
+        uint32_t ThreadsUseful;
+    };
+
+    //! Arguments for updating a system which had livingParticleCount particles at the end of the previous frame
+    DispatchSize ForUpdate(uint32_t livingParticleCount, uint32_t capacity);
+
+    //! Arguments for spawning toSpawn particles into a system where survivorCount particles survived the update
+    DispatchSize ForSpawn(uint32_t survivorCount, uint32_t toSpawn, uint32_t capacity);
+
+    //! Arguments for evaluating per-particle lighting for a system with particleCount particles
+    DispatchSize ForLighting(uint32_t particleCount, uint32_t capacity);
+
+    //! Combines the update and spawn sizes into the statistics reported by ParticleSystem::DispatchStatistics
+    ShaderInterop::ParticleDispatchStatistics Statistics(const DispatchSize& update, const DispatchSize& spawn);
+}
@@ -0,0 +1,108 @@
+#include "pch.h"
+#include "ParticleLightingReference.h"
+
+namespace ParticleLightingReference
+{
+    static float ClampedDot(float3 a, float3 b)
+    {
+        return Math::Clamp(a.Dot(b), 0.f, 1.f);
+    }
+
+    static float3 Lerp(float3 a, float3 b, float t)
+    {
+        return a + (b - a) * t;
+    }
+
+    // See Brdf in PbrBrdf.hlsli
+    struct Brdf
+    {
+        float3 Normal;
+        float3 ViewDirection;
+        float RoughnessAlpha;
+        float NdotV;
+        float3 DiffuseColor;
+        float3 F0;
+        float3 F90;
+
+        float3 Diffuse = float3::Zero;
+        float3 Specular = float3::Zero;
+
+        Brdf(const Surface& surface)
+        {
+            Normal = surface.Normal;
+            ViewDirection = (surface.EyePosition - surface.WorldPosition).Normalized();
+            RoughnessAlpha = surface.Roughness * surface.Roughness;
+            NdotV = ClampedDot(Normal, ViewDirection);
+            DiffuseColor = Lerp(surface.BaseColor, float3::Zero, surface.Metalness);
+            F0 = Lerp(float3(0.04f, 0.04f, 0.04f), surface.BaseColor, surface.Metalness);
+            F90 = float3::One;
+        }
+
+        void ApplyLight(float3 surfaceToLight, float3 lightColor, float lightIntensity)
+        {
+            float3 halfVector = (surfaceToLight + ViewDirection).Normalized();
+
+            // Particles pretend light shines through them, see ApplyLight in PbrBrdf.hlsli
+            if (Normal.Dot(surfaceToLight) < 0.f)
+            { Normal = -Normal; }
+            float NdotL = 1.f;
+
+            float NdotH = ClampedDot(Normal, halfVector);
+            float VdotH = ClampedDot(ViewDirection, halfVector);
+
+            // Fresnel (Schlick)
+            float vhPart = 1.f - VdotH;
+            float vh2 = vhPart * vhPart;
+            float vh5 = vh2 * vh2 * vhPart;
+            float3 fresnel = F0 + (F90 - F0) * vh5;
+
+            // Specular (GGX)
+            float alphaSquared = RoughnessAlpha * RoughnessAlpha;
+            float visibility = NdotL * std::sqrt(NdotV * NdotV * (1.f - alphaSquared) + alphaSquared);
+            visibility += NdotV * std::sqrt(NdotL * NdotL * (1.f - alphaSquared) + alphaSquared);
+            visibility = visibility > 0.f ? 0.5f / visibility : 0.f;
+
+            float distribution = NdotH * NdotH * (alphaSquared - 1.f) + 1.f;
+            distribution = alphaSquared / (Math::Pi * distribution * distribution);
+
+            Diffuse = Diffuse + lightIntensity * lightColor * NdotL * (float3::One - fresnel) * (DiffuseColor * Math::InversePi);
+            Specular = Specular + lightIntensity * lightColor * NdotL * fresnel * (visibility * distribution);
+        }
+
+        void ApplyDirectionalLight(float3 lightDirection, float3 lightColor, float lightIntensity)
+        {
+            ApplyLight(-lightDirection, lightColor, lightIntensity);
+        }
+
+        void ApplyPointLight(const ShaderInterop::LightInfo& light, float3 worldPosition)
+        {
+            float3 surfaceToLight = light.Position - worldPosition;
+
+            float distanceSquared = surfaceToLight.LengthSquared();
+            float rangeSquared = light.Range * light.Range;
+            float distanceOverRange = distanceSquared / rangeSquared;
+            distanceOverRange *= distanceOverRange;
+            float lightAttenuation = Math::Clamp(1.f - distanceOverRange, 0.f, 1.f) / std::max(distanceSquared, 0.0001f);
+
+            if (lightAttenuation <= 0.f)
+            { return; }
+
+            // Note that like the GPU implementation the light direction is not normalized
+            ApplyLight(surfaceToLight, light.Color, light.Intensity * lightAttenuation);
+        }
+    };
+
+    Result Evaluate(const Surface& surface, std::span<const ShaderInterop::LightInfo> pointLights)
+    {
+        Brdf brdf(surface);
+
+        // See ApplySceneDirectionalLights in PbrBrdf.hlsli
+        brdf.ApplyDirectionalLight(float3(-0.5f, -0.707f, -0.5f).Normalized(), float3::One, 0.2f);
+        brdf.ApplyDirectionalLight(float3(0.5f, 0.707f, 0.5f).Normalized(), float3::One, 0.2f * 0.4f);
+
+        for (const ShaderInterop::LightInfo& light : pointLights)
+        { brdf.ApplyPointLight(light, surface.WorldPosition); }
+
+        return { brdf.Diffuse, brdf.Specular };
+    }
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include "ShaderInterop.h"
+#include "Vector3.h"
+
+#include <span>
+
+//! CPU implementation of the per-particle lighting evaluated by ParticleLighting.cs.hlsl
+//! This mirrors the PBR_IS_PARTICLE variant of Brdf in PbrBrdf.hlsli so that the lighting math can be checked away from the GPU.
+namespace ParticleLightingReference
+{
+    struct Surface
+    {
+        float3 BaseColor;
+        float Metalness;
+        float Roughness;
+        float3 WorldPosition;
+        float3 Normal;
+        float3 EyePosition;
+    };
+
+    struct Result
+    {
+        float3 Diffuse;
+        float3 Specular;
+    };
+
+    //! Evaluates the scene's static directional lights followed by the specified point lights
+    //! Unlike the GPU the point lights are not culled by the light linked list, the caller is expected to provide the relevant lights.
+    Result Evaluate(const Surface& surface, std::span<const ShaderInterop::LightInfo> pointLights);
+}
@@ -21,24 +21,35 @@ ParticleSystem::ParticleSystem(ResourceManager& resources, const std::wstring& d
     , m_SpawnPoint(spawnPoint)
     , m_Capacity(capacity)
 {
-    D3D12_HEAP_PROPERTIES heapProperties = { D3D12_HEAP_TYPE_DEFAULT };
+    // Sort lists are raw buffers of index/key pairs
+    uint32_t sortBufferSizeBytes = sizeof(uint2) * m_Capacity;
+    D3D12_RESOURCE_DESC sortBufferDescription = DescribeBufferResource(sortBufferSizeBytes, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
+    D3D12_UNORDERED_ACCESS_VIEW_DESC sortBufferUavDescription =
+    {
+        .Format = DXGI_FORMAT_R32_TYPELESS,
+        .ViewDimension = D3D12_UAV_DIMENSION_BUFFER,
+        .Buffer =
+        {
+            .FirstElement = 0,
+            .NumElements = sortBufferSizeBytes / sizeof(uint32_t),
+            .Flags = D3D12_BUFFER_UAV_FLAG_RAW,
+        },
+    };
 
     // Allocate state buffers
     D3D12_RESOURCE_DESC stateBufferDescription = DescribeBufferResource(ShaderInterop::SizeOfParticleState * capacity, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
 
     for (size_t i = 0; i < 2; i++)
     {
-        ComPtr<ID3D12Resource> buffer;
-        AssertSuccess(m_Graphics.Device()->CreateCommittedResource
+        ComPtr<ID3D12Resource> buffer = m_Graphics.GpuMemoryManager().CreateResource
         (
-            &heapProperties,
+            GpuMemoryCategory::Particles,
+            D3D12_HEAP_TYPE_DEFAULT,
             D3D12_HEAP_FLAG_CREATE_NOT_ZEROED,
-            &stateBufferDescription,
+            stateBufferDescription,
             D3D12_RESOURCE_STATE_COMMON,
-            nullptr,
-            IID_PPV_ARGS(&buffer)
-        ));
-        buffer->SetName(std::format(L"'{}' Particle States {}", debugName, i).c_str());
+            std::format(L"'{}' Particle States {}", debugName, i)
+        );
 
         D3D12_UNORDERED_ACCESS_VIEW_DESC uavDescription =
         {
@@ -57,67 +68,258 @@ ParticleSystem::ParticleSystem(ResourceManager& resources, const std::wstring& d
         m_ParticleStateBuffers[i].Counter = UavCounter(m_Graphics, std::format(L"'{}' Particle Counter {}", debugName, i));
         m_ParticleStateBuffers[i].Uav = m_Graphics.ResourceDescriptorManager().CreateUnorderedAccessView(buffer.Get(), m_ParticleStateBuffers[i].Counter, uavDescription);
         m_ParticleStateBuffers[i].Buffer = RawGpuResource(std::move(buffer));
+
+        // Allocate sort buffer
+        ComPtr<ID3D12Resource> sortBuffer = m_Graphics.GpuMemoryManager().CreateResource
+        (
+            GpuMemoryCategory::Particles,
+            D3D12_HEAP_TYPE_DEFAULT,
+            D3D12_HEAP_FLAG_CREATE_NOT_ZEROED,
+            sortBufferDescription,
+            D3D12_RESOURCE_STATE_COMMON,
+            std::format(L"'{}' Particle Sort Buffer {}", debugName, i)
+        );
+
+        m_ParticleStateBuffers[i].SortListUav = m_Graphics.ResourceDescriptorManager().CreateUnorderedAccessView(sortBuffer.Get(), nullptr, sortBufferUavDescription);
+        m_ParticleStateBuffers[i].SortList = RawGpuResource(std::move(sortBuffer));
     }
 
     // Allocate sprite buffer
     D3D12_RESOURCE_DESC spriteBufferDescription = DescribeBufferResource(ShaderInterop::SizeOfParticleSprite * capacity, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
-    ComPtr<ID3D12Resource> spriteBuffer;
-    AssertSuccess(m_Graphics.Device()->CreateCommittedResource
+    ComPtr<ID3D12Resource> spriteBuffer = m_Graphics.GpuMemoryManager().CreateResource
     (
-        &heapProperties,
+        GpuMemoryCategory::Particles,
+        D3D12_HEAP_TYPE_DEFAULT,
         D3D12_HEAP_FLAG_CREATE_NOT_ZEROED,
-        &spriteBufferDescription,
+        spriteBufferDescription,
         D3D12_RESOURCE_STATE_COMMON,
-        nullptr,
-        IID_PPV_ARGS(&spriteBuffer)
-    ));
-    spriteBuffer->SetName(std::format(L"'{}' Particle Sprites", debugName).c_str());
+        std::format(L"'{}' Particle Sprites", debugName)
+    );
     m_ParticleSpriteBuffer = RawGpuResource(std::move(spriteBuffer));
 
-    // Allocate sort buffer
-    uint32_t sortBufferSizeBytes = sizeof(uint2) * m_Capacity;
-    D3D12_RESOURCE_DESC sortBufferDescription = DescribeBufferResource(sortBufferSizeBytes, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
-    ComPtr<ID3D12Resource> sortBuffer;
-    AssertSuccess(m_Graphics.Device()->CreateCommittedResource
+    // Allocate lighting buffer
+    D3D12_RESOURCE_DESC lightingBufferDescription = DescribeBufferResource(ShaderInterop::SizeOfParticleLighting * capacity, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
+    ComPtr<ID3D12Resource> lightingBuffer = m_Graphics.GpuMemoryManager().CreateResource
     (
-        &heapProperties,
+        GpuMemoryCategory::Particles,
+        D3D12_HEAP_TYPE_DEFAULT,
         D3D12_HEAP_FLAG_CREATE_NOT_ZEROED,
-        &sortBufferDescription,
+        lightingBufferDescription,
         D3D12_RESOURCE_STATE_COMMON,
-        nullptr,
-        IID_PPV_ARGS(&sortBuffer)
-    ));
-    sortBuffer->SetName(std::format(L"'{}' Particle Sort Buffer", debugName).c_str());
-
-    D3D12_UNORDERED_ACCESS_VIEW_DESC uavDescription =
-    {
-        .Format = DXGI_FORMAT_R32_TYPELESS,
-        .ViewDimension = D3D12_UAV_DIMENSION_BUFFER,
-        .Buffer =
-        {
-            .FirstElement = 0,
-            .NumElements = sortBufferSizeBytes / sizeof(uint32_t),
-            .Flags = D3D12_BUFFER_UAV_FLAG_RAW,
-        },
-    };
-
-    m_ParticleSpriteSortBufferUav = m_Graphics.ResourceDescriptorManager().CreateUnorderedAccessView(sortBuffer.Get(), nullptr, uavDescription);
-    m_ParticleSpriteSortBuffer = RawGpuResource(std::move(sortBuffer));
+        std::format(L"'{}' Particle Lighting", debugName)
+    );
+    m_ParticleLightingBuffer = RawGpuResource(std::move(lightingBuffer));
 
     // Allocate DrawIndirect arguments buffer
     D3D12_RESOURCE_DESC drawIndirectArgumentsDescription = DescribeBufferResource(sizeof(D3D12_DRAW_ARGUMENTS), D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
-    ComPtr<ID3D12Resource> drawIndirectArguments;
-    AssertSuccess(m_Graphics.Device()->CreateCommittedResource
+    ComPtr<ID3D12Resource> drawIndirectArguments = m_Graphics.GpuMemoryManager().CreateResource
     (
-        &heapProperties,
+        GpuMemoryCategory::Particles,
+        D3D12_HEAP_TYPE_DEFAULT,
         D3D12_HEAP_FLAG_CREATE_NOT_ZEROED,
-        &drawIndirectArgumentsDescription,
+        drawIndirectArgumentsDescription,
         D3D12_RESOURCE_STATE_COMMON,
-        nullptr,
-        IID_PPV_ARGS(&drawIndirectArguments)
-    ));
-    drawIndirectArguments->SetName(std::format(L"'{}' Particle Render Arguments", debugName).c_str());
+        std::format(L"'{}' Particle Render Arguments", debugName)
+    );
     m_DrawIndirectArguments = RawGpuResource(std::move(drawIndirectArguments));
+
+    // Allocate indirect dispatch arguments and statistics
+    uint32_t dispatchArgumentsSize = ShaderInterop::ParticleSystem::DispatchStatistics + sizeof(ShaderInterop::ParticleDispatchStatistics);
+    D3D12_RESOURCE_DESC dispatchIndirectArgumentsDescription = DescribeBufferResource(dispatchArgumentsSize, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
+    ComPtr<ID3D12Resource> dispatchIndirectArguments = m_Graphics.GpuMemoryManager().CreateResource
+    (
+        GpuMemoryCategory::Particles,
+        D3D12_HEAP_TYPE_DEFAULT,
+        D3D12_HEAP_FLAG_CREATE_NOT_ZEROED,
+        dispatchIndirectArgumentsDescription,
+        D3D12_RESOURCE_STATE_COMMON,
+        std::format(L"'{}' Particle Dispatch Arguments", debugName)
+    );
+    m_DispatchIndirectArguments = RawGpuResource(std::move(dispatchIndirectArguments));
+
+    {
+        D3D12_RESOURCE_DESC readbackDescription = DescribeBufferResource(sizeof(ShaderInterop::ParticleDispatchStatistics) * DispatchStatisticsBufferCount, D3D12_RESOURCE_FLAG_NONE);
+        m_DispatchStatisticsReadbackBuffer = m_Graphics.GpuMemoryManager().CreateResource
+        (
+            GpuMemoryCategory::Particles,
+            D3D12_HEAP_TYPE_READBACK,
+            D3D12_HEAP_FLAG_NONE,
+            readbackDescription,
+            D3D12_RESOURCE_STATE_COPY_DEST,
+            std::format(L"'{}' Particle Dispatch Statistics Readback", debugName)
+        );
+    }
+
+    // Allocate temporal sort resources
+    {
+        ComPtr<ID3D12Resource> mergeScratch = m_Graphics.GpuMemoryManager().CreateResource
+        (
+            GpuMemoryCategory::Particles,
+            D3D12_HEAP_TYPE_DEFAULT,
+            D3D12_HEAP_FLAG_CREATE_NOT_ZEROED,
+            sortBufferDescription,
+            D3D12_RESOURCE_STATE_COMMON,
+            std::format(L"'{}' Particle Sort Merge Scratch", debugName)
+        );
+        m_SortMergeScratchUav = m_Graphics.ResourceDescriptorManager().CreateUnorderedAccessView(mergeScratch.Get(), nullptr, sortBufferUavDescription);
+        m_SortMergeScratch = RawGpuResource(std::move(mergeScratch));
+
+        D3D12_RESOURCE_DESC statisticsDescription = DescribeBufferResource(ShaderInterop::ParticleSortFixUp::StatisticsSize, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
+        ComPtr<ID3D12Resource> statistics = m_Graphics.GpuMemoryManager().CreateResource
+        (
+            GpuMemoryCategory::Particles,
+            D3D12_HEAP_TYPE_DEFAULT,
+            D3D12_HEAP_FLAG_NONE,
+            statisticsDescription,
+            D3D12_RESOURCE_STATE_COMMON,
+            std::format(L"'{}' Particle Sort Statistics", debugName)
+        );
+
+        D3D12_UNORDERED_ACCESS_VIEW_DESC statisticsUavDescription =
+        {
+            .Format = DXGI_FORMAT_R32_TYPELESS,
+            .ViewDimension = D3D12_UAV_DIMENSION_BUFFER,
+            .Buffer =
+            {
+                .FirstElement = 0,
+                .NumElements = ShaderInterop::ParticleSortFixUp::StatisticsSize / sizeof(uint32_t),
+                .Flags = D3D12_BUFFER_UAV_FLAG_RAW,
+            },
+        };
+        m_SortStatisticsUav = m_Graphics.ResourceDescriptorManager().CreateUnorderedAccessView(statistics.Get(), nullptr, statisticsUavDescription);
+        m_SortStatistics = RawGpuResource(std::move(statistics));
+
+        D3D12_RESOURCE_DESC fixUpArgumentsDescription = DescribeBufferResource(sizeof(D3D12_DISPATCH_ARGUMENTS) * 2, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
+        ComPtr<ID3D12Resource> fixUpArguments = m_Graphics.GpuMemoryManager().CreateResource
+        (
+            GpuMemoryCategory::Particles,
+            D3D12_HEAP_TYPE_DEFAULT,
+            D3D12_HEAP_FLAG_CREATE_NOT_ZEROED,
+            fixUpArgumentsDescription,
+            D3D12_RESOURCE_STATE_COMMON,
+            std::format(L"'{}' Particle Sort Fix-up Arguments", debugName)
+        );
+        m_SortFixUpArguments = RawGpuResource(std::move(fixUpArguments));
+
+        m_SortFallbackItemCount = UavCounter(m_Graphics, std::format(L"'{}' Particle Sort Fallback Item Count", debugName));
+    }
+}
+
+void ParticleSystem::BindUpdateRootParameters(ComputeContext& context, const ShaderInterop::ParticleSystemParams& params, D3D12_GPU_VIRTUAL_ADDRESS perFrameCb, ParticleStateBuffer& inputStateBuffer, ParticleStateBuffer& outputStateBuffer)
+{
+    context->SetComputeRootSignature(m_Resources.ParticleSystemRootSignature);
+    context->SetComputeRoot32BitConstants(ShaderInterop::ParticleSystem::RpParams, sizeof(params) / sizeof(uint32_t), &params, 0);
+    context->SetComputeRootConstantBufferView(ShaderInterop::ParticleSystem::RpPerFrameCb, perFrameCb);
+    context->SetComputeRootShaderResourceView(ShaderInterop::ParticleSystem::RpParticleStatesIn, inputStateBuffer.Buffer.GpuAddress());
+    context->SetComputeRootShaderResourceView(ShaderInterop::ParticleSystem::RpLivingParticleCount, inputStateBuffer.Counter.GpuAddress());
+    context->SetComputeRootDescriptorTable(ShaderInterop::ParticleSystem::RpParticleStatesOut, outputStateBuffer.Uav.ResidentHandle());
+    context->SetComputeRootUnorderedAccessView(ShaderInterop::ParticleSystem::RpParticleSpritesOut, m_ParticleSpriteBuffer.GpuAddress());
+    context->SetComputeRootUnorderedAccessView(ShaderInterop::ParticleSystem::RpLivingParticleCountOut, outputStateBuffer.Counter.GpuAddress());
+    context->SetComputeRootUnorderedAccessView(ShaderInterop::ParticleSystem::RpDrawIndirectArguments, m_DrawIndirectArguments.GpuAddress());
+    context->SetComputeRootUnorderedAccessView(ShaderInterop::ParticleSystem::RpParticleSpriteSortBuffer, outputStateBuffer.SortList.GpuAddress());
+    context->SetComputeRootShaderResourceView(ShaderInterop::ParticleSystem::RpPreviousParticleSpriteSortBuffer, inputStateBuffer.SortList.GpuAddress());
+    context->SetComputeRootUnorderedAccessView(ShaderInterop::ParticleSystem::RpDispatchIndirectArguments, m_DispatchIndirectArguments.GpuAddress());
+}
+
+void ParticleSystem::BindSortFixUpRootParameters(ComputeContext& context, ParticleStateBuffer& outputStateBuffer)
+{
+    context.TransitionResource(m_SortMergeScratch, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+    context.TransitionResource(m_SortStatistics, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+    context.TransitionResource(m_SortFixUpArguments, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+    context.TransitionResource(m_SortFallbackItemCount, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+
+    ShaderInterop::ParticleSortFixUpParams params =
+    {
+        .ParticleCapacity = m_Capacity,
+        .StatisticsOffset = 0,
+        .WindowOffset = 0,
+        .MaxDisorderRatio = m_MaxSortDisorderRatio,
+    };
+
+    context->SetComputeRootSignature(m_Resources.ParticleSortFixUpRootSignature);
+    context->SetComputeRoot32BitConstants(ShaderInterop::ParticleSortFixUp::RpParams, sizeof(params) / sizeof(uint32_t), &params, 0);
+    context->SetComputeRootUnorderedAccessView(ShaderInterop::ParticleSortFixUp::RpLivingParticleCount, outputStateBuffer.Counter.GpuAddress());
+    context->SetComputeRootUnorderedAccessView(ShaderInterop::ParticleSortFixUp::RpSortList, outputStateBuffer.SortList.GpuAddress());
+    context->SetComputeRootUnorderedAccessView(ShaderInterop::ParticleSortFixUp::RpMergeScratch, m_SortMergeScratch.GpuAddress());
+    context->SetComputeRootUnorderedAccessView(ShaderInterop::ParticleSortFixUp::RpStatistics, m_SortStatistics.GpuAddress());
+    context->SetComputeRootUnorderedAccessView(ShaderInterop::ParticleSortFixUp::RpFixUpArguments, m_SortFixUpArguments.GpuAddress());
+    context->SetComputeRootUnorderedAccessView(ShaderInterop::ParticleSortFixUp::RpFallbackItemCount, m_SortFallbackItemCount.GpuAddress());
+}
+
+void ParticleSystem::MeasureSortDisorder(ComputeContext& context, uint32_t statisticsOffset)
+{
+    context->SetComputeRoot32BitConstant(ShaderInterop::ParticleSortFixUp::RpParams, statisticsOffset, offsetof(ShaderInterop::ParticleSortFixUpParams, StatisticsOffset) / sizeof(uint32_t));
+    context->SetPipelineState(m_Resources.ParticleSortMeasureDisorder);
+    context.Dispatch(Math::DivRoundUp(m_Capacity, ShaderInterop::ParticleSortFixUp::MeasureGroupSize));
+    context.UavBarrier(m_SortStatistics);
+}
+
+void ParticleSystem::FixUpSurvivorOrder(ComputeContext& context, ParticleStateBuffer& outputStateBuffer)
+{
+    PIXBeginEvent(&context, 42, L"Fix up '%s' survivor order", m_DebugName.c_str());
+    BindSortFixUpRootParameters(context, outputStateBuffer);
+    context.ClearUav(m_SortStatisticsUav, m_SortStatistics);
+    context.UavBarrier(m_SortStatistics);
+
+    // Estimate how disordered the survivors are and decide whether or not it's worth attempting to fix them up
+    MeasureSortDisorder(context, ShaderInterop::ParticleSortFixUp::StatisticsInitialInversions);
+    context->SetPipelineState(m_Resources.ParticleSortPrepareFixUp);
+    context.Dispatch(1);
+
+    // Fix up the survivors in two sets of windows, the second offset by half a window so that items can cross the boundaries of the first
+    context.TransitionResource(m_SortFixUpArguments, D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT);
+    context->SetPipelineState(m_Resources.ParticleSortFixUp);
+    context.DispatchIndirect(m_SortFixUpArguments, 0);
+    context.UavBarrier(outputStateBuffer.SortList);
+
+    uint32_t windowOffset = ShaderInterop::ParticleSortFixUp::FixUpWindowSize / 2;
+    context->SetComputeRoot32BitConstant(ShaderInterop::ParticleSortFixUp::RpParams, windowOffset, offsetof(ShaderInterop::ParticleSortFixUpParams, WindowOffset) / sizeof(uint32_t));
+    context.DispatchIndirect(m_SortFixUpArguments, sizeof(D3D12_DISPATCH_ARGUMENTS));
+    context.UavBarrier(outputStateBuffer.SortList);
+
+    // Check whether the fix-up was successful, spawned particles can only be merged into a sorted list of survivors
+    MeasureSortDisorder(context, ShaderInterop::ParticleSortFixUp::StatisticsFixedInversions);
+    PIXEndEvent(&context);
+}
+
+void ParticleSystem::FinishTemporalSort(ComputeContext& context, ParticleStateBuffer& outputStateBuffer, uint32_t spawnedCount)
+{
+    PIXBeginEvent(&context, 42, L"Finish '%s' temporal sort", m_DebugName.c_str());
+    BindSortFixUpRootParameters(context, outputStateBuffer);
+
+    // Merge the newly spawned particles into the survivors
+    // (If too many particles were spawned we leave them at the end of the list and let the full sort deal with it.)
+    if (spawnedCount > 0 && spawnedCount <= MaxSpawnedToMerge)
+    {
+        context->SetPipelineState(m_Resources.ParticleSortMergeSpawned);
+        context.Dispatch(Math::DivRoundUp(m_Capacity, ShaderInterop::ParticleSortFixUp::MergeGroupSize));
+        context.UavBarrier(m_SortMergeScratch);
+
+        // The merged list becomes the sort list, the old sort list becomes scratch space for next time
+        std::swap(outputStateBuffer.SortList, m_SortMergeScratch);
+        std::swap(outputStateBuffer.SortListUav, m_SortMergeScratchUav);
+        context->SetComputeRootUnorderedAccessView(ShaderInterop::ParticleSortFixUp::RpSortList, outputStateBuffer.SortList.GpuAddress());
+        context->SetComputeRootUnorderedAccessView(ShaderInterop::ParticleSortFixUp::RpMergeScratch, m_SortMergeScratch.GpuAddress());
+    }
+
+    // If the list still isn't sorted the full sort will run, otherwise it'll be told there's nothing to sort
+    MeasureSortDisorder(context, ShaderInterop::ParticleSortFixUp::StatisticsFinalInversions);
+    context->SetPipelineState(m_Resources.ParticleSortPrepareFallback);
+    context.Dispatch(1);
+    context.UavBarrier(m_SortFallbackItemCount);
+    PIXEndEvent(&context);
+
+    BitonicSortParams sortParams =
+    {
+        .SortList = outputStateBuffer.SortList,
+        .SortListUav = outputStateBuffer.SortListUav,
+        .Capacity = m_Capacity,
+        .ItemKind = BitonicSortParams::SeparateKeyIndex,
+        .ItemCountBuffer = m_SortFallbackItemCount,
+        .SkipPreSort = false,
+        .SortAscending = false,
+    };
+    m_Resources.BitonicSort.Sort(context, sortParams);
 }
 
 void ParticleSystem::Update(ComputeContext& context, float deltaTime, D3D12_GPU_VIRTUAL_ADDRESS perFrameCb, bool skipPrepareRender)
@@ -131,9 +333,6 @@ void ParticleSystem::Update(ComputeContext& context, float deltaTime, D3D12_GPU_
         m_Graphics.ComputeQueue().AwaitSyncPoint(m_RenderSyncPoint);
     }
 
-    context->SetComputeRootSignature(m_Resources.ParticleSystemRootSignature);
-    context->SetPipelineState(m_Resources.ParticleSystemUpdate);
-
     PIXBeginEvent(&context, 42, L"Update '%s' particle system", m_DebugName.c_str());
 
     // Determine number of particles to spawn this frame
@@ -151,35 +350,53 @@ void ParticleSystem::Update(ComputeContext& context, float deltaTime, D3D12_GPU_
     context.TransitionResource(inputStateBuffer.Counter, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
     context.TransitionResource(outputStateBuffer.Buffer, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
     context.TransitionResource(outputStateBuffer.Counter, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+    context.TransitionResource(inputStateBuffer.SortList, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+    context.TransitionResource(outputStateBuffer.SortList, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
     context.TransitionResource(m_ParticleSpriteBuffer, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
     context.TransitionResource(m_DrawIndirectArguments, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+    context.TransitionResource(m_DispatchIndirectArguments, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
 
     context.ClearUav(outputStateBuffer.Counter);
 
     // Bind root signature
     ShaderInterop::ParticleSystemParams params = m_Definition.CreateShaderParams(m_Capacity, toSpawn, m_SpawnPoint);
-    context->SetComputeRoot32BitConstants(ShaderInterop::ParticleSystem::RpParams, sizeof(params) / sizeof(uint32_t), &params, 0);
-    context->SetComputeRootConstantBufferView(ShaderInterop::ParticleSystem::RpPerFrameCb, perFrameCb);
-    context->SetComputeRootShaderResourceView(ShaderInterop::ParticleSystem::RpParticleStatesIn, inputStateBuffer.Buffer.GpuAddress());
-    context->SetComputeRootShaderResourceView(ShaderInterop::ParticleSystem::RpLivingParticleCount, inputStateBuffer.Counter.GpuAddress());
-    context->SetComputeRootDescriptorTable(ShaderInterop::ParticleSystem::RpParticleStatesOut, outputStateBuffer.Uav.ResidentHandle());
-    context->SetComputeRootUnorderedAccessView(ShaderInterop::ParticleSystem::RpParticleSpritesOut, m_ParticleSpriteBuffer.GpuAddress());
-    context->SetComputeRootUnorderedAccessView(ShaderInterop::ParticleSystem::RpLivingParticleCountOut, outputStateBuffer.Counter.GpuAddress());
-    context->SetComputeRootUnorderedAccessView(ShaderInterop::ParticleSystem::RpDrawIndirectArguments, m_DrawIndirectArguments.GpuAddress());
-    context->SetComputeRootUnorderedAccessView(ShaderInterop::ParticleSystem::RpParticleSpriteSortBuffer, m_ParticleSpriteSortBuffer.GpuAddress());
+    BindUpdateRootParameters(context, params, perFrameCb, inputStateBuffer, outputStateBuffer);
+
+    // Size the update dispatch based on the living particle count
+    // (We don't know the living particle count down on the CPU, so this has to be done with an indirect dispatch.)
+    context->SetPipelineState(m_Resources.ParticleSystemPrepareUpdateIndirect);
+    context.Dispatch(1);
+    context.TransitionResource(m_DispatchIndirectArguments, D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT);
 
     // Update existing particles
-    //PERF: For systems with very large capacities that are not near capacity, this ends up spawning a bunch of useless threads
-    // Could use indirect dispatch in order to only spawn the number needed to update the living particle count (which we don't know down on the CPU.)
-    context.Dispatch(Math::DivRoundUp(m_Capacity, ShaderInterop::ParticleSystem::UpdateGroupSize));
+    // When using the temporal sort, particles are visited in the order they were sorted last frame
+    bool useTemporalSort = m_SortMode == ParticleSortMode::Temporal;
+    context->SetPipelineState(useTemporalSort ? m_Resources.ParticleSystemUpdateTemporalSort : m_Resources.ParticleSystemUpdate);
+    context.DispatchIndirect(m_DispatchIndirectArguments, ShaderInterop::ParticleSystem::DispatchArgumentsUpdate);
+
+    // Fix up the order of the survivors before spawning new particles
+    // (This has to happen before spawning since the spawned particles are merged in separately.)
+    if (useTemporalSort && !skipPrepareRender)
+    {
+        context.UavBarrier();
+        FixUpSurvivorOrder(context, outputStateBuffer);
+        BindUpdateRootParameters(context, params, perFrameCb, inputStateBuffer, outputStateBuffer);
+    }
 
     // Spawn new particles
     // Spawning happens after updating so that we only spawn new particles when there's free particle slots
     if (toSpawn > 0)
     {
         context.UavBarrier(outputStateBuffer.Counter); // Update must finish allocating output particles before spawning can happen
+
+        // Size the spawn dispatch based on the number of free slots left after updating
+        context.TransitionResource(m_DispatchIndirectArguments, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+        context->SetPipelineState(m_Resources.ParticleSystemPrepareSpawnIndirect);
+        context.Dispatch(1);
+        context.TransitionResource(m_DispatchIndirectArguments, D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT);
+
         context->SetPipelineState(m_Resources.ParticleSystemSpawn);
-        context.Dispatch(Math::DivRoundUp(toSpawn, ShaderInterop::ParticleSystem::SpawnGroupSize));
+        context.DispatchIndirect(m_DispatchIndirectArguments, ShaderInterop::ParticleSystem::DispatchArgumentsSpawn);
     }
 
     // Don't bother preparing to render if we aren't going to do it
@@ -194,28 +411,39 @@ void ParticleSystem::Update(ComputeContext& context, float deltaTime, D3D12_GPU_
     }
 
     // Prepare parameters for the indirect draw
+    // This also prepares the lighting dispatch, so the dispatch arguments need to be writable again
     context.UavBarrier(outputStateBuffer.Counter); // We need to know the final particle count by this point
+    context.TransitionResource(m_DispatchIndirectArguments, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
     context->SetPipelineState(m_Resources.ParticleSystemPrepareDrawIndirect);
     context.Dispatch(1);
 
     // Sort particle sprites
-    BitonicSortParams sortParams =
+    if (useTemporalSort)
     {
-        .SortList = m_ParticleSpriteSortBuffer,
-        .SortListUav = m_ParticleSpriteSortBufferUav,
-        .Capacity = m_Capacity,
-        .ItemKind = BitonicSortParams::SeparateKeyIndex,
-        .ItemCountBuffer = outputStateBuffer.Counter,
-        .SkipPreSort = false,
-        .SortAscending = false,
-    };
-    m_Resources.BitonicSort.Sort(context, sortParams);
+        context.UavBarrier();
+        FinishTemporalSort(context, outputStateBuffer, toSpawn);
+    }
+    else
+    {
+        BitonicSortParams sortParams =
+        {
+            .SortList = outputStateBuffer.SortList,
+            .SortListUav = outputStateBuffer.SortListUav,
+            .Capacity = m_Capacity,
+            .ItemKind = BitonicSortParams::SeparateKeyIndex,
+            .ItemCountBuffer = outputStateBuffer.Counter,
+            .SkipPreSort = false,
+            .SortAscending = false,
+        };
+        m_Resources.BitonicSort.Sort(context, sortParams);
+    }
 
     // Transition all resources for their use in render
     context.UavBarrier();
     context.TransitionResource(m_ParticleSpriteBuffer, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
-    context.TransitionResource(m_ParticleSpriteSortBuffer, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+    context.TransitionResource(outputStateBuffer.SortList, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
     context.TransitionResource(m_DrawIndirectArguments, D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT);
+    context.TransitionResource(m_DispatchIndirectArguments, D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT);
 
     // Update complete, save a sync point for render
     PIXEndEvent(&context);
@@ -223,7 +451,39 @@ void ParticleSystem::Update(ComputeContext& context, float deltaTime, D3D12_GPU_
     { m_UpdateSyncPoint = context.Flush(); }
 }
 
-void ParticleSystem::Render(GraphicsContext& context, D3D12_GPU_VIRTUAL_ADDRESS perFrameCb, LightHeap& lightHeap, LightLinkedList& lightLinkedList, bool showLightBoundaries)
+void ParticleSystem::ComputeLighting(GraphicsContext& context, D3D12_GPU_VIRTUAL_ADDRESS perFrameCb, LightHeap& lightHeap, LightLinkedList& lightLinkedList, uint2 screenSize)
+{
+    PIXBeginEvent(&context, 42, L"Compute '%s' particle lighting", m_DebugName.c_str());
+    UavCounter& currentCounter = m_ParticleStateBuffers[m_CurrentParticleStateBuffer].Counter;
+    context.TransitionResource(currentCounter, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+    context.TransitionResource(m_ParticleLightingBuffer, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+    context.TransitionResource(m_DispatchIndirectArguments, D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT); // Written by MainPrepareDrawIndirect during update
+
+    ShaderInterop::ParticleLightingParams params =
+    {
+        .ParticleCapacity = m_Capacity,
+        .ScreenSize = screenSize,
+    };
+
+    context->SetComputeRootSignature(m_Resources.ParticleLightingRootSignature);
+    context->SetComputeRoot32BitConstants(ShaderInterop::ParticleLighting::RpParams, sizeof(params) / sizeof(uint32_t), &params, 0);
+    context->SetComputeRootConstantBufferView(ShaderInterop::ParticleLighting::RpPerFrameCb, perFrameCb);
+    context->SetComputeRootShaderResourceView(ShaderInterop::ParticleLighting::RpParticleBuffer, m_ParticleSpriteBuffer.GpuAddress());
+    context->SetComputeRootShaderResourceView(ShaderInterop::ParticleLighting::RpLivingParticleCount, currentCounter.GpuAddress());
+    context->SetComputeRootUnorderedAccessView(ShaderInterop::ParticleLighting::RpParticleLightingOut, m_ParticleLightingBuffer.GpuAddress());
+    context->SetComputeRootShaderResourceView(ShaderInterop::ParticleLighting::RpMaterialHeap, m_Resources.PbrMaterials.BufferGpuAddress());
+    context->SetComputeRootShaderResourceView(ShaderInterop::ParticleLighting::RpLightHeap, lightHeap.BufferGpuAddress());
+    context->SetComputeRootShaderResourceView(ShaderInterop::ParticleLighting::RpLightLinksHeap, lightLinkedList.LightLinksHeapGpuAddress());
+    context->SetComputeRootShaderResourceView(ShaderInterop::ParticleLighting::RpFirstLightLinkBuffer, lightLinkedList.FirstLightLinkBufferGpuAddress());
+
+    context->SetPipelineState(m_Resources.ParticleLighting);
+    context.Compute().DispatchIndirect(m_DispatchIndirectArguments, ShaderInterop::ParticleSystem::DispatchArgumentsLighting);
+
+    context.TransitionResource(m_ParticleLightingBuffer, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+    PIXEndEvent(&context);
+}
+
+void ParticleSystem::Render(GraphicsContext& context, D3D12_GPU_VIRTUAL_ADDRESS perFrameCb, LightHeap& lightHeap, LightLinkedList& lightLinkedList, uint2 screenSize, bool showLightBoundaries)
 {
     PIXBeginEvent(&context, 42, L"Render '%s' particle system", m_DebugName.c_str());
 
@@ -232,11 +492,19 @@ void ParticleSystem::Render(GraphicsContext& context, D3D12_GPU_VIRTUAL_ADDRESS
     if (!m_UpdateSyncPoint.WasReached())
     { m_Graphics.GraphicsQueue().AwaitSyncPoint(m_UpdateSyncPoint); }
 
+    // Evaluate lighting up front if we're lighting per-particle
+    // (The light boundaries debug visualization only exists for per-pixel lighting.)
+    bool usePerParticleLighting = m_LightingMode == ParticleLightingMode::PerParticle && !showLightBoundaries;
+    if (usePerParticleLighting)
+    { ComputeLighting(context, perFrameCb, lightHeap, lightLinkedList, screenSize); }
+    else
+    { context.TransitionResource(m_ParticleLightingBuffer, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE); }
+
     // Draw the particles
     context->SetGraphicsRootSignature(m_Resources.ParticleRenderRootSignature);
 
     context->SetGraphicsRootShaderResourceView(ShaderInterop::ParticleRender::RpParticleBuffer, m_ParticleSpriteBuffer.GpuAddress());
-    context->SetGraphicsRootShaderResourceView(ShaderInterop::ParticleRender::RpSortedParticleLookupBuffer, m_ParticleSpriteSortBuffer.GpuAddress());
+    context->SetGraphicsRootShaderResourceView(ShaderInterop::ParticleRender::RpSortedParticleLookupBuffer, m_ParticleStateBuffers[m_CurrentParticleStateBuffer].SortList.GpuAddress());
     context->SetGraphicsRootConstantBufferView(ShaderInterop::ParticleRender::RpPerFrameCb, perFrameCb);
     context->SetGraphicsRootShaderResourceView(ShaderInterop::ParticleRender::RpMaterialHeap, m_Resources.PbrMaterials.BufferGpuAddress());
 
@@ -246,13 +514,62 @@ void ParticleSystem::Render(GraphicsContext& context, D3D12_GPU_VIRTUAL_ADDRESS
 
     context->SetGraphicsRootDescriptorTable(ShaderInterop::ParticleRender::RpSamplerHeap, m_Graphics.SamplerHeap().GpuHeap()->GetGPUDescriptorHandleForHeapStart());
     context->SetGraphicsRootDescriptorTable(ShaderInterop::ParticleRender::RpBindlessHeap, m_Graphics.ResourceDescriptorManager().GpuHeap()->GetGPUDescriptorHandleForHeapStart());
+    context->SetGraphicsRootShaderResourceView(ShaderInterop::ParticleRender::RpParticleLightingBuffer, m_ParticleLightingBuffer.GpuAddress());
 
-    context->SetPipelineState(showLightBoundaries ? m_Resources.ParticleRenderLightDebug : m_Resources.ParticleRender);
+    if (showLightBoundaries)
+    { context->SetPipelineState(m_Resources.ParticleRenderLightDebug); }
+    else
+    { context->SetPipelineState(usePerParticleLighting ? m_Resources.ParticleRenderCachedLighting : m_Resources.ParticleRender); }
     context->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
     context.DrawIndirect(m_DrawIndirectArguments);
 
+    CollectDispatchStatistics(context);
+
     PIXEndEvent(&context);
     m_RenderSyncPoint = context.Flush();
+
+    uint32_t statisticsBuffer = (m_NextDispatchStatisticsBuffer + DispatchStatisticsBufferCount - 1) % DispatchStatisticsBufferCount;
+    if (m_DispatchStatisticsPending[statisticsBuffer])
+    { m_DispatchStatisticsSyncPoints[statisticsBuffer] = m_RenderSyncPoint; }
+}
+
+void ParticleSystem::CollectDispatchStatistics(GraphicsContext& context)
+{
+    const uint32_t statisticsSize = sizeof(ShaderInterop::ParticleDispatchStatistics);
+
+    // Read the most recent statistics which have finished on the GPU
+    for (uint32_t i = 1; i <= DispatchStatisticsBufferCount; i++)
+    {
+        uint32_t buffer = (m_NextDispatchStatisticsBuffer + DispatchStatisticsBufferCount - i) % DispatchStatisticsBufferCount;
+        if (!m_DispatchStatisticsPending[buffer] || !m_DispatchStatisticsSyncPoints[buffer].WasReached())
+        { continue; }
+
+        D3D12_RANGE readRange = { .Begin = statisticsSize * buffer, .End = statisticsSize * (buffer + 1) };
+        uint8_t* mapped;
+        AssertSuccess(m_DispatchStatisticsReadbackBuffer->Map(0, &readRange, (void**)&mapped));
+        memcpy(&m_DispatchStatistics, mapped + readRange.Begin, statisticsSize);
+        D3D12_RANGE emptyRange = { };
+        m_DispatchStatisticsReadbackBuffer->Unmap(0, &emptyRange);
+
+        // Anything older than this is no longer interesting
+        for (uint32_t j = 0; j < DispatchStatisticsBufferCount; j++)
+        {
+            if (m_DispatchStatisticsSyncPoints[j].WasReached())
+            { m_DispatchStatisticsPending[j] = false; }
+        }
+        break;
+    }
+
+    // Copy out the statistics for this frame
+    // If the GPU is falling far enough behind that the next buffer is still in use we just skip collecting statistics for this frame
+    uint32_t nextBuffer = m_NextDispatchStatisticsBuffer;
+    if (m_DispatchStatisticsPending[nextBuffer])
+    { return; }
+
+    context.TransitionResource(m_DispatchIndirectArguments, D3D12_RESOURCE_STATE_COPY_SOURCE, true);
+    context->CopyBufferRegion(m_DispatchStatisticsReadbackBuffer.Get(), statisticsSize * nextBuffer, m_DispatchIndirectArguments, ShaderInterop::ParticleSystem::DispatchStatistics, statisticsSize);
+    m_DispatchStatisticsPending[nextBuffer] = true;
+    m_NextDispatchStatisticsBuffer = (nextBuffer + 1) % DispatchStatisticsBufferCount;
 }
 
 void ParticleSystem::SeedState(float numSeconds)
@@ -2,6 +2,7 @@
 #include "GpuSyncPoint.h"
 #include "RawGpuResource.h"
 #include "ResourceDescriptor.h"
+#include "ShaderInterop.h"
 #include "UavCounter.h"
 #include "Vector3.h"
 
@@ -13,6 +14,26 @@ class LightLinkedList;
 struct ParticleSystemDefinition;
 struct ResourceManager;
 
+static const char* ParticleSortModeNames = "Full\0Temporal\0";
+enum class ParticleSortMode : int
+{
+    //! Particles are fully sorted every frame using the bitonic sort
+    Full,
+    //! Particles are visited in the order they were sorted last frame and the resulting (nearly sorted) list is repaired with a bounded fix-up
+    //! Falls back to the full sort whenever the fix-up fails to sort the list. See ParticleSortFixUp.cs.hlsl for details.
+    Temporal,
+};
+
+static const char* ParticleLightingModeNames = "Per pixel\0Per particle\0";
+enum class ParticleLightingMode : int
+{
+    //! Lighting is evaluated for every pixel of every sprite using the light linked list
+    PerPixel,
+    //! Lighting is evaluated once per particle in a compute pass and applied uniformly across the sprite
+    //! Much cheaper when sprites overlap heavily at the cost of ignoring normal maps and light variation across the sprite. See ParticleLighting.cs.hlsl for details.
+    PerParticle,
+};
+
 class ParticleSystem
 {
 private:
@@ -25,6 +46,15 @@ private:
 
     float m_SpawnLeftover = 0.f;
 
+    ParticleSortMode m_SortMode = ParticleSortMode::Full;
+    float m_MaxSortDisorderRatio = 0.05f;
+
+    ParticleLightingMode m_LightingMode = ParticleLightingMode::PerPixel;
+
+    //! The maximum number of particles spawned in a single frame which will be merged into the survivors when using the temporal sort
+    //! (Merging is quadratic in the number of spawned particles, beyond this the full sort is used instead.)
+    static const uint32_t MaxSpawnedToMerge = 256;
+
     GpuSyncPoint m_UpdateSyncPoint;
     GpuSyncPoint m_RenderSyncPoint;
 
@@ -33,27 +63,56 @@ private:
         RawGpuResource Buffer;
         ResourceDescriptor Uav;
         UavCounter Counter;
+
+        //! The sorted particle sprite lookup for the particles in this buffer
+        //! This is kept alongside the state buffer so that the temporal sort can visit particles in the order they were sorted in the previous frame
+        RawGpuResource SortList;
+        ResourceDescriptor SortListUav;
     };
     ParticleStateBuffer m_ParticleStateBuffers[2];
     uint32_t m_CurrentParticleStateBuffer = 0;
 
     RawGpuResource m_ParticleSpriteBuffer;
-
-    RawGpuResource m_ParticleSpriteSortBuffer;
-    ResourceDescriptor m_ParticleSpriteSortBufferUav;
+    RawGpuResource m_ParticleLightingBuffer;
 
     RawGpuResource m_DrawIndirectArguments;
 
+    //! Indirect dispatch arguments for the update and spawn passes followed by the ParticleDispatchStatistics for the most recent update
+    RawGpuResource m_DispatchIndirectArguments;
+
+    // Dispatch statistics are read back on a small ring of buffers so the CPU never waits on the GPU to see them
+    static const uint32_t DispatchStatisticsBufferCount = 3;
+    ComPtr<ID3D12Resource> m_DispatchStatisticsReadbackBuffer;
+    GpuSyncPoint m_DispatchStatisticsSyncPoints[DispatchStatisticsBufferCount];
+    bool m_DispatchStatisticsPending[DispatchStatisticsBufferCount] = { };
+    uint32_t m_NextDispatchStatisticsBuffer = 0;
+    ShaderInterop::ParticleDispatchStatistics m_DispatchStatistics = { };
+
+    // Temporal sort resources
+    RawGpuResource m_SortMergeScratch;
+    ResourceDescriptor m_SortMergeScratchUav;
+    RawGpuResource m_SortStatistics;
+    ResourceDescriptor m_SortStatisticsUav;
+    RawGpuResource m_SortFixUpArguments;
+    UavCounter m_SortFallbackItemCount;
+
 public:
     ParticleSystem(ResourceManager& resources, const std::wstring& debugName, const ParticleSystemDefinition& definition, float3 spawnPoint, uint32_t capacity);
 
 private:
     void Update(ComputeContext& context, float deltaTime, D3D12_GPU_VIRTUAL_ADDRESS perFrameCb, bool skipPrepareRender);
+    void BindUpdateRootParameters(ComputeContext& context, const ShaderInterop::ParticleSystemParams& params, D3D12_GPU_VIRTUAL_ADDRESS perFrameCb, ParticleStateBuffer& inputStateBuffer, ParticleStateBuffer& outputStateBuffer);
+    void BindSortFixUpRootParameters(ComputeContext& context, ParticleStateBuffer& outputStateBuffer);
+    void MeasureSortDisorder(ComputeContext& context, uint32_t statisticsOffset);
+    void FixUpSurvivorOrder(ComputeContext& context, ParticleStateBuffer& outputStateBuffer);
+    void FinishTemporalSort(ComputeContext& context, ParticleStateBuffer& outputStateBuffer, uint32_t spawnedCount);
+    void CollectDispatchStatistics(GraphicsContext& context);
+    void ComputeLighting(GraphicsContext& context, D3D12_GPU_VIRTUAL_ADDRESS perFrameCb, LightHeap& lightHeap, LightLinkedList& lightLinkedList, uint2 screenSize);
 public:
     inline void Update(ComputeContext& context, float deltaTime, D3D12_GPU_VIRTUAL_ADDRESS perFrameCb)
     { Update(context, deltaTime, perFrameCb, false); }
 
-    void Render(GraphicsContext& context, D3D12_GPU_VIRTUAL_ADDRESS perFrameCb, LightHeap& lightHeap, LightLinkedList& lightLinkedList, bool showLightBoundaries = false);
+    void Render(GraphicsContext& context, D3D12_GPU_VIRTUAL_ADDRESS perFrameCb, LightHeap& lightHeap, LightLinkedList& lightLinkedList, uint2 screenSize, bool showLightBoundaries = false);
 
     //! Seeds the state of the particle system by simulating it for the specified number of (simulated) seconds
     void SeedState(float numSeconds);
@@ -62,4 +121,19 @@ public:
 
     inline float3 SpawnPoint() const { return m_SpawnPoint; }
     inline void SpawnPoint(float3 spawnPoint) { m_SpawnPoint = spawnPoint; }
+
+    inline ParticleSortMode SortMode() const { return m_SortMode; }
+    inline void SortMode(ParticleSortMode sortMode) { m_SortMode = sortMode; }
+
+    //! The maximum ratio of out of order neighbors to particles for which the temporal sort will attempt the bounded fix-up before falling back to the full sort
+    inline float MaxSortDisorderRatio() const { return m_MaxSortDisorderRatio; }
+    inline void MaxSortDisorderRatio(float ratio) { m_MaxSortDisorderRatio = ratio; }
+
+    inline ParticleLightingMode LightingMode() const { return m_LightingMode; }
+    inline void LightingMode(ParticleLightingMode lightingMode) { m_LightingMode = lightingMode; }
+
+    //! The number of update and spawn threads which were dispatched versus the number which had a particle to work on
+    //! These lag behind the current frame by however long it takes for the GPU to finish rendering.
+    inline const ShaderInterop::ParticleDispatchStatistics& DispatchStatistics() const { return m_DispatchStatistics; }
+    inline uint32_t Capacity() const { return m_Capacity; }
 };
@@ -3,7 +3,7 @@
 
 #include "GltfLoadContext.h"
 #include "ResourceManager.h"
-#include "Texture.h"
+#include "GpuTextureStreamer.h"
 
 #include <tiny_gltf.h>
 
@@ -38,7 +38,7 @@ PbrMaterial::PbrMaterial(GltfLoadContext& context, int materialIndex, bool primi
         if (colorTexture.index >= 0)
         {
             Assert(colorTexture.texCoord == 0 && "Using secondary UV sets is not yet supported.");
-            pbr.BaseColorTexture = context.LoadTexture(colorTexture.index, true).BindlessIndex();
+            pbr.BaseColorTexture = context.LoadTexture(colorTexture.index, true, StreamedTexturePlaceholder::White);
             pbr.BaseColorTextureSampler = context.LoadSamplerForTexture(colorTexture.index);
         }
     }
@@ -51,7 +51,7 @@ PbrMaterial::PbrMaterial(GltfLoadContext& context, int materialIndex, bool primi
         if (mrTexture.index >= 0)
         {
             Assert(mrTexture.texCoord == 0 && "Using secondary UV sets is not yet supported.");
-            pbr.MealicRoughnessTexture = context.LoadTexture(mrTexture.index, false).BindlessIndex();
+            pbr.MealicRoughnessTexture = context.LoadTexture(mrTexture.index, false, StreamedTexturePlaceholder::White);
             pbr.MetalicRoughnessTextureSampler = context.LoadSamplerForTexture(mrTexture.index);
         }
     }
@@ -66,7 +66,7 @@ PbrMaterial::PbrMaterial(GltfLoadContext& context, int materialIndex, bool primi
             Assert(primitiveHasTangents && "Primitives with a normal texture must have tangents.");
 
             Assert(normalTexture.texCoord == 0 && "Using secondary UV sets is not yet supported.");
-            pbr.NormalTexture = context.LoadTexture(normalTexture.index, false).BindlessIndex();
+            pbr.NormalTexture = context.LoadTexture(normalTexture.index, false, StreamedTexturePlaceholder::FlatNormal);
             pbr.NormalTextureSampler = context.LoadSamplerForTexture(normalTexture.index);
             pbr.NormalTextureScale = (float)normalTexture.scale;
         }
@@ -89,7 +89,7 @@ PbrMaterial::PbrMaterial(GltfLoadContext& context, int materialIndex, bool primi
         if (emissiveTexture.index >= 0)
         {
             Assert(emissiveTexture.texCoord == 0 && "Using secondary UV sets is not yet supported.");
-            pbr.EmissiveTexture = context.LoadTexture(emissiveTexture.index, true).BindlessIndex();
+            pbr.EmissiveTexture = context.LoadTexture(emissiveTexture.index, true, StreamedTexturePlaceholder::Black);
             pbr.EmissiveTextureSampler = context.LoadSamplerForTexture(emissiveTexture.index);
         }
     }
@@ -105,6 +105,7 @@ PbrMaterial::PbrMaterial(GltfLoadContext& context, int materialIndex, bool primi
     if (material.alphaMode == "MASK")
     {
         pbr.AlphaCutoff = (float)material.alphaCutoff;
+        m_IsAlphaTested = true;
     }
 
     // Create the material
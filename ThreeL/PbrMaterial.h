@@ -10,6 +10,7 @@ private:
     PipelineStateObject* m_PipelineStateObject = nullptr;
     PbrMaterialId m_MaterialId = -1;
     bool m_IsTransparent = false;
+    bool m_IsAlphaTested = false;
     bool m_IsDoubleSided = false;
 
 public:
@@ -19,5 +20,6 @@ public:
     inline const PipelineStateObject& PipelineStateObject() const { return *m_PipelineStateObject; }
     inline PbrMaterialId MaterialId() const { return m_MaterialId; }
     inline bool IsTransparent() const { return m_IsTransparent; }
+    inline bool IsAlphaTested() const { return m_IsAlphaTested; }
     inline bool IsDoubleSided() const { return m_IsDoubleSided; }
 };
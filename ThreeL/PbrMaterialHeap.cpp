@@ -12,8 +12,21 @@ PbrMaterialHeap::PbrMaterialHeap(GraphicsCore& graphics)
 PbrMaterialId PbrMaterialHeap::CreateMaterial(const ShaderInterop::PbrMaterialParams& params)
 {
     Assert(m_MaterialParams == nullptr && "Materials cannot be created after they've previously been uploaded!");
-    m_MaterialParamsStaging.push_back(params);
-    return (uint32_t)m_MaterialParamsStaging.size() - 1;
+    PbrMaterialId material = (uint32_t)m_MaterialParamsCpu.size();
+    m_MaterialParamsCpu.push_back(params);
+    m_MaterialTextures.push_back({ params.BaseColorTexture, params.MealicRoughnessTexture, params.NormalTexture, params.EmissiveTexture });
+
+    for (uint32_t texture : m_MaterialTextures.back())
+    {
+        if (texture == BUFFER_DISABLED)
+        { continue; }
+
+        std::vector<PbrMaterialId>& materials = m_MaterialsByTexture[texture];
+        if (materials.empty() || materials.back() != material)
+        { materials.push_back(material); }
+    }
+
+    return material;
 }
 
 GpuSyncPoint PbrMaterialHeap::UploadMaterials()
@@ -21,21 +34,48 @@ GpuSyncPoint PbrMaterialHeap::UploadMaterials()
     Assert(m_MaterialParams == nullptr && "Materials have already been uploaded!");
 
     // Handle edge case where there's no materials
-    if (m_MaterialParamsStaging.size() == 0)
-    { m_MaterialParamsStaging.push_back({ }); }
+    if (m_MaterialParamsCpu.size() == 0)
+    { m_MaterialParamsCpu.push_back({ }); }
+
+    // The CPU-side copy is kept around for when streamed textures get new descriptors
+    D3D12_RESOURCE_DESC resourceDescription = DescribeBufferResource(m_MaterialParamsCpu.size() * sizeof(ShaderInterop::PbrMaterialParams));
+    m_MaterialParams = std::make_unique<FrequentlyUpdatedResource>(m_Graphics, resourceDescription, L"PBR Material Parameters");
+    return m_MaterialParams->Update(std::span<const ShaderInterop::PbrMaterialParams>(m_MaterialParamsCpu));
+}
 
-    D3D12_RESOURCE_DESC resourceDescription = DescribeBufferResource(m_MaterialParamsStaging.size() * sizeof(ShaderInterop::PbrMaterialParams));
-    PendingUpload pendingUpload = m_Graphics.UploadQueue().AllocateResource(resourceDescription, L"PBR Material Parameters");
+void PbrMaterialHeap::ReplaceTexture(uint32_t oldBindlessIndex, uint32_t newBindlessIndex)
+{
+    auto entry = m_MaterialsByTexture.find(oldBindlessIndex);
+    if (entry == m_MaterialsByTexture.end())
+    { return; }
+
+    std::vector<PbrMaterialId> materials = std::move(entry->second);
+    m_MaterialsByTexture.erase(entry);
 
-    std::span<const ShaderInterop::PbrMaterialParams> sourceSpan = m_MaterialParamsStaging;
-    std::span<ShaderInterop::PbrMaterialParams> destinationSpan = SpanCast<uint8_t, ShaderInterop::PbrMaterialParams>(pendingUpload.StagingBuffer());
-    SpanCopy(destinationSpan, sourceSpan);
+    for (PbrMaterialId material : materials)
+    {
+        ShaderInterop::PbrMaterialParams& params = m_MaterialParamsCpu[material];
+        uint32_t* textures[] = { &params.BaseColorTexture, &params.MealicRoughnessTexture, &params.NormalTexture, &params.EmissiveTexture };
+        for (size_t i = 0; i < std::size(textures); i++)
+        {
+            if (*textures[i] == oldBindlessIndex)
+            {
+                *textures[i] = newBindlessIndex;
+                m_MaterialTextures[material][i] = newBindlessIndex;
+            }
+        }
+    }
 
-    // CPU-side staging buffer is no longer needed
-    m_MaterialParamsStaging.clear();
+    m_MaterialsByTexture[newBindlessIndex] = std::move(materials);
+    m_IsDirty = true;
+}
+
+GpuSyncPoint PbrMaterialHeap::Update()
+{
+    Assert(m_MaterialParams != nullptr && "Materials not uploaded to GPU!");
+    if (!m_IsDirty)
+    { return { }; }
 
-    // Initiate the upload
-    InitiatedUpload upload = pendingUpload.InitiateUpload();
-    m_MaterialParams = std::move(upload.Resource);
-    return upload.SyncPoint;
+    m_IsDirty = false;
+    return m_MaterialParams->Update(std::span<const ShaderInterop::PbrMaterialParams>(m_MaterialParamsCpu));
 }
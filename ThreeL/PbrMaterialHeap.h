@@ -1,20 +1,34 @@
 #pragma once
 #include "pch.h"
+#include "FrequentlyUpdatedResource.h"
 #include "GpuSyncPoint.h"
 #include "Math.h"
 #include "ShaderInterop.h"
 
+#include <array>
+#include <memory>
+#include <span>
+#include <unordered_map>
+
 class GraphicsCore;
 
 using PbrMaterialId = uint32_t;
 
+//! The parameters of every PBR material, which are uploaded once loading finishes
+//! Texture indices change as streamed textures are given new descriptors (see GpuTextureStreamer) so the parameters are kept on the CPU and re-uploaded when
+//! that happens.
 class PbrMaterialHeap
 {
 private:
     GraphicsCore& m_Graphics;
 
-    ComPtr<ID3D12Resource> m_MaterialParams;
-    std::vector<ShaderInterop::PbrMaterialParams> m_MaterialParamsStaging;
+    std::unique_ptr<FrequentlyUpdatedResource> m_MaterialParams;
+    std::vector<ShaderInterop::PbrMaterialParams> m_MaterialParamsCpu;
+    bool m_IsDirty = false;
+
+    // The bindless indices of each material's textures are kept on the CPU so that texture streaming can be prioritized by what's being drawn
+    std::vector<std::array<uint32_t, 4>> m_MaterialTextures;
+    std::unordered_map<uint32_t, std::vector<PbrMaterialId>> m_MaterialsByTexture;
 
 public:
     PbrMaterialHeap(GraphicsCore& graphics);
@@ -22,9 +36,23 @@ public:
     PbrMaterialId CreateMaterial(const ShaderInterop::PbrMaterialParams& params);
     GpuSyncPoint UploadMaterials();
 
+    //! Points every material using the texture with the old bindless index at the new one, takes effect with the next call to Update
+    void ReplaceTexture(uint32_t oldBindlessIndex, uint32_t newBindlessIndex);
+
+    //! Uploads the materials if any of them changed since the last update, the graphics queue must wait on the returned sync point before reading them
+    //! Must not be called more than once per frame
+    GpuSyncPoint Update();
+
+    //! Returns the bindless indices of the textures used by the specified material, unused textures are BUFFER_DISABLED
+    inline std::span<const uint32_t> MaterialTextures(PbrMaterialId material) const
+    {
+        Assert(material < m_MaterialTextures.size());
+        return m_MaterialTextures[material];
+    }
+
     inline D3D12_GPU_VIRTUAL_ADDRESS BufferGpuAddress() const
     {
         Assert(m_MaterialParams != nullptr && "Materials not uploaded to GPU!");
-        return m_MaterialParams->GetGPUVirtualAddress();
+        return m_MaterialParams->Current()->GetGPUVirtualAddress();
     }
 };
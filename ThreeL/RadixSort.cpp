@@ -0,0 +1,90 @@
+#include "pch.h"
+#include "RadixSort.h"
+
+#include "JobSystem.h"
+
+#include <algorithm>
+
+void RadixSorter::Sort(JobSystem& jobs, std::span<uint64_t> keys, std::span<uint32_t> values)
+{
+    Assert(keys.size() == values.size());
+    Assert(keys.size() <= UINT32_MAX);
+
+    const uint32_t count = (uint32_t)keys.size();
+    if (count <= 1)
+    { return; }
+
+    const uint32_t jobCount = std::clamp(count / MinItemsPerJob, 1u, jobs.WorkerCount() + 1);
+    const uint32_t itemsPerJob = (count + jobCount - 1) / jobCount;
+
+    m_ScratchKeys.resize(count);
+    m_ScratchValues.resize(count);
+    m_Histograms.resize(jobCount * BucketCount);
+
+    std::span<uint64_t> sourceKeys = keys;
+    std::span<uint32_t> sourceValues = values;
+    std::span<uint64_t> destinationKeys = m_ScratchKeys;
+    std::span<uint32_t> destinationValues = m_ScratchValues;
+
+    for (uint32_t shift = 0; shift < 64; shift += DigitBits)
+    {
+        // Every job counts the digits of its own slice of the list
+        jobs.ParallelFor(jobCount, [&](uint32_t job)
+            {
+                uint32_t* histogram = &m_Histograms[job * BucketCount];
+                std::fill(histogram, histogram + BucketCount, 0);
+
+                uint32_t end = std::min(count, (job + 1) * itemsPerJob);
+                for (uint32_t i = job * itemsPerJob; i < end; i++)
+                { histogram[(sourceKeys[i] >> shift) & (BucketCount - 1)]++; }
+            });
+
+        // Keys frequently share their upper digits (IE: depths within a similar range), a pass where every key lands in the same bucket wouldn't move anything
+        bool isTrivialPass = false;
+        for (uint32_t bucket = 0; bucket < BucketCount && !isTrivialPass; bucket++)
+        {
+            uint32_t bucketTotal = 0;
+            for (uint32_t job = 0; job < jobCount; job++)
+            { bucketTotal += m_Histograms[job * BucketCount + bucket]; }
+            isTrivialPass = bucketTotal == count;
+        }
+
+        if (isTrivialPass)
+        { continue; }
+
+        // Turn the counts into scatter offsets, each bucket is laid out in job order so that the sort is stable
+        uint32_t offset = 0;
+        for (uint32_t bucket = 0; bucket < BucketCount; bucket++)
+        {
+            for (uint32_t job = 0; job < jobCount; job++)
+            {
+                uint32_t& entry = m_Histograms[job * BucketCount + bucket];
+                uint32_t bucketCount = entry;
+                entry = offset;
+                offset += bucketCount;
+            }
+        }
+
+        jobs.ParallelFor(jobCount, [&](uint32_t job)
+            {
+                uint32_t* offsets = &m_Histograms[job * BucketCount];
+                uint32_t end = std::min(count, (job + 1) * itemsPerJob);
+                for (uint32_t i = job * itemsPerJob; i < end; i++)
+                {
+                    uint32_t destination = offsets[(sourceKeys[i] >> shift) & (BucketCount - 1)]++;
+                    destinationKeys[destination] = sourceKeys[i];
+                    destinationValues[destination] = sourceValues[i];
+                }
+            });
+
+        std::swap(sourceKeys, destinationKeys);
+        std::swap(sourceValues, destinationValues);
+    }
+
+    // An odd number of passes leaves the result in the scratch buffers
+    if (sourceKeys.data() != keys.data())
+    {
+        std::copy(sourceKeys.begin(), sourceKeys.end(), keys.begin());
+        std::copy(sourceValues.begin(), sourceValues.end(), values.begin());
+    }
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include <span>
+#include <vector>
+
+class JobSystem;
+
+//! Stable least significant digit radix sort of 64-bit keys with 32-bit payloads, split across the job system
+//! The scratch memory is kept between sorts so that sorting every frame doesn't allocate once the sorter has warmed up.
+class RadixSorter
+{
+private:
+    static constexpr uint32_t DigitBits = 8;
+    static constexpr uint32_t BucketCount = 1 << DigitBits;
+
+    // Lists smaller than this are sorted by a single job since waking the workers would cost more than it saves
+    static constexpr uint32_t MinItemsPerJob = 8192;
+
+    std::vector<uint64_t> m_ScratchKeys;
+    std::vector<uint32_t> m_ScratchValues;
+
+    // BucketCount counts for each job, reused as each job's scatter offsets
+    std::vector<uint32_t> m_Histograms;
+
+public:
+    //! Sorts keys in ascending order and applies the same permutation to values
+    void Sort(JobSystem& jobs, std::span<uint64_t> keys, std::span<uint32_t> values);
+};
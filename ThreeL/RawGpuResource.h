@@ -17,7 +17,7 @@ public:
     RawGpuResource(ComPtr<ID3D12Resource>&& resource, D3D12_RESOURCE_STATES initialState = D3D12_RESOURCE_STATE_COMMON)
     {
         m_Resource = resource;
-        m_CurrentState = initialState;
+        m_State = ResourceState(initialState);
         m_GpuAddress = m_Resource->GetGPUVirtualAddress();
     }
 
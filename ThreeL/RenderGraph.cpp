@@ -0,0 +1,439 @@
+#include "pch.h"
+#include "RenderGraph.h"
+
+#include <algorithm>
+
+namespace
+{
+    const uint32_t NO_PASS = UINT32_MAX;
+    const uint32_t QUEUE_COUNT = (uint32_t)RenderGraphQueue::Count;
+
+    bool IsGraphicsOnlyAccess(RenderGraphAccess access)
+    {
+        return access == RenderGraphAccess::RenderTarget || access == RenderGraphAccess::DepthWrite || access == RenderGraphAccess::DepthRead;
+    }
+
+    // Reads of the same kind only need a transition between them when async compute read first, since graphics passes read with more shader stages
+    bool NeedsTransition(RenderGraphAccess before, RenderGraphQueue beforeQueue, RenderGraphAccess after, RenderGraphQueue afterQueue)
+    {
+        if (before != after)
+        { return true; }
+
+        return after == RenderGraphAccess::ShaderRead && beforeQueue == RenderGraphQueue::AsyncCompute && afterQueue == RenderGraphQueue::Graphics;
+    }
+
+    uint64_t AlignUp(uint64_t value, uint64_t alignment)
+    {
+        return (value + alignment - 1) & ~(alignment - 1);
+    }
+}
+
+RenderGraphResourceId RenderGraph::CreateTransient(std::string name, uint64_t sizeBytes, uint64_t alignment, uint32_t heapClass)
+{
+    Assert(sizeBytes > 0);
+    Assert(alignment > 0 && (alignment & (alignment - 1)) == 0 && "Alignment must be a power of two.");
+    Resource resource =
+    {
+        .Name = std::move(name),
+        .IsTransient = true,
+        .IsExtracted = false,
+        .SizeBytes = sizeBytes,
+        .Alignment = alignment,
+        .HeapClass = heapClass,
+    };
+    m_Resources.push_back(std::move(resource));
+    return (RenderGraphResourceId)m_Resources.size() - 1;
+}
+
+RenderGraphResourceId RenderGraph::Import(std::string name)
+{
+    Resource resource =
+    {
+        .Name = std::move(name),
+        .IsTransient = false,
+        .IsExtracted = false,
+        .SizeBytes = 0,
+        .Alignment = 1,
+        .HeapClass = 0,
+    };
+    m_Resources.push_back(std::move(resource));
+    return (RenderGraphResourceId)m_Resources.size() - 1;
+}
+
+void RenderGraph::Extract(RenderGraphResourceId resource)
+{
+    Assert(m_Resources[resource].IsTransient && "Only transients can be extracted.");
+    m_Resources[resource].IsExtracted = true;
+}
+
+RenderGraphPassId RenderGraph::AddPass(std::string name, RenderGraphQueue queue, std::span<const RenderGraphResourceUse> uses, bool hasSideEffects)
+{
+    for (size_t i = 0; i < uses.size(); i++)
+    {
+        Assert(uses[i].Resource < m_Resources.size());
+        Assert(uses[i].Access != RenderGraphAccess::None);
+        Assert((queue == RenderGraphQueue::Graphics || !IsGraphicsOnlyAccess(uses[i].Access)) && "Async compute can't use render targets or depth buffers.");
+
+        for (size_t j = 0; j < i; j++)
+        { Assert(uses[i].Resource != uses[j].Resource && "Each resource may only be used once per pass."); }
+    }
+
+    Pass pass =
+    {
+        .Name = std::move(name),
+        .Queue = queue,
+        .Uses = std::vector<RenderGraphResourceUse>(uses.begin(), uses.end()),
+        .HasSideEffects = hasSideEffects,
+    };
+    m_Passes.push_back(std::move(pass));
+    return (RenderGraphPassId)m_Passes.size() - 1;
+}
+
+void RenderGraph::Clear()
+{
+    m_Resources.clear();
+    m_Passes.clear();
+}
+
+RenderGraphCompilation RenderGraph::Compile() const
+{
+    const uint32_t passCount = (uint32_t)m_Passes.size();
+    const uint32_t resourceCount = (uint32_t)m_Resources.size();
+    RenderGraphCompilation result = { };
+
+    //-----------------------------------------------------------------------------------------------------------------
+    // Cull passes whose results are never used
+    //-----------------------------------------------------------------------------------------------------------------
+    // Walking backwards means we always know whether anything after a pass needs what it writes
+    std::vector<bool> isResourceNeeded(resourceCount);
+    for (uint32_t i = 0; i < resourceCount; i++)
+    { isResourceNeeded[i] = !m_Resources[i].IsTransient || m_Resources[i].IsExtracted; }
+
+    std::vector<bool> isPassLive(passCount);
+    for (uint32_t i = passCount; i-- > 0;)
+    {
+        const Pass& pass = m_Passes[i];
+        bool isLive = pass.HasSideEffects;
+        for (const RenderGraphResourceUse& use : pass.Uses)
+        {
+            if (RenderGraphAccessIsWrite(use.Access) && isResourceNeeded[use.Resource])
+            { isLive = true; }
+        }
+
+        if (!isLive)
+        { continue; }
+
+        isPassLive[i] = true;
+        for (const RenderGraphResourceUse& use : pass.Uses)
+        { isResourceNeeded[use.Resource] = true; }
+    }
+
+    //-----------------------------------------------------------------------------------------------------------------
+    // Find the dependencies between live passes
+    //-----------------------------------------------------------------------------------------------------------------
+    // A use depends on the previous write, and a write depends on every use since the previous write
+    // Transitioning a resource between reads counts as a write here since the transition has to be ordered with the other reads just the same
+    struct ResourceHistory
+    {
+        RenderGraphPassId LastWriter = NO_PASS;
+        RenderGraphAccess LastAccess = RenderGraphAccess::None;
+        RenderGraphQueue LastQueue = RenderGraphQueue::Graphics;
+        std::vector<RenderGraphPassId> Readers;
+    };
+    std::vector<ResourceHistory> histories(resourceCount);
+    std::vector<std::vector<RenderGraphPassId>> dependencies(passCount);
+
+    for (RenderGraphPassId i = 0; i < passCount; i++)
+    {
+        if (!isPassLive[i])
+        { continue; }
+
+        std::vector<RenderGraphPassId>& passDependencies = dependencies[i];
+        RenderGraphQueue queue = m_Passes[i].Queue;
+        for (const RenderGraphResourceUse& use : m_Passes[i].Uses)
+        {
+            ResourceHistory& history = histories[use.Resource];
+            if (history.LastWriter != NO_PASS)
+            { passDependencies.push_back(history.LastWriter); }
+
+            if (RenderGraphAccessIsWrite(use.Access) || NeedsTransition(history.LastAccess, history.LastQueue, use.Access, queue))
+            {
+                passDependencies.insert(passDependencies.end(), history.Readers.begin(), history.Readers.end());
+                history.LastWriter = i;
+                history.Readers.clear();
+            }
+            else
+            { history.Readers.push_back(i); }
+
+            history.LastAccess = use.Access;
+            history.LastQueue = queue;
+        }
+
+        std::sort(passDependencies.begin(), passDependencies.end());
+        passDependencies.erase(std::unique(passDependencies.begin(), passDependencies.end()), passDependencies.end());
+    }
+
+    //-----------------------------------------------------------------------------------------------------------------
+    // Order the live passes
+    //-----------------------------------------------------------------------------------------------------------------
+    // Graphics passes stay in the order they were added, async compute passes are hoisted to right after their last dependency
+    // (Everything a pass depends on was added before it, so hoisting can never move a pass ahead of its dependencies.)
+    std::vector<RenderGraphPassId> order;
+    auto PositionOf = [&](RenderGraphPassId pass) { return (uint32_t)(std::find(order.begin(), order.end(), pass) - order.begin()); };
+    RenderGraphPassId previousAsyncPass = NO_PASS;
+
+    for (RenderGraphPassId i = 0; i < passCount; i++)
+    {
+        if (!isPassLive[i])
+        {
+            result.Memory.CulledPassCount++;
+            continue;
+        }
+
+        if (m_Passes[i].Queue == RenderGraphQueue::Graphics)
+        {
+            order.push_back(i);
+            continue;
+        }
+
+        // Passes on the same queue run in order no matter what, so there's no sense in hoisting above the previous one
+        uint32_t position = previousAsyncPass == NO_PASS ? 0 : PositionOf(previousAsyncPass) + 1;
+        for (RenderGraphPassId dependency : dependencies[i])
+        { position = std::max(position, PositionOf(dependency) + 1); }
+
+        order.insert(order.begin() + position, i);
+        previousAsyncPass = i;
+    }
+
+    const uint32_t orderCount = (uint32_t)order.size();
+    std::vector<uint32_t> positions(passCount, NO_PASS);
+    for (uint32_t position = 0; position < orderCount; position++)
+    { positions[order[position]] = position; }
+
+    result.Memory.PassCount = orderCount;
+    result.Passes.resize(orderCount);
+    for (uint32_t position = 0; position < orderCount; position++)
+    {
+        result.Passes[position].Pass = order[position];
+        result.Passes[position].Queue = m_Passes[order[position]].Queue;
+    }
+
+    //-----------------------------------------------------------------------------------------------------------------
+    // Add cross-queue waits
+    //-----------------------------------------------------------------------------------------------------------------
+    // Waiting on a pass implies waiting on every pass before it on the same queue, so only the latest dependency on each queue needs a wait
+    // and dependencies older than something the queue already waited on are skipped entirely.
+    // syncedPositions[queue][otherQueue] is the position of the latest pass on otherQueue which queue has waited on
+    int64_t syncedPositions[QUEUE_COUNT][QUEUE_COUNT];
+    std::fill(&syncedPositions[0][0], &syncedPositions[0][0] + QUEUE_COUNT * QUEUE_COUNT, -1);
+
+    // Graphics passes can run alongside async compute passes between the graphics pass the async compute queue last waited on and the next graphics pass
+    // which waits on the async compute queue, so async compute passes are in flight for that entire window as far as lifetimes are concerned
+    std::vector<uint32_t> windowStarts(orderCount);
+    std::vector<uint32_t> windowEnds(orderCount);
+
+    for (uint32_t position = 0; position < orderCount; position++)
+    {
+        RenderGraphCompiledPass& compiledPass = result.Passes[position];
+        uint32_t queue = (uint32_t)compiledPass.Queue;
+
+        for (uint32_t otherQueue = 0; otherQueue < QUEUE_COUNT; otherQueue++)
+        {
+            if (otherQueue == queue)
+            { continue; }
+
+            int64_t latestPosition = -1;
+            for (RenderGraphPassId dependency : dependencies[compiledPass.Pass])
+            {
+                if ((uint32_t)m_Passes[dependency].Queue == otherQueue)
+                { latestPosition = std::max(latestPosition, (int64_t)positions[dependency]); }
+            }
+
+            if (latestPosition > syncedPositions[queue][otherQueue])
+            {
+                compiledPass.Waits.push_back(order[latestPosition]);
+                result.Passes[latestPosition].IsWaitedOn = true;
+                syncedPositions[queue][otherQueue] = latestPosition;
+            }
+        }
+
+        windowStarts[position] = position;
+        windowEnds[position] = position;
+        if (compiledPass.Queue == RenderGraphQueue::AsyncCompute)
+        { windowStarts[position] = (uint32_t)(syncedPositions[queue][(uint32_t)RenderGraphQueue::Graphics] + 1); }
+    }
+
+    for (uint32_t position = 0; position < orderCount; position++)
+    {
+        if (result.Passes[position].Queue != RenderGraphQueue::AsyncCompute)
+        { continue; }
+
+        // Nothing waits on this pass until a graphics pass waits on it or on a later async compute pass, otherwise it may run until the end of the graph
+        windowEnds[position] = orderCount - 1;
+        for (uint32_t waiter = position + 1; waiter < orderCount; waiter++)
+        {
+            bool waitsOnPass = false;
+            if (result.Passes[waiter].Queue == RenderGraphQueue::Graphics)
+            {
+                for (RenderGraphPassId waitedPass : result.Passes[waiter].Waits)
+                { waitsOnPass |= positions[waitedPass] >= position; }
+            }
+
+            if (waitsOnPass)
+            {
+                windowEnds[position] = waiter - 1;
+                break;
+            }
+        }
+    }
+
+    //-----------------------------------------------------------------------------------------------------------------
+    // Determine the lifetime of each transient
+    //-----------------------------------------------------------------------------------------------------------------
+    result.Resources.resize(resourceCount);
+    for (RenderGraphResourcePlacement& placement : result.Resources)
+    { placement = { .IsPlaced = false, .HeapClass = 0, .Offset = 0, .FirstPass = NO_PASS, .LastPass = 0 }; }
+
+    for (uint32_t position = 0; position < orderCount; position++)
+    {
+        for (const RenderGraphResourceUse& use : m_Passes[order[position]].Uses)
+        {
+            if (!m_Resources[use.Resource].IsTransient)
+            { continue; }
+
+            RenderGraphResourcePlacement& placement = result.Resources[use.Resource];
+            placement.IsPlaced = true;
+            placement.HeapClass = m_Resources[use.Resource].HeapClass;
+            placement.FirstPass = std::min(placement.FirstPass, windowStarts[position]);
+            placement.LastPass = std::max(placement.LastPass, windowEnds[position]);
+        }
+    }
+
+    std::vector<RenderGraphResourceId> placedResources;
+    for (RenderGraphResourceId i = 0; i < resourceCount; i++)
+    {
+        const Resource& resource = m_Resources[i];
+        RenderGraphResourcePlacement& placement = result.Resources[i];
+        if (!resource.IsTransient)
+        { continue; }
+
+        if (!placement.IsPlaced)
+        {
+            placement.FirstPass = 0;
+            result.Memory.CulledTransientCount++;
+            result.Memory.CulledTransientBytes += resource.SizeBytes;
+            continue;
+        }
+
+        // Extracted resources are used after the graph runs
+        if (resource.IsExtracted)
+        { placement.LastPass = orderCount - 1; }
+
+        placedResources.push_back(i);
+        result.Memory.TransientCount++;
+        result.Memory.TransientBytes += resource.SizeBytes;
+    }
+
+    //-----------------------------------------------------------------------------------------------------------------
+    // Alias transients with non-overlapping lifetimes
+    //-----------------------------------------------------------------------------------------------------------------
+    // Resources are placed largest first since small resources are more likely to fit in the gaps left between larger ones
+    std::stable_sort(placedResources.begin(), placedResources.end(), [&](RenderGraphResourceId a, RenderGraphResourceId b)
+        {
+            return m_Resources[a].SizeBytes > m_Resources[b].SizeBytes;
+        });
+
+    struct Collision
+    {
+        uint64_t Start;
+        uint64_t End;
+    };
+    std::vector<Collision> collisions;
+
+    for (size_t i = 0; i < placedResources.size(); i++)
+    {
+        const Resource& resource = m_Resources[placedResources[i]];
+        RenderGraphResourcePlacement& placement = result.Resources[placedResources[i]];
+
+        collisions.clear();
+        for (size_t j = 0; j < i; j++)
+        {
+            const RenderGraphResourcePlacement& other = result.Resources[placedResources[j]];
+            if (other.HeapClass != placement.HeapClass || other.LastPass < placement.FirstPass || other.FirstPass > placement.LastPass)
+            { continue; }
+
+            Collision collision = { other.Offset, other.Offset + m_Resources[placedResources[j]].SizeBytes };
+            collisions.push_back(collision);
+        }
+
+        std::sort(collisions.begin(), collisions.end(), [](const Collision& a, const Collision& b) { return a.Start < b.Start; });
+
+        uint64_t offset = 0;
+        for (const Collision& collision : collisions)
+        {
+            if (offset + resource.SizeBytes <= collision.Start)
+            { break; }
+
+            offset = std::max(offset, AlignUp(collision.End, resource.Alignment));
+        }
+
+        placement.Offset = offset;
+
+        if (result.HeapSizes.size() <= placement.HeapClass)
+        { result.HeapSizes.resize(placement.HeapClass + 1); }
+        result.HeapSizes[placement.HeapClass] = std::max(result.HeapSizes[placement.HeapClass], offset + resource.SizeBytes);
+    }
+
+    for (uint64_t heapSize : result.HeapSizes)
+    { result.Memory.HeapBytes += heapSize; }
+
+    //-----------------------------------------------------------------------------------------------------------------
+    // Derive barriers
+    //-----------------------------------------------------------------------------------------------------------------
+    struct ResourceBarrierState
+    {
+        RenderGraphAccess Access = RenderGraphAccess::None;
+        uint32_t LastPosition = NO_PASS;
+    };
+    std::vector<ResourceBarrierState> barrierStates(resourceCount);
+
+    for (uint32_t position = 0; position < orderCount; position++)
+    {
+        RenderGraphCompiledPass& compiledPass = result.Passes[position];
+        for (const RenderGraphResourceUse& use : m_Passes[compiledPass.Pass].Uses)
+        {
+            if (!m_Resources[use.Resource].IsTransient)
+            { continue; }
+
+            ResourceBarrierState& state = barrierStates[use.Resource];
+            RenderGraphBarrier barrier = { use.Resource, state.Access, use.Access };
+
+            if (state.Access == RenderGraphAccess::None)
+            {
+                Assert(RenderGraphAccessIsWrite(use.Access) && "The first use of a transient must write to it.");
+                compiledPass.Barriers.push_back(barrier);
+            }
+            else if (NeedsTransition(state.Access, result.Passes[state.LastPosition].Queue, use.Access, compiledPass.Queue))
+            {
+                // Async compute can't transition out of graphics-only accesses, so the previous (graphics) user transitions the resource once it's done with it
+                if (compiledPass.Queue == RenderGraphQueue::AsyncCompute && IsGraphicsOnlyAccess(state.Access))
+                {
+                    Assert(result.Passes[state.LastPosition].Queue == RenderGraphQueue::Graphics);
+                    result.Passes[state.LastPosition].EndBarriers.push_back(barrier);
+                }
+                else
+                { compiledPass.Barriers.push_back(barrier); }
+            }
+            else if (use.Access == RenderGraphAccess::UnorderedAccess && result.Passes[state.LastPosition].Queue == compiledPass.Queue)
+            {
+                // UAV barrier (Work on the other queue is already complete thanks to the wait between them)
+                compiledPass.Barriers.push_back(barrier);
+            }
+
+            state.Access = use.Access;
+            state.LastPosition = position;
+        }
+    }
+
+    return result;
+}
@@ -0,0 +1,175 @@
+#pragma once
+#include <initializer_list>
+#include <span>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+using RenderGraphResourceId = uint32_t;
+using RenderGraphPassId = uint32_t;
+
+enum class RenderGraphQueue
+{
+    Graphics,
+    AsyncCompute,
+    Count
+};
+
+//! How a pass uses a resource, this determines both the dependencies between passes and the barriers between them
+enum class RenderGraphAccess
+{
+    None, //!< Only used by barriers, the resource has just been acquired and its contents are undefined
+    RenderTarget,
+    DepthWrite,
+    DepthRead,
+    ShaderRead,
+    UnorderedAccess,
+    CopySource,
+    CopyDest,
+};
+
+inline bool RenderGraphAccessIsWrite(RenderGraphAccess access)
+{
+    return access == RenderGraphAccess::RenderTarget || access == RenderGraphAccess::DepthWrite || access == RenderGraphAccess::UnorderedAccess || access == RenderGraphAccess::CopyDest;
+}
+
+struct RenderGraphResourceUse
+{
+    RenderGraphResourceId Resource;
+    RenderGraphAccess Access;
+};
+
+//! A barrier which must be recorded on a pass's queue before it runs
+//! Before is None when the resource is being acquired, in which case it needs an aliasing barrier and must be discarded (or fully overwritten) before use.
+//! Before and After are both UnorderedAccess for UAV barriers.
+struct RenderGraphBarrier
+{
+    RenderGraphResourceId Resource;
+    RenderGraphAccess Before;
+    RenderGraphAccess After;
+};
+
+struct RenderGraphCompiledPass
+{
+    RenderGraphPassId Pass;
+    RenderGraphQueue Queue;
+    std::vector<RenderGraphBarrier> Barriers;
+    //! Barriers which must be recorded after the pass runs, these transition resources out of accesses async compute can't transition from (IE: DepthRead)
+    //! when an async compute pass uses them next. Only graphics passes have these.
+    std::vector<RenderGraphBarrier> EndBarriers;
+    //! Passes on other queues which must complete before this one starts, there's at most one per queue
+    std::vector<RenderGraphPassId> Waits;
+    //! True when a pass on another queue waits on this one
+    bool IsWaitedOn;
+};
+
+struct RenderGraphResourcePlacement
+{
+    //! False for imported resources and for transients which are only used by culled passes
+    bool IsPlaced;
+    uint32_t HeapClass;
+    uint64_t Offset;
+    //! The span of compiled pass indices where the resource is in use, inclusive
+    uint32_t FirstPass;
+    uint32_t LastPass;
+};
+
+struct RenderGraphMemoryReport
+{
+    uint32_t PassCount;
+    uint32_t CulledPassCount;
+    uint32_t TransientCount; //!< Placed transients, transients which were culled aren't included
+    uint32_t CulledTransientCount;
+    uint64_t TransientBytes; //!< Memory the placed transients would need if each had its own allocation
+    uint64_t CulledTransientBytes;
+    uint64_t HeapBytes; //!< Memory needed by the heaps the transients were aliased into
+
+    inline uint64_t AliasingSavedBytes() const { return TransientBytes - HeapBytes; }
+};
+
+//! The outcome of RenderGraph::Compile
+struct RenderGraphCompilation
+{
+    //! The passes which survived culling in the order they should be recorded
+    std::vector<RenderGraphCompiledPass> Passes;
+    //! Indexed by RenderGraphResourceId
+    std::vector<RenderGraphResourcePlacement> Resources;
+    //! The size each heap class needs to be, indexed by heap class
+    std::vector<uint64_t> HeapSizes;
+    RenderGraphMemoryReport Memory;
+};
+
+//! A frame's passes along with the resources they read and write, compiled into a schedule with barriers and memory aliasing
+//!
+//! Passes are added in the order they'd run in on a single queue, and a pass can only depend on passes added before it so the graph can never contain a cycle.
+//! Compiling the graph:
+//! * Culls passes whose results are never used. Passes are kept when they have side effects, write an imported or extracted resource, or write a transient
+//!   which is used by a later pass which is kept. (Writes are assumed to be partial, so earlier writers of a resource written by a kept pass are kept too.)
+//! * Hoists async compute passes to right after the last pass they depend on so they overlap as much graphics work as possible, and adds the minimum set of
+//!   cross-queue waits needed to honor every dependency.
+//! * Aliases transients whose lifetimes don't overlap into shared heaps. Async compute passes are assumed to run at any point between the passes they wait on
+//!   and the passes which wait on them, so their resources have conservative lifetimes. Transients are placed largest first at the lowest offset which doesn't
+//!   collide with a placed resource whose lifetime overlaps.
+//! * Derives the barriers needed between uses of each transient, including acquiring it when its lifetime starts. The first use of a transient must write to it.
+//!
+//! Transients only alias transients with the same heap class, the class is arbitrary and up to the caller. (IE: To meet the resource heap tier 1 requirement
+//! that buffers, render target/depth stencil textures, and other textures don't share heaps.)
+//! Imported resources are owned outside of the graph, they only affect culling and ordering. Their owners are responsible for their barriers.
+//! This type has no dependency on D3D (or anything else) so that it can be tested and evaluated without a GPU, see GpuRenderGraph for the D3D12 implementation.
+class RenderGraph
+{
+private:
+    struct Resource
+    {
+        std::string Name;
+        bool IsTransient;
+        bool IsExtracted;
+        uint64_t SizeBytes;
+        uint64_t Alignment;
+        uint32_t HeapClass;
+    };
+
+    struct Pass
+    {
+        std::string Name;
+        RenderGraphQueue Queue;
+        std::vector<RenderGraphResourceUse> Uses;
+        bool HasSideEffects;
+    };
+
+    std::vector<Resource> m_Resources;
+    std::vector<Pass> m_Passes;
+
+public:
+    RenderGraph() = default;
+    RenderGraph(const RenderGraph&) = delete;
+
+    //! Declares a resource whose memory is provided by the graph, alignment must be a power of two
+    RenderGraphResourceId CreateTransient(std::string name, uint64_t sizeBytes, uint64_t alignment, uint32_t heapClass);
+
+    //! Declares a resource owned outside of the graph, passes which write to it are never culled
+    RenderGraphResourceId Import(std::string name);
+
+    //! Marks a transient as being used after the graph has run (until the next time the graph's memory is reused)
+    //! Its lifetime extends to the end of the graph and the passes which write to it are never culled.
+    void Extract(RenderGraphResourceId resource);
+
+    //! Adds a pass, each resource may only be used once per pass
+    //! Async compute passes may only use resources as shader reads, unordered access, or copy sources and destinations.
+    RenderGraphPassId AddPass(std::string name, RenderGraphQueue queue, std::span<const RenderGraphResourceUse> uses, bool hasSideEffects = false);
+
+    inline RenderGraphPassId AddPass(std::string name, RenderGraphQueue queue, std::initializer_list<RenderGraphResourceUse> uses, bool hasSideEffects = false)
+    { return AddPass(std::move(name), queue, std::span<const RenderGraphResourceUse>(uses.begin(), uses.size()), hasSideEffects); }
+
+    //! Removes every pass and resource
+    void Clear();
+
+    inline uint32_t PassCount() const { return (uint32_t)m_Passes.size(); }
+    inline uint32_t ResourceCount() const { return (uint32_t)m_Resources.size(); }
+    inline const std::string& PassName(RenderGraphPassId pass) const { return m_Passes[pass].Name; }
+    inline const std::string& ResourceName(RenderGraphResourceId resource) const { return m_Resources[resource].Name; }
+    inline RenderGraphQueue PassQueue(RenderGraphPassId pass) const { return m_Passes[pass].Queue; }
+    inline bool IsTransient(RenderGraphResourceId resource) const { return m_Resources[resource].IsTransient; }
+
+    RenderGraphCompilation Compile() const;
+};
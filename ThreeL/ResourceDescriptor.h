@@ -7,16 +7,20 @@ struct ResourceDescriptor
 private:
     D3D12_CPU_DESCRIPTOR_HANDLE m_StagingHandle;
     D3D12_GPU_DESCRIPTOR_HANDLE m_ResidentHandle;
+    uint32_t m_Generation;
 
 public:
     ResourceDescriptor()
-        : m_StagingHandle(), m_ResidentHandle()
+        : m_StagingHandle(), m_ResidentHandle(), m_Generation(0)
     { }
 
-    ResourceDescriptor(D3D12_CPU_DESCRIPTOR_HANDLE stagingHandle, D3D12_GPU_DESCRIPTOR_HANDLE residentHandle)
-        : m_StagingHandle(stagingHandle), m_ResidentHandle(residentHandle)
+    ResourceDescriptor(D3D12_CPU_DESCRIPTOR_HANDLE stagingHandle, D3D12_GPU_DESCRIPTOR_HANDLE residentHandle, uint32_t generation)
+        : m_StagingHandle(stagingHandle), m_ResidentHandle(residentHandle), m_Generation(generation)
     { }
 
     inline D3D12_CPU_DESCRIPTOR_HANDLE StagingHandle() const { return m_StagingHandle; }
     inline D3D12_GPU_DESCRIPTOR_HANDLE ResidentHandle() const { return m_ResidentHandle; }
+
+    //! Used to detect use of the descriptor after it has been freed, see DescriptorHandle
+    inline uint32_t Generation() const { return m_Generation; }
 };
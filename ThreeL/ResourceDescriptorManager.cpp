@@ -4,7 +4,7 @@
 #include "GraphicsCore.h"
 
 ResourceDescriptorManager::ResourceDescriptorManager(GraphicsCore& graphics)
-    : m_Graphics(graphics)
+    : m_Graphics(graphics), m_ResidentAllocator(RESIDENT_DESCRIPTOR_COUNT), m_DynamicRing(DYNAMIC_DESCRIPTOR_COUNT)
 {
     m_DescriptorSize = m_Graphics.Device()->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
 
@@ -31,17 +31,16 @@ ResourceDescriptorManager::ResourceDescriptorManager(GraphicsCore& graphics)
     m_DynamicGpuHandle0.ptr = m_ResidentGpuHandle0.ptr + dynamicSegmentOffset;
 }
 
-uint32_t ResourceDescriptorManager::AllocateResidentDescriptor()
+DescriptorHandle ResourceDescriptorManager::AllocateResidentDescriptor()
 {
-    uint32_t index = InterlockedIncrement(&m_NextFreeResidentDescriptorIndex) - 1;
-
-    //TODO: Right now there is no mechanism for freeing reisdent descriptors, they're allocated for the lifetime of the GraphicsCore.
-    if (index >= RESIDENT_DESCRIPTOR_COUNT)
+    std::lock_guard<std::mutex> lock(m_ResidentAllocatorLock);
+    DescriptorHandle handle;
+    if (!m_ResidentAllocator.TryAllocate(&handle))
     {
-        Fail("Reisdent descriptor heap exhausted.");
+        Fail("Resident descriptor heap exhausted.");
     }
 
-    return index;
+    return handle;
 }
 
 DynamicResourceDescriptor ResourceDescriptorManager::AllocateDynamicDescriptor()
@@ -49,6 +48,29 @@ DynamicResourceDescriptor ResourceDescriptorManager::AllocateDynamicDescriptor()
     return DynamicResourceDescriptor(*this, AllocateResidentDescriptor());
 }
 
+void ResourceDescriptorManager::FreeResidentDescriptor(const ResourceDescriptor& descriptor)
+{
+    DescriptorHandle handle = { .Index = GetResidentIndex(descriptor), .Generation = descriptor.Generation() };
+    std::lock_guard<std::mutex> lock(m_ResidentAllocatorLock);
+    m_ResidentAllocator.Free(handle);
+}
+
+void ResourceDescriptorManager::FreeResidentDescriptor(const ResourceDescriptor& descriptor, const GpuSyncPoint& syncPoint)
+{
+    m_PendingFreeCount++;
+    syncPoint.Then(m_Graphics.FenceReactor(), [this, descriptor]()
+        {
+            FreeResidentDescriptor(descriptor);
+            m_PendingFreeCount--;
+        });
+}
+
+DescriptorAllocatorStatistics ResourceDescriptorManager::ResidentStatistics()
+{
+    std::lock_guard<std::mutex> lock(m_ResidentAllocatorLock);
+    return m_ResidentAllocator.Statistics();
+}
+
 ResourceDescriptor ResourceDescriptorManager::CreateConstantBufferView(const D3D12_CONSTANT_BUFFER_VIEW_DESC& description)
 {
     DynamicResourceDescriptor handle = AllocateDynamicDescriptor();
@@ -80,24 +102,29 @@ DynamicDescriptorTableBuilder ResourceDescriptorManager::AllocateDynamicTable(ui
 {
     Assert(length > 1); // Dynamic tables must have more than one entry.
 
-TryAgain:
-    uint64_t tableEnd = InterlockedAdd64((int64_t*)&m_NextFreeDynamicDescriptorIndex, length);
-
-    // Handle overflow of NextFreeDynamicDescriptorIndex
-    if (tableEnd < length)
+    uint32_t tableStart;
     {
-        goto TryAgain;
+        std::lock_guard<std::mutex> lock(m_DynamicRingLock);
+        while (!m_DynamicRing.TryAllocate(length, &tableStart))
+        {
+            // The heap can't grow without invalidating every table which is already bound, so all we can do is wait for the GPU to catch up
+            if (m_DynamicFrames.empty())
+            {
+                Fail("Dynamic descriptor ring exhausted by a single frame.");
+            }
+
+            m_DynamicRingStallCount++;
+            const DynamicFrame& oldest = m_DynamicFrames.front();
+            oldest.GraphicsSyncPoint.Wait();
+            oldest.ComputeSyncPoint.Wait();
+            RetireDynamicFrames();
+        }
     }
 
-    uint64_t tableStart = tableEnd - length;
-
-    //TODO: Ensure that the allocated table does not crash into the back end of descriptors which are still in use
-    // Right now we rely on the fact that the dynamic descriptor table is very large, even if it's just for validation it'd be nice to validate.
-
     // Create the table builder
     D3D12_CPU_DESCRIPTOR_HANDLE cpuHandle = m_DynamicCpuHandle0;
     D3D12_GPU_DESCRIPTOR_HANDLE gpuHandle = m_DynamicGpuHandle0;
-    uint64_t handleOffset = tableStart * m_DescriptorSize;
+    uint64_t handleOffset = (uint64_t)tableStart * m_DescriptorSize;
     cpuHandle.ptr += (size_t)handleOffset;
     gpuHandle.ptr += handleOffset;
 
@@ -109,3 +136,43 @@ TryAgain:
         length
     };
 }
+
+void ResourceDescriptorManager::RetireDynamicFrames()
+{
+    // Must be called with m_DynamicRingLock held
+    uint64_t completedFenceValue = 0;
+    while (!m_DynamicFrames.empty())
+    {
+        const DynamicFrame& frame = m_DynamicFrames.front();
+        if (!frame.GraphicsSyncPoint.WasReached() || !frame.ComputeSyncPoint.WasReached())
+        { break; }
+
+        completedFenceValue = frame.FenceValue;
+        m_DynamicFrames.pop_front();
+    }
+
+    m_DynamicRing.Retire(completedFenceValue);
+}
+
+void ResourceDescriptorManager::EndFrame()
+{
+    std::lock_guard<std::mutex> lock(m_DynamicRingLock);
+    uint64_t fenceValue = m_NextDynamicFrameFenceValue++;
+    m_DynamicRing.EndFrame(fenceValue);
+    DynamicFrame frame =
+    {
+        .FenceValue = fenceValue,
+        .GraphicsSyncPoint = m_Graphics.GraphicsQueue().QueueSyncPoint(),
+        .ComputeSyncPoint = m_Graphics.ComputeQueue().QueueSyncPoint(),
+    };
+    m_DynamicFrames.push_back(frame);
+
+    // Retire eagerly so that the statistics reflect what's actually in flight
+    RetireDynamicFrames();
+}
+
+DescriptorRingStatistics ResourceDescriptorManager::DynamicStatistics()
+{
+    std::lock_guard<std::mutex> lock(m_DynamicRingLock);
+    return m_DynamicRing.Statistics();
+}
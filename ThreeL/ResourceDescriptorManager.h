@@ -1,9 +1,15 @@
 #pragma once
 #include "pch.h"
+#include "DescriptorAllocator.h"
+#include "DescriptorRing.h"
 #include "DynamicDescriptorTableBuilder.h"
 #include "DynamicResourceDescriptor.h"
+#include "GpuSyncPoint.h"
 #include "ResourceDescriptor.h"
 
+#include <atomic>
+#include <deque>
+#include <mutex>
 #include <tuple>
 
 class GraphicsCore;
@@ -18,8 +24,10 @@ class GraphicsCore;
 /// * The dynamic descriptor segment
 ///
 /// The resident descriptor segment is used for the individual descriptors corresponding to long-lived resources like textures.
+/// Resident descriptors are recycled through a free list once they're freed, see <see cref="FreeResidentDescriptor"/>.
 ///
 /// The dynamic descriptor segment is a ring buffer of ephemeral descriptors used to build descriptor tables during rendering.
+/// Dynamic tables live until the GPU finishes the frame they were allocated in, see <see cref="EndFrame"/>.
 ///
 /// (In the future we might add the ability to pre-allocate long-lived descriptor tables out of the resident segment, but this is currently not supported.)
 ///
@@ -43,10 +51,25 @@ private:
     D3D12_CPU_DESCRIPTOR_HANDLE m_DynamicCpuHandle0;
     D3D12_GPU_DESCRIPTOR_HANDLE m_DynamicGpuHandle0;
 
-    uint32_t m_NextFreeResidentDescriptorIndex = 0;
-    uint64_t m_NextFreeDynamicDescriptorIndex = 0;
+    std::mutex m_ResidentAllocatorLock;
+    DescriptorAllocator m_ResidentAllocator;
+    std::atomic<uint32_t> m_PendingFreeCount = 0;
 
-    static const uint32_t RESIDENT_DESCRIPTOR_COUNT = 4096;
+    // The end of the GPU work from a frame which allocated dynamic tables, fence values are frame serials as far as the ring is concerned
+    struct DynamicFrame
+    {
+        uint64_t FenceValue;
+        GpuSyncPoint GraphicsSyncPoint;
+        GpuSyncPoint ComputeSyncPoint;
+    };
+
+    std::mutex m_DynamicRingLock;
+    DescriptorRing m_DynamicRing;
+    std::deque<DynamicFrame> m_DynamicFrames;
+    uint64_t m_NextDynamicFrameFenceValue = 1;
+    std::atomic<uint32_t> m_DynamicRingStallCount = 0;
+
+    static const uint32_t RESIDENT_DESCRIPTOR_COUNT = 65536;
 #ifdef DEBUG
     // On debug builds, use a more modestly-sized descriptor heap so we more easily notice out of control heap usage
     static const uint32_t TOTAL_DESCRIPTOR_COUNT = RESIDENT_DESCRIPTOR_COUNT * 2;
@@ -61,19 +84,39 @@ public:
     ResourceDescriptorManager(GraphicsCore& graphics);
 
 private:
-    uint32_t AllocateResidentDescriptor();
+    DescriptorHandle AllocateResidentDescriptor();
+    void RetireDynamicFrames();
 
 public:
     DynamicResourceDescriptor AllocateDynamicDescriptor();
 
+    //! Frees the descriptor for reuse, the descriptor must not be in use by the GPU
+    void FreeResidentDescriptor(const ResourceDescriptor& descriptor);
+
+    //! Frees the descriptor for reuse once the GPU reaches the specified sync point
+    void FreeResidentDescriptor(const ResourceDescriptor& descriptor, const GpuSyncPoint& syncPoint);
+
+    //! Statistics for the resident segment, descriptors waiting on a sync point before they're freed are counted as live
+    DescriptorAllocatorStatistics ResidentStatistics();
+    inline uint32_t PendingFreeCount() const { return m_PendingFreeCount; }
+
     ResourceDescriptor CreateConstantBufferView(const D3D12_CONSTANT_BUFFER_VIEW_DESC& description);
     ResourceDescriptor CreateShaderResourceView(ID3D12Resource* resource, const D3D12_SHADER_RESOURCE_VIEW_DESC& description);
     ResourceDescriptor CreateUnorderedAccessView(ID3D12Resource* resource, ID3D12Resource* counterResource, const D3D12_UNORDERED_ACCESS_VIEW_DESC& description);
 
     std::tuple<D3D12_CPU_DESCRIPTOR_HANDLE, D3D12_GPU_DESCRIPTOR_HANDLE> AllocateUninitializedResidentDescriptor();
 
+    //! Allocates a descriptor table which lives until the GPU finishes the current frame
+    //! If the ring is full this stalls until the GPU finishes the oldest frame using it.
     DynamicDescriptorTableBuilder AllocateDynamicTable(uint32_t length);
 
+    //! Ends the current frame for the purposes of dynamic descriptor tables
+    //! Must be called once all work using the frame's tables has been submitted to the graphics and compute queues.
+    void EndFrame();
+
+    DescriptorRingStatistics DynamicStatistics();
+    inline uint32_t DynamicStallCount() const { return m_DynamicRingStallCount; }
+
     inline ID3D12DescriptorHeap* GpuHeap() const { return m_GpuHeap.Get(); }
 
     //TODO: This exists to enable bindless, ideally we should probably just rip out all the bindful stuff or make it the exception instead
@@ -3,271 +3,525 @@
 
 #include "GraphicsCore.h"
 #include "HlslCompiler.h"
+#include "JobGraph.h"
+#include "JobSystem.h"
+#include "ShaderInterop.h"
 
-ResourceManager::ResourceManager(GraphicsCore& graphics)
-    : Graphics(graphics), PbrMaterials(graphics), MeshHeap(graphics)
+#include <deque>
+
+namespace
+{
+    struct ShaderJob
+    {
+        ShaderBlobs Shader;
+        std::string Diagnostics;
+    };
+}
+
+ResourceManager::ResourceManager(GraphicsCore& graphics, JobSystem& jobs)
+    : Graphics(graphics), PbrMaterials(graphics), MeshHeap(graphics), StreamedTextures(graphics)
 {
-    HlslCompiler hlslCompiler;
+    // Shaders are compiled and pipeline states are created by a job graph so that they're spread across every core
+    // Nothing actually happens until the graph is run below, each pipeline state is created as soon as the shaders and root signature it needs are ready.
+    JobGraph graph;
+
+    // DXC compilers must only be used by one thread at a time, so each thread gets its own
+    std::vector<std::unique_ptr<HlslCompiler>> compilers(jobs.WorkerCount() + 1);
+    auto Compiler = [&](uint32_t threadIndex) -> HlslCompiler&
+        {
+            if (compilers[threadIndex] == nullptr)
+            { compilers[threadIndex] = std::make_unique<HlslCompiler>(); }
+            return *compilers[threadIndex];
+        };
+
+    // The job which produces each shader and root signature, used to find the dependencies of the jobs which use them
+    std::unordered_map<const void*, JobId> producers;
+    auto After = [&](std::initializer_list<const void*> inputs)
+        {
+            std::vector<JobId> dependencies;
+            for (const void* input : inputs)
+            { dependencies.push_back(producers.at(input)); }
+            return dependencies;
+        };
 
-    BitonicSort = ::BitonicSort(Graphics, hlslCompiler);
+    // A deque is used so that the shaders don't move as more are added
+    std::deque<ShaderJob> shaderJobs;
+    auto CompileShader = [&](std::wstring filePath, std::wstring entryPoint, std::wstring target, std::vector<std::wstring> defines = {}) -> ShaderBlobs&
+        {
+            ShaderJob& shaderJob = shaderJobs.emplace_back();
+            std::string name = std::format("Compile {} {}", filePath, entryPoint);
+            for (const std::wstring& define : defines)
+            { name += std::format(" {}", define); }
+
+            producers[&shaderJob.Shader] = graph.Add(name, { }, [&Compiler, &shaderJob, filePath, entryPoint, target, defines](JobContext& context)
+                {
+                    std::optional<ShaderBlobs> shader = Compiler(context.ThreadIndex).TryCompileShader(filePath, entryPoint, target, defines, shaderJob.Diagnostics);
+                    if (shader.has_value())
+                    { shaderJob.Shader = std::move(*shader); }
+                    else
+                    { context.Error = std::move(shaderJob.Diagnostics); }
+                });
+
+            return shaderJob.Shader;
+        };
+
+    auto CreateRootSignature = [&](RootSignature& rootSignature, const ShaderBlobs& shader, std::wstring name)
+        {
+            producers[&rootSignature] = graph.Add(std::format("Create {}", name), After({ &shader }), [this, &rootSignature, &shader, name](JobContext&)
+                { rootSignature = RootSignature(Graphics, shader, name); });
+        };
+
+    // The bitonic sort compiles its own shaders, so it's done as a single job
+    graph.Add("Create bitonic sort", { }, [&](JobContext& context) { BitonicSort = ::BitonicSort(Graphics, Compiler(context.ThreadIndex)); });
 
     // Compile all shaders
-    ShaderBlobs pbrVs = hlslCompiler.CompileShader(L"Shaders/Pbr.hlsl", L"VsMain", L"vs_6_0");
-    ShaderBlobs pbrPs = hlslCompiler.CompileShader(L"Shaders/Pbr.hlsl", L"PsMain", L"ps_6_0");
-    ShaderBlobs pbrPsLightDebug = hlslCompiler.CompileShader(L"Shaders/Pbr.hlsl", L"PsMain", L"ps_6_0", { L"DEBUG_LIGHT_BOUNDARIES" });
+    ShaderBlobs& pbrVs = CompileShader(L"Shaders/Pbr.hlsl", L"VsMain", L"vs_6_0");
+    ShaderBlobs& pbrPs = CompileShader(L"Shaders/Pbr.hlsl", L"PsMain", L"ps_6_0");
+    ShaderBlobs& pbrPsLightDebug = CompileShader(L"Shaders/Pbr.hlsl", L"PsMain", L"ps_6_0", { L"DEBUG_LIGHT_BOUNDARIES" });
+    ShaderBlobs& pbrVsInstanced = CompileShader(L"Shaders/Pbr.hlsl", L"VsMain", L"vs_6_0", { L"PBR_INSTANCED" });
 
-    ShaderBlobs depthOnlyVs = hlslCompiler.CompileShader(L"Shaders/DepthOnly.hlsl", L"VsMain", L"vs_6_0");
-    ShaderBlobs depthOnlyPs = hlslCompiler.CompileShader(L"Shaders/DepthOnly.hlsl", L"PsMain", L"ps_6_0");
+    ShaderBlobs& depthOnlyVs = CompileShader(L"Shaders/DepthOnly.hlsl", L"VsMain", L"vs_6_0");
+    ShaderBlobs& depthOnlyPs = CompileShader(L"Shaders/DepthOnly.hlsl", L"PsMain", L"ps_6_0");
+    ShaderBlobs& depthOnlyVsInstanced = CompileShader(L"Shaders/DepthOnly.hlsl", L"VsMain", L"vs_6_0", { L"PBR_INSTANCED" });
 
-    ShaderBlobs fullScreenQuadVs = hlslCompiler.CompileShader(L"Shaders/FullScreenQuad.vs.hlsl", L"VsMain", L"vs_6_0");
+    ShaderBlobs& fullScreenQuadVs = CompileShader(L"Shaders/FullScreenQuad.vs.hlsl", L"VsMain", L"vs_6_0");
 
-    ShaderBlobs depthDownsamplePs = hlslCompiler.CompileShader(L"Shaders/DepthDownsample.ps.hlsl", L"PsMain", L"ps_6_0");
+    ShaderBlobs& depthDownsamplePs = CompileShader(L"Shaders/DepthDownsample.ps.hlsl", L"PsMain", L"ps_6_0");
 
-    ShaderBlobs generateMipMapsCsUnorm = hlslCompiler.CompileShader(L"Shaders/GenerateMipmapChain.cs.hlsl", L"Main", L"cs_6_0", { L"GENERATE_UNORM_MIPMAP_CHAIN" });
-    ShaderBlobs generateMipMapsCsFloat = hlslCompiler.CompileShader(L"Shaders/GenerateMipmapChain.cs.hlsl", L"Main", L"cs_6_0");
+    ShaderBlobs& generateMipMapsCsUnorm = CompileShader(L"Shaders/GenerateMipmapChain.cs.hlsl", L"Main", L"cs_6_0", { L"GENERATE_UNORM_MIPMAP_CHAIN" });
+    ShaderBlobs& generateMipMapsCsFloat = CompileShader(L"Shaders/GenerateMipmapChain.cs.hlsl", L"Main", L"cs_6_0");
 
-    ShaderBlobs lightLinkedListFillVs = hlslCompiler.CompileShader(L"Shaders/LightLinkedListFill.hlsl", L"VsMain", L"vs_6_0");
-    ShaderBlobs lightLinkedListFillPs = hlslCompiler.CompileShader(L"Shaders/LightLinkedListFill.hlsl", L"PsMain", L"ps_6_0");
+    ShaderBlobs& lightLinkedListFillVs = CompileShader(L"Shaders/LightLinkedListFill.hlsl", L"VsMain", L"vs_6_0");
+    ShaderBlobs& lightLinkedListFillPs = CompileShader(L"Shaders/LightLinkedListFill.hlsl", L"PsMain", L"ps_6_0");
 
-    ShaderBlobs lightLinkedListDebugPs = hlslCompiler.CompileShader(L"Shaders/LightLinkedListDebug.ps.hlsl", L"PsMain", L"ps_6_0");
+    ShaderBlobs& lightLinkedListDebugPs = CompileShader(L"Shaders/LightLinkedListDebug.ps.hlsl", L"PsMain", L"ps_6_0");
 
     std::vector<std::wstring> lightLinkedListStatsCsDefines;
     // My Intel UHD 620 is choking on the groupshared optimization in this shader.
     // I've also seen a AMD RX 6700 XT choking on this in a different way (light count is randomly corrupted), so let's just disable the optimization for now.
     //if (Graphics.IsIntel())
     lightLinkedListStatsCsDefines.push_back(L"NO_GROUPSHARED");
-    ShaderBlobs lightLinkedListStatsCs = hlslCompiler.CompileShader(L"Shaders/LightLinkedListStats.cs.hlsl", L"Main", L"cs_6_0", lightLinkedListStatsCsDefines);
+    ShaderBlobs& lightLinkedListStatsCs = CompileShader(L"Shaders/LightLinkedListStats.cs.hlsl", L"Main", L"cs_6_0", lightLinkedListStatsCsDefines);
 
-    ShaderBlobs lightSpritesVs = hlslCompiler.CompileShader(L"Shaders/LightSprites.hlsl", L"VsMain", L"vs_6_0");
-    ShaderBlobs lightSpritesPs = hlslCompiler.CompileShader(L"Shaders/LightSprites.hlsl", L"PsMain", L"ps_6_0");
+    ShaderBlobs& lightSpritesVs = CompileShader(L"Shaders/LightSprites.hlsl", L"VsMain", L"vs_6_0");
+    ShaderBlobs& lightSpritesPs = CompileShader(L"Shaders/LightSprites.hlsl", L"PsMain", L"ps_6_0");
 
-    ShaderBlobs particleSystemSpawn = hlslCompiler.CompileShader(L"Shaders/ParticleSystem.cs.hlsl", L"MainSpawn", L"cs_6_0");
-    ShaderBlobs particleSystemUpdate = hlslCompiler.CompileShader(L"Shaders/ParticleSystem.cs.hlsl", L"MainUpdate", L"cs_6_0");
-    ShaderBlobs particleSystemPrepareDrawIndirect = hlslCompiler.CompileShader(L"Shaders/ParticleSystem.cs.hlsl", L"MainPrepareDrawIndirect", L"cs_6_0");
+    ShaderBlobs& particleSystemSpawn = CompileShader(L"Shaders/ParticleSystem.cs.hlsl", L"MainSpawn", L"cs_6_0");
+    ShaderBlobs& particleSystemUpdate = CompileShader(L"Shaders/ParticleSystem.cs.hlsl", L"MainUpdate", L"cs_6_0");
+    ShaderBlobs& particleSystemUpdateTemporalSort = CompileShader(L"Shaders/ParticleSystem.cs.hlsl", L"MainUpdate", L"cs_6_0", { L"PARTICLE_TEMPORAL_SORT" });
+    ShaderBlobs& particleSystemPrepareDrawIndirect = CompileShader(L"Shaders/ParticleSystem.cs.hlsl", L"MainPrepareDrawIndirect", L"cs_6_0");
+    ShaderBlobs& particleSystemPrepareUpdateIndirect = CompileShader(L"Shaders/ParticleSystem.cs.hlsl", L"MainPrepareUpdateIndirect", L"cs_6_0");
+    ShaderBlobs& particleSystemPrepareSpawnIndirect = CompileShader(L"Shaders/ParticleSystem.cs.hlsl", L"MainPrepareSpawnIndirect", L"cs_6_0");
 
-    ShaderBlobs particleRenderVs = hlslCompiler.CompileShader(L"Shaders/ParticleRender.hlsl", L"VsMainParticle", L"vs_6_0");
-    ShaderBlobs particleRenderPs = hlslCompiler.CompileShader(L"Shaders/ParticleRender.hlsl", L"PsMain", L"ps_6_0");
-    ShaderBlobs particleRenderPsLightDebug = hlslCompiler.CompileShader(L"Shaders/ParticleRender.hlsl", L"PsMain", L"ps_6_0", { L"DEBUG_LIGHT_BOUNDARIES" });
-
-    // Create root signatures
-    PbrRootSignature = RootSignature(Graphics, pbrVs, L"PBR Root Signature");
-    DepthOnlyRootSignature = RootSignature(Graphics, depthOnlyVs, L"DepthOnly Root Signature");
-    DepthDownsampleRootSignature = RootSignature(Graphics, depthDownsamplePs, L"DepthDownsample Root Signature");
-    GenerateMipMapsRootSignature = RootSignature(Graphics, generateMipMapsCsUnorm, L"GenerateMipMaps Root Signature");
-    LightLinkedListFillRootSignature = RootSignature(Graphics, lightLinkedListFillVs, L"LightLinkedList Fill Root Signature");
-    LightLinkedListDebugRootSignature = RootSignature(Graphics, lightLinkedListDebugPs, L"LightLinkedList Debug Root Signature");
-    LightLinkedListStatsRootSignature = RootSignature(Graphics, lightLinkedListStatsCs, L"LightLinkedList Statistics Root Signature");
-    LightSpritesRootSignature = RootSignature(Graphics, lightSpritesVs, L"Light Sprites Root Signature");
-    ParticleSystemRootSignature = RootSignature(Graphics, particleSystemSpawn, L"Particle System Root Signature");
-    ParticleRenderRootSignature = RootSignature(Graphics, particleRenderVs, L"Particle Render Root Signature");
-
-    // Create PBR pipeline state objects
-    {
-        D3D12_GRAPHICS_PIPELINE_STATE_DESC pbrDescription = PipelineStateObject::BaseDescription;
-        pbrDescription.pRootSignature = PbrRootSignature.Get();
-        pbrDescription.VS = pbrVs.ShaderBytecode();
-        pbrDescription.PS = pbrPs.ShaderBytecode();
+    ShaderBlobs& particleSortMeasureDisorder = CompileShader(L"Shaders/ParticleSortFixUp.cs.hlsl", L"MainMeasureDisorder", L"cs_6_0");
+    ShaderBlobs& particleSortPrepareFixUp = CompileShader(L"Shaders/ParticleSortFixUp.cs.hlsl", L"MainPrepareFixUp", L"cs_6_0");
+    ShaderBlobs& particleSortFixUp = CompileShader(L"Shaders/ParticleSortFixUp.cs.hlsl", L"MainFixUp", L"cs_6_0");
+    ShaderBlobs& particleSortMergeSpawned = CompileShader(L"Shaders/ParticleSortFixUp.cs.hlsl", L"MainMergeSpawned", L"cs_6_0");
+    ShaderBlobs& particleSortPrepareFallback = CompileShader(L"Shaders/ParticleSortFixUp.cs.hlsl", L"MainPrepareFallback", L"cs_6_0");
 
-        // Depth pre-pass
-        pbrDescription.DepthStencilState.DepthFunc = D3D12_COMPARISON_FUNC_EQUAL;
-        pbrDescription.DepthStencilState.DepthWriteMask = D3D12_DEPTH_WRITE_MASK_ZERO;
+    ShaderBlobs& particleRenderVs = CompileShader(L"Shaders/ParticleRender.hlsl", L"VsMainParticle", L"vs_6_0");
+    ShaderBlobs& particleRenderPs = CompileShader(L"Shaders/ParticleRender.hlsl", L"PsMain", L"ps_6_0");
+    ShaderBlobs& particleRenderPsLightDebug = CompileShader(L"Shaders/ParticleRender.hlsl", L"PsMain", L"ps_6_0", { L"DEBUG_LIGHT_BOUNDARIES" });
+    ShaderBlobs& particleRenderVsCachedLighting = CompileShader(L"Shaders/ParticleRender.hlsl", L"VsMainParticle", L"vs_6_0", { L"PARTICLE_LIGHTING_CACHE" });
+    ShaderBlobs& particleRenderPsCachedLighting = CompileShader(L"Shaders/ParticleRender.hlsl", L"PsMain", L"ps_6_0", { L"PARTICLE_LIGHTING_CACHE" });
 
-        D3D12_INPUT_ELEMENT_DESC inputLayout[] =
-        {
-            // SemanticName, SemanticIndex, Format, InputSlot
-            { "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, MeshInputSlot::Position },
-            { "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, MeshInputSlot::Normal },
-            { "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, MeshInputSlot::Uv0 },
-        };
-        pbrDescription.InputLayout = { inputLayout, (UINT)std::size(inputLayout) };
+    ShaderBlobs& particleLighting = CompileShader(L"Shaders/ParticleLighting.cs.hlsl", L"MainComputeLighting", L"cs_6_0");
 
-        D3D12_GRAPHICS_PIPELINE_STATE_DESC pbrLightDebugDescription = pbrDescription;
+    ShaderBlobs& sceneCullingClearCounts = CompileShader(L"Shaders/SceneCulling.cs.hlsl", L"MainClearCounts", L"cs_6_0");
+    ShaderBlobs& sceneCulling = CompileShader(L"Shaders/SceneCulling.cs.hlsl", L"MainCull", L"cs_6_0");
 
-        // Create opaque PSOs
-        PbrBlendOffSingleSided = PipelineStateObject(Graphics, pbrDescription, L"PBR PSO - Opaque Single Sided");
-        pbrDescription.RasterizerState.CullMode = D3D12_CULL_MODE_NONE;
-        PbrBlendOffDoubleSided = PipelineStateObject(Graphics, pbrDescription, L"PBR PSO - Opaque Double Sided");
+    // Create root signatures
+    CreateRootSignature(PbrRootSignature, pbrVs, L"PBR Root Signature");
+    CreateRootSignature(DepthOnlyRootSignature, depthOnlyVs, L"DepthOnly Root Signature");
+    CreateRootSignature(DepthDownsampleRootSignature, depthDownsamplePs, L"DepthDownsample Root Signature");
+    CreateRootSignature(GenerateMipMapsRootSignature, generateMipMapsCsUnorm, L"GenerateMipMaps Root Signature");
+    CreateRootSignature(LightLinkedListFillRootSignature, lightLinkedListFillVs, L"LightLinkedList Fill Root Signature");
+    CreateRootSignature(LightLinkedListDebugRootSignature, lightLinkedListDebugPs, L"LightLinkedList Debug Root Signature");
+    CreateRootSignature(LightLinkedListStatsRootSignature, lightLinkedListStatsCs, L"LightLinkedList Statistics Root Signature");
+    CreateRootSignature(LightSpritesRootSignature, lightSpritesVs, L"Light Sprites Root Signature");
+    CreateRootSignature(ParticleSystemRootSignature, particleSystemSpawn, L"Particle System Root Signature");
+    CreateRootSignature(ParticleSortFixUpRootSignature, particleSortMeasureDisorder, L"Particle Sort Fix-up Root Signature");
+    CreateRootSignature(ParticleRenderRootSignature, particleRenderVs, L"Particle Render Root Signature");
+    CreateRootSignature(ParticleLightingRootSignature, particleLighting, L"Particle Lighting Root Signature");
+    CreateRootSignature(SceneCullingRootSignature, sceneCulling, L"Scene Culling Root Signature");
 
-        // Create alpha-blended PSOs
-        pbrDescription.DepthStencilState.DepthWriteMask = D3D12_DEPTH_WRITE_MASK_ZERO;
-        pbrDescription.BlendState.RenderTarget[0] =
+    // Create PBR pipeline state objects
+    graph.Add("Create PBR PSOs", After({ &PbrRootSignature, &pbrVs, &pbrPs, &pbrPsLightDebug, &pbrVsInstanced }), [&](JobContext&)
         {
-            .BlendEnable = true,
-            .LogicOpEnable = false,
-            .SrcBlend = D3D12_BLEND_SRC_ALPHA,
-            .DestBlend = D3D12_BLEND_INV_SRC_ALPHA,
-            .BlendOp = D3D12_BLEND_OP_ADD,
-            .SrcBlendAlpha = D3D12_BLEND_ONE,
-            .DestBlendAlpha = D3D12_BLEND_INV_SRC_ALPHA,
-            .BlendOpAlpha = D3D12_BLEND_OP_ADD,
-            .LogicOp = D3D12_LOGIC_OP_NOOP,
-            .RenderTargetWriteMask = D3D12_COLOR_WRITE_ENABLE_ALL,
-        };
-        PbrBlendOnDoubleSided = PipelineStateObject(Graphics, pbrDescription, L"PBR PSO - Blended Double Sided");
-        pbrDescription.RasterizerState.CullMode = D3D12_CULL_MODE_BACK;
-        PbrBlendOnSingleSided = PipelineStateObject(Graphics, pbrDescription, L"PBR PSO - Blended Single Sided");
-
-        // Create light boundary debug PSOs
-        pbrLightDebugDescription.PS = pbrPsLightDebug.ShaderBytecode();
-        PbrLightDebugSingleSided = PipelineStateObject(Graphics, pbrLightDebugDescription, L"PBR PSO - Light Debug Single Sided");
-        pbrLightDebugDescription.RasterizerState.CullMode = D3D12_CULL_MODE_NONE;
-        PbrLightDebugDoubleSided = PipelineStateObject(Graphics, pbrLightDebugDescription, L"PBR PSO - Light Debug Double Sided");
-    }
+            D3D12_GRAPHICS_PIPELINE_STATE_DESC pbrDescription = PipelineStateObject::BaseDescription;
+            pbrDescription.pRootSignature = PbrRootSignature.Get();
+            pbrDescription.VS = pbrVs.ShaderBytecode();
+            pbrDescription.PS = pbrPs.ShaderBytecode();
+
+            // Depth pre-pass
+            pbrDescription.DepthStencilState.DepthFunc = D3D12_COMPARISON_FUNC_EQUAL;
+            pbrDescription.DepthStencilState.DepthWriteMask = D3D12_DEPTH_WRITE_MASK_ZERO;
+
+            D3D12_INPUT_ELEMENT_DESC inputLayout[] =
+            {
+                // SemanticName, SemanticIndex, Format, InputSlot
+                { "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, MeshInputSlot::Position },
+                { "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, MeshInputSlot::Normal },
+                { "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, MeshInputSlot::Uv0 },
+            };
+            pbrDescription.InputLayout = { inputLayout, (UINT)std::size(inputLayout) };
+
+            D3D12_GRAPHICS_PIPELINE_STATE_DESC pbrLightDebugDescription = pbrDescription;
+            D3D12_GRAPHICS_PIPELINE_STATE_DESC pbrInstancedDescription = pbrDescription;
+
+            // Create opaque PSOs
+            PbrBlendOffSingleSided = PipelineStateObject(Graphics, pbrDescription, L"PBR PSO - Opaque Single Sided");
+            pbrDescription.RasterizerState.CullMode = D3D12_CULL_MODE_NONE;
+            PbrBlendOffDoubleSided = PipelineStateObject(Graphics, pbrDescription, L"PBR PSO - Opaque Double Sided");
+
+            // Create alpha-blended PSOs
+            // (Transparent primitives aren't part of the depth pre-pass, so they're depth tested normally rather than against their own depth.)
+            pbrDescription.DepthStencilState.DepthFunc = D3D12_COMPARISON_FUNC_GREATER;
+            pbrDescription.DepthStencilState.DepthWriteMask = D3D12_DEPTH_WRITE_MASK_ZERO;
+            pbrDescription.BlendState.RenderTarget[0] =
+            {
+                .BlendEnable = true,
+                .LogicOpEnable = false,
+                .SrcBlend = D3D12_BLEND_SRC_ALPHA,
+                .DestBlend = D3D12_BLEND_INV_SRC_ALPHA,
+                .BlendOp = D3D12_BLEND_OP_ADD,
+                .SrcBlendAlpha = D3D12_BLEND_ONE,
+                .DestBlendAlpha = D3D12_BLEND_INV_SRC_ALPHA,
+                .BlendOpAlpha = D3D12_BLEND_OP_ADD,
+                .LogicOp = D3D12_LOGIC_OP_NOOP,
+                .RenderTargetWriteMask = D3D12_COLOR_WRITE_ENABLE_ALL,
+            };
+            PbrBlendOnDoubleSided = PipelineStateObject(Graphics, pbrDescription, L"PBR PSO - Blended Double Sided");
+            pbrDescription.RasterizerState.CullMode = D3D12_CULL_MODE_BACK;
+            PbrBlendOnSingleSided = PipelineStateObject(Graphics, pbrDescription, L"PBR PSO - Blended Single Sided");
+
+            // Create light boundary debug PSOs
+            pbrLightDebugDescription.PS = pbrPsLightDebug.ShaderBytecode();
+            PbrLightDebugSingleSided = PipelineStateObject(Graphics, pbrLightDebugDescription, L"PBR PSO - Light Debug Single Sided");
+            pbrLightDebugDescription.RasterizerState.CullMode = D3D12_CULL_MODE_NONE;
+            PbrLightDebugDoubleSided = PipelineStateObject(Graphics, pbrLightDebugDescription, L"PBR PSO - Light Debug Double Sided");
+
+            // Create instanced PSOs
+            // (Transparent primitives are never instanced so there's no blended variants.)
+            pbrInstancedDescription.VS = pbrVsInstanced.ShaderBytecode();
+            PbrInstancedBlendOffSingleSided = PipelineStateObject(Graphics, pbrInstancedDescription, L"PBR PSO - Instanced Opaque Single Sided");
+            pbrInstancedDescription.RasterizerState.CullMode = D3D12_CULL_MODE_NONE;
+            PbrInstancedBlendOffDoubleSided = PipelineStateObject(Graphics, pbrInstancedDescription, L"PBR PSO - Instanced Opaque Double Sided");
+
+            pbrInstancedDescription.PS = pbrPsLightDebug.ShaderBytecode();
+            pbrInstancedDescription.RasterizerState.CullMode = D3D12_CULL_MODE_BACK;
+            PbrInstancedLightDebugSingleSided = PipelineStateObject(Graphics, pbrInstancedDescription, L"PBR PSO - Instanced Light Debug Single Sided");
+            pbrInstancedDescription.RasterizerState.CullMode = D3D12_CULL_MODE_NONE;
+            PbrInstancedLightDebugDoubleSided = PipelineStateObject(Graphics, pbrInstancedDescription, L"PBR PSO - Instanced Light Debug Double Sided");
+        });
 
     // Create DepthOnly pipeline state object
-    {
-        D3D12_GRAPHICS_PIPELINE_STATE_DESC depthOnlyDescription = PipelineStateObject::BaseDescription;
-        depthOnlyDescription.pRootSignature = DepthOnlyRootSignature.Get();
-        depthOnlyDescription.VS = depthOnlyVs.ShaderBytecode();
-        depthOnlyDescription.PS = depthOnlyPs.ShaderBytecode();
-        depthOnlyDescription.NumRenderTargets = 0;
-        depthOnlyDescription.RTVFormats[0] = DXGI_FORMAT_UNKNOWN;
-
-        D3D12_INPUT_ELEMENT_DESC inputLayout[] =
+    graph.Add("Create DepthOnly PSO", After({ &DepthOnlyRootSignature, &depthOnlyVs, &depthOnlyPs, &depthOnlyVsInstanced }), [&](JobContext&)
         {
-            // SemanticName, SemanticIndex, Format, InputSlot
-            { "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, MeshInputSlot::Position },
-            { "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, MeshInputSlot::Uv0 },
-        };
-        depthOnlyDescription.InputLayout = { inputLayout, (UINT)std::size(inputLayout) };
-
-        DepthOnlySingleSided = PipelineStateObject(Graphics, depthOnlyDescription, L"DepthOnly PSO - Single Sided");
-        depthOnlyDescription.RasterizerState.CullMode = D3D12_CULL_MODE_NONE;
-        DepthOnlyDoubleSided = PipelineStateObject(Graphics, depthOnlyDescription, L"DepthOnly PSO - Double Sided");
-    }
+            D3D12_GRAPHICS_PIPELINE_STATE_DESC depthOnlyDescription = PipelineStateObject::BaseDescription;
+            depthOnlyDescription.pRootSignature = DepthOnlyRootSignature.Get();
+            depthOnlyDescription.VS = depthOnlyVs.ShaderBytecode();
+            depthOnlyDescription.PS = depthOnlyPs.ShaderBytecode();
+            depthOnlyDescription.NumRenderTargets = 0;
+            depthOnlyDescription.RTVFormats[0] = DXGI_FORMAT_UNKNOWN;
+
+            D3D12_INPUT_ELEMENT_DESC inputLayout[] =
+            {
+                // SemanticName, SemanticIndex, Format, InputSlot
+                { "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, MeshInputSlot::Position },
+                { "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, MeshInputSlot::Uv0 },
+            };
+            depthOnlyDescription.InputLayout = { inputLayout, (UINT)std::size(inputLayout) };
+
+            DepthOnlySingleSided = PipelineStateObject(Graphics, depthOnlyDescription, L"DepthOnly PSO - Single Sided");
+            depthOnlyDescription.RasterizerState.CullMode = D3D12_CULL_MODE_NONE;
+            DepthOnlyDoubleSided = PipelineStateObject(Graphics, depthOnlyDescription, L"DepthOnly PSO - Double Sided");
+
+            depthOnlyDescription.VS = depthOnlyVsInstanced.ShaderBytecode();
+            depthOnlyDescription.RasterizerState.CullMode = D3D12_CULL_MODE_BACK;
+            DepthOnlyInstancedSingleSided = PipelineStateObject(Graphics, depthOnlyDescription, L"DepthOnly PSO - Instanced Single Sided");
+            depthOnlyDescription.RasterizerState.CullMode = D3D12_CULL_MODE_NONE;
+            DepthOnlyInstancedDoubleSided = PipelineStateObject(Graphics, depthOnlyDescription, L"DepthOnly PSO - Instanced Double Sided");
+        });
 
     // Create DepthDownsample pipeline state object
-    {
-        D3D12_GRAPHICS_PIPELINE_STATE_DESC depthDownsampleDescription = PipelineStateObject::BaseDescription;
-        depthDownsampleDescription.pRootSignature = DepthDownsampleRootSignature.Get();
-        depthDownsampleDescription.VS = fullScreenQuadVs.ShaderBytecode();
-        depthDownsampleDescription.PS = depthDownsamplePs.ShaderBytecode();
-        depthDownsampleDescription.NumRenderTargets = 0;
-        depthDownsampleDescription.RTVFormats[0] = DXGI_FORMAT_UNKNOWN;
-        depthDownsampleDescription.DepthStencilState.DepthFunc = D3D12_COMPARISON_FUNC_ALWAYS;
-
-        DepthDownsample = PipelineStateObject(Graphics, depthDownsampleDescription, L"DepthDownsample PSO");
-    }
+    graph.Add("Create DepthDownsample PSO", After({ &DepthDownsampleRootSignature, &fullScreenQuadVs, &depthDownsamplePs }), [&](JobContext&)
+        {
+            D3D12_GRAPHICS_PIPELINE_STATE_DESC depthDownsampleDescription = PipelineStateObject::BaseDescription;
+            depthDownsampleDescription.pRootSignature = DepthDownsampleRootSignature.Get();
+            depthDownsampleDescription.VS = fullScreenQuadVs.ShaderBytecode();
+            depthDownsampleDescription.PS = depthDownsamplePs.ShaderBytecode();
+            depthDownsampleDescription.NumRenderTargets = 0;
+            depthDownsampleDescription.RTVFormats[0] = DXGI_FORMAT_UNKNOWN;
+            depthDownsampleDescription.DepthStencilState.DepthFunc = D3D12_COMPARISON_FUNC_ALWAYS;
+
+            DepthDownsample = PipelineStateObject(Graphics, depthDownsampleDescription, L"DepthDownsample PSO");
+        });
 
     // Create GenerateMipMaps pipeline state object
-    {
-        D3D12_COMPUTE_PIPELINE_STATE_DESC generateMipMapsDescription =
+    graph.Add("Create GenerateMipMaps PSO", After({ &GenerateMipMapsRootSignature, &generateMipMapsCsUnorm, &generateMipMapsCsFloat }), [&](JobContext&)
         {
-            .pRootSignature = GenerateMipMapsRootSignature.Get(),
-            .CS = generateMipMapsCsUnorm.ShaderBytecode(),
-        };
-        GenerateMipMapsUnorm = PipelineStateObject(Graphics, generateMipMapsDescription, L"GenerateMipMaps PSO - UNorm");
-        generateMipMapsDescription.CS = generateMipMapsCsFloat.ShaderBytecode();
-        GenerateMipMapsFloat = PipelineStateObject(Graphics, generateMipMapsDescription, L"GenerateMipMaps PSO - Float");
-    }
+            D3D12_COMPUTE_PIPELINE_STATE_DESC generateMipMapsDescription =
+            {
+                .pRootSignature = GenerateMipMapsRootSignature.Get(),
+                .CS = generateMipMapsCsUnorm.ShaderBytecode(),
+            };
+            GenerateMipMapsUnorm = PipelineStateObject(Graphics, generateMipMapsDescription, L"GenerateMipMaps PSO - UNorm");
+            generateMipMapsDescription.CS = generateMipMapsCsFloat.ShaderBytecode();
+            GenerateMipMapsFloat = PipelineStateObject(Graphics, generateMipMapsDescription, L"GenerateMipMaps PSO - Float");
+        });
 
     // Create LightLinkedListFill pipeline state object
-    {
-        D3D12_GRAPHICS_PIPELINE_STATE_DESC description = PipelineStateObject::BaseDescription;
-        description.pRootSignature = LightLinkedListFillRootSignature.Get();
-        description.VS = lightLinkedListFillVs.ShaderBytecode();
-        description.PS = lightLinkedListFillPs.ShaderBytecode();
-        description.NumRenderTargets = 0;
-        description.RTVFormats[0] = DXGI_FORMAT_UNKNOWN;
-        description.RasterizerState.CullMode = D3D12_CULL_MODE_FRONT;
-        description.DepthStencilState.DepthEnable = false;
-        description.DepthStencilState.DepthWriteMask = D3D12_DEPTH_WRITE_MASK_ZERO;
-
-        D3D12_INPUT_ELEMENT_DESC inputLayout[] =
+    graph.Add("Create LightLinkedListFill PSO", After({ &LightLinkedListFillRootSignature, &lightLinkedListFillVs, &lightLinkedListFillPs }), [&](JobContext&)
         {
-            // SemanticName, SemanticIndex, Format, InputSlot
-            { "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, MeshInputSlot::Position },
-        };
-        description.InputLayout = { inputLayout, (UINT)std::size(inputLayout) };
-
-        LightLinkedListFill = PipelineStateObject(Graphics, description, L"LightLinkedList Fill PSO");
-    }
+            D3D12_GRAPHICS_PIPELINE_STATE_DESC description = PipelineStateObject::BaseDescription;
+            description.pRootSignature = LightLinkedListFillRootSignature.Get();
+            description.VS = lightLinkedListFillVs.ShaderBytecode();
+            description.PS = lightLinkedListFillPs.ShaderBytecode();
+            description.NumRenderTargets = 0;
+            description.RTVFormats[0] = DXGI_FORMAT_UNKNOWN;
+            description.RasterizerState.CullMode = D3D12_CULL_MODE_FRONT;
+            description.DepthStencilState.DepthEnable = false;
+            description.DepthStencilState.DepthWriteMask = D3D12_DEPTH_WRITE_MASK_ZERO;
+
+            D3D12_INPUT_ELEMENT_DESC inputLayout[] =
+            {
+                // SemanticName, SemanticIndex, Format, InputSlot
+                { "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, MeshInputSlot::Position },
+            };
+            description.InputLayout = { inputLayout, (UINT)std::size(inputLayout) };
+
+            LightLinkedListFill = PipelineStateObject(Graphics, description, L"LightLinkedList Fill PSO");
+        });
 
     // Create LightLinkedListDebug pipeline state object
-    {
-        D3D12_GRAPHICS_PIPELINE_STATE_DESC description = PipelineStateObject::BaseDescription;
-        description.pRootSignature = LightLinkedListDebugRootSignature.Get();
-        description.VS = fullScreenQuadVs.ShaderBytecode();
-        description.PS = lightLinkedListDebugPs.ShaderBytecode();
-        description.DepthStencilState.DepthEnable = false;
-        description.DepthStencilState.DepthWriteMask = D3D12_DEPTH_WRITE_MASK_ZERO;
-        description.BlendState.RenderTarget[0] =
+    graph.Add("Create LightLinkedListDebug PSO", After({ &LightLinkedListDebugRootSignature, &fullScreenQuadVs, &lightLinkedListDebugPs }), [&](JobContext&)
         {
-            .BlendEnable = true,
-            .LogicOpEnable = false,
-            .SrcBlend = D3D12_BLEND_SRC_ALPHA,
-            .DestBlend = D3D12_BLEND_INV_SRC_ALPHA,
-            .BlendOp = D3D12_BLEND_OP_ADD,
-            .SrcBlendAlpha = D3D12_BLEND_ONE,
-            .DestBlendAlpha = D3D12_BLEND_INV_SRC_ALPHA,
-            .BlendOpAlpha = D3D12_BLEND_OP_ADD,
-            .LogicOp = D3D12_LOGIC_OP_NOOP,
-            .RenderTargetWriteMask = D3D12_COLOR_WRITE_ENABLE_ALL,
-        };
-
-        LightLinkedListDebug = PipelineStateObject(Graphics, description, L"LightLinkedList Debug PSO");
-    }
+            D3D12_GRAPHICS_PIPELINE_STATE_DESC description = PipelineStateObject::BaseDescription;
+            description.pRootSignature = LightLinkedListDebugRootSignature.Get();
+            description.VS = fullScreenQuadVs.ShaderBytecode();
+            description.PS = lightLinkedListDebugPs.ShaderBytecode();
+            description.DepthStencilState.DepthEnable = false;
+            description.DepthStencilState.DepthWriteMask = D3D12_DEPTH_WRITE_MASK_ZERO;
+            description.BlendState.RenderTarget[0] =
+            {
+                .BlendEnable = true,
+                .LogicOpEnable = false,
+                .SrcBlend = D3D12_BLEND_SRC_ALPHA,
+                .DestBlend = D3D12_BLEND_INV_SRC_ALPHA,
+                .BlendOp = D3D12_BLEND_OP_ADD,
+                .SrcBlendAlpha = D3D12_BLEND_ONE,
+                .DestBlendAlpha = D3D12_BLEND_INV_SRC_ALPHA,
+                .BlendOpAlpha = D3D12_BLEND_OP_ADD,
+                .LogicOp = D3D12_LOGIC_OP_NOOP,
+                .RenderTargetWriteMask = D3D12_COLOR_WRITE_ENABLE_ALL,
+            };
+
+            LightLinkedListDebug = PipelineStateObject(Graphics, description, L"LightLinkedList Debug PSO");
+        });
 
     // Create LightLinkedListStats pipeline state object
-    {
-        D3D12_COMPUTE_PIPELINE_STATE_DESC generateMipMapsDescription =
+    graph.Add("Create LightLinkedListStats PSO", After({ &LightLinkedListStatsRootSignature, &lightLinkedListStatsCs }), [&](JobContext&)
         {
-            .pRootSignature = LightLinkedListStatsRootSignature.Get(),
-            .CS = lightLinkedListStatsCs.ShaderBytecode(),
-        };
-        LightLinkedListStats = PipelineStateObject(Graphics, generateMipMapsDescription, L"LightLinkedList Statistics PSO");
-    }
+            D3D12_COMPUTE_PIPELINE_STATE_DESC generateMipMapsDescription =
+            {
+                .pRootSignature = LightLinkedListStatsRootSignature.Get(),
+                .CS = lightLinkedListStatsCs.ShaderBytecode(),
+            };
+            LightLinkedListStats = PipelineStateObject(Graphics, generateMipMapsDescription, L"LightLinkedList Statistics PSO");
+        });
 
     // Create LightSprites pipeline state object
-    {
-        D3D12_GRAPHICS_PIPELINE_STATE_DESC description = PipelineStateObject::BaseDescription;
-        description.pRootSignature = LightSpritesRootSignature.Get();
-        description.VS = lightSpritesVs.ShaderBytecode();
-        description.PS = lightSpritesPs.ShaderBytecode();
-        LightSprites = PipelineStateObject(Graphics, description, L"Light Sprites PSO");
-    }
+    graph.Add("Create LightSprites PSO", After({ &LightSpritesRootSignature, &lightSpritesVs, &lightSpritesPs }), [&](JobContext&)
+        {
+            D3D12_GRAPHICS_PIPELINE_STATE_DESC description = PipelineStateObject::BaseDescription;
+            description.pRootSignature = LightSpritesRootSignature.Get();
+            description.VS = lightSpritesVs.ShaderBytecode();
+            description.PS = lightSpritesPs.ShaderBytecode();
+            LightSprites = PipelineStateObject(Graphics, description, L"Light Sprites PSO");
+        });
 
     // Create ParticleSystem pipeline state objects
-    {
-        D3D12_COMPUTE_PIPELINE_STATE_DESC description =
+    graph.Add("Create ParticleSystem PSOs", After({ &ParticleSystemRootSignature, &particleSystemSpawn, &particleSystemUpdate, &particleSystemUpdateTemporalSort, &particleSystemPrepareDrawIndirect, &particleSystemPrepareUpdateIndirect, &particleSystemPrepareSpawnIndirect }), [&](JobContext&)
         {
-            .pRootSignature = ParticleSystemRootSignature.Get(),
-            .CS = particleSystemSpawn.ShaderBytecode(),
-        };
-        ParticleSystemSpawn = PipelineStateObject(Graphics, description, L"Particle System Spawn PSO");
+            D3D12_COMPUTE_PIPELINE_STATE_DESC description =
+            {
+                .pRootSignature = ParticleSystemRootSignature.Get(),
+                .CS = particleSystemSpawn.ShaderBytecode(),
+            };
+            ParticleSystemSpawn = PipelineStateObject(Graphics, description, L"Particle System Spawn PSO");
 
-        description.CS = particleSystemUpdate.ShaderBytecode();
-        ParticleSystemUpdate = PipelineStateObject(Graphics, description, L"Particle System Update PSO");
+            description.CS = particleSystemUpdate.ShaderBytecode();
+            ParticleSystemUpdate = PipelineStateObject(Graphics, description, L"Particle System Update PSO");
 
-        description.CS = particleSystemPrepareDrawIndirect.ShaderBytecode();
-        ParticleSystemPrepareDrawIndirect = PipelineStateObject(Graphics, description, L"Particle System Prepare DrawIndirect PSO");
-    }
+            description.CS = particleSystemUpdateTemporalSort.ShaderBytecode();
+            ParticleSystemUpdateTemporalSort = PipelineStateObject(Graphics, description, L"Particle System Update PSO - Temporal Sort");
+
+            description.CS = particleSystemPrepareDrawIndirect.ShaderBytecode();
+            ParticleSystemPrepareDrawIndirect = PipelineStateObject(Graphics, description, L"Particle System Prepare DrawIndirect PSO");
+
+            description.CS = particleSystemPrepareUpdateIndirect.ShaderBytecode();
+            ParticleSystemPrepareUpdateIndirect = PipelineStateObject(Graphics, description, L"Particle System Prepare Update DispatchIndirect PSO");
+
+            description.CS = particleSystemPrepareSpawnIndirect.ShaderBytecode();
+            ParticleSystemPrepareSpawnIndirect = PipelineStateObject(Graphics, description, L"Particle System Prepare Spawn DispatchIndirect PSO");
+        });
+
+    // Create ParticleSortFixUp pipeline state objects
+    graph.Add("Create ParticleSortFixUp PSOs", After({ &ParticleSortFixUpRootSignature, &particleSortMeasureDisorder, &particleSortPrepareFixUp, &particleSortFixUp, &particleSortMergeSpawned, &particleSortPrepareFallback }), [&](JobContext&)
+        {
+            D3D12_COMPUTE_PIPELINE_STATE_DESC description =
+            {
+                .pRootSignature = ParticleSortFixUpRootSignature.Get(),
+                .CS = particleSortMeasureDisorder.ShaderBytecode(),
+            };
+            ParticleSortMeasureDisorder = PipelineStateObject(Graphics, description, L"Particle Sort Measure Disorder PSO");
+
+            description.CS = particleSortPrepareFixUp.ShaderBytecode();
+            ParticleSortPrepareFixUp = PipelineStateObject(Graphics, description, L"Particle Sort Prepare Fix-up PSO");
+
+            description.CS = particleSortFixUp.ShaderBytecode();
+            ParticleSortFixUp = PipelineStateObject(Graphics, description, L"Particle Sort Fix-up PSO");
+
+            description.CS = particleSortMergeSpawned.ShaderBytecode();
+            ParticleSortMergeSpawned = PipelineStateObject(Graphics, description, L"Particle Sort Merge Spawned PSO");
+
+            description.CS = particleSortPrepareFallback.ShaderBytecode();
+            ParticleSortPrepareFallback = PipelineStateObject(Graphics, description, L"Particle Sort Prepare Fallback PSO");
+        });
 
     // Create ParticleRender pipeline state object
+    graph.Add("Create ParticleRender PSO", After({ &ParticleRenderRootSignature, &particleRenderVs, &particleRenderPs, &particleRenderPsLightDebug, &particleRenderVsCachedLighting, &particleRenderPsCachedLighting }), [&](JobContext&)
+        {
+            D3D12_GRAPHICS_PIPELINE_STATE_DESC description = PipelineStateObject::BaseDescription;
+            description.pRootSignature = ParticleRenderRootSignature.Get();
+            description.VS = particleRenderVs.ShaderBytecode();
+            description.PS = particleRenderPs.ShaderBytecode();
+            description.RasterizerState.CullMode = D3D12_CULL_MODE_NONE;
+            description.DepthStencilState.DepthWriteMask = D3D12_DEPTH_WRITE_MASK_ZERO;
+            description.BlendState.RenderTarget[0] =
+            {
+                .BlendEnable = true,
+                .LogicOpEnable = false,
+                .SrcBlend = D3D12_BLEND_SRC_ALPHA, // It's tempting to use pre-multiplied alpha, but the textures only *sort-of* look like they're pre-multiplied.
+                .DestBlend = D3D12_BLEND_INV_SRC_ALPHA,
+                .BlendOp = D3D12_BLEND_OP_ADD,
+                .SrcBlendAlpha = D3D12_BLEND_ONE,
+                .DestBlendAlpha = D3D12_BLEND_INV_SRC_ALPHA,
+                .BlendOpAlpha = D3D12_BLEND_OP_ADD,
+                .LogicOp = D3D12_LOGIC_OP_NOOP,
+                .RenderTargetWriteMask = D3D12_COLOR_WRITE_ENABLE_ALL,
+            };
+
+            ParticleRender = PipelineStateObject(Graphics, description, L"Particle Render PSO");
+
+            description.PS = particleRenderPsLightDebug.ShaderBytecode();
+            ParticleRenderLightDebug = PipelineStateObject(Graphics, description, L"Particle Render PSO - Light Debug");
+
+            description.VS = particleRenderVsCachedLighting.ShaderBytecode();
+            description.PS = particleRenderPsCachedLighting.ShaderBytecode();
+            ParticleRenderCachedLighting = PipelineStateObject(Graphics, description, L"Particle Render PSO - Cached Lighting");
+        });
+
+    // Create ParticleLighting pipeline state object
+    graph.Add("Create ParticleLighting PSO", After({ &ParticleLightingRootSignature, &particleLighting }), [&](JobContext&)
+        {
+            D3D12_COMPUTE_PIPELINE_STATE_DESC description =
+            {
+                .pRootSignature = ParticleLightingRootSignature.Get(),
+                .CS = particleLighting.ShaderBytecode(),
+            };
+            ParticleLighting = PipelineStateObject(Graphics, description, L"Particle Lighting PSO");
+        });
+
+    // Create SceneCulling pipeline state objects
+    graph.Add("Create SceneCulling PSOs", After({ &SceneCullingRootSignature, &sceneCullingClearCounts, &sceneCulling }), [&](JobContext&)
+        {
+            D3D12_COMPUTE_PIPELINE_STATE_DESC description =
+            {
+                .pRootSignature = SceneCullingRootSignature.Get(),
+                .CS = sceneCullingClearCounts.ShaderBytecode(),
+            };
+            SceneCullingClearCounts = PipelineStateObject(Graphics, description, L"Scene Culling Clear Counts PSO");
+
+            description.CS = sceneCulling.ShaderBytecode();
+            SceneCulling = PipelineStateObject(Graphics, description, L"Scene Culling PSO");
+        });
+
+    JobGraphResult result = graph.Run(jobs);
+
+    // Diagnostics are reported in the order the shaders were listed above rather than the order they happened to compile in
+    for (const ShaderJob& shaderJob : shaderJobs)
+    {
+        if (!shaderJob.Diagnostics.empty())
+        { fprintf(stderr, "%s", shaderJob.Diagnostics.c_str()); }
+    }
+
+    for (const JobError& error : result.Errors)
+    { fprintf(stderr, "'%s' failed:\n%s\n", graph.Name(error.Job).c_str(), error.Message.c_str()); }
+
+    if (!result.Succeeded())
+    { Fail("Failed to create shaders or pipeline states."); }
+
+    double jobSeconds = 0.0;
+    uint32_t cacheHitCount = 0;
+    uint32_t cacheMissCount = 0;
+    for (double seconds : result.Seconds)
+    { jobSeconds += seconds; }
+
+    for (const std::unique_ptr<HlslCompiler>& compiler : compilers)
     {
-        D3D12_GRAPHICS_PIPELINE_STATE_DESC description = PipelineStateObject::BaseDescription;
-        description.pRootSignature = ParticleRenderRootSignature.Get();
-        description.VS = particleRenderVs.ShaderBytecode();
-        description.PS = particleRenderPs.ShaderBytecode();
-        description.RasterizerState.CullMode = D3D12_CULL_MODE_NONE;
-        description.DepthStencilState.DepthWriteMask = D3D12_DEPTH_WRITE_MASK_ZERO;
-        description.BlendState.RenderTarget[0] =
+        if (compiler != nullptr)
         {
-            .BlendEnable = true,
-            .LogicOpEnable = false,
-            .SrcBlend = D3D12_BLEND_SRC_ALPHA, // It's tempting to use pre-multiplied alpha, but the textures only *sort-of* look like they're pre-multiplied.
-            .DestBlend = D3D12_BLEND_INV_SRC_ALPHA,
-            .BlendOp = D3D12_BLEND_OP_ADD,
-            .SrcBlendAlpha = D3D12_BLEND_ONE,
-            .DestBlendAlpha = D3D12_BLEND_INV_SRC_ALPHA,
-            .BlendOpAlpha = D3D12_BLEND_OP_ADD,
-            .LogicOp = D3D12_LOGIC_OP_NOOP,
-            .RenderTargetWriteMask = D3D12_COLOR_WRITE_ENABLE_ALL,
-        };
+            cacheHitCount += compiler->Cache().HitCount();
+            cacheMissCount += compiler->Cache().MissCount();
+        }
+    }
 
-        ParticleRender = PipelineStateObject(Graphics, description, L"Particle Render PSO");
+    printf("Created shaders and pipeline states in %.1f ms (%.1f ms of work on %u threads, %u shader cache hits, %u compiled):\n", result.TotalSeconds * 1000.0, jobSeconds * 1000.0, jobs.WorkerCount() + 1, cacheHitCount, cacheMissCount);
+    for (JobId job = 0; job < graph.JobCount(); job++)
+    { printf("    %8.2f ms  %s\n", result.Seconds[job] * 1000.0, graph.Name(job).c_str()); }
 
-        description.PS = particleRenderPsLightDebug.ShaderBytecode();
-        ParticleRenderLightDebug = PipelineStateObject(Graphics, description, L"Particle Render PSO - Light Debug");
+    // Create PBR indirect draw command signature
+    // Arguments must match the layout of ShaderInterop::IndirectDrawRecord
+    {
+        D3D12_INDIRECT_ARGUMENT_DESC arguments[] =
+        {
+            { .Type = D3D12_INDIRECT_ARGUMENT_TYPE_VERTEX_BUFFER_VIEW },
+            { .Type = D3D12_INDIRECT_ARGUMENT_TYPE_VERTEX_BUFFER_VIEW },
+            { .Type = D3D12_INDIRECT_ARGUMENT_TYPE_VERTEX_BUFFER_VIEW },
+            { .Type = D3D12_INDIRECT_ARGUMENT_TYPE_INDEX_BUFFER_VIEW },
+            { .Type = D3D12_INDIRECT_ARGUMENT_TYPE_CONSTANT },
+            { .Type = D3D12_INDIRECT_ARGUMENT_TYPE_DRAW_INDEXED },
+        };
+        arguments[0].VertexBuffer.Slot = MeshInputSlot::Position;
+        arguments[1].VertexBuffer.Slot = MeshInputSlot::Normal;
+        arguments[2].VertexBuffer.Slot = MeshInputSlot::Uv0;
+        arguments[4].Constant.RootParameterIndex = ShaderInterop::Pbr::RpPerNodeCb;
+        arguments[4].Constant.DestOffsetIn32BitValues = 0;
+        arguments[4].Constant.Num32BitValuesToSet = sizeof(ShaderInterop::PerNodeCb) / sizeof(uint32_t);
+
+        D3D12_COMMAND_SIGNATURE_DESC description =
+        {
+            .ByteStride = sizeof(ShaderInterop::IndirectDrawRecord),
+            .NumArgumentDescs = (UINT)std::size(arguments),
+            .pArgumentDescs = arguments,
+        };
+
+        AssertSuccess(Graphics.Device()->CreateCommandSignature(&description, PbrRootSignature.Get(), IID_PPV_ARGS(&PbrIndirectDrawCommandSignature)));
+        PbrIndirectDrawCommandSignature->SetName(L"PBR Indirect Draw Command Signature");
     }
 }
+
+ID3D12PipelineState* ResourceManager::InstancedPipelineState(ID3D12PipelineState* pipelineState) const
+{
+    if (pipelineState == PbrBlendOffSingleSided) { return PbrInstancedBlendOffSingleSided; }
+    if (pipelineState == PbrBlendOffDoubleSided) { return PbrInstancedBlendOffDoubleSided; }
+    if (pipelineState == PbrLightDebugSingleSided) { return PbrInstancedLightDebugSingleSided; }
+    if (pipelineState == PbrLightDebugDoubleSided) { return PbrInstancedLightDebugDoubleSided; }
+    if (pipelineState == DepthOnlySingleSided) { return DepthOnlyInstancedSingleSided; }
+    if (pipelineState == DepthOnlyDoubleSided) { return DepthOnlyInstancedDoubleSided; }
+
+    Fail("The specified pipeline state has no instanced variant.");
+    return nullptr;
+}
@@ -1,11 +1,13 @@
 #pragma once
 #include "BitonicSort.h"
+#include "GpuTextureStreamer.h"
 #include "MeshHeap.h"
 #include "PbrMaterialHeap.h"
 #include "PipelineStateObject.h"
 #include "RootSignature.h"
 
 class GraphicsCore;
+class JobSystem;
 
 namespace MeshInputSlot
 {
@@ -22,6 +24,7 @@ struct ResourceManager
     GraphicsCore& Graphics;
     PbrMaterialHeap PbrMaterials;
     MeshHeap MeshHeap;
+    GpuTextureStreamer StreamedTextures;
     BitonicSort BitonicSort;
 
     // No complicated PSO management here, we don't need very many so we just make them all by hand
@@ -34,9 +37,16 @@ struct ResourceManager
     PipelineStateObject PbrLightDebugSingleSided;
     PipelineStateObject PbrLightDebugDoubleSided;
 
+    PipelineStateObject PbrInstancedBlendOffSingleSided;
+    PipelineStateObject PbrInstancedBlendOffDoubleSided;
+    PipelineStateObject PbrInstancedLightDebugSingleSided;
+    PipelineStateObject PbrInstancedLightDebugDoubleSided;
+
     RootSignature DepthOnlyRootSignature;
     PipelineStateObject DepthOnlySingleSided;
     PipelineStateObject DepthOnlyDoubleSided;
+    PipelineStateObject DepthOnlyInstancedSingleSided;
+    PipelineStateObject DepthOnlyInstancedDoubleSided;
 
     RootSignature DepthDownsampleRootSignature;
     PipelineStateObject DepthDownsample;
@@ -60,15 +70,40 @@ struct ResourceManager
     RootSignature ParticleSystemRootSignature;
     PipelineStateObject ParticleSystemSpawn;
     PipelineStateObject ParticleSystemUpdate;
+    PipelineStateObject ParticleSystemUpdateTemporalSort;
     PipelineStateObject ParticleSystemPrepareDrawIndirect;
+    PipelineStateObject ParticleSystemPrepareUpdateIndirect;
+    PipelineStateObject ParticleSystemPrepareSpawnIndirect;
+
+    RootSignature ParticleSortFixUpRootSignature;
+    PipelineStateObject ParticleSortMeasureDisorder;
+    PipelineStateObject ParticleSortPrepareFixUp;
+    PipelineStateObject ParticleSortFixUp;
+    PipelineStateObject ParticleSortMergeSpawned;
+    PipelineStateObject ParticleSortPrepareFallback;
 
     RootSignature ParticleRenderRootSignature;
     PipelineStateObject ParticleRender;
     PipelineStateObject ParticleRenderLightDebug;
+    PipelineStateObject ParticleRenderCachedLighting;
+
+    RootSignature ParticleLightingRootSignature;
+    PipelineStateObject ParticleLighting;
 
-    explicit ResourceManager(GraphicsCore& graphics);
+    RootSignature SceneCullingRootSignature;
+    PipelineStateObject SceneCullingClearCounts;
+    PipelineStateObject SceneCulling;
+
+    //! Draws a ShaderInterop::IndirectDrawRecord, must be used with PbrRootSignature
+    ComPtr<ID3D12CommandSignature> PbrIndirectDrawCommandSignature;
+
+    //! Shaders are compiled and pipeline states are created across the job system's threads
+    ResourceManager(GraphicsCore& graphics, JobSystem& jobs);
     ResourceManager(const ResourceManager&) = delete;
 
+    //! Returns the variant of an opaque PBR or DepthOnly pipeline state which sources node transforms from the instance buffer, see InstancedDrawList
+    ID3D12PipelineState* InstancedPipelineState(ID3D12PipelineState* pipelineState) const;
+
     //! Marks this resource manager as finished, flushing its managed resources to the GPU
     //! Does not wait for GPU work to complete, caller is expected to flush the upload queue themselves
     inline void Finish()
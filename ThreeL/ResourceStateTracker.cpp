@@ -0,0 +1,389 @@
+#include "pch.h"
+#include "ResourceStateTracker.h"
+
+namespace
+{
+    const D3D12_RESOURCE_STATES READ_ONLY_STATES = D3D12_RESOURCE_STATE_GENERIC_READ | D3D12_RESOURCE_STATE_DEPTH_READ | D3D12_RESOURCE_STATE_RESOLVE_SOURCE | D3D12_RESOURCE_STATE_SHADING_RATE_SOURCE;
+
+    // Textures which don't allow simultaneous access can only be promoted to these
+    const D3D12_RESOURCE_STATES TEXTURE_PROMOTABLE_STATES = D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE | D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE | D3D12_RESOURCE_STATE_COPY_SOURCE | D3D12_RESOURCE_STATE_COPY_DEST;
+
+    inline bool IsReadOnly(D3D12_RESOURCE_STATES state)
+    {
+        return state != D3D12_RESOURCE_STATE_COMMON && (state & ~READ_ONLY_STATES) == 0;
+    }
+}
+
+void ResourceState::Initialize(uint32_t subresourceCount, bool isStateless)
+{
+    Assert(subresourceCount > 0);
+    Subresource subresource =
+    {
+        .State = m_InitialState,
+        .SplitStateBefore = D3D12_RESOURCE_STATE_COMMON,
+        .SplitSubresource = 0,
+        .IsPromoted = false,
+        .IsSplit = false,
+        .IsPromotionPending = false,
+        .StateBeforePromotion = D3D12_RESOURCE_STATE_COMMON,
+        .WasPromoted = false,
+    };
+    m_Subresources.assign(subresourceCount, subresource);
+    m_IsStateless = isStateless;
+}
+
+D3D12_RESOURCE_STATES ResourceState::State(uint32_t subresource) const
+{
+    if (!IsInitialized())
+    { return m_InitialState; }
+
+    Assert(subresource < m_Subresources.size());
+    return m_Subresources[subresource].State;
+}
+
+bool ResourceState::IsUniform() const
+{
+    for (const Subresource& subresource : m_Subresources)
+    {
+        if (!(subresource == m_Subresources[0]))
+        { return false; }
+    }
+
+    return true;
+}
+
+ResourceStateTracker::ResourceStateTracker(D3D12_COMMAND_LIST_TYPE queueType)
+    : m_QueueType(queueType)
+{
+}
+
+void ResourceStateTracker::Transition(ResourceState& state, ID3D12Resource* resource, D3D12_RESOURCE_STATES desiredState, uint32_t subresource)
+{
+    Assert(state.IsInitialized() && "Resource state must be initialized before it is tracked.");
+    Track(state);
+
+    if (subresource != D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES)
+    {
+        Assert(subresource < state.SubresourceCount());
+        TransitionSubresource(state.m_Subresources[subresource], resource, subresource, desiredState, false, state);
+    }
+    // Subresources in the same state are transitioned together with a single barrier
+    else if (state.IsUniform())
+    {
+        ResourceState::Subresource uniform = state.m_Subresources[0];
+        TransitionSubresource(uniform, resource, D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES, desiredState, false, state);
+        std::fill(state.m_Subresources.begin(), state.m_Subresources.end(), uniform);
+    }
+    else
+    {
+        for (uint32_t i = 0; i < state.SubresourceCount(); i++)
+        { TransitionSubresource(state.m_Subresources[i], resource, i, desiredState, false, state); }
+    }
+}
+
+void ResourceStateTracker::BeginTransition(ResourceState& state, ID3D12Resource* resource, D3D12_RESOURCE_STATES desiredState, uint32_t subresource)
+{
+    Assert(state.IsInitialized() && "Resource state must be initialized before it is tracked.");
+    Track(state);
+
+    if (subresource != D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES)
+    {
+        Assert(subresource < state.SubresourceCount());
+        TransitionSubresource(state.m_Subresources[subresource], resource, subresource, desiredState, true, state);
+    }
+    else if (state.IsUniform())
+    {
+        ResourceState::Subresource uniform = state.m_Subresources[0];
+        TransitionSubresource(uniform, resource, D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES, desiredState, true, state);
+        std::fill(state.m_Subresources.begin(), state.m_Subresources.end(), uniform);
+    }
+    else
+    {
+        for (uint32_t i = 0; i < state.SubresourceCount(); i++)
+        { TransitionSubresource(state.m_Subresources[i], resource, i, desiredState, true, state); }
+    }
+}
+
+void ResourceStateTracker::AddBarrier(const D3D12_RESOURCE_BARRIER& barrier, bool wasPromoted)
+{
+    m_PendingBarriers.push_back(barrier);
+    m_PendingBarrierWasPromoted.push_back(wasPromoted);
+}
+
+void ResourceStateTracker::UavBarrier(ID3D12Resource* resource)
+{
+    D3D12_RESOURCE_BARRIER barrier =
+    {
+        .Type = D3D12_RESOURCE_BARRIER_TYPE_UAV,
+        .Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE,
+        .UAV = { .pResource = resource },
+    };
+    AddBarrier(barrier);
+}
+
+void ResourceStateTracker::AliasingBarrier(ID3D12Resource* resourceBefore, ID3D12Resource* resourceAfter)
+{
+    D3D12_RESOURCE_BARRIER barrier =
+    {
+        .Type = D3D12_RESOURCE_BARRIER_TYPE_ALIASING,
+        .Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE,
+        .Aliasing =
+        {
+            .pResourceBefore = resourceBefore,
+            .pResourceAfter = resourceAfter,
+        },
+    };
+    AddBarrier(barrier);
+}
+
+void ResourceStateTracker::WorkRecorded()
+{
+    Assert(m_PendingBarriers.empty() && "Pending barriers must be recorded before any work.");
+
+    for (ResourceState* state : m_PendingPromotions)
+    {
+        for (ResourceState::Subresource& subresource : state->m_Subresources)
+        {
+            subresource.IsPromotionPending = false;
+            subresource.StateBeforePromotion = D3D12_RESOURCE_STATE_COMMON;
+            subresource.WasPromoted = false;
+        }
+
+        state->m_HasPendingPromotions = false;
+    }
+
+    m_PendingPromotions.clear();
+}
+
+void ResourceStateTracker::CommandListEnded()
+{
+    Assert(m_PendingBarriers.empty() && "Pending barriers must be recorded before the command list ends.");
+
+    for (ResourceState* state : m_TrackedResources)
+    {
+        for (ResourceState::Subresource& subresource : state->m_Subresources)
+        {
+            Assert(!subresource.IsSplit && "Split barriers must end in the same command list they began in.");
+            RollBackPromotion(subresource);
+
+            if (m_QueueType == D3D12_COMMAND_LIST_TYPE_COPY || state->m_IsStateless || (subresource.IsPromoted && IsReadOnly(subresource.State)))
+            { subresource.State = D3D12_RESOURCE_STATE_COMMON; }
+
+            subresource.IsPromoted = false;
+        }
+
+        state->m_IsTracked = false;
+        state->m_HasPendingPromotions = false;
+    }
+
+    m_TrackedResources.clear();
+    m_PendingPromotions.clear();
+}
+
+void ResourceStateTracker::Track(ResourceState& state)
+{
+    if (state.m_IsTracked)
+    { return; }
+
+    state.m_IsTracked = true;
+    m_TrackedResources.push_back(&state);
+}
+
+void ResourceStateTracker::RollBackPromotion(ResourceState::Subresource& subresource)
+{
+    if (!subresource.IsPromotionPending)
+    { return; }
+
+    subresource.State = subresource.StateBeforePromotion;
+    subresource.IsPromoted = subresource.WasPromoted;
+    subresource.IsPromotionPending = false;
+    subresource.StateBeforePromotion = D3D12_RESOURCE_STATE_COMMON;
+    subresource.WasPromoted = false;
+}
+
+bool ResourceStateTracker::CanPromote(const ResourceState::Subresource& subresource, D3D12_RESOURCE_STATES desiredState, bool isStateless) const
+{
+    if (desiredState == D3D12_RESOURCE_STATE_COMMON)
+    { return false; }
+
+    if (!isStateless && (desiredState & ~TEXTURE_PROMOTABLE_STATES) != 0)
+    { return false; }
+
+    // Resources in the common state can be promoted to a single write state or any combination of read states
+    if (subresource.State == D3D12_RESOURCE_STATE_COMMON)
+    { return isStateless || IsReadOnly(desiredState) || desiredState == D3D12_RESOURCE_STATE_COPY_DEST; }
+
+    // Promoted read states can accumulate more read states, but anything which was promoted to a write state needs an explicit barrier from then on
+    return subresource.IsPromoted && IsReadOnly(subresource.State) && IsReadOnly(desiredState);
+}
+
+void ResourceStateTracker::TransitionSubresource(ResourceState::Subresource& subresource, ID3D12Resource* resource, uint32_t subresourceIndex, D3D12_RESOURCE_STATES desiredState, bool isSplit, ResourceState& state)
+{
+    // Using a subresource with a split barrier in progress ends the split barrier
+    if (subresource.IsSplit)
+    {
+        Assert(desiredState == subresource.State && "Subresource was used in a different state before its split barrier ended.");
+        Assert(subresourceIndex == subresource.SplitSubresource && "Split barriers must end with the same subresource they began with.");
+        Assert(!isSplit && "Split barrier was begun twice.");
+
+        D3D12_RESOURCE_BARRIER barrier =
+        {
+            .Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION,
+            .Flags = D3D12_RESOURCE_BARRIER_FLAG_END_ONLY,
+            .Transition =
+            {
+                .pResource = resource,
+                .Subresource = subresourceIndex,
+                .StateBefore = subresource.SplitStateBefore,
+                .StateAfter = subresource.State,
+            },
+        };
+        AddBarrier(barrier);
+        subresource.SplitStateBefore = D3D12_RESOURCE_STATE_COMMON;
+        subresource.SplitSubresource = 0;
+        subresource.IsSplit = false;
+        return;
+    }
+
+    // Promotions which nothing has used yet never happened as far as the GPU is concerned
+    RollBackPromotion(subresource);
+
+    // Ignore no-op transitions, including ones to read states the subresource is already readable in
+    if (subresource.State == desiredState)
+    { return; }
+
+    if (IsReadOnly(subresource.State) && IsReadOnly(desiredState) && (desiredState & ~subresource.State) == 0)
+    { return; }
+
+    if (CanPromote(subresource, desiredState, state.m_IsStateless))
+    {
+        // There's nothing to begin, the transition which ends the split will promote instead
+        if (isSplit)
+        { return; }
+
+        if (!state.m_HasPendingPromotions)
+        {
+            state.m_HasPendingPromotions = true;
+            m_PendingPromotions.push_back(&state);
+        }
+
+        subresource.IsPromotionPending = true;
+        subresource.StateBeforePromotion = subresource.State;
+        subresource.WasPromoted = subresource.IsPromoted;
+        subresource.State |= desiredState;
+        subresource.IsPromoted = true;
+        return;
+    }
+
+    if (isSplit)
+    {
+        D3D12_RESOURCE_BARRIER barrier =
+        {
+            .Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION,
+            .Flags = D3D12_RESOURCE_BARRIER_FLAG_BEGIN_ONLY,
+            .Transition =
+            {
+                .pResource = resource,
+                .Subresource = subresourceIndex,
+                .StateBefore = subresource.State,
+                .StateAfter = desiredState,
+            },
+        };
+        AddBarrier(barrier);
+        subresource.SplitStateBefore = subresource.State;
+        subresource.SplitSubresource = subresourceIndex;
+        subresource.IsSplit = true;
+        subresource.IsPromoted = false;
+    }
+    else
+    { AddTransitionBarrier(subresource, resource, subresourceIndex, desiredState); }
+
+    subresource.State = desiredState;
+}
+
+void ResourceStateTracker::AddTransitionBarrier(ResourceState::Subresource& subresource, ID3D12Resource* resource, uint32_t subresourceIndex, D3D12_RESOURCE_STATES desiredState)
+{
+    D3D12_RESOURCE_STATES stateBefore = subresource.State;
+    D3D12_RESOURCE_STATES stateAfter = desiredState;
+
+    // Look for a pending transition of the same subresource to merge with
+    // The search stops at anything else which might depend on the subresource being in its intermediate state.
+    for (size_t i = m_PendingBarriers.size(); i-- > 0;)
+    {
+        D3D12_RESOURCE_BARRIER& barrier = m_PendingBarriers[i];
+        if (barrier.Type == D3D12_RESOURCE_BARRIER_TYPE_UAV)
+        {
+            if (barrier.UAV.pResource == nullptr || barrier.UAV.pResource == resource)
+            { break; }
+            continue;
+        }
+
+        if (barrier.Type == D3D12_RESOURCE_BARRIER_TYPE_ALIASING)
+        {
+            if (barrier.Aliasing.pResourceBefore == nullptr || barrier.Aliasing.pResourceBefore == resource || barrier.Aliasing.pResourceAfter == nullptr || barrier.Aliasing.pResourceAfter == resource)
+            { break; }
+            continue;
+        }
+
+        D3D12_RESOURCE_TRANSITION_BARRIER& transition = barrier.Transition;
+        if (transition.pResource != resource)
+        { continue; }
+
+        bool isAll = subresourceIndex == D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES || transition.Subresource == D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
+        if (!isAll && transition.Subresource != subresourceIndex)
+        { continue; }
+
+        if (transition.Subresource != subresourceIndex || barrier.Flags != D3D12_RESOURCE_BARRIER_FLAG_NONE || transition.StateAfter != stateBefore)
+        { break; }
+
+        // A->B followed by B->C becomes A->C
+        if (transition.StateBefore != stateAfter)
+        {
+            transition.StateAfter = stateAfter;
+            subresource.IsPromoted = false;
+            return;
+        }
+
+        // A->B followed by B->A cancels out, but only if nothing on either side of the barriers needed them for synchronization
+        // As far as the GPU is concerned the subresource never leaves its previous state, so it still decays if it was promoted into it
+        if (IsReadOnly(stateAfter))
+        {
+            subresource.IsPromoted = m_PendingBarrierWasPromoted[i];
+            m_PendingBarriers.erase(m_PendingBarriers.begin() + i);
+            m_PendingBarrierWasPromoted.erase(m_PendingBarrierWasPromoted.begin() + i);
+            return;
+        }
+
+        // Back to back UAV accesses still need their writes to be ordered
+        if (stateAfter == D3D12_RESOURCE_STATE_UNORDERED_ACCESS)
+        {
+            barrier =
+            {
+                .Type = D3D12_RESOURCE_BARRIER_TYPE_UAV,
+                .Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE,
+                .UAV = { .pResource = resource },
+            };
+            subresource.IsPromoted = m_PendingBarrierWasPromoted[i];
+            m_PendingBarrierWasPromoted[i] = false;
+            return;
+        }
+
+        // Other write states are left alone
+        break;
+    }
+
+    D3D12_RESOURCE_BARRIER barrier =
+    {
+        .Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION,
+        .Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE,
+        .Transition =
+        {
+            .pResource = resource,
+            .Subresource = subresourceIndex,
+            .StateBefore = stateBefore,
+            .StateAfter = stateAfter,
+        },
+    };
+    AddBarrier(barrier, subresource.IsPromoted);
+    subresource.IsPromoted = false;
+}
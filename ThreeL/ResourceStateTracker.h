@@ -0,0 +1,123 @@
+#pragma once
+#include <d3d12.h>
+#include <span>
+#include <stdint.h>
+#include <vector>
+
+//! The state of every subresource of a single resource as seen by the command lists which have been recorded so far, see ResourceStateTracker
+//! States are only expanded per subresource once the resource is first used by a tracker since that's the first time its description is needed.
+class ResourceState
+{
+    friend class ResourceStateTracker;
+private:
+    struct Subresource
+    {
+        D3D12_RESOURCE_STATES State;
+        // Only valid when IsSplit is set, the end of a split barrier must match its beginning
+        D3D12_RESOURCE_STATES SplitStateBefore;
+        uint32_t SplitSubresource;
+        bool IsPromoted; // State was implicitly promoted from common by the current command list
+        bool IsSplit; // A split barrier to State has begun but hasn't ended yet
+
+        // Promotions only happen once the GPU actually accesses the subresource, so they're rolled back if it's transitioned again before any work is recorded
+        bool IsPromotionPending;
+        D3D12_RESOURCE_STATES StateBeforePromotion;
+        bool WasPromoted;
+
+        inline bool operator ==(const Subresource&) const = default;
+    };
+
+    D3D12_RESOURCE_STATES m_InitialState;
+    bool m_IsStateless = false;
+    bool m_IsTracked = false;
+    bool m_HasPendingPromotions = false;
+    std::vector<Subresource> m_Subresources;
+
+public:
+    ResourceState(D3D12_RESOURCE_STATES initialState = D3D12_RESOURCE_STATE_COMMON)
+        : m_InitialState(initialState)
+    {
+    }
+
+    inline bool IsInitialized() const { return !m_Subresources.empty(); }
+
+    //! Expands the initial state to every subresource
+    //! Stateless resources are buffers and textures which allow simultaneous access, they can be promoted from common to any state and always decay back to it.
+    void Initialize(uint32_t subresourceCount, bool isStateless);
+
+    inline uint32_t SubresourceCount() const { return (uint32_t)m_Subresources.size(); }
+    D3D12_RESOURCE_STATES State(uint32_t subresource = 0) const;
+    //! True when every subresource is in the same state
+    bool IsUniform() const;
+};
+
+//! Tracks resource states per subresource for a single command list and batches the barriers needed to move between them
+//!
+//! Transitions which can be satisfied by implicit state promotion don't emit barriers, and resources decay back to common when the command list ends
+//! following the rules of the D3D12 resource state model:
+//! * Everything accessed on a copy queue decays.
+//! * Stateless resources (buffers and simultaneous access textures) can be promoted to any state and always decay.
+//! * Other textures can only be promoted to shader resource and copy states, and only decay if they were promoted to a read-only state.
+//! https://learn.microsoft.com/en-us/windows/win32/direct3d12/using-resource-barriers-to-synchronize-resource-states-in-direct3d-12#implicit-state-transitions
+//!
+//! Promotions only happen once the GPU actually accesses a resource, so the tracker assumes the work recorded after the next WorkRecorded uses every resource
+//! transitioned before it. A promotion is rolled back if the subresource is transitioned again before then.
+//!
+//! Barriers accumulate until the caller takes them with PendingBarriers, which it should do right before recording any work which depends on them.
+//! Consecutive transitions of the same subresource are merged (A->B followed by B->C becomes A->C) and transitions which cancel out are dropped.
+//! Transitioning to a read-only state the subresource is already readable in is a no-op.
+//!
+//! Resource states are stored in the ResourceState (which lives with the resource), so only one tracker may use a resource between command lists ending.
+//! This type only emits barrier descriptions, it never calls into D3D.
+class ResourceStateTracker
+{
+private:
+    D3D12_COMMAND_LIST_TYPE m_QueueType;
+    std::vector<D3D12_RESOURCE_BARRIER> m_PendingBarriers;
+    // Parallel to m_PendingBarriers, whether the subresource was promoted into the state a transition barrier leaves
+    // This is restored when a later barrier cancels it out since the subresource never actually left that state.
+    std::vector<bool> m_PendingBarrierWasPromoted;
+    std::vector<ResourceState*> m_TrackedResources;
+    std::vector<ResourceState*> m_PendingPromotions;
+
+public:
+    ResourceStateTracker(D3D12_COMMAND_LIST_TYPE queueType);
+    ResourceStateTracker(const ResourceStateTracker&) = delete;
+
+    //! Transitions one subresource (or all of them) to the desired state, completing a split barrier to that state if one was begun
+    //! The resource state must have been initialized.
+    void Transition(ResourceState& state, ID3D12Resource* resource, D3D12_RESOURCE_STATES desiredState, uint32_t subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES);
+
+    //! Begins a split barrier to the desired state, the subresource must not be used until Transition is called with the same state
+    //! Transitions which don't need a barrier (IE: because they're implicit promotions) have nothing to begin and happen once Transition is called.
+    void BeginTransition(ResourceState& state, ID3D12Resource* resource, D3D12_RESOURCE_STATES desiredState, uint32_t subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES);
+
+    //! Adds a UAV barrier for the resource, or for all UAV accesses when resource is null
+    void UavBarrier(ID3D12Resource* resource);
+
+    //! Adds an aliasing barrier between two placed resources which share memory, either may be null to mean any resource
+    void AliasingBarrier(ID3D12Resource* resourceBefore, ID3D12Resource* resourceAfter);
+
+    inline std::span<const D3D12_RESOURCE_BARRIER> PendingBarriers() const { return m_PendingBarriers; }
+    inline void ClearPendingBarriers()
+    {
+        m_PendingBarriers.clear();
+        m_PendingBarrierWasPromoted.clear();
+    }
+
+    //! Indicates that work which accesses resources in their current states was recorded, which is when implicit promotions actually happen
+    //! Pending barriers must have been recorded and cleared first.
+    void WorkRecorded();
+
+    //! Applies implicit state decay to every resource used since the last call, must be called whenever the command list is closed
+    //! Pending barriers must have been recorded and cleared first.
+    void CommandListEnded();
+
+private:
+    void Track(ResourceState& state);
+    void RollBackPromotion(ResourceState::Subresource& subresource);
+    void TransitionSubresource(ResourceState::Subresource& subresource, ID3D12Resource* resource, uint32_t subresourceIndex, D3D12_RESOURCE_STATES desiredState, bool isSplit, ResourceState& state);
+    bool CanPromote(const ResourceState::Subresource& subresource, D3D12_RESOURCE_STATES desiredState, bool isStateless) const;
+    void AddBarrier(const D3D12_RESOURCE_BARRIER& barrier, bool wasPromoted = false);
+    void AddTransitionBarrier(ResourceState::Subresource& subresource, ID3D12Resource* resource, uint32_t subresourceIndex, D3D12_RESOURCE_STATES desiredState);
+};
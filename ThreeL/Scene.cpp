@@ -2,6 +2,7 @@
 #include "Scene.h"
 
 #include "GltfLoadContext.h"
+#include "JobSystem.h"
 
 // glTF uses right-handed coordinates but we use left-handed so we need to convert form one to the other, which we do by mirroring about the YZ plane
 static const float4x4 g_CoordinateSpaceConversion
@@ -12,7 +13,7 @@ static const float4x4 g_CoordinateSpaceConversion
     0.f, 0.f, 0.f, 1.f
 );
 
-Scene::Scene(ResourceManager& resources, const tinygltf::Model& model, const float4x4& transform)
+Scene::Scene(ResourceManager& resources, JobSystem& jobs, const tinygltf::Model& model, const float4x4& transform)
 {
     GltfLoadContext context(resources.Graphics, resources, model, *this);
     const tinygltf::Scene& scene = model.scenes[model.defaultScene];
@@ -129,6 +130,37 @@ Scene::Scene(ResourceManager& resources, const tinygltf::Model& model, const flo
     {
         LoadNode(nodeIndex, rootTransform);
     }
+
+    // Generate meshlets and LODs for all of the primitives at once since simplification is by far the most expensive part of loading
+    // (Primitives of meshes which aren't referenced by the scene are never loaded, so they're skipped.)
+    jobs.ParallelFor((uint32_t)m_Primitives.size(), [&](uint32_t i)
+        {
+            if (m_Primitives[i].IsValid())
+            {
+                m_Primitives[i].GenerateMeshlets();
+                m_Primitives[i].GenerateLods();
+            }
+        });
+
+    MeshletStatistics meshletStatistics = { };
+    for (MeshPrimitive& primitive : m_Primitives)
+    {
+        if (primitive.IsValid())
+        {
+            primitive.UploadGeneratedGeometry(resources.MeshHeap);
+            meshletStatistics += primitive.MeshletBuildStatistics();
+        }
+    }
+
+    printf
+    (
+        "Built %u meshlets averaging %.1f triangles with %.2f vertices per triangle, %u have normal cones averaging %.1f degrees.\n",
+        meshletStatistics.MeshletCount,
+        meshletStatistics.MeshletCount == 0 ? 0.f : (float)meshletStatistics.TriangleCount / (float)meshletStatistics.MeshletCount,
+        meshletStatistics.VerticesPerTriangle(),
+        meshletStatistics.ConeCount,
+        Math::Rad2Deg(meshletStatistics.AverageConeAngle())
+    );
 }
 
 Scene::~Scene()
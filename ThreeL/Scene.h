@@ -3,12 +3,13 @@
 #include "MeshPrimitive.h"
 #include "ResourceManager.h"
 #include "SceneNode.h"
-#include "Texture.h"
 
 #include <tiny_gltf.h>
 #include <span>
 #include <vector>
 
+class JobSystem;
+
 class Scene
 {
     // GltfLoadContext is responsible for managing our various resource caches
@@ -18,11 +19,11 @@ private:
     std::span<MeshPrimitive> m_Primitives;
     std::span<SceneNode> m_SceneNodes;
 
-    // (Image index + sRGB bit) -> Texture
-    std::unordered_map<uint64_t, std::unique_ptr<Texture>> m_TextureCache;
+    // (Image index + sRGB bit) -> Streamed texture bindless index
+    std::unordered_map<uint64_t, uint32_t> m_TextureCache;
 
 public:
-    Scene(ResourceManager& resources, const tinygltf::Model& model, const float4x4& transform);
+    Scene(ResourceManager& resources, JobSystem& jobs, const tinygltf::Model& model, const float4x4& transform);
 
     inline std::span<const SceneNode> SceneNodes() const { return m_SceneNodes; }
     inline auto begin() const { return SceneNodes().begin(); }
@@ -0,0 +1,92 @@
+#include "pch.h"
+#include "SceneOccluders.h"
+
+#include "Scene.h"
+
+#include <algorithm>
+
+OccluderGeometry SelectSceneOccluders(const Scene& scene, uint32_t triangleBudget)
+{
+    struct Candidate
+    {
+        const MeshPrimitive* Primitive;
+        float4x4 Transform;
+        uint32_t TriangleCount;
+        float Score;
+    };
+
+    std::vector<Candidate> candidates;
+    for (const SceneNode& node : scene)
+    {
+        if (!node.IsValid()) { continue; }
+
+        float4x4 transform = node.WorldTransform();
+        for (const MeshPrimitive& primitive : node)
+        {
+            std::span<const float3> positions = primitive.OccluderPositions();
+            std::span<const uint32_t> indices = primitive.OccluderIndices();
+            if (indices.size() < 3)
+            { continue; }
+
+            float area = 0.f;
+            for (size_t i = 0; i + 2 < indices.size(); i += 3)
+            {
+                float4 a = transform.Transform(float4(positions[indices[i + 0]], 1.f));
+                float4 b = transform.Transform(float4(positions[indices[i + 1]], 1.f));
+                float4 c = transform.Transform(float4(positions[indices[i + 2]], 1.f));
+                float3 ab = float3(b.x - a.x, b.y - a.y, b.z - a.z);
+                float3 ac = float3(c.x - a.x, c.y - a.y, c.z - a.z);
+                area += ab.Cross(ac).Length() * 0.5f;
+            }
+
+            // Double-sided primitives are rasterized with both windings, so they cost twice as much
+            uint32_t triangleCount = (uint32_t)(indices.size() / 3) * (primitive.Material().IsDoubleSided() ? 2 : 1);
+            candidates.push_back
+            ({
+                .Primitive = &primitive,
+                .Transform = transform,
+                .TriangleCount = triangleCount,
+                .Score = area / (float)triangleCount,
+            });
+        }
+    }
+
+    std::sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b) { return a.Score > b.Score; });
+
+    OccluderGeometry result;
+    uint32_t remainingBudget = triangleBudget;
+    for (const Candidate& candidate : candidates)
+    {
+        if (candidate.TriangleCount > remainingBudget)
+        { continue; }
+
+        remainingBudget -= candidate.TriangleCount;
+
+        uint32_t baseVertex = (uint32_t)result.Positions.size();
+        for (float3 position : candidate.Primitive->OccluderPositions())
+        {
+            float4 world = candidate.Transform.Transform(float4(position, 1.f));
+            result.Positions.push_back(float3(world.x, world.y, world.z));
+        }
+
+        std::span<const uint32_t> indices = candidate.Primitive->OccluderIndices();
+        for (size_t i = 0; i + 2 < indices.size(); i += 3)
+        {
+            result.Indices.push_back(baseVertex + indices[i + 0]);
+            result.Indices.push_back(baseVertex + indices[i + 1]);
+            result.Indices.push_back(baseVertex + indices[i + 2]);
+        }
+
+        if (candidate.Primitive->Material().IsDoubleSided())
+        {
+            for (size_t i = 0; i + 2 < indices.size(); i += 3)
+            {
+                result.Indices.push_back(baseVertex + indices[i + 0]);
+                result.Indices.push_back(baseVertex + indices[i + 2]);
+                result.Indices.push_back(baseVertex + indices[i + 1]);
+            }
+        }
+    }
+
+    return result;
+}
@@ -0,0 +1,8 @@
+#pragma once
+#include "OcclusionRasterizer.h"
+
+class Scene;
+
+//! Selects the scene's most effective occluders and flattens them into world space geometry for OcclusionRasterizer
+//! Occluders are ranked by world space area per triangle (IE: walls and floors made of large triangles rank highly) and taken until the triangle budget is exhausted.
+OccluderGeometry SelectSceneOccluders(const Scene& scene, uint32_t triangleBudget);
@@ -0,0 +1,259 @@
+#include "pch.h"
+#include "ShaderCache.h"
+
+#include <fstream>
+#include <random>
+#include <thread>
+#include <unordered_set>
+#include <xxhash.h>
+
+namespace
+{
+    const uint32_t CacheFileMagic = 0x4353334C; // '3LSC'
+
+    // Bump this whenever the key or file layout changes to orphan old entries
+    const uint32_t CacheFormatVersion = 1;
+
+    struct CacheFileHeader
+    {
+        uint32_t Magic;
+        uint32_t FormatVersion;
+        uint32_t ShaderSize;
+        uint32_t RootSignatureSize;
+
+        // XXH64 of the shader followed by the root signature, guards against truncated or corrupted files
+        uint64_t Checksum;
+    };
+
+    std::optional<std::vector<uint8_t>> ReadFile(const std::filesystem::path& path)
+    {
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        if (!file)
+        { return std::nullopt; }
+
+        std::streamoff size = file.tellg();
+        if (size < 0)
+        { return std::nullopt; }
+
+        std::vector<uint8_t> result((size_t)size);
+        file.seekg(0);
+        if (!file.read((char*)result.data(), size))
+        { return std::nullopt; }
+
+        return result;
+    }
+
+    // Strings are hashed with their length so that adjacent strings can't run together (IE: "ab" + "c" vs "a" + "bc")
+    template<typename TChar>
+    void HashString(XXH3_state_t* state, std::basic_string_view<TChar> string)
+    {
+        uint64_t length = string.size();
+        XXH3_128bits_update(state, &length, sizeof(length));
+        XXH3_128bits_update(state, string.data(), string.size() * sizeof(TChar));
+    }
+
+    // Returns the path of every file named by an #include directive in the source
+    std::vector<std::string> ScanIncludes(std::span<const uint8_t> source)
+    {
+        std::vector<std::string> result;
+        std::string_view text((const char*)source.data(), source.size());
+
+        size_t lineStart = 0;
+        while (lineStart < text.size())
+        {
+            size_t lineEnd = text.find('\n', lineStart);
+            if (lineEnd == std::string_view::npos)
+            { lineEnd = text.size(); }
+
+            std::string_view line = text.substr(lineStart, lineEnd - lineStart);
+            lineStart = lineEnd + 1;
+
+            // Directives may have whitespace both before and after the #
+            size_t i = line.find_first_not_of(" \t");
+            if (i == std::string_view::npos || line[i] != '#')
+            { continue; }
+
+            i = line.find_first_not_of(" \t", i + 1);
+            if (i == std::string_view::npos || line.substr(i, 7) != "include")
+            { continue; }
+
+            i = line.find_first_not_of(" \t", i + 7);
+            if (i == std::string_view::npos || (line[i] != '"' && line[i] != '<'))
+            { continue; }
+
+            char terminator = line[i] == '"' ? '"' : '>';
+            size_t end = line.find(terminator, i + 1);
+            if (end != std::string_view::npos)
+            { result.emplace_back(line.substr(i + 1, end - i - 1)); }
+        }
+
+        return result;
+    }
+}
+
+ShaderCache::ShaderCache(std::filesystem::path directory, std::string compilerVersion)
+    : m_Directory(std::move(directory)), m_CompilerVersion(std::move(compilerVersion))
+{
+}
+
+std::optional<CachedShader> ShaderCache::GetOrCompile(const ShaderCacheRequest& request, const std::function<std::optional<CachedShader>()>& compile)
+{
+    std::string key = ComputeKey(request);
+    if (std::optional<CachedShader> cached = Load(key))
+    {
+        m_HitCount++;
+        return cached;
+    }
+
+    m_MissCount++;
+    std::optional<CachedShader> result = compile();
+    if (result.has_value())
+    { Store(key, *result); }
+
+    return result;
+}
+
+std::string ShaderCache::ComputeKey(const ShaderCacheRequest& request) const
+{
+    XXH3_state_t* state = XXH3_createState();
+    Assert(state != nullptr);
+    XXH3_128bits_reset(state);
+
+    XXH3_128bits_update(state, &CacheFormatVersion, sizeof(CacheFormatVersion));
+    HashString<char>(state, m_CompilerVersion);
+    HashString<char>(state, request.SourcePath.generic_string());
+    HashString<wchar_t>(state, request.EntryPoint);
+    HashString<wchar_t>(state, request.Target);
+
+    // Defines and arguments are counted so that moving a string from one list to the other changes the key
+    uint64_t defineCount = request.Defines.size();
+    XXH3_128bits_update(state, &defineCount, sizeof(defineCount));
+    for (const std::wstring& define : request.Defines)
+    { HashString<wchar_t>(state, define); }
+
+    uint64_t argumentCount = request.Arguments.size();
+    XXH3_128bits_update(state, &argumentCount, sizeof(argumentCount));
+    for (const std::wstring& argument : request.Arguments)
+    { HashString<wchar_t>(state, argument); }
+
+    for (const std::filesystem::path& path : IncludeClosure(request.SourcePath))
+    {
+        HashString<char>(state, path.generic_string());
+
+        std::optional<std::vector<uint8_t>> contents = ReadFile(path);
+        uint8_t exists = contents.has_value();
+        XXH3_128bits_update(state, &exists, sizeof(exists));
+        if (contents.has_value())
+        { HashString<char>(state, std::string_view((const char*)contents->data(), contents->size())); }
+    }
+
+    XXH128_hash_t hash = XXH3_128bits_digest(state);
+    XXH3_freeState(state);
+    return std::format("{:016x}{:016x}", hash.high64, hash.low64);
+}
+
+std::optional<CachedShader> ShaderCache::Load(const std::string& key) const
+{
+    std::optional<std::vector<uint8_t>> contents = ReadFile(m_Directory / (key + ".bin"));
+    if (!contents.has_value() || contents->size() < sizeof(CacheFileHeader))
+    { return std::nullopt; }
+
+    CacheFileHeader header;
+    memcpy(&header, contents->data(), sizeof(header));
+    std::span<const uint8_t> payload = std::span(*contents).subspan(sizeof(header));
+
+    if (header.Magic != CacheFileMagic || header.FormatVersion != CacheFormatVersion)
+    { return std::nullopt; }
+
+    if ((uint64_t)header.ShaderSize + header.RootSignatureSize != payload.size() || XXH64(payload.data(), payload.size(), 0) != header.Checksum)
+    {
+        printf("Warning: Ignoring corrupt shader cache entry '%s'.\n", key.c_str());
+        return std::nullopt;
+    }
+
+    CachedShader result;
+    result.Shader.assign(payload.begin(), payload.begin() + header.ShaderSize);
+    result.RootSignature.assign(payload.begin() + header.ShaderSize, payload.end());
+    return result;
+}
+
+void ShaderCache::Store(const std::string& key, const CachedShader& shader) const
+{
+    std::error_code error;
+    std::filesystem::create_directories(m_Directory, error);
+
+    // Each writer uses its own temporary file, whichever process finishes last wins the rename but they all wrote the same thing anyway
+    std::random_device random;
+    std::filesystem::path temporaryPath = m_Directory / std::format("{}.{:08x}{:08x}.tmp", key, random(), (uint32_t)std::hash<std::thread::id>()(std::this_thread::get_id()));
+    std::filesystem::path finalPath = m_Directory / (key + ".bin");
+
+    XXH64_state_t* checksum = XXH64_createState();
+    Assert(checksum != nullptr);
+    XXH64_reset(checksum, 0);
+    XXH64_update(checksum, shader.Shader.data(), shader.Shader.size());
+    XXH64_update(checksum, shader.RootSignature.data(), shader.RootSignature.size());
+
+    CacheFileHeader header =
+    {
+        .Magic = CacheFileMagic,
+        .FormatVersion = CacheFormatVersion,
+        .ShaderSize = (uint32_t)shader.Shader.size(),
+        .RootSignatureSize = (uint32_t)shader.RootSignature.size(),
+        .Checksum = XXH64_digest(checksum),
+    };
+    XXH64_freeState(checksum);
+
+    bool success;
+    {
+        std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+        file.write((const char*)&header, sizeof(header));
+        file.write((const char*)shader.Shader.data(), shader.Shader.size());
+        file.write((const char*)shader.RootSignature.data(), shader.RootSignature.size());
+        file.close();
+        success = file.good();
+    }
+
+    if (success)
+    {
+        std::filesystem::rename(temporaryPath, finalPath, error);
+        success = !error;
+    }
+
+    if (!success)
+    {
+        printf("Warning: Failed to write shader cache entry '%s'.\n", key.c_str());
+        std::filesystem::remove(temporaryPath, error);
+    }
+}
+
+std::vector<std::filesystem::path> ShaderCache::IncludeClosure(const std::filesystem::path& sourcePath)
+{
+    std::vector<std::filesystem::path> result = { sourcePath.lexically_normal() };
+    std::unordered_set<std::string> visited = { result[0].generic_string() };
+
+    // result doubles as the work queue
+    for (size_t i = 0; i < result.size(); i++)
+    {
+        std::optional<std::vector<uint8_t>> contents = ReadFile(result[i]);
+        if (!contents.has_value())
+        { continue; }
+
+        for (const std::string& include : ScanIncludes(*contents))
+        {
+            // Like DXC, includes are resolved relative to the including file first and then relative to the root source file
+            std::error_code error;
+            std::filesystem::path path = (result[i].parent_path() / include).lexically_normal();
+            if (!std::filesystem::exists(path, error))
+            {
+                std::filesystem::path fallbackPath = (result[0].parent_path() / include).lexically_normal();
+                if (std::filesystem::exists(fallbackPath, error))
+                { path = fallbackPath; }
+            }
+
+            if (visited.insert(path.generic_string()).second)
+            { result.push_back(path); }
+        }
+    }
+
+    return result;
+}
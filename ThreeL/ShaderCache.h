@@ -0,0 +1,66 @@
+#pragma once
+#include <filesystem>
+#include <functional>
+#include <optional>
+#include <string>
+#include <vector>
+
+//! Compiler output stored by ShaderCache
+struct CachedShader
+{
+    std::vector<uint8_t> Shader;
+
+    //! Empty if the shader has no embedded root signature
+    std::vector<uint8_t> RootSignature;
+};
+
+//! Everything which determines the output of compiling a shader
+struct ShaderCacheRequest
+{
+    std::filesystem::path SourcePath;
+    std::wstring EntryPoint;
+    std::wstring Target;
+    std::vector<std::wstring> Defines;
+
+    //! Any other compiler arguments which affect the output (IE: optimization and debug info flags)
+    std::vector<std::wstring> Arguments;
+};
+
+//! Content-addressed on-disk cache of compiled shaders
+//! Entries are keyed by a hash of the request, the compiler version, and the contents of the source file and every file it transitively includes, so
+//! editing any of them simply misses the cache rather than needing to invalidate anything. Entries are written to a temporary file and renamed into place,
+//! so several processes can safely share the same cache directory.
+//! The cache knows nothing about the compiler itself, compilation is provided by the caller of GetOrCompile.
+class ShaderCache
+{
+private:
+    std::filesystem::path m_Directory;
+    std::string m_CompilerVersion;
+
+    uint32_t m_HitCount = 0;
+    uint32_t m_MissCount = 0;
+
+public:
+    //! compilerVersion must change whenever the compiler might produce different output for the same request
+    ShaderCache(std::filesystem::path directory, std::string compilerVersion);
+    ShaderCache(const ShaderCache&) = delete;
+
+    //! Returns the cached output for the request or compiles it and adds it to the cache
+    //! Failing to read or write the cache is never fatal, it just means compile is called. Failed compilations (IE: compile returns nothing) aren't cached.
+    std::optional<CachedShader> GetOrCompile(const ShaderCacheRequest& request, const std::function<std::optional<CachedShader>()>& compile);
+
+    //! Returns the request's cache key as a hex string, which is also the name of its cache file
+    std::string ComputeKey(const ShaderCacheRequest& request) const;
+
+    std::optional<CachedShader> Load(const std::string& key) const;
+    void Store(const std::string& key, const CachedShader& shader) const;
+
+    //! Returns the source file followed by every file it includes (directly or indirectly) in the order they were first encountered
+    //! Includes are found by scanning for #include directives without preprocessing, so conditionally included files are always part of the closure. Missing
+    //! files are listed too since creating one may change which file an include resolves to.
+    static std::vector<std::filesystem::path> IncludeClosure(const std::filesystem::path& sourcePath);
+
+    inline const std::filesystem::path& Directory() const { return m_Directory; }
+    inline uint32_t HitCount() const { return m_HitCount; }
+    inline uint32_t MissCount() const { return m_MissCount; }
+};
@@ -80,6 +80,33 @@ namespace ShaderInterop
     static_assert(offsetof(PerNodeCb, ColorsIndex) == 116);
     static_assert(offsetof(PerNodeCb, TangentsIndex) == 120);
 
+    //! Replaces the transforms in PerNodeCb for instanced scene draws, see InstancedDrawList
+    struct PerInstance
+    {
+        float4x4 Transform;
+        float3x3 NormalTransform;
+    };
+    static_assert(sizeof(PerInstance) == 112);
+    static_assert(offsetof(PerInstance, Transform) == 0);
+    static_assert(offsetof(PerInstance, NormalTransform) == 64);
+
+    //! A meshlet and its culling data as stored in MeshPrimitive's bindless meshlet buffer, see MeshletBuilder.h
+    //! FirstVertex indexes the meshlet vertex buffer, FirstTriangle indexes the packed triangle buffer (three 8-bit vertex indices per uint)
+    struct MeshletInfo
+    {
+        uint32_t FirstVertex;
+        uint32_t VertexCount;
+        uint32_t FirstTriangle;
+        uint32_t TriangleCount;
+        float3 Center;
+        float Radius;
+        float3 ConeAxis;
+        float ConeCutoff;
+    };
+    static_assert(sizeof(MeshletInfo) == 48);
+    static_assert(offsetof(MeshletInfo, Center) == 16);
+    static_assert(offsetof(MeshletInfo, ConeAxis) == 32);
+
     namespace Pbr
     {
         // See PBR_ROOT_SIGNATURE in Common.hlsli
@@ -93,11 +120,82 @@ namespace ShaderInterop
             RpFirstLightLinkBuffer,
             RpSamplerHeap,
             RpBindlessHeap,
+            RpInstanceBuffer,
+        };
+    }
+
+    //! A single draw consumed by ExecuteIndirect with ResourceManager::PbrIndirectDrawCommandSignature, see IndirectDrawArguments.h
+    //! The vertex and index buffer views come first so that everything is naturally aligned without any padding between arguments.
+    struct IndirectDrawRecord
+    {
+        D3D12_VERTEX_BUFFER_VIEW Positions;
+        D3D12_VERTEX_BUFFER_VIEW Normals;
+        D3D12_VERTEX_BUFFER_VIEW Uvs;
+        D3D12_INDEX_BUFFER_VIEW Indices;
+        PerNodeCb PerNode;
+        D3D12_DRAW_INDEXED_ARGUMENTS Draw;
+    };
+    static_assert(sizeof(IndirectDrawRecord) == 208);
+    static_assert(offsetof(IndirectDrawRecord, Indices) == 48);
+    static_assert(offsetof(IndirectDrawRecord, PerNode) == 64);
+    static_assert(offsetof(IndirectDrawRecord, Draw) == 188);
+
+    struct IndirectDrawCullingInfo
+    {
+        float3 BoundsCenter;
+        uint32_t BucketIndex;
+        float3 BoundsExtents;
+        uint32_t BucketFirst;
+        //! The range of IndirectDrawArguments::Arguments::Lods for the draw's simplified LODs, see DrawPacket::FirstLod
+        uint32_t FirstLod;
+        uint32_t LodCount;
+    };
+    static_assert(sizeof(IndirectDrawCullingInfo) == 40);
+    static_assert(offsetof(IndirectDrawCullingInfo, BucketIndex) == 12);
+    static_assert(offsetof(IndirectDrawCullingInfo, BoundsExtents) == 16);
+    static_assert(offsetof(IndirectDrawCullingInfo, BucketFirst) == 28);
+    static_assert(offsetof(IndirectDrawCullingInfo, FirstLod) == 32);
+
+    //! A MeshLod as seen by SceneCulling.cs.hlsl, which patches the indices into the draw records that use it
+    struct IndirectDrawLod
+    {
+        D3D12_INDEX_BUFFER_VIEW Indices;
+        uint32_t IndexCount;
+        float Error;
+    };
+    static_assert(sizeof(IndirectDrawLod) == 24);
+    static_assert(offsetof(IndirectDrawLod, IndexCount) == 16);
+
+    struct SceneCullingParams
+    {
+        uint32_t DrawCount;
+        uint32_t BucketCount;
+        //! See DrawList::SelectLods, LOD selection is disabled when MaxPixelError is 0
+        float PixelsPerUnit;
+        float MaxPixelError;
+    };
+    static_assert(sizeof(SceneCullingParams) == 4 * sizeof(uint32_t));
+
+    namespace SceneCulling
+    {
+        // See ROOT_SIGNATURE in SceneCulling.cs.hlsl
+        enum RootParameters
+        {
+            RpParams,
+            RpPerFrameCb,
+            RpRecords,
+            RpCullingInfo,
+            RpLods,
+            RpCulledRecords,
+            RpBucketCounts,
         };
+
+        static const uint32_t GroupSize = 64;
     }
 
     const static uint32_t SizeOfParticleState = 60;
     const static uint32_t SizeOfParticleSprite = 48;
+    const static uint32_t SizeOfParticleLighting = 24;
 
     namespace ParticleRender
     {
@@ -113,6 +211,7 @@ namespace ShaderInterop
             RpFirstLightLinkBuffer,
             RpSamplerHeap,
             RpBindlessHeap,
+            RpParticleLightingBuffer,
         };
     }
 
@@ -180,10 +279,98 @@ namespace ShaderInterop
             RpLivingParticleCountOut,
             RpDrawIndirectArguments,
             RpParticleSpriteSortBuffer,
+            RpPreviousParticleSpriteSortBuffer,
+            RpDispatchIndirectArguments,
         };
 
         static const uint32_t SpawnGroupSize = 64;
         static const uint32_t UpdateGroupSize = 64;
+
+        // See g_DispatchIndirectArguments in ParticleSystem.cs.hlsl
+        static const uint32_t DispatchArgumentsUpdate = 0;
+        static const uint32_t DispatchArgumentsSpawn = 12;
+        static const uint32_t DispatchArgumentsLighting = 24;
+        static const uint32_t DispatchStatistics = 36;
+    }
+
+    struct ParticleDispatchStatistics
+    {
+        uint32_t UpdateThreadsDispatched;
+        uint32_t UpdateThreadsUseful;
+        uint32_t SpawnThreadsDispatched;
+        uint32_t SpawnThreadsUseful;
+    };
+    static_assert(sizeof(ParticleDispatchStatistics) == 16);
+    static_assert(ParticleSystem::DispatchArgumentsSpawn == ParticleSystem::DispatchArgumentsUpdate + sizeof(D3D12_DISPATCH_ARGUMENTS));
+    static_assert(ParticleSystem::DispatchArgumentsLighting == ParticleSystem::DispatchArgumentsSpawn + sizeof(D3D12_DISPATCH_ARGUMENTS));
+    static_assert(ParticleSystem::DispatchStatistics == ParticleSystem::DispatchArgumentsLighting + sizeof(D3D12_DISPATCH_ARGUMENTS));
+
+    struct ParticleLightingParams
+    {
+        uint32_t ParticleCapacity;
+        uint2 ScreenSize;
+    };
+    static_assert(sizeof(ParticleLightingParams) == 3 * sizeof(uint32_t));
+    static_assert(offsetof(ParticleLightingParams, ParticleCapacity) == 0);
+    static_assert(offsetof(ParticleLightingParams, ScreenSize) == 4);
+
+    namespace ParticleLighting
+    {
+        // See ROOT_SIGNATURE in ParticleLighting.cs.hlsl
+        enum RootParameters
+        {
+            RpParams,
+            RpPerFrameCb,
+            RpParticleBuffer,
+            RpLivingParticleCount,
+            RpParticleLightingOut,
+            RpMaterialHeap,
+            RpLightHeap,
+            RpLightLinksHeap,
+            RpFirstLightLinkBuffer,
+        };
+
+        static const uint32_t GroupSize = 64;
+    }
+
+    struct ParticleSortFixUpParams
+    {
+        uint32_t ParticleCapacity;
+        uint32_t StatisticsOffset;
+        uint32_t WindowOffset;
+        float MaxDisorderRatio;
+    };
+    static_assert(sizeof(ParticleSortFixUpParams) == 4 * sizeof(uint32_t));
+    static_assert(offsetof(ParticleSortFixUpParams, ParticleCapacity) == 0);
+    static_assert(offsetof(ParticleSortFixUpParams, StatisticsOffset) == 4);
+    static_assert(offsetof(ParticleSortFixUpParams, WindowOffset) == 8);
+    static_assert(offsetof(ParticleSortFixUpParams, MaxDisorderRatio) == 12);
+
+    namespace ParticleSortFixUp
+    {
+        // See ROOT_SIGNATURE in ParticleSortFixUp.cs.hlsl
+        enum RootParameters
+        {
+            RpParams,
+            RpLivingParticleCount,
+            RpSortList,
+            RpMergeScratch,
+            RpStatistics,
+            RpFixUpArguments,
+            RpFallbackItemCount,
+        };
+
+        // Byte offsets within the statistics buffer
+        static const uint32_t StatisticsInitialInversions = 0;
+        static const uint32_t StatisticsFixedInversions = 4;
+        static const uint32_t StatisticsSurvivorCount = 8;
+        static const uint32_t StatisticsFinalInversions = 12;
+        static const uint32_t StatisticsSize = 16;
+
+        static const uint32_t MeasureGroupSize = 64;
+        static const uint32_t MergeGroupSize = 64;
+        static const uint32_t FixUpWindowSize = 2048;
+        static const uint32_t FixUpPassCount = 64;
     }
 
     struct GenerateMipmapChainParams
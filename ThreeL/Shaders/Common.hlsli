@@ -73,6 +73,12 @@ struct PerNode
     uint TangentsIndex;
 };
 
+struct PerInstance
+{
+    float4x4 Transform;
+    float3x4 NormalTransform; // Rows are padded to match the CPU-side float3x3
+};
+
 struct PerFrame
 {
     float4x4 ViewProjectionTransform;
@@ -99,6 +105,27 @@ SamplerState g_Samplers[] : register(space1);
 Texture2D g_Textures[] : register(space2);
 ByteAddressBuffer g_Buffers[] : register(space3);
 
+// Only used when PBR_INSTANCED is defined, the root descriptor points at the first instance of the draw since SV_InstanceID doesn't include the start instance
+StructuredBuffer<PerInstance> g_Instances : register(t4);
+
+float4x4 NodeTransform(uint instanceId)
+{
+#ifdef PBR_INSTANCED
+    return g_Instances[instanceId].Transform;
+#else
+    return g_PerNode.Transform;
+#endif
+}
+
+float3x3 NodeNormalTransform(uint instanceId)
+{
+#ifdef PBR_INSTANCED
+    return (float3x3)g_Instances[instanceId].NormalTransform;
+#else
+    return g_PerNode.NormalTransform;
+#endif
+}
+
 #ifndef PBR_ROOT_SIGNATURE
 #define PBR_ROOT_SIGNATURE \
     "RootFlags(ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT)," \
@@ -115,6 +142,7 @@ ByteAddressBuffer g_Buffers[] : register(space3);
         "SRV(t0, space = 2, offset = 0, numDescriptors = unbounded, flags = DESCRIPTORS_VOLATILE | DATA_VOLATILE)," \
         "SRV(t0, space = 3, offset = 0, numDescriptors = unbounded, flags = DESCRIPTORS_VOLATILE | DATA_VOLATILE)" \
     ")," \
+    "SRV(t4, flags = DATA_STATIC, visibility = SHADER_VISIBILITY_VERTEX)," \
     ""
 #endif
 
@@ -7,6 +7,7 @@
 struct VsInput
 {
     uint VertexId : SV_VertexID;
+    uint InstanceId : SV_InstanceID;
     float3 Position : POSITION;
     float2 Uv0 : TEXCOORD0;
 
@@ -37,7 +38,7 @@ PsInput VsMain(VsInput input)
     PsInput result;
 
     result.Position = float4(input.Position.xyz, 1.f);
-    result.Position = mul(result.Position, g_PerNode.Transform);
+    result.Position = mul(result.Position, NodeTransform(input.InstanceId));
     result.Position = mul(result.Position, g_PerFrame.ViewProjectionTransform);
 
     result.Color = input.Color();
@@ -23,6 +23,13 @@ struct ParticleSprite
     float2x2 Transform;
 };
 
+// Lighting evaluated once per particle when ParticleLightingMode::PerParticle is used (see ParticleLighting.cs.hlsl)
+struct ParticleLighting
+{
+    float3 Diffuse;
+    float3 Specular;
+};
+
 ParticleSprite MakeSprite(ParticleState state)
 {
     ParticleSprite sprite;
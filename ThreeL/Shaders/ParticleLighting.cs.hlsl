@@ -0,0 +1,83 @@
+// Evaluates lighting once per particle rather than once per pixel when ParticleSystem uses ParticleLightingMode::PerParticle
+// Translucent particles overlap heavily, so walking the light linked list for every pixel of every sprite gets expensive fast.
+// Instead we walk it once at the particle's center and let ParticleRender.hlsl (compiled with PARTICLE_LIGHTING_CACHE) apply the result.
+// See ParticleLightingReference.h for a CPU implementation of the same math.
+#define PBR_IS_PARTICLE
+
+#include "ParticleCommon.hlsli"
+#include "Common.hlsli"
+#include "PbrBrdf.hlsli"
+
+StructuredBuffer<ParticleSprite> g_Particles : register(t0, space900);
+ByteAddressBuffer g_LivingParticleCount : register(t1, space900);
+
+RWStructuredBuffer<ParticleLighting> g_ParticleLightingOut : register(u0, space900);
+
+struct ParticleLightingParams
+{
+    uint ParticleCapacity;
+    uint2 ScreenSize;
+};
+
+ConstantBuffer<ParticleLightingParams> g_Params : register(b0, space900);
+
+#define ROOT_SIGNATURE \
+    "RootConstants(num32BitConstants = 3, b0, space = 900)," \
+    "CBV(b1)," \
+    "SRV(t0, space = 900, flags = DATA_STATIC_WHILE_SET_AT_EXECUTE)," \
+    "SRV(t1, space = 900, flags = DATA_STATIC_WHILE_SET_AT_EXECUTE)," \
+    "UAV(u0, space = 900, flags = DATA_VOLATILE)," \
+    "SRV(t0, flags = DATA_STATIC)," \
+    "SRV(t1, flags = DATA_STATIC_WHILE_SET_AT_EXECUTE)," \
+    "SRV(t2, flags = DATA_STATIC_WHILE_SET_AT_EXECUTE)," \
+    "SRV(t3, flags = DATA_STATIC_WHILE_SET_AT_EXECUTE)," \
+    ""
+
+[numthreads(64, 1, 1)]
+[RootSignature(ROOT_SIGNATURE)]
+void MainComputeLighting(uint3 threadId : SV_DispatchThreadID)
+{
+    // Particle count can be beyond capacity when spawning fails due to the system being full
+    uint particleCount = min(g_LivingParticleCount.Load(0), g_Params.ParticleCapacity);
+    if (threadId.x >= particleCount)
+    { return; }
+
+    ParticleSprite particle = g_Particles[threadId.x];
+    MaterialParams material = g_Materials[particle.MaterialId];
+
+    // Textures can't be sampled without a UV, so the base color texture is applied in the pixel shader instead
+    // Normal maps and metal/roughness textures are ignored entirely
+    float4 baseColor = particle.Color * material.BaseColorFactor;
+    float3 normal = normalize(mul(float3(0.f, 0.f, -1.f), (float3x3)g_PerFrame.ViewTransformInverse));
+
+    Brdf brdf = MakeBrdf(baseColor.rgb, material.MetallicFactor, material.RoughnessFactor, particle.WorldPosition, normal);
+    brdf.ApplySceneDirectionalLights();
+
+    // Apply point lights from the light linked list at the particle's center
+    // Particles which are off screen will not be drawn, but their corners might be so we clamp to the edge of the screen
+    float4 position = mul(float4(particle.WorldPosition, 1.f), g_PerFrame.ViewProjectionTransform);
+    if (position.w > 0.f)
+    {
+        float2 uv = position.xy / position.w * float2(0.5f, -0.5f) + 0.5f;
+        uint2 screenPosition = (uint2)clamp(uv * (float2)g_Params.ScreenSize, 0.f.xx, (float2)(g_Params.ScreenSize - 1));
+        uint2 lightLinkedListPosition = ScreenSpaceToLightLinkedListSpace(screenPosition);
+        uint lightLinkIndex = g_FirstLightLink.Load(GetFirstLightLinkAddress(lightLinkedListPosition)) & NO_LIGHT_LINK;
+        while (lightLinkIndex != NO_LIGHT_LINK)
+        {
+            LightLink lightLink = g_LightLinksHeap[lightLinkIndex];
+            lightLinkIndex = lightLink.NextLightIndex();
+
+            // Skip lights outside our depth
+            if (position.w < lightLink.MinDepth() || position.w > lightLink.MaxDepth())
+            { continue; }
+
+            LightInfo light = g_Lights[lightLink.LightId()];
+            brdf.ApplyPointLight(light);
+        }
+    }
+
+    ParticleLighting result;
+    result.Diffuse = brdf.Diffuse;
+    result.Specular = brdf.Specular;
+    g_ParticleLightingOut[threadId.x] = result;
+}
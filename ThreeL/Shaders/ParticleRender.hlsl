@@ -13,6 +13,7 @@
         "SRV(t0, space = 2, offset = 0, numDescriptors = unbounded, flags = DESCRIPTORS_VOLATILE | DATA_VOLATILE)," \
         "SRV(t0, space = 3, offset = 0, numDescriptors = unbounded, flags = DESCRIPTORS_VOLATILE | DATA_VOLATILE)" \
     ")," \
+    "SRV(t2, space = 900, flags = DATA_STATIC_WHILE_SET_AT_EXECUTE, visibility = SHADER_VISIBILITY_VERTEX)," \
     ""
 
 #define PBR_IS_PARTICLE
@@ -23,6 +24,7 @@
 
 StructuredBuffer<ParticleSprite> g_Particles : register(t0, space900);
 ByteAddressBuffer g_SortedParticleLookup : register(t1, space900);
+StructuredBuffer<ParticleLighting> g_ParticleLighting : register(t2, space900);
 
 //===================================================================================================================================================
 // Vertex shader
@@ -52,5 +54,11 @@ PsInput VsMainParticle(uint vertexId : SV_VertexID, uint particleIndex : SV_Inst
 
     result.MaterialId = particle.MaterialId;
 
+#ifdef PARTICLE_LIGHTING_CACHE
+    ParticleLighting lighting = g_ParticleLighting[particleIndex];
+    result.CachedDiffuse = lighting.Diffuse;
+    result.CachedSpecular = lighting.Specular;
+#endif
+
     return result;
 }
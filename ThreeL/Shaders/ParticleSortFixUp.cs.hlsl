@@ -0,0 +1,231 @@
+// Temporally coherent particle sorting
+// When ParticleSystem uses ParticleSortMode::Temporal the update shader visits particles in the order they were sorted last frame, so the sort list
+// it emits is already nearly sorted. The shaders in this file measure how disordered the list is, repair small amounts of local disorder, and merge in
+// newly spawned particles. If anything is still out of order afterwards the fallback item count is set so that the full bitonic sort runs.
+// See TemporalParticleSort.h for a CPU implementation of the same algorithm.
+
+// Writable just to avoid transitioning the resource, not written
+RWByteAddressBuffer g_LivingParticleCount : register(u0, space900);
+
+// Sort list is uint2(index, key) pairs sorted by key in descending order (IE: back to front)
+RWByteAddressBuffer g_SortList : register(u1, space900);
+RWByteAddressBuffer g_MergeScratch : register(u2, space900);
+
+RWByteAddressBuffer g_Statistics : register(u3, space900);
+// [0] u32 Inversions in the list of survivors as emitted by the update shader
+// [4] u32 Inversions in the list of survivors after the fix-up passes
+// [8] u32 Number of particles which survived the update (IE: the living particle count before spawning)
+// [12] u32 Inversions in the final list (the full sort is used when this is non-zero)
+#define STATISTICS_INITIAL_INVERSIONS 0
+#define STATISTICS_FIXED_INVERSIONS 4
+#define STATISTICS_SURVIVOR_COUNT 8
+#define STATISTICS_FINAL_INVERSIONS 12
+
+RWByteAddressBuffer g_FixUpArguments : register(u4, space900);
+// [0] D3D12_DISPATCH_ARGUMENTS for the aligned fix-up pass
+// [12] D3D12_DISPATCH_ARGUMENTS for the offset fix-up pass
+
+RWByteAddressBuffer g_FallbackItemCount : register(u5, space900);
+
+struct ParticleSortFixUpParams
+{
+    uint ParticleCapacity;
+    uint StatisticsOffset;
+    uint WindowOffset;
+    float MaxDisorderRatio;
+};
+
+ConstantBuffer<ParticleSortFixUpParams> g_Params : register(b0, space900);
+
+#define ROOT_SIGNATURE \
+    "RootConstants(num32BitConstants = 4, b0, space = 900)," \
+    "UAV(u0, space = 900)," \
+    "UAV(u1, space = 900, flags = DATA_VOLATILE)," \
+    "UAV(u2, space = 900, flags = DATA_VOLATILE)," \
+    "UAV(u3, space = 900, flags = DATA_VOLATILE)," \
+    "UAV(u4, space = 900, flags = DATA_VOLATILE)," \
+    "UAV(u5, space = 900, flags = DATA_VOLATILE)," \
+    ""
+
+// Each fix-up group sorts a window of 2048 items in groupshared memory, which is enough to move any item up to FIXUP_PASS_COUNT / 2 places
+// Windows from a single dispatch don't overlap, so the fix-up is dispatched twice with the second dispatch offset by half a window
+#define FIXUP_GROUP_SIZE 1024
+#define FIXUP_WINDOW_SIZE (FIXUP_GROUP_SIZE * 2)
+#define FIXUP_PASS_COUNT 64
+
+groupshared uint2 gs_Window[FIXUP_WINDOW_SIZE];
+
+uint GetItemCount()
+{
+    // Particle count can be beyond capacity when spawning fails due to the system being full
+    return min(g_LivingParticleCount.Load(0), g_Params.ParticleCapacity);
+}
+
+uint2 LoadItem(uint index)
+{
+    return g_SortList.Load2(index * 8);
+}
+
+// Returns true when a is in front of b, meaning that a must come after b in a back to front list
+bool ShouldSwap(uint2 a, uint2 b)
+{
+    return a.y < b.y;
+}
+
+[numthreads(64, 1, 1)]
+[RootSignature(ROOT_SIGNATURE)]
+void MainMeasureDisorder(uint3 threadId : SV_DispatchThreadID)
+{
+    // We use the number of adjacent pairs which are out of order as our disorder estimate
+    // It's cheap to compute and it's zero if and only if the list is sorted, which is what the fallback check relies on
+    uint itemCount = GetItemCount();
+    bool isInversion = false;
+    if (threadId.x + 1 < itemCount)
+    { isInversion = ShouldSwap(LoadItem(threadId.x), LoadItem(threadId.x + 1)); }
+
+    uint inversionCount = WaveActiveCountBits(isInversion);
+
+    [branch]
+    if (WaveIsFirstLane() && inversionCount > 0)
+    { g_Statistics.InterlockedAdd(g_Params.StatisticsOffset, inversionCount); }
+}
+
+[numthreads(1, 1, 1)]
+[RootSignature(ROOT_SIGNATURE)]
+void MainPrepareFixUp()
+{
+    // This runs before spawning, so the item count is the number of survivors
+    uint itemCount = GetItemCount();
+    g_Statistics.Store(STATISTICS_SURVIVOR_COUNT, itemCount);
+
+    // Skip the fix-up when the list is already sorted or when it's so disordered that the fix-up is unlikely to succeed
+    // (In the latter case the final disorder check will send us down the full sort path.)
+    uint inversionCount = g_Statistics.Load(STATISTICS_INITIAL_INVERSIONS);
+    bool shouldFixUp = inversionCount > 0 && (float)inversionCount <= (float)itemCount * g_Params.MaxDisorderRatio;
+
+    uint alignedGroupCount = shouldFixUp ? (itemCount + FIXUP_WINDOW_SIZE - 1) / FIXUP_WINDOW_SIZE : 0;
+    g_FixUpArguments.Store3(0, uint3(alignedGroupCount, 1, 1));
+
+    // The offset pass is only necessary when there's more than a single window's worth of items
+    uint offsetGroupCount = shouldFixUp && itemCount > FIXUP_WINDOW_SIZE ? (itemCount + FIXUP_WINDOW_SIZE / 2 + FIXUP_WINDOW_SIZE - 1) / FIXUP_WINDOW_SIZE : 0;
+    g_FixUpArguments.Store3(12, uint3(offsetGroupCount, 1, 1));
+}
+
+[numthreads(FIXUP_GROUP_SIZE, 1, 1)]
+[RootSignature(ROOT_SIGNATURE)]
+void MainFixUp(uint3 groupId : SV_GroupID, uint3 groupThreadId : SV_GroupThreadID)
+{
+    uint itemCount = GetItemCount();
+    int windowStart = (int)(groupId.x * FIXUP_WINDOW_SIZE) - (int)g_Params.WindowOffset;
+
+    // Determine the portion of the window which covers the sort list
+    uint validStart = (uint)max(-windowStart, 0);
+    uint validEnd = (uint)clamp((int)itemCount - windowStart, 0, FIXUP_WINDOW_SIZE);
+
+    // Load the window into groupshared memory
+    for (uint i = groupThreadId.x; i < FIXUP_WINDOW_SIZE; i += FIXUP_GROUP_SIZE)
+    {
+        if (i >= validStart && i < validEnd)
+        { gs_Window[i] = LoadItem(windowStart + (int)i); }
+    }
+
+    GroupMemoryBarrierWithGroupSync();
+
+    // Odd-even transposition sort, bounded to a fixed number of passes
+    // Each pass can move an item by one place, so this repairs any item which was displaced by less than FIXUP_PASS_COUNT / 2 places
+    for (uint pass = 0; pass < FIXUP_PASS_COUNT; pass++)
+    {
+        uint a = groupThreadId.x * 2 + (pass & 1);
+        uint b = a + 1;
+
+        if (a >= validStart && b < validEnd)
+        {
+            uint2 itemA = gs_Window[a];
+            uint2 itemB = gs_Window[b];
+            if (ShouldSwap(itemA, itemB))
+            {
+                gs_Window[a] = itemB;
+                gs_Window[b] = itemA;
+            }
+        }
+
+        GroupMemoryBarrierWithGroupSync();
+    }
+
+    // Write the window back out
+    for (uint j = groupThreadId.x; j < FIXUP_WINDOW_SIZE; j += FIXUP_GROUP_SIZE)
+    {
+        if (j >= validStart && j < validEnd)
+        { g_SortList.Store2((windowStart + (int)j) * 8, gs_Window[j]); }
+    }
+}
+
+[numthreads(64, 1, 1)]
+[RootSignature(ROOT_SIGNATURE)]
+void MainMergeSpawned(uint3 threadId : SV_DispatchThreadID)
+{
+    // At this point the sort list is the list of survivors followed by the newly spawned particles
+    // Each item computes its position in the merged list and scatters itself into the scratch buffer
+    // (The spawned portion is expected to be small, ParticleSystem won't run this pass if too many particles were spawned this frame.)
+    uint itemCount = GetItemCount();
+    uint survivorCount = min(g_Statistics.Load(STATISTICS_SURVIVOR_COUNT), itemCount);
+    uint index = threadId.x;
+
+    if (index >= itemCount)
+    { return; }
+
+    uint2 item = LoadItem(index);
+    uint outputIndex = index;
+
+    // The merge relies on the survivors being sorted, if the fix-up failed to sort them we just copy the list as-is and let the full sort handle it
+    [branch]
+    if (g_Statistics.Load(STATISTICS_FIXED_INVERSIONS) == 0)
+    {
+        if (index < survivorCount)
+        {
+            // Survivors are pushed back by every spawned particle which sorts before them
+            // (Ties are resolved in favor of the survivors.)
+            for (uint i = survivorCount; i < itemCount; i++)
+            {
+                if (ShouldSwap(item, LoadItem(i)))
+                { outputIndex++; }
+            }
+        }
+        else
+        {
+            // Binary search for the first survivor which should come after this particle
+            uint low = 0;
+            uint high = survivorCount;
+            while (low < high)
+            {
+                uint middle = (low + high) / 2;
+                if (ShouldSwap(LoadItem(middle), item))
+                { high = middle; }
+                else
+                { low = middle + 1; }
+            }
+
+            // Spawned particles are pushed back by every other spawned particle which sorts before them
+            // (Ties are resolved by the spawned particles' original order.)
+            outputIndex = low;
+            for (uint i = survivorCount; i < itemCount; i++)
+            {
+                uint2 other = LoadItem(i);
+                if (ShouldSwap(item, other) || (other.y == item.y && i < index))
+                { outputIndex++; }
+            }
+        }
+    }
+
+    g_MergeScratch.Store2(outputIndex * 8, item);
+}
+
+[numthreads(1, 1, 1)]
+[RootSignature(ROOT_SIGNATURE)]
+void MainPrepareFallback()
+{
+    // If the list isn't sorted by now we ask the bitonic sort to sort the whole thing, otherwise we ask it to sort nothing
+    uint itemCount = GetItemCount();
+    bool needsFullSort = g_Statistics.Load(STATISTICS_FINAL_INVERSIONS) > 0;
+    g_FallbackItemCount.Store(0, needsFullSort ? itemCount : 0);
+}
@@ -4,6 +4,7 @@
 
 StructuredBuffer<ParticleState> g_ParticleStatesIn : register(t0, space900);
 ByteAddressBuffer g_LivingParticleCount : register(t1, space900);
+ByteAddressBuffer g_PreviousParticleSpriteSortBuffer : register(t2, space900); // The sort list from the frame which produced g_ParticleStatesIn
 
 RWStructuredBuffer<ParticleState> g_ParticleStatesOut : register(u0, space900);
 RWStructuredBuffer<ParticleSprite> g_ParticleSpritesOut : register(u1, space900);
@@ -12,6 +13,16 @@ RWByteAddressBuffer g_LivingParticleCountOut : register(u2, space900);
 RWByteAddressBuffer g_DrawIndirectArguments : register(u3, space900);
 RWByteAddressBuffer g_ParticleSpriteSortBuffer : register(u4, space900);
 
+RWByteAddressBuffer g_DispatchIndirectArguments : register(u5, space900);
+// [0] D3D12_DISPATCH_ARGUMENTS for MainUpdate
+// [12] D3D12_DISPATCH_ARGUMENTS for MainSpawn
+// [24] D3D12_DISPATCH_ARGUMENTS for MainComputeLighting in ParticleLighting.cs.hlsl
+// [36] ParticleDispatchStatistics
+#define DISPATCH_ARGUMENTS_UPDATE 0
+#define DISPATCH_ARGUMENTS_SPAWN 12
+#define DISPATCH_ARGUMENTS_LIGHTING 24
+#define DISPATCH_STATISTICS 36
+
 struct ParticleSystemParams
 {
     uint ParticleCapacity;
@@ -54,11 +65,63 @@ ConstantBuffer<ParticleSystemParams> g_Params : register(b0, space900);
     "UAV(u2, space = 900, flags = DATA_VOLATILE)," \
     "UAV(u3, space = 900, flags = DATA_VOLATILE)," \
     "UAV(u4, space = 900, flags = DATA_VOLATILE)," \
+    "SRV(t2, space = 900, flags = DATA_STATIC_WHILE_SET_AT_EXECUTE)," \
+    "UAV(u5, space = 900, flags = DATA_VOLATILE)," \
     ""
 
+#define UPDATE_GROUP_SIZE 64
+#define SPAWN_GROUP_SIZE 64
+#define LIGHTING_GROUP_SIZE 64
+
 void OutputParticle(uint outputIndex, ParticleState state);
 
-[numthreads(64, 1, 1)]
+#ifdef PARTICLE_TEMPORAL_SORT
+// Allocates output slots such that living particles retain their relative order within a wave
+// Waves are not guaranteed to allocate in order, but in practice they're close enough for the sort fix-up to handle (see ParticleSortFixUp.cs.hlsl)
+uint AllocateOrderedOutputIndex(bool isAlive)
+{
+    uint aliveCount = WaveActiveCountBits(isAlive);
+    uint waveOutputIndex = 0;
+
+    [branch]
+    if (WaveIsFirstLane())
+    { g_LivingParticleCountOut.InterlockedAdd(0, aliveCount, waveOutputIndex); }
+
+    return WaveReadLaneFirst(waveOutputIndex) + WavePrefixCountBits(isAlive);
+}
+#endif
+
+// Dispatch argument computation, see ParticleDispatchArguments.h for the CPU equivalent
+[numthreads(1, 1, 1)]
+[RootSignature(ROOT_SIGNATURE)]
+void MainPrepareUpdateIndirect()
+{
+    // Living particle count can be beyond capacity when spawning fails due to the system being full
+    uint livingParticleCount = min(g_LivingParticleCount.Load(0), g_Params.ParticleCapacity);
+    uint groupCount = (livingParticleCount + UPDATE_GROUP_SIZE - 1) / UPDATE_GROUP_SIZE;
+    g_DispatchIndirectArguments.Store3(DISPATCH_ARGUMENTS_UPDATE, uint3(groupCount, 1, 1));
+
+    // Spawn arguments are only prepared when there's something to spawn, so we default them to nothing here
+    g_DispatchIndirectArguments.Store3(DISPATCH_ARGUMENTS_SPAWN, uint3(0, 1, 1));
+
+    // Dispatched threads, useful threads for both update and spawn
+    g_DispatchIndirectArguments.Store4(DISPATCH_STATISTICS, uint4(groupCount * UPDATE_GROUP_SIZE, livingParticleCount, 0, 0));
+}
+
+[numthreads(1, 1, 1)]
+[RootSignature(ROOT_SIGNATURE)]
+void MainPrepareSpawnIndirect()
+{
+    // This runs after updating, so the output count is the number of particles which survived
+    // Only spawn as many particles as will actually fit in the system
+    uint survivorCount = min(g_LivingParticleCountOut.Load(0), g_Params.ParticleCapacity);
+    uint toSpawn = min(g_Params.ToSpawnThisFrame, g_Params.ParticleCapacity - survivorCount);
+    uint groupCount = (toSpawn + SPAWN_GROUP_SIZE - 1) / SPAWN_GROUP_SIZE;
+    g_DispatchIndirectArguments.Store3(DISPATCH_ARGUMENTS_SPAWN, uint3(groupCount, 1, 1));
+    g_DispatchIndirectArguments.Store2(DISPATCH_STATISTICS + 8, uint2(groupCount * SPAWN_GROUP_SIZE, toSpawn));
+}
+
+[numthreads(SPAWN_GROUP_SIZE, 1, 1)]
 [RootSignature(ROOT_SIGNATURE)]
 void MainSpawn(uint3 threadId : SV_DispatchThreadID)
 {
@@ -94,22 +157,34 @@ void MainSpawn(uint3 threadId : SV_DispatchThreadID)
     OutputParticle(outputIndex, state);
 }
 
-[numthreads(64, 1, 1)]
+[numthreads(UPDATE_GROUP_SIZE, 1, 1)]
 [RootSignature(ROOT_SIGNATURE)]
 void MainUpdate(uint3 threadId : SV_DispatchThreadID)
 {
-    uint inputIndex = threadId.x;
     uint livingParticleCount = g_LivingParticleCount.Load(0);
 
-    if (inputIndex >= g_Params.ParticleCapacity || inputIndex >= livingParticleCount)
+    if (threadId.x >= g_Params.ParticleCapacity || threadId.x >= livingParticleCount)
     { return; }
 
+#ifdef PARTICLE_TEMPORAL_SORT
+    // Visit particles in the order they were sorted last frame so that the sort list we emit is nearly sorted already
+    uint inputIndex = g_PreviousParticleSpriteSortBuffer.Load(threadId.x * 8);
+#else
+    uint inputIndex = threadId.x;
+#endif
+
     float deltaTime = g_PerFrame.DeltaTime;
     ParticleState state = g_ParticleStatesIn[inputIndex];
     state.LifeTimer -= deltaTime;
+    bool isAlive = state.LifeTimer > 0.f;
+
+#ifdef PARTICLE_TEMPORAL_SORT
+    // This must happen before dead particles exit so that they participate in the wave-wide allocation
+    uint outputIndex = AllocateOrderedOutputIndex(isAlive);
+#endif
 
     // If the particle died there's nothing left to do
-    if (state.LifeTimer <= 0.f)
+    if (!isAlive)
     { return; }
 
     // Update the particle
@@ -127,7 +202,9 @@ void MainUpdate(uint3 threadId : SV_DispatchThreadID)
 
     // Write the particle out
     // No need to check if outputIndex is in-bounds since we know we're only processing up to the capacity from the input
+#ifndef PARTICLE_TEMPORAL_SORT
     uint outputIndex = g_ParticleStatesOut.IncrementCounter();
+#endif
     OutputParticle(outputIndex, state);
 }
 
@@ -161,4 +238,8 @@ void MainPrepareDrawIndirect()
         1 // StartInstanceLocation
     );
     g_DrawIndirectArguments.Store4(0, arguments);
+
+    // Lighting is evaluated once for every particle which will be drawn
+    uint lightingGroupCount = (particleCount + LIGHTING_GROUP_SIZE - 1) / LIGHTING_GROUP_SIZE;
+    g_DispatchIndirectArguments.Store3(DISPATCH_ARGUMENTS_LIGHTING, uint3(lightingGroupCount, 1, 1));
 }
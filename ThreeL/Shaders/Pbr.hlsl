@@ -7,6 +7,7 @@
 struct VsInput
 {
     uint VertexId : SV_VertexID;
+    uint InstanceId : SV_InstanceID;
     float3 Position : POSITION;
     float3 Normal : NORMAL;
     float2 Uv0 : TEXCOORD0;
@@ -18,7 +19,7 @@ struct VsInput
             return 0.f.xxxx;
 
         float4 tangent = g_Buffers[g_PerNode.TangentsIndex].Load<float4>(VertexId * sizeof(float4));
-        return float4(normalize(mul(tangent.xyz, g_PerNode.NormalTransform)), tangent.w);
+        return float4(normalize(mul(tangent.xyz, NodeNormalTransform(InstanceId))), tangent.w);
     }
 
     float4 Color()
@@ -42,6 +43,10 @@ struct PsInput
 #ifdef PBR_IS_PARTICLE // Material comes from vertex shader for particles since they're instanced (see ParticleRender.hlsl)
     uint MaterialId : MATERIALID;
 #endif
+#ifdef PARTICLE_LIGHTING_CACHE // Lighting is evaluated once per particle (see ParticleLighting.cs.hlsl)
+    nointerpolation float3 CachedDiffuse : CACHEDDIFFUSE;
+    nointerpolation float3 CachedSpecular : CACHEDSPECULAR;
+#endif
 };
 
 //===================================================================================================================================================
@@ -54,11 +59,11 @@ PsInput VsMain(VsInput input)
     PsInput result;
 
     result.Position = float4(input.Position, 1.f);
-    result.Position = mul(result.Position, g_PerNode.Transform);
+    result.Position = mul(result.Position, NodeTransform(input.InstanceId));
     result.WorldPosition = result.Position.xyz;
     result.Position = mul(result.Position, g_PerFrame.ViewProjectionTransform);
 
-    result.Normal = normalize(mul(input.Normal, g_PerNode.NormalTransform));
+    result.Normal = normalize(mul(input.Normal, NodeNormalTransform(input.InstanceId)));
     result.Tangent = input.TangentWorld();
 
     result.Color = input.Color();
@@ -72,141 +77,7 @@ PsInput VsMain(VsInput input)
 // Pixel shader
 //===================================================================================================================================================
 
-float clampedDot(float3 a, float3 b)
-{
-    return clamp(dot(a, b), 0.f, 1.f);
-}
-
-// The BRDF implementation here is based on the techniques recommended by the glTF specificaiton
-// https://registry.khronos.org/glTF/specs/2.0/glTF-2.0.html#appendix-b-brdf-implementation
-// (Note that the math will not match 1:1 until you reach the simplifications described in the final section.)
-struct Brdf
-{
-    // Surface-dependent fields
-    float3 BaseColor;
-    float RoughnessAlpha;
-    float3 WorldPosition;
-    float3 Normal; // N
-    float3 ViewDirection; // V
-    float NdotV;
-    float3 DiffuseColor;
-    float3 F0;
-    float3 F90;
-
-    // Outputs
-    float3 Diffuse;
-    float3 Specular;
-
-    // Light-dependent temporaries
-    float3 SurfaceToLight; // L
-    float3 HalfVector; // H
-    float NdotL;
-    float NdotH;
-    float VdotH;
-
-    float3 Frensel_Schlick()
-    {
-        float vhPart = 1.f - VdotH;
-        float vh2 = vhPart * vhPart;
-        float vh5 = vh2 * vh2 * vhPart;
-
-        return F0 + (F90 - F0) * vh5;
-    }
-
-    float3 DiffuseBrdf_Lambertian()
-    {
-        return DiffuseColor / Math::Pi;
-    }
-
-    // Specular BRDF using GGX microfacet distribution
-    // https://registry.khronos.org/glTF/specs/2.0/glTF-2.0.html#specular-brdf
-    float SpecularBrdf_GGX()
-    {
-        float alphaSquared = RoughnessAlpha * RoughnessAlpha;
-
-        // Calculate visibility function
-        // Using the derived simplificaiton described here:
-        // https://google.github.io/filament/Filament.md.html#materialsystem/specularbrdf/geometricshadowing(specularg)
-        float visibility;
-        {
-            visibility = NdotL * sqrt(NdotV * NdotV * (1.f - alphaSquared) + alphaSquared);
-            visibility += NdotV * sqrt(NdotL * NdotL * (1.f - alphaSquared) + alphaSquared);
-            visibility = visibility > 0.f ? 0.5f / visibility : 0.f;
-        }
-
-        // Calculate Trowbridge-Reitz microfacet distribution
-        float distribution;
-        {
-            distribution = NdotH * NdotH * (alphaSquared - 1.f) + 1.f;
-            distribution = alphaSquared / (Math::Pi * distribution * distribution);
-        }
-
-        return visibility * distribution;
-    }
-
-    void ApplyLight(float3 surfaceToLight, float3 lightColor, float lightIntensity)
-    {
-        SurfaceToLight = surfaceToLight;
-        HalfVector = normalize(SurfaceToLight + ViewDirection);
-        NdotL = dot(Normal, SurfaceToLight);
-
-#ifdef PBR_IS_PARTICLE
-        // For particles only we do an extreme approximation of light scattering within the particle
-        // Right now we don't incorporate a BTDF (IE: transmission of light through objects isn't simulated) so we have to pretend light shines through
-        // Additionally from a math perspective our particles are flat quads, but from a visual perspective they're 3D clouds of smoke so we need to simulate that
-        // Doing this isn't physically accurate, but it's good enough to make our particles lit in a way that makes sense
-        if (NdotL < 0.f)
-        { Normal = -Normal; }
-        NdotL = 1.f;
-#endif
-
-        NdotH = clampedDot(Normal, HalfVector);
-        VdotH = clampedDot(ViewDirection, HalfVector);
-
-#ifndef PBR_IS_PARTICLE
-        // Surface is not hit by the light
-        if (NdotL <= 0.f)
-        { return; }
-#endif
-
-        float3 frensel = Frensel_Schlick();
-        Diffuse += lightIntensity * lightColor * NdotL * (1.f.xxx - frensel) * DiffuseBrdf_Lambertian();
-        Specular += lightIntensity * lightColor * NdotL * frensel * SpecularBrdf_GGX();
-    }
-
-    void ApplyDirectionalLight(float3 lightDirection, float3 lightColor, float lightIntensity)
-    {
-        ApplyLight(-lightDirection, lightColor, lightIntensity);
-    }
-
-    void ApplyPointLight(LightInfo light)
-    {
-        float3 surfaceToLight = light.Position - WorldPosition;
-
-        // Calculate attenuation based on the KHR_lights_punctual spec with minimum bounds on denominator to avoid explosion at light center
-        // https://github.com/KhronosGroup/glTF/blob/main/extensions/2.0/Khronos/KHR_lights_punctual/README.md#range-property
-        float distanceSquared = dot(surfaceToLight, surfaceToLight);
-        float rangeSquared = light.Range * light.Range;
-        float distanceOverRange = distanceSquared / rangeSquared; // pow2
-        distanceOverRange *= distanceOverRange; // pow4
-        float lightAttenuation = saturate(1.f - distanceOverRange) / max(distanceSquared, 0.0001);
-
-        // When this is enabled it's easier to see the boundaries of light spheres, which are normally pretty hard to see since the light
-        // attenuation is approaching zero at that point. Basically this shows dim solid light for areas covered by the light linked list
-        // and bright in areas actually covered by the light. It also indirectly shows light checks lost due to depth errors.
-        // In other words, this shows that RangeExtension in LightLinkedListFill.hlsl is being calculated correctly.
-#ifdef DEBUG_LIGHT_BOUNDARIES
-        lightAttenuation = distanceSquared < rangeSquared ? 1.f : 0.25f;
-        Diffuse += light.Color * lightAttenuation;
-#else
-        // Surface is outside the range of the light
-        if (lightAttenuation <= 0.f)
-        { return; }
-
-        ApplyLight(surfaceToLight, light.Color, light.Intensity * lightAttenuation);
-#endif
-    }
-};
+#include "PbrBrdf.hlsli"
 
 float4 SampleBindlessTexture(uint textureIndex, uint samplerIndex, float2 uv)
 {
@@ -231,10 +102,11 @@ float4 PsMain(PsInput input, bool isFrontFace: SV_IsFrontFace) : SV_Target
 #endif
 
     // Get base color
-    float4 baseColor = input.Color * material.BaseColorFactor;
-
+    float4 baseColorTexture = 1.f.xxxx;
     if (material.BaseColorTexture != DISABLED_BUFFER)
-    { baseColor *= SampleBindlessTexture(material.BaseColorTexture, material.BaseColorTextureSampler, input.Uv0); }
+    { baseColorTexture = SampleBindlessTexture(material.BaseColorTexture, material.BaseColorTextureSampler, input.Uv0); }
+
+    float4 baseColor = input.Color * material.BaseColorFactor * baseColorTexture;
 
     // Only base color affects alpha so alpha cutoff can be applied at this point
     if (baseColor.a < material.AlphaCutoff)
@@ -287,23 +159,16 @@ float4 PsMain(PsInput input, bool isFrontFace: SV_IsFrontFace) : SV_Target
     // PBR calculations
     //=================================================================================================================
 
-    Brdf brdf;
-    brdf.BaseColor = baseColor.rgb;
-    brdf.RoughnessAlpha = roughness * roughness;
-    brdf.WorldPosition = input.WorldPosition;
-    brdf.Normal = normal;
-    brdf.ViewDirection = normalize(g_PerFrame.EyePosition - brdf.WorldPosition);
-    brdf.NdotV = clampedDot(brdf.Normal, brdf.ViewDirection);
-    brdf.DiffuseColor = lerp(brdf.BaseColor, 0.f.xxx, metalness);
-    brdf.F0 = lerp(0.04.xxx, brdf.BaseColor, metalness);
-    brdf.F90 = 1.f.xxx;
-
-    brdf.Diffuse = 0.f.xxx;
-    brdf.Specular = 0.f.xxx;
+#ifdef PARTICLE_LIGHTING_CACHE
+    // Lighting was evaluated once per particle by ParticleLighting.cs.hlsl, all that's left is to apply the textured portion of the base color
+    // (Note that this means normal maps and metal/roughness textures are ignored.)
+    float4 result = float4(emissive + input.CachedDiffuse * baseColorTexture.rgb + input.CachedSpecular, baseColor.a);
+    return result;
+#else
+    Brdf brdf = MakeBrdf(baseColor.rgb, metalness, roughness, input.WorldPosition, normal);
 
     // Apply static direction lights
-    brdf.ApplyDirectionalLight(normalize(float3(-0.5f, -0.707f, -0.5f)), float3(1.f, 1.f, 1.f), 0.2f);
-    brdf.ApplyDirectionalLight(normalize(float3(0.5f, 0.707f, 0.5f)), float3(1.f, 1.f, 1.f), 0.2f * 0.4f);
+    brdf.ApplySceneDirectionalLights();
 
     // Apply point lights from light linked list
     uint2 lightLinkedListPosition = ScreenSpaceToLightLinkedListSpace((uint2)input.Position.xy);
@@ -324,4 +189,5 @@ float4 PsMain(PsInput input, bool isFrontFace: SV_IsFrontFace) : SV_Target
     // Compute final result
     float4 result = float4(emissive + brdf.Diffuse + brdf.Specular, baseColor.a);
     return result;
+#endif
 }
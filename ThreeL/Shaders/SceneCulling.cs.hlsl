@@ -0,0 +1,147 @@
+// GPU-driven scene culling
+// Frustum culls the draw records built by IndirectDrawArguments and compacts the visible ones so that IndirectDrawList can draw each pipeline state
+// bucket with a single ExecuteIndirect. Compacted records keep their bucket's base offset, so each bucket only needs its own draw count.
+// Visible records also have their indices replaced by the coarsest acceptable LOD's as they're compacted.
+#include "Common.hlsli"
+
+struct IndirectDrawCullingInfo
+{
+    float3 BoundsCenter;
+    uint BucketIndex;
+    float3 BoundsExtents;
+    uint BucketFirst;
+    uint FirstLod;
+    uint LodCount;
+};
+
+struct IndirectDrawLod
+{
+    uint2 IndicesBufferLocation;
+    uint IndicesSizeInBytes;
+    uint IndicesFormat;
+    uint IndexCount;
+    float Error;
+};
+
+// Records are ShaderInterop::IndirectDrawRecord, but we only ever copy them (and patch their indices) so they're treated as opaque blobs
+#define RECORD_SIZE 208
+#define RECORD_INDICES_OFFSET 48
+#define RECORD_INDEX_COUNT_OFFSET 188
+
+ByteAddressBuffer g_Records : register(t0, space900);
+StructuredBuffer<IndirectDrawCullingInfo> g_CullingInfo : register(t1, space900);
+StructuredBuffer<IndirectDrawLod> g_Lods : register(t2, space900);
+
+RWByteAddressBuffer g_CulledRecords : register(u0, space900);
+RWByteAddressBuffer g_BucketCounts : register(u1, space900);
+
+struct SceneCullingParams
+{
+    uint DrawCount;
+    uint BucketCount;
+    float PixelsPerUnit;
+    float MaxPixelError;
+};
+
+ConstantBuffer<SceneCullingParams> g_Params : register(b0, space900);
+
+#define ROOT_SIGNATURE \
+    "RootConstants(num32BitConstants = 4, b0, space = 900)," \
+    "CBV(b1)," \
+    "SRV(t0, space = 900, flags = DATA_STATIC)," \
+    "SRV(t1, space = 900, flags = DATA_STATIC)," \
+    "SRV(t2, space = 900, flags = DATA_STATIC)," \
+    "UAV(u0, space = 900, flags = DATA_VOLATILE)," \
+    "UAV(u1, space = 900, flags = DATA_VOLATILE)," \
+    ""
+
+[numthreads(64, 1, 1)]
+[RootSignature(ROOT_SIGNATURE)]
+void MainClearCounts(uint3 threadId : SV_DispatchThreadID)
+{
+    if (threadId.x < g_Params.BucketCount)
+    { g_BucketCounts.Store(threadId.x * 4, 0); }
+}
+
+bool IsVisible(float3 center, float3 extents)
+{
+    // Frustum planes are extracted from the columns of the view projection matrix
+    // We use reverse Z with an infinite far plane, so there's no far plane to test against
+    float4x4 m = g_PerFrame.ViewProjectionTransform;
+    float4 column0 = float4(m[0].x, m[1].x, m[2].x, m[3].x);
+    float4 column1 = float4(m[0].y, m[1].y, m[2].y, m[3].y);
+    float4 column2 = float4(m[0].z, m[1].z, m[2].z, m[3].z);
+    float4 column3 = float4(m[0].w, m[1].w, m[2].w, m[3].w);
+
+    float4 planes[5] =
+    {
+        column3 + column0, // Left
+        column3 - column0, // Right
+        column3 + column1, // Bottom
+        column3 - column1, // Top
+        column3 - column2, // Near
+    };
+
+    [unroll]
+    for (uint i = 0; i < 5; i++)
+    {
+        // The box is outside when its closest corner is behind the plane
+        float distance = dot(planes[i].xyz, center) + planes[i].w;
+        float radius = dot(extents, abs(planes[i].xyz));
+        if (distance + radius < 0.f)
+        { return false; }
+    }
+
+    return true;
+}
+
+// Picks the coarsest LOD whose error projects to no more than MaxPixelError pixels, this must match DrawList::SelectLods
+uint SelectLod(IndirectDrawCullingInfo info)
+{
+    if (g_Params.MaxPixelError <= 0.f)
+    { return 0; }
+
+    // Distance is measured to the nearest point of the bounds so that the camera can never be closer to the primitive than we think
+    float3 offset = max(abs(g_PerFrame.EyePosition - info.BoundsCenter) - info.BoundsExtents, 0.f);
+    float distance = length(offset);
+
+    // Errors grow with each LOD, so the first acceptable one from the coarsest end is the coarsest acceptable one
+    for (uint i = info.LodCount; i > 0; i--)
+    {
+        if (g_Lods[info.FirstLod + i - 1].Error * g_Params.PixelsPerUnit <= g_Params.MaxPixelError * distance)
+        { return i; }
+    }
+
+    return 0;
+}
+
+[numthreads(64, 1, 1)]
+[RootSignature(ROOT_SIGNATURE)]
+void MainCull(uint3 threadId : SV_DispatchThreadID)
+{
+    uint drawIndex = threadId.x;
+    if (drawIndex >= g_Params.DrawCount)
+    { return; }
+
+    IndirectDrawCullingInfo info = g_CullingInfo[drawIndex];
+    if (!IsVisible(info.BoundsCenter, info.BoundsExtents))
+    { return; }
+
+    //PERF: Draws within a wave usually share a bucket, so these atomics could be aggregated per-wave
+    uint slot;
+    g_BucketCounts.InterlockedAdd(info.BucketIndex * 4, 1, slot);
+
+    uint source = drawIndex * RECORD_SIZE;
+    uint destination = (info.BucketFirst + slot) * RECORD_SIZE;
+    for (uint offset = 0; offset < RECORD_SIZE; offset += 16)
+    { g_CulledRecords.Store4(destination + offset, g_Records.Load4(source + offset)); }
+
+    // LODs share the vertex buffers of the full detail geometry, so only the index buffer view and index count change
+    uint lod = SelectLod(info);
+    if (lod > 0)
+    {
+        IndirectDrawLod meshLod = g_Lods[info.FirstLod + lod - 1];
+        g_CulledRecords.Store4(destination + RECORD_INDICES_OFFSET, uint4(meshLod.IndicesBufferLocation, meshLod.IndicesSizeInBytes, meshLod.IndicesFormat));
+        g_CulledRecords.Store(destination + RECORD_INDEX_COUNT_OFFSET, meshLod.IndexCount);
+    }
+}
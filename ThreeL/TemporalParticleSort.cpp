@@ -0,0 +1,128 @@
+#include "pch.h"
+#include "TemporalParticleSort.h"
+
+#include <algorithm>
+
+namespace TemporalParticleSort
+{
+    // Returns true when a is in front of b, meaning that a must come after b in a back to front list
+    static inline bool ShouldSwap(uint2 a, uint2 b)
+    {
+        return a.y < b.y;
+    }
+
+    uint32_t CountInversions(std::span<const uint2> items)
+    {
+        uint32_t inversionCount = 0;
+        for (size_t i = 1; i < items.size(); i++)
+        {
+            if (ShouldSwap(items[i - 1], items[i]))
+            { inversionCount++; }
+        }
+
+        return inversionCount;
+    }
+
+    static void FixUpWindows(std::span<uint2> items, uint32_t windowSize, uint32_t windowOffset, uint32_t passCount)
+    {
+        int64_t itemCount = (int64_t)items.size();
+        for (int64_t windowStart = -(int64_t)windowOffset; windowStart < itemCount; windowStart += windowSize)
+        {
+            int64_t validStart = std::max<int64_t>(windowStart, 0);
+            int64_t validEnd = std::min<int64_t>(windowStart + windowSize, itemCount);
+
+            for (uint32_t pass = 0; pass < passCount; pass++)
+            {
+                for (int64_t a = windowStart + (pass & 1); a + 1 < windowStart + windowSize; a += 2)
+                {
+                    int64_t b = a + 1;
+                    if (a >= validStart && b < validEnd && ShouldSwap(items[a], items[b]))
+                    { std::swap(items[a], items[b]); }
+                }
+            }
+        }
+    }
+
+    void FixUp(std::span<uint2> items, uint32_t windowSize, uint32_t passCount)
+    {
+        Assert(windowSize > 0 && windowSize % 2 == 0);
+        FixUpWindows(items, windowSize, 0, passCount);
+
+        if (items.size() > windowSize)
+        { FixUpWindows(items, windowSize, windowSize / 2, passCount); }
+    }
+
+    void MergeSpawned(std::span<const uint2> items, uint32_t survivorCount, std::span<uint2> output)
+    {
+        Assert(output.size() >= items.size());
+        Assert(survivorCount <= items.size());
+        std::span<const uint2> survivors = items.subspan(0, survivorCount);
+        std::span<const uint2> spawned = items.subspan(survivorCount);
+
+        for (uint32_t index = 0; index < items.size(); index++)
+        {
+            uint2 item = items[index];
+            size_t outputIndex;
+
+            if (index < survivorCount)
+            {
+                // Survivors are pushed back by every spawned particle which sorts before them (ties are resolved in favor of the survivors)
+                outputIndex = index;
+                for (uint2 other : spawned)
+                {
+                    if (ShouldSwap(item, other))
+                    { outputIndex++; }
+                }
+            }
+            else
+            {
+                // Find the first survivor which should come after this particle
+                auto firstAfter = std::partition_point(survivors.begin(), survivors.end(), [&](uint2 survivor) { return !ShouldSwap(survivor, item); });
+                outputIndex = firstAfter - survivors.begin();
+
+                // Spawned particles are pushed back by every other spawned particle which sorts before them (ties are resolved by their original order)
+                for (uint32_t i = survivorCount; i < items.size(); i++)
+                {
+                    if (ShouldSwap(item, items[i]) || (items[i].y == item.y && i < index))
+                    { outputIndex++; }
+                }
+            }
+
+            output[outputIndex] = item;
+        }
+    }
+
+    SortPath Sort(std::span<uint2> items, uint32_t survivorCount, float maxDisorderRatio, uint32_t maxSpawnedToMerge)
+    {
+        Assert(survivorCount <= items.size());
+        std::span<uint2> survivors = items.subspan(0, survivorCount);
+        uint32_t spawnedCount = (uint32_t)items.size() - survivorCount;
+
+        // Repair local disorder in the survivors
+        uint32_t initialInversions = CountInversions(survivors);
+        bool didWork = false;
+        if (initialInversions > 0 && (float)initialInversions <= (float)survivorCount * maxDisorderRatio)
+        {
+            FixUp(survivors);
+            didWork = true;
+        }
+
+        // Merge in the spawned particles, this relies on the survivors being sorted
+        if (spawnedCount > 0 && spawnedCount <= maxSpawnedToMerge && CountInversions(survivors) == 0)
+        {
+            std::vector<uint2> merged(items.size());
+            MergeSpawned(items, survivorCount, merged);
+            std::copy(merged.begin(), merged.end(), items.begin());
+            didWork = true;
+        }
+
+        // Fall back to a full sort if anything is still out of order
+        if (CountInversions(items) > 0)
+        {
+            std::stable_sort(items.begin(), items.end(), [](uint2 a, uint2 b) { return a.y > b.y; });
+            return SortPath::FullSort;
+        }
+
+        return didWork ? SortPath::FixedUp : SortPath::AlreadySorted;
+    }
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include "ShaderInterop.h"
+#include "Vector2.h"
+
+#include <span>
+
+//! CPU implementation of the temporally coherent particle sort used by ParticleSortMode::Temporal (see ParticleSortFixUp.cs.hlsl)
+//! Items are index/key pairs with the index in X and the sort key in Y, sorted by key in descending order to match the GPU sort list.
+//! Each function here mirrors one of the GPU passes so that the algorithm can be reasoned about (and debugged) away from the GPU.
+namespace TemporalParticleSort
+{
+    enum class SortPath
+    {
+        //! The list was already sorted, no work was done
+        AlreadySorted,
+        //! The list was sorted by the bounded fix-up and merging in the spawned items
+        FixedUp,
+        //! The fix-up was skipped or was unable to sort the list, so the full sort was used
+        FullSort,
+    };
+
+    //! Returns the number of adjacent pairs in the list which are out of order
+    //! This is the disorder estimate used to decide whether the fix-up is worth attempting, it is zero if and only if the list is sorted.
+    uint32_t CountInversions(std::span<const uint2> items);
+
+    //! Performs a bounded odd-even transposition sort on the list in windows of the specified size
+    //! Matches the aligned and offset dispatches of MainFixUp
+    void FixUp
+    (
+        std::span<uint2> items,
+        uint32_t windowSize = ShaderInterop::ParticleSortFixUp::FixUpWindowSize,
+        uint32_t passCount = ShaderInterop::ParticleSortFixUp::FixUpPassCount
+    );
+
+    //! Merges the items following the first survivorCount items (IE: the newly spawned particles) into the survivors
+    //! The survivors must already be sorted. Matches MainMergeSpawned.
+    void MergeSpawned(std::span<const uint2> items, uint32_t survivorCount, std::span<uint2> output);
+
+    //! Sorts the list using the same decisions as the GPU implementation and returns the path which was taken
+    //! survivorCount is the number of items at the start of the list which survived from the previous frame (IE: the part of the list which is expected to be nearly sorted.)
+    SortPath Sort(std::span<uint2> items, uint32_t survivorCount, float maxDisorderRatio, uint32_t maxSpawnedToMerge);
+}
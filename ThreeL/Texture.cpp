@@ -103,10 +103,7 @@ Texture::Texture(const ResourceManager& resources, std::wstring debugName, std::
         ComputeContext context(graphics.ComputeQueue(), resources.GenerateMipMapsRootSignature, isUnorm ? resources.GenerateMipMapsUnorm : resources.GenerateMipMapsFloat);
         PIXBeginEvent(&context, 0, L"Generate mipmap chain for '%s'", debugName.c_str());
 
-        // Create an SRV and UAV for each mip level
-        //TODO: This could actually be a nice use of the vestigual dynamic resource descriptor infrastructure we have floating around,
-        // although it was designed with copying from the CPU staging descriptor heap in mind so it's not a perfect fit.
-        // For now we just allocate forever descriptors even though they'll only really be used for this one thing
+        // Create an SRV and UAV for each mip level, they're freed once the mip chain has been generated
         std::vector<ResourceDescriptor> mipSrvs(textureDescription.MipLevels);
         std::vector<ResourceDescriptor> mipUavs(textureDescription.MipLevels);
         {
@@ -157,39 +154,27 @@ Texture::Texture(const ResourceManager& resources, std::wstring debugName, std::
             context->SetComputeRootDescriptorTable(ShaderInterop::GenerateMipmapChain::RpOutputTexture, mipUavs[level].ResidentHandle());
 
             // Transition the output texture to allow unordered access
-            context.__AllocateResourceBarrier() =
-            {
-                .Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION,
-                .Transition =
-                {
-                    .pResource = m_Resource.Get(),
-                    .Subresource = level,
-                    .StateBefore = D3D12_RESOURCE_STATE_COMMON,
-                    .StateAfter = D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
-                },
-            };
+            context.TransitionSubresource(*this, level, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
 
             // Dispatch compute shader to generate the level N mip from the level N-1 mip
             uint2 dispatchSize = (mipSize + (ShaderInterop::GenerateMipmapChain::ThreadGroupSize - 1)) / ShaderInterop::GenerateMipmapChain::ThreadGroupSize;
             context.Dispatch(uint3(dispatchSize, 1));
 
             // Flush UAV writes and transition the subresource back to a shader resource
+            // Common is required here as the texture will be accessed on the graphics queue later so we need implicit state promotion
             context.UavBarrier();
-            context.__AllocateResourceBarrier() =
-            {
-                .Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION,
-                .Transition =
-                {
-                    .pResource = m_Resource.Get(),
-                    .Subresource = level,
-                    .StateBefore = D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
-                    // Common is required here as the texture will be accessed on the graphics queue later so we need implicit state promotion
-                    .StateAfter = D3D12_RESOURCE_STATE_COMMON,
-                },
-            };
+            context.TransitionSubresource(*this, level, D3D12_RESOURCE_STATE_COMMON);
         }
 
         PIXEndEvent(&context);
-        context.Finish();
+        GpuSyncPoint mipsSyncPoint = context.Finish();
+
+        for (uint16_t level = 0; level < textureDescription.MipLevels; level++)
+        {
+            graphics.ResourceDescriptorManager().FreeResidentDescriptor(mipSrvs[level], mipsSyncPoint);
+
+            if (level > 0)
+            { graphics.ResourceDescriptorManager().FreeResidentDescriptor(mipUavs[level], mipsSyncPoint); }
+        }
     }
 }
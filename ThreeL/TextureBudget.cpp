@@ -0,0 +1,173 @@
+#include "pch.h"
+#include "TextureBudget.h"
+
+#include <algorithm>
+#include <queue>
+#include <tuple>
+
+TextureBudget::TextureBudget(uint64_t budgetBytes)
+    : m_BudgetBytes(budgetBytes)
+{
+}
+
+uint32_t TextureBudget::MipCount(uint2 size)
+{
+    uint32_t mipCount = 1;
+    for (uint32_t largest = std::max(size.x, size.y); largest > 1; largest >>= 1)
+    { mipCount++; }
+    return mipCount;
+}
+
+uint2 TextureBudget::MipSize(uint2 size, uint32_t mipLevel)
+{
+    return uint2(std::max(size.x >> mipLevel, 1u), std::max(size.y >> mipLevel, 1u));
+}
+
+uint64_t TextureBudget::MipChainBytes(uint2 size, uint32_t mostDetailedMip)
+{
+    uint64_t bytes = 0;
+    uint32_t mipCount = MipCount(size);
+    for (uint32_t mipLevel = mostDetailedMip; mipLevel < mipCount; mipLevel++)
+    {
+        uint2 mipSize = MipSize(size, mipLevel);
+        bytes += (uint64_t)mipSize.x * mipSize.y * 4;
+    }
+
+    return bytes;
+}
+
+uint32_t TextureBudget::FloorMip(uint2 size, uint32_t maxSize)
+{
+    uint32_t mipLevel = 0;
+    while (true)
+    {
+        uint2 mipSize = MipSize(size, mipLevel);
+        if ((mipSize.x <= maxSize && mipSize.y <= maxSize) || (mipSize.x == 1 && mipSize.y == 1))
+        { return mipLevel; }
+        mipLevel++;
+    }
+}
+
+uint32_t TextureBudget::AddTexture(uint2 size, uint32_t floorMip)
+{
+    Assert(floorMip < MipCount(size));
+    Entry entry =
+    {
+        .Size = size,
+        .FloorMip = floorMip,
+        .TargetMip = floorMip,
+        .LastUsedFrame = 0,
+        .WasUsed = false,
+        .IsRemoved = false,
+    };
+    m_Entries.push_back(entry);
+    return (uint32_t)m_Entries.size() - 1;
+}
+
+void TextureBudget::RemoveTexture(uint32_t texture)
+{
+    Entry& entry = m_Entries[texture];
+    entry.IsRemoved = true;
+    entry.TargetMip = MipCount(entry.Size);
+}
+
+void TextureBudget::MarkUsed(uint32_t texture, uint64_t frame)
+{
+    Entry& entry = m_Entries[texture];
+    entry.LastUsedFrame = std::max(entry.LastUsedFrame, frame);
+    entry.WasUsed = true;
+}
+
+void TextureBudget::Update()
+{
+    m_Statistics = { .BudgetBytes = m_BudgetBytes };
+
+    // Start from what every texture wants
+    uint64_t targetBytes = 0;
+    for (Entry& entry : m_Entries)
+    {
+        if (entry.IsRemoved)
+        { continue; }
+
+        entry.TargetMip = entry.WasUsed ? 0 : entry.FloorMip;
+        targetBytes += MipChainBytes(entry.Size, entry.TargetMip);
+    }
+    m_Statistics.WantedBytes = targetBytes;
+
+    // Drop top mips until everything fits, oldest first and then largest first
+    // Each candidate is keyed by its last used frame and the size of its current top mip, the queue yields the greatest key so the frame is negated
+    using Candidate = std::tuple<int64_t, uint64_t, uint32_t>;
+    std::priority_queue<Candidate> candidates;
+    auto TopMipBytes = [](const Entry& entry) { return MipChainBytes(entry.Size, entry.TargetMip) - MipChainBytes(entry.Size, entry.TargetMip + 1); };
+
+    if (targetBytes > m_BudgetBytes)
+    {
+        for (uint32_t i = 0; i < m_Entries.size(); i++)
+        {
+            const Entry& entry = m_Entries[i];
+            if (!entry.IsRemoved && entry.TargetMip < entry.FloorMip)
+            { candidates.emplace(-(int64_t)entry.LastUsedFrame, TopMipBytes(entry), i); }
+        }
+    }
+
+    while (targetBytes > m_BudgetBytes && !candidates.empty())
+    {
+        uint32_t i = std::get<2>(candidates.top());
+        candidates.pop();
+
+        Entry& entry = m_Entries[i];
+        targetBytes -= TopMipBytes(entry);
+        entry.TargetMip++;
+        m_Statistics.EvictedMipCount++;
+
+        if (entry.TargetMip < entry.FloorMip)
+        { candidates.emplace(-(int64_t)entry.LastUsedFrame, TopMipBytes(entry), i); }
+    }
+
+    m_Statistics.TargetBytes = targetBytes;
+    m_Statistics.IsOverBudget = targetBytes > m_BudgetBytes;
+}
+
+TextureBudgetSimulation SimulateTextureBudget(const TextureUsageTrace& trace, uint64_t budgetBytes, uint32_t floorMipSize)
+{
+    TextureBudget budget(budgetBytes);
+    for (uint2 size : trace.TextureSizes)
+    { budget.AddTexture(size, TextureBudget::FloorMip(size, floorMipSize)); }
+
+    TextureBudgetSimulation simulation = { };
+    std::vector<uint32_t> targets(trace.TextureSizes.size());
+    for (uint32_t i = 0; i < targets.size(); i++)
+    {
+        targets[i] = budget.TargetMip(i);
+        simulation.StreamedBytes += TextureBudget::MipChainBytes(trace.TextureSizes[i], targets[i]);
+    }
+
+    for (uint64_t frame = 0; frame < trace.FrameUsage.size(); frame++)
+    {
+        // Textures are drawn with whatever the previous frame's update made resident
+        for (uint32_t texture : trace.FrameUsage[frame])
+        {
+            simulation.UseCount++;
+            if (targets[texture] != 0)
+            { simulation.DegradedUseCount++; }
+
+            budget.MarkUsed(texture, frame);
+        }
+
+        budget.Update();
+        simulation.PeakTargetBytes = std::max(simulation.PeakTargetBytes, budget.Statistics().TargetBytes);
+
+        for (uint32_t i = 0; i < targets.size(); i++)
+        {
+            uint2 size = trace.TextureSizes[i];
+            uint32_t target = budget.TargetMip(i);
+            if (target < targets[i])
+            { simulation.StreamedBytes += TextureBudget::MipChainBytes(size, target) - TextureBudget::MipChainBytes(size, targets[i]); }
+            else if (target > targets[i])
+            { simulation.EvictedBytes += TextureBudget::MipChainBytes(size, targets[i]) - TextureBudget::MipChainBytes(size, target); }
+            targets[i] = target;
+        }
+    }
+
+    return simulation;
+}
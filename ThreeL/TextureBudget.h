@@ -0,0 +1,85 @@
+#pragma once
+#include "Math.h"
+
+#include <stdint.h>
+#include <vector>
+
+struct TextureBudgetStatistics
+{
+    uint64_t BudgetBytes;
+    uint64_t TargetBytes; //!< Memory used by every texture at its target mip
+    uint64_t WantedBytes; //!< Memory which would be used if there were no budget
+    uint32_t EvictedMipCount; //!< Mips which are wanted but don't fit in the budget
+    bool IsOverBudget; //!< True when the budget can't even fit every texture at its floor mip
+};
+
+//! A recording of which textures were used each frame, see SimulateTextureBudget
+struct TextureUsageTrace
+{
+    std::vector<uint2> TextureSizes;
+    std::vector<std::vector<uint32_t>> FrameUsage;
+};
+
+struct TextureBudgetSimulation
+{
+    uint64_t StreamedBytes; //!< Mips which had to be streamed in (including ones which were previously evicted)
+    uint64_t EvictedBytes;
+    uint64_t PeakTargetBytes;
+    uint32_t UseCount;
+    uint32_t DegradedUseCount; //!< Uses of a texture while it wasn't at full detail
+};
+
+//! Decides how many mips of each texture should be resident to fit within a memory budget
+//!
+//! Textures which have been used want their full mip chain, textures which have never been used only want their floor mip (and the mips smaller than it.)
+//! When the wanted mips don't fit, top mips are dropped from the least recently used textures first. Textures which were last used on the same frame
+//! lose their largest mips first so that quality degrades evenly across them. Textures are never dropped below their floor mip.
+//!
+//! Memory is estimated assuming 32bpp textures with full mip chains and no placement padding.
+//! This type has no dependency on D3D (or anything else) so that policies can be evaluated offline against recorded traces.
+class TextureBudget
+{
+private:
+    struct Entry
+    {
+        uint2 Size;
+        uint32_t FloorMip;
+        uint32_t TargetMip;
+        uint64_t LastUsedFrame;
+        bool WasUsed;
+        bool IsRemoved;
+    };
+
+    uint64_t m_BudgetBytes;
+    std::vector<Entry> m_Entries;
+    TextureBudgetStatistics m_Statistics = { };
+
+public:
+    TextureBudget(uint64_t budgetBytes = UINT64_MAX);
+
+    static uint32_t MipCount(uint2 size);
+    static uint2 MipSize(uint2 size, uint32_t mipLevel);
+    //! Returns the number of bytes used by the mips of a 32bpp texture starting at mostDetailedMip, 0 when mostDetailedMip is the mip count
+    static uint64_t MipChainBytes(uint2 size, uint32_t mostDetailedMip);
+    //! Returns the most detailed mip which is no larger than maxSize in either dimension
+    static uint32_t FloorMip(uint2 size, uint32_t maxSize);
+
+    //! Adds a texture to the budget, it starts at its floor mip
+    uint32_t AddTexture(uint2 size, uint32_t floorMip);
+    //! Removes a texture from the budget (IE: because it failed to load), it no longer counts against the budget and its target is its mip count
+    void RemoveTexture(uint32_t texture);
+    void MarkUsed(uint32_t texture, uint64_t frame);
+
+    inline uint64_t Budget() const { return m_BudgetBytes; }
+    inline void SetBudget(uint64_t budgetBytes) { m_BudgetBytes = budgetBytes; }
+
+    //! Recomputes the target mip of every texture
+    void Update();
+
+    //! The most detailed mip the texture should have resident as of the last update
+    inline uint32_t TargetMip(uint32_t texture) const { return m_Entries[texture].TargetMip; }
+    inline const TextureBudgetStatistics& Statistics() const { return m_Statistics; }
+};
+
+//! Replays a usage trace against a budget, assuming mips are streamed in as soon as they're wanted
+TextureBudgetSimulation SimulateTextureBudget(const TextureUsageTrace& trace, uint64_t budgetBytes, uint32_t floorMipSize);
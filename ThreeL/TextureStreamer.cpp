@@ -0,0 +1,553 @@
+#include "pch.h"
+#include "TextureStreamer.h"
+
+#include <algorithm>
+
+namespace
+{
+    // Lookup tables for filtering sRGB textures in linear space
+    // (Linear values are quantized to 12 bits on the way back, which is more than enough precision for 8 bit sRGB.)
+    struct SrgbTables
+    {
+        float ToLinear[256];
+        uint8_t FromLinear[4096];
+
+        SrgbTables()
+        {
+            for (int i = 0; i < 256; i++)
+            {
+                float c = (float)i / 255.f;
+                ToLinear[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+            }
+
+            for (int i = 0; i < 4096; i++)
+            {
+                float l = (float)i / 4095.f;
+                float c = l <= 0.0031308f ? l * 12.92f : 1.055f * std::pow(l, 1.f / 2.4f) - 0.055f;
+                FromLinear[i] = (uint8_t)std::clamp(c * 255.f + 0.5f, 0.f, 255.f);
+            }
+        }
+    };
+
+    const SrgbTables& GetSrgbTables()
+    {
+        static SrgbTables tables;
+        return tables;
+    }
+}
+
+TextureStreamer::TextureStreamer(TextureUploadSink& sink, TextureDecoder decoder, uint32_t workerCount, uint64_t maxDecodedBytes)
+    : m_Sink(sink), m_Decoder(std::move(decoder)), m_MaxDecodedBytes(maxDecodedBytes)
+{
+    Assert(workerCount > 0);
+    Assert(m_Decoder != nullptr);
+
+    m_Workers.reserve(workerCount);
+    for (uint32_t i = 0; i < workerCount; i++)
+    { m_Workers.emplace_back([this]() { WorkerMain(); }); }
+}
+
+StreamedTextureId TextureStreamer::Register(std::vector<uint8_t>&& encodedData, uint2 size, bool isSrgb)
+{
+    Assert(size.x > 0 && size.y > 0);
+    Assert(!encodedData.empty());
+
+    StreamedTextureId id;
+    {
+        std::lock_guard<std::mutex> lock(m_Lock);
+        id = (StreamedTextureId)m_Textures.size();
+        StreamedTexture& texture = m_Textures.emplace_back();
+        texture.EncodedData = std::move(encodedData);
+        texture.Size = size;
+        texture.MipCount = TextureBudget::MipCount(size);
+        texture.IsSrgb = isSrgb;
+        Assert(texture.MipCount < 32 && "Texture has too many mips for the mip masks.");
+        texture.Mips.resize(texture.MipCount);
+
+        // Nothing is allocated until the first mips are ready, and the budget starts every texture off with just its tail mips
+        uint32_t budgetId = m_Budget.AddTexture(size, TextureBudget::FloorMip(size, TAIL_MIP_SIZE));
+        Assert(budgetId == id);
+        texture.TargetMip = m_Budget.TargetMip(id);
+        texture.AllocatedMip = texture.MipCount;
+        texture.IssuedMip = texture.MipCount;
+        texture.MostDetailedResidentMip = texture.MipCount;
+
+        texture.DecodeState = TextureDecodeState::Waiting;
+        m_WaitingCount++;
+
+        if (m_UsageTrace != nullptr)
+        { m_UsageTrace->TextureSizes.push_back(size); }
+    }
+
+    m_WorkAvailable.notify_one();
+    return id;
+}
+
+void TextureStreamer::ReportUsage(StreamedTextureId texture, float coverage)
+{
+    std::lock_guard<std::mutex> lock(m_Lock);
+    Assert(texture < m_Textures.size());
+
+    // Coverage is summed over every draw using the texture this frame, it'll be folded into the priority by the next update
+    float& frameCoverage = m_Textures[texture].FrameCoverage;
+    frameCoverage = std::min(frameCoverage + coverage, 1.f);
+}
+
+void TextureStreamer::Update(uint64_t uploadByteBudget)
+{
+    std::vector<SinkCommand> commands;
+    bool isDecodeNeeded = false;
+    {
+        std::lock_guard<std::mutex> lock(m_Lock);
+        m_FrameNumber++;
+
+        std::vector<uint32_t>* frameUsage = nullptr;
+        if (m_UsageTrace != nullptr)
+        { frameUsage = &m_UsageTrace->FrameUsage.emplace_back(); }
+
+        // Fold this frame's usage into the priorities and the budget
+        for (StreamedTextureId id = 0; id < m_Textures.size(); id++)
+        {
+            StreamedTexture& texture = m_Textures[id];
+            texture.Priority = std::max(texture.Priority * PRIORITY_DECAY, texture.FrameCoverage);
+
+            if (texture.FrameCoverage > 0.f)
+            {
+                m_Budget.MarkUsed(id, m_FrameNumber);
+                if (frameUsage != nullptr)
+                { frameUsage->push_back(id); }
+            }
+
+            texture.FrameCoverage = 0.f;
+        }
+
+        m_Budget.Update();
+
+        auto AllocateMips = [&](StreamedTextureId id, uint32_t mostDetailedMip)
+            {
+                StreamedTexture& texture = m_Textures[id];
+                SinkCommand command =
+                {
+                    .IsAllocation = true,
+                    .Texture = id,
+                    .MipLevel = mostDetailedMip,
+                    .PreserveFromMip = std::max(texture.IssuedMip, mostDetailedMip),
+                };
+                commands.push_back(std::move(command));
+                texture.AllocatedMip = mostDetailedMip;
+            };
+
+        // Apply the budget and find textures which have mips ready to be uploaded
+        std::vector<StreamedTextureId> streamingTextures;
+        for (StreamedTextureId id = 0; id < m_Textures.size(); id++)
+        {
+            StreamedTexture& texture = m_Textures[id];
+            if (texture.HasFailed)
+            { continue; }
+
+            texture.TargetMip = m_Budget.TargetMip(id);
+
+            // Decoded mips above the target aren't wanted anymore
+            for (uint32_t mipLevel = 0; mipLevel < texture.TargetMip; mipLevel++)
+            {
+                m_DecodedBytes -= texture.Mips[mipLevel].size();
+                texture.Mips[mipLevel] = std::vector<uint8_t>();
+            }
+
+            // Shrink textures which are over budget
+            // (Textures with uploads in flight are left alone until they land since they might be to the mips we'd be dropping.)
+            if (texture.TargetMip > texture.AllocatedMip && texture.InFlightMipMask == 0)
+            {
+                m_EvictedBytes += TextureBudget::MipChainBytes(texture.Size, texture.AllocatedMip) - TextureBudget::MipChainBytes(texture.Size, texture.TargetMip);
+                AllocateMips(id, texture.TargetMip);
+                texture.IssuedMip = std::max(texture.IssuedMip, texture.TargetMip);
+                texture.UploadedMipMask &= ~((1u << texture.TargetMip) - 1);
+
+                if (texture.MostDetailedResidentMip < texture.TargetMip)
+                {
+                    texture.MostDetailedResidentMip = texture.TargetMip;
+                    TextureResidencyChange change = { .Texture = id, .MostDetailedMip = texture.TargetMip };
+                    m_ResidencyChanges.push_back(change);
+                }
+            }
+
+            // Grow textures which are under their target, decoding them again if their mips were freed
+            if (texture.TargetMip < texture.IssuedMip)
+            {
+                if (!texture.Mips[texture.IssuedMip - 1].empty())
+                { streamingTextures.push_back(id); }
+                else if (texture.DecodeState == TextureDecodeState::Idle)
+                {
+                    texture.DecodeState = TextureDecodeState::Waiting;
+                    m_WaitingCount++;
+                    isDecodeNeeded = true;
+                }
+            }
+        }
+
+        // Mips are issued from the smallest to the largest
+        auto CanIssueMip = [&](const StreamedTexture& texture) { return texture.IssuedMip > texture.TargetMip && !texture.Mips[texture.IssuedMip - 1].empty(); };
+        auto IssueMip = [&](StreamedTextureId id)
+            {
+                StreamedTexture& texture = m_Textures[id];
+                uint32_t mipLevel = texture.IssuedMip - 1;
+
+                // Textures are grown all the way to their target at once so that streaming one in only needs a single reallocation
+                if (mipLevel < texture.AllocatedMip)
+                { AllocateMips(id, texture.TargetMip); }
+
+                std::vector<uint8_t>& data = texture.Mips[mipLevel];
+                m_DecodedBytes -= data.size();
+                m_UploadedBytes += data.size();
+
+                SinkCommand command =
+                {
+                    .IsAllocation = false,
+                    .Texture = id,
+                    .MipLevel = mipLevel,
+                    .Size = TextureBudget::MipSize(texture.Size, mipLevel),
+                    .Data = std::move(data),
+                };
+                commands.push_back(std::move(command));
+
+                texture.IssuedMip--;
+                texture.InFlightMipMask |= 1u << mipLevel;
+            };
+
+        // Tail mips go first since they're what gets textures off of their placeholders
+        for (StreamedTextureId id : streamingTextures)
+        {
+            StreamedTexture& texture = m_Textures[id];
+            while (CanIssueMip(texture))
+            {
+                uint2 size = TextureBudget::MipSize(texture.Size, texture.IssuedMip - 1);
+                if (size.x > TAIL_MIP_SIZE || size.y > TAIL_MIP_SIZE)
+                { break; }
+
+                IssueMip(id);
+            }
+        }
+
+        // Detail mips are issued in strict priority order so that lower priority textures can't starve the most visible ones by squeezing into the budget
+        std::stable_sort(streamingTextures.begin(), streamingTextures.end(), [&](StreamedTextureId a, StreamedTextureId b) { return m_Textures[a].Priority > m_Textures[b].Priority; });
+        uint64_t issuedBytes = 0;
+        bool isBudgetExhausted = false;
+        for (StreamedTextureId id : streamingTextures)
+        {
+            StreamedTexture& texture = m_Textures[id];
+            while (CanIssueMip(texture))
+            {
+                uint64_t mipBytes = texture.Mips[texture.IssuedMip - 1].size();
+                if (issuedBytes > 0 && issuedBytes + mipBytes > uploadByteBudget)
+                {
+                    isBudgetExhausted = true;
+                    break;
+                }
+
+                IssueMip(id);
+                issuedBytes += mipBytes;
+            }
+
+            if (isBudgetExhausted)
+            { break; }
+        }
+    }
+
+    if (isDecodeNeeded)
+    { m_WorkAvailable.notify_all(); }
+
+    if (commands.empty())
+    { return; }
+
+    // The sink is called without holding the lock since it's allowed to call MipUploaded immediately
+    for (const SinkCommand& command : commands)
+    {
+        if (command.IsAllocation)
+        { m_Sink.AllocateMips(command.Texture, command.MipLevel, command.PreserveFromMip); }
+        else
+        { m_Sink.UploadMip(command.Texture, command.MipLevel, command.Size, command.Data); }
+    }
+    m_Sink.FlushUploads();
+
+    // Workers which stopped due to MaxDecodedBytes might be able to continue now
+    m_WorkAvailable.notify_all();
+}
+
+void TextureStreamer::MipUploaded(StreamedTextureId id, uint32_t mipLevel)
+{
+    std::lock_guard<std::mutex> lock(m_Lock);
+    Assert(id < m_Textures.size());
+    StreamedTexture& texture = m_Textures[id];
+    Assert(mipLevel < texture.MipCount);
+    Assert((texture.InFlightMipMask & (1u << mipLevel)) != 0 && "Mip level was not being uploaded!");
+    texture.InFlightMipMask &= ~(1u << mipLevel);
+    texture.UploadedMipMask |= 1u << mipLevel;
+
+    // Uploads may complete out of order, so the resident mip can only advance once every smaller mip is also resident
+    uint32_t mostDetailedMip = texture.MostDetailedResidentMip;
+    while (mostDetailedMip > 0 && (texture.UploadedMipMask & (1u << (mostDetailedMip - 1))) != 0)
+    { mostDetailedMip--; }
+
+    if (mostDetailedMip == texture.MostDetailedResidentMip)
+    { return; }
+
+    texture.MostDetailedResidentMip = mostDetailedMip;
+    TextureResidencyChange change = { .Texture = id, .MostDetailedMip = mostDetailedMip };
+    m_ResidencyChanges.push_back(change);
+}
+
+std::vector<TextureResidencyChange> TextureStreamer::TakeResidencyChanges()
+{
+    std::lock_guard<std::mutex> lock(m_Lock);
+    std::vector<TextureResidencyChange> changes;
+    changes.swap(m_ResidencyChanges);
+    return changes;
+}
+
+uint32_t TextureStreamer::MostDetailedResidentMip(StreamedTextureId texture)
+{
+    std::lock_guard<std::mutex> lock(m_Lock);
+    Assert(texture < m_Textures.size());
+    return m_Textures[texture].MostDetailedResidentMip;
+}
+
+uint32_t TextureStreamer::MipCount(StreamedTextureId texture)
+{
+    std::lock_guard<std::mutex> lock(m_Lock);
+    Assert(texture < m_Textures.size());
+    return m_Textures[texture].MipCount;
+}
+
+uint2 TextureStreamer::Size(StreamedTextureId texture)
+{
+    std::lock_guard<std::mutex> lock(m_Lock);
+    Assert(texture < m_Textures.size());
+    return m_Textures[texture].Size;
+}
+
+bool TextureStreamer::IsSrgb(StreamedTextureId texture)
+{
+    std::lock_guard<std::mutex> lock(m_Lock);
+    Assert(texture < m_Textures.size());
+    return m_Textures[texture].IsSrgb;
+}
+
+void TextureStreamer::SetBudget(uint64_t budgetBytes)
+{
+    std::lock_guard<std::mutex> lock(m_Lock);
+    m_Budget.SetBudget(budgetBytes);
+}
+
+void TextureStreamer::StartRecordingUsage()
+{
+    std::lock_guard<std::mutex> lock(m_Lock);
+    m_UsageTrace = std::make_unique<TextureUsageTrace>();
+    for (const StreamedTexture& texture : m_Textures)
+    { m_UsageTrace->TextureSizes.push_back(texture.Size); }
+}
+
+TextureUsageTrace TextureStreamer::StopRecordingUsage()
+{
+    std::lock_guard<std::mutex> lock(m_Lock);
+    if (m_UsageTrace == nullptr)
+    { return { }; }
+
+    TextureUsageTrace trace = std::move(*m_UsageTrace);
+    m_UsageTrace = nullptr;
+    return trace;
+}
+
+bool TextureStreamer::IsRecordingUsage()
+{
+    std::lock_guard<std::mutex> lock(m_Lock);
+    return m_UsageTrace != nullptr;
+}
+
+TextureStreamerStatistics TextureStreamer::Statistics()
+{
+    std::lock_guard<std::mutex> lock(m_Lock);
+    TextureStreamerStatistics statistics =
+    {
+        .TextureCount = (uint32_t)m_Textures.size(),
+        .DecodedBytes = m_DecodedBytes,
+        .UploadedBytes = m_UploadedBytes,
+        .EvictedBytes = m_EvictedBytes,
+        .Budget = m_Budget.Statistics(),
+    };
+
+    for (const StreamedTexture& texture : m_Textures)
+    {
+        if (texture.HasFailed)
+        {
+            statistics.FailedCount++;
+            continue;
+        }
+
+        statistics.AllocatedBytes += TextureBudget::MipChainBytes(texture.Size, texture.AllocatedMip);
+        if (texture.DecodeState == TextureDecodeState::Waiting)
+        { statistics.WaitingCount++; }
+        else if (texture.DecodeState == TextureDecodeState::Decoding)
+        { statistics.DecodingCount++; }
+        else if (texture.MostDetailedResidentMip > texture.TargetMip)
+        { statistics.StreamingCount++; }
+        else
+        { statistics.ResidentCount++; }
+    }
+
+    return statistics;
+}
+
+bool TextureStreamer::TryTakeDecodeJob(StreamedTextureId* outTexture)
+{
+    // Must be called with m_Lock held
+    if (m_WaitingCount == 0 || m_DecodedBytes >= m_MaxDecodedBytes)
+    { return false; }
+
+    //PERF: This is a linear scan, but scenes don't have enough textures for it to matter
+    StreamedTextureId best = UINT32_MAX;
+    for (StreamedTextureId id = 0; id < m_Textures.size(); id++)
+    {
+        const StreamedTexture& texture = m_Textures[id];
+        if (texture.DecodeState != TextureDecodeState::Waiting)
+        { continue; }
+
+        // Ties go to whichever texture was registered first
+        if (best == UINT32_MAX || texture.Priority + texture.FrameCoverage > m_Textures[best].Priority + m_Textures[best].FrameCoverage)
+        { best = id; }
+    }
+
+    Assert(best != UINT32_MAX);
+    m_Textures[best].DecodeState = TextureDecodeState::Decoding;
+    m_WaitingCount--;
+    *outTexture = best;
+    return true;
+}
+
+void TextureStreamer::WorkerMain()
+{
+    std::unique_lock<std::mutex> lock(m_Lock);
+    while (true)
+    {
+        StreamedTextureId id;
+        m_WorkAvailable.wait(lock, [&]() { return m_IsShuttingDown || TryTakeDecodeJob(&id); });
+
+        if (m_IsShuttingDown)
+        { return; }
+
+        // Nothing else touches the encoded data or the size of a texture, so the lock isn't needed while decoding
+        StreamedTexture& texture = m_Textures[id];
+        std::span<const uint8_t> encodedData = texture.EncodedData;
+        uint2 size = texture.Size;
+        bool isSrgb = texture.IsSrgb;
+        lock.unlock();
+
+        std::vector<uint8_t> rgbaData;
+        uint2 decodedSize;
+        bool success = m_Decoder(encodedData, &rgbaData, &decodedSize);
+        if (!success)
+        { printf("Warning: Failed to decode streamed texture #%u, it will be left as its placeholder.\n", id); }
+        else if (decodedSize.x != size.x || decodedSize.y != size.y)
+        {
+            printf("Warning: Streamed texture #%u decoded as %ux%u but was registered as %ux%u.\n", id, decodedSize.x, decodedSize.y, size.x, size.y);
+            success = false;
+        }
+
+        std::vector<std::vector<uint8_t>> mips;
+        if (success)
+        { mips = BuildMipChain(std::move(rgbaData), size, isSrgb); }
+
+        lock.lock();
+        texture.DecodeState = TextureDecodeState::Idle;
+        if (!success)
+        {
+            texture.HasFailed = true;
+            texture.EncodedData = std::vector<uint8_t>();
+            m_Budget.RemoveTexture(id);
+            continue;
+        }
+
+        // Only keep the mips which are still wanted, the target might've changed while we were decoding
+        for (uint32_t mipLevel = texture.TargetMip; mipLevel < texture.IssuedMip; mipLevel++)
+        {
+            if (texture.Mips[mipLevel].empty())
+            {
+                m_DecodedBytes += mips[mipLevel].size();
+                texture.Mips[mipLevel] = std::move(mips[mipLevel]);
+            }
+        }
+    }
+}
+
+std::vector<std::vector<uint8_t>> TextureStreamer::BuildMipChain(std::vector<uint8_t>&& rgbaData, uint2 size, bool isSrgb)
+{
+    Assert(rgbaData.size() == (size_t)size.x * size.y * 4);
+    const SrgbTables& srgb = GetSrgbTables();
+
+    uint32_t mipCount = TextureBudget::MipCount(size);
+    std::vector<std::vector<uint8_t>> mips;
+    mips.reserve(mipCount);
+    mips.push_back(std::move(rgbaData));
+
+    // Each mip is a 2x2 box filter of the previous one, sRGB color channels are averaged in linear space
+    // (Odd dimensions clamp to the last row/column, which is a slight bias we accept in exchange for simplicity.)
+    for (uint32_t mipLevel = 1; mipLevel < mipCount; mipLevel++)
+    {
+        const std::vector<uint8_t>& source = mips[mipLevel - 1];
+        uint2 sourceSize = TextureBudget::MipSize(size, mipLevel - 1);
+        uint2 mipSize = TextureBudget::MipSize(size, mipLevel);
+        std::vector<uint8_t> mip((size_t)mipSize.x * mipSize.y * 4);
+
+        for (uint32_t y = 0; y < mipSize.y; y++)
+        {
+            uint32_t y0 = std::min(y * 2, sourceSize.y - 1);
+            uint32_t y1 = std::min(y * 2 + 1, sourceSize.y - 1);
+            for (uint32_t x = 0; x < mipSize.x; x++)
+            {
+                uint32_t x0 = std::min(x * 2, sourceSize.x - 1);
+                uint32_t x1 = std::min(x * 2 + 1, sourceSize.x - 1);
+                const uint8_t* texels[] =
+                {
+                    &source[((size_t)y0 * sourceSize.x + x0) * 4],
+                    &source[((size_t)y0 * sourceSize.x + x1) * 4],
+                    &source[((size_t)y1 * sourceSize.x + x0) * 4],
+                    &source[((size_t)y1 * sourceSize.x + x1) * 4],
+                };
+
+                uint8_t* destination = &mip[((size_t)y * mipSize.x + x) * 4];
+                for (uint32_t channel = 0; channel < 4; channel++)
+                {
+                    if (isSrgb && channel < 3)
+                    {
+                        float sum = 0.f;
+                        for (const uint8_t* texel : texels)
+                        { sum += srgb.ToLinear[texel[channel]]; }
+                        destination[channel] = srgb.FromLinear[(uint32_t)(sum * 0.25f * 4095.f + 0.5f)];
+                    }
+                    else
+                    {
+                        uint32_t sum = 0;
+                        for (const uint8_t* texel : texels)
+                        { sum += texel[channel]; }
+                        destination[channel] = (uint8_t)((sum + 2) / 4);
+                    }
+                }
+            }
+        }
+
+        mips.push_back(std::move(mip));
+    }
+
+    return mips;
+}
+
+TextureStreamer::~TextureStreamer()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_Lock);
+        m_IsShuttingDown = true;
+    }
+
+    m_WorkAvailable.notify_all();
+    for (std::thread& worker : m_Workers)
+    { worker.join(); }
+}
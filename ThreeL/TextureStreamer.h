@@ -0,0 +1,194 @@
+#pragma once
+#include "Math.h"
+#include "TextureBudget.h"
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+using StreamedTextureId = uint32_t;
+
+//! Receives mip levels from a TextureStreamer as they're scheduled for upload
+//! The streamer has no dependency on D3D so that its decode/prioritize/schedule pipeline can run without a GPU, see GpuTextureStreamer for the D3D12 implementation.
+class TextureUploadSink
+{
+public:
+    //! (Re)allocates the texture so that it holds mips [mostDetailedMip, mip count), preserving the contents of mips [preserveFromMip, mip count)
+    //! Always called before the first upload to a mip the current allocation doesn't hold, and to shrink textures when they're over budget.
+    //! The preserved mips must remain visible to shaders throughout, preserveFromMip is the mip count when there's nothing to preserve.
+    //! Work must be carried out in the order it's handed to the sink, so preserved mips include ones whose uploads are still in flight.
+    virtual void AllocateMips(StreamedTextureId texture, uint32_t mostDetailedMip, uint32_t preserveFromMip) = 0;
+
+    //! Uploads a single mip level of a texture, the data must be copied out before returning as the streamer frees it afterwards
+    //! Once the mip level is resident the sink must call TextureStreamer::MipUploaded, which may happen on any thread (including this one.)
+    virtual void UploadMip(StreamedTextureId texture, uint32_t mipLevel, uint2 size, std::span<const uint8_t> rgbaData) = 0;
+
+    //! Called at the end of each TextureStreamer::Update which allocated or uploaded anything, allows the sink to batch its work
+    virtual void FlushUploads() = 0;
+
+    virtual ~TextureUploadSink() = default;
+};
+
+//! Decodes an encoded image (IE: a PNG or JPEG) to 32bpp RGBA, returns false if the image couldn't be decoded
+using TextureDecoder = std::function<bool(std::span<const uint8_t> encodedData, std::vector<uint8_t>* outRgbaData, uint2* outSize)>;
+
+struct TextureResidencyChange
+{
+    StreamedTextureId Texture;
+    uint32_t MostDetailedMip;
+};
+
+struct TextureStreamerStatistics
+{
+    uint32_t TextureCount;
+    uint32_t WaitingCount;
+    uint32_t DecodingCount;
+    uint32_t StreamingCount; //!< Textures which aren't resident down to their target mip yet
+    uint32_t ResidentCount;
+    uint32_t FailedCount;
+    uint64_t DecodedBytes; //!< CPU memory held by decoded mips which haven't been uploaded yet
+    uint64_t UploadedBytes;
+    uint64_t AllocatedBytes; //!< Estimated GPU memory of every texture's current allocation
+    uint64_t EvictedBytes;
+    TextureBudgetStatistics Budget;
+};
+
+//! Streams textures to the GPU lowest mip first within a memory budget, with decoding done on demand by background worker threads
+//!
+//! Textures are registered with their encoded image data. The TextureBudget decides which mips of each texture should be resident based on when it was last
+//! used, and textures are decoded and uploaded in order of priority (which comes from the screen coverage reported by ReportUsage) until they reach that mip.
+//! Workers build the mip chain on the CPU, and Update hands the mips to the upload sink smallest first so that every texture quickly gets a usable
+//! (if blurry) representation. The most detailed resident mip only advances once every smaller mip has been uploaded.
+//!
+//! When the budget drops a texture's top mips it's reallocated without them. Evicted mips are decoded again from the retained encoded image if they're needed later.
+//! Decoding stalls once MaxDecodedBytes worth of mips are waiting for upload, which keeps the workers from decoding the entire scene up front.
+//! Update and ReportUsage must only be called from one thread at a time, everything else is free-threaded.
+class TextureStreamer
+{
+public:
+    //! Mips this size or smaller (in both dimensions) are cheap enough that they're always resident and are uploaded regardless of the upload budget
+    static constexpr uint32_t TAIL_MIP_SIZE = 64;
+    //! Priorities are multiplied by this every update, so textures which go off-screen gradually lose out to what's currently visible
+    static constexpr float PRIORITY_DECAY = 0.95f;
+    static constexpr uint64_t DEFAULT_MAX_DECODED_BYTES = 256 * 1024 * 1024;
+
+private:
+    enum class TextureDecodeState
+    {
+        Idle,
+        Waiting,
+        Decoding,
+    };
+
+    struct StreamedTexture
+    {
+        // The encoded image is kept around so that evicted mips can be decoded again
+        std::vector<uint8_t> EncodedData;
+        uint2 Size;
+        uint32_t MipCount;
+        bool IsSrgb;
+        TextureDecodeState DecodeState = TextureDecodeState::Idle;
+        bool HasFailed = false;
+
+        float Priority = 0.f;
+        float FrameCoverage = 0.f;
+
+        // Decoded mips are freed as they're handed to the sink (or once they're no longer wanted)
+        std::vector<std::vector<uint8_t>> Mips;
+
+        // Mips [AllocatedMip, MipCount) are allocated on the GPU, [IssuedMip, MipCount) have been handed to the sink and [MostDetailedResidentMip, MipCount) are resident
+        uint32_t TargetMip;
+        uint32_t AllocatedMip;
+        uint32_t IssuedMip;
+        uint32_t MostDetailedResidentMip;
+        uint32_t InFlightMipMask = 0;
+        uint32_t UploadedMipMask = 0;
+    };
+
+    // Work for the sink is collected while holding the lock and handed to it in order afterwards
+    struct SinkCommand
+    {
+        bool IsAllocation;
+        StreamedTextureId Texture;
+        uint32_t MipLevel; // The most detailed mip for allocations
+        uint32_t PreserveFromMip;
+        uint2 Size;
+        std::vector<uint8_t> Data;
+    };
+
+    TextureUploadSink& m_Sink;
+    TextureDecoder m_Decoder;
+    const uint64_t m_MaxDecodedBytes;
+
+    // The following are protected by m_Lock
+    // (Textures are kept in a deque so that workers can read the encoded data of the texture they're decoding without holding the lock.)
+    std::mutex m_Lock;
+    std::condition_variable m_WorkAvailable;
+    std::deque<StreamedTexture> m_Textures;
+    TextureBudget m_Budget;
+    std::vector<TextureResidencyChange> m_ResidencyChanges;
+    uint64_t m_FrameNumber = 0;
+    uint32_t m_WaitingCount = 0;
+    uint64_t m_DecodedBytes = 0;
+    uint64_t m_UploadedBytes = 0;
+    uint64_t m_EvictedBytes = 0;
+    bool m_IsShuttingDown = false;
+
+    // Usage is only recorded while this is non-null, see StartRecordingUsage
+    std::unique_ptr<TextureUsageTrace> m_UsageTrace;
+
+    std::vector<std::thread> m_Workers;
+
+public:
+    //! The sink must outlive the streamer
+    TextureStreamer(TextureUploadSink& sink, TextureDecoder decoder, uint32_t workerCount = 2, uint64_t maxDecodedBytes = DEFAULT_MAX_DECODED_BYTES);
+    TextureStreamer(const TextureStreamer&) = delete;
+
+    //! Registers a texture for streaming, size must match the size of the decoded image
+    StreamedTextureId Register(std::vector<uint8_t>&& encodedData, uint2 size, bool isSrgb);
+
+    //! Reports that the texture was used to draw something covering the specified fraction of the screen this frame
+    void ReportUsage(StreamedTextureId texture, float coverage);
+
+    //! Updates priorities and the budget from the usage reported since the last update and hands work to the sink
+    //! Tail mips are always uploaded, other mips are uploaded in order of priority until uploadByteBudget is exhausted (but at least one is always uploaded.)
+    void Update(uint64_t uploadByteBudget);
+
+    //! Marks the specified mip level as resident, called by the upload sink
+    void MipUploaded(StreamedTextureId texture, uint32_t mipLevel);
+
+    //! Returns the changes to the most detailed resident mip of each texture since the last call
+    //! The resident mip may become less detailed when mips are evicted.
+    std::vector<TextureResidencyChange> TakeResidencyChanges();
+
+    //! Returns the most detailed resident mip of the texture, or its mip count if none of it is resident yet
+    uint32_t MostDetailedResidentMip(StreamedTextureId texture);
+    uint32_t MipCount(StreamedTextureId texture);
+    uint2 Size(StreamedTextureId texture);
+    bool IsSrgb(StreamedTextureId texture);
+
+    //! Sets the budget for texture memory, textures are shrunk or grown to fit by subsequent updates
+    void SetBudget(uint64_t budgetBytes);
+
+    //! Starts recording which textures are used each frame for evaluating budgets with SimulateTextureBudget
+    void StartRecordingUsage();
+    //! Stops recording and returns the trace, which is empty if recording wasn't started
+    TextureUsageTrace StopRecordingUsage();
+    bool IsRecordingUsage();
+
+    TextureStreamerStatistics Statistics();
+
+private:
+    void WorkerMain();
+    bool TryTakeDecodeJob(StreamedTextureId* outTexture);
+    std::vector<std::vector<uint8_t>> BuildMipChain(std::vector<uint8_t>&& rgbaData, uint2 size, bool isSrgb);
+
+public:
+    ~TextureStreamer();
+};
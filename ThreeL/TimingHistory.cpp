@@ -0,0 +1,323 @@
+#include "pch.h"
+#include "TimingHistory.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <json.hpp>
+
+namespace
+{
+    const uint32_t DOMAIN_COUNT = (uint32_t)TimingDomain::Count;
+    const char* DomainNames[DOMAIN_COUNT] = { "Cpu", "Gpu" };
+
+    // Nearest-rank percentile index within count sorted samples
+    size_t PercentileIndex(size_t count, size_t percent)
+    { return std::max((count * percent + 99) / 100, (size_t)1) - 1; }
+}
+
+TimingSummary TimingHistorySnapshot::Summarize(uint32_t timer, TimingDomain domain) const
+{
+    TimingSummary summary = { .LastHitchFrame = UINT64_MAX };
+
+    std::vector<float> samples;
+    samples.reserve(FrameCount());
+    double total = 0.0;
+    for (uint32_t frame = 0; frame < FrameCount(); frame++)
+    {
+        float sample = Sample(frame, timer, domain);
+        if (sample < 0.f)
+        {
+            summary.SkippedCount++;
+            continue;
+        }
+
+        samples.push_back(sample);
+        total += sample;
+    }
+
+    summary.SampleCount = (uint32_t)samples.size();
+    if (samples.empty())
+    { return summary; }
+
+    // Each percentile is selected from the partition above the previous one, so this is linear rather than a full sort
+    size_t p50 = PercentileIndex(samples.size(), 50);
+    size_t p95 = PercentileIndex(samples.size(), 95);
+    size_t p99 = PercentileIndex(samples.size(), 99);
+    std::nth_element(samples.begin(), samples.begin() + p50, samples.end());
+    if (p95 > p50)
+    { std::nth_element(samples.begin() + p50 + 1, samples.begin() + p95, samples.end()); }
+    if (p99 > p95)
+    { std::nth_element(samples.begin() + p95 + 1, samples.begin() + p99, samples.end()); }
+
+    summary.Min = *std::min_element(samples.begin(), samples.begin() + p50 + 1);
+    summary.Mean = total / (double)samples.size();
+    summary.P50 = samples[p50];
+    summary.P95 = samples[p95];
+    summary.P99 = samples[p99];
+    summary.Max = *std::max_element(samples.begin() + p99, samples.end());
+
+    for (uint32_t frame = 0; frame < FrameCount(); frame++)
+    {
+        float sample = Sample(frame, timer, domain);
+        if (sample < 0.f || !TimingHistory::IsHitch(sample, summary.P50))
+        { continue; }
+
+        summary.HitchCount++;
+        summary.LastHitchFrame = FrameNumbers[frame];
+    }
+
+    return summary;
+}
+
+void TimingHistorySnapshot::WriteJson(std::ostream& output) const
+{
+    using nlohmann::ordered_json;
+    ordered_json root;
+    root["FrameCount"] = FrameCount();
+    root["FirstFrame"] = FrameNumbers.empty() ? 0 : FrameNumbers.front();
+    root["LastFrame"] = FrameNumbers.empty() ? 0 : FrameNumbers.back();
+    root["HitchMedianFactor"] = TimingHistory::HITCH_MEDIAN_FACTOR;
+    root["HitchMinimumMs"] = TimingHistory::HITCH_MINIMUM_MS;
+
+    ordered_json& timers = root["Timers"] = ordered_json::object();
+    for (uint32_t timer = 0; timer < TimerCount(); timer++)
+    {
+        ordered_json& timerJson = timers[TimerNames[timer]];
+        for (uint32_t domain = 0; domain < DOMAIN_COUNT; domain++)
+        {
+            TimingSummary summary = Summarize(timer, (TimingDomain)domain);
+            ordered_json hitches = ordered_json::array();
+            for (uint32_t frame = 0; frame < FrameCount() && summary.HitchCount > 0; frame++)
+            {
+                float sample = Sample(frame, timer, (TimingDomain)domain);
+                if (sample >= 0.f && TimingHistory::IsHitch(sample, summary.P50))
+                { hitches.push_back(FrameNumbers[frame]); }
+            }
+
+            timerJson[DomainNames[domain]] =
+            {
+                { "SampleCount", summary.SampleCount },
+                { "SkippedCount", summary.SkippedCount },
+                { "Min", summary.Min },
+                { "Mean", summary.Mean },
+                { "P50", summary.P50 },
+                { "P95", summary.P95 },
+                { "P99", summary.P99 },
+                { "Max", summary.Max },
+                { "HitchFrames", std::move(hitches) },
+            };
+        }
+    }
+
+    ordered_json& frames = root["Frames"] = ordered_json::array();
+    for (uint32_t frame = 0; frame < FrameCount(); frame++)
+    {
+        ordered_json frameJson = { { "Frame", FrameNumbers[frame] } };
+        for (uint32_t domain = 0; domain < DOMAIN_COUNT; domain++)
+        {
+            ordered_json& domainJson = frameJson[DomainNames[domain]] = ordered_json::array();
+            for (uint32_t timer = 0; timer < TimerCount(); timer++)
+            {
+                float sample = Sample(frame, timer, (TimingDomain)domain);
+                if (sample < 0.f)
+                { domainJson.push_back(nullptr); }
+                else
+                { domainJson.push_back(sample); }
+            }
+        }
+        frames.push_back(std::move(frameJson));
+    }
+
+    output << root.dump(2) << '\n';
+}
+
+void TimingHistorySnapshot::WriteCsv(std::ostream& output) const
+{
+    output << "Frame";
+    for (const std::string& name : TimerNames)
+    {
+        for (uint32_t domain = 0; domain < DOMAIN_COUNT; domain++)
+        { output << ',' << name << ' ' << DomainNames[domain]; }
+    }
+    output << '\n';
+
+    for (uint32_t frame = 0; frame < FrameCount(); frame++)
+    {
+        output << FrameNumbers[frame];
+        for (uint32_t timer = 0; timer < TimerCount(); timer++)
+        {
+            for (uint32_t domain = 0; domain < DOMAIN_COUNT; domain++)
+            {
+                output << ',';
+                float sample = Sample(frame, timer, (TimingDomain)domain);
+                if (sample >= 0.f)
+                { output << sample; }
+            }
+        }
+        output << '\n';
+    }
+}
+
+TimingHistory::TimingHistory(std::vector<std::string> timerNames, uint32_t capacity)
+    : m_TimerNames(std::move(timerNames)), m_Capacity(capacity)
+{
+    Assert(m_Capacity > 0);
+    m_Samples = std::make_unique<std::atomic<float>[]>((size_t)m_Capacity * TimerCount() * DOMAIN_COUNT);
+    m_FrameNumbers = std::make_unique<std::atomic<uint64_t>[]>(m_Capacity);
+}
+
+void TimingHistory::Record(uint64_t frameNumber, std::span<const float> cpuMilliseconds, std::span<const float> gpuMilliseconds)
+{
+    Assert(cpuMilliseconds.size() == TimerCount() && gpuMilliseconds.size() == TimerCount());
+
+    // Announce the frame before overwriting the oldest one so that snapshots can tell its slot might have been clobbered while they were copying it
+    uint64_t index = m_StartedCount.load(std::memory_order_relaxed);
+    m_StartedCount.store(index + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    size_t slot = (size_t)(index % m_Capacity);
+    std::atomic<float>* samples = &m_Samples[slot * TimerCount() * DOMAIN_COUNT];
+    for (uint32_t timer = 0; timer < TimerCount(); timer++)
+    {
+        samples[timer * DOMAIN_COUNT + (uint32_t)TimingDomain::Cpu].store(cpuMilliseconds[timer] < 0.f ? SKIPPED : cpuMilliseconds[timer], std::memory_order_relaxed);
+        samples[timer * DOMAIN_COUNT + (uint32_t)TimingDomain::Gpu].store(gpuMilliseconds[timer] < 0.f ? SKIPPED : gpuMilliseconds[timer], std::memory_order_relaxed);
+    }
+    m_FrameNumbers[slot].store(frameNumber, std::memory_order_relaxed);
+
+    m_RecordedCount.store(index + 1, std::memory_order_release);
+}
+
+TimingHistorySnapshot TimingHistory::Snapshot() const
+{
+    TimingHistorySnapshot snapshot = { .TimerNames = m_TimerNames };
+
+    uint64_t recordedCount = m_RecordedCount.load(std::memory_order_acquire);
+    uint64_t firstFrame = recordedCount > m_Capacity ? recordedCount - m_Capacity : 0;
+    uint32_t frameCount = (uint32_t)(recordedCount - firstFrame);
+    size_t frameSize = (size_t)TimerCount() * DOMAIN_COUNT;
+
+    snapshot.FrameNumbers.resize(frameCount);
+    snapshot.Samples.resize(frameCount * frameSize);
+    for (uint32_t i = 0; i < frameCount; i++)
+    {
+        size_t slot = (size_t)((firstFrame + i) % m_Capacity);
+        snapshot.FrameNumbers[i] = m_FrameNumbers[slot].load(std::memory_order_relaxed);
+        for (size_t j = 0; j < frameSize; j++)
+        { snapshot.Samples[i * frameSize + j] = m_Samples[slot * frameSize + j].load(std::memory_order_relaxed); }
+    }
+
+    // If we read anything written by a frame which started after recordedCount, we're guaranteed to see it started here
+    // Every frame whose slot was reused by a frame which started is dropped since it may be a mix of the old and new frame.
+    std::atomic_thread_fence(std::memory_order_acquire);
+    uint64_t startedCount = m_StartedCount.load(std::memory_order_relaxed);
+    uint64_t firstIntactFrame = startedCount > m_Capacity ? startedCount - m_Capacity : 0;
+    if (firstIntactFrame > firstFrame)
+    {
+        uint32_t tornCount = (uint32_t)std::min(firstIntactFrame - firstFrame, (uint64_t)frameCount);
+        snapshot.FrameNumbers.erase(snapshot.FrameNumbers.begin(), snapshot.FrameNumbers.begin() + tornCount);
+        snapshot.Samples.erase(snapshot.Samples.begin(), snapshot.Samples.begin() + tornCount * frameSize);
+    }
+
+    return snapshot;
+}
+
+bool TimingHistory::Export(const std::string& filePath) const
+{
+    std::ofstream file(filePath, std::ios::out | std::ios::trunc);
+    if (!file)
+    {
+        printf("Warning: Failed to open '%s' to export timing history.\n", filePath.c_str());
+        return false;
+    }
+
+    TimingHistorySnapshot snapshot = Snapshot();
+    std::string extension = std::filesystem::path(filePath).extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](char c) { return (char)std::tolower((unsigned char)c); });
+    if (extension == ".csv")
+    { snapshot.WriteCsv(file); }
+    else
+    { snapshot.WriteJson(file); }
+
+    file.close();
+    if (!file)
+    {
+        printf("Warning: Failed to write timing history to '%s'.\n", filePath.c_str());
+        return false;
+    }
+
+    printf("Exported %u frames of timing history to '%s'.\n", snapshot.FrameCount(), filePath.c_str());
+    return true;
+}
+
+TimingHistoryBenchmark TimingHistory::Benchmark(uint32_t timerCount, uint32_t capacity, uint32_t frameCount)
+{
+    Assert(timerCount > 0 && frameCount > 0);
+    using Clock = std::chrono::steady_clock;
+    auto Seconds = [](Clock::time_point start) { return std::chrono::duration<double>(Clock::now() - start).count(); };
+
+    std::vector<std::string> names;
+    for (uint32_t i = 0; i < timerCount; i++)
+    { names.push_back("Timer" + std::to_string(i)); }
+    TimingHistory history(std::move(names), capacity);
+
+    // Generate the samples using a fixed LCG so that every run records the same data
+    // Each timer jitters around its own base time, skips a frame now and then, and hitches every so often
+    uint32_t seed = 0x5EED;
+    auto Random = [&]()
+        {
+            seed = seed * 1664525 + 1013904223;
+            return (float)(seed >> 8) / (float)(1 << 24);
+        };
+
+    std::vector<float> cpuSamples((size_t)frameCount * timerCount);
+    std::vector<float> gpuSamples((size_t)frameCount * timerCount);
+    for (uint32_t frame = 0; frame < frameCount; frame++)
+    {
+        for (uint32_t timer = 0; timer < timerCount; timer++)
+        {
+            float baseTime = 0.25f + (float)timer * 0.5f;
+            float hitch = Random() < 0.01f ? 4.f : 1.f;
+            size_t i = (size_t)frame * timerCount + timer;
+            cpuSamples[i] = Random() < 0.02f ? SKIPPED : baseTime * (0.9f + Random() * 0.2f) * hitch;
+            gpuSamples[i] = Random() < 0.02f ? SKIPPED : baseTime * (0.9f + Random() * 0.2f) * hitch;
+        }
+    }
+
+    TimingHistoryBenchmark result = { .TimerCount = timerCount, .Capacity = capacity, .FrameCount = frameCount };
+
+    Clock::time_point start = Clock::now();
+    for (uint32_t frame = 0; frame < frameCount; frame++)
+    {
+        std::span<const float> cpu(cpuSamples.data() + (size_t)frame * timerCount, timerCount);
+        std::span<const float> gpu(gpuSamples.data() + (size_t)frame * timerCount, timerCount);
+        history.Record(frame, cpu, gpu);
+    }
+    result.RecordSeconds = Seconds(start) / frameCount;
+
+    const uint32_t iterationCount = 100;
+    TimingHistorySnapshot snapshot;
+    start = Clock::now();
+    for (uint32_t iteration = 0; iteration < iterationCount; iteration++)
+    { snapshot = history.Snapshot(); }
+    result.SnapshotSeconds = Seconds(start) / iterationCount;
+    Assert(snapshot.FrameCount() == std::min(frameCount, capacity));
+
+    start = Clock::now();
+    for (uint32_t iteration = 0; iteration < iterationCount; iteration++)
+    {
+        for (uint32_t timer = 0; timer < timerCount; timer++)
+        {
+            for (uint32_t domain = 0; domain < DOMAIN_COUNT; domain++)
+            {
+                TimingSummary summary = snapshot.Summarize(timer, (TimingDomain)domain);
+                Assert(summary.Min <= summary.P50 && summary.P50 <= summary.P95 && summary.P95 <= summary.P99 && summary.P99 <= summary.Max);
+            }
+        }
+    }
+    result.SummarizeSeconds = Seconds(start) / iterationCount;
+
+    return result;
+}
@@ -0,0 +1,120 @@
+#pragma once
+#include <atomic>
+#include <iosfwd>
+#include <memory>
+#include <span>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+//! The clock a timing sample was measured with
+enum class TimingDomain
+{
+    Cpu,
+    Gpu,
+    Count
+};
+
+//! Rolling statistics for one timer over the frames of a TimingHistorySnapshot, all times are in milliseconds
+//! Frames where the timer wasn't captured are excluded, every time is 0 when there are no samples.
+struct TimingSummary
+{
+    uint32_t SampleCount;
+    uint32_t SkippedCount;
+    double Min;
+    double Mean;
+    double P50;
+    double P95;
+    double P99;
+    double Max;
+    //! Samples which were hitches, see TimingHistory::IsHitch
+    uint32_t HitchCount;
+    uint64_t LastHitchFrame; //!< UINT64_MAX when there were no hitches
+};
+
+//! A copy of the frames held by a TimingHistory, oldest first
+struct TimingHistorySnapshot
+{
+    std::vector<std::string> TimerNames;
+    std::vector<uint64_t> FrameNumbers;
+    //! Indexed by [frame][timer][domain], skipped timers are TimingHistory::SKIPPED
+    std::vector<float> Samples;
+
+    inline uint32_t FrameCount() const { return (uint32_t)FrameNumbers.size(); }
+    inline uint32_t TimerCount() const { return (uint32_t)TimerNames.size(); }
+    inline float Sample(uint32_t frame, uint32_t timer, TimingDomain domain) const
+    { return Samples[((size_t)frame * TimerCount() + timer) * (size_t)TimingDomain::Count + (size_t)domain]; }
+
+    TimingSummary Summarize(uint32_t timer, TimingDomain domain) const;
+
+    //! Writes the summary of every timer followed by every frame's samples, skipped samples are written as null
+    void WriteJson(std::ostream& output) const;
+    //! Writes a row per frame with a CPU and GPU column per timer, skipped samples are left empty
+    void WriteCsv(std::ostream& output) const;
+};
+
+//! Timings from TimingHistory::Benchmark, in seconds per operation
+struct TimingHistoryBenchmark
+{
+    uint32_t TimerCount;
+    uint32_t Capacity;
+    uint32_t FrameCount;
+    double RecordSeconds; //!< Per recorded frame
+    double SnapshotSeconds; //!< Per snapshot of a full history
+    double SummarizeSeconds; //!< Per summary of every timer in both domains
+};
+
+//! A ring of per-frame timer samples for spotting spikes and jitter which a single frame's timings hide
+//!
+//! One thread records a frame at a time while any number of other threads take snapshots without locks. Samples are stored in atomics and snapshots detect
+//! frames which were overwritten while they were being copied (like a seqlock) and drop them, so a snapshot never contains a torn frame.
+//! This type has no dependency on D3D (or Windows) so that it can be tested and benchmarked with synthetic samples, see FrameStatistics for where it's fed.
+class TimingHistory
+{
+public:
+    static constexpr uint32_t DEFAULT_CAPACITY = 1024;
+    //! Recorded for timers which weren't captured during a frame
+    static constexpr float SKIPPED = -1.f;
+    //! A sample is a hitch when it's at least this many times the median of its timer...
+    static constexpr double HITCH_MEDIAN_FACTOR = 2.0;
+    //! ...and at least this many milliseconds above it, so that cheap timers jittering by fractions of a millisecond aren't hitches
+    static constexpr double HITCH_MINIMUM_MS = 1.0;
+
+private:
+    std::vector<std::string> m_TimerNames;
+    const uint32_t m_Capacity;
+
+    // Indexed by [frame % capacity][timer][domain]
+    std::unique_ptr<std::atomic<float>[]> m_Samples;
+    std::unique_ptr<std::atomic<uint64_t>[]> m_FrameNumbers;
+
+    // Frames [0, m_RecordedCount) have been recorded, frame m_StartedCount - 1 may be in the middle of being written
+    std::atomic<uint64_t> m_StartedCount = 0;
+    std::atomic<uint64_t> m_RecordedCount = 0;
+
+public:
+    TimingHistory(std::vector<std::string> timerNames, uint32_t capacity = DEFAULT_CAPACITY);
+    TimingHistory(const TimingHistory&) = delete;
+
+    //! Records a frame's samples in milliseconds, indexed by timer, negative samples are recorded as skipped
+    //! Only one thread may record at a time.
+    void Record(uint64_t frameNumber, std::span<const float> cpuMilliseconds, std::span<const float> gpuMilliseconds);
+
+    //! Copies the most recent frames (up to the capacity) without blocking the recording thread
+    TimingHistorySnapshot Snapshot() const;
+
+    //! Writes a snapshot to the specified file, as CSV if its extension is .csv and JSON otherwise
+    //! Returns false if the file couldn't be written.
+    bool Export(const std::string& filePath) const;
+
+    inline uint32_t Capacity() const { return m_Capacity; }
+    inline uint32_t TimerCount() const { return (uint32_t)m_TimerNames.size(); }
+    inline const std::string& TimerName(uint32_t timer) const { return m_TimerNames[timer]; }
+    inline uint64_t RecordedFrameCount() const { return m_RecordedCount.load(std::memory_order_acquire); }
+
+    static inline bool IsHitch(double sample, double median)
+    { return sample >= median * HITCH_MEDIAN_FACTOR && sample >= median + HITCH_MINIMUM_MS; }
+
+    //! Records frameCount frames of synthetic samples (with occasional hitches) and times recording, snapshotting, and summarizing them
+    static TimingHistoryBenchmark Benchmark(uint32_t timerCount, uint32_t capacity, uint32_t frameCount);
+};
@@ -0,0 +1,124 @@
+#include "pch.h"
+#include "TransparentDrawList.h"
+
+#include "JobSystem.h"
+#include "Stopwatch.h"
+
+#include <algorithm>
+#include <bit>
+
+namespace
+{
+    // Maps a float to an unsigned integer with the same ordering (IE: negative floats have their bits flipped and positive ones have their sign set)
+    inline uint32_t SortableFloatBits(float value)
+    {
+        uint32_t bits = std::bit_cast<uint32_t>(value);
+        uint32_t mask = (uint32_t)((int32_t)bits >> 31) | 0x80000000;
+        return bits ^ mask;
+    }
+}
+
+TransparentDrawList::TransparentDrawList(const DrawList& drawList)
+    : m_Packets(drawList.Packets().begin(), drawList.Packets().end()), m_Nodes(drawList.Nodes().begin(), drawList.Nodes().end()), m_PrimitiveCount(drawList.PrimitiveCount())
+{
+    Assert(drawList.Pass() == DrawListPass::Transparent);
+    m_DrawOrder.reserve(m_Packets.size());
+    m_SortKeys.reserve(m_Packets.size());
+}
+
+void TransparentDrawList::BuildSortKeys(JobSystem& jobs, std::span<const DrawPacket> packets, std::span<const uint32_t> order, const float4x4& viewTransform, std::span<uint64_t> keys)
+{
+    Assert(order.size() == keys.size());
+
+    const uint32_t count = (uint32_t)order.size();
+    const uint32_t jobCount = std::clamp(count / MinKeysPerJob, 1u, jobs.WorkerCount() + 1);
+    const uint32_t keysPerJob = (count + jobCount - 1) / jobCount;
+
+    jobs.ParallelFor(jobCount, [&](uint32_t job)
+        {
+            const float4x4& m = viewTransform;
+            uint32_t end = std::min(count, (job + 1) * keysPerJob);
+            for (uint32_t i = job * keysPerJob; i < end; i++)
+            {
+                const DrawPacket& packet = packets[order[i]];
+                float3 center = packet.BoundsCenter;
+                float depth = center.x * m.m02 + center.y * m.m12 + center.z * m.m22 + m.m32;
+
+                uint32_t pipelineOrdinal = (uint32_t)(packet.SortKey >> 48);
+                uint64_t state = (pipelineOrdinal << 16) | (packet.MaterialId & 0xFFFF);
+                keys[i] = ((uint64_t)~SortableFloatBits(depth) << 32) | state;
+            }
+        });
+}
+
+void TransparentDrawList::Sort(JobSystem& jobs, const float4x4& viewTransform, std::span<const uint8_t> primitiveVisibility)
+{
+    Assert(primitiveVisibility.empty() || primitiveVisibility.size() == m_PrimitiveCount);
+
+    m_DrawOrder.clear();
+    for (uint32_t i = 0; i < m_Packets.size(); i++)
+    {
+        if (primitiveVisibility.empty() || primitiveVisibility[m_Packets[i].PrimitiveIndex])
+        { m_DrawOrder.push_back(i); }
+    }
+
+    m_SortKeys.resize(m_DrawOrder.size());
+    BuildSortKeys(jobs, m_Packets, m_DrawOrder, viewTransform, m_SortKeys);
+    m_Sorter.Sort(jobs, m_SortKeys, m_DrawOrder);
+}
+
+TransparentSortBenchmark TransparentDrawList::Benchmark(JobSystem& jobs, uint32_t drawCount, uint32_t iterationCount)
+{
+    Assert(iterationCount > 0);
+
+    // Scatter the packets through a cube around the camera using a fixed LCG so that every run sorts the same data
+    std::vector<DrawPacket> packets(drawCount);
+    uint32_t seed = 0x5EED;
+    auto Random = [&]()
+        {
+            seed = seed * 1664525 + 1013904223;
+            return (float)(seed >> 8) / (float)(1 << 24);
+        };
+
+    for (uint32_t i = 0; i < drawCount; i++)
+    {
+        packets[i] =
+        {
+            .SortKey = (uint64_t)(i % 8) << 48,
+            .NodeIndex = i,
+            .PrimitiveIndex = i,
+            .MaterialId = i % 64,
+            .BoundsCenter = float3(Random() * 200.f - 100.f, Random() * 200.f - 100.f, Random() * 200.f - 100.f),
+        };
+    }
+
+    std::vector<uint32_t> order(drawCount);
+    std::vector<uint64_t> keys(drawCount);
+    RadixSorter sorter;
+
+    TransparentSortBenchmark result = { .DrawCount = drawCount, .IterationCount = iterationCount };
+    for (uint32_t iteration = 0; iteration < iterationCount; iteration++)
+    {
+        // Orbit the camera a little each iteration so that the keys change like they would between frames
+        float angle = (float)iteration * 0.1f;
+        float3 eye(std::cos(angle) * 50.f, 10.f, std::sin(angle) * 50.f);
+        float4x4 viewTransform = float4x4::MakeCameraLookAtViewTransform(eye, float3::Zero, float3::UnitY);
+
+        for (uint32_t i = 0; i < drawCount; i++)
+        { order[i] = i; }
+
+        Stopwatch stopwatch;
+        BuildSortKeys(jobs, packets, order, viewTransform, keys);
+        result.BuildKeysSeconds += stopwatch.ElapsedSeconds();
+
+        stopwatch.Restart();
+        sorter.Sort(jobs, keys, order);
+        result.SortSeconds += stopwatch.ElapsedSeconds();
+
+        Assert(std::is_sorted(keys.begin(), keys.end()));
+    }
+
+    result.BuildKeysSeconds /= iterationCount;
+    result.SortSeconds /= iterationCount;
+    return result;
+}
@@ -0,0 +1,132 @@
+#pragma once
+#include "DrawList.h"
+#include "RadixSort.h"
+
+#include <span>
+#include <vector>
+
+class JobSystem;
+
+//! Timings from TransparentDrawList::Benchmark, in seconds per sort
+struct TransparentSortBenchmark
+{
+    uint32_t DrawCount;
+    uint32_t IterationCount;
+    double BuildKeysSeconds;
+    double SortSeconds;
+};
+
+//! Per-frame sorted counterpart to DrawList for DrawListPass::Transparent
+//! Alpha blending only composites correctly back to front, so unlike the other draw lists the packet order can't be baked up-front. Every frame the
+//! visible packets are given a 64-bit key from their view depth and state and radix sorted on the job system before being submitted in that order.
+class TransparentDrawList
+{
+private:
+    std::vector<DrawPacket> m_Packets;
+    std::vector<ShaderInterop::PerNodeCb> m_Nodes;
+    uint32_t m_PrimitiveCount = 0;
+
+    // Indices of m_Packets in submission order, only valid after Sort
+    std::vector<uint32_t> m_DrawOrder;
+    std::vector<uint64_t> m_SortKeys;
+    RadixSorter m_Sorter;
+
+    // Packets per job when building sort keys
+    static constexpr uint32_t MinKeysPerJob = 4096;
+
+public:
+    //! The draw list must have been built for DrawListPass::Transparent, it does not need to outlive the transparent draw list
+    explicit TransparentDrawList(const DrawList& drawList);
+    TransparentDrawList(const TransparentDrawList&) = delete;
+
+    inline std::span<const DrawPacket> Packets() const { return m_Packets; }
+    inline uint32_t DrawCount() const { return (uint32_t)m_DrawOrder.size(); }
+
+    //! Key layout, most significant first:
+    //! [63:32] Inverted view depth of the packet's bounds, so that farther packets sort first
+    //! [31:16] Pipeline state ordinal (From DrawPacket::SortKey)
+    //! [15:0] Material ID
+    //! Packets at exactly the same depth (IE: decals or glass panes split into several primitives) are grouped by state so they don't thrash it.
+    static void BuildSortKeys(JobSystem& jobs, std::span<const DrawPacket> packets, std::span<const uint32_t> order, const float4x4& viewTransform, std::span<uint64_t> keys);
+
+    //! Gathers the visible packets and sorts them back to front as seen through the specified view transform
+    void Sort(JobSystem& jobs, const float4x4& viewTransform, std::span<const uint8_t> primitiveVisibility = { });
+
+    //! Records the draws in the order determined by the last call to Sort, see DrawList::Submit
+    //! Transparent primitives are always drawn using their full detail geometry since their LODs would pop through whatever is behind them.
+    template<typename TCommandList>
+    DrawListStatistics Submit(TCommandList* commandList) const;
+
+    //! Times building keys for and sorting drawCount synthetic packets, used by the --benchmark-transparent-sort command line option
+    static TransparentSortBenchmark Benchmark(JobSystem& jobs, uint32_t drawCount, uint32_t iterationCount);
+};
+
+template<typename TCommandList>
+DrawListStatistics TransparentDrawList::Submit(TCommandList* commandList) const
+{
+    static constexpr uint32_t PerPrimitiveConstantsOffset = offsetof(ShaderInterop::PerNodeCb, MaterialId) / sizeof(uint32_t);
+    static constexpr uint32_t PerPrimitiveConstantsCount = sizeof(ShaderInterop::PerNodeCb) / sizeof(uint32_t) - PerPrimitiveConstantsOffset;
+
+    DrawListStatistics statistics = { };
+    const DrawPacket* previous = nullptr;
+
+    for (uint32_t packetIndex : m_DrawOrder)
+    {
+        const DrawPacket& packet = m_Packets[packetIndex];
+
+        if (previous == nullptr || packet.PipelineState != previous->PipelineState)
+        {
+            commandList->SetPipelineState(packet.PipelineState);
+            statistics.PipelineStateChanges++;
+        }
+
+        auto SetVertexBuffer = [&](UINT slot, const D3D12_VERTEX_BUFFER_VIEW& view, const D3D12_VERTEX_BUFFER_VIEW* previousView)
+            {
+                if (previousView != nullptr && memcmp(&view, previousView, sizeof(view)) == 0)
+                { return; }
+
+                commandList->IASetVertexBuffers(slot, 1, &view);
+                statistics.VertexBufferChanges++;
+            };
+
+        SetVertexBuffer(MeshInputSlot::Position, packet.Positions, previous == nullptr ? nullptr : &previous->Positions);
+        SetVertexBuffer(MeshInputSlot::Normal, packet.Normals, previous == nullptr ? nullptr : &previous->Normals);
+        SetVertexBuffer(MeshInputSlot::Uv0, packet.Uvs, previous == nullptr ? nullptr : &previous->Uvs);
+
+        if (previous == nullptr || packet.NodeIndex != previous->NodeIndex)
+        {
+            ShaderInterop::PerNodeCb perNode = m_Nodes[packet.NodeIndex];
+            perNode.MaterialId = packet.MaterialId;
+            perNode.ColorsIndex = packet.ColorsIndex;
+            perNode.TangentsIndex = packet.TangentsIndex;
+            commandList->SetGraphicsRoot32BitConstants(ShaderInterop::Pbr::RpPerNodeCb, sizeof(perNode) / sizeof(uint32_t), &perNode, 0);
+            statistics.RootConstantChanges++;
+        }
+        else if (packet.MaterialId != previous->MaterialId || packet.ColorsIndex != previous->ColorsIndex || packet.TangentsIndex != previous->TangentsIndex)
+        {
+            uint32_t perPrimitive[] = { packet.MaterialId, packet.ColorsIndex, packet.TangentsIndex };
+            static_assert(std::size(perPrimitive) == PerPrimitiveConstantsCount);
+            commandList->SetGraphicsRoot32BitConstants(ShaderInterop::Pbr::RpPerNodeCb, PerPrimitiveConstantsCount, perPrimitive, PerPrimitiveConstantsOffset);
+            statistics.RootConstantChanges++;
+        }
+
+        if (packet.IsIndexed)
+        {
+            if (previous == nullptr || !previous->IsIndexed || memcmp(&packet.Indices, &previous->Indices, sizeof(packet.Indices)) != 0)
+            {
+                commandList->IASetIndexBuffer(&packet.Indices);
+                statistics.IndexBufferChanges++;
+            }
+
+            commandList->DrawIndexedInstanced(packet.VertexOrIndexCount, 1, 0, 0, 0);
+        }
+        else
+        { commandList->DrawInstanced(packet.VertexOrIndexCount, 1, 0, 0); }
+
+        statistics.DrawCount++;
+        statistics.InstanceCount++;
+        previous = &packet;
+    }
+
+    return statistics;
+}
@@ -7,11 +7,15 @@
 #include "DearImGui.h"
 #include "DebugLayer.h"
 #include "FrameStatistics.h"
+#include "GpuRenderGraph.h"
+#include "GpuTextureStreamer.h"
+#include "GraphicsCore.h"
 #include "LightLinkedList.h"
 #include "ParticleSystem.h"
 #include "ParticleSystemDefinition.h"
 
 #include <imgui_internal.h>
+#include <span>
 
 Ui::Ui(GraphicsCore& graphics, Window& window, DearImGui& dearImGui, CameraController& camera, CameraInput& cameraInput, FrameStatistics& stats)
     : m_Graphics(graphics), m_Window(window), m_DearImGui(dearImGui), m_Camera(camera), m_CameraInput(cameraInput), m_Stats(stats)
@@ -178,6 +182,37 @@ void Ui::SubmitParticleSystemEditor(ComputeContext& context, ParticleSystem& par
         ImGui::ColorEdit3("Base color", &particleSystemDefinition.BaseColor.x);
         ImGui::DragFloatRange2("Shade", &particleSystemDefinition.MinShade, &particleSystemDefinition.MaxShade, 0.001f, 0.f, 1.f, "%.3f", nullptr, ImGuiSliderFlags_AlwaysClamp);
 
+        ImGui::SeparatorText("Lighting");
+        ParticleLightingMode lightingMode = particleSystem.LightingMode();
+        if (ImGui::Combo("Lighting", (int*)&lightingMode, ParticleLightingModeNames))
+        { particleSystem.LightingMode(lightingMode); }
+        ImGui::SetItemTooltip("Per particle lighting is much cheaper when particles overlap,\nbut ignores normal maps and lighting variation across each particle.");
+
+        ImGui::SeparatorText("Sorting");
+        ParticleSortMode sortMode = particleSystem.SortMode();
+        if (ImGui::Combo("Sort mode", (int*)&sortMode, ParticleSortModeNames))
+        { particleSystem.SortMode(sortMode); }
+
+        if (sortMode == ParticleSortMode::Temporal)
+        {
+            float maxDisorderRatio = particleSystem.MaxSortDisorderRatio();
+            if (ImGui::SliderFloat("Max disorder", &maxDisorderRatio, 0.f, 1.f, "%.3f", ImGuiSliderFlags_AlwaysClamp))
+            { particleSystem.MaxSortDisorderRatio(maxDisorderRatio); }
+        }
+
+        ImGui::SeparatorText("Dispatch statistics");
+        {
+            const ShaderInterop::ParticleDispatchStatistics& dispatchStats = particleSystem.DispatchStatistics();
+            auto dispatchRow = [](const char* name, uint32_t dispatched, uint32_t useful)
+            {
+                float efficiency = dispatched == 0 ? 100.f : (float)useful / (float)dispatched * 100.f;
+                ImGui::Text("%s: %u / %u threads (%.0f%%)", name, useful, dispatched, efficiency);
+            };
+            dispatchRow("Update", dispatchStats.UpdateThreadsDispatched, dispatchStats.UpdateThreadsUseful);
+            dispatchRow("Spawn", dispatchStats.SpawnThreadsDispatched, dispatchStats.SpawnThreadsUseful);
+            ImGui::Text("Capacity: %u particles", particleSystem.Capacity());
+        }
+
         ImGui::SeparatorText("Commands");
         if (ImGui::Button("Reset", ImVec2(-1.f, 0.f)))
             particleSystem.Reset(context);
@@ -201,10 +236,20 @@ void Ui::SubmitParticleSystemEditor(ComputeContext& context, ParticleSystem& par
     }
 }
 
-static void TimerRow(FrameStatistics& stats, float timeWidth, const char* name, Timer timer)
+static void PercentileCell(const TimingSummary& summary, float timeWidth)
+{
+    if (summary.SampleCount == 0)
+        ImGui::RightAlignedText("N/A", timeWidth);
+    else
+        ImGui::RightAlignedText(std::format("{:0.2f}", summary.P99), timeWidth);
+}
+
+static void TimerRow(FrameStatistics& stats, std::span<const TimingSummary> summaries, float timeWidth, const char* name, Timer timer)
 {
     double elapsedCpu = stats.GetElapsedTimeCpu(timer);
     double elapsedGpu = stats.GetElapsedTimeGpu(timer);
+    const TimingSummary& summaryCpu = summaries[(size_t)timer * (size_t)TimingDomain::Count + (size_t)TimingDomain::Cpu];
+    const TimingSummary& summaryGpu = summaries[(size_t)timer * (size_t)TimingDomain::Count + (size_t)TimingDomain::Gpu];
 
     ImGui::TableNextRow();
     ImGui::TableSetColumnIndex(0);
@@ -219,15 +264,21 @@ static void TimerRow(FrameStatistics& stats, float timeWidth, const char* name,
         ImGui::RightAlignedText(std::format("{:0.2f}", elapsedGpu * 1000.0), timeWidth);
 
     ImGui::TableSetColumnIndex(2);
+    PercentileCell(summaryGpu, timeWidth);
+
+    ImGui::TableSetColumnIndex(3);
     if (elapsedCpu == FrameStatistics::TIMER_SKIPPED)
         ImGui::RightAlignedText("N/A", timeWidth);
     else if (elapsedCpu == FrameStatistics::TIMER_INVALID)
         ImGui::RightAlignedText("ERROR", timeWidth);
     else
         ImGui::RightAlignedText(std::format("{:0.2f}", elapsedCpu * 1000.0), timeWidth);
+
+    ImGui::TableSetColumnIndex(4);
+    PercentileCell(summaryCpu, timeWidth);
 }
 
-void Ui::SubmitTimingStatisticsWindow()
+void Ui::SubmitTimingStatisticsWindow(GpuTextureStreamer& textureStreamer, const GpuRenderGraph& renderGraph)
 {
     ImGuiViewport* mainViewport = ImGui::GetMainViewport();
     ImGui::SetNextWindowPos(ImVec2(m_CentralNode->Pos.x + m_CentralNode->Size.x, m_CentralNode->Pos.y), ImGuiCond_Always, ImVec2(1.f, 0.f));
@@ -236,13 +287,30 @@ void Ui::SubmitTimingStatisticsWindow()
     ImGui::PushStyleVar(ImGuiStyleVar_WindowPadding, ImVec2(5.f, 0.f));
     if (ImGui::Begin2("Timing Statistics", &ShowTimingStatisticsWindow, flags))
     {
+        // Refresh the rolling statistics
+        const TimingHistory& history = m_Stats.History();
+        uint64_t recordedFrameCount = history.RecordedFrameCount();
+        if (m_TimingSummaries.empty() || recordedFrameCount >= m_TimingSummariesRecordedFrameCount + TIMING_SUMMARY_INTERVAL)
+        {
+            TimingHistorySnapshot snapshot = history.Snapshot();
+            m_TimingSummaries.resize((size_t)Timer::COUNT * (size_t)TimingDomain::Count);
+            for (uint32_t timer = 0; timer < (uint32_t)Timer::COUNT; timer++)
+            {
+                for (uint32_t domain = 0; domain < (uint32_t)TimingDomain::Count; domain++)
+                { m_TimingSummaries[timer * (uint32_t)TimingDomain::Count + domain] = snapshot.Summarize(timer, (TimingDomain)domain); }
+            }
+            m_TimingSummariesRecordedFrameCount = recordedFrameCount;
+        }
+
         ImGuiTableFlags tableFlags = 0;
-        if (ImGui::BeginTable("TimingStats", 3, tableFlags))
+        if (ImGui::BeginTable("TimingStats", 5, tableFlags))
         {
             float maxTimeWidth = ImGui::CalcTextSize("999.99").x;
             ImGui::TableSetupColumn("Measurement");
             ImGui::TableSetupColumn("GPU", ImGuiTableColumnFlags_WidthFixed, maxTimeWidth);
+            ImGui::TableSetupColumn("GPU p99", ImGuiTableColumnFlags_WidthFixed, maxTimeWidth);
             ImGui::TableSetupColumn("CPU", ImGuiTableColumnFlags_WidthFixed, maxTimeWidth);
+            ImGui::TableSetupColumn("CPU p99", ImGuiTableColumnFlags_WidthFixed, maxTimeWidth);
 
             ImGui::TableNextRow();
             ImGui::TableSetColumnIndex(0);
@@ -250,27 +318,133 @@ void Ui::SubmitTimingStatisticsWindow()
             ImGui::TableSetColumnIndex(1);
             ImGui::RightAlignedText("GPU", maxTimeWidth);
             ImGui::TableSetColumnIndex(2);
+            ImGui::RightAlignedText("p99", maxTimeWidth);
+            ImGui::TableSetColumnIndex(3);
             ImGui::RightAlignedText("CPU", maxTimeWidth);
-
-            TimerRow(m_Stats, maxTimeWidth, "FrameSetup", Timer::FrameSetup);
-            TimerRow(m_Stats, maxTimeWidth, "ParticleUpdate", Timer::ParticleUpdate);
-            TimerRow(m_Stats, maxTimeWidth, "DepthPrePass", Timer::DepthPrePass);
-            TimerRow(m_Stats, maxTimeWidth, "DepthDownsample", Timer::DownsampleDepth);
-            TimerRow(m_Stats, maxTimeWidth, "FillLightLinkedList", Timer::FillLightLinkedList);
-            TimerRow(m_Stats, maxTimeWidth, "OpaquePass", Timer::OpaquePass);
-            TimerRow(m_Stats, maxTimeWidth, "ParticleRender", Timer::ParticleRender);
-            TimerRow(m_Stats, maxTimeWidth, "DebugOverlay", Timer::DebugOverlay);
-            TimerRow(m_Stats, maxTimeWidth, "UI", Timer::UI);
-            TimerRow(m_Stats, maxTimeWidth, "Present", Timer::Present);
-            TimerRow(m_Stats, maxTimeWidth, "FrameTotal", Timer::FrameTotal);
+            ImGui::TableSetColumnIndex(4);
+            ImGui::RightAlignedText("p99", maxTimeWidth);
+
+            TimerRow(m_Stats, m_TimingSummaries, maxTimeWidth, "FrameSetup", Timer::FrameSetup);
+            TimerRow(m_Stats, m_TimingSummaries, maxTimeWidth, "ParticleUpdate", Timer::ParticleUpdate);
+            TimerRow(m_Stats, m_TimingSummaries, maxTimeWidth, "SceneCulling", Timer::SceneCulling);
+            TimerRow(m_Stats, m_TimingSummaries, maxTimeWidth, "DepthPrePass", Timer::DepthPrePass);
+            TimerRow(m_Stats, m_TimingSummaries, maxTimeWidth, "DepthDownsample", Timer::DownsampleDepth);
+            TimerRow(m_Stats, m_TimingSummaries, maxTimeWidth, "FillLightLinkedList", Timer::FillLightLinkedList);
+            TimerRow(m_Stats, m_TimingSummaries, maxTimeWidth, "OpaquePass", Timer::OpaquePass);
+            TimerRow(m_Stats, m_TimingSummaries, maxTimeWidth, "TransparentPass", Timer::TransparentPass);
+            TimerRow(m_Stats, m_TimingSummaries, maxTimeWidth, "ParticleRender", Timer::ParticleRender);
+            TimerRow(m_Stats, m_TimingSummaries, maxTimeWidth, "DebugOverlay", Timer::DebugOverlay);
+            TimerRow(m_Stats, m_TimingSummaries, maxTimeWidth, "UI", Timer::UI);
+            TimerRow(m_Stats, m_TimingSummaries, maxTimeWidth, "Present", Timer::Present);
+            TimerRow(m_Stats, m_TimingSummaries, maxTimeWidth, "FrameTotal", Timer::FrameTotal);
 
             ImGui::EndTable();
         }
+
+        const TimingSummary& frameGpu = m_TimingSummaries[(size_t)Timer::FrameTotal * (size_t)TimingDomain::Count + (size_t)TimingDomain::Gpu];
+        const TimingSummary& frameCpu = m_TimingSummaries[(size_t)Timer::FrameTotal * (size_t)TimingDomain::Count + (size_t)TimingDomain::Cpu];
+        ImGui::Text("Frame time over %u frames: GPU %.2f / %.2f / %.2f ms, CPU %.2f / %.2f / %.2f ms (p50 / p95 / max)", frameGpu.SampleCount, frameGpu.P50, frameGpu.P95, frameGpu.Max, frameCpu.P50, frameCpu.P95, frameCpu.Max);
+        ImGui::Text("Frame hitches: %u GPU, %u CPU", frameGpu.HitchCount, frameCpu.HitchCount);
+
+        ResourceDescriptorManager& descriptorManager = m_Graphics.ResourceDescriptorManager();
+        DescriptorAllocatorStatistics descriptors = descriptorManager.ResidentStatistics();
+        ImGui::Text("Resident descriptors: %u / %u (%u pending free)", descriptors.LiveCount, descriptors.Capacity, descriptorManager.PendingFreeCount());
+        ImGui::Text("Descriptor fragmentation: %.1f%% (largest hole %u)", descriptors.Fragmentation() * 100.f, descriptors.LargestFreeRun);
+        DescriptorRingStatistics dynamicDescriptors = descriptorManager.DynamicStatistics();
+        ImGui::Text("Dynamic descriptors: %u / %u (peak %u, %u frames in flight, %u stalls)", dynamicDescriptors.UsedCount, dynamicDescriptors.Capacity, dynamicDescriptors.HighWaterMark, dynamicDescriptors.InFlightFrameCount, descriptorManager.DynamicStallCount());
+
+        GpuMemoryManager& memoryManager = m_Graphics.GpuMemoryManager();
+        ImGui::Text("Placed resource heaps: %.1f MB", (float)memoryManager.ReservedHeapBytes() / (1024.f * 1024.f));
+        for (size_t i = 0; i < (size_t)GpuMemoryCategory::Count; i++)
+        {
+            GpuMemoryCategoryStatistics memory = memoryManager.CategoryStatistics((GpuMemoryCategory)i);
+            ImGui::Text("  %s: %.1f MB (%u resources, %u placed)", GpuMemoryCategoryName((GpuMemoryCategory)i), (float)memory.UsedBytes / (1024.f * 1024.f), memory.ResourceCount, memory.PlacedResourceCount);
+        }
+
+        const RenderGraphMemoryReport& graph = renderGraph.MemoryReport();
+        ImGui::Text("Render graph: %u passes (%u culled), %u transients (%u culled)", graph.PassCount, graph.CulledPassCount, graph.TransientCount, graph.CulledTransientCount);
+        ImGui::Text("  Transients: %.1f MB, aliased: %.1f MB (saved %.1f MB), heaps: %.1f MB", (float)graph.TransientBytes / (1024.f * 1024.f), (float)graph.HeapBytes / (1024.f * 1024.f), (float)graph.AliasingSavedBytes() / (1024.f * 1024.f), (float)renderGraph.ReservedHeapBytes() / (1024.f * 1024.f));
+
+        TextureStreamerStatistics streaming = textureStreamer.Statistics();
+        ImGui::Text("Streamed textures: %u / %u resident (%u waiting, %u decoding, %u streaming, %u failed)", streaming.ResidentCount, streaming.TextureCount, streaming.WaitingCount, streaming.DecodingCount, streaming.StreamingCount, streaming.FailedCount);
+        ImGui::Text("  Decoded: %.1f MB, uploaded: %.1f MB", (float)streaming.DecodedBytes / (1024.f * 1024.f), (float)streaming.UploadedBytes / (1024.f * 1024.f));
+        ImGui::Text("  Allocated: %.1f MB, budget: %.1f / %.1f MB%s", (float)streaming.AllocatedBytes / (1024.f * 1024.f), (float)streaming.Budget.TargetBytes / (1024.f * 1024.f), (float)streaming.Budget.BudgetBytes / (1024.f * 1024.f), streaming.Budget.IsOverBudget ? " (over budget!)" : "");
         ImGui::End();
     }
     ImGui::PopStyleVar();
 }
 
+void Ui::SubmitTextureStreamingWindow(GpuTextureStreamer& textureStreamer)
+{
+    ImGui::SetNextWindowSize(ImVec2(350.f * m_DearImGui.DpiScale(), 0.f), ImGuiCond_FirstUseEver);
+    if (ImGui::Begin2("Texture streaming", &ShowTextureStreamingWindow))
+    {
+        TextureStreamerStatistics streaming = textureStreamer.Statistics();
+        const float megabyte = 1024.f * 1024.f;
+
+        if (m_TextureBudgetMegabytes < 0)
+        { m_TextureBudgetMegabytes = (int)(streaming.Budget.BudgetBytes / (1024 * 1024)); }
+
+        ImGui::PushItemWidth(-FLT_MIN);
+        ImGui::TextUnformatted("Memory budget");
+        if (ImGui::SliderInt("##textureBudget", &m_TextureBudgetMegabytes, 16, 4096, "%d MB", ImGuiSliderFlags_AlwaysClamp | ImGuiSliderFlags_Logarithmic))
+        { textureStreamer.SetBudget((uint64_t)m_TextureBudgetMegabytes * 1024 * 1024); }
+        ImGui::PopItemWidth();
+
+        ImGui::Text("Wanted: %.1f MB", (float)streaming.Budget.WantedBytes / megabyte);
+        ImGui::Text("Target: %.1f MB (%u mips evicted)%s", (float)streaming.Budget.TargetBytes / megabyte, streaming.Budget.EvictedMipCount, streaming.Budget.IsOverBudget ? " over budget!" : "");
+        ImGui::Text("Allocated: %.1f MB", (float)streaming.AllocatedBytes / megabyte);
+        ImGui::Text("Uploaded: %.1f MB, evicted: %.1f MB", (float)streaming.UploadedBytes / megabyte, (float)streaming.EvictedBytes / megabyte);
+
+        // Recorded traces are replayed against a range of budgets around the current one to help pick a budget for the scene
+        ImGui::SeparatorText("Budget simulation");
+        if (!textureStreamer.IsRecordingUsage())
+        {
+            if (ImGui::Button("Start recording usage", ImVec2(-1.f, 0.f)))
+            { textureStreamer.StartRecordingUsage(); }
+        }
+        else if (ImGui::Button("Stop recording and simulate", ImVec2(-1.f, 0.f)))
+        {
+            TextureUsageTrace trace = textureStreamer.StopRecordingUsage();
+            m_TextureBudgetSimulations.clear();
+            for (uint64_t budget = std::max<uint64_t>(streaming.Budget.BudgetBytes / 8, 1024 * 1024); budget <= streaming.Budget.BudgetBytes * 4; budget *= 2)
+            {
+                TextureBudgetSimulation simulation = SimulateTextureBudget(trace, budget, TextureStreamer::TAIL_MIP_SIZE);
+                m_TextureBudgetSimulations.emplace_back(budget, simulation);
+                printf("Texture budget %.1f MB: streamed %.1f MB, evicted %.1f MB, peak %.1f MB, %u / %u uses degraded\n",
+                    (float)budget / megabyte, (float)simulation.StreamedBytes / megabyte, (float)simulation.EvictedBytes / megabyte,
+                    (float)simulation.PeakTargetBytes / megabyte, simulation.DegradedUseCount, simulation.UseCount);
+            }
+        }
+
+        if (!m_TextureBudgetSimulations.empty() && ImGui::BeginTable("TextureBudgetSimulations", 4))
+        {
+            ImGui::TableSetupColumn("Budget");
+            ImGui::TableSetupColumn("Streamed");
+            ImGui::TableSetupColumn("Evicted");
+            ImGui::TableSetupColumn("Degraded");
+            ImGui::TableHeadersRow();
+
+            for (const auto& [budget, simulation] : m_TextureBudgetSimulations)
+            {
+                ImGui::TableNextRow();
+                ImGui::TableSetColumnIndex(0);
+                ImGui::Text("%.0f MB", (float)budget / megabyte);
+                ImGui::TableSetColumnIndex(1);
+                ImGui::Text("%.1f MB", (float)simulation.StreamedBytes / megabyte);
+                ImGui::TableSetColumnIndex(2);
+                ImGui::Text("%.1f MB", (float)simulation.EvictedBytes / megabyte);
+                ImGui::TableSetColumnIndex(3);
+                ImGui::Text("%.1f%%", simulation.UseCount == 0 ? 0.f : (float)simulation.DegradedUseCount * 100.f / (float)simulation.UseCount);
+            }
+
+            ImGui::EndTable();
+        }
+
+        ImGui::End();
+    }
+}
+
 void Ui::SubmitViewportOverlays(ShaderInterop::LightLinkedListDebugMode debugOverlay, uint32_t maxLightsPerPixelForOverlay)
 {
     using ShaderInterop::LightLinkedListDebugMode;
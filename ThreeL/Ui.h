@@ -1,13 +1,19 @@
 #pragma once
 #include "Matrix4.h"
 #include "ShaderInterop.h"
+#include "TextureBudget.h"
+#include "TimingHistory.h"
 #include "Vector2.h"
 
+#include <vector>
+
 class CameraController;
 class CameraInput;
 struct ComputeContext;
 class DearImGui;
 class FrameStatistics;
+class GpuRenderGraph;
+class GpuTextureStreamer;
 class GraphicsCore;
 struct ImGuiDockNode;
 class ParticleSystem;
@@ -49,8 +55,22 @@ public:
     bool ShowParticleSystemGizmo = true;
     void SubmitParticleSystemEditor(ComputeContext& context, ParticleSystem& particleSystem, ParticleSystemDefinition& particleSystemDefinition);
 
+private:
+    // Summarizing the timing history isn't free, so it's only redone every TIMING_SUMMARY_INTERVAL recorded frames
+    // Indexed by Timer * TimingDomain::Count + TimingDomain
+    static constexpr uint64_t TIMING_SUMMARY_INTERVAL = 30;
+    std::vector<TimingSummary> m_TimingSummaries;
+    uint64_t m_TimingSummariesRecordedFrameCount = 0;
+public:
     bool ShowTimingStatisticsWindow = false;
-    void SubmitTimingStatisticsWindow();
+    void SubmitTimingStatisticsWindow(GpuTextureStreamer& textureStreamer, const GpuRenderGraph& renderGraph);
+
+private:
+    int m_TextureBudgetMegabytes = -1;
+    std::vector<std::pair<uint64_t, TextureBudgetSimulation>> m_TextureBudgetSimulations;
+public:
+    bool ShowTextureStreamingWindow = false;
+    void SubmitTextureStreamingWindow(GpuTextureStreamer& textureStreamer);
 
     bool ShowControlsHint = true;
     void SubmitViewportOverlays(ShaderInterop::LightLinkedListDebugMode debugOverlay, uint32_t maxLightsPerPixelForOverlay);
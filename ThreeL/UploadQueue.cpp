@@ -3,9 +3,34 @@
 
 #include "GraphicsCore.h"
 
+namespace
+{
+    ComPtr<ID3D12Resource> CreateUploadResource(ID3D12Device* device, uint64_t sizeBytes, const std::wstring& debugName)
+    {
+        D3D12_HEAP_PROPERTIES uploadHeapProperties = { D3D12_HEAP_TYPE_UPLOAD };
+        D3D12_RESOURCE_DESC uploadResourceDescription = DescribeBufferResource(sizeBytes, D3D12_RESOURCE_FLAG_DENY_SHADER_RESOURCE);
+
+        ComPtr<ID3D12Resource> uploadResource;
+        AssertSuccess(device->CreateCommittedResource(
+            &uploadHeapProperties,
+            D3D12_HEAP_FLAG_CREATE_NOT_ZEROED,
+            &uploadResourceDescription,
+            D3D12_RESOURCE_STATE_GENERIC_READ,
+            nullptr,
+            IID_PPV_ARGS(&uploadResource)
+        ));
+        uploadResource->SetName(debugName.c_str());
+        return uploadResource;
+    }
+}
+
 UploadQueue::UploadQueue(GraphicsCore& graphics)
-    : m_Graphics(graphics), CommandQueue(graphics, D3D12_COMMAND_LIST_TYPE_COPY)
+    : m_Graphics(graphics), CommandQueue(graphics, D3D12_COMMAND_LIST_TYPE_COPY), m_Ring(RingSize)
 {
+    // The ring stays mapped for the lifetime of the queue, which is fine for upload heaps
+    m_RingResource = CreateUploadResource(graphics.Device(), RingSize, L"UploadQueue Staging Ring");
+    D3D12_RANGE emptyRange = { }; // We aren't going to read anything
+    AssertSuccess(m_RingResource->Map(0, &emptyRange, (void**)&m_MappedRing));
 }
 
 PendingUpload UploadQueue::AllocateResource(const D3D12_RESOURCE_DESC& resourceDescription, const std::wstring& debugName)
@@ -14,53 +39,79 @@ PendingUpload UploadQueue::AllocateResource(const D3D12_RESOURCE_DESC& resourceD
     Assert(debugName.length() > 0);
 
     // Allocate the resource
-    D3D12_HEAP_PROPERTIES resourceHeapProperties = { D3D12_HEAP_TYPE_DEFAULT };
-    ComPtr<ID3D12Resource> resource;
-    AssertSuccess(m_Graphics.Device()->CreateCommittedResource
+    ComPtr<ID3D12Resource> resource = m_Graphics.GpuMemoryManager().CreateResource
     (
-        &resourceHeapProperties,
+        resourceDescription.Dimension == D3D12_RESOURCE_DIMENSION_BUFFER ? GpuMemoryCategory::Buffers : GpuMemoryCategory::Textures,
+        D3D12_HEAP_TYPE_DEFAULT,
         D3D12_HEAP_FLAG_CREATE_NOT_ZEROED,
-        &resourceDescription,
+        resourceDescription,
         // Since we're going to first access this resource from a copy queue, it needs to start in the common state rather than copy destintation
         // https://docs.microsoft.com/en-us/windows/win32/api/d3d12/ne-d3d12-d3d12_resource_states#constants
         D3D12_RESOURCE_STATE_COMMON,
-        nullptr,
-        IID_PPV_ARGS(&resource)
-    ));
-    resource->SetName(debugName.c_str());
+        debugName
+    );
 
+    return AllocateUpload(std::move(resource), resourceDescription, 0, debugName);
+}
+
+PendingUpload UploadQueue::AllocateSubresourceUpload(ComPtr<ID3D12Resource> resource, uint32_t subresource, const std::wstring& debugName)
+{
+    Assert(resource != nullptr);
+    Assert(debugName.length() > 0);
+
+    D3D12_RESOURCE_DESC resourceDescription = resource->GetDesc();
+    Assert(resourceDescription.Dimension != D3D12_RESOURCE_DIMENSION_BUFFER && "Buffers only have a single subresource.");
+    Assert(subresource < (uint32_t)resourceDescription.MipLevels * resourceDescription.DepthOrArraySize);
+    return AllocateUpload(std::move(resource), resourceDescription, subresource, debugName);
+}
+
+PendingUpload UploadQueue::AllocateUpload(ComPtr<ID3D12Resource>&& resource, const D3D12_RESOURCE_DESC& resourceDescription, uint32_t subresource, const std::wstring& debugName)
+{
     // Determine the layout of the upload resource
     D3D12_PLACED_SUBRESOURCE_FOOTPRINT uploadPlacedFootprint;
     UINT rowCount;
     UINT64 rowSizeBytes;
     UINT64 uploadBufferSize;
-    m_Graphics.Device()->GetCopyableFootprints(&resourceDescription, 0, 1, 0, &uploadPlacedFootprint, &rowCount, &rowSizeBytes, &uploadBufferSize);
-
-    // Create the upload buffer
-    //TODO: For resources under a certain size it'd might make sense to pool and recycle buffers
-    D3D12_HEAP_PROPERTIES uploadHeapProperties = { D3D12_HEAP_TYPE_UPLOAD };
-    D3D12_RESOURCE_DESC uploadResourceDescription = DescribeBufferResource(uploadBufferSize, D3D12_RESOURCE_FLAG_DENY_SHADER_RESOURCE);
+    m_Graphics.Device()->GetCopyableFootprints(&resourceDescription, subresource, 1, 0, &uploadPlacedFootprint, &rowCount, &rowSizeBytes, &uploadBufferSize);
 
+    // Try to sub-allocate the staging memory from the ring
+    Assert(uploadPlacedFootprint.Offset == 0);
     ComPtr<ID3D12Resource> uploadResource;
-    AssertSuccess(m_Graphics.Device()->CreateCommittedResource(
-        &uploadHeapProperties,
-        D3D12_HEAP_FLAG_CREATE_NOT_ZEROED,
-        &uploadResourceDescription,
-        D3D12_RESOURCE_STATE_GENERIC_READ,
-        nullptr,
-        IID_PPV_ARGS(&uploadResource)
-    ));
-    uploadResource->SetName(std::format(L"{} (Upload)", debugName).c_str());
-
-    // Map the upload resource
-    uint8_t* mappedPtr;
-    D3D12_RANGE emptyRange = { }; // We aren't going to read anything
-    AssertSuccess(uploadResource->Map(0, &emptyRange, (void**)&mappedPtr));
+    uint64_t ringRegion = NoRingRegion;
+    uint8_t* mappedPtr = nullptr;
+    if (uploadBufferSize <= MaxRingAllocationSize)
+    {
+        bool isTexture = resourceDescription.Dimension != D3D12_RESOURCE_DIMENSION_BUFFER;
+        uint64_t alignment = isTexture ? D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT : D3D12_RAW_UAV_SRV_BYTE_ALIGNMENT;
 
-    size_t mappedSpanSize = uploadBufferSize - uploadPlacedFootprint.Offset;
-    mappedPtr += uploadPlacedFootprint.Offset;
+        std::lock_guard<std::mutex> lock(m_RingLock);
+        UploadRingAllocation allocation;
+        bool success = m_Ring.TryAllocate(uploadBufferSize, alignment, &allocation);
+        if (!success)
+        {
+            m_Ring.Retire(m_QueueFence->GetCompletedValue());
+            success = m_Ring.TryAllocate(uploadBufferSize, alignment, &allocation);
+        }
 
-    std::span<uint8_t> mappedSpan(mappedPtr, mappedSpanSize);
+        if (success)
+        {
+            uploadResource = m_RingResource;
+            ringRegion = allocation.Region;
+            uploadPlacedFootprint.Offset = allocation.Offset;
+            mappedPtr = m_MappedRing + allocation.Offset;
+        }
+    }
+
+    // Otherwise create a dedicated upload buffer
+    if (uploadResource == nullptr)
+    {
+        uploadResource = CreateUploadResource(m_Graphics.Device(), uploadBufferSize, std::format(L"{} (Upload)", debugName));
+
+        D3D12_RANGE emptyRange = { }; // We aren't going to read anything
+        AssertSuccess(uploadResource->Map(0, &emptyRange, (void**)&mappedPtr));
+    }
+
+    std::span<uint8_t> mappedSpan(mappedPtr, uploadBufferSize);
 
     // Return the pending upload
     Assert(rowCount < std::numeric_limits<uint32_t>::max() && "Row count can't fit in a uint!");
@@ -69,9 +120,11 @@ PendingUpload UploadQueue::AllocateResource(const D3D12_RESOURCE_DESC& resourceD
     (
         *this,
         std::move(uploadResource),
+        ringRegion,
         std::move(resource),
         uploadPlacedFootprint,
         resourceDescription.Dimension != D3D12_RESOURCE_DIMENSION_BUFFER, // isTextureUpload
+        subresource,
         mappedSpan,
         (uint32_t)rowCount,
         (uint32_t)rowSizeBytes
@@ -80,33 +133,115 @@ PendingUpload UploadQueue::AllocateResource(const D3D12_RESOURCE_DESC& resourceD
 
 InitiatedUpload UploadQueue::InitiateUpload(PendingUpload& job)
 {
-    // Unmap the staging buffer
-    job.m_UploadResource->Unmap(0, nullptr);
+    PendingUpload* jobs[] = { &job };
+    InitiatedUpload upload;
+    InitiateUploads(jobs, std::span(&upload, 1));
+    return upload;
+}
 
-    // Perform the upload
-    GpuSyncPoint syncPoint;
-    if (job.m_IsTextureUpload)
-    { syncPoint = PerformTextureUpload(job.m_Resource.Get(), job.m_UploadResource.Get(), job.m_UploadPlacedFootprint); }
-    else
-    { syncPoint = PerformBufferUpload(job.m_Resource.Get(), job.m_UploadResource.Get()); }
+std::vector<InitiatedUpload> UploadQueue::InitiateUploads(std::span<PendingUpload* const> jobs)
+{
+    for (PendingUpload* job : jobs)
+    {
+        Assert(job->m_StagingBuffer.data() != nullptr && "Attempted to initiate the upload of job which was already submitted!");
+        job->m_StagingBuffer = { };
+    }
+
+    std::vector<InitiatedUpload> uploads(jobs.size());
+    if (!jobs.empty())
+    { InitiateUploads(jobs, uploads); }
+    return uploads;
+}
+
+GpuSyncPoint UploadQueue::InitiateUploads(std::span<PendingUpload* const> jobs, std::span<InitiatedUpload> outUploads)
+{
+    Assert(jobs.size() == outUploads.size());
+
+    // Record all of the copies to a single command list
+    CommandContext& context = RentContext();
+    context.Begin(nullptr);
+
+    for (PendingUpload* job : jobs)
+    { RecordUpload(context, *job); }
+
+    GpuSyncPoint syncPoint = context.Finish();
+    ReturnContext(context);
 
     // Note: No resource barrier is needed or possible after uploading.
     // Resources written on copy queues must always implicitly decay to D3D12_RESOURCE_STATE_COMMON
     // https://docs.microsoft.com/en-us/windows/win32/direct3d12/using-resource-barriers-to-synchronize-resource-states-in-direct3d-12#state-decay-to-common
     // https://docs.microsoft.com/en-us/windows/win32/api/d3d12/ne-d3d12-d3d12_resource_states#constants
 
-    // Queue the staging resource for cleanup
+    // Hand the staging memory back once the copies are done with it
+    bool usesRing = false;
+    std::vector<ComPtr<ID3D12Resource>> dedicatedUploadResources;
     {
-        std::lock_guard<std::mutex> lock(m_CleanupQueueLock);
-        m_CleanupQueue.push({ syncPoint, std::move(job.m_UploadResource) });
+        std::lock_guard<std::mutex> lock(m_RingLock);
+        for (PendingUpload* job : jobs)
+        {
+            if (job->m_RingRegion != NoRingRegion)
+            {
+                m_Ring.Submit(job->m_RingRegion, syncPoint.m_FenceValue);
+                job->m_UploadResource = nullptr;
+                usesRing = true;
+            }
+            else
+            { dedicatedUploadResources.push_back(std::move(job->m_UploadResource)); }
+        }
     }
 
+    // The dedicated upload resources are released along with the callback
+    syncPoint.Then(m_Graphics.FenceReactor(), [this, usesRing, fenceValue = syncPoint.m_FenceValue, dedicatedUploadResources = std::move(dedicatedUploadResources)]()
+        {
+            if (usesRing)
+            {
+                std::lock_guard<std::mutex> lock(m_RingLock);
+                m_Ring.Retire(fenceValue);
+            }
+        });
+
     // All done!
-    return
+    for (size_t i = 0; i < jobs.size(); i++)
     {
-        .Resource = std::move(job.m_Resource),
-        .SyncPoint = syncPoint,
-    };
+        outUploads[i] =
+        {
+            .Resource = std::move(jobs[i]->m_Resource),
+            .SyncPoint = syncPoint,
+        };
+    }
+
+    return syncPoint;
+}
+
+void UploadQueue::RecordUpload(CommandContext& context, PendingUpload& job)
+{
+    // Dedicated upload resources are only mapped for the duration of the upload, the ring is always mapped
+    if (job.m_RingRegion == NoRingRegion)
+    { job.m_UploadResource->Unmap(0, nullptr); }
+
+    if (job.m_IsTextureUpload)
+    {
+        D3D12_TEXTURE_COPY_LOCATION sourceLocation =
+        {
+            .pResource = job.m_UploadResource.Get(),
+            .Type = D3D12_TEXTURE_COPY_TYPE_PLACED_FOOTPRINT,
+            .PlacedFootprint = job.m_UploadPlacedFootprint,
+        };
+
+        D3D12_TEXTURE_COPY_LOCATION destinationLocation =
+        {
+            .pResource = job.m_Resource.Get(),
+            .Type = D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX,
+            .SubresourceIndex = job.m_Subresource,
+        };
+
+        context.m_CommandList->CopyTextureRegion(&destinationLocation, 0, 0, 0, &sourceLocation, nullptr);
+    }
+    else
+    {
+        // The ring is much larger than the destination, so this can't use CopyResource like the dedicated upload resources could
+        context.m_CommandList->CopyBufferRegion(job.m_Resource.Get(), 0, job.m_UploadResource.Get(), job.m_UploadPlacedFootprint.Offset, job.m_Resource->GetDesc().Width);
+    }
 }
 
 GpuSyncPoint UploadQueue::PerformTextureUpload(ID3D12Resource* destination, ID3D12Resource* source, const D3D12_PLACED_SUBRESOURCE_FOOTPRINT& uploadPlacedFootprint)
@@ -135,6 +270,40 @@ GpuSyncPoint UploadQueue::PerformTextureUpload(ID3D12Resource* destination, ID3D
     return syncPoint;
 }
 
+GpuSyncPoint UploadQueue::CopyTextureMips(ID3D12Resource* destination, uint32_t destinationMip, ID3D12Resource* source, uint32_t sourceMip, uint32_t mipCount)
+{
+    Assert(destination->GetDesc().Format == source->GetDesc().Format);
+    Assert(destination->GetDesc().DepthOrArraySize == 1 && source->GetDesc().DepthOrArraySize == 1);
+    Assert(destinationMip + mipCount <= destination->GetDesc().MipLevels);
+    Assert(sourceMip + mipCount <= source->GetDesc().MipLevels);
+
+    CommandContext& context = RentContext();
+    context.Begin(nullptr);
+
+    for (uint32_t i = 0; i < mipCount; i++)
+    {
+        D3D12_TEXTURE_COPY_LOCATION sourceLocation =
+        {
+            .pResource = source,
+            .Type = D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX,
+            .SubresourceIndex = sourceMip + i,
+        };
+
+        D3D12_TEXTURE_COPY_LOCATION destinationLocation =
+        {
+            .pResource = destination,
+            .Type = D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX,
+            .SubresourceIndex = destinationMip + i,
+        };
+
+        context.m_CommandList->CopyTextureRegion(&destinationLocation, 0, 0, 0, &sourceLocation, nullptr);
+    }
+
+    GpuSyncPoint syncPoint = context.Finish();
+    ReturnContext(context);
+    return syncPoint;
+}
+
 GpuSyncPoint UploadQueue::PerformBufferUpload(ID3D12Resource* destination, ID3D12Resource* source, uint64_t length)
 {
     CommandContext& context = RentContext();
@@ -171,21 +340,8 @@ void UploadQueue::Flush()
 {
     QueueSyncPoint().Wait();
     
-    // At this point all outstanding upload jobs are complete, just drain the queue
-    std::lock_guard<std::mutex> lock(m_CleanupQueueLock);
-    while (!m_CleanupQueue.empty())
-    {
-        // Popping will implicitly release the resource
-        m_CleanupQueue.pop();
-    }
-}
-
-void UploadQueue::Cleanup()
-{
-    std::lock_guard<std::mutex> lock(m_CleanupQueueLock);
-    while (!m_CleanupQueue.empty() && m_CleanupQueue.front().first.WasReached())
-    {
-        // Popping will implicitly release the resource
-        m_CleanupQueue.pop();
-    }
+    // At this point all outstanding upload jobs are complete, retire the ring now rather than waiting for the fence reactor to get to it
+    // (Dedicated upload resources are still released by the reactor.)
+    std::lock_guard<std::mutex> lock(m_RingLock);
+    m_Ring.Retire(m_QueueFence->GetCompletedValue());
 }
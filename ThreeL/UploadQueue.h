@@ -2,6 +2,10 @@
 #include "CommandQueue.h"
 #include "GpuSyncPoint.h"
 #include "pch.h"
+#include "UploadRing.h"
+
+#include <span>
+#include <vector>
 
 class GraphicsCore;
 class UploadQueue;
@@ -18,9 +22,11 @@ struct PendingUpload
 private:
     UploadQueue& m_UploadQueue;
     ComPtr<ID3D12Resource> m_UploadResource;
+    uint64_t m_RingRegion; // NoRingRegion when the upload uses a dedicated upload resource
     ComPtr<ID3D12Resource> m_Resource;
     D3D12_PLACED_SUBRESOURCE_FOOTPRINT m_UploadPlacedFootprint;
     bool m_IsTextureUpload;
+    uint32_t m_Subresource;
 
     std::span<uint8_t> m_StagingBuffer; // start is nullptr when upload already done
     const uint32_t m_RowCount;
@@ -30,18 +36,22 @@ private:
     (
         UploadQueue& uploadQueue,
         ComPtr<ID3D12Resource>&& uploadResource,
+        uint64_t ringRegion,
         ComPtr<ID3D12Resource>&& resource,
         D3D12_PLACED_SUBRESOURCE_FOOTPRINT uploadPlacedFootprint,
         bool isTextureUpload,
+        uint32_t subresource,
         std::span<uint8_t> stagingBuffer,
         uint32_t rowCount,
         uint32_t rowLengthBytes
     )
         : m_UploadQueue(uploadQueue)
         , m_UploadResource(uploadResource)
+        , m_RingRegion(ringRegion)
         , m_Resource(resource)
         , m_UploadPlacedFootprint(uploadPlacedFootprint)
         , m_IsTextureUpload(isTextureUpload)
+        , m_Subresource(subresource)
         , m_StagingBuffer(stagingBuffer)
         , m_RowCount(rowCount)
         , m_RowLengthBytes(rowLengthBytes)
@@ -52,6 +62,22 @@ private:
     PendingUpload& operator =(const PendingUpload&) = delete;
 
 public:
+    // Moving is fine though (IE: for batching uploads in a container), the moved-from upload is left looking like it was already initiated
+    PendingUpload(PendingUpload&& other) noexcept
+        : m_UploadQueue(other.m_UploadQueue)
+        , m_UploadResource(std::move(other.m_UploadResource))
+        , m_RingRegion(other.m_RingRegion)
+        , m_Resource(std::move(other.m_Resource))
+        , m_UploadPlacedFootprint(other.m_UploadPlacedFootprint)
+        , m_IsTextureUpload(other.m_IsTextureUpload)
+        , m_Subresource(other.m_Subresource)
+        , m_StagingBuffer(other.m_StagingBuffer)
+        , m_RowCount(other.m_RowCount)
+        , m_RowLengthBytes(other.m_RowLengthBytes)
+    {
+        other.m_StagingBuffer = { };
+    }
+
     inline std::span<uint8_t> StagingBuffer() { return m_StagingBuffer; }
     inline uint32_t RowCount() { return m_RowCount; }
     inline uint32_t RowLengthBytes() { return m_RowLengthBytes; }
@@ -80,24 +106,44 @@ class UploadQueue : public CommandQueue
 private:
     GraphicsCore& m_Graphics;
 
-    std::mutex m_CleanupQueueLock;
-    std::queue<std::pair<GpuSyncPoint, ComPtr<ID3D12Resource>>> m_CleanupQueue;
+    // Staging memory for most uploads is sub-allocated from a persistently mapped ring, uploads larger than MaxRingAllocationSize (or which don't fit
+    // while the ring is full) get their own upload resource instead
+    static constexpr uint64_t RingSize = 64 * 1024 * 1024;
+    static constexpr uint64_t MaxRingAllocationSize = RingSize / 4;
+    static constexpr uint64_t NoRingRegion = UINT64_MAX;
+
+    // Regions of the ring are retired and dedicated upload resources are released by the fence reactor once their copies complete
+    std::mutex m_RingLock;
+    UploadRing m_Ring;
+    ComPtr<ID3D12Resource> m_RingResource;
+    uint8_t* m_MappedRing;
 
 public:
     UploadQueue(GraphicsCore& graphics);
 
     PendingUpload AllocateResource(const D3D12_RESOURCE_DESC& resourceDescription, const std::wstring& debugName);
 
+    //! Allocates an upload of a single subresource of an existing texture, the resource must be in the common state
+    //! The other subresources of the texture may be in use while the upload is in progress, but the uploaded subresource must not be.
+    PendingUpload AllocateSubresourceUpload(ComPtr<ID3D12Resource> resource, uint32_t subresource, const std::wstring& debugName);
+
+    //! Initiates several uploads using a single command list, all of the returned uploads share the same sync point
+    //! Prefer this over PendingUpload::InitiateUpload when creating many small resources at once.
+    std::vector<InitiatedUpload> InitiateUploads(std::span<PendingUpload* const> jobs);
+
+    //! Copies mipCount mip levels between two textures with the same format, both resources must be in the common state
+    //! The copy is ordered after every upload initiated before it, so it's fine for the source mips to still be uploading.
+    GpuSyncPoint CopyTextureMips(ID3D12Resource* destination, uint32_t destinationMip, ID3D12Resource* source, uint32_t sourceMip, uint32_t mipCount);
+
 private:
+    PendingUpload AllocateUpload(ComPtr<ID3D12Resource>&& resource, const D3D12_RESOURCE_DESC& resourceDescription, uint32_t subresource, const std::wstring& debugName);
     InitiatedUpload InitiateUpload(PendingUpload& job);
+    GpuSyncPoint InitiateUploads(std::span<PendingUpload* const> jobs, std::span<InitiatedUpload> outUploads);
+    void RecordUpload(CommandContext& context, PendingUpload& job);
     GpuSyncPoint PerformTextureUpload(ID3D12Resource* destination, ID3D12Resource* source, const D3D12_PLACED_SUBRESOURCE_FOOTPRINT& uploadPlacedFootprint);
     GpuSyncPoint PerformBufferUpload(ID3D12Resource* destination, ID3D12Resource* source, uint64_t length = -1);
 
 public:
     //! Flushes all outstanding uploads associated with this queue
     void Flush();
-
-    //TODO: Ideally this should just happen automagically on a background thread
-    //! Cleans up outstanding staging resources which are no longer needed
-    void Cleanup();
 };
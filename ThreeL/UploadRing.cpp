@@ -0,0 +1,70 @@
+#include "pch.h"
+#include "UploadRing.h"
+
+UploadRing::UploadRing(uint64_t capacity)
+    : m_Capacity(capacity)
+{
+    Assert(capacity > 0);
+}
+
+bool UploadRing::TryAllocate(uint64_t sizeBytes, uint64_t alignment, UploadRingAllocation* outAllocation)
+{
+    Assert(sizeBytes > 0);
+    Assert(alignment > 0 && (alignment & (alignment - 1)) == 0 && "The alignment must be a power of two.");
+    Assert(m_Capacity % alignment == 0 && "The ring's capacity must be a multiple of the alignment.");
+
+    if (sizeBytes > m_Capacity)
+    { return false; }
+
+    // Align the start of the allocation, wrapping around to the start of the ring if it'd run off the end
+    uint64_t offset = m_Head % m_Capacity;
+    uint64_t alignedOffset = (offset + alignment - 1) & ~(alignment - 1);
+    if (alignedOffset + sizeBytes > m_Capacity)
+    { alignedOffset = m_Capacity; }
+
+    uint64_t end = m_Head + (alignedOffset - offset) + sizeBytes;
+    if (end - m_Tail > m_Capacity)
+    { return false; }
+
+    *outAllocation =
+    {
+        .Offset = alignedOffset % m_Capacity,
+        .Region = m_RetiredRegionCount + m_Regions.size(),
+    };
+
+    m_Regions.push_back({ .End = end, .FenceValue = NotSubmitted });
+    m_Head = end;
+    return true;
+}
+
+void UploadRing::Submit(uint64_t region, uint64_t fenceValue)
+{
+    Assert(region >= m_RetiredRegionCount && region - m_RetiredRegionCount < m_Regions.size() && "The region was already retired or never allocated.");
+    Assert(fenceValue != NotSubmitted);
+
+    Region& entry = m_Regions[(size_t)(region - m_RetiredRegionCount)];
+    Assert(entry.FenceValue == NotSubmitted && "The region was already submitted.");
+    entry.FenceValue = fenceValue;
+}
+
+void UploadRing::Retire(uint64_t completedFenceValue)
+{
+    while (!m_Regions.empty())
+    {
+        const Region& front = m_Regions.front();
+        if (front.FenceValue == NotSubmitted || front.FenceValue > completedFenceValue)
+        { break; }
+
+        m_Tail = front.End;
+        m_Regions.pop_front();
+        m_RetiredRegionCount++;
+    }
+
+    // Once everything has been retired the next allocation may as well start at the beginning of the ring
+    // (This avoids wrapping around in the middle of a batch when the ring is mostly idle.)
+    if (m_Regions.empty())
+    {
+        m_Head += (m_Capacity - m_Head % m_Capacity) % m_Capacity;
+        m_Tail = m_Head;
+    }
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include <deque>
+#include <stdint.h>
+
+//! An allocation made by UploadRing::Allocate
+struct UploadRingAllocation
+{
+    //! Offset of the allocation from the start of the ring
+    uint64_t Offset;
+
+    //! Identifies the allocation when it's submitted, see UploadRing::Submit
+    uint64_t Region;
+};
+
+//! Bookkeeping for a ring of staging memory which is shared by many uploads
+//! Allocations are carved from the ring in order and are tagged with a fence value once the copy reading them is submitted. They're reclaimed in the same
+//! order once the fence reaches that value, so an upload which is slow to be submitted holds back everything allocated after it.
+//! This type only deals in offsets and fence values so it has no dependency on D3D. It is not thread-safe.
+class UploadRing
+{
+private:
+    static constexpr uint64_t NotSubmitted = UINT64_MAX;
+
+    struct Region
+    {
+        //! The end of the region, padding skipped to wrap around the end of the ring belongs to the region which caused it
+        uint64_t End;
+        uint64_t FenceValue;
+    };
+
+    uint64_t m_Capacity;
+
+    // Positions are monotonically increasing byte counts, the corresponding offset within the ring is the position modulo the capacity
+    uint64_t m_Head = 0;
+    uint64_t m_Tail = 0;
+
+    // Live regions from oldest to newest, the region ID of the front region is m_RetiredRegionCount
+    std::deque<Region> m_Regions;
+    uint64_t m_RetiredRegionCount = 0;
+
+public:
+    //! The capacity must be a multiple of every alignment which will be requested
+    UploadRing(uint64_t capacity);
+    UploadRing(const UploadRing&) = delete;
+
+    //! Allocates sizeBytes bytes aligned to alignment (which must be a power of two)
+    //! Returns false when the ring doesn't have enough free space, the caller may retire regions and try again or use dedicated memory instead.
+    bool TryAllocate(uint64_t sizeBytes, uint64_t alignment, UploadRingAllocation* outAllocation);
+
+    //! Marks the allocation's region as being read by work which will be complete once the fence reaches fenceValue
+    void Submit(uint64_t region, uint64_t fenceValue);
+
+    //! Reclaims regions which were submitted with a fence value of at most completedFenceValue
+    void Retire(uint64_t completedFenceValue);
+
+    inline uint64_t Capacity() const { return m_Capacity; }
+    inline uint64_t UsedBytes() const { return m_Head - m_Tail; }
+    inline uint32_t RegionCount() const { return (uint32_t)m_Regions.size(); }
+    inline bool IsEmpty() const { return m_Regions.empty(); }
+};